@@ -0,0 +1,1042 @@
+/*
+  Adaptive Radix Tree
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <art/art.h>
+
+#include <string.h>
+#include <_memory.h>
+#include <linux/_compiler.h>
+#include <iterator/iterator.h>
+
+#define ART_INT_BYTES (sizeof(art_key_t))
+
+#define __art_is_leaf(p) ((uintptr_t)(p) & 1)
+#define __art_leaf(p)    ((art_leaf_t*)((uintptr_t)(p) & ~(uintptr_t)1))
+#define __art_tag(l)     ((void*)((uintptr_t)(l) | 1))
+#define __art_min(a, b)  ((a) < (b) ? (a) : (b))
+
+/* Big-endian with the sign bit flipped, so bytes compare as the signed integers do */
+static /* __always_inline */ inline const uint8_t* __art_int_bytes(art_key_t key, uint8_t* buf)
+{
+    uintptr_t u = (uintptr_t)key ^ ((uintptr_t)1 << (ART_INT_BYTES * 8 - 1));
+    int i = 0;
+
+    for (i = ART_INT_BYTES - 1; i >= 0; --i) {
+        buf[i] = (uint8_t)u;
+        u >>= 8;
+    }
+    return buf;
+}
+
+static /* __always_inline */ inline const uint8_t* __art_key_bytes(const art_t* _this, art_key_t key, uint8_t* buf, uint32_t* len)
+{
+    if (_this->string) {
+        *len = strlen((const char*)key) + 1;
+        return (const uint8_t*)key;
+    }
+
+    *len = ART_INT_BYTES;
+    return __art_int_bytes(key, buf);
+}
+
+static /* __always_inline */ inline const uint8_t* __art_leaf_bytes(const art_t* _this, const art_leaf_t* leaf, uint8_t* buf, uint32_t* len)
+{
+    *len = leaf->len;
+    return _this->string ? (const uint8_t*)leaf->key : __art_int_bytes(leaf->key, buf);
+}
+
+static /* __always_inline */ inline int __art_cmp(const uint8_t* left, uint32_t llen, const uint8_t* right, uint32_t rlen)
+{
+    int c = memcmp(left, right, __art_min(llen, rlen));
+    return 0 != c ? c : (int)llen - (int)rlen;
+}
+
+static /* __always_inline */ inline int __art_leaf_cmp(const art_t* _this, const art_leaf_t* leaf, const uint8_t* key, uint32_t len)
+{
+    uint8_t buf[ART_INT_BYTES];
+    uint32_t llen = 0;
+    const uint8_t* lk = __art_leaf_bytes(_this, leaf, buf, &llen);
+
+    return __art_cmp(lk, llen, key, len);
+}
+
+static void __art_leaf_free(const art_t* _this, art_leaf_t* leaf)
+{
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&leaf->value);
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+        _this->ops->free_key(&leaf->key);
+
+    p_free(leaf);
+}
+
+static art_node_t* __art_node_new(art_node_type_t type)
+{
+    static const size_t bytes[] = {
+        [ART_NODE4]   = sizeof(art_node4_t),
+        [ART_NODE16]  = sizeof(art_node16_t),
+        [ART_NODE48]  = sizeof(art_node48_t),
+        [ART_NODE256] = sizeof(art_node256_t),
+    };
+    art_node_t* n = (art_node_t*)p_calloc(1, bytes[type]);
+
+    if (likely(!is_null(n)))
+        n->type = type;
+    return n;
+}
+
+static /* __always_inline */ inline void __art_copy_header(art_node_t* dst, const art_node_t* src)
+{
+    dst->count = src->count;
+    dst->prefix_len = src->prefix_len;
+    memcpy(dst->prefix, src->prefix, __art_min(src->prefix_len, ART_PREFIX_MAX));
+}
+
+static void** __art_find_child(art_node_t* n, uint8_t c)
+{
+    art_node4_t* n4 = NULL;
+    art_node16_t* n16 = NULL;
+    art_node48_t* n48 = NULL;
+    art_node256_t* n256 = NULL;
+    int i = 0;
+
+    switch (n->type) {
+    case ART_NODE4:
+        n4 = (art_node4_t*)n;
+        for (i = 0; i < n->count; ++i)
+            if (n4->keys[i] == c)
+                return &n4->child[i];
+        break;
+    case ART_NODE16:
+        n16 = (art_node16_t*)n;
+        for (i = 0; i < n->count; ++i)
+            if (n16->keys[i] == c)
+                return &n16->child[i];
+        break;
+    case ART_NODE48:
+        n48 = (art_node48_t*)n;
+        if (0 != n48->index[c])
+            return &n48->child[n48->index[c] - 1];
+        break;
+    case ART_NODE256:
+        n256 = (art_node256_t*)n;
+        if (!is_null(n256->child[c]))
+            return &n256->child[c];
+        break;
+    }
+    return NULL;
+}
+
+/* The first child on a byte greater than `c`, -1 for the first of all */
+static void* __art_child_after(const art_node_t* n, int c)
+{
+    const art_node4_t* n4 = NULL;
+    const art_node16_t* n16 = NULL;
+    const art_node48_t* n48 = NULL;
+    const art_node256_t* n256 = NULL;
+    int i = 0;
+
+    switch (n->type) {
+    case ART_NODE4:
+        n4 = (const art_node4_t*)n;
+        for (i = 0; i < n->count; ++i)
+            if (n4->keys[i] > c)
+                return n4->child[i];
+        break;
+    case ART_NODE16:
+        n16 = (const art_node16_t*)n;
+        for (i = 0; i < n->count; ++i)
+            if (n16->keys[i] > c)
+                return n16->child[i];
+        break;
+    case ART_NODE48:
+        n48 = (const art_node48_t*)n;
+        for (i = c + 1; i < 256; ++i)
+            if (0 != n48->index[i])
+                return n48->child[n48->index[i] - 1];
+        break;
+    case ART_NODE256:
+        n256 = (const art_node256_t*)n;
+        for (i = c + 1; i < 256; ++i)
+            if (!is_null(n256->child[i]))
+                return n256->child[i];
+        break;
+    }
+    return NULL;
+}
+
+static art_leaf_t* __art_minimum(const void* p)
+{
+    while (!is_null(p) && !__art_is_leaf(p))
+        p = __art_child_after((const art_node_t*)p, -1);
+    return is_null(p) ? NULL : __art_leaf(p);
+}
+
+/* The bytes the path through `n` compresses, from its least leaf if they weren't all kept */
+static /* __always_inline */ inline const uint8_t* __art_prefix(const art_t* _this, const art_node_t* n, uint32_t depth, uint8_t* buf)
+{
+    uint32_t len = 0;
+
+    if (n->prefix_len <= ART_PREFIX_MAX)
+        return n->prefix;
+    return __art_leaf_bytes(_this, __art_minimum(n), buf, &len) + depth;
+}
+
+/* Count of the bytes of the compressed path of `n` that `key` matches from `depth` */
+static uint32_t __art_prefix_mismatch(const art_t* _this, const art_node_t* n, const uint8_t* key, uint32_t len, uint32_t depth)
+{
+    uint8_t buf[ART_INT_BYTES];
+    uint32_t max = __art_min(__art_min(n->prefix_len, ART_PREFIX_MAX), len - depth);
+    uint32_t llen = 0;
+    const uint8_t* lk = NULL;
+    uint32_t i = 0;
+
+    for (i = 0; i < max; ++i)
+        if (n->prefix[i] != key[depth + i])
+            return i;
+
+    if (n->prefix_len > ART_PREFIX_MAX) {
+        lk = __art_leaf_bytes(_this, __art_minimum(n), buf, &llen);
+        max = __art_min(__art_min(llen, len) - depth, n->prefix_len);
+        for (; i < max; ++i)
+            if (lk[depth + i] != key[depth + i])
+                return i;
+    }
+    return i;
+}
+
+static void __art_insert_sorted(uint8_t* keys, void** child, int count, uint8_t c, void* p)
+{
+    int i = 0;
+
+    while (i < count && keys[i] < c)
+        ++i;
+
+    memmove(keys + i + 1, keys + i, count - i);
+    memmove(child + i + 1, child + i, (count - i) * sizeof(void*));
+    keys[i] = c;
+    child[i] = p;
+}
+
+/* Link `p` under `n` on byte `c`, growing `n` into the next node type if full */
+static bool __art_add_child(void** ref, art_node_t* n, uint8_t c, void* p)
+{
+    art_node4_t* n4 = NULL;
+    art_node16_t* n16 = NULL;
+    art_node48_t* n48 = NULL;
+    art_node256_t* n256 = NULL;
+    int i = 0;
+
+    switch (n->type) {
+    case ART_NODE4:
+        n4 = (art_node4_t*)n;
+        if (n->count < 4) {
+            __art_insert_sorted(n4->keys, n4->child, n->count, c, p);
+            n->count++;
+            return true;
+        }
+
+        n16 = (art_node16_t*)__art_node_new(ART_NODE16);
+        if (unlikely(is_null(n16)))
+            return false;
+
+        __art_copy_header(&n16->n, n);
+        memcpy(n16->keys, n4->keys, sizeof(n4->keys));
+        memcpy(n16->child, n4->child, sizeof(n4->child));
+        *ref = n16;
+        p_free(n4);
+        return __art_add_child(ref, &n16->n, c, p);
+
+    case ART_NODE16:
+        n16 = (art_node16_t*)n;
+        if (n->count < 16) {
+            __art_insert_sorted(n16->keys, n16->child, n->count, c, p);
+            n->count++;
+            return true;
+        }
+
+        n48 = (art_node48_t*)__art_node_new(ART_NODE48);
+        if (unlikely(is_null(n48)))
+            return false;
+
+        __art_copy_header(&n48->n, n);
+        for (i = 0; i < 16; ++i) {
+            n48->index[n16->keys[i]] = i + 1;
+            n48->child[i] = n16->child[i];
+        }
+        *ref = n48;
+        p_free(n16);
+        return __art_add_child(ref, &n48->n, c, p);
+
+    case ART_NODE48:
+        n48 = (art_node48_t*)n;
+        if (n->count < 48) {
+            for (i = 0; !is_null(n48->child[i]); ++i)
+                ;
+            n48->child[i] = p;
+            n48->index[c] = i + 1;
+            n->count++;
+            return true;
+        }
+
+        n256 = (art_node256_t*)__art_node_new(ART_NODE256);
+        if (unlikely(is_null(n256)))
+            return false;
+
+        __art_copy_header(&n256->n, n);
+        for (i = 0; i < 256; ++i)
+            if (0 != n48->index[i])
+                n256->child[i] = n48->child[n48->index[i] - 1];
+        *ref = n256;
+        p_free(n48);
+        return __art_add_child(ref, &n256->n, c, p);
+
+    case ART_NODE256:
+        n256 = (art_node256_t*)n;
+        n256->child[c] = p;
+        n->count++;
+        return true;
+    }
+    return false;
+}
+
+/* Unlink the child in `slot` on byte `c`, shrinking `n` once it's a quarter full.
+   A shrink failing to allocate leaves the bigger node */
+static void __art_remove_child(void** ref, art_node_t* n, uint8_t c, void** slot)
+{
+    art_node4_t* n4 = NULL;
+    art_node16_t* n16 = NULL;
+    art_node48_t* n48 = NULL;
+    art_node256_t* n256 = NULL;
+    art_node_t* child = NULL;
+    uint32_t prefix = 0;
+    uint32_t sub = 0;
+    int i = 0;
+    int k = 0;
+
+    switch (n->type) {
+    case ART_NODE256:
+        n256 = (art_node256_t*)n;
+        n256->child[c] = NULL;
+        if (--n->count > 37 || is_null(n48 = (art_node48_t*)__art_node_new(ART_NODE48)))
+            return;
+
+        __art_copy_header(&n48->n, n);
+        for (i = 0; i < 256; ++i) {
+            if (!is_null(n256->child[i])) {
+                n48->child[k] = n256->child[i];
+                n48->index[i] = ++k;
+            }
+        }
+        *ref = n48;
+        p_free(n256);
+        return;
+
+    case ART_NODE48:
+        n48 = (art_node48_t*)n;
+        n48->child[n48->index[c] - 1] = NULL;
+        n48->index[c] = 0;
+        if (--n->count > 12 || is_null(n16 = (art_node16_t*)__art_node_new(ART_NODE16)))
+            return;
+
+        __art_copy_header(&n16->n, n);
+        for (i = 0; i < 256; ++i) {
+            if (0 != n48->index[i]) {
+                n16->keys[k] = i;
+                n16->child[k++] = n48->child[n48->index[i] - 1];
+            }
+        }
+        *ref = n16;
+        p_free(n48);
+        return;
+
+    case ART_NODE16:
+        n16 = (art_node16_t*)n;
+        i = slot - n16->child;
+        memmove(n16->keys + i, n16->keys + i + 1, n->count - 1 - i);
+        memmove(n16->child + i, n16->child + i + 1, (n->count - 1 - i) * sizeof(void*));
+        if (--n->count > 3 || is_null(n4 = (art_node4_t*)__art_node_new(ART_NODE4)))
+            return;
+
+        __art_copy_header(&n4->n, n);
+        memcpy(n4->keys, n16->keys, 3);
+        memcpy(n4->child, n16->child, 3 * sizeof(void*));
+        *ref = n4;
+        p_free(n16);
+        return;
+
+    case ART_NODE4:
+        n4 = (art_node4_t*)n;
+        i = slot - n4->child;
+        memmove(n4->keys + i, n4->keys + i + 1, n->count - 1 - i);
+        memmove(n4->child + i, n4->child + i + 1, (n->count - 1 - i) * sizeof(void*));
+        if (--n->count > 1)
+            return;
+
+        /* A single child takes the place of `n`, the path of `n` and its byte joining its own */
+        if (!__art_is_leaf(n4->child[0])) {
+            child = (art_node_t*)n4->child[0];
+            prefix = n->prefix_len;
+            if (prefix < ART_PREFIX_MAX)
+                n->prefix[prefix++] = n4->keys[0];
+            if (prefix < ART_PREFIX_MAX) {
+                sub = __art_min(child->prefix_len, ART_PREFIX_MAX - prefix);
+                memcpy(n->prefix + prefix, child->prefix, sub);
+                prefix += sub;
+            }
+            memcpy(child->prefix, n->prefix, __art_min(prefix, ART_PREFIX_MAX));
+            child->prefix_len += n->prefix_len + 1;
+        }
+        *ref = n4->child[0];
+        p_free(n4);
+        return;
+    }
+}
+
+/* Return the leaf holding `key` if there's one, else link `leaf`. `*oom` is set if that failed */
+static art_leaf_t* __art_insert(const art_t* _this, void** ref, const uint8_t* key, uint32_t len, uint32_t depth, art_leaf_t* leaf, bool* oom)
+{
+    uint8_t buf[ART_INT_BYTES];
+    void* p = *ref;
+    art_node_t* n = NULL;
+    art_node4_t* t = NULL;
+    art_leaf_t* l = NULL;
+    const uint8_t* lk = NULL;
+    uint32_t llen = 0;
+    uint32_t i = 0;
+    void** child = NULL;
+
+    if (is_null(p)) {
+        *ref = __art_tag(leaf);
+        return NULL;
+    }
+
+    /* Two leaves now, under a node on the first byte they differ */
+    if (__art_is_leaf(p)) {
+        l = __art_leaf(p);
+        lk = __art_leaf_bytes(_this, l, buf, &llen);
+        if (0 == __art_cmp(lk, llen, key, len))
+            return l;
+
+        t = (art_node4_t*)__art_node_new(ART_NODE4);
+        if (unlikely(is_null(t))) {
+            *oom = true;
+            return NULL;
+        }
+
+        for (i = depth; i < llen && i < len && lk[i] == key[i]; ++i)
+            ;
+        t->n.prefix_len = i - depth;
+        memcpy(t->n.prefix, key + depth, __art_min(t->n.prefix_len, ART_PREFIX_MAX));
+        __art_add_child((void**)&t, &t->n, lk[i], p);
+        __art_add_child((void**)&t, &t->n, key[i], __art_tag(leaf));
+        *ref = t;
+        return NULL;
+    }
+
+    n = (art_node_t*)p;
+    if (n->prefix_len > 0) {
+        i = __art_prefix_mismatch(_this, n, key, len, depth);
+        if (i < n->prefix_len) {
+            /* The path splits inside the prefix of `n` */
+            t = (art_node4_t*)__art_node_new(ART_NODE4);
+            if (unlikely(is_null(t))) {
+                *oom = true;
+                return NULL;
+            }
+
+            t->n.prefix_len = i;
+            memcpy(t->n.prefix, n->prefix, __art_min(i, ART_PREFIX_MAX));
+            if (n->prefix_len <= ART_PREFIX_MAX) {
+                __art_add_child((void**)&t, &t->n, n->prefix[i], n);
+                n->prefix_len -= i + 1;
+                memmove(n->prefix, n->prefix + i + 1, __art_min(n->prefix_len, ART_PREFIX_MAX));
+            } else {
+                n->prefix_len -= i + 1;
+                lk = __art_leaf_bytes(_this, __art_minimum(n), buf, &llen);
+                __art_add_child((void**)&t, &t->n, lk[depth + i], n);
+                memcpy(n->prefix, lk + depth + i + 1, __art_min(n->prefix_len, ART_PREFIX_MAX));
+            }
+            __art_add_child((void**)&t, &t->n, key[depth + i], __art_tag(leaf));
+            *ref = t;
+            return NULL;
+        }
+        depth += n->prefix_len;
+    }
+
+    child = __art_find_child(n, key[depth]);
+    if (!is_null(child))
+        return __art_insert(_this, child, key, len, depth + 1, leaf, oom);
+
+    if (!__art_add_child(ref, n, key[depth], __art_tag(leaf)))
+        *oom = true;
+    return NULL;
+}
+
+static art_leaf_t* __art_find(const art_t* _this, const uint8_t* key, uint32_t len)
+{
+    const void* p = _this->root;
+    const art_node_t* n = NULL;
+    void** child = NULL;
+    uint32_t depth = 0;
+    uint32_t max = 0;
+
+    while (!is_null(p)) {
+        if (__art_is_leaf(p))
+            return 0 == __art_leaf_cmp(_this, __art_leaf(p), key, len) ? __art_leaf(p) : NULL;
+
+        /* Only the bytes kept are checked, the leaf checks the whole key at last */
+        n = (const art_node_t*)p;
+        if (n->prefix_len > 0) {
+            max = __art_min(n->prefix_len, ART_PREFIX_MAX);
+            if (depth + max > len || 0 != memcmp(n->prefix, key + depth, max))
+                return NULL;
+            depth += n->prefix_len;
+        }
+
+        if (depth >= len)
+            return NULL;
+
+        child = __art_find_child((art_node_t*)n, key[depth++]);
+        p = is_null(child) ? NULL : *child;
+    }
+    return NULL;
+}
+
+/* The least leaf of `p` >= `key`, or > `key` with `upper` */
+static art_leaf_t* __art_bound(const art_t* _this, const void* p, const uint8_t* key, uint32_t len, uint32_t depth, bool upper)
+{
+    uint8_t buf[ART_INT_BYTES];
+    const art_node_t* n = NULL;
+    const uint8_t* prefix = NULL;
+    art_leaf_t* ret = NULL;
+    void** child = NULL;
+    uint32_t i = 0;
+    int c = 0;
+
+    if (__art_is_leaf(p)) {
+        c = __art_leaf_cmp(_this, __art_leaf(p), key, len);
+        return c > 0 || (0 == c && !upper) ? __art_leaf(p) : NULL;
+    }
+
+    n = (const art_node_t*)p;
+    if (n->prefix_len > 0) {
+        prefix = __art_prefix(_this, n, depth, buf);
+        for (i = 0; i < n->prefix_len; ++i) {
+            if (depth + i >= len)
+                return __art_minimum(n);
+            if (prefix[i] != key[depth + i])
+                return prefix[i] > key[depth + i] ? __art_minimum(n) : NULL;
+        }
+        depth += n->prefix_len;
+    }
+
+    if (depth >= len)
+        return __art_minimum(n);
+
+    child = __art_find_child((art_node_t*)n, key[depth]);
+    if (!is_null(child) && !is_null(ret = __art_bound(_this, *child, key, len, depth + 1, upper)))
+        return ret;
+
+    return __art_minimum(__art_child_after(n, key[depth]));
+}
+
+/* Unlink and return the leaf holding `key` */
+static art_leaf_t* __art_remove(art_t* _this, void** ref, const uint8_t* key, uint32_t len, uint32_t depth)
+{
+    void* p = *ref;
+    art_node_t* n = NULL;
+    art_leaf_t* l = NULL;
+    void** child = NULL;
+    uint32_t max = 0;
+
+    if (is_null(p))
+        return NULL;
+
+    if (__art_is_leaf(p)) {
+        l = __art_leaf(p);
+        if (0 != __art_leaf_cmp(_this, l, key, len))
+            return NULL;
+        *ref = NULL;
+        return l;
+    }
+
+    n = (art_node_t*)p;
+    if (n->prefix_len > 0) {
+        max = __art_min(n->prefix_len, ART_PREFIX_MAX);
+        if (depth + max > len || 0 != memcmp(n->prefix, key + depth, max))
+            return NULL;
+        depth += n->prefix_len;
+    }
+
+    if (depth >= len)
+        return NULL;
+
+    child = __art_find_child(n, key[depth]);
+    if (is_null(child))
+        return NULL;
+
+    if (!__art_is_leaf(*child))
+        return __art_remove(_this, child, key, len, depth + 1);
+
+    l = __art_leaf(*child);
+    if (0 != __art_leaf_cmp(_this, l, key, len))
+        return NULL;
+
+    __art_remove_child(ref, n, key[depth], child);
+    return l;
+}
+
+/* In order, return false once `cb` did */
+static bool __art_walk(const void* p, for_each_kv cb, void* arg, art_size_t* count)
+{
+    const art_node_t* n = NULL;
+    const art_node48_t* n48 = NULL;
+    void* const* child = NULL;
+    int i = 0;
+
+    if (__art_is_leaf(p)) {
+        (*count)++;
+        return cb(__art_leaf(p)->key, __art_leaf(p)->value, arg);
+    }
+
+    n = (const art_node_t*)p;
+    switch (n->type) {
+    case ART_NODE4:
+    case ART_NODE16:
+        child = ART_NODE4 == n->type ? ((const art_node4_t*)n)->child : ((const art_node16_t*)n)->child;
+        for (i = 0; i < n->count; ++i)
+            if (!__art_walk(child[i], cb, arg, count))
+                return false;
+        break;
+    case ART_NODE48:
+        n48 = (const art_node48_t*)n;
+        for (i = 0; i < 256; ++i)
+            if (0 != n48->index[i] && !__art_walk(n48->child[n48->index[i] - 1], cb, arg, count))
+                return false;
+        break;
+    case ART_NODE256:
+        child = ((const art_node256_t*)n)->child;
+        for (i = 0; i < 256; ++i)
+            if (!is_null(child[i]) && !__art_walk(child[i], cb, arg, count))
+                return false;
+        break;
+    }
+    return true;
+}
+
+/* Postorder, return the count of leaves freed */
+static art_size_t __art_free(const art_t* _this, void* p)
+{
+    art_node_t* n = NULL;
+    art_node48_t* n48 = NULL;
+    void** child = NULL;
+    art_size_t ret = 0;
+    int i = 0;
+
+    if (__art_is_leaf(p)) {
+        __art_leaf_free(_this, __art_leaf(p));
+        return 1;
+    }
+
+    n = (art_node_t*)p;
+    switch (n->type) {
+    case ART_NODE4:
+    case ART_NODE16:
+        child = ART_NODE4 == n->type ? ((art_node4_t*)n)->child : ((art_node16_t*)n)->child;
+        for (i = 0; i < n->count; ++i)
+            ret += __art_free(_this, child[i]);
+        break;
+    case ART_NODE48:
+        n48 = (art_node48_t*)n;
+        for (i = 0; i < 256; ++i)
+            if (0 != n48->index[i])
+                ret += __art_free(_this, n48->child[n48->index[i] - 1]);
+        break;
+    case ART_NODE256:
+        child = ((art_node256_t*)n)->child;
+        for (i = 0; i < 256; ++i)
+            if (!is_null(child[i]))
+                ret += __art_free(_this, child[i]);
+        break;
+    }
+
+    p_free(n);
+    return ret;
+}
+
+static /* __always_inline */ inline art_size_t __art_size(const art_t* _this)
+{
+    return _this->size;
+}
+
+static /* __always_inline */ inline art_size_t _art_size(const art_t* _this)
+{
+    if (unlikely(is_null(_this)))
+        return -1;
+    return __art_size(_this);
+}
+
+static /* __always_inline */ inline art_leaf_t* __art_end(const art_t* _this)
+{
+    return (art_leaf_t*)iterator_end();
+}
+
+static /* __always_inline */ inline art_leaf_t* __art_begin(const art_t* _this)
+{
+    art_leaf_t* l = __art_minimum(_this->root);
+    return is_null(l) ? __art_end(_this) : l;
+}
+
+static /* __always_inline */ inline art_leaf_t* _art_begin(const art_t* _this)
+{
+    if (unlikely(is_null(_this)))
+        return NULL;
+    return __art_begin(_this);
+}
+
+/* Bound of a key that may not be valid, NULL for none */
+static art_leaf_t* __art_bound_key(const art_t* _this, art_key_t key, bool upper)
+{
+    uint8_t buf[ART_INT_BYTES];
+    const uint8_t* kb = NULL;
+    uint32_t len = 0;
+
+    if (is_null(_this->root) || (_this->string && is_null((void*)key)))
+        return NULL;
+
+    kb = __art_key_bytes(_this, key, buf, &len);
+    return __art_bound(_this, _this->root, kb, len, 0, upper);
+}
+
+static /* __always_inline */ inline art_leaf_t* __art_next(const art_t* _this, const art_leaf_t* leaf)
+{
+    art_leaf_t* l = NULL;
+
+    if (__art_end(_this) == leaf)
+        return __art_end(_this);
+
+    l = __art_bound_key(_this, leaf->key, true);
+    return is_null(l) ? __art_end(_this) : l;
+}
+
+static /* __always_inline */ inline art_leaf_t* _art_next(const art_t* _this, const art_leaf_t* leaf)
+{
+    if (unlikely(is_null(_this) || is_null(leaf)))
+        return NULL;
+    return __art_next(_this, leaf);
+}
+
+static art_leaf_t* art_find(const art_t* _this, art_key_t key)
+{
+    uint8_t buf[ART_INT_BYTES];
+    const uint8_t* kb = NULL;
+    art_leaf_t* l = NULL;
+    uint32_t len = 0;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (_this->string && is_null((void*)key))
+        return __art_end(_this);
+
+    kb = __art_key_bytes(_this, key, buf, &len);
+    l = __art_find(_this, kb, len);
+    return is_null(l) ? __art_end(_this) : l;
+}
+
+static art_leaf_t* art_lower_bound(const art_t* _this, art_key_t key)
+{
+    art_leaf_t* l = NULL;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    l = __art_bound_key(_this, key, false);
+    return is_null(l) ? __art_end(_this) : l;
+}
+
+static art_leaf_t* art_upper_bound(const art_t* _this, art_key_t key)
+{
+    art_leaf_t* l = NULL;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    l = __art_bound_key(_this, key, true);
+    return is_null(l) ? __art_end(_this) : l;
+}
+
+/* The leaf is made first and dropped if the key exists: one descent either way */
+static art_leaf_t* __art_insert_kv(art_t* _this, art_key_t key, art_value_t value, bool replace)
+{
+    uint8_t buf[ART_INT_BYTES];
+    const uint8_t* kb = NULL;
+    art_leaf_t* l = NULL;
+    art_leaf_t* old = NULL;
+    uint32_t len = 0;
+    bool oom = false;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (_this->string && is_null((void*)key))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
+        return NULL;
+
+    l = (art_leaf_t*)p_calloc(1, sizeof(art_leaf_t));
+    if (unlikely(is_null(l)))
+        return NULL;
+
+    if (is_null(_this->ops) || is_null(_this->ops->copy_key)) {
+        l->key = key;
+    } else {
+        if (!_this->ops->copy_key(key, &l->key)) {
+            p_free(l);
+            return NULL;
+        }
+    }
+
+    if (is_null(_this->ops) || is_null(_this->ops->copy_value)) {
+        l->value = value;
+    } else {
+        if (!_this->ops->copy_value(value, &l->value)) {
+            if (!is_null(_this->ops->free_key))
+                _this->ops->free_key(&l->key);
+            p_free(l);
+            return NULL;
+        }
+    }
+
+    kb = __art_key_bytes(_this, l->key, buf, &len);
+    l->len = len;
+
+    old = __art_insert(_this, &_this->root, kb, len, 0, l, &oom);
+    if (is_null(old) && !oom) {
+        _this->size++;
+        return l;
+    }
+
+    if (!oom && replace) {
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+            _this->ops->free_value(&old->value);
+        old->value = l->value;
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+            _this->ops->free_key(&l->key);
+        p_free(l);
+        return old;
+    }
+
+    __art_leaf_free(_this, l);
+    return NULL;
+}
+
+static /* __always_inline */ inline art_leaf_t* art_insert(art_t* _this, art_key_t key, art_value_t value)
+{
+    return __art_insert_kv(_this, key, value, false);
+}
+
+static /* __always_inline */ inline art_leaf_t* art_insert_replace(art_t* _this, art_key_t key, art_value_t value)
+{
+    return __art_insert_kv(_this, key, value, true);
+}
+
+static art_leaf_t* art_erase(art_t* _this, art_leaf_t* pos)
+{
+    uint8_t buf[ART_INT_BYTES];
+    const uint8_t* kb = NULL;
+    art_leaf_t* next = NULL;
+    uint32_t len = 0;
+
+    if (unlikely(is_null(_this) || is_null(pos)))
+        return NULL;
+
+    if (__art_size(_this) <= 0 || __art_end(_this) == pos)
+        return NULL;
+
+    next = __art_next(_this, pos);
+    kb = __art_key_bytes(_this, pos->key, buf, &len);
+    if (pos != __art_remove(_this, &_this->root, kb, len, 0))
+        return NULL;
+
+    _this->size--;
+    __art_leaf_free(_this, pos);
+    return next;
+}
+
+static art_size_t art_remove(art_t* _this, art_key_t key)
+{
+    uint8_t buf[ART_INT_BYTES];
+    const uint8_t* kb = NULL;
+    art_leaf_t* l = NULL;
+    uint32_t len = 0;
+
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    if (_this->string && is_null((void*)key))
+        return 0;
+
+    kb = __art_key_bytes(_this, key, buf, &len);
+    l = __art_remove(_this, &_this->root, kb, len, 0);
+    if (is_null(l))
+        return 0;
+
+    _this->size--;
+    __art_leaf_free(_this, l);
+    return 1;
+}
+
+static art_size_t art_clear(art_t* _this)
+{
+    art_size_t ret = 0;
+
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    if (!is_null(_this->root))
+        ret = __art_free(_this, _this->root);
+
+    _this->root = NULL;
+    _this->size = 0;
+    return ret;
+}
+
+static art_size_t art_for_each_range(const art_t* _this, art_key_t lo, art_key_t hi, for_each_kv cb, void* arg)
+{
+    uint8_t buf[ART_INT_BYTES];
+    const uint8_t* hb = NULL;
+    art_leaf_t* l = NULL;
+    art_size_t ret = 0;
+    uint32_t len = 0;
+
+    if (unlikely(is_null(_this) || is_null(cb)))
+        return -1;
+
+    if (_this->string && is_null((void*)hi))
+        return 0;
+
+    hb = __art_key_bytes(_this, hi, buf, &len);
+    for (l = __art_bound_key(_this, lo, false); !is_null(l) && __art_leaf_cmp(_this, l, hb, len) < 0; l = __art_bound_key(_this, l->key, true)) {
+        ret++;
+        if (!cb(l->key, l->value, arg))
+            break;
+    }
+    return ret;
+}
+
+/* Down to the subtree of which every key starts with `prefix`, then a walk of it */
+static art_size_t art_for_each_prefix(const art_t* _this, const char* prefix, for_each_kv cb, void* arg)
+{
+    uint8_t buf[ART_INT_BYTES];
+    const uint8_t* key = (const uint8_t*)prefix;
+    const void* p = NULL;
+    const art_node_t* n = NULL;
+    const art_leaf_t* l = NULL;
+    const uint8_t* pb = NULL;
+    void** child = NULL;
+    art_size_t ret = 0;
+    uint32_t depth = 0;
+    uint32_t len = 0;
+    uint32_t i = 0;
+
+    if (unlikely(is_null(_this) || is_null(prefix) || is_null(cb)))
+        return -1;
+
+    if (!_this->string)
+        return -1;
+
+    len = strlen(prefix);
+    for (p = _this->root; !is_null(p); p = *child) {
+        if (__art_is_leaf(p)) {
+            l = __art_leaf(p);
+            if (l->len > len && 0 == memcmp((const void*)l->key, key, len))
+                __art_walk(p, cb, arg, &ret);
+            break;
+        }
+
+        n = (const art_node_t*)p;
+        if (n->prefix_len > 0) {
+            pb = __art_prefix(_this, n, depth, buf);
+            for (i = 0; i < n->prefix_len && depth + i < len; ++i)
+                if (pb[i] != key[depth + i])
+                    return 0;
+            depth += n->prefix_len;
+        }
+
+        if (depth >= len) {
+            __art_walk(p, cb, arg, &ret);
+            break;
+        }
+
+        child = __art_find_child((art_node_t*)n, key[depth++]);
+        if (is_null(child))
+            break;
+    }
+    return ret;
+}
+
+/* __always_inline */ inline void __art_init(art_t* art)
+{
+    art->root = NULL;
+}
+
+/* __always_inline */ inline void __art_deinit(art_t* art)
+{
+    art_clear(art);
+
+    art->ops = NULL;
+    art->root = NULL;
+    art->size = 0;
+    art->string = false;
+}
+
+typedef map_iterator_t* (*fp_end)(const art_t* _this);
+typedef map_iterator_t* (*fp_begin)(const art_t* _this);
+typedef map_iterator_t* (*fp_next)(const art_t* _this, const map_iterator_t* iterator);
+typedef map_iterator_t* (*fp_find)(const art_t* _this, art_key_t key);
+typedef map_iterator_t* (*fp_insert)(art_t* _this, art_key_t key, art_value_t value);
+typedef map_iterator_t* (*fp_erase)(art_t* _this, map_iterator_t* iterator);
+
+const class_art_t* class_art_ins(void)
+{
+    static const class_art_t ins = {
+        .size            = _art_size,
+        .end             = (fp_end)__art_end,
+        .begin           = (fp_begin)_art_begin,
+        .next            = (fp_next)_art_next,
+        .find            = (fp_find)art_find,
+        .lower_bound     = (fp_find)art_lower_bound,
+        .upper_bound     = (fp_find)art_upper_bound,
+        .insert          = (fp_insert)art_insert,
+        .insert_replace  = (fp_insert)art_insert_replace,
+        .erase           = (fp_erase)art_erase,
+        .remove          = art_remove,
+        .clear           = art_clear,
+        .for_each_range  = art_for_each_range,
+        .for_each_prefix = art_for_each_prefix,
+    };
+    return &ins;
+}
@@ -0,0 +1,1079 @@
+/*
+  B+tree Implementations
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <btree/btree.h>
+
+#include <string.h>
+#include <_log.h>
+#include <_memory.h>
+#include <linux/_compiler.h>
+#include <iterator/iterator.h>
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
+#ifndef TAG
+#define TAG "[btree]"
+#endif /* TAG */
+
+#define BTREE_LEAF_MIN   (BTREE_LEAF_SLOTS / 2)
+#define BTREE_INNER_MIN  (BTREE_INNER_KEYS / 2)
+#define BTREE_MAX_HEIGHT (32)
+
+/* Leaves are aligned to BTREE_LEAF_BYTES, so the leaf of an iterator is found by masking */
+#define btree_leaf_of(it) ((btree_leaf_t*)((uintptr_t)(it) & ~(uintptr_t)(BTREE_LEAF_BYTES - 1)))
+
+_Static_assert(sizeof(btree_leaf_t) <= BTREE_LEAF_BYTES, "btree_leaf_t doesn't fit in BTREE_LEAF_BYTES");
+_Static_assert(0 == BTREE_INNER_KEYS % 4, "BTREE_INNER_KEYS must be a multiple of the SIMD width");
+
+/* Nodes a leaf split may need, they are allocated before the tree is modified so that
+   running out of memory leaves it untouched */
+typedef struct btree_reserve {
+    btree_inner_t* inner[BTREE_MAX_HEIGHT];
+    uint32_t       count;
+} btree_reserve_t;
+
+static __always_inline btree_kv_t* __btree_end(const btree_t* _this)
+{
+    return (btree_kv_t*)iterator_end();
+}
+
+static __always_inline btree_kv_t* __btree_rend(const btree_t* _this)
+{
+    return (btree_kv_t*)iterator_rend();
+}
+
+static __always_inline bool __btree_raw(const btree_t* _this)
+{
+    return is_null(_this->ops) || is_null(_this->ops->__lt);
+}
+
+static __always_inline bool __btree_eq(const btree_t* _this, btree_key_t left, btree_key_t right)
+{
+    if (__btree_raw(_this))
+        return left == right;
+    if (!is_null(_this->ops->__cmp))
+        return 0 == _this->ops->__cmp(left, right);
+    return !_this->ops->__lt(left, right) && !_this->ops->__lt(right, left);
+}
+
+/* Count of `keys` lt `key`, or le `key` when `upper`. All BTREE_INNER_KEYS slots are
+   compared and the bits beyond `count` are masked off, which keeps the loop branch-free */
+static __always_inline uint32_t __btree_rank_int(const btree_key_t* keys, uint32_t count, btree_key_t key, bool upper)
+{
+#if defined(__AVX2__)
+    __m256i k = _mm256_set1_epi64x((long long)key), v, c;
+    uint32_t i, mask = 0;
+
+    for (i = 0; i < BTREE_INNER_KEYS; i += 4) {
+        v = _mm256_loadu_si256((const __m256i*)(keys + i));
+        c = upper ? _mm256_cmpgt_epi64(v, k) : _mm256_cmpgt_epi64(k, v);
+        mask |= (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(c)) << i;
+    }
+    mask &= (1U << count) - 1;
+    return upper ? count - __builtin_popcount(mask) : (uint32_t)__builtin_popcount(mask);
+#elif defined(__SSE4_2__)
+    __m128i k = _mm_set1_epi64x((long long)key), v, c;
+    uint32_t i, mask = 0;
+
+    for (i = 0; i < BTREE_INNER_KEYS; i += 2) {
+        v = _mm_loadu_si128((const __m128i*)(keys + i));
+        c = upper ? _mm_cmpgt_epi64(v, k) : _mm_cmpgt_epi64(k, v);
+        mask |= (uint32_t)_mm_movemask_pd(_mm_castsi128_pd(c)) << i;
+    }
+    mask &= (1U << count) - 1;
+    return upper ? count - __builtin_popcount(mask) : (uint32_t)__builtin_popcount(mask);
+#else
+    uint32_t i, ret = 0;
+
+    if (upper) {
+        for (i = 0; i < count; ++i)
+            ret += keys[i] <= key;
+    } else {
+        for (i = 0; i < count; ++i)
+            ret += keys[i] < key;
+    }
+    return ret;
+#endif
+}
+
+/* Index of the child of `n` to descend into */
+static __always_inline uint32_t __btree_inner_rank(const btree_t* _this, const btree_inner_t* n, btree_key_t key, bool upper)
+{
+    uint32_t lo = 0, hi = n->count, mid;
+
+    if (__btree_raw(_this))
+        return __btree_rank_int(n->keys, n->count, key, upper);
+
+    while (lo < hi) {
+        mid = (lo + hi) >> 1;
+        if (upper ? !_this->ops->__lt(key, n->keys[mid]) : _this->ops->__lt(n->keys[mid], key))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Position of the first pair ge `key`, or gt `key` when `upper` */
+static __always_inline uint32_t __btree_leaf_rank(const btree_t* _this, const btree_leaf_t* n, btree_key_t key, bool upper)
+{
+    uint32_t i, ret = 0, lo = 0, hi = n->count, mid;
+
+    if (__btree_raw(_this)) {
+        if (upper) {
+            for (i = 0; i < n->count; ++i)
+                ret += n->kv[i].key <= key;
+        } else {
+            for (i = 0; i < n->count; ++i)
+                ret += n->kv[i].key < key;
+        }
+        return ret;
+    }
+
+    while (lo < hi) {
+        mid = (lo + hi) >> 1;
+        if (upper ? !_this->ops->__lt(key, n->kv[mid].key) : _this->ops->__lt(n->kv[mid].key, key))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static btree_leaf_t* __btree_descend(const btree_t* _this, btree_key_t key, bool upper)
+{
+    void* n = _this->root;
+    uint32_t h;
+
+    for (h = _this->height; h > 1; --h)
+        n = ((btree_inner_t*)n)->child[__btree_inner_rank(_this, n, key, upper)];
+    return n;
+}
+
+static btree_kv_t* __btree_bound(const btree_t* _this, btree_key_t key, bool upper)
+{
+    btree_leaf_t* leaf;
+    uint32_t pos;
+
+    if (_this->size <= 0)
+        return __btree_end(_this);
+
+    leaf = __btree_descend(_this, key, upper);
+    pos  = __btree_leaf_rank(_this, leaf, key, upper);
+    if (pos < leaf->count)
+        return &leaf->kv[pos];
+
+    /* Every key of the following leaves is beyond the separator we stopped at */
+    return is_null(leaf->next) ? __btree_end(_this) : &leaf->next->kv[0];
+}
+
+static __always_inline bool __btree_sep_copy(const btree_t* _this, btree_key_t in, btree_key_t* out)
+{
+    if (is_null(_this->ops) || is_null(_this->ops->copy_key)) {
+        *out = in;
+        return true;
+    }
+    return _this->ops->copy_key(in, out);
+}
+
+/* Separators are copies of keys when the keys are copied, see `__btree_sep_copy` */
+static __always_inline void __btree_sep_free(const btree_t* _this, btree_key_t* key)
+{
+    if (!is_null(_this->ops) && !is_null(_this->ops->copy_key) && !is_null(_this->ops->free_key))
+        _this->ops->free_key(key);
+}
+
+static __always_inline void __btree_kv_free(const btree_t* _this, btree_kv_t* kv)
+{
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+        _this->ops->free_key(&kv->key);
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&kv->value);
+}
+
+static btree_leaf_t* __btree_leaf_alloc(void)
+{
+    void* ret = NULL;
+
+    if (0 != posix_memalign(&ret, BTREE_LEAF_BYTES, sizeof(btree_leaf_t)))
+        return NULL;
+
+    memset(ret, 0, sizeof(btree_leaf_t));
+    return ret;
+}
+
+static __always_inline void __btree_set_parent(void* n, bool leaf, btree_inner_t* parent)
+{
+    if (leaf)
+        ((btree_leaf_t*)n)->parent = parent;
+    else
+        ((btree_inner_t*)n)->parent = parent;
+}
+
+static __always_inline uint32_t __btree_child_index(const btree_inner_t* parent, const void* n)
+{
+    uint32_t i = 0;
+
+    while (parent->child[i] != n)
+        ++i;
+    return i;
+}
+
+static __always_inline void __btree_leaf_unlink(btree_t* _this, btree_leaf_t* leaf)
+{
+    if (is_null(leaf->prev))
+        _this->head = leaf->next;
+    else
+        leaf->prev->next = leaf->next;
+
+    if (is_null(leaf->next))
+        _this->tail = leaf->prev;
+    else
+        leaf->next->prev = leaf->prev;
+}
+
+/* Drop `keys[idx]` and `child[idx + 1]`, the separator itself is left to the caller */
+static __always_inline void __btree_inner_drop(btree_inner_t* n, uint32_t idx)
+{
+    memmove(&n->keys[idx], &n->keys[idx + 1], (n->count - idx - 1) * sizeof(btree_key_t));
+    memmove(&n->child[idx + 1], &n->child[idx + 2], (n->count - idx - 1) * sizeof(void*));
+    n->count--;
+}
+
+/* Link `right` after `left` under their parent with the separator `sep` */
+static void __btree_parent_insert(btree_t* _this, void* left, btree_key_t sep, void* right, bool leaf, btree_reserve_t* rsv)
+{
+    btree_inner_t* p = leaf ? ((btree_leaf_t*)left)->parent : ((btree_inner_t*)left)->parent;
+    btree_inner_t* q;
+    btree_key_t keys[BTREE_INNER_KEYS + 1];
+    void* child[BTREE_INNER_KEYS + 2];
+    uint32_t i, idx;
+
+    if (is_null(p)) {
+        p = rsv->inner[--rsv->count];
+        p->count    = 1;
+        p->keys[0]  = sep;
+        p->child[0] = left;
+        p->child[1] = right;
+        p->parent   = NULL;
+        __btree_set_parent(left, leaf, p);
+        __btree_set_parent(right, leaf, p);
+        _this->root = p;
+        _this->height++;
+        return;
+    }
+
+    idx = __btree_child_index(p, left);
+    if (p->count < BTREE_INNER_KEYS) {
+        memmove(&p->keys[idx + 1], &p->keys[idx], (p->count - idx) * sizeof(btree_key_t));
+        memmove(&p->child[idx + 2], &p->child[idx + 1], (p->count - idx) * sizeof(void*));
+        p->keys[idx] = sep;
+        p->child[idx + 1] = right;
+        p->count++;
+        __btree_set_parent(right, leaf, p);
+        return;
+    }
+
+    /* `p` is full: of the BTREE_INNER_KEYS + 1 keys the lower half stays,
+       the middle one moves up and the upper half goes to `q` */
+    memcpy(keys, p->keys, idx * sizeof(btree_key_t));
+    keys[idx] = sep;
+    memcpy(keys + idx + 1, p->keys + idx, (BTREE_INNER_KEYS - idx) * sizeof(btree_key_t));
+    memcpy(child, p->child, (idx + 1) * sizeof(void*));
+    child[idx + 1] = right;
+    memcpy(child + idx + 2, p->child + idx + 1, (BTREE_INNER_KEYS - idx) * sizeof(void*));
+
+    q = rsv->inner[--rsv->count];
+    p->count = BTREE_INNER_MIN;
+    memcpy(p->keys, keys, BTREE_INNER_MIN * sizeof(btree_key_t));
+    memcpy(p->child, child, (BTREE_INNER_MIN + 1) * sizeof(void*));
+    q->count = BTREE_INNER_KEYS - BTREE_INNER_MIN;
+    memcpy(q->keys, keys + BTREE_INNER_MIN + 1, q->count * sizeof(btree_key_t));
+    memcpy(q->child, child + BTREE_INNER_MIN + 1, (q->count + 1) * sizeof(void*));
+
+    for (i = 0; i <= q->count; ++i)
+        __btree_set_parent(q->child[i], leaf, q);
+    if (idx + 1 <= BTREE_INNER_MIN)
+        __btree_set_parent(right, leaf, p);
+
+    __btree_parent_insert(_this, p, keys[BTREE_INNER_MIN], q, false, rsv);
+}
+
+/* Insert the pair, whose key and value have already been copied, at `pos` of `leaf` */
+static btree_kv_t* __btree_insert_at(btree_t* _this, btree_leaf_t* leaf, uint32_t pos, btree_key_t key, btree_value_t value)
+{
+    const uint32_t half = BTREE_LEAF_MIN + 1;
+    btree_kv_t tmp[BTREE_LEAF_SLOTS + 1];
+    btree_reserve_t rsv = { .count = 0, };
+    btree_leaf_t* right;
+    btree_inner_t* p;
+    btree_key_t sep;
+    uint32_t need = 0;
+
+    if (leaf->count < BTREE_LEAF_SLOTS) {
+        memmove(&leaf->kv[pos + 1], &leaf->kv[pos], (leaf->count - pos) * sizeof(btree_kv_t));
+        leaf->kv[pos].key   = key;
+        leaf->kv[pos].value = value;
+        leaf->count++;
+        _this->size++;
+        return &leaf->kv[pos];
+    }
+
+    for (p = leaf->parent; !is_null(p) && BTREE_INNER_KEYS == p->count; p = p->parent)
+        need++;
+    if (is_null(p))
+        need++; /* A new root */
+
+    right = __btree_leaf_alloc();
+    if (is_null(right))
+        return NULL;
+
+    for (; rsv.count < need; rsv.count++) {
+        rsv.inner[rsv.count] = (btree_inner_t*)p_calloc(1, sizeof(btree_inner_t));
+        if (is_null(rsv.inner[rsv.count]))
+            goto err;
+    }
+
+    /* The first pair of `right` once the new pair is in place */
+    sep = pos < half ? leaf->kv[half - 1].key : pos == half ? key : leaf->kv[half].key;
+    if (!__btree_sep_copy(_this, sep, &sep))
+        goto err;
+
+    memcpy(tmp, leaf->kv, pos * sizeof(btree_kv_t));
+    tmp[pos].key   = key;
+    tmp[pos].value = value;
+    memcpy(tmp + pos + 1, leaf->kv + pos, (BTREE_LEAF_SLOTS - pos) * sizeof(btree_kv_t));
+
+    leaf->count  = half;
+    right->count = BTREE_LEAF_SLOTS + 1 - half;
+    memcpy(leaf->kv, tmp, leaf->count * sizeof(btree_kv_t));
+    memcpy(right->kv, tmp + half, right->count * sizeof(btree_kv_t));
+
+    right->prev = leaf;
+    right->next = leaf->next;
+    if (is_null(leaf->next))
+        _this->tail = right;
+    else
+        leaf->next->prev = right;
+    leaf->next = right;
+
+    _this->size++;
+    __btree_parent_insert(_this, leaf, sep, right, true, &rsv);
+    return pos < half ? &leaf->kv[pos] : &right->kv[pos - half];
+
+err:
+    while (rsv.count > 0)
+        p_free(rsv.inner[--rsv.count]);
+    p_free(right);
+    return NULL;
+}
+
+/* Return NULL if the key exists (unique mode) or memory runs out */
+static btree_kv_t* __btree_insert(btree_t* _this, btree_key_t key, btree_value_t value)
+{
+    btree_leaf_t* leaf;
+    btree_kv_t* t;
+    uint32_t pos;
+
+    if (is_null(_this->root)) {
+        leaf = __btree_leaf_alloc();
+        if (is_null(leaf))
+            return NULL;
+
+        _this->root   = leaf;
+        _this->head   = leaf;
+        _this->tail   = leaf;
+        _this->height = 1;
+    }
+
+    /* Equal keys are appended after the existing ones, like `multimap` */
+    if (_this->config.c.b_multi) {
+        leaf = __btree_descend(_this, key, true);
+        pos  = __btree_leaf_rank(_this, leaf, key, true);
+        return __btree_insert_at(_this, leaf, pos, key, value);
+    }
+
+    leaf = __btree_descend(_this, key, false);
+    pos  = __btree_leaf_rank(_this, leaf, key, false);
+    t = pos < leaf->count ? &leaf->kv[pos] : is_null(leaf->next) ? NULL : &leaf->next->kv[0];
+    if (!is_null(t) && __btree_eq(_this, t->key, key))
+        return NULL;
+    return __btree_insert_at(_this, leaf, pos, key, value);
+}
+
+/* Restore the fill of inner node `n` after it lost a key */
+static void __btree_inner_fix(btree_t* _this, btree_inner_t* n, bool leaf)
+{
+    btree_inner_t* p, * s;
+    uint32_t i, j;
+
+    for (;;) {
+        p = n->parent;
+        if (is_null(p)) {
+            if (0 == n->count) {
+                _this->root = n->child[0];
+                __btree_set_parent(_this->root, leaf, NULL);
+                _this->height--;
+                p_free(n);
+            }
+            return;
+        }
+
+        if (n->count >= BTREE_INNER_MIN)
+            return;
+
+        i = __btree_child_index(p, n);
+
+        /* Borrow through the parent from the left sibling */
+        if (i > 0 && ((btree_inner_t*)p->child[i - 1])->count > BTREE_INNER_MIN) {
+            s = p->child[i - 1];
+            memmove(&n->keys[1], &n->keys[0], n->count * sizeof(btree_key_t));
+            memmove(&n->child[1], &n->child[0], (n->count + 1) * sizeof(void*));
+            n->keys[0]  = p->keys[i - 1];
+            n->child[0] = s->child[s->count];
+            __btree_set_parent(n->child[0], leaf, n);
+            p->keys[i - 1] = s->keys[s->count - 1];
+            s->count--;
+            n->count++;
+            return;
+        }
+
+        /* Borrow through the parent from the right sibling */
+        if (i < p->count && ((btree_inner_t*)p->child[i + 1])->count > BTREE_INNER_MIN) {
+            s = p->child[i + 1];
+            n->keys[n->count]      = p->keys[i];
+            n->child[n->count + 1] = s->child[0];
+            __btree_set_parent(n->child[n->count + 1], leaf, n);
+            n->count++;
+            p->keys[i] = s->keys[0];
+            memmove(&s->keys[0], &s->keys[1], (s->count - 1) * sizeof(btree_key_t));
+            memmove(&s->child[0], &s->child[1], s->count * sizeof(void*));
+            s->count--;
+            return;
+        }
+
+        /* Merge the right one of the pair into the left one, the separator comes down */
+        if (i > 0) {
+            s = p->child[i - 1];
+        } else {
+            s = n;
+            n = p->child[1];
+            i = 1;
+        }
+
+        s->keys[s->count] = p->keys[i - 1];
+        memcpy(&s->keys[s->count + 1], n->keys, n->count * sizeof(btree_key_t));
+        memcpy(&s->child[s->count + 1], n->child, (n->count + 1) * sizeof(void*));
+        for (j = 0; j <= n->count; ++j)
+            __btree_set_parent(n->child[j], leaf, s);
+        s->count += n->count + 1;
+
+        __btree_inner_drop(p, i - 1);
+        p_free(n);
+
+        n = p;
+        leaf = false;
+    }
+}
+
+/* Erase the pair at `idx` of `leaf` and return the pair that followed it */
+static btree_kv_t* __btree_erase(btree_t* _this, btree_leaf_t* leaf, uint32_t idx)
+{
+    btree_leaf_t* s;
+    btree_inner_t* p;
+    btree_key_t sep;
+    uint32_t i;
+
+    __btree_kv_free(_this, &leaf->kv[idx]);
+    memmove(&leaf->kv[idx], &leaf->kv[idx + 1], (leaf->count - idx - 1) * sizeof(btree_kv_t));
+    leaf->count--;
+    _this->size--;
+
+    if (1 == _this->height) {
+        if (leaf->count > 0)
+            goto out;
+
+        p_free(leaf);
+        _this->root   = NULL;
+        _this->head   = NULL;
+        _this->tail   = NULL;
+        _this->height = 0;
+        return __btree_end(_this);
+    }
+
+    if (leaf->count >= BTREE_LEAF_MIN)
+        goto out;
+
+    p = leaf->parent;
+    i = __btree_child_index(p, leaf);
+
+    /* Borrow the last pair of the left sibling, which becomes the separator */
+    s = i > 0 ? p->child[i - 1] : NULL;
+    if (!is_null(s) && s->count > BTREE_LEAF_MIN && __btree_sep_copy(_this, s->kv[s->count - 1].key, &sep)) {
+        memmove(&leaf->kv[1], &leaf->kv[0], leaf->count * sizeof(btree_kv_t));
+        leaf->kv[0] = s->kv[--s->count];
+        leaf->count++;
+        __btree_sep_free(_this, &p->keys[i - 1]);
+        p->keys[i - 1] = sep;
+        idx++;
+        goto out;
+    }
+
+    /* Borrow the first pair of the right sibling, its new first pair becomes the separator */
+    s = i < p->count ? p->child[i + 1] : NULL;
+    if (!is_null(s) && s->count > BTREE_LEAF_MIN && __btree_sep_copy(_this, s->kv[1].key, &sep)) {
+        leaf->kv[leaf->count++] = s->kv[0];
+        memmove(&s->kv[0], &s->kv[1], (s->count - 1) * sizeof(btree_kv_t));
+        s->count--;
+        __btree_sep_free(_this, &p->keys[i]);
+        p->keys[i] = sep;
+        goto out;
+    }
+
+    /* Merge, when copying a separator failed a sibling may be too full and `leaf` is left under-filled */
+    if (i > 0 && ((btree_leaf_t*)p->child[i - 1])->count + leaf->count <= BTREE_LEAF_SLOTS) {
+        s = p->child[i - 1];
+        memcpy(&s->kv[s->count], leaf->kv, leaf->count * sizeof(btree_kv_t));
+        idx += s->count;
+        s->count += leaf->count;
+        __btree_leaf_unlink(_this, leaf);
+        p_free(leaf);
+        leaf = s;
+        i--;
+    } else if (i < p->count && ((btree_leaf_t*)p->child[i + 1])->count + leaf->count <= BTREE_LEAF_SLOTS) {
+        s = p->child[i + 1];
+        memcpy(&leaf->kv[leaf->count], s->kv, s->count * sizeof(btree_kv_t));
+        leaf->count += s->count;
+        __btree_leaf_unlink(_this, s);
+        p_free(s);
+    } else {
+        goto out;
+    }
+
+    __btree_sep_free(_this, &p->keys[i]);
+    __btree_inner_drop(p, i);
+    __btree_inner_fix(_this, p, true);
+
+out:
+    if (idx < leaf->count)
+        return &leaf->kv[idx];
+    return is_null(leaf->next) ? __btree_end(_this) : &leaf->next->kv[0];
+}
+
+static void __btree_free_node(btree_t* _this, void* node, uint32_t level)
+{
+    btree_inner_t* n = node;
+    btree_leaf_t* l = node;
+    uint32_t i;
+
+    if (1 == level) {
+        for (i = 0; i < l->count; ++i)
+            __btree_kv_free(_this, &l->kv[i]);
+        p_free(l);
+        return;
+    }
+
+    for (i = 0; i <= n->count; ++i)
+        __btree_free_node(_this, n->child[i], level - 1);
+    for (i = 0; i < n->count; ++i)
+        __btree_sep_free(_this, &n->keys[i]);
+    p_free(n);
+}
+
+/* Locate the leaf and the index of an iterator, NULL if it isn't a live pair */
+static __always_inline btree_leaf_t* __btree_locate(const btree_kv_t* kv, uint32_t* idx)
+{
+    btree_leaf_t* leaf = btree_leaf_of(kv);
+
+    *idx = kv - leaf->kv;
+    return *idx < leaf->count ? leaf : NULL;
+}
+
+static __always_inline btree_size_t _btree_size(const btree_t* _this)
+{
+    if (unlikely(is_null(_this)))
+        return -1;
+    return _this->size;
+}
+
+static btree_kv_t* btree_find(const btree_t* _this, btree_key_t key);
+
+static btree_count_t btree_count(const btree_t* _this, btree_key_t key)
+{
+    btree_count_t ret = 0;
+    btree_kv_t* t = btree_find(_this, key);
+    btree_leaf_t* leaf;
+    uint32_t idx;
+
+    if (is_null(t))
+        return -1;
+
+    if (__btree_end(_this) == t || !_this->config.c.b_multi)
+        return __btree_end(_this) == t ? 0 : 1;
+
+    for (leaf = __btree_locate(t, &idx); !is_null(leaf); leaf = leaf->next, idx = 0) {
+        for (; idx < leaf->count; ++idx, ++ret) {
+            if (!__btree_eq(_this, leaf->kv[idx].key, key))
+                return ret;
+        }
+    }
+    return ret;
+}
+
+static btree_kv_t* __btree_first(const btree_t* _this)
+{
+    return _this->size <= 0 ? NULL : &_this->head->kv[0];
+}
+
+static btree_kv_t* __btree_last(const btree_t* _this)
+{
+    return _this->size <= 0 ? NULL : &_this->tail->kv[_this->tail->count - 1];
+}
+
+/* The pair after `kv`, `past` once `kv` is the last one, NULL if `kv` isn't a live pair */
+static btree_kv_t* __btree_next(const btree_kv_t* kv, btree_kv_t* past)
+{
+    btree_leaf_t* leaf;
+    uint32_t idx;
+
+    leaf = __btree_locate(kv, &idx);
+    if (unlikely(is_null(leaf)))
+        return NULL;
+
+    if (idx + 1 < leaf->count)
+        return &leaf->kv[idx + 1];
+    return is_null(leaf->next) ? past : &leaf->next->kv[0];
+}
+
+/* The pair before `kv`, `past` once `kv` is the first one, NULL if `kv` isn't a live pair */
+static btree_kv_t* __btree_prev(const btree_kv_t* kv, btree_kv_t* past)
+{
+    btree_leaf_t* leaf;
+    uint32_t idx;
+
+    leaf = __btree_locate(kv, &idx);
+    if (unlikely(is_null(leaf)))
+        return NULL;
+
+    if (idx > 0)
+        return &leaf->kv[idx - 1];
+    return is_null(leaf->prev) ? past : &leaf->prev->kv[leaf->prev->count - 1];
+}
+
+static btree_kv_t* _btree_begin(const btree_t* _this)
+{
+    btree_kv_t* t;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    t = __btree_first(_this);
+    return is_null(t) ? __btree_end(_this) : t;
+}
+
+static btree_kv_t* _btree_next(const btree_t* _this, const btree_kv_t* kv)
+{
+    if (unlikely(is_null(_this) || is_null(kv)))
+        return NULL;
+
+    /* The input parameter is `iterator`, and there's no need
+       to check whether it equals `rend` */
+    if (_this->size <= 0 || __btree_end(_this) == kv)
+        return __btree_end(_this);
+    return __btree_next(kv, __btree_end(_this));
+}
+
+static btree_kv_t* _btree_prev(const btree_t* _this, const btree_kv_t* kv)
+{
+    if (unlikely(is_null(_this) || is_null(kv)))
+        return NULL;
+
+    if (_this->size <= 0)
+        return __btree_end(_this);
+
+    if (__btree_end(_this) == kv)
+        return __btree_last(_this);
+    return __btree_prev(kv, __btree_end(_this));
+}
+
+static btree_kv_t* _btree_rbegin(const btree_t* _this)
+{
+    btree_kv_t* t;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    t = __btree_last(_this);
+    return is_null(t) ? __btree_rend(_this) : t;
+}
+
+static btree_kv_t* _btree_rnext(const btree_t* _this, const btree_kv_t* kv)
+{
+    if (unlikely(is_null(_this) || is_null(kv)))
+        return NULL;
+
+    /* The input parameter is `reverse_iterator`, and there's no need
+       to check whether it equals `end` */
+    if (_this->size <= 0 || __btree_rend(_this) == kv)
+        return __btree_rend(_this);
+    return __btree_prev(kv, __btree_rend(_this));
+}
+
+static btree_kv_t* _btree_rprev(const btree_t* _this, const btree_kv_t* kv)
+{
+    if (unlikely(is_null(_this) || is_null(kv)))
+        return NULL;
+
+    if (_this->size <= 0)
+        return __btree_rend(_this);
+
+    if (__btree_rend(_this) == kv)
+        return __btree_first(_this);
+    return __btree_next(kv, __btree_rend(_this));
+}
+
+static btree_kv_t* btree_find(const btree_t* _this, btree_key_t key)
+{
+    btree_kv_t* t;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return NULL;
+
+    t = __btree_bound(_this, key, false);
+    return __btree_end(_this) == t || __btree_eq(_this, t->key, key) ? t : __btree_end(_this);
+}
+
+static btree_kv_t* btree_lower_bound(const btree_t* _this, btree_key_t key)
+{
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return NULL;
+
+    return __btree_bound(_this, key, false);
+}
+
+static btree_kv_t* btree_upper_bound(const btree_t* _this, btree_key_t key)
+{
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return NULL;
+
+    return __btree_bound(_this, key, true);
+}
+
+static btree_kv_t* btree_insert(btree_t* _this, btree_key_t key, btree_value_t value)
+{
+    btree_kv_t kv, * ret;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return NULL;
+
+    kv.key   = key;
+    kv.value = value;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->copy_key) && !_this->ops->copy_key(key, &kv.key))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->copy_value) && !_this->ops->copy_value(value, &kv.value)) {
+        if (!is_null(_this->ops->free_key))
+            _this->ops->free_key(&kv.key);
+        return NULL;
+    }
+
+    ret = __btree_insert(_this, kv.key, kv.value);
+    if (is_null(ret))
+        __btree_kv_free(_this, &kv);
+    return ret;
+}
+
+static btree_kv_t* btree_insert_replace(btree_t* _this, btree_key_t key, btree_value_t value)
+{
+    btree_value_t tvalue;
+    btree_kv_t* t;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
+        return NULL;
+
+    t = btree_find(_this, key);
+    if (is_null(t))
+        return NULL;
+
+    if (__btree_end(_this) == t)
+        return btree_insert(_this, key, value);
+
+    tvalue = t->value;
+    if (is_null(_this->ops) || is_null(_this->ops->copy_value)) {
+        t->value = value;
+    } else {
+        if (!_this->ops->copy_value(value, &t->value)) {
+            t->value = tvalue;
+            return NULL;
+        }
+
+        if (!is_null(_this->ops->free_value))
+            _this->ops->free_value(&tvalue);
+    }
+    return t;
+}
+
+static btree_kv_t* btree_erase(btree_t* _this, btree_kv_t* pos)
+{
+    btree_leaf_t* leaf;
+    uint32_t idx;
+
+    if (unlikely(is_null(_this) || is_null(pos)))
+        return NULL;
+
+    /* The input parameter is `iterator`, and there's no need
+       to check whether it equals `rend` */
+    if (_this->size <= 0 || __btree_end(_this) == pos)
+        return NULL;
+
+    leaf = __btree_locate(pos, &idx);
+    if (unlikely(is_null(leaf)))
+        return NULL;
+    return __btree_erase(_this, leaf, idx);
+}
+
+static btree_size_t btree_remove(btree_t* _this, btree_key_t key)
+{
+    btree_size_t ret = 0;
+    btree_kv_t* t;
+
+    t = btree_find(_this, key);
+    if (is_null(t))
+        return -1;
+
+    while (__btree_end(_this) != t && __btree_eq(_this, t->key, key)) {
+        t = btree_erase(_this, t);
+        ret++;
+
+        if (!_this->config.c.b_multi)
+            break;
+    }
+    return ret;
+}
+
+static btree_size_t btree_remove_if(btree_t* _this, remove_if_condition_kv cond)
+{
+    btree_size_t ret = 0;
+    btree_kv_t* t;
+
+    if (unlikely(is_null(_this) || is_null(cond)))
+        return -1;
+
+    for (t = _btree_begin(_this); __btree_end(_this) != t; ) {
+        if (!cond(t->key, t->value)) {
+            t = _btree_next(_this, t);
+            continue;
+        }
+
+        t = btree_erase(_this, t);
+        ret++;
+    }
+    return ret;
+}
+
+static btree_size_t btree_remove_if_v(btree_t* _this, remove_if_condition_v cond)
+{
+    btree_size_t ret = 0;
+    btree_kv_t* t;
+
+    if (unlikely(is_null(_this) || is_null(cond)))
+        return -1;
+
+    for (t = _btree_begin(_this); __btree_end(_this) != t; ) {
+        if (!cond(t->key)) {
+            t = _btree_next(_this, t);
+            continue;
+        }
+
+        t = btree_erase(_this, t);
+        ret++;
+    }
+    return ret;
+}
+
+static btree_kv_t* btree_insert_v(btree_t* _this, btree_key_t value)
+{
+    return btree_insert(_this, value, 0);
+}
+
+static btree_size_t btree_clear(btree_t* _this)
+{
+    btree_size_t ret;
+
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    ret = _this->size;
+    if (!is_null(_this->root))
+        __btree_free_node(_this, _this->root, _this->height);
+
+    _this->root   = NULL;
+    _this->head   = NULL;
+    _this->tail   = NULL;
+    _this->height = 0;
+    _this->size   = 0;
+    return ret;
+}
+
+/* __always_inline */ inline void __btree_init(btree_t* btree, const class_map_ops_t* ops, bool multi)
+{
+    btree->ops = ops;
+    memset(&btree->ops_set, 0, sizeof(btree->ops_set));
+    btree->root   = NULL;
+    btree->head   = NULL;
+    btree->tail   = NULL;
+    btree->height = 0;
+    btree->config.d = 0;
+    btree->config.c.b_multi = multi;
+    btree->size   = 0;
+}
+
+/* __always_inline */ inline void __btree_init_set(btree_t* btree, const class_set_ops_t* ops, bool multi)
+{
+    __btree_init(btree, NULL, multi);
+    btree->config.c.b_set = 1;
+
+    if (is_null(ops))
+        return;
+
+    btree->ops_set.valid_key = ops->valid_value;
+    btree->ops_set.__lt      = ops->__lt_value;
+    btree->ops_set.__cmp     = ops->__cmp_value;
+    btree->ops_set.copy_key  = ops->copy_value;
+    btree->ops_set.free_key  = ops->free_value;
+    btree->ops = &btree->ops_set;
+}
+
+/* __always_inline */ inline void __btree_deinit(btree_t* btree)
+{
+    btree_clear(btree);
+    __btree_init(btree, NULL, false);
+}
+
+typedef map_iterator_t* (*bm_fp_end)(const btree_t* _this);
+typedef map_iterator_t* (*bm_fp_begin)(const btree_t* _this);
+typedef map_iterator_t* (*bm_fp_next)(const btree_t* _this, const map_iterator_t* iterator);
+typedef map_iterator_t* (*bm_fp_prev)(const btree_t* _this, const map_iterator_t* iterator);
+typedef map_r_iterator_t* (*bm_fp_rend)(const btree_t* _this);
+typedef map_r_iterator_t* (*bm_fp_rbegin)(const btree_t* _this);
+typedef map_r_iterator_t* (*bm_fp_rnext)(const btree_t* _this, const map_r_iterator_t* r_iterator);
+typedef map_r_iterator_t* (*bm_fp_rprev)(const btree_t* _this, const map_r_iterator_t* r_iterator);
+typedef map_iterator_t* (*bm_fp_find)(const btree_t* _this, btree_key_t key);
+typedef map_iterator_t* (*bm_fp_insert)(btree_t* _this, btree_key_t key, btree_value_t value);
+typedef map_iterator_t* (*bm_fp_erase)(btree_t* _this, map_iterator_t* iterator);
+
+typedef set_iterator_t* (*bs_fp_end)(const btree_t* _this);
+typedef set_iterator_t* (*bs_fp_begin)(const btree_t* _this);
+typedef set_iterator_t* (*bs_fp_next)(const btree_t* _this, const set_iterator_t* iterator);
+typedef set_iterator_t* (*bs_fp_prev)(const btree_t* _this, const set_iterator_t* iterator);
+typedef set_r_iterator_t* (*bs_fp_rend)(const btree_t* _this);
+typedef set_r_iterator_t* (*bs_fp_rbegin)(const btree_t* _this);
+typedef set_r_iterator_t* (*bs_fp_rnext)(const btree_t* _this, const set_r_iterator_t* r_iterator);
+typedef set_r_iterator_t* (*bs_fp_rprev)(const btree_t* _this, const set_r_iterator_t* r_iterator);
+typedef set_iterator_t* (*bs_fp_find)(const btree_t* _this, btree_key_t value);
+typedef set_iterator_t* (*bs_fp_insert)(btree_t* _this, btree_key_t value);
+typedef set_iterator_t* (*bs_fp_erase)(btree_t* _this, set_iterator_t* iterator);
+
+#define BTREE_CLASS_MAP(_insert_replace) {                   \
+        .size           = _btree_size,                       \
+        .count          = btree_count,                       \
+        .end            = (bm_fp_end)__btree_end,            \
+        .begin          = (bm_fp_begin)_btree_begin,         \
+        .next           = (bm_fp_next)_btree_next,           \
+        .prev           = (bm_fp_prev)_btree_prev,           \
+        .rend           = (bm_fp_rend)__btree_rend,          \
+        .rbegin         = (bm_fp_rbegin)_btree_rbegin,       \
+        .rnext          = (bm_fp_rnext)_btree_rnext,         \
+        .rprev          = (bm_fp_rprev)_btree_rprev,         \
+        .find           = (bm_fp_find)btree_find,            \
+        .lower_bound    = (bm_fp_find)btree_lower_bound,     \
+        .upper_bound    = (bm_fp_find)btree_upper_bound,     \
+        .insert         = (bm_fp_insert)btree_insert,        \
+        .insert_replace = (bm_fp_insert)(_insert_replace),   \
+        .erase          = (bm_fp_erase)btree_erase,          \
+        .remove         = btree_remove,                      \
+        .remove_if      = btree_remove_if,                   \
+        .clear          = btree_clear,                       \
+    }
+
+#define BTREE_CLASS_SET {                                    \
+        .size           = _btree_size,                       \
+        .count          = btree_count,                       \
+        .end            = (bs_fp_end)__btree_end,            \
+        .begin          = (bs_fp_begin)_btree_begin,         \
+        .next           = (bs_fp_next)_btree_next,           \
+        .prev           = (bs_fp_prev)_btree_prev,           \
+        .rend           = (bs_fp_rend)__btree_rend,          \
+        .rbegin         = (bs_fp_rbegin)_btree_rbegin,       \
+        .rnext          = (bs_fp_rnext)_btree_rnext,         \
+        .rprev          = (bs_fp_rprev)_btree_rprev,         \
+        .find           = (bs_fp_find)btree_find,            \
+        .lower_bound    = (bs_fp_find)btree_lower_bound,     \
+        .upper_bound    = (bs_fp_find)btree_upper_bound,     \
+        .insert         = (bs_fp_insert)btree_insert_v,      \
+        .erase          = (bs_fp_erase)btree_erase,          \
+        .remove         = btree_remove,                      \
+        .remove_if      = btree_remove_if_v,                 \
+        .clear          = btree_clear,                       \
+    }
+
+const class_btree_map_t* class_btree_map_ins(void)
+{
+    static const class_btree_map_t ins = BTREE_CLASS_MAP(btree_insert_replace);
+    return &ins;
+}
+
+const class_btree_map_t* class_btree_multimap_ins(void)
+{
+    static const class_btree_map_t ins = BTREE_CLASS_MAP(NULL);
+    return &ins;
+}
+
+const class_btree_set_t* class_btree_set_ins(void)
+{
+    static const class_btree_set_t ins = BTREE_CLASS_SET;
+    return &ins;
+}
+
+const class_btree_set_t* class_btree_multiset_ins(void)
+{
+    static const class_btree_set_t ins = BTREE_CLASS_SET;
+    return &ins;
+}
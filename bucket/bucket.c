@@ -478,6 +478,7 @@ static bucket_node_t* __bucket_rb_find(const bucket_t* _this, const class_bucket
 {
     struct rb_node* n = _this->ds.rb.rb_node;
     bucket_node_t* t = NULL;
+    int cmp = 0;
 
     if (is_null(ops) || is_null(ops->__lt)) {
         while (!is_null(n)) {
@@ -490,6 +491,18 @@ static bucket_node_t* __bucket_rb_find(const bucket_t* _this, const class_bucket
             else
                 return t;
         }
+    } else if (!is_null(ops->__cmp)) {
+        while (!is_null(n)) {
+            t = bucket_rb_entry(n);
+            cmp = ops->__cmp(key, t->key);
+
+            if (cmp < 0)
+                n = n->rb_left;
+            else if (cmp > 0)
+                n = n->rb_right;
+            else
+                return t;
+        }
     } else {
         while (!is_null(n)) {
             t = bucket_rb_entry(n);
@@ -516,6 +529,11 @@ static bucket_node_t* __bucket_hl_find(const bucket_t* _this, const class_bucket
             if (key == t->key)
                 return t;
         }
+    } else if (!is_null(ops->__cmp)) {
+        hlist_for_each_entry(t, thl, &_this->ds.hl, ds_node.hl_node) {
+            if (0 == ops->__cmp(key, t->key))
+                return t;
+        }
     } else {
         hlist_for_each_entry(t, thl, &_this->ds.hl, ds_node.hl_node) {
             if (!ops->__lt(key, t->key) && !ops->__lt(t->key, key))
@@ -578,6 +596,7 @@ static bucket_node_t* __bucket_rb_insert(bucket_t* _this, const class_bucket_ops
     struct rb_node** n = &_this->ds.rb.rb_node;
     struct rb_node* parent = NULL;
     bucket_node_t* t = NULL;
+    int cmp = 0;
 
     if (is_null(ops) || is_null(ops->__lt)) {
         while (!is_null(*n)) {
@@ -591,6 +610,19 @@ static bucket_node_t* __bucket_rb_insert(bucket_t* _this, const class_bucket_ops
             else
                 return t;
         }
+    } else if (!is_null(ops->__cmp)) {
+        while (!is_null(*n)) {
+            parent = *n;
+            t = bucket_rb_entry(parent);
+            cmp = ops->__cmp(node->key, t->key);
+
+            if (cmp < 0)
+                n = &parent->rb_left;
+            else if (cmp > 0)
+                n = &parent->rb_right;
+            else
+                return t;
+        }
     } else {
         while (!is_null(*n)) {
             parent = *n;
@@ -1138,19 +1170,33 @@ static /* __always_inline */ inline bucket_node_t* bucket_pop(bucket_t* _this, b
 
 
 /* Clear */
+/* Postorder, so nodes are freed without `rb_erase` keeping the tree balanced all along */
 static bucket_size_t bucket_rb_clear(bucket_t* _this, const class_bucket_ops_t* ops)
 {
     bucket_size_t ret = 0;
     bucket_node_t* t = NULL;
+    struct rb_node* n = NULL;
+    struct rb_node* next = NULL;
 
     if (unlikely(is_null(_this)))
         return -1;
 
-    for (t = __bucket_rb_begin(_this); __bucket_end(_this) != t; ) {
-        t = bucket_rb_erase(_this, ops, t);
+    for (n = rb_first_postorder(&_this->ds.rb); !is_null(n); n = next) {
+        next = rb_next_postorder(n);
+        t = bucket_rb_entry(n);
+
+        if (!is_null(ops) && !is_null(ops->free_key))
+            ops->free_key(&t->key);
+
+        if (!is_null(ops) && !is_null(ops->free_value))
+            ops->free_value(&t->value);
+
+        p_free(t);
         ret++;
     }
 
+    _this->ds.rb = RB_ROOT;
+    _this->size -= ret;
     return ret;
 }
 
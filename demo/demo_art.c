@@ -0,0 +1,91 @@
+/*
+  Adaptive Radix Tree Demos
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <art/art.h>
+#include <string.h>
+#include <_log.h>
+#include <operations/ds_ops_string.h>
+
+#define TAG "[demo_art]"
+
+#define _tok(x)  ((art_key_t)(x))
+#define _from(x) ((x) ? (x) : "null string")
+
+static class_map_ops_t demo_string_ops = {
+    .valid_key = ds_ops_valid_key_default_string_max_128,
+    .copy_key  = ds_ops_copy_data_default_string,
+    .free_key  = ds_ops_free_data_default_string,
+};
+
+static bool demo_print(art_key_t key, art_value_t value, void* arg)
+{
+    pr_test("(%s, %zd)", _from((const char*)key), value);
+    return true;
+}
+
+static void demo_about_integer(void)
+{
+    art_t demo = ART_INIT(&demo);
+    map_iterator_t* it = NULL;
+
+    for (int i = -500; i < 500; ++i)
+        cart->insert(&demo, i * 4, i);                  // Keys of [ -2000, 1996 ] step 4, negatives first
+
+    cart->insert_replace(&demo, 0, -1);                 // (0, -1)
+    cart->remove(&demo, -2000);                         // [ (-1996, -499), ..., (1996, 499) ]
+
+    it = cart->lower_bound(&demo, 1990);
+    for (; cart->end(&demo) != it; it = cart->next(&demo, it))
+        pr_test("(%zd, %zd)", it->key, it->value);      // [ (1992, 498), (1996, 499) ]
+    pr_test("");
+
+    it = cart->upper_bound(&demo, -1);
+    pr_test("(%zd, %zd)", it->key, it->value);          // (0, -1)
+    pr_test("%zd", cart->size(&demo));                  // 999
+    pr_test("");
+
+    ART_DEINIT(&demo);
+}
+
+static void demo_about_string(void)
+{
+    art_t demo = ART_INIT_STRING(&demo, &demo_string_ops);
+
+    cart->insert(&demo, _tok("jerry"), 1);
+    cart->insert(&demo, _tok("jenny"), 2);
+    cart->insert(&demo, _tok("jen"), 3);
+    cart->insert(&demo, _tok("tom"), 4);
+    cart->insert(&demo, _tok("jen"), 5);                // exists, return NULL
+
+    for (map_iterator_t* it = cart->begin(&demo); cart->end(&demo) != it; it = cart->next(&demo, it))
+        pr_test("(%s, %zd)", _from(it->skey), it->value); // [ (jen, 3), (jenny, 2), (jerry, 1), (tom, 4) ]
+    pr_test("");
+
+    cart->for_each_prefix(&demo, "jen", demo_print, NULL); // [ (jen, 3), (jenny, 2) ]
+    pr_test("");
+
+    ART_DEINIT(&demo);
+}
+
+int main(void)
+{
+    demo_about_integer();
+    demo_about_string();
+    return 0;
+}
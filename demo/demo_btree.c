@@ -0,0 +1,101 @@
+/*
+  B+tree Demos
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <btree/btree.h>
+#include <string.h>
+#include <_log.h>
+#include <operations/ds_ops_string.h>
+
+#define TAG "[demo_btree]"
+
+#define _tok(x)  ((btree_key_t)(x))
+#define _from(x) ((x) ? (x) : "null string")
+
+static class_set_ops_t demo_set_ops = {
+    .valid_value = ds_ops_valid_key_default_string_max_128,
+    .__lt_value  = __ds_ops_lt_default_string,
+    .__cmp_value = __ds_ops_cmp_default_string,
+    .copy_value  = ds_ops_copy_data_default_string,
+    .free_value  = ds_ops_free_data_default_string,
+};
+
+static void demo_about_map(void)
+{
+    btree_t demo = BTREE_MAP_INIT(&demo);
+    map_iterator_t* it = NULL;
+
+    for (int i = 1000; i > 0; --i)
+        cbtree_map->insert(&demo, i, i * 10);           // Enough pairs for a few levels of inner nodes
+
+    cbtree_map->insert_replace(&demo, 500, -1);         // (500, -1)
+    cbtree_map->remove(&demo, 1);                       // [ (2, 20), (3, 30), ..., (1000, 10000) ]
+
+    it = cbtree_map->lower_bound(&demo, 998);
+    for (; cbtree_map->end(&demo) != it; it = cbtree_map->next(&demo, it))
+        pr_test("(%zd, %zd)", it->key, it->value);      // [ (998, 9980), (999, 9990), (1000, 10000) ]
+    pr_test("");
+
+    it = cbtree_map->find(&demo, 500);
+    pr_test("(%zd, %zd)", it->key, it->value);          // (500, -1)
+    pr_test("%zd", cbtree_map->size(&demo));            // 999
+    pr_test("");
+
+    BTREE_DEINIT(&demo);
+}
+
+static void demo_about_multimap(void)
+{
+    btree_t demo = BTREE_MULTIMAP_INIT(&demo);
+
+    for (int i = 0; i < 6; ++i)
+        cbtree_multimap->insert(&demo, i % 3, i);       // [ (0, 0), (0, 3), (1, 1), (1, 4), (2, 2), (2, 5) ]
+
+    pr_test("%zd", cbtree_multimap->count(&demo, 1));   // 2
+    cbtree_multimap->remove(&demo, 1);                  // [ (0, 0), (0, 3), (2, 2), (2, 5) ]
+
+    for (map_r_iterator_t* it = cbtree_multimap->rbegin(&demo); cbtree_multimap->rend(&demo) != it; it = cbtree_multimap->rnext(&demo, it))
+        pr_test("(%zd, %zd)", it->key, it->value);      // [ (2, 5), (2, 2), (0, 3), (0, 0) ]
+    pr_test("");
+
+    BTREE_DEINIT(&demo);
+}
+
+static void demo_about_set(void)
+{
+    btree_t demo = BTREE_SET_INIT_OPS(&demo, &demo_set_ops);
+
+    cbtree_set->insert(&demo, _tok("jerry"));
+    cbtree_set->insert(&demo, _tok("and"));
+    cbtree_set->insert(&demo, _tok("abc"));
+    cbtree_set->insert(&demo, _tok("and"));             // exists, return NULL
+
+    for (set_iterator_t* it = cbtree_set->begin(&demo); cbtree_set->end(&demo) != it; it = cbtree_set->next(&demo, it))
+        pr_test("%s", _from(it->svalue));               // [ 'abc', 'and', 'jerry' ]
+    pr_test("");
+
+    BTREE_DEINIT(&demo);
+}
+
+int main(void)
+{
+    demo_about_map();
+    demo_about_multimap();
+    demo_about_set();
+    return 0;
+}
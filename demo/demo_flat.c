@@ -0,0 +1,84 @@
+/*
+  Flat Map and Set Demos
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <flat/flat.h>
+#include <string.h>
+#include <_log.h>
+#include <operations/ds_ops_string.h>
+
+#define TAG "[demo_flat]"
+
+#define _tok(x)  ((flat_key_t)(x))
+#define _from(x) ((x) ? (x) : "null string")
+
+static class_set_ops_t demo_set_ops = {
+    .valid_value = ds_ops_valid_key_default_string_max_128,
+    .__lt_value  = __ds_ops_lt_default_string,
+    .__cmp_value = __ds_ops_cmp_default_string,
+    .copy_value  = ds_ops_copy_data_default_string,
+    .free_value  = ds_ops_free_data_default_string,
+};
+
+static void demo_about_map(void)
+{
+    flat_t demo = FLAT_MAP_INIT(&demo);
+    flat_key_t keys[] = { 50, 10, 40, 20, 30, 10 };
+    flat_value_t values[] = { 5, 1, 4, 2, 3, -1 };
+    map_iterator_t* it = NULL;
+
+    cflat_map->build_sorted(&demo, keys, values, 6);   // [ (10, 1), (20, 2), (30, 3), (40, 4), (50, 5) ], the first 10 is kept
+    cflat_map->insert(&demo, 60, 6);                    // Past the greatest key, no shift
+    cflat_map->insert_replace(&demo, 30, -3);           // (30, -3)
+    cflat_map->remove(&demo, 20);                       // [ (10, 1), (30, -3), (40, 4), (50, 5), (60, 6) ]
+
+    it = cflat_map->lower_bound(&demo, 35);
+    for (; cflat_map->end(&demo) != it; it = cflat_map->next(&demo, it))
+        pr_test("(%zd, %zd)", it->key, it->value);      // [ (40, 4), (50, 5), (60, 6) ]
+    pr_test("");
+
+    it = cflat_map->select(&demo, 1);
+    pr_test("(%zd, %zd)", it->key, it->value);          // (30, -3)
+    pr_test("%zd", cflat_map->rank(&demo, 50));         // 3
+    pr_test("");
+
+    FLAT_DEINIT(&demo);
+}
+
+static void demo_about_set(void)
+{
+    flat_t demo = FLAT_SET_INIT_OPS(&demo, &demo_set_ops);
+
+    cflat_set->insert(&demo, _tok("jerry"));
+    cflat_set->insert(&demo, _tok("and"));
+    cflat_set->insert(&demo, _tok("abc"));
+    cflat_set->insert(&demo, _tok("and"));              // exists, return NULL
+
+    for (set_r_iterator_t* it = cflat_set->rbegin(&demo); cflat_set->rend(&demo) != it; it = cflat_set->rnext(&demo, it))
+        pr_test("%s", _from(it->svalue));               // [ 'jerry', 'and', 'abc' ]
+    pr_test("");
+
+    FLAT_DEINIT(&demo);
+}
+
+int main(void)
+{
+    demo_about_map();
+    demo_about_set();
+    return 0;
+}
@@ -18,7 +18,11 @@
 */
 
 #include <hashmap/hashmap.h>
+#include <hashmap/hashmap_image.h>
+#include <hashmap/hashmap_wal.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <_log.h>
 #include <operations/ds_ops_string.h>
 
@@ -36,6 +40,25 @@ static class_hashmap_ops_t demo_ops = {
     .__hash      = __ds_ops_hash_default_string,
     .valid_key   = ds_ops_valid_key_default_string_max_128,
     .__lt        = __ds_ops_lt_default_string,
+    .__cmp       = __ds_ops_cmp_default_string,
+    .copy_key    = ds_ops_copy_data_default_string,
+    .free_key    = ds_ops_free_data_default_string,
+    .valid_value = NULL,
+    .copy_value  = NULL,
+    .free_value  = NULL,
+};
+
+/* Every key in one bucket, so that a single chain holds all of them */
+static ds_hash_t demo_hash_one(ds_key_t key)
+{
+    return 1;
+}
+
+static class_hashmap_ops_t demo_ops_one_bucket = {
+    .__hash      = demo_hash_one,
+    .valid_key   = ds_ops_valid_key_default_string_max_128,
+    .__lt        = __ds_ops_lt_default_string,
+    .__cmp       = __ds_ops_cmp_default_string,
     .copy_key    = ds_ops_copy_data_default_string,
     .free_key    = ds_ops_free_data_default_string,
     .valid_value = NULL,
@@ -149,11 +172,116 @@ static void demo_about_find(void)
     HASHMAP_DEINIT(&demo);
 }
 
+static void demo_about_compact(void)
+{
+    hashmap_t demo = HASHMAP_INIT_OPS_COMPACT(&demo, &demo_ops_one_bucket);
+    hashmap_size_t ret;
+
+    (void)ret;
+
+    char id[][20] = { "1", "2", "3", "4", "5", "6" };
+    for (int i = 0; i < sizeof(id) / sizeof(id[0]); ++i)
+        cds->insert(&demo, _tok(id[i]), i);
+    // after for, one chain [ ('6', 5), ('5', 4), ('4', 3), ('3', 2), ('2', 1), ('1', 0) ]
+
+    ret = cds->remove(&demo, _tok(id[2])); // [ ('6', 5), ('5', 4), ('4', 3), ('2', 1), ('1', 0) ], '3' goes to the free list
+    ret = cds->clear(&demo);               // [ ], return 5, every key freed once
+
+    for (int i = 0; i < sizeof(id) / sizeof(id[0]); ++i)
+        cds->insert(&demo, _tok(id[i]), i);
+    ret = cds->remove(&demo, _tok(id[4])); // [ ('6', 5), ('4', 3), ('3', 2), ('2', 1), ('1', 0) ]
+    pr_test("compact size [ %zd ]", cds->size(&demo)); // compact size [ 5 ]
+
+    HASHMAP_DEINIT(&demo);                 // frees the 5 remaining keys, not the free list
+}
+
+static void demo_about_image(void)
+{
+    hashmap_t demo = HASHMAP_INIT_OPS(&demo, &demo_ops);
+    hashmap_image_t image = HASHMAP_IMAGE_INIT(&image);
+    hashmap_value_t value = 0;
+    bool ret;
+
+    (void)ret;
+
+    char id[][20] = { "yj", "jy", "123", "?混搭33*&", "中文", "test" };
+    for (int i = 0; i < sizeof(id) / sizeof(id[0]); ++i)
+        cds->insert(&demo, _tok(id[i]), i);
+
+    ret = chashmap_image->dump(&demo, "/tmp/demo_hashmap.img", HM_KV_KEY_STRING); // true
+    HASHMAP_DEINIT(&demo);
+
+    ret = chashmap_image->load(&image, "/tmp/demo_hashmap.img");  // true, nothing is rebuilt
+    ret = chashmap_image->find(&image, _tok("中文"), &value);     // found, value = 4
+    ret = chashmap_image->find(&image, _tok("jerry"), &value);    // no found
+    pr_test("image size [ %zd ], value [ %zd ]", chashmap_image->size(&image), value); // image size [ 6 ], value [ 4 ]
+
+    HASHMAP_IMAGE_DEINIT(&image);
+    unlink("/tmp/demo_hashmap.img");
+}
+
+static void demo_about_wal(void)
+{
+    hashmap_t demo = HASHMAP_INIT_OPS(&demo, &demo_ops);
+    hashmap_t raw = HASHMAP_INIT(&raw);
+    hashmap_wal_t wal = HASHMAP_WAL_INIT_2(&wal, 4, 10); // group commit every 4 records or 10 ms
+    hashmap_size_t ret;
+    struct stat st;
+    bool ok;
+
+    (void)ret;
+    (void)ok;
+
+    unlink("/tmp/demo_hashmap.wal");
+    ret = chashmap_wal->open(&wal, &demo, "/tmp/demo_hashmap.wal", HM_KV_KEY_STRING); // 0, a new log
+
+    char id[][20] = { "yj", "jy", "123", "?混搭33*&", "中文", "test" };
+    for (int i = 0; i < sizeof(id) / sizeof(id[0]); ++i)
+        chashmap_wal->insert(&wal, _tok(id[i]), i);          // 6 insert records, one fdatasync per 4
+    chashmap_wal->insert_replace(&wal, _tok("yj"), 99);      // [ ('yj', 99), ... ]
+    ret = chashmap_wal->remove(&wal, _tok("jy"));            // 1, the last record
+    ok = chashmap_wal->close(&wal);                          // true, 8 records on disk
+    HASHMAP_DEINIT(&demo);
+
+    demo = HASHMAP_INIT_OPS(&demo, &demo_ops);
+    ret = chashmap_wal->replay(&demo, "/tmp/demo_hashmap.wal", HM_KV_KEY_STRING);
+    pr_test("replay [ %zd ] records, size [ %zd ], yj [ %zd ]", ret, cds->size(&demo),
+            cds->find(&demo, _tok("yj"))->value);            // replay [ 8 ] records, size [ 5 ], yj [ 99 ]
+    HASHMAP_DEINIT(&demo);
+
+    ret = chashmap_wal->replay(&raw, "/tmp/demo_hashmap.wal", HM_KV_KEY_STRING); // -1, `raw` can't copy the keys
+    HASHMAP_DEINIT(&raw);
+
+    /* Cut the remove of 'jy' in half, as a crash in the middle of its write would */
+    stat("/tmp/demo_hashmap.wal", &st);
+    ok = 0 == truncate("/tmp/demo_hashmap.wal", st.st_size - 3);
+
+    demo = HASHMAP_INIT_OPS(&demo, &demo_ops);
+    ret = chashmap_wal->open(&wal, &demo, "/tmp/demo_hashmap.wal", HM_KV_KEY_STRING);
+    pr_test("reopen [ %zd ] records, size [ %zd ]", ret, cds->size(&demo)); // reopen [ 7 ] records, size [ 6 ], the torn tail is cut off
+
+    ret = chashmap_wal->remove(&wal, _tok("test"));          // 1, appended after the cut
+    ok = chashmap_wal->compact(&wal);                        // true, the log is rewritten as 5 insert records
+    ok = chashmap_wal->close(&wal);
+    HASHMAP_DEINIT(&demo);
+
+    demo = HASHMAP_INIT_OPS(&demo, &demo_ops);
+    ret = chashmap_wal->replay(&demo, "/tmp/demo_hashmap.wal", HM_KV_KEY_STRING);
+    pr_test("compacted [ %zd ] records, size [ %zd ]", ret, cds->size(&demo)); // compacted [ 5 ] records, size [ 5 ]
+    HASHMAP_DEINIT(&demo);
+
+    HASHMAP_WAL_DEINIT(&wal);
+    unlink("/tmp/demo_hashmap.wal");
+}
+
 int main(void)
 {
     demo_base_and_iterator();
     demo_about_insert();
     demo_about_erase();
     demo_about_find();
+    demo_about_compact();
+    demo_about_image();
+    demo_about_wal();
     return 0;
 }
@@ -0,0 +1,96 @@
+/*
+  Interval Tree Demos
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <interval/interval.h>
+#include <string.h>
+#include <_log.h>
+#include <operations/ds_ops_string.h>
+
+#define TAG "[demo_interval]"
+
+#define _tov(x)  ((interval_value_t)(x))
+#define _from(x) ((x) ? (x) : "null string")
+
+static class_interval_ops_t demo_ops = {
+    .valid_value = ds_ops_valid_key_default_string_max_128,
+    .copy_value  = ds_ops_copy_data_default_string,
+    .free_value  = ds_ops_free_data_default_string,
+};
+
+static bool demo_print(interval_key_t lo, interval_key_t hi, interval_value_t value, void* arg)
+{
+    pr_test("[%zd, %zd) %zd", lo, hi, value);
+    return true;
+}
+
+static void demo_about_overlap(void)
+{
+    interval_t demo = INTERVAL_INIT(&demo);
+    interval_iterator_t* it = NULL;
+
+    cinterval->insert(&demo, 15, 20, 1);
+    cinterval->insert(&demo, 10, 30, 2);
+    cinterval->insert(&demo, 17, 19, 3);
+    cinterval->insert(&demo, 5, 20, 4);
+    cinterval->insert(&demo, 12, 15, 5);
+    cinterval->insert(&demo, 30, 40, 6);
+    cinterval->insert(&demo, 8, 8, 7);                      // empty, return NULL
+
+    pr_test("%zd", cinterval->overlap(&demo, 14, 16, demo_print, NULL)); // [ [5, 20) 4, [10, 30) 2, [12, 15) 5, [15, 20) 1 ], 4
+    pr_test("");
+
+    pr_test("%zd", cinterval->stab(&demo, 30, demo_print, NULL));        // [ [30, 40) 6 ], 1, `hi` isn't held
+    pr_test("");
+
+    it = cinterval->overlap_first(&demo, 18, 19);
+    for (; cinterval->end(&demo) != it; it = cinterval->overlap_next(&demo, it, 18, 19))
+        pr_test("[%zd, %zd) %zd", it->lo, it->hi, it->value); // [ [5, 20) 4, [10, 30) 2, [15, 20) 1, [17, 19) 3 ]
+    pr_test("");
+
+    INTERVAL_DEINIT(&demo);
+}
+
+static void demo_about_erase(void)
+{
+    interval_t demo = INTERVAL_INIT_OPS(&demo, &demo_ops);
+    interval_iterator_t* it = NULL;
+
+    cinterval->insert(&demo, 9, 17, _tov("meeting"));
+    cinterval->insert(&demo, 12, 13, _tov("lunch"));
+    cinterval->insert(&demo, 12, 13, _tov("call"));      // equal intervals are all kept
+    cinterval->insert(&demo, 18, 22, _tov("dinner"));
+
+    pr_test("%zd", cinterval->remove(&demo, 12, 13));       // 2
+    it = cinterval->find(&demo, 9, 17);
+    cinterval->erase(&demo, it);                            // [ [18, 22) 'dinner' ]
+
+    for (it = cinterval->begin(&demo); cinterval->end(&demo) != it; it = cinterval->next(&demo, it))
+        pr_test("[%zd, %zd) %s", it->lo, it->hi, _from(it->svalue));
+    pr_test("%zd", cinterval->size(&demo));                 // 1
+    pr_test("");
+
+    INTERVAL_DEINIT(&demo);
+}
+
+int main(void)
+{
+    demo_about_overlap();
+    demo_about_erase();
+    return 0;
+}
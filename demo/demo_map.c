@@ -35,6 +35,7 @@
 static class_map_ops_t demo_ops = {
     .valid_key   = ds_ops_valid_key_default_string_max_128,
     .__lt        = __ds_ops_lt_default_string,
+    .__cmp       = __ds_ops_cmp_default_string,
     .copy_key    = ds_ops_copy_data_default_string,
     .free_key    = ds_ops_free_data_default_string,
     .valid_value = NULL,
@@ -136,6 +137,8 @@ static void demo_about_find(void)
 {
     map_t demo = MAP_INIT(&demo);
     map_iterator_t* it = NULL;
+    map_key_t keys[4] = { 8, 66, 3, 0 };
+    map_iterator_t* out[4];
 
     (void)it;
 
@@ -146,6 +149,10 @@ static void demo_about_find(void)
     it = cds->find(&demo, 3);  // found, it -> (3, 3)
     it = cds->find(&demo, 66); // no found, it -> end()
 
+    pr_test("%zd", cds->find_batch(&demo, keys, 4, out)); // 2, out -> [ (8, 8), end(), (3, 3), end() ]
+    for (int i = 0; i < 4; ++i)
+        pr_test("%zd", cds->end(&demo) != out[i] ? out[i]->key : -1);
+
     it = cds->lower_bound(&demo, 0); pr_test("%zd", it && cds->end(&demo) != it ? it->key : -1); // it -> (1, 1)
     it = cds->lower_bound(&demo, 6); pr_test("%zd", it && cds->end(&demo) != it ? it->key : -1); // it -> (6, 6)
     it = cds->lower_bound(&demo, 8); pr_test("%zd", it && cds->end(&demo) != it ? it->key : -1); // it -> (8, 8)
@@ -160,11 +167,149 @@ static void demo_about_find(void)
     MAP_DEINIT(&demo);
 }
 
+static void demo_about_build_sorted(void)
+{
+    map_t demo = MAP_INIT(&demo);
+    map_key_t keys[] = { 5, 1, 3, 1, 4 };
+    map_value_t values[] = { 50, 10, 30, 11, 40 };
+
+    pr_test("%zd", cds->build_sorted(&demo, keys, values, 5, true)); // 4, sorted first and the first (1, 10) is kept
+
+    for (map_iterator_t* it = cds->begin(&demo); cds->end(&demo) != it; it = cds->next(&demo, it))
+        pr_test("(%zd, %zd)", it->key, it->value);                   // [ (1, 10), (3, 30), (4, 40), (5, 50) ]
+    pr_test("");
+
+    cds->remove(&demo, 3);                                           // nodes of the block are released one by one
+    pr_test("%zd", cds->build_sorted(&demo, keys, values, 5, true)); // -1, not empty
+
+    MAP_DEINIT(&demo);
+}
+
+static void demo_about_insert_hint(void)
+{
+    map_t demo = MAP_INIT(&demo);
+    map_iterator_t* it = NULL;
+
+    for (int i = 0; i < 10; i += 2)
+        cds->insert(&demo, i, i);                         // increasing keys, appended at `rightmost`
+
+    it = cds->find(&demo, 4);
+    it = cds->insert_hint(&demo, it, 5, 5);               // right after the hint, no descent
+    it = cds->insert_hint(&demo, it, 3, 3);               // out of place, a full search
+    it = cds->insert_hint(&demo, cds->end(&demo), 9, 9);  // at `end`
+
+    for (it = cds->begin(&demo); cds->end(&demo) != it; it = cds->next(&demo, it))
+        pr_test("(%zd, %zd)", it->key, it->value);        // [ (0, 0), (2, 2), (3, 3), (4, 4), (5, 5), (6, 6), (8, 8), (9, 9) ]
+    pr_test("");
+
+    MAP_DEINIT(&demo);
+}
+
+static bool demo_sum(map_key_t key, map_value_t value, void* arg)
+{
+    *(map_value_t*)arg += value;
+    return true;
+}
+
+static void demo_about_range(void)
+{
+    map_t demo = MAP_INIT(&demo);
+    map_iterator_t* it = NULL;
+    map_iterator_t* last = NULL;
+    map_value_t sum = 0;
+
+    for (int i = 1; i <= 10; ++i)
+        cds->insert(&demo, i * 10, i);                              // [ (10, 1), (20, 2), ..., (100, 10) ], keyed by expiry time
+
+    it = cds->equal_range(&demo, 30, &last);
+    pr_test("(%zd, %zd)", it->key, last->key);                      // (30, 40)
+
+    pr_test("%zd", cds->for_each_range(&demo, 20, 50, demo_sum, &sum));
+    pr_test("%zd", sum);                                            // 3 visited: 2 + 3 + 4 = 9
+
+    pr_test("%zd", cds->erase_range(&demo, 0, 65));                 // 6 expired, [ (70, 7), (80, 8), (90, 9), (100, 10) ]
+    pr_test("%zd", cds->size(&demo));                               // 4
+    pr_test("");
+
+    MAP_DEINIT(&demo);
+}
+
+static void demo_about_split_join(void)
+{
+    map_t demo = MAP_INIT(&demo);
+    map_t shard = MAP_INIT(&shard);
+
+    for (int i = 1; i <= 8; ++i)
+        cds->insert(&demo, i, i * 10);                              // [ (1, 10), (2, 20), ..., (8, 80) ]
+
+    pr_test("%zd", cds->split(&demo, 6, &demo, &shard));            // 5, keys >= 6 are relinked into `shard`
+    pr_test("%zd", cds->size(&shard));                              // 3, [ (6, 60), (7, 70), (8, 80) ]
+    pr_test("%zd", cds->join(&shard, &demo));                       // -1, the keys of `demo` aren't greater
+    pr_test("%zd", cds->join(&demo, &shard));                       // 8, all back in `demo`, `shard` is empty
+    pr_test("");
+
+    MAP_DEINIT(&demo);
+    MAP_DEINIT(&shard);
+}
+
+static void demo_about_node_handle(void)
+{
+    map_t demo = MAP_INIT_OPS(&demo, &demo_ops);
+    map_t cold = MAP_INIT_OPS(&cold, &demo_ops);
+    ds_node_handle_t handle = { 0 };
+
+    cds->insert(&demo, _tok("jerry"), 1);
+    cds->insert(&demo, _tok("tom"), 2);
+    cds->insert(&cold, _tok("tom"), 3);
+
+    cds->extract(&demo, cds->find(&demo, _tok("jerry")), &handle); // The key string and the node move into `handle`
+    cds->insert_node(&cold, &handle);                               // Linked as it was, nothing allocated or copied
+    for (map_iterator_t* it = cds->begin(&cold); cds->end(&cold) != it; it = cds->next(&cold, it))
+        pr_test("(%s, %zd)", _from(it->skey), it->value);           // [ (jerry, 1), (tom, 3) ]
+
+    cds->extract(&demo, cds->begin(&demo), &handle);                // (tom, 2)
+    if (NULL == cds->insert_node(&cold, &handle))                   // "tom" exists, `handle` still holds the entry
+        cds->free_node(&cold, &handle);
+    pr_test("%zd", cds->size(&demo) + cds->size(&cold));           // 2
+    pr_test("");
+
+    MAP_DEINIT(&demo);
+    MAP_DEINIT(&cold);
+}
+
+static void demo_about_small(void)
+{
+    map_t demo = MAP_INIT_SMALL(&demo);
+    map_iterator_t* it = NULL;
+
+    for (int i = 8; i > 0; --i)
+        cds->insert(&demo, i, i * 10);                 // 8 entries in one sorted array, no node allocated
+
+    it = cds->find(&demo, 3);                          // a linear scan of the array
+    pr_test("(%zd, %zd)", it->key, it->value);         // (3, 30)
+
+    for (int i = 9; i <= 20; ++i)
+        cds->insert(&demo, i, i * 10);                 // the 17th moves them all into the tree
+    pr_test("%zd", cds->erase_range(&demo, 1, 13));    // 12, 8 left, back to the array
+
+    for (it = cds->begin(&demo); cds->end(&demo) != it; it = cds->next(&demo, it))
+        pr_test("(%zd, %zd)", it->key, it->value);     // [ (13, 130), (14, 140), ..., (20, 200) ]
+    pr_test("");
+
+    MAP_DEINIT(&demo);
+}
+
 int main(void)
 {
     demo_base_and_iterator();
     demo_about_insert();
     demo_about_erase();
     demo_about_find();
+    demo_about_build_sorted();
+    demo_about_insert_hint();
+    demo_about_range();
+    demo_about_split_join();
+    demo_about_node_handle();
+    demo_about_small();
     return 0;
 }
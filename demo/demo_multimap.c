@@ -35,6 +35,7 @@
 static class_multimap_ops_t demo_ops = {
     .valid_key   = ds_ops_valid_key_default_string_max_128,
     .__lt        = __ds_ops_lt_default_string,
+    .__cmp       = __ds_ops_cmp_default_string,
     .copy_key    = ds_ops_copy_data_default_string,
     .free_key    = ds_ops_free_data_default_string,
     .valid_value = NULL,
@@ -166,11 +167,97 @@ static void demo_about_find(void)
     MULTIMAP_DEINIT(&demo);
 }
 
+static void demo_about_order_stat(void)
+{
+    multimap_t demo = MULTIMAP_INIT_OS(&demo);
+    multimap_iterator_t* it = NULL;
+
+    for (int i = 0; i < 12; ++i)
+        cds->insert(&demo, i % 4, i);                // [ (0, 0), (0, 4), (0, 8), (1, 1), ..., (3, 3), (3, 7), (3, 11) ]
+
+    pr_test("%zd", cds->count(&demo, 2));            // 3, without walking the duplicates
+    pr_test("%zd", cds->rank(&demo, 2));             // 6, keys < 2
+    pr_test("%zd", cds->count_range(&demo, 1, 3));   // 6, keys in [ 1, 3 )
+
+    it = cds->select(&demo, 4);
+    pr_test("(%zd, %zd)", it->key, it->value);       // (1, 5)
+    pr_test("");
+
+    MULTIMAP_DEINIT(&demo);
+}
+
+static void demo_about_compress(void)
+{
+    multimap_t demo = MULTIMAP_INIT_COMPRESS(&demo);
+    multimap_iterator_t* it = NULL;
+
+    for (int i = 0; i < 9; ++i)
+        cds->insert(&demo, i % 3, i);                // [ (0, 0), (0, 3), (0, 6), (1, 1), ..., (2, 8) ], a node per key
+
+    pr_test("%zd", cds->count(&demo, 1));            // 3
+
+    it = cds->find(&demo, 1);
+    it = cds->erase(&demo, it);                      // [ (0, 0), (0, 3), (0, 6), (1, 4), (1, 7), (2, 2), ... ]
+    pr_test("(%zd, %zd)", it->key, it->value);       // (1, 4)
+
+    for (it = cds->begin(&demo); cds->end(&demo) != it; it = cds->next(&demo, it))
+        pr_test("(%zd, %zd)", it->key, it->value);
+    pr_test("");
+
+    {
+        multimap_size_t n = 0;
+        for (multimap_r_iterator_t* rit = cds->rprev(&demo, cds->rend(&demo)); cds->rend(&demo) != rit; rit = cds->rprev(&demo, rit))
+            n++;                                     // (0, 0), (0, 3), (0, 6), (1, 4), (1, 7), (2, 2), ..., from rend
+        pr_test("%zd of %zd", n, cds->size(&demo));  // 8 of 8
+    }
+    pr_test("");
+
+    MULTIMAP_DEINIT(&demo);
+
+    demo = MULTIMAP_INIT_OS_COMPRESS(&demo);         // Nodes weigh their count
+    for (int i = 0; i < 100; ++i)
+        cds->insert(&demo, i % 4, i);
+
+    pr_test("%zd", cds->rank(&demo, 3));             // 75
+    it = cds->select(&demo, 30);
+    pr_test("(%zd, %zd)", it->key, it->value);       // (1, 21)
+    pr_test("%zd", cds->count_range(&demo, 1, 3));   // 50
+    pr_test("");
+
+    MULTIMAP_DEINIT(&demo);
+}
+
+static void demo_about_small(void)
+{
+    multimap_t demo = MULTIMAP_INIT_SMALL(&demo);
+    multimap_iterator_t* it = NULL;
+
+    for (int i = 0; i < 12; ++i)
+        cds->insert(&demo, i % 3, i);                // 12 entries in one sorted array, equal keys as they came
+
+    it = cds->find(&demo, 1);                        // a linear scan of the array
+    pr_test("(%zd, %zd)", it->key, it->value);       // (1, 1)
+    pr_test("%zd", cds->count(&demo, 2));            // 4
+
+    for (int i = 12; i < 20; ++i)
+        cds->insert(&demo, i % 3, i);                // the 17th moves them all into the tree
+    pr_test("%zd", cds->erase_range(&demo, 0, 2));   // 14, 6 left, back to the array
+
+    for (it = cds->begin(&demo); cds->end(&demo) != it; it = cds->next(&demo, it))
+        pr_test("(%zd, %zd)", it->key, it->value);   // [ (2, 2), (2, 5), ..., (2, 17) ]
+    pr_test("");
+
+    MULTIMAP_DEINIT(&demo);
+}
+
 int main(void)
 {
     demo_base_and_iterator();
     demo_about_insert();
     demo_about_erase();
     demo_about_find();
+    demo_about_order_stat();
+    demo_about_compress();
+    demo_about_small();
     return 0;
 }
@@ -35,6 +35,7 @@
 static class_multiset_ops_t demo_ops = {
     .valid_value = ds_ops_valid_data_default_string,
     .__lt_value  = __ds_ops_lt_default_string,
+    .__cmp_value = __ds_ops_cmp_default_string,
     .copy_value  = ds_ops_copy_data_default_string,
     .free_value  = ds_ops_free_data_default_string,
 };
@@ -166,11 +167,74 @@ static void demo_about_find(void)
     MULTISET_DEINIT(&demo);
 }
 
+static void demo_about_compress(void)
+{
+    multiset_t demo = MULTISET_INIT_COMPRESS(&demo);
+    multiset_iterator_t* it = NULL;
+
+    for (int i = 0; i < 1000; ++i)
+        cds->insert(&demo, i % 3);                   // 3 nodes, whatever the size
+
+    pr_test("%zd", cds->size(&demo));                // 1000
+    pr_test("%zd", cds->count(&demo, 1));            // 333
+    pr_test("%zd", cds->rank(&demo, 2));             // 667
+
+    {
+        multiset_size_t n = 0;
+        for (multiset_r_iterator_t* rit = cds->rprev(&demo, cds->rend(&demo)); cds->rend(&demo) != rit; rit = cds->rprev(&demo, rit))
+            n++;                                     // Every occurrence, in order, from rend
+        pr_test("%zd of %zd", n, cds->size(&demo));  // 1000 of 1000
+    }
+
+    it = cds->find(&demo, 2);
+    while (cds->end(&demo) != it && 2 == it->value)
+        it = cds->erase(&demo, it);                  // One occurrence at a time
+    pr_test("%zd", cds->count(&demo, 2));            // 0
+    pr_test("");
+
+    MULTISET_DEINIT(&demo);
+
+    demo = MULTISET_INIT_OS_COMPRESS(&demo);         // Nodes weigh their count
+    for (int i = 0; i < 1000; ++i)
+        cds->insert(&demo, i % 10);
+
+    pr_test("%zd", cds->rank(&demo, 7));             // 700, in O(log 10)
+    pr_test("%d", (int)cds->select(&demo, 250)->value); // 2
+    pr_test("%zd", cds->count_range(&demo, 3, 5));   // 200
+    pr_test("");
+
+    MULTISET_DEINIT(&demo);
+}
+
+static void demo_about_small(void)
+{
+    multiset_t demo = MULTISET_INIT_SMALL(&demo);
+    multiset_iterator_t* it = NULL;
+
+    for (int i = 0; i < 12; ++i)
+        cds->insert(&demo, i % 4);                   // 12 values in one sorted array, no node allocated
+
+    pr_test("%zd", cds->count(&demo, 2));            // 3, a scan of the array
+    pr_test("%d", (int)cds->select(&demo, 7)->value); // 2
+
+    for (int i = 0; i < 8; ++i)
+        cds->insert(&demo, 4);                       // the 17th moves them all into the tree
+    pr_test("%zd", cds->erase_range(&demo, 2, 5));   // 14, 6 left, back to the array
+
+    for (it = cds->begin(&demo); cds->end(&demo) != it; it = cds->next(&demo, it))
+        pr_test("%d", (int)it->value);               // [ 0, 0, 0, 1, 1, 1 ]
+    pr_test("");
+
+    MULTISET_DEINIT(&demo);
+}
+
 int main(void)
 {
     demo_base_and_iterator();
     demo_about_insert();
     demo_about_erase();
     demo_about_find();
+    demo_about_compress();
+    demo_about_small();
     return 0;
 }
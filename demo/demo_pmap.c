@@ -0,0 +1,104 @@
+/*
+  Persistent Map and Set Demos
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <pmap/pmap.h>
+#include <_log.h>
+#include <operations/ds_ops_string.h>
+
+#define TAG "[demo_pmap]"
+
+#define _tok(x)  ((pmap_key_t)(x))
+#define _from(x) ((x) ? (x) : "null string")
+
+static class_set_ops_t demo_set_ops = {
+    .valid_value = ds_ops_valid_key_default_string_max_128,
+    .__lt_value  = __ds_ops_lt_default_string,
+    .copy_value  = ds_ops_copy_data_default_string,
+    .free_value  = ds_ops_free_data_default_string,
+};
+
+static bool demo_print(map_key_t key, map_value_t value, void* arg)
+{
+    pr_test("(%zd, %zd)", key, value);
+    return true;
+}
+
+static void demo_about_versions(void)
+{
+    pmap_t* v0 = cpmap->create(NULL);
+    pmap_t* v1 = NULL;
+    pmap_t* v2 = NULL;
+    pmap_t* t = NULL;
+
+    v1 = v0;
+    for (int i = 1; i <= 5; ++i) {
+        t = cpmap->insert(v1, i, i * 10);
+        cpmap->release(v1);                             // the version before isn't needed any more
+        v1 = t;                                         // [ (1, 10), (2, 20), (3, 30), (4, 40), (5, 50) ]
+    }
+
+    v2 = cpmap->remove(v1, 3);                          // v1 is left as it was
+    t = cpmap->insert_replace(v2, 5, -1);
+    cpmap->release(v2);
+    v2 = t;                                             // [ (1, 10), (2, 20), (4, 40), (5, -1) ]
+
+    cpmap->for_each_range(v1, 2, 6, demo_print, NULL);  // [ (2, 20), (3, 30), (4, 40), (5, 50) ]
+    pr_test("");
+    cpmap->for_each_range(v2, 2, 6, demo_print, NULL);  // [ (2, 20), (4, 40), (5, -1) ]
+    pr_test("%zd | %zd", cpmap->size(v1), cpmap->size(v2)); // 5 | 4
+    pr_test("");
+
+    cpmap->release(v1);
+    cpmap->release(v2);
+}
+
+static void demo_about_slot(void)
+{
+    pmap_slot_t slot = PMAP_SLOT_INIT(&slot);
+    pmap_t* writer = cpset->create(&demo_set_ops);
+    pmap_t* reader = NULL;
+    pmap_t* t = NULL;
+
+    t = cpset->insert(writer, _tok("jerry"));
+    cpset->release(writer);
+    writer = t;
+    cpset->publish(&slot, writer);                      // readers see [ 'jerry' ]
+
+    reader = cpset->acquire(&slot);                     // O(1), no lock, any thread
+
+    t = cpset->insert(writer, _tok("and"));
+    cpset->release(writer);
+    writer = t;
+    cpset->publish(&slot, writer);                      // [ 'and', 'jerry' ] for the readers coming
+
+    for (set_iterator_t* it = cpset->begin(reader); cpset->end(reader) != it; it = cpset->next(reader, it))
+        pr_test("%s", _from(it->svalue));               // [ 'jerry' ], still the version acquired
+    pr_test("");
+
+    cpset->release(reader);
+    cpset->release(writer);
+    PMAP_SLOT_DEINIT(&slot);
+}
+
+int main(void)
+{
+    demo_about_versions();
+    demo_about_slot();
+    return 0;
+}
@@ -35,6 +35,7 @@
 static class_set_ops_t demo_ops = {
     .valid_value = ds_ops_valid_data_default_string,
     .__lt_value  = __ds_ops_lt_default_string,
+    .__cmp_value = __ds_ops_cmp_default_string,
     .copy_value  = ds_ops_copy_data_default_string,
     .free_value  = ds_ops_free_data_default_string,
 };
@@ -132,6 +133,10 @@ static void demo_about_find(void)
 {
     set_t demo = SET_INIT(&demo);
     set_iterator_t* it = NULL;
+    set_value_t values[4] = { 8, 66, 3, 0 };
+    set_value_t sorted[4] = { 0, 3, 8, 9 };
+    set_iterator_t* out[4];
+    uint64_t bitmap[1];
 
     (void)it;
 
@@ -142,6 +147,12 @@ static void demo_about_find(void)
     it = cds->find(&demo, 3);  // found, it -> 3
     it = cds->find(&demo, 66); // no found, it -> end()
 
+    pr_test("%zd", cds->find_batch(&demo, values, 4, out)); // 2, out -> [ 8, end(), 3, end() ]
+    for (int i = 0; i < 4; ++i)
+        pr_test("%zd", cds->end(&demo) != out[i] ? out[i]->value : -1);
+    pr_test("%zd", cds->contains_sorted(&demo, sorted, 4, bitmap)); // 2, one walk in order
+    pr_test("%zd", (ssize_t)bitmap[0]);                             // 6, bits 1 and 2: 3 and 8 are in
+
     it = cds->lower_bound(&demo, 0); pr_test("%zd", it && cds->end(&demo) != it ? it->value : -1); // it -> 1
     it = cds->lower_bound(&demo, 6); pr_test("%zd", it && cds->end(&demo) != it ? it->value : -1); // it -> 6
     it = cds->lower_bound(&demo, 8); pr_test("%zd", it && cds->end(&demo) != it ? it->value : -1); // it -> 8
@@ -156,11 +167,59 @@ static void demo_about_find(void)
     SET_DEINIT(&demo);
 }
 
+static void demo_about_algebra(void)
+{
+    set_t a = SET_INIT(&a);
+    set_t b = SET_INIT(&b);
+    set_t demo = SET_INIT(&demo);
+
+    for (int i = 1; i <= 6; ++i) {
+        cds->insert(&a, i);                             // [ 1, 2, 3, 4, 5, 6 ]
+        cds->insert(&b, i * 2);                         // [ 2, 4, 6, 8, 10, 12 ]
+    }
+
+    pr_test("%zd", cds->set_intersection(&demo, &a, &b));
+    foreach();                                          // 3, [ 2, 4, 6 ]
+    pr_test("");
+
+    cds->clear(&demo);
+    pr_test("%zd", cds->set_symmetric_difference(&demo, &a, &b));
+    foreach();                                          // 6, [ 1, 3, 5, 8, 10, 12 ]
+    pr_test("");
+
+    pr_test("%zd", cds->difference_with(&demo, &a));   // 3, [ 8, 10, 12 ]
+    pr_test("%zd", cds->union_with(&demo, &b));        // 6, [ 2, 4, 6, 8, 10, 12 ]
+    pr_test("");
+
+    SET_DEINIT(&a);
+    SET_DEINIT(&b);
+    SET_DEINIT(&demo);
+}
+
+static void demo_about_thread(void)
+{
+    set_t demo = SET_INIT_THREAD(&demo);
+
+    for (int i = 10; i > 0; --i)
+        cds->insert(&demo, i * 3);                      // each node linked between its neighbours as it goes in
+
+    cds->remove(&demo, 15);                             // and unlinked from them
+    cds->erase_range(&demo, 20, 28);
+
+    for (set_r_iterator_t* it = cds->rbegin(&demo); cds->rend(&demo) != it; it = cds->rnext(&demo, it))
+        pr_test("%zd", it->value);                      // [ 30, 18, 12, 9, 6, 3 ], one hop a step
+    pr_test("");
+
+    SET_DEINIT(&demo);
+}
+
 int main(void)
 {
     demo_base_and_iterator();
     demo_about_insert();
     demo_about_erase();
     demo_about_find();
+    demo_about_algebra();
+    demo_about_thread();
     return 0;
 }
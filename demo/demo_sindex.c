@@ -0,0 +1,69 @@
+/*
+  Static Search Index Demos
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <sindex/sindex.h>
+#include <_log.h>
+
+#define TAG "[demo_sindex]"
+
+static void demo_about_eytzinger(void)
+{
+    set_t allow = SET_INIT(&allow);
+    sindex_t demo = SINDEX_INIT(&demo);
+    sindex_key_t lower = 0;
+
+    for (int i = 1; i <= 100; ++i)
+        cset->insert(&allow, i * 10);                   // [ 10, 20, ..., 1000 ]
+
+    csindex->build_set(&demo, &allow);                  // The set may go, the index holds its own copy
+    SET_DEINIT(&allow);
+
+    pr_test("%d", csindex->contains(&demo, 500));       // 1
+    pr_test("%d", csindex->contains(&demo, 505));       // 0
+    csindex->lower_bound(&demo, 505, &lower, NULL);
+    pr_test("%zd", lower);                              // 510
+    pr_test("%d", csindex->lower_bound(&demo, 1001, &lower, NULL)); // 0
+    pr_test("");
+
+    SINDEX_DEINIT(&demo);
+}
+
+static void demo_about_stree(void)
+{
+    sindex_t demo = SINDEX_INIT_STREE(&demo);
+    sindex_key_t keys[] = { 7, -3, 42, 7, 0 };
+    sindex_value_t values[] = { 70, -30, 420, -1, 0 };
+    sindex_value_t value = 0;
+
+    pr_test("%zd", csindex->build_sorted(&demo, keys, values, 5)); // 4, the first 7 is kept
+    csindex->find(&demo, 7, &value);
+    pr_test("%zd", value);                              // 70
+    csindex->find(&demo, -3, &value);
+    pr_test("%zd", value);                              // -30
+    pr_test("");
+
+    SINDEX_DEINIT(&demo);
+}
+
+int main(void)
+{
+    demo_about_eytzinger();
+    demo_about_stree();
+    return 0;
+}
@@ -0,0 +1,76 @@
+/*
+  Concurrent Skiplist Demos
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <skiplist/skiplist.h>
+#include <_log.h>
+
+#define TAG "[demo_skiplist]"
+
+#define THREADS 4
+
+static skiplist_t demo;
+
+static void* demo_writer(void* arg)
+{
+    long base = (long)arg;
+
+    for (long i = 0; i < 1000; ++i)
+        cskiplist->insert(&demo, base + i * THREADS, i);  // every thread its own keys, [ 0, 4000 )
+
+    for (long i = 0; i < 1000; i += 2)
+        cskiplist->remove(&demo, base + i * THREADS);      // the even `i` removed again, [ 4, 5, 6, 7, 12, 13, ... ]
+    return NULL;
+}
+
+static bool demo_print(skiplist_key_t key, skiplist_value_t value, void* arg)
+{
+    pr_test("(%zd, %zd)", key, value);
+    return true;
+}
+
+static void demo_about_threads(void)
+{
+    pthread_t threads[THREADS];
+    skiplist_key_t key = 0;
+    skiplist_value_t value = 0;
+
+    demo = SKIPLIST_INIT(&demo);
+
+    for (long i = 0; i < THREADS; ++i)
+        pthread_create(&threads[i], NULL, demo_writer, (void*)i);
+    for (long i = 0; i < THREADS; ++i)
+        pthread_join(threads[i], NULL);
+
+    pr_test("%zd", cskiplist->size(&demo));                   // 2000
+    pr_test("%d", cskiplist->find(&demo, 0, NULL));           // 0, removed
+
+    cskiplist->lower_bound(&demo, 0, &key, &value);
+    pr_test("(%zd, %zd)", key, value);                        // (4, 1)
+
+    cskiplist->for_each_range(&demo, 8, 16, demo_print, NULL); // [ (12, 3), (13, 3), (14, 3), (15, 3) ]
+    pr_test("");
+
+    SKIPLIST_DEINIT(&demo);
+}
+
+int main(void)
+{
+    demo_about_threads();
+    return 0;
+}
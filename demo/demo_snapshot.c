@@ -0,0 +1,82 @@
+/*
+  Snapshot Demos
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <snapshot/snapshot.h>
+#include <unistd.h>
+#include <_log.h>
+
+#define cds csnapshot
+#define TAG "[demo_snapshot]"
+
+static void demo_about_map(void)
+{
+    map_t demo = MAP_INIT(&demo);
+    snapshot_t ss = SNAPSHOT_INIT(&ss);
+    snapshot_report_t report;
+    bool ret;
+
+    (void)ret;
+
+    for (int i = 1; i <= 100000; ++i)
+        cmap->insert(&demo, i, i);
+
+    ret = cds->map(&ss, &demo, "/tmp/demo_snapshot.map", HM_KV_INT); // true, the child writes the 100000 entries as they were now
+
+    for (int i = 1; i <= 100000; i += 2)
+        cmap->remove(&demo, i);        // the parent keeps going, copy-on-write keeps the child's view intact
+
+    ret = cds->wait(&ss, &report);     // true
+    pr_test("records [ %lu ], bytes [ %lu ], duration [ %lu us ], cow [ %lu / %lu ] = %.3f", 
+            (unsigned long)report.records, (unsigned long)report.bytes, (unsigned long)report.duration_us, 
+            (unsigned long)report.cow_bytes, (unsigned long)report.rss_bytes, report.cow_amplification); // records [ 100000 ], ...
+
+    SNAPSHOT_DEINIT(&ss);
+    MAP_DEINIT(&demo);
+    unlink("/tmp/demo_snapshot.map");
+}
+
+static void demo_about_hashmap(void)
+{
+    hashmap_t demo = HASHMAP_INIT(&demo);
+    snapshot_t ss = SNAPSHOT_INIT(&ss);
+    snapshot_report_t report;
+    bool ret;
+
+    (void)ret;
+
+    for (int i = 1; i <= 100000; ++i)
+        chashmap->insert(&demo, i, i);
+
+    ret = cds->hashmap(&ss, &demo, "/tmp/demo_snapshot.img", HM_KV_INT); // true
+    while (!cds->done(&ss))
+        chashmap->insert_replace(&demo, 1, -1); // keep writing until the child is done
+    ret = cds->wait(&ss, &report);     // true
+    pr_test("records [ %lu ], status [ %d ]", (unsigned long)report.records, report.status); // records [ 100000 ], status [ 0 ]
+
+    SNAPSHOT_DEINIT(&ss);
+    HASHMAP_DEINIT(&demo);
+    unlink("/tmp/demo_snapshot.img");
+}
+
+int main(void)
+{
+    demo_about_map();
+    demo_about_hashmap();
+    return 0;
+}
@@ -0,0 +1,783 @@
+/*
+  Flat Map and Set
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <flat/flat.h>
+
+#include <string.h>
+#include <_memory.h>
+#include <sort/sort.h>
+#include <linux/_compiler.h>
+#include <iterator/iterator.h>
+
+#define FLAT_CAPACITY_MIN (8)
+
+/* log2 of the ds_data_t an entry takes: a pair in map mode, a value in set mode */
+static __always_inline uint32_t __flat_shift(const flat_t* _this)
+{
+    return _this->config.c.b_set ? 0 : 1;
+}
+
+static __always_inline flat_size_t __flat_size(const flat_t* _this)
+{
+    return _this->vec.size >> __flat_shift(_this);
+}
+
+static __always_inline ds_data_t* __flat_at(const flat_t* _this, flat_size_t i)
+{
+    return &_this->vec.head[i << __flat_shift(_this)].data;
+}
+
+static __always_inline ds_data_t* __flat_end(const flat_t* _this)
+{
+    return (ds_data_t*)iterator_end();
+}
+
+static __always_inline ds_data_t* __flat_rend(const flat_t* _this)
+{
+    return (ds_data_t*)iterator_rend();
+}
+
+static __always_inline bool __flat_raw(const flat_t* _this)
+{
+    return is_null(_this->ops) || is_null(_this->ops->__lt);
+}
+
+static __always_inline bool __flat_lt(const flat_t* _this, flat_key_t left, flat_key_t right)
+{
+    return __flat_raw(_this) ? left < right : _this->ops->__lt(left, right);
+}
+
+static bool __flat_lt_default(ds_data_t left, ds_data_t right)
+{
+    return left < right;
+}
+
+/* Index of the entry `it` points to, false if it isn't one */
+static __always_inline bool __flat_locate(const flat_t* _this, const void* it, flat_size_t* i)
+{
+    flat_size_t d = (const vector_node_t*)it - _this->vec.head;
+
+    if (d < 0 || d >= _this->vec.size || 0 != (d & ((1 << __flat_shift(_this)) - 1)))
+        return false;
+
+    *i = d >> __flat_shift(_this);
+    return true;
+}
+
+/* Count of keys lt `key`, or le `key` when `upper`. The range is halved down to one entry
+   without an early exit, which leaves the loop a conditional move per step */
+static flat_size_t __flat_rank(const flat_t* _this, flat_key_t key, bool upper)
+{
+    const vector_node_t* head = _this->vec.head;
+    const vector_node_t* base = head;
+    uint32_t shift = __flat_shift(_this);
+    flat_size_t n = __flat_size(_this);
+    flat_size_t half = 0;
+
+    if (n <= 0)
+        return 0;
+
+    if (__flat_raw(_this)) {
+        while (n > 1) {
+            half = n >> 1;
+            base = (upper ? base[half << shift].data <= key : base[half << shift].data < key) ? base + (half << shift) : base;
+            n -= half;
+        }
+        return ((base - head) >> shift) + (upper ? base->data <= key : base->data < key);
+    }
+
+    while (n > 1) {
+        half = n >> 1;
+        if (upper ? !_this->ops->__lt(key, base[half << shift].data) : _this->ops->__lt(base[half << shift].data, key))
+            base += half << shift;
+        n -= half;
+    }
+    return ((base - head) >> shift) + (upper ? !_this->ops->__lt(key, base->data) : _this->ops->__lt(base->data, key));
+}
+
+static __always_inline bool __flat_valid(const flat_t* _this, flat_key_t key, flat_value_t value)
+{
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return false;
+
+    if (!_this->config.c.b_set && !is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
+        return false;
+
+    return true;
+}
+
+/* Copies of `key` and `value` into `kv` */
+static bool __flat_fill(const flat_t* _this, ds_data_t* kv, flat_key_t key, flat_value_t value)
+{
+    if (is_null(_this->ops) || is_null(_this->ops->copy_key)) {
+        kv[0] = key;
+    } else {
+        if (!_this->ops->copy_key(key, &kv[0]))
+            return false;
+    }
+
+    if (_this->config.c.b_set)
+        return true;
+
+    if (is_null(_this->ops) || is_null(_this->ops->copy_value)) {
+        kv[1] = value;
+    } else {
+        if (!_this->ops->copy_value(value, &kv[1])) {
+            if (!is_null(_this->ops->free_key))
+                _this->ops->free_key(&kv[0]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static __always_inline void __flat_free_kv(const flat_t* _this, ds_data_t* kv)
+{
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+        _this->ops->free_key(&kv[0]);
+
+    if (!_this->config.c.b_set && !is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&kv[1]);
+}
+
+/* Copy `key` and `value` into a gap opened at `i` by shifting the tail, doubling the
+   capacity of the vector if it's full */
+static ds_data_t* __flat_insert_at(flat_t* _this, flat_size_t i, flat_key_t key, flat_value_t value)
+{
+    vector_t* vec = &_this->vec;
+    uint32_t shift = __flat_shift(_this);
+    ds_data_t tmp[2] = { 0, 0 };
+    ds_data_t* kv = NULL;
+
+    if (!__flat_fill(_this, tmp, key, value))
+        return NULL;
+
+    if (vec->size + (1 << shift) > vec->capacity && !cvector->reserve(vec, vec->size < FLAT_CAPACITY_MIN ? FLAT_CAPACITY_MIN : vec->size << 1)) {
+        __flat_free_kv(_this, tmp);
+        return NULL;
+    }
+
+    memmove(&vec->head[(i + 1) << shift], &vec->head[i << shift], (vec->size - (i << shift)) * sizeof(vector_node_t));
+    vec->size += 1 << shift;
+
+    kv = __flat_at(_this, i);
+    memcpy(kv, tmp, sizeof(ds_data_t) << shift);
+    return kv;
+}
+
+static __always_inline flat_size_t _flat_size(const flat_t* _this)
+{
+    if (unlikely(is_null(_this)))
+        return -1;
+    return __flat_size(_this);
+}
+
+static ds_data_t* _flat_begin(const flat_t* _this)
+{
+    if (unlikely(is_null(_this)))
+        return NULL;
+    return __flat_size(_this) > 0 ? __flat_at(_this, 0) : __flat_end(_this);
+}
+
+static ds_data_t* _flat_next(const flat_t* _this, const ds_data_t* kv)
+{
+    flat_size_t i = 0;
+
+    if (unlikely(is_null(_this) || is_null(kv)))
+        return NULL;
+
+    /* The input parameter is `iterator`, and there's no need
+       to check whether it equals `rend` */
+    if (__flat_size(_this) <= 0 || __flat_end(_this) == kv)
+        return __flat_end(_this);
+
+    if (unlikely(!__flat_locate(_this, kv, &i)))
+        return NULL;
+    return i + 1 < __flat_size(_this) ? __flat_at(_this, i + 1) : __flat_end(_this);
+}
+
+static ds_data_t* _flat_prev(const flat_t* _this, const ds_data_t* kv)
+{
+    flat_size_t i = 0;
+
+    if (unlikely(is_null(_this) || is_null(kv)))
+        return NULL;
+
+    if (__flat_size(_this) <= 0)
+        return __flat_end(_this);
+
+    if (__flat_end(_this) == kv)
+        return __flat_at(_this, __flat_size(_this) - 1);
+
+    if (unlikely(!__flat_locate(_this, kv, &i)))
+        return NULL;
+    return i > 0 ? __flat_at(_this, i - 1) : __flat_end(_this);
+}
+
+static ds_data_t* _flat_rbegin(const flat_t* _this)
+{
+    if (unlikely(is_null(_this)))
+        return NULL;
+    return __flat_size(_this) > 0 ? __flat_at(_this, __flat_size(_this) - 1) : __flat_rend(_this);
+}
+
+static ds_data_t* _flat_rnext(const flat_t* _this, const ds_data_t* kv)
+{
+    flat_size_t i = 0;
+
+    if (unlikely(is_null(_this) || is_null(kv)))
+        return NULL;
+
+    /* The input parameter is `reverse_iterator`, and there's no need
+       to check whether it equals `end` */
+    if (__flat_size(_this) <= 0 || __flat_rend(_this) == kv)
+        return __flat_rend(_this);
+
+    if (unlikely(!__flat_locate(_this, kv, &i)))
+        return NULL;
+    return i > 0 ? __flat_at(_this, i - 1) : __flat_rend(_this);
+}
+
+static ds_data_t* _flat_rprev(const flat_t* _this, const ds_data_t* kv)
+{
+    flat_size_t i = 0;
+
+    if (unlikely(is_null(_this) || is_null(kv)))
+        return NULL;
+
+    if (__flat_size(_this) <= 0)
+        return __flat_rend(_this);
+
+    if (__flat_rend(_this) == kv)
+        return __flat_at(_this, 0);
+
+    if (unlikely(!__flat_locate(_this, kv, &i)))
+        return NULL;
+    return i + 1 < __flat_size(_this) ? __flat_at(_this, i + 1) : __flat_rend(_this);
+}
+
+static ds_data_t* flat_find(const flat_t* _this, flat_key_t key)
+{
+    flat_size_t i = 0;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return __flat_end(_this);
+
+    i = __flat_rank(_this, key, false);
+    if (i < __flat_size(_this) && !__flat_lt(_this, key, *__flat_at(_this, i)))
+        return __flat_at(_this, i);
+    return __flat_end(_this);
+}
+
+static flat_count_t flat_count(const flat_t* _this, flat_key_t key)
+{
+    ds_data_t* kv = flat_find(_this, key);
+
+    if (unlikely(is_null(kv)))
+        return -1;
+    return __flat_end(_this) == kv ? 0 : 1;
+}
+
+static ds_data_t* __flat_bound(const flat_t* _this, flat_key_t key, bool upper)
+{
+    flat_size_t i = 0;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return __flat_end(_this);
+
+    i = __flat_rank(_this, key, upper);
+    return i < __flat_size(_this) ? __flat_at(_this, i) : __flat_end(_this);
+}
+
+static ds_data_t* flat_lower_bound(const flat_t* _this, flat_key_t key)
+{
+    return __flat_bound(_this, key, false);
+}
+
+static ds_data_t* flat_upper_bound(const flat_t* _this, flat_key_t key)
+{
+    return __flat_bound(_this, key, true);
+}
+
+static ds_data_t* __flat_insert(flat_t* _this, flat_key_t key, flat_value_t value, bool replace)
+{
+    flat_value_t v = 0;
+    ds_data_t* kv = NULL;
+    flat_size_t i = 0;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (!__flat_valid(_this, key, value))
+        return NULL;
+
+    i = __flat_rank(_this, key, false);
+    if (i >= __flat_size(_this) || __flat_lt(_this, key, *__flat_at(_this, i)))
+        return __flat_insert_at(_this, i, key, value);
+
+    if (!replace)
+        return NULL;
+
+    kv = __flat_at(_this, i);
+    if (is_null(_this->ops) || is_null(_this->ops->copy_value)) {
+        v = value;
+    } else {
+        if (!_this->ops->copy_value(value, &v))
+            return NULL;
+    }
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&kv[1]);
+    kv[1] = v;
+    return kv;
+}
+
+static ds_data_t* flat_insert(flat_t* _this, flat_key_t key, flat_value_t value)
+{
+    return __flat_insert(_this, key, value, false);
+}
+
+static ds_data_t* flat_insert_replace(flat_t* _this, flat_key_t key, flat_value_t value)
+{
+    return __flat_insert(_this, key, value, true);
+}
+
+static ds_data_t* flat_insert_v(flat_t* _this, flat_key_t value)
+{
+    return __flat_insert(_this, value, 0, false);
+}
+
+static ds_data_t* flat_insert_hint(flat_t* _this, ds_data_t* hint, flat_key_t key, flat_value_t value)
+{
+    flat_size_t h = 0;
+
+    if (unlikely(is_null(_this) || is_null(hint)))
+        return NULL;
+
+    if (__flat_end(_this) == hint)
+        h = __flat_size(_this);
+    else if (!__flat_locate(_this, hint, &h))
+        return __flat_insert(_this, key, value, false);
+
+    if (!__flat_valid(_this, key, value))
+        return NULL;
+
+    if ((0 == h || __flat_lt(_this, *__flat_at(_this, h - 1), key)) && (__flat_size(_this) == h || __flat_lt(_this, key, *__flat_at(_this, h))))
+        return __flat_insert_at(_this, h, key, value);
+
+    return __flat_insert(_this, key, value, false);
+}
+
+static ds_data_t* flat_insert_hint_v(flat_t* _this, ds_data_t* hint, flat_key_t value)
+{
+    return flat_insert_hint(_this, hint, value, 0);
+}
+
+static ds_data_t* flat_erase(flat_t* _this, ds_data_t* kv)
+{
+    vector_node_t* head = NULL;
+    uint32_t shift = 0;
+    flat_size_t i = 0;
+
+    if (unlikely(is_null(_this) || is_null(kv)))
+        return NULL;
+
+    /* The input parameter is `iterator`, and there's no need
+       to check whether it equals `rend` */
+    if (__flat_size(_this) <= 0 || __flat_end(_this) == kv)
+        return NULL;
+
+    if (unlikely(!__flat_locate(_this, kv, &i)))
+        return NULL;
+
+    __flat_free_kv(_this, kv);
+
+    head = _this->vec.head;
+    shift = __flat_shift(_this);
+    cvector->erase_range(&_this->vec, (vector_iterator_t*)&head[i << shift], (vector_iterator_t*)&head[(i + 1) << shift]);
+    return i < __flat_size(_this) ? __flat_at(_this, i) : __flat_end(_this);
+}
+
+static flat_size_t flat_remove(flat_t* _this, flat_key_t key)
+{
+    ds_data_t* kv = flat_find(_this, key);
+
+    if (unlikely(is_null(kv)))
+        return -1;
+
+    if (__flat_end(_this) == kv)
+        return 0;
+
+    flat_erase(_this, kv);
+    return 1;
+}
+
+/* One pass packing the kept entries to the front */
+static flat_size_t __flat_remove_if(flat_t* _this, remove_if_condition_kv cond_kv, remove_if_condition_v cond_v)
+{
+    uint32_t shift = 0;
+    ds_data_t* kv = NULL;
+    flat_size_t i, j, n;
+
+    if (unlikely(is_null(_this) || (is_null(cond_kv) && is_null(cond_v))))
+        return -1;
+
+    shift = __flat_shift(_this);
+    n = __flat_size(_this);
+    for (i = 0, j = 0; i < n; ++i) {
+        kv = __flat_at(_this, i);
+        if (is_null(cond_kv) ? cond_v(kv[0]) : cond_kv(kv[0], kv[1])) {
+            __flat_free_kv(_this, kv);
+            continue;
+        }
+
+        if (i != j)
+            memcpy(__flat_at(_this, j), kv, sizeof(ds_data_t) << shift);
+        j++;
+    }
+
+    _this->vec.size = j << shift;
+    return n - j;
+}
+
+static flat_size_t flat_remove_if(flat_t* _this, remove_if_condition_kv cond)
+{
+    return __flat_remove_if(_this, cond, NULL);
+}
+
+static flat_size_t flat_remove_if_v(flat_t* _this, remove_if_condition_v cond)
+{
+    return __flat_remove_if(_this, NULL, cond);
+}
+
+static flat_size_t flat_clear(flat_t* _this)
+{
+    flat_size_t ret = 0;
+    flat_size_t i = 0;
+
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    ret = __flat_size(_this);
+    for (i = 0; i < ret; ++i)
+        __flat_free_kv(_this, __flat_at(_this, i));
+
+    cvector->clear(&_this->vec);
+    return ret;
+}
+
+/* The input is laid out in the vector and sorted there if it isn't, the first of equal
+   keys is then copied in place */
+static flat_size_t __flat_build_sorted(flat_t* _this, const flat_key_t* keys, const flat_value_t* values, flat_size_t n)
+{
+    uint32_t shift = 0;
+    ds_data_t tmp[2] = { 0, 0 };
+    ds_data_t* kv = NULL;
+    flat_size_t i, m = 0;
+
+    if (unlikely(is_null(_this) || n < 0 || (n > 0 && is_null(keys))))
+        return -1;
+
+    if (__flat_size(_this) > 0)
+        return -1;
+
+    for (i = 0; i < n; ++i)
+        if (!__flat_valid(_this, keys[i], is_null(values) ? 0 : values[i]))
+            return -1;
+
+    shift = __flat_shift(_this);
+    if (!cvector->reserve(&_this->vec, n << shift))
+        return -1;
+
+    for (i = 0; i < n; ++i) {
+        kv = __flat_at(_this, i);
+        kv[0] = keys[i];
+        if (!_this->config.c.b_set)
+            kv[1] = is_null(values) ? 0 : values[i];
+    }
+
+    for (i = 1; i < n && !__flat_lt(_this, keys[i], keys[i - 1]); ++i)
+        ;
+
+    if (i < n && !__sort_merge_n(__flat_at(_this, 0), n, 1 << shift, __flat_raw(_this) ? __flat_lt_default : _this->ops->__lt))
+        return -1;
+
+    for (i = 0; i < n; ++i) {
+        kv = __flat_at(_this, i);
+        if (m > 0 && !__flat_lt(_this, *__flat_at(_this, m - 1), kv[0]))
+            continue;
+
+        if (!__flat_fill(_this, tmp, kv[0], _this->config.c.b_set ? 0 : kv[1])) {
+            _this->vec.size = m << shift;
+            flat_clear(_this);
+            return -1;
+        }
+
+        memcpy(__flat_at(_this, m++), tmp, sizeof(ds_data_t) << shift);
+    }
+
+    _this->vec.size = m << shift;
+    return m;
+}
+
+static flat_size_t flat_build_sorted(flat_t* _this, const flat_key_t* keys, const flat_value_t* values, flat_size_t n)
+{
+    return __flat_build_sorted(_this, keys, values, n);
+}
+
+static flat_size_t flat_build_sorted_v(flat_t* _this, const flat_key_t* values, flat_size_t n)
+{
+    return __flat_build_sorted(_this, values, NULL, n);
+}
+
+static flat_size_t flat_rank(const flat_t* _this, flat_key_t key)
+{
+    if (unlikely(is_null(_this)))
+        return -1;
+    return __flat_rank(_this, key, false);
+}
+
+static ds_data_t* flat_select(const flat_t* _this, flat_size_t k)
+{
+    if (unlikely(is_null(_this)))
+        return NULL;
+    return k >= 0 && k < __flat_size(_this) ? __flat_at(_this, k) : __flat_end(_this);
+}
+
+static flat_size_t flat_count_range(const flat_t* _this, flat_key_t lo, flat_key_t hi)
+{
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    if (!__flat_lt(_this, lo, hi))
+        return 0;
+    return __flat_rank(_this, hi, false) - __flat_rank(_this, lo, false);
+}
+
+static ds_data_t* flat_equal_range(const flat_t* _this, flat_key_t key, ds_data_t** last)
+{
+    flat_size_t i = 0;
+
+    if (unlikely(is_null(_this) || is_null(last)))
+        return NULL;
+
+    i = __flat_rank(_this, key, false);
+    if (i >= __flat_size(_this)) {
+        *last = __flat_end(_this);
+        return *last;
+    }
+
+    *last = __flat_lt(_this, key, *__flat_at(_this, i)) ? __flat_at(_this, i) : flat_select(_this, i + 1);
+    return __flat_at(_this, i);
+}
+
+static flat_size_t flat_erase_range(flat_t* _this, flat_key_t lo, flat_key_t hi)
+{
+    vector_node_t* head = NULL;
+    uint32_t shift = 0;
+    flat_size_t i, j, k;
+
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    if (!__flat_lt(_this, lo, hi))
+        return 0;
+
+    i = __flat_rank(_this, lo, false);
+    j = __flat_rank(_this, hi, false);
+    if (i >= j)
+        return 0;
+
+    for (k = i; k < j; ++k)
+        __flat_free_kv(_this, __flat_at(_this, k));
+
+    head = _this->vec.head;
+    shift = __flat_shift(_this);
+    cvector->erase_range(&_this->vec, (vector_iterator_t*)&head[i << shift], (vector_iterator_t*)&head[j << shift]);
+    return j - i;
+}
+
+static flat_size_t __flat_for_each_range(const flat_t* _this, flat_key_t lo, flat_key_t hi, for_each_kv cb_kv, for_each_v cb_v, void* arg)
+{
+    flat_size_t ret = 0;
+    ds_data_t* kv = NULL;
+    flat_size_t i = 0;
+
+    if (unlikely(is_null(_this) || (is_null(cb_kv) && is_null(cb_v))))
+        return -1;
+
+    for (i = __flat_rank(_this, lo, false); i < __flat_size(_this); ++i) {
+        kv = __flat_at(_this, i);
+        if (!__flat_lt(_this, kv[0], hi))
+            break;
+
+        ret++;
+        if (!(is_null(cb_kv) ? cb_v(kv[0], arg) : cb_kv(kv[0], kv[1], arg)))
+            break;
+    }
+    return ret;
+}
+
+static flat_size_t flat_for_each_range(const flat_t* _this, flat_key_t lo, flat_key_t hi, for_each_kv cb, void* arg)
+{
+    return __flat_for_each_range(_this, lo, hi, cb, NULL, arg);
+}
+
+static flat_size_t flat_for_each_range_v(const flat_t* _this, flat_key_t lo, flat_key_t hi, for_each_v cb, void* arg)
+{
+    return __flat_for_each_range(_this, lo, hi, NULL, cb, arg);
+}
+
+static bool flat_reserve(flat_t* _this, flat_size_t n)
+{
+    if (unlikely(is_null(_this) || n < 0))
+        return false;
+    return cvector->reserve(&_this->vec, n << __flat_shift(_this));
+}
+
+/* __always_inline */ inline void __flat_init(flat_t* flat, const class_map_ops_t* ops)
+{
+    flat->ops = ops;
+    memset(&flat->ops_set, 0, sizeof(flat->ops_set));
+    flat->vec = VECTOR_INIT(&flat->vec);
+    flat->config.d = 0;
+}
+
+/* __always_inline */ inline void __flat_init_set(flat_t* flat, const class_set_ops_t* ops)
+{
+    __flat_init(flat, NULL);
+    flat->config.c.b_set = 1;
+
+    if (is_null(ops))
+        return;
+
+    flat->ops_set.valid_key = ops->valid_value;
+    flat->ops_set.__lt      = ops->__lt_value;
+    flat->ops_set.__cmp     = ops->__cmp_value;
+    flat->ops_set.copy_key  = ops->copy_value;
+    flat->ops_set.free_key  = ops->free_value;
+    flat->ops = &flat->ops_set;
+}
+
+/* __always_inline */ inline void __flat_deinit(flat_t* flat)
+{
+    flat_clear(flat);
+    __vector_deinit(&flat->vec);
+    __flat_init(flat, NULL);
+}
+
+typedef map_iterator_t* (*fm_fp_end)(const flat_t* _this);
+typedef map_iterator_t* (*fm_fp_begin)(const flat_t* _this);
+typedef map_iterator_t* (*fm_fp_next)(const flat_t* _this, const map_iterator_t* iterator);
+typedef map_r_iterator_t* (*fm_fp_rend)(const flat_t* _this);
+typedef map_r_iterator_t* (*fm_fp_rnext)(const flat_t* _this, const map_r_iterator_t* r_iterator);
+typedef map_iterator_t* (*fm_fp_find)(const flat_t* _this, flat_key_t key);
+typedef map_iterator_t* (*fm_fp_insert)(flat_t* _this, flat_key_t key, flat_value_t value);
+typedef map_iterator_t* (*fm_fp_erase)(flat_t* _this, map_iterator_t* iterator);
+typedef map_iterator_t* (*fm_fp_select)(const flat_t* _this, flat_size_t k);
+typedef map_iterator_t* (*fm_fp_insert_hint)(flat_t* _this, map_iterator_t* hint, flat_key_t key, flat_value_t value);
+typedef map_iterator_t* (*fm_fp_equal_range)(const flat_t* _this, flat_key_t key, map_iterator_t** last);
+
+typedef set_iterator_t* (*fs_fp_end)(const flat_t* _this);
+typedef set_iterator_t* (*fs_fp_begin)(const flat_t* _this);
+typedef set_iterator_t* (*fs_fp_next)(const flat_t* _this, const set_iterator_t* iterator);
+typedef set_r_iterator_t* (*fs_fp_rend)(const flat_t* _this);
+typedef set_r_iterator_t* (*fs_fp_rnext)(const flat_t* _this, const set_r_iterator_t* r_iterator);
+typedef set_iterator_t* (*fs_fp_find)(const flat_t* _this, flat_key_t value);
+typedef set_iterator_t* (*fs_fp_insert)(flat_t* _this, flat_key_t value);
+typedef set_iterator_t* (*fs_fp_erase)(flat_t* _this, set_iterator_t* iterator);
+typedef set_iterator_t* (*fs_fp_select)(const flat_t* _this, flat_size_t k);
+typedef set_iterator_t* (*fs_fp_insert_hint)(flat_t* _this, set_iterator_t* hint, flat_key_t value);
+typedef set_iterator_t* (*fs_fp_equal_range)(const flat_t* _this, flat_key_t value, set_iterator_t** last);
+
+const class_flat_map_t* class_flat_map_ins(void)
+{
+    static const class_flat_map_t ins = {
+        .size           = _flat_size,
+        .count          = flat_count,
+        .end            = (fm_fp_end)__flat_end,
+        .begin          = (fm_fp_begin)_flat_begin,
+        .next           = (fm_fp_next)_flat_next,
+        .prev           = (fm_fp_next)_flat_prev,
+        .rend           = (fm_fp_rend)__flat_rend,
+        .rbegin         = (fm_fp_rend)_flat_rbegin,
+        .rnext          = (fm_fp_rnext)_flat_rnext,
+        .rprev          = (fm_fp_rnext)_flat_rprev,
+        .find           = (fm_fp_find)flat_find,
+        .lower_bound    = (fm_fp_find)flat_lower_bound,
+        .upper_bound    = (fm_fp_find)flat_upper_bound,
+        .insert         = (fm_fp_insert)flat_insert,
+        .insert_replace = (fm_fp_insert)flat_insert_replace,
+        .erase          = (fm_fp_erase)flat_erase,
+        .remove         = flat_remove,
+        .remove_if      = flat_remove_if,
+        .clear          = flat_clear,
+        .build_sorted   = flat_build_sorted,
+        .rank           = flat_rank,
+        .select         = (fm_fp_select)flat_select,
+        .count_range    = flat_count_range,
+        .insert_hint    = (fm_fp_insert_hint)flat_insert_hint,
+        .equal_range    = (fm_fp_equal_range)flat_equal_range,
+        .erase_range    = flat_erase_range,
+        .for_each_range = flat_for_each_range,
+        .reserve        = flat_reserve,
+    };
+    return &ins;
+}
+
+const class_flat_set_t* class_flat_set_ins(void)
+{
+    static const class_flat_set_t ins = {
+        .size           = _flat_size,
+        .count          = flat_count,
+        .end            = (fs_fp_end)__flat_end,
+        .begin          = (fs_fp_begin)_flat_begin,
+        .next           = (fs_fp_next)_flat_next,
+        .prev           = (fs_fp_next)_flat_prev,
+        .rend           = (fs_fp_rend)__flat_rend,
+        .rbegin         = (fs_fp_rend)_flat_rbegin,
+        .rnext          = (fs_fp_rnext)_flat_rnext,
+        .rprev          = (fs_fp_rnext)_flat_rprev,
+        .find           = (fs_fp_find)flat_find,
+        .lower_bound    = (fs_fp_find)flat_lower_bound,
+        .upper_bound    = (fs_fp_find)flat_upper_bound,
+        .insert         = (fs_fp_insert)flat_insert_v,
+        .erase          = (fs_fp_erase)flat_erase,
+        .remove         = flat_remove,
+        .remove_if      = flat_remove_if_v,
+        .clear          = flat_clear,
+        .build_sorted   = flat_build_sorted_v,
+        .rank           = flat_rank,
+        .select         = (fs_fp_select)flat_select,
+        .count_range    = flat_count_range,
+        .insert_hint    = (fs_fp_insert_hint)flat_insert_hint_v,
+        .equal_range    = (fs_fp_equal_range)flat_equal_range,
+        .erase_range    = flat_erase_range,
+        .for_each_range = flat_for_each_range_v,
+        .reserve        = flat_reserve,
+    };
+    return &ins;
+}
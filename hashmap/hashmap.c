@@ -24,6 +24,7 @@
 #include <stdarg.h>
 #include <_log.h>
 #include <_memory.h>
+#include <_handle.h>
 #include <linux/_compiler.h>
 #include <iterator/iterator.h>
 
@@ -96,9 +97,16 @@ static __always_inline hashmap_bcount_t _hashmap_bucket_valid_count(const hashma
     return __hashmap_bucket_valid_count(_this);
 }
 
+#include <../hashmap/hashmap_compact.c>
+
 static /* __always_inline */ inline hashmap_count_t hashmap_count(const hashmap_t* _this, hashmap_key_t key)
 {
-    hashmap_bnode_t* n = hashmap_find(_this, key);
+    hashmap_bnode_t* n;
+
+    if (!is_null(_this) && __hashmap_compact(_this))
+        return __hmc_end(_this) != __hmc_find(_this, key) ? 1 : 0;
+
+    n = hashmap_find(_this, key);
     return is_null(n) ? -1 : __hashmap_end(_this) != n ? 1 : 0;
 }
 
@@ -171,6 +179,8 @@ static /* __always_inline */ inline hashmap_bnode_t* _hashmap_begin(const hashma
 {
     if (unlikely(is_null(_this)))
         return NULL;
+    if (__hashmap_compact(_this))
+        return (hashmap_bnode_t*)__hmc_begin(_this);
     return __hashmap_begin(_this);
 }
 
@@ -210,6 +220,8 @@ static /* __always_inline */ inline hashmap_bnode_t* _hashmap_next(const hashmap
 {
     if (unlikely(is_null(_this) || is_null(node)))
         return NULL;
+    if (__hashmap_compact(_this))
+        return (hashmap_bnode_t*)_hmc_next(_this, (const hashmap_cnode_t*)node);
     return __hashmap_next(_this, node);
 }
 
@@ -250,6 +262,8 @@ static /* __always_inline */ inline hashmap_bnode_t* _hashmap_prev(const hashmap
 {
     if (unlikely(is_null(_this) || is_null(node)))
         return NULL;
+    if (__hashmap_compact(_this))
+        return (hashmap_bnode_t*)_hmc_prev(_this, (const hashmap_cnode_t*)node);
     return __hashmap_prev(_this, node);
 }
 
@@ -282,6 +296,8 @@ static /* __always_inline */ inline hashmap_bnode_t* _hashmap_rbegin(const hashm
 {
     if (unlikely(is_null(_this)))
         return NULL;
+    if (__hashmap_compact(_this))
+        return (hashmap_bnode_t*)__hmc_rbegin(_this);
     return __hashmap_rbegin(_this);
 }
 
@@ -321,6 +337,8 @@ static /* __always_inline */ inline hashmap_bnode_t* _hashmap_rnext(const hashma
 {
     if (unlikely(is_null(_this) || is_null(node)))
         return NULL;
+    if (__hashmap_compact(_this))
+        return (hashmap_bnode_t*)_hmc_rnext(_this, (const hashmap_cnode_t*)node);
     return __hashmap_rnext(_this, node);
 }
 
@@ -361,6 +379,8 @@ static /* __always_inline */ inline hashmap_bnode_t* _hashmap_rprev(const hashma
 {
     if (unlikely(is_null(_this) || is_null(node)))
         return NULL;
+    if (__hashmap_compact(_this))
+        return (hashmap_bnode_t*)_hmc_rprev(_this, (const hashmap_cnode_t*)node);
     return __hashmap_rprev(_this, node);
 }
 
@@ -381,6 +401,9 @@ static inline hashmap_bnode_t* hashmap_find(const hashmap_t* _this, hashmap_key_
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
         return NULL;
 
+    if (__hashmap_compact(_this))
+        return (hashmap_bnode_t*)__hmc_find(_this, key);
+
     if (is_null(_this->ops) || is_null(_this->ops->__hash))
         hash = key;
     else
@@ -427,11 +450,12 @@ static /* __always_inline */ inline void __hashmap_bucket_switch(hashmap_t* _thi
                 __hmbucket_size(bucket_sh));
 }
 
+/* `n_size` is `bucket_count` times a power of 2, so a node either stays or moves to a bucket past the old ones */
 static void __hashmap_rehash_resume(hashmap_t* _this, hashmap_node_t* n, hashmap_bcount_t n_size)
 {
     hashmap_node_t* p = n;
     hashmap_bcount_t bcnt_o = __hashmap_bucket_count(_this), bcnt_n = n_size;
-    hashmap_bcount_t idx_o, idx_n, idx_e;
+    hashmap_bcount_t idx_o, idx_n, idx_e, bits = (bcnt_n - 1) ^ (bcnt_o - 1);
     bucket_shell_t* bsh_o, * bsh_n;
     bucket_node_t* it, * bnode;
     hashmap_bcount_t vcnt_o = __hashmap_bucket_valid_count(_this), vcnt_n = 0;
@@ -452,13 +476,13 @@ static void __hashmap_rehash_resume(hashmap_t* _this, hashmap_node_t* n, hashmap
         vcnt_n++;
 
         for (it = hmbucket_begin(bsh_o); __hmbucket_end(bsh_o) != it; ) {
-            if (!(it->hash & bcnt_o)) { /* 2x expansion logic */
+            if (!(it->hash & bits)) {
                 it = hmbucket_next(bsh_o, it);
                 continue;
             }
 
-            idx_n = idx_o + bcnt_o; /* 2x expansion logic */
-            bsh_n = phmbkt((p + bcnt_o)->sh);
+            idx_n = it->hash & (bcnt_n - 1);
+            bsh_n = phmbkt((n + idx_n)->sh);
             if (___hmbucket_invalid(bsh_n)) {
                 __hashmap_bucket_init(_this, bsh_n);
                 vcnt_n++;
@@ -532,30 +556,17 @@ static /* __always_inline */ inline bool __hashmap_buckets_free(hashmap_t* _this
     return true;
 }
 
-static bool __hashmap_rehash(hashmap_t* _this)
+/* `rehash` follows the 2x bucket_count expansion logic by default, `reserve` jumps to `bcnt_n` at once */
+static bool __hashmap_rehash_expand(hashmap_t* _this, hashmap_bcount_t bcnt_n)
 {
     hashmap_node_t* n = NULL;
-    hashmap_bcount_t bcnt_n, bcnt_o = __hashmap_bucket_count(_this);
-
-    if (is_null(_this->head))
-        return __hashmap_buckets_init_alloc(_this);
-
-    if (__hashmap_size(_this) <= bcnt_o * _this->load_factor)
-        return true;
-
-    /* The upper limit has already been reached, keep it */
-    if (bcnt_o >= _this->bucket_count_max)
-        return true;
-
-    /* `rehash` follows the 2x bucket_count expansion logic by default. 
-       If multi-fold expansion is used, the logic needs to be checked */
-    bcnt_n = bcnt_o << 1;
+    hashmap_bcount_t bcnt_o = __hashmap_bucket_count(_this);
 
     n = p_realloc(_this->head, bcnt_n * sizeof(hashmap_node_t));
     if (is_null(n))
         goto err;
 
-    memset(n + bcnt_o, 0, bcnt_o * sizeof(hashmap_node_t));
+    memset(n + bcnt_o, 0, (bcnt_n - bcnt_o) * sizeof(hashmap_node_t));
 
     pr_debug("Preparing for rehash, current [ %zd > %lf(%zd * %f) ], max [ %zd ]", 
                 __hashmap_size(_this), bcnt_o * _this->load_factor, 
@@ -578,7 +589,50 @@ err:
     return false;
 }
 
-static hashmap_bnode_t* hashmap_insert(hashmap_t* _this, hashmap_key_t key, hashmap_value_t value)
+static bool __hashmap_rehash(hashmap_t* _this)
+{
+    hashmap_bcount_t bcnt_o = __hashmap_bucket_count(_this);
+
+    if (is_null(_this->head))
+        return __hashmap_buckets_init_alloc(_this);
+
+    if (__hashmap_size(_this) <= bcnt_o * _this->load_factor)
+        return true;
+
+    /* The upper limit has already been reached, keep it */
+    if (bcnt_o >= _this->bucket_count_max)
+        return true;
+
+    return __hashmap_rehash_expand(_this, bcnt_o << 1);
+}
+
+/* Links the node of `handle` unless `key` is there, reusing its memory */
+static bucket_node_t* __hashmap_bucket_insert_node(hashmap_t* _this, bucket_shell_t* bkt_sh, hashmap_hash_t hash, ds_node_handle_t* handle)
+{
+    bucket_node_t* t = hmbucket_find_hc_valid(bkt_sh, bucket_ops(_this), handle->key);
+
+    if (is_null(t) || __hmbucket_end(bkt_sh) != t)
+        return NULL;
+
+    t = (bucket_node_t*)ds_node_handle_take(handle, sizeof(bucket_node_t));
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    t->key = handle->key;
+    t->value = handle->value;
+    t->hash = hash;
+
+    if (t != hmbucket_insert_hc_same(bkt_sh, bucket_ops(_this), t)) {
+        ds_node_handle_put(handle, t, sizeof(bucket_node_t));
+        return NULL;
+    }
+
+    handle->full = false;
+    return t;
+}
+
+/* A new node of `key` and `value` copied, or the node of `handle` if it's not NULL */
+static hashmap_bnode_t* __hashmap_insert(hashmap_t* _this, hashmap_key_t key, hashmap_value_t value, ds_node_handle_t* handle)
 {
     hashmap_hash_t hash;
     hashmap_bcount_t idx;
@@ -586,15 +640,18 @@ static hashmap_bnode_t* hashmap_insert(hashmap_t* _this, hashmap_key_t key, hash
     bucket_node_t* bkt_node;
     bool f_head = false, f_bkt = false;
 
-    if (unlikely(is_null(_this)))
-        return NULL;
-
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
         return NULL;
 
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
         return NULL;
 
+    if (__hashmap_compact(_this) && !is_null(handle))
+        return (hashmap_bnode_t*)__hmc_insert_node(_this, handle);
+
+    if (__hashmap_compact(_this))
+        return (hashmap_bnode_t*)__hmc_insert(_this, key, value, false);
+
     if (is_null(_this->head)) {
         if (!__hashmap_buckets_init_alloc(_this))
             return NULL;
@@ -619,7 +676,10 @@ static hashmap_bnode_t* hashmap_insert(hashmap_t* _this, hashmap_key_t key, hash
         f_bkt = true;
     }
 
-    bkt_node = hmbucket_insert_hc_valid(bkt_sh, bucket_ops(_this), hash, key, value);
+    if (is_null(handle))
+        bkt_node = hmbucket_insert_hc_valid(bkt_sh, bucket_ops(_this), hash, key, value);
+    else
+        bkt_node = __hashmap_bucket_insert_node(_this, bkt_sh, hash, handle);
     if (is_null(bkt_node))
         goto err;
 
@@ -647,6 +707,14 @@ err:
     return NULL;
 }
 
+static hashmap_bnode_t* hashmap_insert(hashmap_t* _this, hashmap_key_t key, hashmap_value_t value)
+{
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    return __hashmap_insert(_this, key, value, NULL);
+}
+
 static hashmap_bnode_t* hashmap_insert_replace(hashmap_t* _this, hashmap_key_t key, hashmap_value_t value)
 {
     hashmap_hash_t hash;
@@ -665,6 +733,9 @@ static hashmap_bnode_t* hashmap_insert_replace(hashmap_t* _this, hashmap_key_t k
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
         return NULL;
 
+    if (__hashmap_compact(_this))
+        return (hashmap_bnode_t*)__hmc_insert(_this, key, value, true);
+
     if (is_null(_this->head)) {
         if (!__hashmap_buckets_init_alloc(_this))
             return NULL;
@@ -721,14 +792,18 @@ err:
     return NULL;
 }
 
-static hashmap_bnode_t* hashmap_erase(hashmap_t* _this, hashmap_bnode_t* pos)
+/* The node is freed, or moved into `handle` if it's not NULL */
+static hashmap_bnode_t* __hashmap_erase(hashmap_t* _this, hashmap_bnode_t* pos, ds_node_handle_t* handle)
 {
     hashmap_bcount_t i, idx, idx_e;
     bucket_shell_t* bkt_sh, * bkt_for;
     bucket_node_t* bkt_node, * ret;
 
-    if (unlikely(is_null(_this) || is_null(pos)))
-        return NULL;
+    if (__hashmap_compact(_this) && !is_null(handle))
+        return (hashmap_bnode_t*)__hmc_extract(_this, (hashmap_cnode_t*)pos, handle);
+
+    if (__hashmap_compact(_this))
+        return (hashmap_bnode_t*)__hmc_erase(_this, (hashmap_cnode_t*)pos);
 
     /* The input parameter is `iterator`, and there's no need to check whether it equals `rend` */
     if (__hashmap_size(_this) <= 0 || __hashmap_end(_this) == pos/* || __hashmap_rend(_this) == pos*/)
@@ -764,10 +839,20 @@ static hashmap_bnode_t* hashmap_erase(hashmap_t* _this, hashmap_bnode_t* pos)
        2. The `pos` belongs to this bucket, memory issues are detected.
        3. The `pos` doesn't belong to this bucket, erase normally.
        4. The `pos` doesn't belong to this bucket, memory issues are detected. */
-    bkt_node = hmbucket_erase(bkt_sh, bucket_ops(_this), pos);
+    if (is_null(handle))
+        bkt_node = hmbucket_erase(bkt_sh, bucket_ops(_this), pos);
+    else
+        bkt_node = hmbucket_pop(bkt_sh, pos);
     if (is_null(bkt_node))
         return NULL; /* Err: by bucket, but the erasing operation was not carried out */
 
+    if (!is_null(handle)) {
+        handle->key = pos->key;
+        handle->value = pos->value;
+        handle->full = true;
+        ds_node_handle_put(handle, pos, sizeof(bucket_node_t));
+    }
+
     _this->size--;
 
     if (__hmbucket_size(bkt_sh) <= UNTREEIFY_THRESHOLD && ___hmbucket_is_tree(bkt_sh))
@@ -781,6 +866,14 @@ static hashmap_bnode_t* hashmap_erase(hashmap_t* _this, hashmap_bnode_t* pos)
     return ret;
 }
 
+static hashmap_bnode_t* hashmap_erase(hashmap_t* _this, hashmap_bnode_t* pos)
+{
+    if (unlikely(is_null(_this) || is_null(pos)))
+        return NULL;
+
+    return __hashmap_erase(_this, pos, NULL);
+}
+
 static inline hashmap_size_t hashmap_remove(hashmap_t* _this, hashmap_key_t key)
 {
     hashmap_size_t ret;
@@ -797,6 +890,9 @@ static inline hashmap_size_t hashmap_remove(hashmap_t* _this, hashmap_key_t key)
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
         return -1;
 
+    if (__hashmap_compact(_this))
+        return __hmc_remove(_this, key);
+
     if (is_null(_this->ops) || is_null(_this->ops->__hash))
         hash = key;
     else
@@ -835,6 +931,9 @@ static hashmap_size_t hashmap_clear(hashmap_t* _this)
     if (__hashmap_size(_this) <= 0)
         return 0;
 
+    if (__hashmap_compact(_this))
+        return __hmc_clear(_this);
+
     i     = _this->pi_s < 0 ? 0 : _this->pi_s;
     idx_e = _this->pi_e < 0 ? __hashmap_bucket_count(_this) - 1 : _this->pi_e;
     for (; i <= idx_e; ++i) {
@@ -866,6 +965,38 @@ static hashmap_size_t hashmap_clear(hashmap_t* _this)
     return ret; /* Returns the actual operation count */
 }
 
+/* The key, the value and the node memory go to `handle`, a compact hashmap keeps its pool node */
+static hashmap_bnode_t* hashmap_extract(hashmap_t* _this, hashmap_bnode_t* pos, ds_node_handle_t* handle)
+{
+    if (unlikely(is_null(_this) || is_null(pos) || is_null(handle) || handle->full))
+        return NULL;
+
+    return __hashmap_erase(_this, pos, handle);
+}
+
+/* On failure `handle` is left as it was */
+static hashmap_bnode_t* hashmap_insert_node(hashmap_t* _this, ds_node_handle_t* handle)
+{
+    if (unlikely(is_null(_this) || is_null(handle) || !handle->full))
+        return NULL;
+
+    return __hashmap_insert(_this, handle->key, handle->value, handle);
+}
+
+static void hashmap_free_node(hashmap_t* _this, ds_node_handle_t* handle)
+{
+    if (unlikely(is_null(_this) || is_null(handle)))
+        return;
+
+    if (handle->full && !is_null(_this->ops) && !is_null(_this->ops->free_key))
+        _this->ops->free_key(&handle->key);
+
+    if (handle->full && !is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&handle->value);
+
+    ds_node_handle_release(handle);
+}
+
 static hashmap_bcount_t bucket_count_correct(hashmap_bcount_t bucket_count)
 {
     uint8_t t = 0;
@@ -887,6 +1018,32 @@ static hashmap_bcount_t bucket_count_correct(hashmap_bcount_t bucket_count)
     return t > 1 ? ret << 1 : ret;
 }
 
+static hashmap_bcount_t hashmap_reserve(hashmap_t* _this, hashmap_size_t count)
+{
+    hashmap_bcount_t target;
+
+    if (unlikely(is_null(_this) || count < 0))
+        return -1;
+
+    target = bucket_count_correct((hashmap_bcount_t)(count / _this->load_factor) + 1);
+    if (target <= 0 || target > _this->bucket_count_max)
+        target = _this->bucket_count_max;
+
+    if (__hashmap_compact(_this))
+        return __hmc_reserve(_this, count, target) ? (is_null(_this->chead) ? _this->bucket_count_init : __hashmap_bucket_count(_this)) : -1;
+
+    /* Nothing is allocated yet, only the initial bucket count needs to be raised */
+    if (is_null(_this->head)) {
+        if (target > _this->bucket_count_init)
+            _this->bucket_count_init = target;
+        return _this->bucket_count_init;
+    }
+
+    if (__hashmap_bucket_count(_this) < target && !__hashmap_rehash_expand(_this, target))
+        return -1;
+    return __hashmap_bucket_count(_this);
+}
+
 /* __always_inline */ inline void __hashmap_init(hashmap_t* hashmap)
 {
     hashmap->head = NULL;
@@ -897,9 +1054,15 @@ static hashmap_bcount_t bucket_count_correct(hashmap_bcount_t bucket_count)
     hashmap->config.c.b_bkt_only_l = 0;
     hashmap->config.c.b_bkt_only_r = 0;
     hashmap->config.c.b_bkt_l_to_r = 1;
+    hashmap->config.c.b_compact = 0;
     hashmap->bucket_valid_count = 0;
     hashmap->pi_s = -1;
     hashmap->pi_e = -1;
+    hashmap->chead = NULL;
+    hashmap->pool = NULL;
+    hashmap->pool_cap = 0;
+    hashmap->pool_used = 0;
+    hashmap->pool_free = 0;
 }
 
 inline void __hashmap_init_arg(hashmap_t* hashmap, int num_arg, ...)
@@ -915,6 +1078,11 @@ inline void __hashmap_init_arg(hashmap_t* hashmap, int num_arg, ...)
     hashmap->bucket_valid_count = 0;
     hashmap->pi_s = -1;
     hashmap->pi_e = -1;
+    hashmap->chead = NULL;
+    hashmap->pool = NULL;
+    hashmap->pool_cap = 0;
+    hashmap->pool_used = 0;
+    hashmap->pool_free = 0;
 
     va_start(alist, num_arg);
     bucket_count_init = num_arg > 0 ? va_arg(alist, hashmap_bcount_t) : 0;
@@ -938,6 +1106,8 @@ inline void __hashmap_init_arg(hashmap_t* hashmap, int num_arg, ...)
         goto end;
     }
 
+    hashmap->config.c.b_compact = config->c.b_compact;
+
     if (config->c.b_bkt_only_l && !config->c.b_bkt_only_r && !config->c.b_bkt_l_to_r)
         hashmap->config.c.b_bkt_only_l = 1;
     else if (!config->c.b_bkt_only_l && config->c.b_bkt_only_r && !config->c.b_bkt_l_to_r)
@@ -955,7 +1125,10 @@ end:
 
 /* __always_inline */ inline void __hashmap_deinit(hashmap_t* hashmap)
 {
-    hashmap_clear(hashmap);
+    if (__hashmap_compact(hashmap))
+        __hmc_deinit(hashmap);
+    else
+        hashmap_clear(hashmap);
     p_free(hashmap->head);
 
     hashmap->ops = NULL;
@@ -969,6 +1142,11 @@ end:
     hashmap->bucket_valid_count = 0;
     hashmap->pi_s = -1;
     hashmap->pi_e = -1;
+    hashmap->chead = NULL;
+    hashmap->pool = NULL;
+    hashmap->pool_cap = 0;
+    hashmap->pool_used = 0;
+    hashmap->pool_free = 0;
 }
 
 typedef hashmap_iterator_t* (*hm_fp_end)(const hashmap_t* _this);
@@ -983,6 +1161,8 @@ typedef hashmap_iterator_t* (*hm_fp_find)(const hashmap_t* _this, hashmap_key_t
 typedef hashmap_iterator_t* (*hm_fp_insert)(hashmap_t* _this, hashmap_key_t key, hashmap_value_t value);
 typedef hashmap_iterator_t* (*hm_fp_insert_replace)(hashmap_t* _this, hashmap_key_t key, hashmap_value_t value);
 typedef hashmap_iterator_t* (*hm_fp_erase)(hashmap_t* _this, hashmap_iterator_t* iterator);
+typedef hashmap_iterator_t* (*hm_fp_extract)(hashmap_t* _this, hashmap_iterator_t* iterator, ds_node_handle_t* handle);
+typedef hashmap_iterator_t* (*hm_fp_insert_node)(hashmap_t* _this, ds_node_handle_t* handle);
 
 /* __always_inline */ inline const class_hashmap_t* class_hashmap_ins(void)
 {
@@ -1005,6 +1185,10 @@ typedef hashmap_iterator_t* (*hm_fp_erase)(hashmap_t* _this, hashmap_iterator_t*
         .erase              = (hm_fp_erase)hashmap_erase,
         .remove             = hashmap_remove,
         .clear              = hashmap_clear,
+        .reserve            = hashmap_reserve,
+        .extract            = (hm_fp_extract)hashmap_extract,
+        .insert_node        = (hm_fp_insert_node)hashmap_insert_node,
+        .free_node          = hashmap_free_node,
     };
     return &ins;
 }
@@ -0,0 +1,608 @@
+/*
+  Hashmap Compact Mode Implementations
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/* Included by hashmap/hashmap.c.
+   In compact mode every entry is a 24-byte `hashmap_cnode_t` in one pool array and the
+   buckets are 32-bit pool indices, so there is no per-entry allocation and no pointer
+   in a chain. The pool grows by `p_realloc`, which moves it: iterators of a compact
+   hashmap are invalidated by any insert, not only by the erase of their own entry. */
+
+#include <hashmap/hashmap.h>
+
+#include <string.h>
+#include <_log.h>
+#include <_memory.h>
+#include <_handle.h>
+#include <linux/_compiler.h>
+#include <iterator/iterator.h>
+
+#define HMC_NIL       (0)
+#define HMC_POOL_MIN  (16)
+#define HMC_POOL_MAX  (0xffffffffU)
+
+#define hmc_node(_this, i)  (&(_this)->pool[(i)])
+#define hmc_idx(_this, n)   ((uint32_t)((n) - (_this)->pool))
+#define hmc_bkt(_this, tag) ((tag) & (uint32_t)(__hashmap_bucket_count(_this) - 1))
+
+static __always_inline bool __hashmap_compact(const hashmap_t* _this)
+{
+    return _this->config.c.b_compact;
+}
+
+static __always_inline hashmap_cnode_t* __hmc_end(const hashmap_t* _this)
+{
+    return (hashmap_cnode_t*)iterator_end();
+}
+
+static __always_inline hashmap_cnode_t* __hmc_rend(const hashmap_t* _this)
+{
+    return (hashmap_cnode_t*)iterator_rend();
+}
+
+static __always_inline hashmap_hash_t __hmc_hash(const hashmap_t* _this, hashmap_key_t key)
+{
+    if (is_null(_this->ops) || is_null(_this->ops->__hash))
+        return key;
+    return _this->ops->__hash(key);
+}
+
+static __always_inline bool __hmc_eq(const hashmap_t* _this, hashmap_key_t left, hashmap_key_t right)
+{
+    if (is_null(_this->ops) || is_null(_this->ops->__lt))
+        return left == right;
+    if (!is_null(_this->ops->__cmp))
+        return 0 == _this->ops->__cmp(left, right);
+    return !_this->ops->__lt(left, right) && !_this->ops->__lt(right, left);
+}
+
+static __always_inline void __hmc_range(hashmap_t* _this, hashmap_bcount_t idx)
+{
+    _this->pi_s = _this->pi_s < 0 ? idx : idx < _this->pi_s ? idx : _this->pi_s;
+    _this->pi_e = _this->pi_e < 0 ? idx : idx > _this->pi_e ? idx : _this->pi_e;
+}
+
+static hashmap_cnode_t* __hmc_find(const hashmap_t* _this, hashmap_key_t key)
+{
+    hashmap_hash_t hash;
+    hashmap_cnode_t* n;
+    uint32_t i, tag;
+
+    if (__hashmap_size(_this) <= 0)
+        return __hmc_end(_this);
+
+    hash = __hmc_hash(_this, key);
+    tag  = (uint32_t)hash;
+    for (i = _this->chead[hmc_bkt(_this, tag)]; HMC_NIL != i; i = n->next) {
+        n = hmc_node(_this, i);
+        if (n->tag == tag && __hmc_eq(_this, n->key, key))
+            return n;
+    }
+    return __hmc_end(_this);
+}
+
+static hashmap_cnode_t* __hmc_bucket_last(const hashmap_t* _this, hashmap_bcount_t idx)
+{
+    uint32_t i = _this->chead[idx];
+
+    while (HMC_NIL != hmc_node(_this, i)->next)
+        i = hmc_node(_this, i)->next;
+    return hmc_node(_this, i);
+}
+
+/* First node of the first non-empty bucket in [ `idx`, pi_e ], NULL if there isn't any */
+static hashmap_cnode_t* __hmc_scan_forward(const hashmap_t* _this, hashmap_bcount_t idx)
+{
+    hashmap_bcount_t idx_e = _this->pi_e < 0 ? __hashmap_bucket_count(_this) - 1 : _this->pi_e;
+
+    for (; idx <= idx_e; ++idx) {
+        if (HMC_NIL != _this->chead[idx])
+            return hmc_node(_this, _this->chead[idx]);
+    }
+    return NULL;
+}
+
+/* Last node of the last non-empty bucket in [ pi_s, `idx` ], NULL if there isn't any */
+static hashmap_cnode_t* __hmc_scan_backward(const hashmap_t* _this, hashmap_bcount_t idx)
+{
+    hashmap_bcount_t idx_e = _this->pi_s < 0 ? 0 : _this->pi_s;
+
+    for (; idx >= idx_e; --idx) { /* The type of `idx` is a signed type */
+        if (HMC_NIL != _this->chead[idx])
+            return __hmc_bucket_last(_this, idx);
+    }
+    return NULL;
+}
+
+static hashmap_cnode_t* __hmc_first(const hashmap_t* _this)
+{
+    if (__hashmap_size(_this) <= 0)
+        return NULL;
+    return __hmc_scan_forward(_this, _this->pi_s < 0 ? 0 : _this->pi_s);
+}
+
+static hashmap_cnode_t* __hmc_last(const hashmap_t* _this)
+{
+    if (__hashmap_size(_this) <= 0)
+        return NULL;
+    return __hmc_scan_backward(_this, _this->pi_e < 0 ? __hashmap_bucket_count(_this) - 1 : _this->pi_e);
+}
+
+static hashmap_cnode_t* __hmc_next(const hashmap_t* _this, const hashmap_cnode_t* node)
+{
+    hashmap_cnode_t* ret;
+
+    if (HMC_NIL != node->next)
+        return hmc_node(_this, node->next);
+
+    ret = __hmc_scan_forward(_this, hmc_bkt(_this, node->tag) + 1);
+    return is_null(ret) ? __hmc_end(_this) : ret;
+}
+
+static hashmap_cnode_t* __hmc_prev(const hashmap_t* _this, const hashmap_cnode_t* node)
+{
+    hashmap_bcount_t idx = hmc_bkt(_this, node->tag);
+    uint32_t i = _this->chead[idx], self = hmc_idx(_this, node);
+    hashmap_cnode_t* ret;
+
+    if (i != self) {
+        while (hmc_node(_this, i)->next != self)
+            i = hmc_node(_this, i)->next;
+        return hmc_node(_this, i);
+    }
+
+    ret = __hmc_scan_backward(_this, idx - 1);
+    return is_null(ret) ? __hmc_end(_this) : ret;
+}
+
+static hashmap_cnode_t* __hmc_begin(const hashmap_t* _this)
+{
+    hashmap_cnode_t* ret = __hmc_first(_this);
+    return is_null(ret) ? __hmc_end(_this) : ret;
+}
+
+static hashmap_cnode_t* __hmc_rbegin(const hashmap_t* _this)
+{
+    hashmap_cnode_t* ret = __hmc_last(_this);
+    return is_null(ret) ? __hmc_rend(_this) : ret;
+}
+
+static hashmap_cnode_t* _hmc_next(const hashmap_t* _this, const hashmap_cnode_t* node)
+{
+    if (__hashmap_size(_this) <= 0 || __hmc_end(_this) == node)
+        return __hmc_end(_this);
+    return __hmc_next(_this, node);
+}
+
+static hashmap_cnode_t* _hmc_prev(const hashmap_t* _this, const hashmap_cnode_t* node)
+{
+    if (__hashmap_size(_this) <= 0)
+        return __hmc_end(_this);
+    if (__hmc_end(_this) == node)
+        return __hmc_last(_this);
+    return __hmc_prev(_this, node);
+}
+
+static hashmap_cnode_t* _hmc_rnext(const hashmap_t* _this, const hashmap_cnode_t* node)
+{
+    hashmap_cnode_t* ret;
+
+    if (__hashmap_size(_this) <= 0 || __hmc_rend(_this) == node)
+        return __hmc_rend(_this);
+
+    ret = __hmc_prev(_this, node);
+    return __hmc_end(_this) == ret ? __hmc_rend(_this) : ret;
+}
+
+static hashmap_cnode_t* _hmc_rprev(const hashmap_t* _this, const hashmap_cnode_t* node)
+{
+    hashmap_cnode_t* ret;
+
+    if (__hashmap_size(_this) <= 0)
+        return __hmc_rend(_this);
+    if (__hmc_rend(_this) == node)
+        return __hmc_first(_this);
+
+    ret = __hmc_next(_this, node);
+    return __hmc_end(_this) == ret ? __hmc_rend(_this) : ret;
+}
+
+static bool __hmc_pool_reserve(hashmap_t* _this, uint64_t count)
+{
+    hashmap_cnode_t* n;
+    uint64_t cap = _this->pool_cap < HMC_POOL_MIN ? HMC_POOL_MIN : _this->pool_cap;
+
+    if (count < _this->pool_cap)
+        return true;
+
+    if (count >= HMC_POOL_MAX) {
+        pr_err("Compact pool is limited to [ %u ] entries!", HMC_POOL_MAX - 1);
+        return false;
+    }
+
+    while (cap <= count)
+        cap <<= 1;
+    if (cap > HMC_POOL_MAX)
+        cap = HMC_POOL_MAX;
+
+    n = p_realloc(_this->pool, cap * sizeof(hashmap_cnode_t));
+    if (is_null(n))
+        return false;
+
+    pr_info("Compact pool [ %u -> %lu ] nodes", _this->pool_cap, (unsigned long)cap);
+    _this->pool = n;
+    _this->pool_cap = cap;
+    return true;
+}
+
+static bool __hmc_buckets_init_alloc(hashmap_t* _this)
+{
+    if (!is_null(_this->chead))
+        return true;
+
+    _this->chead = (uint32_t*)p_calloc(_this->bucket_count_init, sizeof(uint32_t));
+    if (is_null(_this->chead))
+        return false;
+
+    _this->bucket_count = _this->bucket_count_init;
+    return true;
+}
+
+static uint32_t __hmc_node_alloc(hashmap_t* _this)
+{
+    uint32_t i = _this->pool_free;
+
+    if (HMC_NIL != i) {
+        _this->pool_free = hmc_node(_this, i)->next;
+        return i;
+    }
+
+    if (!__hmc_pool_reserve(_this, (uint64_t)_this->pool_used + 1))
+        return HMC_NIL;
+    return ++_this->pool_used;
+}
+
+static __always_inline void __hmc_node_free(hashmap_t* _this, uint32_t i)
+{
+    hashmap_cnode_t* n = hmc_node(_this, i);
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&n->value);
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+        _this->ops->free_key(&n->key);
+
+    n->next = _this->pool_free;
+    _this->pool_free = i;
+}
+
+/* Expansion to `bcnt_n`, `bucket_count` times a power of 2: every chain is split in place
+   by the new bits of its tags, keeping the order. `__hmc_rehash` doubles, `reserve` jumps */
+static bool __hmc_rehash_expand(hashmap_t* _this, hashmap_bcount_t bcnt_n)
+{
+    hashmap_bcount_t bcnt_o = __hashmap_bucket_count(_this), f = bcnt_n / bcnt_o, idx, j;
+    uint32_t* n, i, next, ** tail;
+
+    tail = p_malloc(f * sizeof(uint32_t*));
+    if (is_null(tail))
+        return false;
+
+    n = p_realloc(_this->chead, bcnt_n * sizeof(uint32_t));
+    if (is_null(n)) {
+        p_free(tail);
+        return false;
+    }
+
+    memset(n + bcnt_o, 0, (bcnt_n - bcnt_o) * sizeof(uint32_t));
+    _this->chead = n;
+    _this->bucket_count = bcnt_n;
+    _this->bucket_valid_count = 0;
+    _this->pi_s = -1;
+    _this->pi_e = -1;
+
+    for (idx = 0; idx < bcnt_o; ++idx) {
+        i = n[idx];
+        for (j = 0; j < f; ++j)
+            tail[j] = &n[idx + j * bcnt_o];
+
+        for (; HMC_NIL != i; i = next) {
+            next = hmc_node(_this, i)->next;
+            j = (hmc_node(_this, i)->tag & (bcnt_n - 1)) / bcnt_o;
+            *tail[j] = i;
+            tail[j] = &hmc_node(_this, i)->next;
+        }
+
+        for (j = 0; j < f; ++j) {
+            *tail[j] = HMC_NIL;
+            if (HMC_NIL != n[idx + j * bcnt_o]) {
+                _this->bucket_valid_count++;
+                __hmc_range(_this, idx + j * bcnt_o);
+            }
+        }
+    }
+
+    p_free(tail);
+    pr_info("Compact rehash, bucket_count [ %zd -> %zd ], bucket_valid_count [ %zd ]",
+            bcnt_o, bcnt_n, _this->bucket_valid_count);
+    return true;
+}
+
+static __always_inline void __hmc_rehash(hashmap_t* _this)
+{
+    if (__hashmap_size(_this) <= __hashmap_bucket_count(_this) * _this->load_factor)
+        return ;
+
+    /* The tag only keeps 32 bits of the hash */
+    if (__hashmap_bucket_count(_this) >= _this->bucket_count_max || __hashmap_bucket_count(_this) >= ((hashmap_bcount_t)1 << 32))
+        return ;
+
+    __hmc_rehash_expand(_this, __hashmap_bucket_count(_this) << 1);
+}
+
+/* Link the filled node `i` at the head of its chain */
+static void __hmc_chain(hashmap_t* _this, uint32_t i)
+{
+    hashmap_cnode_t* n = hmc_node(_this, i);
+    hashmap_bcount_t idx;
+    uint32_t tag;
+
+    tag = (uint32_t)__hmc_hash(_this, n->key);
+    idx = hmc_bkt(_this, tag);
+
+    n->tag  = tag;
+    n->next = _this->chead[idx];
+    if (HMC_NIL == n->next)
+        _this->bucket_valid_count++;
+    _this->chead[idx] = i;
+
+    _this->size++;
+    __hmc_range(_this, idx);
+    __hmc_rehash(_this);
+}
+
+static hashmap_cnode_t* __hmc_insert(hashmap_t* _this, hashmap_key_t key, hashmap_value_t value, bool replace)
+{
+    hashmap_value_t tvalue;
+    hashmap_cnode_t* n;
+    uint32_t i;
+
+    if (!__hmc_buckets_init_alloc(_this))
+        return NULL;
+
+    n = __hmc_find(_this, key);
+    if (__hmc_end(_this) != n) {
+        if (!replace)
+            return NULL;
+
+        tvalue = n->value;
+        if (is_null(_this->ops) || is_null(_this->ops->copy_value)) {
+            n->value = value;
+        } else {
+            if (!_this->ops->copy_value(value, &n->value)) {
+                n->value = tvalue;
+                return NULL;
+            }
+
+            if (!is_null(_this->ops->free_value))
+                _this->ops->free_value(&tvalue);
+        }
+        return n;
+    }
+
+    i = __hmc_node_alloc(_this);
+    if (HMC_NIL == i)
+        return NULL;
+
+    n = hmc_node(_this, i); /* The pool may have moved */
+    n->key = key;
+    n->value = value;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->copy_key) && !_this->ops->copy_key(key, &n->key)) {
+        n->next = _this->pool_free;
+        _this->pool_free = i;
+        return NULL;
+    }
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->copy_value) && !_this->ops->copy_value(value, &n->value)) {
+        if (!is_null(_this->ops->free_key))
+            _this->ops->free_key(&n->key);
+        n->next = _this->pool_free;
+        _this->pool_free = i;
+        return NULL;
+    }
+
+    __hmc_chain(_this, i);
+    return n;
+}
+
+/* The key and the value of `handle` are moved into a pool node, its node memory is freed */
+static hashmap_cnode_t* __hmc_insert_node(hashmap_t* _this, ds_node_handle_t* handle)
+{
+    hashmap_cnode_t* n;
+    uint32_t i;
+
+    if (!__hmc_buckets_init_alloc(_this))
+        return NULL;
+
+    if (__hmc_end(_this) != __hmc_find(_this, handle->key))
+        return NULL;
+
+    i = __hmc_node_alloc(_this);
+    if (HMC_NIL == i)
+        return NULL;
+
+    n = hmc_node(_this, i);
+    n->key = handle->key;
+    n->value = handle->value;
+    ds_node_handle_release(handle);
+
+    __hmc_chain(_this, i);
+    return n;
+}
+
+/* Unlink the node `i` from its chain, `pprev` is the link that refers to it */
+static __always_inline void __hmc_unlink(hashmap_t* _this, hashmap_bcount_t idx, uint32_t* pprev, uint32_t i)
+{
+    *pprev = hmc_node(_this, i)->next;
+    if (HMC_NIL == _this->chead[idx])
+        _this->bucket_valid_count--;
+
+    __hmc_node_free(_this, i);
+    _this->size--;
+}
+
+/* As `__hmc_unlink`, but the key and the value are left to the caller */
+static __always_inline void __hmc_pop(hashmap_t* _this, hashmap_bcount_t idx, uint32_t* pprev, uint32_t i)
+{
+    *pprev = hmc_node(_this, i)->next;
+    if (HMC_NIL == _this->chead[idx])
+        _this->bucket_valid_count--;
+
+    hmc_node(_this, i)->next = _this->pool_free;
+    _this->pool_free = i;
+    _this->size--;
+}
+
+/* The link that refers to `pos`, NULL if it isn't linked in this hashmap */
+static uint32_t* __hmc_pprev(hashmap_t* _this, const hashmap_cnode_t* pos, hashmap_bcount_t* idx)
+{
+    uint32_t* pprev, self;
+
+    if (__hashmap_size(_this) <= 0 || __hmc_end(_this) == pos)
+        return NULL;
+
+    /* `pos` doesn't belong to the pool */
+    if (pos < _this->pool + 1 || pos > _this->pool + _this->pool_used)
+        return NULL;
+
+    self = hmc_idx(_this, pos);
+    *idx = hmc_bkt(_this, pos->tag);
+    for (pprev = &_this->chead[*idx]; HMC_NIL != *pprev && *pprev != self; pprev = &hmc_node(_this, *pprev)->next)
+        ;
+    if (HMC_NIL == *pprev)
+        return NULL; /* Err: `pos` isn't linked, or memory `pos->tag` has been modified illegally */
+    return pprev;
+}
+
+static hashmap_cnode_t* __hmc_erase(hashmap_t* _this, hashmap_cnode_t* pos)
+{
+    hashmap_bcount_t idx;
+    hashmap_cnode_t* ret;
+    uint32_t* pprev;
+
+    pprev = __hmc_pprev(_this, pos, &idx);
+    if (is_null(pprev))
+        return NULL;
+
+    ret = __hmc_next(_this, pos); /* Unlinking doesn't move the pool */
+    __hmc_unlink(_this, idx, pprev, *pprev);
+    return ret;
+}
+
+/* The key and the value go to `handle`, the node goes back to the pool */
+static hashmap_cnode_t* __hmc_extract(hashmap_t* _this, hashmap_cnode_t* pos, ds_node_handle_t* handle)
+{
+    hashmap_bcount_t idx;
+    hashmap_cnode_t* ret;
+    uint32_t* pprev;
+
+    pprev = __hmc_pprev(_this, pos, &idx);
+    if (is_null(pprev))
+        return NULL;
+
+    handle->key = pos->key;
+    handle->value = pos->value;
+    handle->full = true;
+
+    ret = __hmc_next(_this, pos);
+    __hmc_pop(_this, idx, pprev, *pprev);
+    return ret;
+}
+
+static hashmap_size_t __hmc_remove(hashmap_t* _this, hashmap_key_t key)
+{
+    hashmap_bcount_t idx;
+    uint32_t* pprev, tag;
+    hashmap_cnode_t* n;
+
+    if (__hashmap_size(_this) <= 0)
+        return 0;
+
+    tag = (uint32_t)__hmc_hash(_this, key);
+    idx = hmc_bkt(_this, tag);
+    for (pprev = &_this->chead[idx]; HMC_NIL != *pprev; pprev = &n->next) {
+        n = hmc_node(_this, *pprev);
+        if (n->tag == tag && __hmc_eq(_this, n->key, key)) {
+            __hmc_unlink(_this, idx, pprev, *pprev);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static hashmap_size_t __hmc_clear(hashmap_t* _this)
+{
+    hashmap_size_t ret = __hashmap_size(_this);
+    hashmap_bcount_t idx;
+    uint32_t i, next;
+
+    if (ret <= 0)
+        return 0;
+
+    if (!is_null(_this->ops) && (!is_null(_this->ops->free_key) || !is_null(_this->ops->free_value))) {
+        for (idx = 0; idx < __hashmap_bucket_count(_this); ++idx) {
+            /* `__hmc_node_free` reuses `next` for the free list */
+            for (i = _this->chead[idx]; HMC_NIL != i; i = next) {
+                next = hmc_node(_this, i)->next;
+                __hmc_node_free(_this, i);
+            }
+        }
+    }
+
+    /* Keep the pool and the buckets for reuse, like the default mode keeps its buckets */
+    memset(_this->chead, 0, __hashmap_bucket_count(_this) * sizeof(uint32_t));
+    _this->pool_used = 0;
+    _this->pool_free = HMC_NIL;
+    _this->size = 0;
+    _this->bucket_valid_count = 0;
+    _this->pi_s = -1;
+    _this->pi_e = -1;
+    return ret;
+}
+
+static bool __hmc_reserve(hashmap_t* _this, hashmap_size_t count, hashmap_bcount_t target)
+{
+    if (!__hmc_pool_reserve(_this, (uint64_t)count + 1))
+        return false;
+
+    if (is_null(_this->chead)) {
+        if (target > _this->bucket_count_init)
+            _this->bucket_count_init = target;
+        return true;
+    }
+
+    return __hashmap_bucket_count(_this) >= target || __hmc_rehash_expand(_this, target);
+}
+
+static void __hmc_deinit(hashmap_t* _this)
+{
+    __hmc_clear(_this);
+    p_free(_this->chead);
+    p_free(_this->pool);
+    _this->pool_cap = 0;
+}
@@ -0,0 +1,432 @@
+/*
+  Hashmap Image Implementations
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <hashmap/hashmap_image.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <_log.h>
+#include <_memory.h>
+#include <linux/_compiler.h>
+
+#ifndef TAG
+#define TAG "[hashmap_image]"
+#endif /* TAG */
+
+#define HMIMG_SLOT_USED    (0x8000000000000000ULL) /* Keeps the stored hash of an occupied slot non-zero */
+#define HMIMG_SLOT_MIN     (16)
+#define HMIMG_ALIGN        (64)
+#define HMIMG_OFF_NULL     (-1)                    /* Offset of a NULL string */
+#define HMIMG_PATH_MAX     (4096)
+
+#define hmimg_align(x)     (((x) + HMIMG_ALIGN - 1) & ~((uint64_t)HMIMG_ALIGN - 1))
+
+static __always_inline uint64_t __hmimg_mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/* The image can't store function pointers, so it always uses its own hash function,
+   independent of `ops->__hash` of the hashmap it was dumped from */
+static inline uint64_t __hmimg_hash(uint32_t type, hashmap_key_t key)
+{
+    const unsigned char* s;
+    uint64_t h;
+
+    if (!(type & HM_KV_KEY_STRING))
+        return __hmimg_mix((uint64_t)key) | HMIMG_SLOT_USED;
+
+    if (is_null(key))
+        return HMIMG_SLOT_USED;
+
+    h = 0xcbf29ce484222325ULL; /* FNV-1a */
+    for (s = (const unsigned char*)key; *s; ++s) {
+        h ^= *s;
+        h *= 0x100000001b3ULL;
+    }
+    return __hmimg_mix(h) | HMIMG_SLOT_USED;
+}
+
+static uint64_t __hmimg_slot_count(hashmap_size_t size)
+{
+    uint64_t want = (uint64_t)size + ((uint64_t)size >> 1) + 1; /* Load factor stays below 2/3 */
+    uint64_t ret = HMIMG_SLOT_MIN;
+
+    while (ret < want)
+        ret <<= 1;
+    return ret;
+}
+
+static __always_inline int64_t __hmimg_arena_put(char* arena, uint64_t* used, const char* s)
+{
+    size_t len;
+    int64_t off;
+
+    if (is_null(s))
+        return HMIMG_OFF_NULL;
+
+    len = strlen(s) + 1;
+    off = (int64_t)*used;
+    memcpy(arena + off, s, len);
+    *used += len;
+    return off;
+}
+
+static bool hashmap_image_dump(const hashmap_t* hashmap, const char* path, hashmap_kv_type_t type)
+{
+    hashmap_image_header_t* hdr;
+    hashmap_image_slot_t* slots, * s;
+    hashmap_iterator_t* it;
+    uint64_t arena_size = 0, arena_used = 0, slot_count, mask, off_slots, off_arena, file_size, h, i;
+    hashmap_size_t size;
+    char tmp[HMIMG_PATH_MAX];
+    char* base, * arena;
+    int fd;
+
+    if (unlikely(is_null(hashmap) || is_null(path)))
+        return false;
+
+    size = chashmap->size(hashmap);
+    if (size < 0)
+        return false;
+
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+        return false;
+
+    if (type & (HM_KV_KEY_STRING | HM_KV_VALUE_STRING)) {
+        for (it = chashmap->begin(hashmap); chashmap->end(hashmap) != it; it = chashmap->next(hashmap, it)) {
+            if (is_null(it))
+                return false;
+            if ((type & HM_KV_KEY_STRING) && !is_null(it->skey))
+                arena_size += strlen(it->skey) + 1;
+            if ((type & HM_KV_VALUE_STRING) && !is_null(it->svalue))
+                arena_size += strlen(it->svalue) + 1;
+        }
+    }
+
+    slot_count = __hmimg_slot_count(size);
+    mask       = slot_count - 1;
+    off_slots  = hmimg_align(sizeof(hashmap_image_header_t));
+    off_arena  = off_slots + slot_count * sizeof(hashmap_image_slot_t);
+    file_size  = off_arena + arena_size;
+
+    fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        pr_err("Open [ %s ] failed!", tmp);
+        return false;
+    }
+
+    if (ftruncate(fd, file_size) < 0) {
+        pr_err("Resize [ %s ] to [ %lu ] failed!", tmp, (unsigned long)file_size);
+        goto err_fd;
+    }
+
+    base = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == base) {
+        pr_err("Map [ %s ] failed!", tmp);
+        goto err_fd;
+    }
+
+    /* The file was extended by `ftruncate`, every slot already reads as empty */
+    hdr   = (hashmap_image_header_t*)base;
+    slots = (hashmap_image_slot_t*)(base + off_slots);
+    arena = base + off_arena;
+
+    for (it = chashmap->begin(hashmap); chashmap->end(hashmap) != it; it = chashmap->next(hashmap, it)) {
+        if (is_null(it))
+            goto err_map;
+
+        h = __hmimg_hash(type, it->key);
+        for (i = h & mask; 0 != slots[i].hash; i = (i + 1) & mask)
+            ;
+
+        s = &slots[i];
+        s->hash  = h;
+        s->key   = type & HM_KV_KEY_STRING ? __hmimg_arena_put(arena, &arena_used, it->skey) : it->key;
+        s->value = type & HM_KV_VALUE_STRING ? __hmimg_arena_put(arena, &arena_used, it->svalue) : it->value;
+    }
+
+    hdr->version    = HASHMAP_IMAGE_VERSION;
+    hdr->type       = type;
+    hdr->size       = size;
+    hdr->slot_count = slot_count;
+    hdr->off_slots  = off_slots;
+    hdr->off_arena  = off_arena;
+    hdr->arena_size = arena_size;
+    hdr->file_size  = file_size;
+    hdr->magic      = HASHMAP_IMAGE_MAGIC; /* Last, a torn image never validates */
+
+    if (msync(base, file_size, MS_SYNC) < 0)
+        goto err_map;
+    munmap(base, file_size);
+
+    if (fsync(fd) < 0)
+        goto err_fd;
+    close(fd);
+
+    if (rename(tmp, path) < 0) {
+        pr_err("Rename [ %s ] -> [ %s ] failed!", tmp, path);
+        unlink(tmp);
+        return false;
+    }
+
+    pr_info("Dump [ %zd ] entries to [ %s ], slots [ %lu ], arena [ %lu ], bytes [ %lu ]", size, path,
+            (unsigned long)slot_count, (unsigned long)arena_size, (unsigned long)file_size);
+    return true;
+
+err_map:
+    munmap(base, file_size);
+err_fd:
+    close(fd);
+    unlink(tmp);
+    return false;
+}
+
+/* A string slot holds HMIMG_OFF_NULL or an offset whose NUL lies within the arena */
+static __always_inline bool __hmimg_str_valid(const char* arena, uint64_t arena_size, int64_t off)
+{
+    if (HMIMG_OFF_NULL == off)
+        return true;
+    return off >= 0 && (uint64_t)off < arena_size && !is_null(memchr(arena + off, '\0', arena_size - off));
+}
+
+static bool __hashmap_image_valid(const hashmap_image_header_t* hdr, size_t length)
+{
+    const hashmap_image_slot_t* slots;
+    const char* arena;
+    uint64_t used = 0, i;
+
+    if (HASHMAP_IMAGE_MAGIC != hdr->magic || HASHMAP_IMAGE_VERSION != hdr->version)
+        return false;
+
+    if (hdr->file_size != length || 0 == hdr->slot_count || (hdr->slot_count & (hdr->slot_count - 1)))
+        return false;
+
+    if (hdr->size >= hdr->slot_count || hdr->off_slots < sizeof(hashmap_image_header_t)
+        || hdr->off_slots > length || (hdr->off_slots & (sizeof(uint64_t) - 1)))
+        return false;
+
+    /* Ordered so that none of the sums can wrap */
+    if (hdr->slot_count > (length - hdr->off_slots) / sizeof(hashmap_image_slot_t)
+        || hdr->off_arena != hdr->off_slots + hdr->slot_count * sizeof(hashmap_image_slot_t)
+        || hdr->arena_size != length - hdr->off_arena)
+        return false;
+
+    /* Lookups trust every slot afterwards, check them all once here: a probe must meet an
+       empty slot, and a string must end inside the arena */
+    slots = (const hashmap_image_slot_t*)((const char*)hdr + hdr->off_slots);
+    arena = (const char*)hdr + hdr->off_arena;
+    for (i = 0; i < hdr->slot_count; ++i) {
+        if (0 == slots[i].hash)
+            continue;
+        ++used;
+        if ((hdr->type & HM_KV_KEY_STRING) && !__hmimg_str_valid(arena, hdr->arena_size, slots[i].key))
+            return false;
+        if ((hdr->type & HM_KV_VALUE_STRING) && !__hmimg_str_valid(arena, hdr->arena_size, slots[i].value))
+            return false;
+    }
+    return used == hdr->size;
+}
+
+static bool hashmap_image_load(hashmap_image_t* _this, const char* path)
+{
+    struct stat st;
+    void* base;
+    int fd;
+
+    if (unlikely(is_null(_this) || is_null(path) || !is_null(_this->base)))
+        return false;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        pr_err("Open [ %s ] failed!", path);
+        return false;
+    }
+
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(hashmap_image_header_t)) {
+        close(fd);
+        return false;
+    }
+
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); /* The mapping holds its own reference to the file */
+    if (MAP_FAILED == base) {
+        pr_err("Map [ %s ] failed!", path);
+        return false;
+    }
+
+    if (!__hashmap_image_valid((const hashmap_image_header_t*)base, st.st_size)) {
+        pr_err("Image [ %s ] is invalid!", path);
+        munmap(base, st.st_size);
+        return false;
+    }
+
+    /* Lookups are random, prevent the kernel from reading ahead on every fault */
+    madvise(base, st.st_size, MADV_RANDOM);
+
+    _this->base   = base;
+    _this->length = st.st_size;
+    _this->header = (const hashmap_image_header_t*)base;
+    _this->slots  = (const hashmap_image_slot_t*)((const char*)base + _this->header->off_slots);
+    _this->arena  = (const char*)base + _this->header->off_arena;
+    return true;
+}
+
+static void hashmap_image_unload(hashmap_image_t* _this)
+{
+    if (unlikely(is_null(_this) || is_null(_this->base)))
+        return ;
+
+    munmap((void*)_this->base, _this->length);
+    __hashmap_image_init(_this);
+}
+
+static __always_inline hashmap_size_t _hashmap_image_size(const hashmap_image_t* _this)
+{
+    if (unlikely(is_null(_this) || is_null(_this->base)))
+        return -1;
+    return _this->header->size;
+}
+
+/* `off` was checked by `__hashmap_image_valid` at load */
+static __always_inline const char* __hmimg_str(const hashmap_image_t* _this, int64_t off)
+{
+    return HMIMG_OFF_NULL == off ? NULL : _this->arena + off;
+}
+
+static inline const hashmap_image_slot_t* __hashmap_image_find(const hashmap_image_t* _this, hashmap_key_t key)
+{
+    const hashmap_image_slot_t* s;
+    const char* skey;
+    uint32_t type = _this->header->type;
+    uint64_t mask = _this->header->slot_count - 1;
+    uint64_t h = __hmimg_hash(type, key), i;
+
+    for (i = h & mask; ; i = (i + 1) & mask) {
+        s = &_this->slots[i];
+        if (0 == s->hash)
+            return NULL;
+        if (s->hash != h)
+            continue;
+        if (!(type & HM_KV_KEY_STRING)) {
+            if (s->key == key)
+                return s;
+            continue;
+        }
+
+        skey = __hmimg_str(_this, s->key);
+        if (is_null(skey) || is_null(key)) {
+            if (skey == (const char*)key)
+                return s;
+            continue;
+        }
+        if (0 == strcmp(skey, (const char*)key))
+            return s;
+    }
+}
+
+static __always_inline hashmap_value_t __hmimg_value(const hashmap_image_t* _this, const hashmap_image_slot_t* s)
+{
+    if (_this->header->type & HM_KV_VALUE_STRING)
+        return (hashmap_value_t)__hmimg_str(_this, s->value);
+    return s->value;
+}
+
+static hashmap_count_t hashmap_image_count(const hashmap_image_t* _this, hashmap_key_t key)
+{
+    if (unlikely(is_null(_this) || is_null(_this->base)))
+        return -1;
+    return is_null(__hashmap_image_find(_this, key)) ? 0 : 1;
+}
+
+static bool hashmap_image_find(const hashmap_image_t* _this, hashmap_key_t key, hashmap_value_t* value)
+{
+    const hashmap_image_slot_t* s;
+
+    if (unlikely(is_null(_this) || is_null(_this->base)))
+        return false;
+
+    s = __hashmap_image_find(_this, key);
+    if (is_null(s))
+        return false;
+
+    if (!is_null(value))
+        *value = __hmimg_value(_this, s);
+    return true;
+}
+
+static hashmap_size_t hashmap_image_for_each(const hashmap_image_t* _this, for_each_kv cb, void* arg)
+{
+    const hashmap_image_slot_t* s;
+    hashmap_key_t key;
+    hashmap_size_t ret = 0;
+    uint64_t i;
+
+    if (unlikely(is_null(_this) || is_null(_this->base) || is_null(cb)))
+        return -1;
+
+    for (i = 0; i < _this->header->slot_count; ++i) {
+        s = &_this->slots[i];
+        if (0 == s->hash)
+            continue;
+
+        key = _this->header->type & HM_KV_KEY_STRING ? (hashmap_key_t)__hmimg_str(_this, s->key) : s->key;
+        ret++;
+        if (!cb(key, __hmimg_value(_this, s), arg))
+            break;
+    }
+    return ret;
+}
+
+/* __always_inline */ inline void __hashmap_image_init(hashmap_image_t* image)
+{
+    image->base   = NULL;
+    image->length = 0;
+    image->header = NULL;
+    image->slots  = NULL;
+    image->arena  = NULL;
+}
+
+/* __always_inline */ inline void __hashmap_image_deinit(hashmap_image_t* image)
+{
+    hashmap_image_unload(image);
+}
+
+/* __always_inline */ inline const class_hashmap_image_t* class_hashmap_image_ins(void)
+{
+    static const class_hashmap_image_t ins = {
+        .dump     = hashmap_image_dump,
+        .load     = hashmap_image_load,
+        .unload   = hashmap_image_unload,
+        .size     = _hashmap_image_size,
+        .count    = hashmap_image_count,
+        .find     = hashmap_image_find,
+        .for_each = hashmap_image_for_each,
+    };
+    return &ins;
+}
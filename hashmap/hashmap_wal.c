@@ -0,0 +1,719 @@
+/*
+  Hashmap Write-Ahead Log Implementations
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <hashmap/hashmap_wal.h>
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <_log.h>
+#include <_memory.h>
+#include <linux/_compiler.h>
+
+#ifndef TAG
+#define TAG "[hashmap_wal]"
+#endif /* TAG */
+
+#define HMWAL_OP_INSERT             (1)
+#define HMWAL_OP_REPLACE            (2)
+#define HMWAL_OP_REMOVE             (3)
+#define HMWAL_REC_HEAD              (8)           /* u32 payload length + u32 checksum */
+#define HMWAL_STR_NULL              (0xffffffffU)
+#define HMWAL_BUF_SIZE              (64 * 1024)   /* Records are handed to the kernel in blocks of this size */
+#define HMWAL_SYNC_EVERY_DEFAULT    (128)
+#define HMWAL_SYNC_INTERVAL_DEFAULT (10)
+#define HMWAL_PATH_MAX              (4096)
+
+typedef struct hmwal_scratch {
+    char*  p;
+    size_t cap;
+} hmwal_scratch_t;
+
+static uint32_t __hmwal_sum(const char* p, size_t n)
+{
+    uint32_t h = 0x811c9dc5U; /* FNV-1a */
+
+    while (n--) {
+        h ^= (unsigned char)*p++;
+        h *= 0x01000193U;
+    }
+    return h;
+}
+
+static __always_inline uint64_t __hmwal_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool __hmwal_write_all(int fd, const char* p, size_t n)
+{
+    ssize_t ret;
+
+    while (n > 0) {
+        ret = write(fd, p, n);
+        if (ret < 0) {
+            if (EINTR == errno)
+                continue;
+            return false;
+        }
+        p += ret;
+        n -= ret;
+    }
+    return true;
+}
+
+static __always_inline size_t __hmwal_data_size(bool str, ds_data_t data)
+{
+    if (!str)
+        return sizeof(int64_t);
+    return sizeof(uint32_t) + (is_null(data) ? 0 : strlen((const char*)data));
+}
+
+static __always_inline char* __hmwal_put_data(char* p, bool str, ds_data_t data)
+{
+    int64_t i = data;
+    uint32_t len;
+
+    if (!str) {
+        memcpy(p, &i, sizeof(i));
+        return p + sizeof(i);
+    }
+
+    len = is_null(data) ? HMWAL_STR_NULL : (uint32_t)strlen((const char*)data);
+    memcpy(p, &len, sizeof(len));
+    p += sizeof(len);
+    if (HMWAL_STR_NULL != len) {
+        memcpy(p, (const char*)data, len);
+        p += len;
+    }
+    return p;
+}
+
+/* Append one record to the buffer, it's only handed to the kernel by `__hmwal_commit` */
+static bool __hmwal_record(hashmap_wal_t* _this, uint8_t op, hashmap_key_t key, hashmap_value_t value)
+{
+    bool kstr = _this->type & HM_KV_KEY_STRING, vstr = _this->type & HM_KV_VALUE_STRING;
+    size_t payload, need;
+    uint32_t len, sum;
+    char* rec, * p, * n;
+
+    payload = 1 + __hmwal_data_size(kstr, key) + (HMWAL_OP_REMOVE == op ? 0 : __hmwal_data_size(vstr, value));
+    need    = _this->buf_len + HMWAL_REC_HEAD + payload;
+    if (need > _this->buf_cap) {
+        n = p_realloc(_this->buf, need > HMWAL_BUF_SIZE * 2 ? need : HMWAL_BUF_SIZE * 2);
+        if (is_null(n))
+            return false;
+        _this->buf     = n;
+        _this->buf_cap = need > HMWAL_BUF_SIZE * 2 ? need : HMWAL_BUF_SIZE * 2;
+    }
+
+    rec = _this->buf + _this->buf_len;
+    p = rec + HMWAL_REC_HEAD;
+    *p++ = op;
+    p = __hmwal_put_data(p, kstr, key);
+    if (HMWAL_OP_REMOVE != op)
+        p = __hmwal_put_data(p, vstr, value);
+
+    len = payload;
+    sum = __hmwal_sum(rec + HMWAL_REC_HEAD, payload);
+    memcpy(rec, &len, sizeof(len));
+    memcpy(rec + sizeof(len), &sum, sizeof(sum));
+    _this->buf_len = need;
+    return true;
+}
+
+static bool __hmwal_flush(hashmap_wal_t* _this, int fd)
+{
+    if (0 == _this->buf_len)
+        return true;
+
+    if (!__hmwal_write_all(fd, _this->buf, _this->buf_len)) {
+        pr_err("Write [ %zu ] bytes to [ %s ] failed!", _this->buf_len, _this->path);
+        return false;
+    }
+    _this->buf_len = 0;
+    return true;
+}
+
+/* What reached `fd` is unknown after a failure, so nothing more is appended to it */
+static __always_inline bool __hmwal_fail(hashmap_wal_t* _this)
+{
+    if (0 == _this->error)
+        _this->error = 0 != errno ? errno : EIO;
+    return false;
+}
+
+static bool __hmwal_sync(hashmap_wal_t* _this)
+{
+    if (0 != _this->error)
+        return false;
+
+    if (!__hmwal_flush(_this, _this->fd))
+        return __hmwal_fail(_this);
+
+    if (fdatasync(_this->fd) < 0) {
+        pr_err("Sync [ %s ] failed!", _this->path);
+        return __hmwal_fail(_this);
+    }
+    _this->pending = 0;
+    _this->last_sync_ms = __hmwal_now_ms();
+    return true;
+}
+
+/* Group commit: many records share one `write` and one `fdatasync` */
+static __always_inline bool __hmwal_commit(hashmap_wal_t* _this)
+{
+    _this->pending++;
+
+    if (_this->pending >= _this->sync_every || __hmwal_now_ms() - _this->last_sync_ms >= _this->sync_interval_ms)
+        return __hmwal_sync(_this);
+
+    if (_this->buf_len >= HMWAL_BUF_SIZE && !__hmwal_flush(_this, _this->fd))
+        return __hmwal_fail(_this);
+    return true;
+}
+
+/* With a NULL `scratch` a string is only checked, not copied */
+static const char* __hmwal_get_data(const char* p, const char* e, bool str, hmwal_scratch_t* scratch, ds_data_t* data)
+{
+    int64_t i;
+    uint32_t len;
+    char* n;
+
+    if (!str) {
+        if (e - p < (ptrdiff_t)sizeof(i))
+            return NULL;
+        memcpy(&i, p, sizeof(i));
+        *data = i;
+        return p + sizeof(i);
+    }
+
+    if (e - p < (ptrdiff_t)sizeof(len))
+        return NULL;
+    memcpy(&len, p, sizeof(len));
+    p += sizeof(len);
+
+    if (HMWAL_STR_NULL == len) {
+        *data = 0;
+        return p;
+    }
+
+    if (e - p < (ptrdiff_t)len)
+        return NULL;
+
+    if (is_null(scratch))
+        return p + len;
+
+    /* The mapping isn't NUL-terminated, hand the hashmap a terminated copy */
+    if (len + 1 > scratch->cap) {
+        n = p_realloc(scratch->p, len + 1);
+        if (is_null(n))
+            return NULL;
+        scratch->p   = n;
+        scratch->cap = len + 1;
+    }
+    memcpy(scratch->p, p, len);
+    scratch->p[len] = '\0';
+    *data = (ds_data_t)scratch->p;
+    return p + len;
+}
+
+/* The end of the intact record at `p`, NULL if it's torn or corrupted */
+static const char* __hmwal_check(const char* p, const char* e, hashmap_kv_type_t type, uint8_t* op)
+{
+    hashmap_key_t key;
+    hashmap_value_t value;
+    uint32_t len, sum;
+    const char* r;
+
+    if (e - p < HMWAL_REC_HEAD)
+        return NULL;
+
+    memcpy(&len, p, sizeof(len));
+    memcpy(&sum, p + sizeof(len), sizeof(sum));
+    if (0 == len || e - p - HMWAL_REC_HEAD < (ptrdiff_t)len || __hmwal_sum(p + HMWAL_REC_HEAD, len) != sum)
+        return NULL;
+
+    r = p + HMWAL_REC_HEAD;
+    e = r + len; /* Decoding can't run past the current record */
+    *op = *r;
+    if (HMWAL_OP_INSERT != *op && HMWAL_OP_REPLACE != *op && HMWAL_OP_REMOVE != *op)
+        return NULL;
+
+    r = __hmwal_get_data(r + 1, e, type & HM_KV_KEY_STRING, NULL, &key);
+    if (!is_null(r) && HMWAL_OP_REMOVE != *op)
+        r = __hmwal_get_data(r, e, type & HM_KV_VALUE_STRING, NULL, &value);
+    return is_null(r) ? NULL : e;
+}
+
+/* Decode the record at `p`, already passed by `__hmwal_check` */
+static const char* __hmwal_decode(const char* p, hashmap_kv_type_t type, hmwal_scratch_t* sk, hmwal_scratch_t* sv,
+                                  uint8_t* op, hashmap_key_t* key, hashmap_value_t* value)
+{
+    uint32_t len;
+    const char* r, * e;
+
+    memcpy(&len, p, sizeof(len));
+    r = p + HMWAL_REC_HEAD;
+    e = r + len;
+    *op = *r;
+
+    r = __hmwal_get_data(r + 1, e, type & HM_KV_KEY_STRING, sk, key);
+    if (!is_null(r) && HMWAL_OP_REMOVE != *op)
+        r = __hmwal_get_data(r, e, type & HM_KV_VALUE_STRING, sv, value);
+    return is_null(r) ? NULL : e;
+}
+
+/* The records are decoded into scratch buffers, the hashmap has to keep copies of the strings */
+static bool __hmwal_copies_strings(const hashmap_t* hashmap, hashmap_kv_type_t type)
+{
+    if ((type & HM_KV_KEY_STRING) && (is_null(hashmap->ops) || is_null(hashmap->ops->copy_key)))
+        return false;
+    if ((type & HM_KV_VALUE_STRING) && (is_null(hashmap->ops) || is_null(hashmap->ops->copy_value)))
+        return false;
+    return true;
+}
+
+static hashmap_size_t __hashmap_wal_replay(hashmap_t* hashmap, const char* path, hashmap_kv_type_t type, off_t* end)
+{
+    const hashmap_wal_header_t* hdr;
+    hmwal_scratch_t sk = { NULL, 0 }, sv = { NULL, 0 };
+    const char* base, * p, * e, * r;
+    hashmap_key_t key;
+    hashmap_value_t value = 0;
+    hashmap_size_t ret = 0, puts = 0;
+    struct stat st;
+    uint8_t op;
+    int fd;
+
+    *end = 0;
+    if (!__hmwal_copies_strings(hashmap, type)) {
+        pr_err("Log [ %s ] holds strings, the hashmap can't copy them!", path);
+        return -1;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return ENOENT == errno ? 0 : -1;
+
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (0 == st.st_size) {
+        close(fd);
+        return 0;
+    }
+
+    if (st.st_size < (off_t)sizeof(hashmap_wal_header_t)) {
+        close(fd);
+        pr_err("Log [ %s ] is too short!", path);
+        return -1;
+    }
+
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == base)
+        return -1;
+    madvise((void*)base, st.st_size, MADV_SEQUENTIAL);
+
+    hdr = (const hashmap_wal_header_t*)base;
+    if (HASHMAP_WAL_MAGIC != hdr->magic || HASHMAP_WAL_VERSION != hdr->version || type != hdr->type) {
+        pr_err("Log [ %s ] header mismatch, type [ 0x%x | 0x%x ]!", path, hdr->type, type);
+        munmap((void*)base, st.st_size);
+        return -1;
+    }
+
+    /* First pass: find the intact prefix and count what it adds, every insert adds at most one
+       entry and every logged remove takes exactly one away */
+    e = base + st.st_size;
+    for (p = base + sizeof(hashmap_wal_header_t); !is_null(r = __hmwal_check(p, e, type, &op)); p = r)
+        puts += HMWAL_OP_REMOVE == op ? -1 : 1;
+
+    *end = p - base;
+    if (*end != st.st_size)
+        pr_warn("Log [ %s ] has a torn tail, [ %ld ] of [ %ld ] bytes are valid", path, (long)*end, (long)st.st_size);
+
+    /* Size the hashmap once, then apply the records with no rehash on the way */
+    if (puts > 0)
+        chashmap->reserve(hashmap, chashmap->size(hashmap) + puts);
+
+    e = p;
+    for (p = base + sizeof(hashmap_wal_header_t); p < e; p = r) {
+        r = __hmwal_decode(p, type, &sk, &sv, &op, &key, &value);
+        if (is_null(r))
+            break;
+
+        switch (op) {
+        case HMWAL_OP_INSERT:  chashmap->insert(hashmap, key, value); break;
+        case HMWAL_OP_REPLACE: chashmap->insert_replace(hashmap, key, value); break;
+        default:               chashmap->remove(hashmap, key); break;
+        }
+        ret++;
+    }
+
+    p_free(sk.p);
+    p_free(sv.p);
+    munmap((void*)base, st.st_size);
+    pr_info("Replay [ %zd ] records from [ %s ], size [ %zd ]", ret, path, chashmap->size(hashmap));
+    return ret;
+}
+
+static hashmap_size_t hashmap_wal_replay(hashmap_t* hashmap, const char* path, hashmap_kv_type_t type)
+{
+    off_t end;
+
+    if (unlikely(is_null(hashmap) || is_null(path)))
+        return -1;
+    return __hashmap_wal_replay(hashmap, path, type, &end);
+}
+
+static bool __hmwal_write_header(int fd, hashmap_kv_type_t type)
+{
+    hashmap_wal_header_t hdr = {
+        .magic   = HASHMAP_WAL_MAGIC,
+        .version = HASHMAP_WAL_VERSION,
+        .type    = type,
+    };
+    return __hmwal_write_all(fd, (const char*)&hdr, sizeof(hdr));
+}
+
+static hashmap_size_t hashmap_wal_open(hashmap_wal_t* _this, hashmap_t* hashmap, const char* path, hashmap_kv_type_t type)
+{
+    hashmap_size_t ret;
+    off_t end;
+    size_t len;
+
+    if (unlikely(is_null(_this) || is_null(hashmap) || is_null(path) || !is_null(_this->hashmap)))
+        return -1;
+
+    ret = __hashmap_wal_replay(hashmap, path, type, &end);
+    if (ret < 0)
+        return -1;
+
+    _this->fd = open(path, O_WRONLY | O_CREAT, 0644);
+    if (_this->fd < 0) {
+        pr_err("Open [ %s ] failed!", path);
+        return -1;
+    }
+
+    if (0 == end) {
+        if (ftruncate(_this->fd, 0) < 0 || !__hmwal_write_header(_this->fd, type) || fsync(_this->fd) < 0)
+            goto err;
+    } else if (ftruncate(_this->fd, end) < 0 || lseek(_this->fd, end, SEEK_SET) < 0) {
+        goto err;
+    }
+
+    len = strlen(path) + 1;
+    _this->path = p_malloc(len);
+    if (is_null(_this->path))
+        goto err;
+    memcpy(_this->path, path, len);
+
+    _this->hashmap      = hashmap;
+    _this->type         = type;
+    _this->buf_len      = 0;
+    _this->pending      = 0;
+    _this->error        = 0;
+    _this->last_sync_ms = __hmwal_now_ms();
+    return ret;
+
+err:
+    close(_this->fd);
+    _this->fd = -1;
+    return -1;
+}
+
+static bool hashmap_wal_sync(hashmap_wal_t* _this)
+{
+    if (unlikely(is_null(_this) || is_null(_this->hashmap)))
+        return false;
+    return __hmwal_sync(_this);
+}
+
+static bool hashmap_wal_tick(hashmap_wal_t* _this)
+{
+    if (unlikely(is_null(_this) || is_null(_this->hashmap)))
+        return false;
+
+    if (0 != _this->error)
+        return false;
+
+    if (0 == _this->pending || __hmwal_now_ms() - _this->last_sync_ms < _this->sync_interval_ms)
+        return true;
+    return __hmwal_sync(_this);
+}
+
+static bool hashmap_wal_close(hashmap_wal_t* _this)
+{
+    bool ret;
+
+    if (unlikely(is_null(_this) || is_null(_this->hashmap)))
+        return false;
+
+    ret = __hmwal_sync(_this);
+    close(_this->fd);
+    p_free(_this->path);
+    _this->fd = -1;
+    _this->hashmap = NULL;
+    _this->buf_len = 0;
+    _this->error = 0;
+    return ret;
+}
+
+static void __hmwal_sync_dir(const char* path)
+{
+    char dir[HMWAL_PATH_MAX];
+    const char* s = strrchr(path, '/');
+    int fd;
+
+    if (is_null(s)) {
+        dir[0] = '.';
+        dir[1] = '\0';
+    } else {
+        if (s - path >= (ptrdiff_t)sizeof(dir))
+            return ;
+        memcpy(dir, path, s - path + 1);
+        dir[s - path + 1] = '\0';
+    }
+
+    fd = open(dir, O_RDONLY);
+    if (fd < 0)
+        return ;
+    fsync(fd);
+    close(fd);
+}
+
+static bool hashmap_wal_compact(hashmap_wal_t* _this)
+{
+    hashmap_iterator_t* it;
+    hashmap_size_t n = 0;
+    char tmp[HMWAL_PATH_MAX];
+    int fd;
+
+    if (unlikely(is_null(_this) || is_null(_this->hashmap)))
+        return false;
+
+    if (snprintf(tmp, sizeof(tmp), "%s.compact", _this->path) >= (int)sizeof(tmp))
+        return false;
+
+    /* Keep the old log complete, it stays authoritative until the rename.
+       A failed log can't be completed, the hashmap already holds what it misses */
+    if (0 != _this->error)
+        _this->buf_len = 0;
+    else if (!__hmwal_sync(_this))
+        return false;
+
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+
+    if (!__hmwal_write_header(fd, _this->type))
+        goto err;
+
+    for (it = chashmap->begin(_this->hashmap); chashmap->end(_this->hashmap) != it; it = chashmap->next(_this->hashmap, it)) {
+        if (is_null(it) || !__hmwal_record(_this, HMWAL_OP_INSERT, it->key, it->value))
+            goto err;
+        if (_this->buf_len >= HMWAL_BUF_SIZE && !__hmwal_flush(_this, fd))
+            goto err;
+        n++;
+    }
+
+    if (!__hmwal_flush(_this, fd) || fdatasync(fd) < 0)
+        goto err;
+
+    if (rename(tmp, _this->path) < 0)
+        goto err;
+    __hmwal_sync_dir(_this->path);
+
+    close(_this->fd);
+    _this->fd = fd;
+    _this->pending = 0;
+    _this->error = 0;
+    _this->last_sync_ms = __hmwal_now_ms();
+    pr_info("Compact [ %s ] to [ %zd ] records", _this->path, n);
+    return true;
+
+err:
+    _this->buf_len = 0;
+    close(fd);
+    unlink(tmp);
+    pr_err("Compact [ %s ] failed!", _this->path);
+    return false;
+}
+
+static hashmap_iterator_t* hashmap_wal_insert(hashmap_wal_t* _this, hashmap_key_t key, hashmap_value_t value)
+{
+    hashmap_iterator_t* ret;
+    size_t mark;
+
+    if (unlikely(is_null(_this) || is_null(_this->hashmap)))
+        return NULL;
+
+    if (0 != _this->error)
+        return NULL;
+
+    mark = _this->buf_len;
+    if (!__hmwal_record(_this, HMWAL_OP_INSERT, key, value))
+        return NULL;
+
+    ret = chashmap->insert(_this->hashmap, key, value);
+    if (is_null(ret)) {
+        _this->buf_len = mark;
+        return NULL;
+    }
+
+    if (!__hmwal_commit(_this))
+        return NULL;
+    return ret;
+}
+
+static hashmap_iterator_t* hashmap_wal_insert_replace(hashmap_wal_t* _this, hashmap_key_t key, hashmap_value_t value)
+{
+    hashmap_iterator_t* ret;
+    size_t mark;
+
+    if (unlikely(is_null(_this) || is_null(_this->hashmap)))
+        return NULL;
+
+    if (0 != _this->error)
+        return NULL;
+
+    mark = _this->buf_len;
+    if (!__hmwal_record(_this, HMWAL_OP_REPLACE, key, value))
+        return NULL;
+
+    ret = chashmap->insert_replace(_this->hashmap, key, value);
+    if (is_null(ret)) {
+        _this->buf_len = mark;
+        return NULL;
+    }
+
+    if (!__hmwal_commit(_this))
+        return NULL;
+    return ret;
+}
+
+static hashmap_iterator_t* hashmap_wal_erase(hashmap_wal_t* _this, hashmap_iterator_t* iterator)
+{
+    hashmap_iterator_t* ret;
+    size_t mark;
+
+    if (unlikely(is_null(_this) || is_null(_this->hashmap) || is_null(iterator)))
+        return NULL;
+
+    if (0 != _this->error)
+        return NULL;
+
+    if (chashmap->end(_this->hashmap) == iterator)
+        return NULL;
+
+    /* The key is gone after `erase`, encode it first */
+    mark = _this->buf_len;
+    if (!__hmwal_record(_this, HMWAL_OP_REMOVE, iterator->key, 0))
+        return NULL;
+
+    ret = chashmap->erase(_this->hashmap, iterator);
+    if (is_null(ret)) {
+        _this->buf_len = mark;
+        return NULL;
+    }
+
+    if (!__hmwal_commit(_this))
+        return NULL;
+    return ret;
+}
+
+static hashmap_size_t hashmap_wal_remove(hashmap_wal_t* _this, hashmap_key_t key)
+{
+    hashmap_size_t ret;
+    size_t mark;
+
+    if (unlikely(is_null(_this) || is_null(_this->hashmap)))
+        return -1;
+
+    if (0 != _this->error)
+        return -1;
+
+    mark = _this->buf_len;
+    if (!__hmwal_record(_this, HMWAL_OP_REMOVE, key, 0))
+        return -1;
+
+    ret = chashmap->remove(_this->hashmap, key);
+    if (ret <= 0) {
+        _this->buf_len = mark;
+        return ret;
+    }
+
+    if (!__hmwal_commit(_this))
+        return -1;
+    return ret;
+}
+
+/* __always_inline */ inline void __hashmap_wal_init(hashmap_wal_t* wal, uint32_t sync_every, uint32_t sync_interval_ms)
+{
+    wal->hashmap          = NULL;
+    wal->type             = HM_KV_INT;
+    wal->fd               = -1;
+    wal->path             = NULL;
+    wal->buf              = NULL;
+    wal->buf_len          = 0;
+    wal->buf_cap          = 0;
+    wal->sync_every       = 0 == sync_every ? HMWAL_SYNC_EVERY_DEFAULT : sync_every;
+    wal->sync_interval_ms = 0 == sync_interval_ms ? HMWAL_SYNC_INTERVAL_DEFAULT : sync_interval_ms;
+    wal->pending          = 0;
+    wal->last_sync_ms     = 0;
+    wal->error            = 0;
+}
+
+/* __always_inline */ inline void __hashmap_wal_deinit(hashmap_wal_t* wal)
+{
+    if (!is_null(wal->hashmap))
+        hashmap_wal_close(wal);
+
+    p_free(wal->buf);
+    wal->buf_len = 0;
+    wal->buf_cap = 0;
+}
+
+/* __always_inline */ inline const class_hashmap_wal_t* class_hashmap_wal_ins(void)
+{
+    static const class_hashmap_wal_t ins = {
+        .open           = hashmap_wal_open,
+        .close          = hashmap_wal_close,
+        .insert         = hashmap_wal_insert,
+        .insert_replace = hashmap_wal_insert_replace,
+        .erase          = hashmap_wal_erase,
+        .remove         = hashmap_wal_remove,
+        .sync           = hashmap_wal_sync,
+        .tick           = hashmap_wal_tick,
+        .compact        = hashmap_wal_compact,
+        .replay         = hashmap_wal_replay,
+    };
+    return &ins;
+}
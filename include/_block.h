@@ -0,0 +1,195 @@
+/*
+  Data Structures Node Blocks
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef __J_BLOCK_H
+#define __J_BLOCK_H
+
+#include <_types.h>
+#include <_memory.h>
+
+/* `count` zeroed nodes of `size` bytes in one allocation, they follow the block header */
+static inline void* ds_block_alloc(ds_block_t** head, ds_size_t count, size_t size)
+{
+    ds_block_t* b = (ds_block_t*)p_calloc(1, sizeof(ds_block_t) + count * size);
+
+    if (NULL == b)
+        return NULL;
+
+    b->base = b;
+    b->end  = (char*)(b + 1) + count * size;
+    b->live = count;
+    b->refs = 1;
+    b->next = *head;
+    *head   = b;
+    return b + 1;
+}
+
+static inline bool __ds_block_has(const ds_block_t* b, const void* node)
+{
+    return (const char*)node >= (const char*)(b->base + 1) && (const char*)node < b->end;
+}
+
+/* `b` is off its list, the nodes go with the last header sharing them */
+static inline void __ds_block_drop(ds_block_t* b)
+{
+    ds_block_t* base = b->base;
+
+    if (b != base)
+        p_free(b);
+    if (0 == --base->refs)
+        p_free(base);
+}
+
+/* Return false if `node` isn't in a block, it's to be freed by itself then */
+static inline bool ds_block_put(ds_block_t** head, void* node)
+{
+    ds_block_t** pb;
+
+    for (pb = head; NULL != *pb; pb = &(*pb)->next) {
+        ds_block_t* b = *pb;
+
+        if (!__ds_block_has(b, node))
+            continue;
+
+        if (0 == --b->live) {
+            *pb = b->next;
+            __ds_block_drop(b);
+        }
+        return true;
+    }
+    return false;
+}
+
+/* Drop the whole block `nodes` came from, whatever its live count */
+static inline void ds_block_free(ds_block_t** head, void* nodes)
+{
+    ds_block_t** pb;
+
+    for (pb = head; NULL != *pb; pb = &(*pb)->next) {
+        ds_block_t* b = *pb;
+
+        if ((void*)(b->base + 1) == nodes) {
+            *pb = b->next;
+            __ds_block_drop(b);
+            return;
+        }
+    }
+}
+
+/* Move every block of `other` in front of `head`, the nodes in them have moved over */
+static inline void ds_block_splice(ds_block_t** head, ds_block_t** other)
+{
+    ds_block_t** pb;
+
+    if (NULL == *other)
+        return;
+
+    for (pb = other; NULL != *pb; pb = &(*pb)->next)
+        ;
+
+    *pb    = *head;
+    *head  = *other;
+    *other = NULL;
+}
+
+/* A split of the nodes of `head` goes in three steps: `ds_block_spare` takes a header per
+   block up front, so that nothing can fail once the nodes are moving, `ds_block_mark` counts
+   each node moving to the other list, and `ds_block_split` hands the blocks over. A block with
+   only some of its nodes marked ends up in both lists, each counting its own, and is freed
+   with the last of them */
+static inline bool ds_block_spare(const ds_block_t* head, ds_block_t** spare)
+{
+    ds_block_t* b = NULL;
+
+    *spare = NULL;
+    for (; NULL != head; head = head->next) {
+        b = (ds_block_t*)p_calloc(1, sizeof(ds_block_t));
+        if (NULL == b)
+            goto err;
+
+        b->next = *spare;
+        *spare  = b;
+    }
+    return true;
+
+err:
+    while (NULL != *spare) {
+        b = *spare;
+        *spare = b->next;
+        p_free(b);
+    }
+    return false;
+}
+
+/* Return false if `node` isn't in a block. A join may bring both headers of a shared block
+   into one list, the marks then fill them in turn up to their live counts */
+static inline bool ds_block_mark(ds_block_t* head, const void* node)
+{
+    for (; NULL != head; head = head->next) {
+        if (head->moved < head->live && __ds_block_has(head, node)) {
+            head->moved++;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* The blocks of `head` with every node marked move to `other`, those with some marked are
+   shared with it through a header of `spare`. The spare headers left are freed */
+static inline void ds_block_split(ds_block_t** head, ds_block_t** other, ds_block_t* spare)
+{
+    ds_block_t** pb = head;
+    ds_block_t* b = NULL;
+    ds_block_t* s = NULL;
+
+    while (NULL != (b = *pb)) {
+        if (0 == b->moved) {
+            pb = &b->next;
+            continue;
+        }
+
+        if (b->moved == b->live) {
+            *pb = b->next;
+        } else {
+            s = spare;
+            spare = s->next;
+
+            s->base = b->base;
+            s->end  = b->end;
+            s->live = b->moved;
+            b->base->refs++;
+            b->live -= b->moved;
+            b->moved = 0;
+            pb = &b->next;
+            b = s;
+        }
+
+        b->moved = 0;
+        b->next  = *other;
+        *other   = b;
+    }
+
+    while (NULL != spare) {
+        s = spare;
+        spare = s->next;
+        p_free(s);
+    }
+}
+
+#endif /* __J_BLOCK_H */
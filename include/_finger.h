@@ -0,0 +1,97 @@
+/*
+  Finger Search of Sorted Probes on rbtree
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef __J_FINGER_H
+#define __J_FINGER_H
+
+#include <_types.h>
+#include <_memory.h>
+#include <linux/rbtree.h>
+
+/* Lookups of keys in ascending order, as `contains_sorted` and `find_sorted` make: each
+   lower bound is searched from the previous one, climbing only until an ancestor bounds
+   the key and descending from there, O(log d) for a gap of d nodes instead of O(log n).
+   Nodes are told apart by the offset of their `rb_node` from the key in front of it */
+
+typedef struct ds_finger {
+    struct rb_node* node; /* First node >= `key`, NULL if there's none */
+    ds_key_t key;         /* The last probe */
+    bool started;
+} ds_finger_t;
+
+#define DS_FINGER_INIT                (ds_finger_t) { .node = NULL, .started = false, }
+#define __finger_key(_node, _off)     (*(const ds_key_t*)((const char*)(_node) - (_off)))
+#define __finger_lt(_lt, _l, _r)      (is_null(_lt) ? (_l) < (_r) : (_lt)((_l), (_r)))
+
+/* First node >= `key` under `n`, `best` if there's none */
+static inline struct rb_node* __finger_descend(struct rb_node* n, struct rb_node* best, ds_key_t key, size_t off, __comp lt)
+{
+    while (!is_null(n)) {
+        if (__finger_lt(lt, __finger_key(n, off), key)) {
+            n = n->rb_right;
+        } else {
+            best = n;
+            n = n->rb_left;
+        }
+    }
+    return best;
+}
+
+/* First node >= `key`, `from` is the first node >= some key not greater than `key` */
+static inline struct rb_node* __finger_climb(struct rb_node* from, ds_key_t key, size_t off, __comp lt)
+{
+    struct rb_node* n = from;
+    struct rb_node* p = NULL;
+
+    if (!__finger_lt(lt, __finger_key(n, off), key))
+        return n;
+
+    /* Every node under `n` before `from` is < `key`, so the answer is under `n` or is the
+       first ancestor it's left of, and that ancestor is the first one to be >= `key` */
+    for (p = rb_parent(n); !is_null(p); n = p, p = rb_parent(n)) {
+        if (p->rb_left == n && !__finger_lt(lt, __finger_key(p, off), key))
+            return __finger_descend(n->rb_right, p, key, off, lt);
+    }
+    return __finger_descend(n->rb_right, NULL, key, off, lt);
+}
+
+/* First node >= `key` in `root`, NULL if there's none. Probes out of order are still
+   right, each one that goes back is searched from the root */
+static inline struct rb_node* ds_finger_lower_bound(const struct rb_root* root, ds_finger_t* f, ds_key_t key, size_t off, __comp lt)
+{
+    if (!f->started || __finger_lt(lt, key, f->key))
+        f->node = __finger_descend(root->rb_node, NULL, key, off, lt);
+    else if (!is_null(f->node))
+        f->node = __finger_climb(f->node, key, off, lt);
+
+    f->key = key;
+    f->started = true;
+    return f->node;
+}
+
+/* Bit `i` of `bitmap` set to `on`, 64 bits a word */
+static /* __always_inline */ inline void ds_bitmap_put(uint64_t* bitmap, ds_size_t i, bool on)
+{
+    if (on)
+        bitmap[i >> 6] |= (uint64_t)1 << (i & 63);
+    else
+        bitmap[i >> 6] &= ~((uint64_t)1 << (i & 63));
+}
+
+#endif /* __J_FINGER_H */
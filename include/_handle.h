@@ -0,0 +1,70 @@
+/*
+  Data Structures Node Handles
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef __J_HANDLE_H
+#define __J_HANDLE_H
+
+#include <string.h>
+#include <_types.h>
+#include <_memory.h>
+
+/* Moving an entry between containers by handle: `extract` unlinks it and leaves its key and
+   value in the handle with the node memory, `insert_node` links them again, reusing that
+   memory when it's large enough. Neither copies nor frees the key and the value, so the ops
+   of both containers must agree on how they're owned */
+
+/* Zeroed memory for a node of `bytes`, the one held by `h` if it's large enough */
+static inline void* ds_node_handle_take(ds_node_handle_t* h, size_t bytes)
+{
+    void* node = h->node;
+
+    if (!is_null(node) && h->bytes >= bytes) {
+        memset(node, 0, bytes);
+    } else {
+        p_free(node);
+        node = p_calloc(1, bytes);
+    }
+
+    h->node = NULL;
+    h->bytes = 0;
+    return node;
+}
+
+/* `h` holds `node` from now on, a smaller one it held is dropped */
+static inline void ds_node_handle_put(ds_node_handle_t* h, void* node, size_t bytes)
+{
+    if (!is_null(h->node) && h->bytes >= bytes) {
+        p_free(node);
+        return;
+    }
+
+    p_free(h->node);
+    h->node = node;
+    h->bytes = bytes;
+}
+
+/* The key and the value have been freed or moved, only the memory is left to go */
+static inline void ds_node_handle_release(ds_node_handle_t* h)
+{
+    p_free(h->node);
+    h->bytes = 0;
+    h->full = false;
+}
+
+#endif /* __J_HANDLE_H */
@@ -0,0 +1,106 @@
+/*
+  Threaded Red-Black Trees
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef __J_THREAD_H
+#define __J_THREAD_H
+
+#include <_types.h>
+#include <_memory.h>
+#include <linux/rbtree.h>
+
+/* A threaded tree keeps the in-order neighbours of each node in two words past its
+   `rb_node`, after the size word of an order-statistic tree, so `next` and `prev` are one
+   load instead of a climb through the parents. A node is linked as a leaf, so its
+   neighbours are its parent and the one on the other side of the parent, and rebalancing
+   doesn't change the order. `off` is the distance from the `rb_node` to the two words */
+
+typedef struct ds_thread {
+    struct rb_node* prev;
+    struct rb_node* next;
+} ds_thread_t;
+
+#define DS_THREAD_EXTRA               sizeof(ds_thread_t)
+#define ds_thread_of(_node, _off)     ((ds_thread_t*)((char*)(_node) + (_off)))
+
+/* `node` has been put at `*link` under `parent`, before the rebalancing */
+static inline void ds_thread_link(struct rb_node* node, struct rb_node* parent, struct rb_node** link, size_t off, struct rb_node** leftmost)
+{
+    ds_thread_t* t = ds_thread_of(node, off);
+    ds_thread_t* p = NULL;
+
+    if (is_null(parent)) {
+        t->prev = NULL;
+        t->next = NULL;
+        *leftmost = node;
+        return;
+    }
+
+    p = ds_thread_of(parent, off);
+    if (link == &parent->rb_left) {
+        t->prev = p->prev;
+        t->next = parent;
+        p->prev = node;
+        if (is_null(t->prev))
+            *leftmost = node;
+        else
+            ds_thread_of(t->prev, off)->next = node;
+    } else {
+        t->prev = parent;
+        t->next = p->next;
+        p->next = node;
+        if (!is_null(t->next))
+            ds_thread_of(t->next, off)->prev = node;
+    }
+}
+
+static inline void ds_thread_unlink(struct rb_node* node, size_t off, struct rb_node** leftmost)
+{
+    ds_thread_t* t = ds_thread_of(node, off);
+
+    if (is_null(t->prev))
+        *leftmost = t->next;
+    else
+        ds_thread_of(t->prev, off)->next = t->next;
+
+    if (!is_null(t->next))
+        ds_thread_of(t->next, off)->prev = t->prev;
+}
+
+/* `tail` and `head` become neighbours, either may be NULL to end the thread there */
+static inline void ds_thread_splice(struct rb_node* tail, struct rb_node* head, size_t off)
+{
+    if (!is_null(tail))
+        ds_thread_of(tail, off)->next = head;
+    if (!is_null(head))
+        ds_thread_of(head, off)->prev = tail;
+}
+
+/* `n` nodes chained in order through `rb_right`, as `rb_build_sorted` takes them, are
+   threaded before they're linked */
+static inline void ds_thread_chain(struct rb_node* list, size_t n, size_t off, struct rb_node** leftmost)
+{
+    struct rb_node* prev = NULL;
+
+    *leftmost = n > 0 ? list : NULL;
+    for (; n > 0; prev = list, list = list->rb_right, --n)
+        ds_thread_splice(prev, list, off);
+    ds_thread_splice(prev, NULL, off);
+}
+
+#endif /* __J_THREAD_H */
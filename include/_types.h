@@ -37,6 +37,28 @@ typedef bool (*remove_if_condition_k)(ds_key_t key);
 typedef bool (*remove_if_condition_v)(ds_value_t value);
 typedef bool (*remove_if_condition_kv)(ds_key_t key, ds_value_t value);
 typedef bool (*__comp)(ds_data_t left, ds_data_t right);
+typedef bool (*for_each_v)(ds_value_t value, void* arg);                 /* Return false to stop the walk */
+typedef bool (*for_each_kv)(ds_key_t key, ds_value_t value, void* arg);  /* Return false to stop the walk */
+
+/* Nodes allocated at once by `build_sorted`, freed with the last of them, see `_block.h` */
+typedef struct ds_block {
+    struct ds_block* next;
+    struct ds_block* base;  /* The block holding the nodes, itself unless `split` shared it */
+    char*            end;
+    ds_size_t        live;  /* Nodes of it in use by this list */
+    ds_size_t        refs;  /* In `base`: the headers sharing it, itself included */
+    ds_size_t        moved; /* Marked by `ds_block_mark` */
+} ds_block_t;
+
+/* An entry unlinked by `extract`, with the memory of its node, see `_handle.h`.
+   A set keeps its value in `key`. Zeroed, it's an empty handle */
+typedef struct ds_node_handle {
+    void*      node;  /* Node memory to be reused by `insert_node`, may be NULL */
+    size_t     bytes; /* Size of `node` */
+    ds_key_t   key;
+    ds_value_t value;
+    bool       full;  /* `key` and `value` are owned by the handle */
+} ds_node_handle_t;
 
 /* list */
 typedef ds_data_t  list_data_t;
@@ -70,6 +92,47 @@ typedef ds_value_t multiset_value_t;
 typedef ds_size_t  multiset_size_t;
 typedef ds_count_t multiset_count_t;
 
+/* btree */
+typedef ds_key_t   btree_key_t;
+typedef ds_value_t btree_value_t;
+typedef ds_size_t  btree_size_t;
+typedef ds_count_t btree_count_t;
+
+/* interval */
+typedef ds_key_t   interval_key_t;
+typedef ds_value_t interval_value_t;
+typedef ds_size_t  interval_size_t;
+typedef ds_count_t interval_count_t;
+
+/* art */
+typedef ds_key_t   art_key_t;
+typedef ds_value_t art_value_t;
+typedef ds_size_t  art_size_t;
+typedef ds_count_t art_count_t;
+
+/* flat */
+typedef ds_key_t   flat_key_t;
+typedef ds_value_t flat_value_t;
+typedef ds_size_t  flat_size_t;
+typedef ds_count_t flat_count_t;
+
+/* sindex */
+typedef ds_key_t   sindex_key_t;
+typedef ds_value_t sindex_value_t;
+typedef ds_size_t  sindex_size_t;
+
+/* pmap */
+typedef ds_key_t   pmap_key_t;
+typedef ds_value_t pmap_value_t;
+typedef ds_size_t  pmap_size_t;
+typedef ds_count_t pmap_count_t;
+
+/* skiplist */
+typedef ds_key_t   skiplist_key_t;
+typedef ds_value_t skiplist_value_t;
+typedef ds_size_t  skiplist_size_t;
+typedef ds_count_t skiplist_count_t;
+
 /* bucket */
 typedef ds_hash_t  bucket_hash_t;
 typedef ds_key_t   bucket_key_t;
@@ -0,0 +1,115 @@
+/*
+  Adaptive Radix Tree
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef __J_ART_H
+#define __J_ART_H
+
+#include <_types.h>
+#include <map/map.h>
+
+/* Adaptive radix tree (Leis et al.) holding a map in key byte order. Inner nodes index the
+   next key byte with 4, 16, 48 or 256 slots, grown and shrunk with their children count,
+   and keep up to ART_PREFIX_MAX bytes of the path they compress, the rest is checked
+   against the key of the leaf at the end. A lookup costs O(key length) byte steps whatever
+   the size, with no comparator call on the way down.
+   Integer keys are encoded big-endian with the sign bit flipped, so the byte order is the
+   signed order. String keys (`ART_INIT_STRING`) are NUL-terminated, the NUL included, so no
+   key is a prefix of another and the order is the one of `strcmp`; `ops->__lt` is unused.
+   `cart` matches the members of `class_map_t` it has. Leaves never move, an iterator stays
+   valid until its own key is removed, `next` costs a lookup */
+#define ART_PREFIX_MAX (10)
+
+typedef enum art_node_type {
+    ART_NODE4   = 1,
+    ART_NODE16  = 2,
+    ART_NODE48  = 3,
+    ART_NODE256 = 4,
+} art_node_type_t;
+
+typedef struct art_leaf {
+    art_key_t key;      /* A `char*` in string mode */
+    art_value_t value;
+    uint32_t len;       /* Bytes of the key, with the NUL of a string */
+} art_leaf_t;
+
+typedef struct art_node {
+    uint8_t type;       /* art_node_type_t */
+    uint16_t count;
+    uint32_t prefix_len;
+    uint8_t prefix[ART_PREFIX_MAX];
+} art_node_t;
+
+typedef struct art_node4 {
+    art_node_t n;
+    uint8_t keys[4];    /* Sorted */
+    void* child[4];
+} art_node4_t;
+
+typedef struct art_node16 {
+    art_node_t n;
+    uint8_t keys[16];   /* Sorted */
+    void* child[16];
+} art_node16_t;
+
+typedef struct art_node48 {
+    art_node_t n;
+    uint8_t index[256]; /* Slot + 1 in `child`, 0 if none */
+    void* child[48];
+} art_node48_t;
+
+typedef struct art_node256 {
+    art_node_t n;
+    void* child[256];
+} art_node256_t;
+
+typedef struct art {
+    const class_map_ops_t* ops;
+    void* root;         /* A node, or a leaf tagged with bit 0 */
+    art_size_t size;
+    bool string;
+} art_t;
+
+typedef struct class_art {
+    art_size_t (*size)(const art_t* _this);
+    map_iterator_t* (*end)(const art_t* _this);
+    map_iterator_t* (*begin)(const art_t* _this);
+    map_iterator_t* (*next)(const art_t* _this, const map_iterator_t* iterator);
+    map_iterator_t* (*find)(const art_t* _this, art_key_t key);
+    map_iterator_t* (*lower_bound)(const art_t* _this, art_key_t key);                 /* >= key */
+    map_iterator_t* (*upper_bound)(const art_t* _this, art_key_t key);                 /*  > key */
+    map_iterator_t* (*insert)(art_t* _this, art_key_t key, art_value_t value);         /* Return NULL if `key` exists */
+    map_iterator_t* (*insert_replace)(art_t* _this, art_key_t key, art_value_t value);
+    map_iterator_t* (*erase)(art_t* _this, map_iterator_t* iterator);
+    art_size_t (*remove)(art_t* _this, art_key_t key);
+    art_size_t (*clear)(art_t* _this);
+    art_size_t (*for_each_range)(const art_t* _this, art_key_t lo, art_key_t hi, for_each_kv cb, void* arg); /* Visit the keys in [ lo, hi ) in order until `cb` returns false, return the count visited */
+    art_size_t (*for_each_prefix)(const art_t* _this, const char* prefix, for_each_kv cb, void* arg);      /* String mode: visit the keys starting with `prefix` in order until `cb` returns false, return the count visited */
+} class_art_t;
+
+void __art_init(art_t* art);
+void __art_deinit(art_t* art);
+const class_art_t* class_art_ins(void);
+#define g_class_art()                 class_art_ins()
+#define cart                          g_class_art()
+#define ART_INIT(_ptr)                (art_t) { .ops = NULL, .size = 0, .string = false, }; __art_init((_ptr))
+#define ART_INIT_OPS(_ptr, _ops)      (art_t) { .ops = _ops, .size = 0, .string = false, }; __art_init((_ptr))
+#define ART_INIT_STRING(_ptr, _ops)   (art_t) { .ops = _ops, .size = 0, .string = true, }; __art_init((_ptr))
+#define ART_DEINIT(_ptr)              do { __art_deinit((_ptr)); } while(0)
+
+#endif /* __J_ART_H */
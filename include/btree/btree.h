@@ -0,0 +1,143 @@
+/*
+  B+tree Interfaces
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef __J_BTREE_H
+#define __J_BTREE_H
+
+#include <_types.h>
+#include <map/map.h>
+#include <set/set.h>
+
+/* A B+tree backend for the ordered containers. Entries live in leaves of 14 pairs (256 bytes,
+   4 cache lines) chained in order, inner nodes hold 16 integer separators in 2 cache lines,
+   so a lookup touches a few nodes instead of one `rb_node` per level.
+   The same tree serves as map, multimap, set or multiset, picked by the init macro, and is
+   driven through `cbtree_map`, `cbtree_multimap`, `cbtree_set` or `cbtree_multiset`, whose
+   members match `class_map_t`, `class_multimap_t`, `class_set_t` and `class_multiset_t`.
+   Iterators point into a leaf, so any insert or erase invalidates all iterators, the one
+   returned by `erase` excepted */
+#define BTREE_LEAF_BYTES (256)
+#define BTREE_LEAF_SLOTS (14)
+#define BTREE_INNER_KEYS (16)
+
+typedef struct btree_kv {
+    btree_key_t   key;   /* The value in set mode */
+    btree_value_t value;
+} btree_kv_t;
+
+typedef struct btree_leaf {
+    btree_kv_t          kv[BTREE_LEAF_SLOTS]; /* Must be first, leaves are aligned to BTREE_LEAF_BYTES */
+    struct btree_leaf*  next;
+    struct btree_leaf*  prev;
+    struct btree_inner* parent;
+    uint32_t            count;
+} btree_leaf_t;
+
+/* Every key of `child[i]` is in [ keys[i - 1], keys[i] ] */
+typedef struct btree_inner {
+    btree_key_t         keys[BTREE_INNER_KEYS];
+    void*               child[BTREE_INNER_KEYS + 1];
+    struct btree_inner* parent;
+    uint32_t            count; /* Count of keys */
+} btree_inner_t;
+
+typedef union btree_config {
+    struct {
+        uint32_t b_multi : 1;  /* Equal keys are allowed */
+        uint32_t b_set   : 1;  /* There's no value, set ops have been translated into `ops_set` */
+    } c;
+    uint32_t d;
+} btree_config_t;
+
+typedef struct btree {
+    const class_map_ops_t* ops;
+    class_map_ops_t        ops_set; /* Set mode: `class_set_ops_t` in the map layout, the `_ptr` of the init macro mustn't be moved */
+    void*                  root;
+    btree_leaf_t*          head;
+    btree_leaf_t*          tail;
+    uint32_t               height;  /* 0: empty, 1: the root is a leaf */
+    btree_config_t         config;
+    btree_size_t           size;
+} btree_t;
+
+typedef struct class_btree_map {
+    btree_size_t (*size)(const btree_t* _this);
+    btree_count_t (*count)(const btree_t* _this, btree_key_t key);
+    map_iterator_t* (*end)(const btree_t* _this);
+    map_iterator_t* (*begin)(const btree_t* _this);
+    map_iterator_t* (*next)(const btree_t* _this, const map_iterator_t* iterator);
+    map_iterator_t* (*prev)(const btree_t* _this, const map_iterator_t* iterator);
+    map_r_iterator_t* (*rend)(const btree_t* _this);
+    map_r_iterator_t* (*rbegin)(const btree_t* _this);
+    map_r_iterator_t* (*rnext)(const btree_t* _this, const map_r_iterator_t* r_iterator);
+    map_r_iterator_t* (*rprev)(const btree_t* _this, const map_r_iterator_t* r_iterator);
+    map_iterator_t* (*find)(const btree_t* _this, btree_key_t key);
+    map_iterator_t* (*lower_bound)(const btree_t* _this, btree_key_t key);                   /* >= key */
+    map_iterator_t* (*upper_bound)(const btree_t* _this, btree_key_t key);                   /*  > key */
+    map_iterator_t* (*insert)(btree_t* _this, btree_key_t key, btree_value_t value);         /* map: return NULL if `key` exists | multimap: always insert after the equal keys */
+    map_iterator_t* (*insert_replace)(btree_t* _this, btree_key_t key, btree_value_t value); /* NULL in `cbtree_multimap` */
+    map_iterator_t* (*erase)(btree_t* _this, map_iterator_t* iterator);
+    btree_size_t (*remove)(btree_t* _this, btree_key_t key);
+    btree_size_t (*remove_if)(btree_t* _this, remove_if_condition_kv cond);
+    btree_size_t (*clear)(btree_t* _this);
+} class_btree_map_t;
+
+typedef struct class_btree_set {
+    btree_size_t (*size)(const btree_t* _this);
+    btree_count_t (*count)(const btree_t* _this, btree_key_t value);
+    set_iterator_t* (*end)(const btree_t* _this);
+    set_iterator_t* (*begin)(const btree_t* _this);
+    set_iterator_t* (*next)(const btree_t* _this, const set_iterator_t* iterator);
+    set_iterator_t* (*prev)(const btree_t* _this, const set_iterator_t* iterator);
+    set_r_iterator_t* (*rend)(const btree_t* _this);
+    set_r_iterator_t* (*rbegin)(const btree_t* _this);
+    set_r_iterator_t* (*rnext)(const btree_t* _this, const set_r_iterator_t* r_iterator);
+    set_r_iterator_t* (*rprev)(const btree_t* _this, const set_r_iterator_t* r_iterator);
+    set_iterator_t* (*find)(const btree_t* _this, btree_key_t value);
+    set_iterator_t* (*lower_bound)(const btree_t* _this, btree_key_t value); /* >= value */
+    set_iterator_t* (*upper_bound)(const btree_t* _this, btree_key_t value); /*  > value */
+    set_iterator_t* (*insert)(btree_t* _this, btree_key_t value);            /* set: return NULL if `value` exists | multiset: always insert after the equal values */
+    set_iterator_t* (*erase)(btree_t* _this, set_iterator_t* iterator);
+    btree_size_t (*remove)(btree_t* _this, btree_key_t value);
+    btree_size_t (*remove_if)(btree_t* _this, remove_if_condition_v cond);
+    btree_size_t (*clear)(btree_t* _this);
+} class_btree_set_t;
+
+void __btree_init(btree_t* btree, const class_map_ops_t* ops, bool multi);
+void __btree_init_set(btree_t* btree, const class_set_ops_t* ops, bool multi);
+void __btree_deinit(btree_t* btree);
+const class_btree_map_t* class_btree_map_ins(void);
+const class_btree_map_t* class_btree_multimap_ins(void);
+const class_btree_set_t* class_btree_set_ins(void);
+const class_btree_set_t* class_btree_multiset_ins(void);
+#define cbtree_map                            class_btree_map_ins()
+#define cbtree_multimap                       class_btree_multimap_ins()
+#define cbtree_set                            class_btree_set_ins()
+#define cbtree_multiset                       class_btree_multiset_ins()
+#define BTREE_MAP_INIT(_ptr)                  (btree_t) { .ops = NULL, .size = 0, }; __btree_init((_ptr), NULL, false)
+#define BTREE_MAP_INIT_OPS(_ptr, _ops)        (btree_t) { .ops = NULL, .size = 0, }; __btree_init((_ptr), (_ops), false)
+#define BTREE_MULTIMAP_INIT(_ptr)             (btree_t) { .ops = NULL, .size = 0, }; __btree_init((_ptr), NULL, true)
+#define BTREE_MULTIMAP_INIT_OPS(_ptr, _ops)   (btree_t) { .ops = NULL, .size = 0, }; __btree_init((_ptr), (_ops), true)
+#define BTREE_SET_INIT(_ptr)                  (btree_t) { .ops = NULL, .size = 0, }; __btree_init_set((_ptr), NULL, false)
+#define BTREE_SET_INIT_OPS(_ptr, _ops)        (btree_t) { .ops = NULL, .size = 0, }; __btree_init_set((_ptr), (_ops), false)
+#define BTREE_MULTISET_INIT(_ptr)             (btree_t) { .ops = NULL, .size = 0, }; __btree_init_set((_ptr), NULL, true)
+#define BTREE_MULTISET_INIT_OPS(_ptr, _ops)   (btree_t) { .ops = NULL, .size = 0, }; __btree_init_set((_ptr), (_ops), true)
+#define BTREE_DEINIT(_ptr)                    do { __btree_deinit((_ptr)); } while(0)
+
+#endif /* __J_BTREE_H */
@@ -30,6 +30,7 @@ typedef struct class_bucket_ops {
     bool (*valid_value)(bucket_value_t value);                  /* Return true if `value` is valid */
     bool (*copy_value)(bucket_value_t in, bucket_value_t* out); /* The function pointer can be null and manages memory on its own. However, if this function is implemented, `free_value` must also be implemented */
     void (*free_value)(bucket_value_t* value);                  /* The function pointer can be null and manages memory on its own */
+    int (*__cmp)(bucket_key_t left, bucket_key_t right);        /* Optional, with `__lt` set and agreeing with it: return < 0, 0 or > 0 as [ `left` < `right` ], [ `left` == `right` ] or [ `left` > `right` ]. Searches and inserts then compare once per node instead of twice */
 } class_bucket_ops_t;
 
 #endif /* __J_BUCKET_OPS_H */
@@ -0,0 +1,125 @@
+/*
+  Flat Map and Set
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef __J_FLAT_H
+#define __J_FLAT_H
+
+#include <_types.h>
+#include <map/map.h>
+#include <set/set.h>
+#include <vector/vector.h>
+
+/* A map or a set kept as one sorted array in a `vector_t`: pairs laid out key, value, key,
+   value ... (values only in set mode), so an entry costs 16 (8) bytes instead of a 48-byte
+   `rb_node`, and `find` and `lower_bound` are a binary search over contiguous memory.
+   Read-mostly tables should be made with `build_sorted`, which sorts once in O(n log n)
+   (O(n) if the input is sorted already); `insert`, `erase` and `remove` shift the tail of
+   the array and cost O(n), appending past the greatest key costs O(1) amortized.
+   `cflat_map` and `cflat_set` match the members of `class_map_t` and `class_set_t` they
+   have. Iterators point into the array, so any insert or erase invalidates all iterators,
+   the one returned by `erase` excepted */
+typedef union flat_config {
+    struct {
+        uint32_t b_set : 1; /* There's no value, set ops have been translated into `ops_set` */
+    } c;
+    uint32_t d;
+} flat_config_t;
+
+typedef struct flat {
+    const class_map_ops_t* ops;
+    class_map_ops_t        ops_set; /* Set mode: `class_set_ops_t` in the map layout, the `_ptr` of the init macro mustn't be moved */
+    vector_t               vec;     /* `size` is the count of ds_data_t, twice the count of pairs in map mode */
+    flat_config_t          config;
+} flat_t;
+
+typedef struct class_flat_map {
+    flat_size_t (*size)(const flat_t* _this);
+    flat_count_t (*count)(const flat_t* _this, flat_key_t key);
+    map_iterator_t* (*end)(const flat_t* _this);
+    map_iterator_t* (*begin)(const flat_t* _this);
+    map_iterator_t* (*next)(const flat_t* _this, const map_iterator_t* iterator);
+    map_iterator_t* (*prev)(const flat_t* _this, const map_iterator_t* iterator);
+    map_r_iterator_t* (*rend)(const flat_t* _this);
+    map_r_iterator_t* (*rbegin)(const flat_t* _this);
+    map_r_iterator_t* (*rnext)(const flat_t* _this, const map_r_iterator_t* r_iterator);
+    map_r_iterator_t* (*rprev)(const flat_t* _this, const map_r_iterator_t* r_iterator);
+    map_iterator_t* (*find)(const flat_t* _this, flat_key_t key);
+    map_iterator_t* (*lower_bound)(const flat_t* _this, flat_key_t key);                  /* >= key */
+    map_iterator_t* (*upper_bound)(const flat_t* _this, flat_key_t key);                  /*  > key */
+    map_iterator_t* (*insert)(flat_t* _this, flat_key_t key, flat_value_t value);         /* O(n), return NULL if `key` exists */
+    map_iterator_t* (*insert_replace)(flat_t* _this, flat_key_t key, flat_value_t value); /* O(n) */
+    map_iterator_t* (*erase)(flat_t* _this, map_iterator_t* iterator);                    /* O(n) */
+    flat_size_t (*remove)(flat_t* _this, flat_key_t key);                                 /* O(n) */
+    flat_size_t (*remove_if)(flat_t* _this, remove_if_condition_kv cond);                 /* O(n) for any count removed */
+    flat_size_t (*clear)(flat_t* _this);
+    flat_size_t (*build_sorted)(flat_t* _this, const flat_key_t* keys, const flat_value_t* values, flat_size_t n); /* Only into an empty map, `values` may be NULL. Unsorted input is sorted first, the first of equal keys is kept. Return the size or -1 */
+    flat_size_t (*rank)(const flat_t* _this, flat_key_t key);                     /* Count of keys < `key` */
+    map_iterator_t* (*select)(const flat_t* _this, flat_size_t k);                /* The k-th in order from 0, `end` if k >= size */
+    flat_size_t (*count_range)(const flat_t* _this, flat_key_t lo, flat_key_t hi); /* Count of keys in [ lo, hi ) */
+    map_iterator_t* (*insert_hint)(flat_t* _this, map_iterator_t* hint, flat_key_t key, flat_value_t value); /* As `insert`, without the search if `key` belongs right before `hint`, or at `end` */
+    map_iterator_t* (*equal_range)(const flat_t* _this, flat_key_t key, map_iterator_t** last); /* [ return, *last ) holds the keys equal to `key`, both are `lower_bound` if there's none */
+    flat_size_t (*erase_range)(flat_t* _this, flat_key_t lo, flat_key_t hi); /* Erase the keys in [ lo, hi ) with one shift of the tail, return the count erased */
+    flat_size_t (*for_each_range)(const flat_t* _this, flat_key_t lo, flat_key_t hi, for_each_kv cb, void* arg); /* Visit the keys in [ lo, hi ) in order until `cb` returns false, return the count visited */
+    bool (*reserve)(flat_t* _this, flat_size_t n); /* Room for `n` pairs */
+} class_flat_map_t;
+
+typedef struct class_flat_set {
+    flat_size_t (*size)(const flat_t* _this);
+    flat_count_t (*count)(const flat_t* _this, flat_key_t value);
+    set_iterator_t* (*end)(const flat_t* _this);
+    set_iterator_t* (*begin)(const flat_t* _this);
+    set_iterator_t* (*next)(const flat_t* _this, const set_iterator_t* iterator);
+    set_iterator_t* (*prev)(const flat_t* _this, const set_iterator_t* iterator);
+    set_r_iterator_t* (*rend)(const flat_t* _this);
+    set_r_iterator_t* (*rbegin)(const flat_t* _this);
+    set_r_iterator_t* (*rnext)(const flat_t* _this, const set_r_iterator_t* r_iterator);
+    set_r_iterator_t* (*rprev)(const flat_t* _this, const set_r_iterator_t* r_iterator);
+    set_iterator_t* (*find)(const flat_t* _this, flat_key_t value);
+    set_iterator_t* (*lower_bound)(const flat_t* _this, flat_key_t value); /* >= value */
+    set_iterator_t* (*upper_bound)(const flat_t* _this, flat_key_t value); /*  > value */
+    set_iterator_t* (*insert)(flat_t* _this, flat_key_t value);            /* O(n), return NULL if `value` exists */
+    set_iterator_t* (*erase)(flat_t* _this, set_iterator_t* iterator);     /* O(n) */
+    flat_size_t (*remove)(flat_t* _this, flat_key_t value);                /* O(n) */
+    flat_size_t (*remove_if)(flat_t* _this, remove_if_condition_v cond);   /* O(n) for any count removed */
+    flat_size_t (*clear)(flat_t* _this);
+    flat_size_t (*build_sorted)(flat_t* _this, const flat_key_t* values, flat_size_t n); /* Only into an empty set. Unsorted input is sorted first, the first of equal values is kept. Return the size or -1 */
+    flat_size_t (*rank)(const flat_t* _this, flat_key_t value);                     /* Count of values < `value` */
+    set_iterator_t* (*select)(const flat_t* _this, flat_size_t k);                  /* The k-th in order from 0, `end` if k >= size */
+    flat_size_t (*count_range)(const flat_t* _this, flat_key_t lo, flat_key_t hi);  /* Count of values in [ lo, hi ) */
+    set_iterator_t* (*insert_hint)(flat_t* _this, set_iterator_t* hint, flat_key_t value); /* As `insert`, without the search if `value` belongs right before `hint`, or at `end` */
+    set_iterator_t* (*equal_range)(const flat_t* _this, flat_key_t value, set_iterator_t** last); /* [ return, *last ) holds the values equal to `value`, both are `lower_bound` if there's none */
+    flat_size_t (*erase_range)(flat_t* _this, flat_key_t lo, flat_key_t hi); /* Erase the values in [ lo, hi ) with one shift of the tail, return the count erased */
+    flat_size_t (*for_each_range)(const flat_t* _this, flat_key_t lo, flat_key_t hi, for_each_v cb, void* arg); /* Visit the values in [ lo, hi ) in order until `cb` returns false, return the count visited */
+    bool (*reserve)(flat_t* _this, flat_size_t n); /* Room for `n` values */
+} class_flat_set_t;
+
+void __flat_init(flat_t* flat, const class_map_ops_t* ops);
+void __flat_init_set(flat_t* flat, const class_set_ops_t* ops);
+void __flat_deinit(flat_t* flat);
+const class_flat_map_t* class_flat_map_ins(void);
+const class_flat_set_t* class_flat_set_ins(void);
+#define cflat_map                      class_flat_map_ins()
+#define cflat_set                      class_flat_set_ins()
+#define FLAT_MAP_INIT(_ptr)            (flat_t) { .ops = NULL, }; __flat_init((_ptr), NULL)
+#define FLAT_MAP_INIT_OPS(_ptr, _ops)  (flat_t) { .ops = NULL, }; __flat_init((_ptr), (_ops))
+#define FLAT_SET_INIT(_ptr)            (flat_t) { .ops = NULL, }; __flat_init_set((_ptr), NULL)
+#define FLAT_SET_INIT_OPS(_ptr, _ops)  (flat_t) { .ops = NULL, }; __flat_init_set((_ptr), (_ops))
+#define FLAT_DEINIT(_ptr)              do { __flat_deinit((_ptr)); } while(0)
+
+#endif /* __J_FLAT_H */
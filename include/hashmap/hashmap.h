@@ -30,6 +30,16 @@ typedef struct hashmap_node {
 } hashmap_node_t;
 typedef bucket_node_t hashmap_bnode_t;
 
+/* Node of the compact mode: chains link through 32-bit indices into `hashmap_t::pool`
+   and only the low 32 bits of the hash are kept, 24 bytes in total and no malloc header.
+   Iterators of a compact hashmap point at these nodes, so `iterator->hash` isn't meaningful */
+typedef struct hashmap_cnode {
+    hashmap_key_t   key;
+    hashmap_value_t value;
+    uint32_t        tag;  /* Low 32 bits of the hash */
+    uint32_t        next; /* Index of the next node in the chain, 0 terminates */
+} hashmap_cnode_t;
+
 typedef struct hashmap_iterator {
     union {
         hashmap_key_t key;
@@ -60,10 +70,18 @@ typedef union hashmap_config {
         uint32_t b_bkt_only_l : 1;
         uint32_t b_bkt_only_r : 1;
         uint32_t b_bkt_l_to_r : 1;
+        uint32_t b_compact    : 1; /* Store entries as `hashmap_cnode_t` in a node pool */
     } c;
     uint32_t d;
 } hashmap_config_t;
 
+/* Describes how `key` and `value` are encoded when a hashmap is written out of process memory */
+typedef enum hashmap_kv_type {
+    HM_KV_INT          = 0x0, /* Both `key` and `value` are integers */
+    HM_KV_KEY_STRING   = 0x1, /* `key` is a NUL-terminated string */
+    HM_KV_VALUE_STRING = 0x2, /* `value` is a NUL-terminated string */
+} hashmap_kv_type_t;
+
 typedef struct hashmap {
     const class_hashmap_ops_t* ops;
     hashmap_node_t*  head;
@@ -76,6 +94,11 @@ typedef struct hashmap {
     hashmap_bcount_t bucket_valid_count;
     hashmap_bcount_t pi_s;
     hashmap_bcount_t pi_e;
+    uint32_t*        chead;     /* Compact mode: bucket heads, indices into `pool` */
+    hashmap_cnode_t* pool;      /* Compact mode: node pool, index 0 is never used */
+    uint32_t         pool_cap;
+    uint32_t         pool_used; /* Highest index handed out */
+    uint32_t         pool_free; /* Head of the free list, linked through `next` */
 } hashmap_t;
 
 typedef struct class_hashmap {
@@ -97,6 +120,10 @@ typedef struct class_hashmap {
     hashmap_iterator_t* (*erase)(hashmap_t* _this, hashmap_iterator_t* iterator);
     hashmap_size_t (*remove)(hashmap_t* _this, hashmap_key_t key);
     hashmap_size_t (*clear)(hashmap_t* _this);
+    hashmap_bcount_t (*reserve)(hashmap_t* _this, hashmap_size_t count);                                /* Make room for `count` entries so that inserting them doesn't rehash, return the bucket count */
+    hashmap_iterator_t* (*extract)(hashmap_t* _this, hashmap_iterator_t* iterator, ds_node_handle_t* handle); /* As `erase`, but the entry is moved into the empty `handle` with its node memory instead of being freed, see `_handle.h`. A compact hashmap keeps the pool node */
+    hashmap_iterator_t* (*insert_node)(hashmap_t* _this, ds_node_handle_t* handle); /* As `insert` with the entry of `handle`, reusing its node memory and without copying the key or the value. On success the handle is empty */
+    void (*free_node)(hashmap_t* _this, ds_node_handle_t* handle); /* Free what `handle` holds with the ops of `_this` */
 } class_hashmap_t;
 
 void __hashmap_init(hashmap_t* hashmap);
@@ -127,4 +154,12 @@ const class_hashmap_t* class_hashmap_ins(void);
 #define HASHMAP_INIT_OPS_4(_ptr, _ops, _bucket_count_init, _bucket_count_max, _load_factor, _config) \
         (hashmap_t) { .ops = _ops, .size = 0, }; __hashmap_init_arg((_ptr), 4, (_bucket_count_init), (_bucket_count_max), (_load_factor), (_config))
 
+#define HASHMAP_CONFIG_COMPACT           (&(hashmap_config_t) { .c = { .b_compact = 1, }, })
+#define HASHMAP_INIT_COMPACT(_ptr) \
+        (hashmap_t) { .ops = NULL, .size = 0, }; \
+        __hashmap_init_arg((_ptr), 4, (hashmap_bcount_t)0, (hashmap_bcount_t)0, 0.0, HASHMAP_CONFIG_COMPACT)
+#define HASHMAP_INIT_OPS_COMPACT(_ptr, _ops) \
+        (hashmap_t) { .ops = _ops, .size = 0, }; \
+        __hashmap_init_arg((_ptr), 4, (hashmap_bcount_t)0, (hashmap_bcount_t)0, 0.0, HASHMAP_CONFIG_COMPACT)
+
 #endif /* __J_HASH_MAP_H */
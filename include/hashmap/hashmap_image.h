@@ -0,0 +1,79 @@
+/*
+  Hashmap Image Interfaces
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef __J_HASH_MAP_IMAGE_H
+#define __J_HASH_MAP_IMAGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <hashmap/hashmap.h>
+
+/* On-disk layout (all offsets are relative to the start of the file, little endian):
+   [ header | slots[slot_count] | arena ]
+   `slots` is an open-addressing table (linear probing), string keys and values are
+   stored as offsets into `arena`, so the image contains no pointers at all */
+#define HASHMAP_IMAGE_MAGIC   (0x474d4948) /* "HIMG" */
+#define HASHMAP_IMAGE_VERSION (1)
+
+typedef struct hashmap_image_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t type;       /* hashmap_kv_type_t */
+    uint32_t reserved;
+    uint64_t size;       /* Count of entries */
+    uint64_t slot_count; /* Power of 2 */
+    uint64_t off_slots;
+    uint64_t off_arena;
+    uint64_t arena_size;
+    uint64_t file_size;
+} hashmap_image_header_t;
+
+typedef struct hashmap_image_slot {
+    uint64_t hash;       /* 0 means the slot is empty */
+    int64_t  key;        /* Integer key or offset into arena */
+    int64_t  value;      /* Integer value or offset into arena */
+} hashmap_image_slot_t;
+
+typedef struct hashmap_image {
+    const void*                   base;
+    size_t                        length;
+    const hashmap_image_header_t* header;
+    const hashmap_image_slot_t*   slots;
+    const char*                   arena;
+} hashmap_image_t;
+
+typedef struct class_hashmap_image {
+    bool (*dump)(const hashmap_t* hashmap, const char* path, hashmap_kv_type_t type); /* Write `hashmap` to `path` (via a temporary file and `rename`) */
+    bool (*load)(hashmap_image_t* _this, const char* path);                          /* Map the image at `path` read-only, nothing is deserialized */
+    void (*unload)(hashmap_image_t* _this);
+    hashmap_size_t (*size)(const hashmap_image_t* _this);
+    hashmap_count_t (*count)(const hashmap_image_t* _this, hashmap_key_t key);
+    bool (*find)(const hashmap_image_t* _this, hashmap_key_t key, hashmap_value_t* value); /* String values point into the mapping and stay valid until `unload` */
+    hashmap_size_t (*for_each)(const hashmap_image_t* _this, for_each_kv cb, void* arg);  /* Visit entries in slot order until `cb` returns false, return the count visited */
+} class_hashmap_image_t;
+
+void __hashmap_image_init(hashmap_image_t* image);
+void __hashmap_image_deinit(hashmap_image_t* image);
+const class_hashmap_image_t* class_hashmap_image_ins(void);
+#define g_class_hashmap_image()  class_hashmap_image_ins()
+#define chashmap_image           g_class_hashmap_image()
+#define HASHMAP_IMAGE_INIT(_ptr)   (hashmap_image_t) { .base = NULL, .length = 0, }; __hashmap_image_init((_ptr))
+#define HASHMAP_IMAGE_DEINIT(_ptr) do { __hashmap_image_deinit((_ptr)); } while(0)
+
+#endif /* __J_HASH_MAP_IMAGE_H */
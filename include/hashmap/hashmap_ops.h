@@ -31,6 +31,7 @@ typedef struct class_hashmap_ops {
     bool (*valid_value)(hashmap_value_t value);                   /* Return true if `valid` is valid */
     bool (*copy_value)(hashmap_value_t in, hashmap_value_t* out); /* The function pointer can be null and manages memory on its own. However, if this function is implemented, `free_value` must also be implemented */
     void (*free_value)(hashmap_value_t* value);                   /* The function pointer can be null and manages memory on its own */
+    int (*__cmp)(hashmap_key_t left, hashmap_key_t right);        /* Optional, with `__lt` set and agreeing with it: return < 0, 0 or > 0 as [ `left` < `right` ], [ `left` == `right` ] or [ `left` > `right` ]. Searches and inserts then compare once per node instead of twice */
 } class_hashmap_ops_t;
 
 #endif /* __J_HASH_MAP_OPS_H */
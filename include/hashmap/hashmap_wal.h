@@ -0,0 +1,86 @@
+/*
+  Hashmap Write-Ahead Log Interfaces
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef __J_HASH_MAP_WAL_H
+#define __J_HASH_MAP_WAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <hashmap/hashmap.h>
+
+/* Log layout: [ header | record | record | ... ]
+   record: [ u32 payload length | u32 checksum | u8 op | key | value ]
+   key/value: integer -> 8 bytes, string -> [ u32 length | bytes ] (length 0xffffffff is NULL)
+   Replay stops at the first torn or corrupted record and the tail is cut off.
+   A failed `write` or `fdatasync` is latched in `error`: the change that hit it stays in
+   the hashmap but is reported as failed, and the log refuses further changes, `sync` and
+   a clean `close` until `compact` rewrites it from the hashmap.
+   Replay hands string keys and values to the hashmap from a buffer it reuses, so a type with
+   HM_KV_KEY_STRING needs `ops->copy_key` and one with HM_KV_VALUE_STRING needs `ops->copy_value`,
+   `open` and `replay` return -1 otherwise */
+#define HASHMAP_WAL_MAGIC   (0x4c41574d) /* "MWAL" */
+#define HASHMAP_WAL_VERSION (2)
+
+typedef struct hashmap_wal_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t type;       /* hashmap_kv_type_t */
+    uint32_t reserved;
+} hashmap_wal_header_t; /* No entry count, replay counts the intact records instead */
+
+typedef struct hashmap_wal {
+    hashmap_t*        hashmap;
+    hashmap_kv_type_t type;
+    int               fd;
+    char*             path;
+    char*             buf;               /* Records not yet written to `fd` */
+    size_t            buf_len;
+    size_t            buf_cap;
+    uint32_t          sync_every;        /* Group commit: `fsync` once per `sync_every` records ... */
+    uint32_t          sync_interval_ms;  /* ... or once `sync_interval_ms` has passed, whichever comes first.
+                                            The clock is only checked by a change or by `tick` */
+    uint64_t          pending;           /* Records appended since the last `fsync` */
+    uint64_t          last_sync_ms;
+    int               error;             /* `errno` of the first failed `write` or `fdatasync`, 0 if none */
+} hashmap_wal_t;
+
+typedef struct class_hashmap_wal {
+    hashmap_size_t (*open)(hashmap_wal_t* _this, hashmap_t* hashmap, const char* path, hashmap_kv_type_t type); /* Replay `path` into the empty `hashmap` and log further changes, return the count of records replayed */
+    bool (*close)(hashmap_wal_t* _this);                                                                  /* Flush, `fsync` and detach, the hashmap itself is kept */
+    hashmap_iterator_t* (*insert)(hashmap_wal_t* _this, hashmap_key_t key, hashmap_value_t value);
+    hashmap_iterator_t* (*insert_replace)(hashmap_wal_t* _this, hashmap_key_t key, hashmap_value_t value);
+    hashmap_iterator_t* (*erase)(hashmap_wal_t* _this, hashmap_iterator_t* iterator);
+    hashmap_size_t (*remove)(hashmap_wal_t* _this, hashmap_key_t key);
+    bool (*sync)(hashmap_wal_t* _this);                                                                   /* Force the group commit now */
+    bool (*tick)(hashmap_wal_t* _this);                                                                   /* Commit pending records if `sync_interval_ms` has passed, call it from an idle loop or a timer so a quiet tail still reaches the disk */
+    bool (*compact)(hashmap_wal_t* _this);                                                                /* Rewrite the log as one insert record per live entry, clears `error` on success */
+    hashmap_size_t (*replay)(hashmap_t* hashmap, const char* path, hashmap_kv_type_t type);               /* Rebuild `hashmap` from `path` without attaching a log, return the count of records replayed. The hashmap is sized once from the records before they are applied */
+} class_hashmap_wal_t;
+
+void __hashmap_wal_init(hashmap_wal_t* wal, uint32_t sync_every, uint32_t sync_interval_ms);
+void __hashmap_wal_deinit(hashmap_wal_t* wal);
+const class_hashmap_wal_t* class_hashmap_wal_ins(void);
+#define g_class_hashmap_wal()  class_hashmap_wal_ins()
+#define chashmap_wal           g_class_hashmap_wal()
+#define HASHMAP_WAL_INIT(_ptr) (hashmap_wal_t) { .hashmap = NULL, .fd = -1, }; __hashmap_wal_init((_ptr), 0, 0)
+#define HASHMAP_WAL_INIT_2(_ptr, _sync_every, _sync_interval_ms) \
+        (hashmap_wal_t) { .hashmap = NULL, .fd = -1, }; __hashmap_wal_init((_ptr), (_sync_every), (_sync_interval_ms))
+#define HASHMAP_WAL_DEINIT(_ptr) do { __hashmap_wal_deinit((_ptr)); } while(0)
+
+#endif /* __J_HASH_MAP_WAL_H */
@@ -0,0 +1,95 @@
+/*
+  Interval Tree Interfaces
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef __J_INTERVAL_H
+#define __J_INTERVAL_H
+
+#include <linux/_types.h>
+#include <interval/interval_ops.h>
+
+/* Half-open intervals [ lo, hi ) ordered by `lo` then `hi`, equal ones are all kept.
+   Every node caches the greatest `hi` of its subtree, kept up by the augment callbacks of
+   `linux/rbtree.h`, so a subtree without overlap is skipped whole and an overlap query
+   takes O(log n + k) for k results */
+typedef struct interval_node {
+    interval_key_t lo;
+    interval_key_t hi;
+    interval_value_t value;
+    interval_key_t max; /* Greatest `hi` in the subtree */
+    struct rb_node node;
+} interval_node_t;
+
+typedef struct interval_iterator {
+    interval_key_t lo;
+    interval_key_t hi;
+    union {
+        interval_value_t value;
+        char* svalue;
+    };
+} interval_iterator_t;
+
+typedef struct interval_reverse_iterator {
+    interval_key_t lo;
+    interval_key_t hi;
+    union {
+        interval_value_t value;
+        char* svalue;
+    };
+} interval_reverse_iterator_t;
+typedef interval_reverse_iterator_t interval_r_iterator_t;
+
+typedef bool (*for_each_interval)(interval_key_t lo, interval_key_t hi, interval_value_t value, void* arg); /* Return false to stop the walk */
+
+typedef struct interval {
+    const class_interval_ops_t* ops;
+    struct rb_root root;
+    interval_size_t size;
+} interval_t;
+
+typedef struct class_interval {
+    interval_size_t (*size)(const interval_t* _this);
+    interval_iterator_t* (*end)(const interval_t* _this);
+    interval_iterator_t* (*begin)(const interval_t* _this);
+    interval_iterator_t* (*next)(const interval_t* _this, const interval_iterator_t* iterator);
+    interval_iterator_t* (*prev)(const interval_t* _this, const interval_iterator_t* iterator);
+    interval_r_iterator_t* (*rend)(const interval_t* _this);
+    interval_r_iterator_t* (*rbegin)(const interval_t* _this);
+    interval_r_iterator_t* (*rnext)(const interval_t* _this, const interval_r_iterator_t* r_iterator);
+    interval_r_iterator_t* (*rprev)(const interval_t* _this, const interval_r_iterator_t* r_iterator);
+    interval_iterator_t* (*find)(const interval_t* _this, interval_key_t lo, interval_key_t hi);                 /* The first interval equal to [ lo, hi ) */
+    interval_iterator_t* (*insert)(interval_t* _this, interval_key_t lo, interval_key_t hi, interval_value_t value); /* Always insert after the equal intervals, return NULL if `lo` >= `hi` */
+    interval_iterator_t* (*erase)(interval_t* _this, interval_iterator_t* iterator);
+    interval_size_t (*remove)(interval_t* _this, interval_key_t lo, interval_key_t hi);                        /* Remove the intervals equal to [ lo, hi ), return the count removed */
+    interval_size_t (*clear)(interval_t* _this);
+    interval_iterator_t* (*overlap_first)(const interval_t* _this, interval_key_t lo, interval_key_t hi);       /* The first in order of the intervals overlapping [ lo, hi ), `end` if there's none. O(log n) */
+    interval_iterator_t* (*overlap_next)(const interval_t* _this, const interval_iterator_t* iterator, interval_key_t lo, interval_key_t hi); /* The next one after `iterator` overlapping [ lo, hi ), `end` if there's none. O(log n) */
+    interval_size_t (*overlap)(const interval_t* _this, interval_key_t lo, interval_key_t hi, for_each_interval cb, void* arg); /* Visit the intervals overlapping [ lo, hi ) in order until `cb` returns false, return the count visited. O(log n + k) */
+    interval_size_t (*stab)(const interval_t* _this, interval_key_t point, for_each_interval cb, void* arg);   /* As `overlap` with the intervals holding `point` */
+} class_interval_t;
+
+void __interval_init(interval_t* interval);
+void __interval_deinit(interval_t* interval);
+const class_interval_t* class_interval_ins(void);
+#define g_class_interval()            class_interval_ins()
+#define cinterval                     g_class_interval()
+#define INTERVAL_INIT(_ptr)           (interval_t) { .ops = NULL, .size = 0, }; __interval_init((_ptr))
+#define INTERVAL_INIT_OPS(_ptr, _ops) (interval_t) { .ops = _ops, .size = 0, }; __interval_init((_ptr))
+#define INTERVAL_DEINIT(_ptr)         do { __interval_deinit((_ptr)); } while(0)
+
+#endif /* __J_INTERVAL_H */
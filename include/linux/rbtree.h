@@ -62,8 +62,51 @@ struct rb_node *rb_prev(const struct rb_node *node);
 struct rb_node *rb_first(const struct rb_root *root);
 struct rb_node *rb_last(const struct rb_root *root);
 
+/* Postorder iteration - always visit the parent after its children, so the
+   current node may be freed once the next one is fetched */
+struct rb_node *rb_first_postorder(const struct rb_root *root);
+struct rb_node *rb_next_postorder(const struct rb_node *node);
+
 void rb_replace_node(struct rb_node *victim, struct rb_node *new, struct rb_root *root);
 
+/* Augmented trees - every rotation and every node gone missing is reported, so data
+   cached per node about its subtree stays right */
+struct rb_augment_callbacks {
+    void (*propagate)(struct rb_node *node, struct rb_node *stop); /* Recompute from `node` up to `stop`, excluded */
+    void (*copy)(struct rb_node *old, struct rb_node *new);        /* `new` has taken the place of `old` */
+    void (*rotate)(struct rb_node *old, struct rb_node *new);      /* `new` has been rotated up over `old` */
+};
+
+/* Link the node with `rb_link_node` first */
+void rb_insert_augmented(struct rb_node *node, struct rb_root *root, const struct rb_augment_callbacks *augment);
+void rb_erase_augmented(struct rb_node *node, struct rb_root *root, const struct rb_augment_callbacks *augment);
+
+/* Order-statistic trees - the count of nodes of a subtree is kept in the word right
+   after its `rb_node`, which must be the last member of an entry allocated
+   `RB_SIZE_EXTRA` bytes larger */
+#define RB_SIZE_EXTRA   sizeof(unsigned long)
+#define rb_size(r)      (*(unsigned long *)((struct rb_node *)(r) + 1))
+#define rb_size_of(r)   ((r) ? rb_size(r) : 0UL)
+
+extern const struct rb_augment_callbacks rb_size_augment;
+
+struct rb_node *rb_select(const struct rb_root *root, unsigned long k); /* The k-th node in order, from 0 */
+unsigned long rb_rank(const struct rb_node *node);                      /* Count of nodes before `node` */
+void rb_size_build(struct rb_root *root);                               /* Compute every size, in O(n) */
+
+/* Build a balanced tree in O(n) from `n` nodes chained in order through `rb_right`,
+   the tree must be empty */
+void rb_build_sorted(struct rb_root *root, struct rb_node *list, size_t n);
+
+/* Join and split, existing nodes are relinked and nothing is allocated. `augment` may be NULL.
+   rb_join:   every node of `left` < `node` < every node of `right`, all linked into `left`,
+              `right` is left empty, in O(log n)
+   rb_concat: every node of `left` < every node of `right`, as `rb_join` with the last of `left`
+   rb_split:  `node` and every node after it move into the empty `right`, in O(log n) */
+void rb_join(struct rb_root *left, struct rb_node *node, struct rb_root *right, const struct rb_augment_callbacks *augment);
+void rb_concat(struct rb_root *left, struct rb_root *right, const struct rb_augment_callbacks *augment);
+void rb_split(struct rb_root *root, struct rb_node *node, struct rb_root *right, const struct rb_augment_callbacks *augment);
+
 static inline void rb_link_node(struct rb_node * node, struct rb_node * parent, struct rb_node ** rb_link)
 {
     node->rb_parent_color = (unsigned long )parent;
@@ -52,10 +52,39 @@ typedef struct map_reverse_iterator {
 } map_reverse_iterator_t;
 typedef map_reverse_iterator_t map_r_iterator_t;
 
+#define MAP_SMALL (16) /* Entries in the array of the adaptive mode, the tree takes over past it and hands back at half */
+/* An entry of the adaptive mode, an iterator points at its slot */
+typedef struct map_small_slot {
+    map_key_t key;
+    map_value_t value;
+} map_small_slot_t;
+
+/* The adaptive mode: the keys in order for the scan, and the entries in slots that don't move */
+typedef struct map_small {
+    map_key_t keys[MAP_SMALL];
+    uint8_t order[MAP_SMALL];  /* Slots of the entries in order of their keys */
+    uint32_t free;             /* A bit per slot not taken */
+    map_small_slot_t slots[MAP_SMALL];
+} map_small_t;
+
+typedef union map_config {
+    struct {
+        uint32_t b_order_stat : 1; /* Keep subtree sizes, `count`, `rank`, `select` and `count_range` take O(log n) instead of O(n) */
+        uint32_t b_small      : 1; /* Up to MAP_SMALL entries are kept in one array instead of nodes of a tree, found with a scan of their sorted keys. Iterators are invalidated when the tree takes over or hands back, see `map_small.c` */
+        uint32_t b_thread     : 1; /* Each node links its neighbours in order, `begin`, `rbegin`, `next` and `prev` take O(1) instead of O(log n) for two more words a node, see `_thread.h` */
+    } c;
+    uint32_t d;
+} map_config_t;
+
 typedef struct map {
     const class_map_ops_t* ops;
     struct rb_root root;
     map_size_t size;
+    ds_block_t* blocks; /* Nodes of `build_sorted(..., contiguous = true)` */
+    struct rb_node* rightmost; /* `rb_last` of `root`, an insert past it is linked there without a descent */
+    struct rb_node* leftmost; /* `rb_first` of `root` in threaded mode */
+    map_config_t config;
+    map_small_t* small; /* While the adaptive mode keeps the entries in an array */
 } map_t;
 
 typedef struct class_map {
@@ -70,6 +99,9 @@ typedef struct class_map {
     map_r_iterator_t* (*rnext)(const map_t* _this, const map_r_iterator_t* r_iterator);
     map_r_iterator_t* (*rprev)(const map_t* _this, const map_r_iterator_t* r_iterator);
     map_iterator_t* (*find)(const map_t* _this, map_key_t key);
+    map_size_t (*find_batch)(const map_t* _this, const map_key_t* keys, map_size_t n, map_iterator_t** out); /* out[i] = find(keys[i]) for the n keys, up to 16 descents run interleaved so their cache misses overlap. Return the count found or -1 */
+    map_size_t (*contains_sorted)(const map_t* _this, const map_key_t* keys, map_size_t n, uint64_t* bitmap); /* Bit i of `bitmap`, 64 a word, is set if keys[i] is in. Keys in ascending order are found in one walk, each from the last one found in O(log d) for a gap of d, out of order ones from the root. Return the count found or -1 */
+    map_size_t (*find_sorted)(const map_t* _this, const map_key_t* keys, map_size_t n, map_iterator_t** out); /* out[i] = find(keys[i]) in one walk as `contains_sorted`. Return the count found or -1 */
     map_iterator_t* (*lower_bound)(const map_t* _this, map_key_t key);                 /* >= key */
     map_iterator_t* (*upper_bound)(const map_t* _this, map_key_t key);                 /*  > key */
     map_iterator_t* (*insert)(map_t* _this, map_key_t key, map_value_t value);         /* if input key doesn't match -> insert | if input key match -> return NULL */
@@ -78,15 +110,34 @@ typedef struct class_map {
     map_size_t (*remove)(map_t* _this, map_key_t key);
     map_size_t (*remove_if)(map_t* _this, remove_if_condition_kv cond);
     map_size_t (*clear)(map_t* _this);
+    map_size_t (*build_sorted)(map_t* _this, const map_key_t* keys, const map_value_t* values, map_size_t n, bool contiguous); /* Only into an empty map, `values` may be NULL. Unsorted input is sorted first, the first of equal keys is kept. Return the size or -1 */
+    map_size_t (*rank)(const map_t* _this, map_key_t key);                     /* Count of keys < `key` */
+    map_iterator_t* (*select)(const map_t* _this, map_size_t k);               /* The k-th in order from 0, `end` if k >= size */
+    map_size_t (*count_range)(const map_t* _this, map_key_t lo, map_key_t hi); /* Count of keys in [ lo, hi ) */
+    map_iterator_t* (*insert_hint)(map_t* _this, map_iterator_t* hint, map_key_t key, map_value_t value); /* As `insert`, in O(1) amortized if `key` belongs right before or after `hint`, or at `end` */
+    map_iterator_t* (*equal_range)(const map_t* _this, map_key_t key, map_iterator_t** last); /* [ return, *last ) holds the keys equal to `key`, both are `lower_bound` if there's none */
+    map_size_t (*erase_range)(map_t* _this, map_key_t lo, map_key_t hi); /* Erase the keys in [ lo, hi ) with one descent, return the count erased */
+    map_size_t (*for_each_range)(const map_t* _this, map_key_t lo, map_key_t hi, for_each_kv cb, void* arg); /* Visit the keys in [ lo, hi ) in order until `cb` returns false, return the count visited */
+    map_size_t (*split)(map_t* _this, map_key_t key, map_t* left, map_t* right); /* Keys < `key` move to `left`, the others to `right`, by relinking the nodes in O(log n). `left` and `right` are empty or `_this`, with its ops and config. Sizes take O(log n) in order-statistic mode, O(min(|left|, |right|)) otherwise. Nodes of `build_sorted(..., contiguous = true)` take O(min(|left|, |right|)) more to share out their blocks. Return the size of `left` or -1 */
+    map_size_t (*join)(map_t* _this, map_t* other); /* Every key of `other` is greater than every key of `_this`, they all move into `_this` in O(log n). Return the size or -1 */
+    map_iterator_t* (*extract)(map_t* _this, map_iterator_t* iterator, ds_node_handle_t* handle); /* As `erase`, but the entry is moved into the empty `handle` with its node memory instead of being freed, see `_handle.h` */
+    map_iterator_t* (*insert_node)(map_t* _this, ds_node_handle_t* handle); /* As `insert` with the entry of `handle`, reusing its node memory and without copying the key or the value. On success the handle is empty */
+    void (*free_node)(map_t* _this, ds_node_handle_t* handle); /* Free what `handle` holds with the ops of `_this` */
 } class_map_t;
 
 void __map_init(map_t* map);
 void __map_deinit(map_t* map);
 const class_map_t* class_map_ins(void);
-#define g_class_map()            class_map_ins()
-#define cmap                     g_class_map()
-#define MAP_INIT(_ptr)           (map_t) { .ops = NULL, .size = 0, }; __map_init((_ptr))
-#define MAP_INIT_OPS(_ptr, _ops) (map_t) { .ops = _ops, .size = 0, }; __map_init((_ptr))
-#define MAP_DEINIT(_ptr)         do { __map_deinit((_ptr)); } while(0)
+#define g_class_map()                  class_map_ins()
+#define cmap                           g_class_map()
+#define MAP_INIT(_ptr)                 (map_t) { .ops = NULL, .size = 0, }; __map_init((_ptr))
+#define MAP_INIT_OPS(_ptr, _ops)       (map_t) { .ops = _ops, .size = 0, }; __map_init((_ptr))
+#define MAP_INIT_OS(_ptr)              (map_t) { .ops = NULL, .size = 0, .config = { .c = { .b_order_stat = 1 } }, }; __map_init((_ptr))
+#define MAP_INIT_OPS_OS(_ptr, _ops)    (map_t) { .ops = _ops, .size = 0, .config = { .c = { .b_order_stat = 1 } }, }; __map_init((_ptr))
+#define MAP_INIT_SMALL(_ptr)           (map_t) { .ops = NULL, .size = 0, .config = { .c = { .b_small = 1 } }, }; __map_init((_ptr))
+#define MAP_INIT_OPS_SMALL(_ptr, _ops) (map_t) { .ops = _ops, .size = 0, .config = { .c = { .b_small = 1 } }, }; __map_init((_ptr))
+#define MAP_INIT_THREAD(_ptr)          (map_t) { .ops = NULL, .size = 0, .config = { .c = { .b_thread = 1 } }, }; __map_init((_ptr))
+#define MAP_INIT_OPS_THREAD(_ptr, _ops) (map_t) { .ops = _ops, .size = 0, .config = { .c = { .b_thread = 1 } }, }; __map_init((_ptr))
+#define MAP_DEINIT(_ptr)               do { __map_deinit((_ptr)); } while(0)
 
 #endif /* __J_MAP_H */
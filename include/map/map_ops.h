@@ -30,6 +30,7 @@ typedef struct class_map_ops {
     bool (*valid_value)(map_value_t value);               /* Return true if `value` is valid */
     bool (*copy_value)(map_value_t in, map_value_t* out); /* The function pointer can be null and manages memory on its own. However, if this function is implemented, `free_value` must also be implemented */
     void (*free_value)(map_value_t* value);               /* The function pointer can be null and manages memory on its own */
+    int (*__cmp)(map_key_t left, map_key_t right);        /* Optional, with `__lt` set and agreeing with it: return < 0, 0 or > 0 as [ `left` < `right` ], [ `left` == `right` ] or [ `left` > `right` ]. Searches and inserts then compare once per node instead of twice */
 } class_map_ops_t;
 
 #endif /* __J_MAP_OPS_H */
@@ -29,6 +29,22 @@ typedef struct multimap_node {
     struct rb_node node;
 } multimap_node_t;
 
+/* Compressed mode: equal keys share one `multimap_cnode_t` holding the key once. An iterator
+   is read as `it->key` and `it->value`, so each value is a pair of words, the key pointer of
+   the node and the value, packed seven to a 128-byte line in runs of the node in insertion
+   order, see multimap_compress.c. An iterator of a compressed multimap is the address of its
+   pair, so `it->value` is the stored value. Pairs never move: like a node, a pair stays valid
+   until its own value is erased */
+typedef struct multimap_crun multimap_crun_t;
+
+typedef struct multimap_cnode {
+    multimap_key_t key;
+    multimap_size_t count;
+    multimap_crun_t* head;   /* Runs of pairs in order */
+    multimap_crun_t* tail;
+    struct rb_node node;     /* Must be last, see `RB_SIZE_EXTRA` */
+} multimap_cnode_t;
+
 typedef struct multimap_iterator {
     union {
         multimap_key_t key;
@@ -52,10 +68,38 @@ typedef struct multimap_reverse_iterator {
 } multimap_reverse_iterator_t;
 typedef multimap_reverse_iterator_t multimap_r_iterator_t;
 
+#define MULTIMAP_SMALL (16) /* Entries in the array of the adaptive mode, the tree takes over past it and hands back at half */
+/* An entry of the adaptive mode, an iterator points at its slot */
+typedef struct multimap_small_slot {
+    multimap_key_t key;
+    multimap_value_t value;
+} multimap_small_slot_t;
+
+/* The adaptive mode: the keys in order for the scan, and the entries in slots that don't move */
+typedef struct multimap_small {
+    multimap_key_t keys[MULTIMAP_SMALL];
+    uint8_t order[MULTIMAP_SMALL];  /* Slots of the entries in order of their keys, equal ones in the order they came */
+    uint32_t free;                  /* A bit per slot not taken */
+    multimap_small_slot_t slots[MULTIMAP_SMALL];
+} multimap_small_t;
+
+typedef union multimap_config {
+    struct {
+        uint32_t b_order_stat : 1; /* Keep subtree sizes, `count`, `rank`, `select` and `count_range` take O(log n) instead of O(n) */
+        uint32_t b_compress   : 1; /* One `multimap_cnode_t` per distinct key, with `b_order_stat` the subtree sizes count each value */
+        uint32_t b_small      : 1; /* Up to MULTIMAP_SMALL entries are kept in one array instead of nodes of a tree, found with a scan of their sorted keys. Iterators are invalidated when the tree takes over or hands back, see `multimap_small.c`. Ignored with `b_compress` */
+    } c;
+    uint32_t d;
+} multimap_config_t;
+
 typedef struct multimap {
     const class_multimap_ops_t* ops;
     struct rb_root root;
     multimap_size_t size;
+    ds_block_t* blocks; /* Nodes of `build_sorted(..., contiguous = true)` */
+    struct rb_node* rightmost; /* `rb_last` of `root`, an insert past it is linked there without a descent */
+    multimap_config_t config;
+    multimap_small_t* small; /* While the adaptive mode keeps the entries in an array */
 } multimap_t;
 
 typedef struct class_multimap {
@@ -70,6 +114,8 @@ typedef struct class_multimap {
     multimap_r_iterator_t* (*rnext)(const multimap_t* _this, const multimap_r_iterator_t* r_iterator);
     multimap_r_iterator_t* (*rprev)(const multimap_t* _this, const multimap_r_iterator_t* r_iterator);
     multimap_iterator_t* (*find)(const multimap_t* _this, multimap_key_t key);
+    multimap_size_t (*contains_sorted)(const multimap_t* _this, const multimap_key_t* keys, multimap_size_t n, uint64_t* bitmap); /* Bit i of `bitmap`, 64 a word, is set if keys[i] is in. Keys in ascending order are found in one walk, each from the last one found in O(log d) for a gap of d, out of order ones from the root. Return the count found or -1 */
+    multimap_size_t (*find_sorted)(const multimap_t* _this, const multimap_key_t* keys, multimap_size_t n, multimap_iterator_t** out); /* out[i] = find(keys[i]) in one walk as `contains_sorted`. Return the count found or -1 */
     multimap_iterator_t* (*lower_bound)(const multimap_t* _this, multimap_key_t key);              /* >= key */
     multimap_iterator_t* (*upper_bound)(const multimap_t* _this, multimap_key_t key);              /*  > key */
     multimap_iterator_t* (*insert)(multimap_t* _this, multimap_key_t key, multimap_value_t value); /* if input key doesn't match -> insert | if input key match -> return NULL */
@@ -77,15 +123,35 @@ typedef struct class_multimap {
     multimap_size_t (*remove)(multimap_t* _this, multimap_key_t key);
     multimap_size_t (*remove_if)(multimap_t* _this, remove_if_condition_kv cond);
     multimap_size_t (*clear)(multimap_t* _this);
+    multimap_size_t (*build_sorted)(multimap_t* _this, const multimap_key_t* keys, const multimap_value_t* values, multimap_size_t n, bool contiguous); /* Only into an empty multimap, `values` may be NULL. Unsorted input is sorted first, equal keys keep their input order. Return the size or -1 */
+    multimap_size_t (*rank)(const multimap_t* _this, multimap_key_t key);                          /* Count of keys < `key` */
+    multimap_iterator_t* (*select)(const multimap_t* _this, multimap_size_t k);                    /* The k-th in order from 0, `end` if k >= size */
+    multimap_size_t (*count_range)(const multimap_t* _this, multimap_key_t lo, multimap_key_t hi); /* Count of keys in [ lo, hi ) */
+    multimap_iterator_t* (*insert_hint)(multimap_t* _this, multimap_iterator_t* hint, multimap_key_t key, multimap_value_t value); /* As `insert`, in O(1) amortized if `key` belongs right before or after `hint`, or at `end`. Equal keys go right before `hint` */
+    multimap_iterator_t* (*equal_range)(const multimap_t* _this, multimap_key_t key, multimap_iterator_t** last); /* [ return, *last ) holds the keys equal to `key`, both are `lower_bound` if there's none */
+    multimap_size_t (*erase_range)(multimap_t* _this, multimap_key_t lo, multimap_key_t hi); /* Erase the keys in [ lo, hi ) with one descent, return the count erased */
+    multimap_size_t (*for_each_range)(const multimap_t* _this, multimap_key_t lo, multimap_key_t hi, for_each_kv cb, void* arg); /* Visit the keys in [ lo, hi ) in order until `cb` returns false, return the count visited */
+    multimap_size_t (*split)(multimap_t* _this, multimap_key_t key, multimap_t* left, multimap_t* right); /* Keys < `key` move to `left`, the others to `right`, by relinking the nodes in O(log n). `left` and `right` are empty or `_this`, with its ops and config. Sizes take O(log n) in order-statistic mode, O(min(|left|, |right|)) otherwise. Nodes of `build_sorted(..., contiguous = true)` take O(min(|left|, |right|)) more to share out their blocks. Return the size of `left` or -1 */
+    multimap_size_t (*join)(multimap_t* _this, multimap_t* other); /* No key of `other` is less than a key of `_this`, they all move into `_this` in O(log n). In compressed mode the boundary keys must differ. Return the size or -1 */
+    multimap_iterator_t* (*extract)(multimap_t* _this, multimap_iterator_t* iterator, ds_node_handle_t* handle); /* As `erase`, but the entry is moved into the empty `handle` with its node memory instead of being freed, see `_handle.h`. In compressed mode the key is copied unless it's the last value of it */
+    multimap_iterator_t* (*insert_node)(multimap_t* _this, ds_node_handle_t* handle); /* As `insert` with the entry of `handle`, reusing its node memory and without copying the key or the value. In compressed mode a key already there takes the value and the key of `handle` is freed. On success the handle is empty */
+    void (*free_node)(multimap_t* _this, ds_node_handle_t* handle); /* Free what `handle` holds with the ops of `_this` */
 } class_multimap_t;
 
 void __multimap_init(multimap_t* multimap);
 void __multimap_deinit(multimap_t* multimap);
 const class_multimap_t* class_multimap_ins(void);
-#define g_class_multimap()            class_multimap_ins()
-#define cmultimap                     g_class_multimap()
-#define MULTIMAP_INIT(_ptr)           (multimap_t) { .ops = NULL, .size = 0, }; __multimap_init((_ptr))
-#define MULTIMAP_INIT_OPS(_ptr, _ops) (multimap_t) { .ops = _ops, .size = 0, }; __multimap_init((_ptr))
-#define MULTIMAP_DEINIT(_ptr)         do { __multimap_deinit((_ptr)); } while(0)
+#define g_class_multimap()                     class_multimap_ins()
+#define cmultimap                              g_class_multimap()
+#define MULTIMAP_INIT(_ptr)                    (multimap_t) { .ops = NULL, .size = 0, }; __multimap_init((_ptr))
+#define MULTIMAP_INIT_OPS(_ptr, _ops)          (multimap_t) { .ops = _ops, .size = 0, }; __multimap_init((_ptr))
+#define MULTIMAP_INIT_OS(_ptr)                 (multimap_t) { .ops = NULL, .size = 0, .config = { .c = { .b_order_stat = 1 } }, }; __multimap_init((_ptr))
+#define MULTIMAP_INIT_OPS_OS(_ptr, _ops)       (multimap_t) { .ops = _ops, .size = 0, .config = { .c = { .b_order_stat = 1 } }, }; __multimap_init((_ptr))
+#define MULTIMAP_INIT_COMPRESS(_ptr)           (multimap_t) { .ops = NULL, .size = 0, .config = { .c = { .b_compress = 1 } }, }; __multimap_init((_ptr))
+#define MULTIMAP_INIT_OPS_COMPRESS(_ptr, _ops) (multimap_t) { .ops = _ops, .size = 0, .config = { .c = { .b_compress = 1 } }, }; __multimap_init((_ptr))
+#define MULTIMAP_INIT_OS_COMPRESS(_ptr)        (multimap_t) { .ops = NULL, .size = 0, .config = { .c = { .b_order_stat = 1, .b_compress = 1 } }, }; __multimap_init((_ptr))
+#define MULTIMAP_INIT_SMALL(_ptr)              (multimap_t) { .ops = NULL, .size = 0, .config = { .c = { .b_small = 1 } }, }; __multimap_init((_ptr))
+#define MULTIMAP_INIT_OPS_SMALL(_ptr, _ops)    (multimap_t) { .ops = _ops, .size = 0, .config = { .c = { .b_small = 1 } }, }; __multimap_init((_ptr))
+#define MULTIMAP_DEINIT(_ptr)                  do { __multimap_deinit((_ptr)); } while(0)
 
 #endif /* __J_MULTIMAP_H */
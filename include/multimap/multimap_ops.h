@@ -31,6 +31,7 @@ typedef struct class_multimap_ops {
     bool (*__lt_value)(multimap_value_t left, multimap_value_t right); /* Return true if [ `left` != `right` ], or if [ `left` < `right` ] */
     bool (*copy_value)(multimap_value_t in, multimap_value_t* out);    /* The function pointer can be null and manages memory on its own. However, if this function is implemented, `free_value` must also be implemented */
     void (*free_value)(multimap_value_t* value);                       /* The function pointer can be null and manages memory on its own */
+    int (*__cmp)(multimap_key_t left, multimap_key_t right);           /* Optional, with `__lt` set and agreeing with it: return < 0, 0 or > 0 as [ `left` < `right` ], [ `left` == `right` ] or [ `left` > `right` ]. Searches and inserts then compare once per node instead of twice */
 } class_multimap_ops_t;
 
 #endif /* __J_MULTIMAP_OPS_H */
@@ -28,6 +28,21 @@ typedef struct multiset_node {
     struct rb_node node;
 } multiset_node_t;
 
+/* Compressed mode: equal values share one `multiset_cnode_t`, which counts them. An iterator
+   is read as `it->value`, so each of them still has a word of its own holding the value:
+   the words are packed seven to a 64-byte line in runs of the node, see multiset_compress.c,
+   and an iterator of a compressed multiset is the address of its word. Words never move: like
+   a node, a word stays valid until its own value is erased */
+typedef struct multiset_crun multiset_crun_t;
+
+typedef struct multiset_cnode {
+    multiset_value_t value;
+    multiset_size_t count;
+    multiset_crun_t* head;   /* Runs of words in order */
+    multiset_crun_t* tail;
+    struct rb_node node;     /* Must be last, see `RB_SIZE_EXTRA` */
+} multiset_cnode_t;
+
 typedef struct multiset_iterator {
     union {
         multiset_value_t value;
@@ -43,10 +58,37 @@ typedef struct multiset_reverse_iterator {
 } multiset_reverse_iterator_t;
 typedef multiset_reverse_iterator_t multiset_r_iterator_t;
 
+#define MULTISET_SMALL (16) /* Values in the array of the adaptive mode, the tree takes over past it and hands back at half */
+/* A value of the adaptive mode, an iterator points at its slot */
+typedef struct multiset_small_slot {
+    multiset_value_t value;
+} multiset_small_slot_t;
+
+/* The adaptive mode: the values in order for the scan, and again in slots that don't move */
+typedef struct multiset_small {
+    multiset_value_t values[MULTISET_SMALL];
+    uint8_t order[MULTISET_SMALL];  /* Slots of the values in order, equal ones in the order they came */
+    uint32_t free;                  /* A bit per slot not taken */
+    multiset_small_slot_t slots[MULTISET_SMALL];
+} multiset_small_t;
+
+typedef union multiset_config {
+    struct {
+        uint32_t b_order_stat : 1; /* Keep subtree sizes, `count`, `rank`, `select` and `count_range` take O(log n) instead of O(n) */
+        uint32_t b_compress   : 1; /* One `multiset_cnode_t` per distinct value, with `b_order_stat` the subtree sizes count each of equal values */
+        uint32_t b_small      : 1; /* Up to MULTISET_SMALL values are kept in one array instead of nodes of a tree, found with a scan of them in order. Iterators are invalidated when the tree takes over or hands back, see `multiset_small.c`. Ignored with `b_compress` */
+    } c;
+    uint32_t d;
+} multiset_config_t;
+
 typedef struct multiset {
     const class_multiset_ops_t* ops;
     struct rb_root root;
     multiset_size_t size;
+    ds_block_t* blocks; /* Nodes of `build_sorted(..., contiguous = true)` */
+    struct rb_node* rightmost; /* `rb_last` of `root`, an insert past it is linked there without a descent */
+    multiset_config_t config;
+    multiset_small_t* small; /* While the adaptive mode keeps the values in an array */
 } multiset_t;
 
 typedef struct class_multiset {
@@ -61,6 +103,8 @@ typedef struct class_multiset {
     multiset_r_iterator_t* (*rnext)(const multiset_t* _this, const multiset_r_iterator_t* r_iterator);
     multiset_r_iterator_t* (*rprev)(const multiset_t* _this, const multiset_r_iterator_t* r_iterator);
     multiset_iterator_t* (*find)(const multiset_t* _this, multiset_value_t value);
+    multiset_size_t (*contains_sorted)(const multiset_t* _this, const multiset_value_t* values, multiset_size_t n, uint64_t* bitmap); /* Bit i of `bitmap`, 64 a word, is set if values[i] is in. Values in ascending order are found in one walk, each from the last one found in O(log d) for a gap of d, out of order ones from the root. Return the count found or -1 */
+    multiset_size_t (*find_sorted)(const multiset_t* _this, const multiset_value_t* values, multiset_size_t n, multiset_iterator_t** out); /* out[i] = find(values[i]) in one walk as `contains_sorted`. Return the count found or -1 */
     multiset_iterator_t* (*lower_bound)(const multiset_t* _this, multiset_value_t value); /* >= value */
     multiset_iterator_t* (*upper_bound)(const multiset_t* _this, multiset_value_t value); /*  > value */
     multiset_iterator_t* (*insert)(multiset_t* _this, multiset_value_t value);            /* if input value doesn't match -> insert | if input value match -> return NULL */
@@ -68,15 +112,43 @@ typedef struct class_multiset {
     multiset_size_t (*remove)(multiset_t* _this, multiset_value_t value);
     multiset_size_t (*remove_if)(multiset_t* _this, remove_if_condition_v cond);
     multiset_size_t (*clear)(multiset_t* _this);
+    multiset_size_t (*build_sorted)(multiset_t* _this, const multiset_value_t* values, multiset_size_t n, bool contiguous); /* Only into an empty multiset. Unsorted input is sorted first, equal values keep their input order. Return the size or -1 */
+    multiset_size_t (*rank)(const multiset_t* _this, multiset_value_t value);                          /* Count of values < `value` */
+    multiset_iterator_t* (*select)(const multiset_t* _this, multiset_size_t k);                        /* The k-th in order from 0, `end` if k >= size */
+    multiset_size_t (*count_range)(const multiset_t* _this, multiset_value_t lo, multiset_value_t hi); /* Count of values in [ lo, hi ) */
+    multiset_iterator_t* (*insert_hint)(multiset_t* _this, multiset_iterator_t* hint, multiset_value_t value); /* As `insert`, in O(1) amortized if `value` belongs right before or after `hint`, or at `end`. Equal values go right before `hint` */
+    multiset_iterator_t* (*equal_range)(const multiset_t* _this, multiset_value_t value, multiset_iterator_t** last); /* [ return, *last ) holds the values equal to `value`, both are `lower_bound` if there's none */
+    multiset_size_t (*erase_range)(multiset_t* _this, multiset_value_t lo, multiset_value_t hi); /* Erase the values in [ lo, hi ) with one descent, return the count erased */
+    multiset_size_t (*for_each_range)(const multiset_t* _this, multiset_value_t lo, multiset_value_t hi, for_each_v cb, void* arg); /* Visit the values in [ lo, hi ) in order until `cb` returns false, return the count visited */
+    multiset_size_t (*set_union)(multiset_t* _this, const multiset_t* a, const multiset_t* b); /* Into an empty `_this` with one merged walk of `a` and `b` and an O(n) `build_sorted`, a value is kept max(count in a, count in b) times. Return the size or -1 */
+    multiset_size_t (*set_intersection)(multiset_t* _this, const multiset_t* a, const multiset_t* b);         /* min(count in a, count in b) times */
+    multiset_size_t (*set_difference)(multiset_t* _this, const multiset_t* a, const multiset_t* b);           /* max(count in a - count in b, 0) times */
+    multiset_size_t (*set_symmetric_difference)(multiset_t* _this, const multiset_t* a, const multiset_t* b); /* |count in a - count in b| times */
+    multiset_size_t (*union_with)(multiset_t* _this, const multiset_t* other); /* In place with one merged walk, copies from `other` are linked without a descent. Return the size or -1 */
+    multiset_size_t (*intersect_with)(multiset_t* _this, const multiset_t* other);
+    multiset_size_t (*difference_with)(multiset_t* _this, const multiset_t* other);
+    multiset_size_t (*symmetric_difference_with)(multiset_t* _this, const multiset_t* other);
+    multiset_size_t (*split)(multiset_t* _this, multiset_value_t value, multiset_t* left, multiset_t* right); /* Values < `value` move to `left`, the others to `right`, by relinking the nodes in O(log n). `left` and `right` are empty or `_this`, with its ops and config. Sizes take O(log n) in order-statistic mode, O(min(|left|, |right|)) otherwise. Nodes of `build_sorted(..., contiguous = true)` take O(min(|left|, |right|)) more to share out their blocks. Return the size of `left` or -1 */
+    multiset_size_t (*join)(multiset_t* _this, multiset_t* other); /* No value of `other` is less than a value of `_this`, they all move into `_this` in O(log n). In compressed mode the boundary values must differ. Return the size or -1 */
+    multiset_iterator_t* (*extract)(multiset_t* _this, multiset_iterator_t* iterator, ds_node_handle_t* handle); /* As `erase`, but the value is moved into `handle->key` of the empty `handle` with its node memory instead of being freed, see `_handle.h`. In compressed mode only the last of equal values moves, the others are copied */
+    multiset_iterator_t* (*insert_node)(multiset_t* _this, ds_node_handle_t* handle); /* As `insert` with `handle->key`, reusing the node memory of `handle` and without copying the value. In compressed mode a value already there is counted and the one of `handle` is freed. On success the handle is empty */
+    void (*free_node)(multiset_t* _this, ds_node_handle_t* handle); /* Free what `handle` holds with the ops of `_this` */
 } class_multiset_t;
 
 void __multiset_init(multiset_t* multiset);
 void __multiset_deinit(multiset_t* multiset);
 const class_multiset_t* class_multiset_ins(void);
-#define g_class_multiset()            class_multiset_ins()
-#define cmultiset                     g_class_multiset()
-#define MULTISET_INIT(_ptr)           (multiset_t) { .ops = NULL, .size = 0, }; __multiset_init((_ptr))
-#define MULTISET_INIT_OPS(_ptr, _ops) (multiset_t) { .ops = _ops, .size = 0, }; __multiset_init((_ptr))
-#define MULTISET_DEINIT(_ptr)         do { __multiset_deinit((_ptr)); } while(0)
+#define g_class_multiset()                     class_multiset_ins()
+#define cmultiset                              g_class_multiset()
+#define MULTISET_INIT(_ptr)                    (multiset_t) { .ops = NULL, .size = 0, }; __multiset_init((_ptr))
+#define MULTISET_INIT_OPS(_ptr, _ops)          (multiset_t) { .ops = _ops, .size = 0, }; __multiset_init((_ptr))
+#define MULTISET_INIT_OS(_ptr)                 (multiset_t) { .ops = NULL, .size = 0, .config = { .c = { .b_order_stat = 1 } }, }; __multiset_init((_ptr))
+#define MULTISET_INIT_OPS_OS(_ptr, _ops)       (multiset_t) { .ops = _ops, .size = 0, .config = { .c = { .b_order_stat = 1 } }, }; __multiset_init((_ptr))
+#define MULTISET_INIT_COMPRESS(_ptr)           (multiset_t) { .ops = NULL, .size = 0, .config = { .c = { .b_compress = 1 } }, }; __multiset_init((_ptr))
+#define MULTISET_INIT_OPS_COMPRESS(_ptr, _ops) (multiset_t) { .ops = _ops, .size = 0, .config = { .c = { .b_compress = 1 } }, }; __multiset_init((_ptr))
+#define MULTISET_INIT_OS_COMPRESS(_ptr)        (multiset_t) { .ops = NULL, .size = 0, .config = { .c = { .b_order_stat = 1, .b_compress = 1 } }, }; __multiset_init((_ptr))
+#define MULTISET_INIT_SMALL(_ptr)              (multiset_t) { .ops = NULL, .size = 0, .config = { .c = { .b_small = 1 } }, }; __multiset_init((_ptr))
+#define MULTISET_INIT_OPS_SMALL(_ptr, _ops)    (multiset_t) { .ops = _ops, .size = 0, .config = { .c = { .b_small = 1 } }, }; __multiset_init((_ptr))
+#define MULTISET_DEINIT(_ptr)                  do { __multiset_deinit((_ptr)); } while(0)
 
 #endif /* __J_MULTISET_H */
@@ -41,6 +41,7 @@ bool ds_ops_valid_key_default_string_max_512(ds_key_t key);         /* String ty
 bool ds_ops_valid_data_default_string(ds_data_t data);              /* String type: judge the validity of the `data`(whether the pointer is null and whether the length is greater than 0), 
                                                                                     without limiting the length */
 bool __ds_ops_lt_default_string(ds_data_t left, ds_data_t right);   /* String type: return true if [ `left` < `right` ] */
+int __ds_ops_cmp_default_string(ds_data_t left, ds_data_t right);   /* String type: return < 0, 0 or > 0 as [ `left` < `right` ], [ `left` == `right` ] or [ `left` > `right` ], with one `strcmp` */
 bool __ds_ops_gt_default_string(ds_data_t left, ds_data_t right);   /* String type: return true if [ `left` > `right` ] */
 bool ds_ops_copy_data_default_string(ds_data_t in, ds_data_t* out); /* String type: deep copy `in` and use `out` to receive the copied memory */
 void ds_ops_free_data_default_string(ds_data_t* data);              /* String type: release the `data` and set `data` to `NULL` */
@@ -0,0 +1,107 @@
+/*
+  Persistent Map and Set
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef __J_PMAP_H
+#define __J_PMAP_H
+
+#include <_types.h>
+#include <map/map.h>
+#include <set/set.h>
+
+/* Persistent (path copying) AVL tree, driven through `cpmap` as a map or `cpset` as a set.
+   A version `pmap_t` is never changed: `insert`, `insert_replace` and `remove` copy the
+   O(log n) nodes on the path they touch and return a new version, the untouched subtrees
+   are shared with the old one. Versions and nodes are reference counted, a version stays
+   valid until it's released, whatever happens to the others.
+   Iterators point into a version and stay valid as long as it's held.
+
+   A writer hands versions to readers through a `pmap_slot_t`: `acquire` takes a reference
+   on the version published last in O(1) without locks, `publish` swaps it and waits for
+   the readers still in the middle of `acquire` before releasing the old one. Only one
+   thread may `publish` on a slot at a time */
+
+typedef struct pmap_node {
+    pmap_key_t key;     /* The value in set mode */
+    pmap_value_t value;
+    struct pmap_node* left;
+    struct pmap_node* right;
+    int height;
+    int refs;           /* Versions and parents holding it, a node held once only can be changed in place */
+} pmap_node_t;
+
+typedef struct pmap {
+    class_map_ops_t ops; /* Set ops are translated into the map layout */
+    pmap_node_t* root;
+    pmap_size_t size;
+    int refs;
+} pmap_t;
+
+typedef struct pmap_slot {
+    pmap_t* version;
+    unsigned long index;      /* Bumped by each `publish`, its parity picks the reader count in use */
+    unsigned long readers[2];
+} pmap_slot_t;
+
+typedef struct class_pmap {
+    pmap_t* (*create)(const class_map_ops_t* ops);   /* An empty version, `ops` may be NULL */
+    pmap_t* (*retain)(pmap_t* _this);
+    void (*release)(pmap_t* _this);
+    pmap_size_t (*size)(const pmap_t* _this);
+    map_iterator_t* (*end)(const pmap_t* _this);
+    map_iterator_t* (*begin)(const pmap_t* _this);
+    map_iterator_t* (*next)(const pmap_t* _this, const map_iterator_t* iterator); /* O(log n) */
+    map_iterator_t* (*find)(const pmap_t* _this, pmap_key_t key);
+    map_iterator_t* (*lower_bound)(const pmap_t* _this, pmap_key_t key);          /* >= key */
+    map_iterator_t* (*upper_bound)(const pmap_t* _this, pmap_key_t key);          /*  > key */
+    pmap_t* (*insert)(const pmap_t* _this, pmap_key_t key, pmap_value_t value);         /* The new version, NULL if `key` exists */
+    pmap_t* (*insert_replace)(const pmap_t* _this, pmap_key_t key, pmap_value_t value); /* The new version */
+    pmap_t* (*remove)(const pmap_t* _this, pmap_key_t key);                             /* The new version, NULL if there's no `key` */
+    pmap_size_t (*for_each_range)(const pmap_t* _this, pmap_key_t lo, pmap_key_t hi, for_each_kv cb, void* arg); /* Visit the keys in [ lo, hi ) in order until `cb` returns false, return the count visited */
+    void (*publish)(pmap_slot_t* slot, pmap_t* version);  /* Take a reference on `version`, NULL to empty the slot */
+    pmap_t* (*acquire)(pmap_slot_t* slot);                /* A reference on the version published last, NULL if none */
+} class_pmap_t;
+
+typedef struct class_pset {
+    pmap_t* (*create)(const class_set_ops_t* ops);
+    pmap_t* (*retain)(pmap_t* _this);
+    void (*release)(pmap_t* _this);
+    pmap_size_t (*size)(const pmap_t* _this);
+    set_iterator_t* (*end)(const pmap_t* _this);
+    set_iterator_t* (*begin)(const pmap_t* _this);
+    set_iterator_t* (*next)(const pmap_t* _this, const set_iterator_t* iterator);
+    set_iterator_t* (*find)(const pmap_t* _this, pmap_key_t value);
+    set_iterator_t* (*lower_bound)(const pmap_t* _this, pmap_key_t value);
+    set_iterator_t* (*upper_bound)(const pmap_t* _this, pmap_key_t value);
+    pmap_t* (*insert)(const pmap_t* _this, pmap_key_t value); /* The new version, NULL if `value` exists */
+    pmap_t* (*remove)(const pmap_t* _this, pmap_key_t value); /* The new version, NULL if there's no `value` */
+    pmap_size_t (*for_each_range)(const pmap_t* _this, pmap_key_t lo, pmap_key_t hi, for_each_v cb, void* arg);
+    void (*publish)(pmap_slot_t* slot, pmap_t* version);
+    pmap_t* (*acquire)(pmap_slot_t* slot);
+} class_pset_t;
+
+const class_pmap_t* class_pmap_ins(void);
+const class_pset_t* class_pset_ins(void);
+#define g_class_pmap()         class_pmap_ins()
+#define g_class_pset()         class_pset_ins()
+#define cpmap                  g_class_pmap()
+#define cpset                  g_class_pset()
+#define PMAP_SLOT_INIT(_ptr)   (pmap_slot_t) { .version = NULL, .index = 0, }
+#define PMAP_SLOT_DEINIT(_ptr) do { cpmap->publish((_ptr), NULL); } while(0)
+
+#endif /* __J_PMAP_H */
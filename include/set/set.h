@@ -43,10 +43,38 @@ typedef struct set_reverse_iterator {
 } set_reverse_iterator_t;
 typedef set_reverse_iterator_t set_r_iterator_t;
 
+#define SET_SMALL                      (16) /* Values in the array of the adaptive mode, the tree takes over past it and hands back at half */
+/* A value of the adaptive mode, an iterator points at its slot */
+typedef struct set_small_slot {
+    set_value_t value;
+} set_small_slot_t;
+
+/* The adaptive mode: the values in order for the scan, and again in slots that don't move */
+typedef struct set_small {
+    set_value_t values[SET_SMALL];
+    uint8_t order[SET_SMALL];  /* Slots of the values in order */
+    uint32_t free;             /* A bit per slot not taken */
+    set_small_slot_t slots[SET_SMALL];
+} set_small_t;
+
+typedef union set_config {
+    struct {
+        uint32_t b_order_stat : 1; /* Keep subtree sizes, `count`, `rank`, `select` and `count_range` take O(log n) instead of O(n) */
+        uint32_t b_small      : 1; /* Up to SET_SMALL values are kept in one array instead of nodes of a tree, found with a scan of them in order. Iterators are invalidated when the tree takes over or hands back, see `set_small.c` */
+        uint32_t b_thread     : 1; /* Each node links its neighbours in order, `begin`, `rbegin`, `next` and `prev` take O(1) instead of O(log n) for two more words a node, see `_thread.h` */
+    } c;
+    uint32_t d;
+} set_config_t;
+
 typedef struct set {
     const class_set_ops_t* ops;
     struct rb_root root;
     set_size_t size;
+    ds_block_t* blocks; /* Nodes of `build_sorted(..., contiguous = true)` */
+    struct rb_node* rightmost; /* `rb_last` of `root`, an insert past it is linked there without a descent */
+    struct rb_node* leftmost; /* `rb_first` of `root` in threaded mode */
+    set_config_t config;
+    set_small_t* small; /* While the adaptive mode keeps the values in an array */
 } set_t;
 
 typedef struct class_set {
@@ -61,6 +89,9 @@ typedef struct class_set {
     set_r_iterator_t* (*rnext)(const set_t* _this, const set_r_iterator_t* r_iterator);
     set_r_iterator_t* (*rprev)(const set_t* _this, const set_r_iterator_t* r_iterator);
     set_iterator_t* (*find)(const set_t* _this, set_value_t value);
+    set_size_t (*find_batch)(const set_t* _this, const set_value_t* values, set_size_t n, set_iterator_t** out); /* out[i] = find(values[i]) for the n values, up to 16 descents run interleaved so their cache misses overlap. Return the count found or -1 */
+    set_size_t (*contains_sorted)(const set_t* _this, const set_value_t* values, set_size_t n, uint64_t* bitmap); /* Bit i of `bitmap`, 64 a word, is set if values[i] is in. Values in ascending order are found in one walk, each from the last one found in O(log d) for a gap of d, out of order ones from the root. Return the count found or -1 */
+    set_size_t (*find_sorted)(const set_t* _this, const set_value_t* values, set_size_t n, set_iterator_t** out); /* out[i] = find(values[i]) in one walk as `contains_sorted`. Return the count found or -1 */
     set_iterator_t* (*lower_bound)(const set_t* _this, set_value_t value); /* >= value */
     set_iterator_t* (*upper_bound)(const set_t* _this, set_value_t value); /*  > value */
     set_iterator_t* (*insert)(set_t* _this, set_value_t value);            /* if input value doesn't match -> insert | if input value match -> return NULL */
@@ -68,15 +99,42 @@ typedef struct class_set {
     set_size_t (*remove)(set_t* _this, set_value_t value);
     set_size_t (*remove_if)(set_t* _this, remove_if_condition_v cond);
     set_size_t (*clear)(set_t* _this);
+    set_size_t (*build_sorted)(set_t* _this, const set_value_t* values, set_size_t n, bool contiguous); /* Only into an empty set. Unsorted input is sorted first, the first of equal values is kept. Return the size or -1 */
+    set_size_t (*rank)(const set_t* _this, set_value_t value);                     /* Count of values < `value` */
+    set_iterator_t* (*select)(const set_t* _this, set_size_t k);                   /* The k-th in order from 0, `end` if k >= size */
+    set_size_t (*count_range)(const set_t* _this, set_value_t lo, set_value_t hi); /* Count of values in [ lo, hi ) */
+    set_iterator_t* (*insert_hint)(set_t* _this, set_iterator_t* hint, set_value_t value); /* As `insert`, in O(1) amortized if `value` belongs right before or after `hint`, or at `end` */
+    set_iterator_t* (*equal_range)(const set_t* _this, set_value_t value, set_iterator_t** last); /* [ return, *last ) holds the values equal to `value`, both are `lower_bound` if there's none */
+    set_size_t (*erase_range)(set_t* _this, set_value_t lo, set_value_t hi); /* Erase the values in [ lo, hi ) with one descent, return the count erased */
+    set_size_t (*for_each_range)(const set_t* _this, set_value_t lo, set_value_t hi, for_each_v cb, void* arg); /* Visit the values in [ lo, hi ) in order until `cb` returns false, return the count visited */
+    set_size_t (*set_union)(set_t* _this, const set_t* a, const set_t* b); /* Into an empty `_this` with one merged walk of `a` and `b` and an O(n) `build_sorted`. Return the size or -1 */
+    set_size_t (*set_intersection)(set_t* _this, const set_t* a, const set_t* b);
+    set_size_t (*set_difference)(set_t* _this, const set_t* a, const set_t* b); /* a - b */
+    set_size_t (*set_symmetric_difference)(set_t* _this, const set_t* a, const set_t* b);
+    set_size_t (*union_with)(set_t* _this, const set_t* other); /* In place with one merged walk, copies from `other` are linked without a descent. Return the size or -1 */
+    set_size_t (*intersect_with)(set_t* _this, const set_t* other);
+    set_size_t (*difference_with)(set_t* _this, const set_t* other);
+    set_size_t (*symmetric_difference_with)(set_t* _this, const set_t* other);
+    set_size_t (*split)(set_t* _this, set_value_t value, set_t* left, set_t* right); /* Values < `value` move to `left`, the others to `right`, by relinking the nodes in O(log n). `left` and `right` are empty or `_this`, with its ops and config. Sizes take O(log n) in order-statistic mode, O(min(|left|, |right|)) otherwise. Nodes of `build_sorted(..., contiguous = true)` take O(min(|left|, |right|)) more to share out their blocks. Return the size of `left` or -1 */
+    set_size_t (*join)(set_t* _this, set_t* other); /* Every value of `other` is greater than every value of `_this`, they all move into `_this` in O(log n). Return the size or -1 */
+    set_iterator_t* (*extract)(set_t* _this, set_iterator_t* iterator, ds_node_handle_t* handle); /* As `erase`, but the value is moved into `handle->key` of the empty `handle` with its node memory instead of being freed, see `_handle.h` */
+    set_iterator_t* (*insert_node)(set_t* _this, ds_node_handle_t* handle); /* As `insert` with `handle->key`, reusing the node memory of `handle` and without copying the value. On success the handle is empty */
+    void (*free_node)(set_t* _this, ds_node_handle_t* handle); /* Free what `handle` holds with the ops of `_this` */
 } class_set_t;
 
 void __set_init(set_t* set);
 void __set_deinit(set_t* set);
 const class_set_t* class_set_ins(void);
-#define g_class_set()            class_set_ins()
-#define cset                     g_class_set()
-#define SET_INIT(_ptr)           (set_t) { .ops = NULL, .size = 0, }; __set_init((_ptr))
-#define SET_INIT_OPS(_ptr, _ops) (set_t) { .ops = _ops, .size = 0, }; __set_init((_ptr))
-#define SET_DEINIT(_ptr)         do { __set_deinit((_ptr)); } while(0)
+#define g_class_set()                  class_set_ins()
+#define cset                           g_class_set()
+#define SET_INIT(_ptr)                 (set_t) { .ops = NULL, .size = 0, }; __set_init((_ptr))
+#define SET_INIT_OPS(_ptr, _ops)       (set_t) { .ops = _ops, .size = 0, }; __set_init((_ptr))
+#define SET_INIT_OS(_ptr)              (set_t) { .ops = NULL, .size = 0, .config = { .c = { .b_order_stat = 1 } }, }; __set_init((_ptr))
+#define SET_INIT_OPS_OS(_ptr, _ops)    (set_t) { .ops = _ops, .size = 0, .config = { .c = { .b_order_stat = 1 } }, }; __set_init((_ptr))
+#define SET_INIT_SMALL(_ptr)           (set_t) { .ops = NULL, .size = 0, .config = { .c = { .b_small = 1 } }, }; __set_init((_ptr))
+#define SET_INIT_OPS_SMALL(_ptr, _ops) (set_t) { .ops = _ops, .size = 0, .config = { .c = { .b_small = 1 } }, }; __set_init((_ptr))
+#define SET_INIT_THREAD(_ptr)          (set_t) { .ops = NULL, .size = 0, .config = { .c = { .b_thread = 1 } }, }; __set_init((_ptr))
+#define SET_INIT_OPS_THREAD(_ptr, _ops) (set_t) { .ops = _ops, .size = 0, .config = { .c = { .b_thread = 1 } }, }; __set_init((_ptr))
+#define SET_DEINIT(_ptr)               do { __set_deinit((_ptr)); } while(0)
 
 #endif /* __J_SET_H */
@@ -27,6 +27,7 @@ typedef struct class_set_ops {
     bool (*__lt_value)(set_value_t left, set_value_t right); /* Return true if [ `left` < `right` ] */
     bool (*copy_value)(set_value_t in, set_value_t* out);    /* The function pointer can be null and manages memory on its own. However, if this function is implemented, `free_value` must also be implemented */
     void (*free_value)(set_value_t* value);                  /* The function pointer can be null and manages memory on its own */
+    int (*__cmp_value)(set_value_t left, set_value_t right); /* Optional, with `__lt_value` set and agreeing with it: return < 0, 0 or > 0 as [ `left` < `right` ], [ `left` == `right` ] or [ `left` > `right` ]. Searches and inserts then compare once per node instead of twice */
 } class_set_ops_t;
 
 #endif /* __J_SET_OPS_H */
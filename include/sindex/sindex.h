@@ -0,0 +1,74 @@
+/*
+  Static Search Index
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef __J_SINDEX_H
+#define __J_SINDEX_H
+
+#include <_types.h>
+#include <map/map.h>
+#include <set/set.h>
+#include <vector/vector.h>
+
+/* An immutable set or map of integer keys, built once from a `set_t`, a `map_t`, a sorted
+   `vector_t` or an array, and laid out for lookups instead of updates:
+   - SINDEX_EYTZINGER: the keys in BFS order of an implicit binary tree (keys[1] is the root,
+     the children of k are 2k and 2k + 1). The descent is a conditional move per level, and
+     the 8 descendants three levels down share a cache line that is prefetched ahead.
+   - SINDEX_STREE: an implicit B-tree of SINDEX_BLOCK keys per 64-byte block (block k has
+     children k * (SINDEX_BLOCK + 1) + i + 1), each block ranked with SIMD compares, one cache
+     miss per level over log17(n) levels.
+   Keys compare as signed integers, containers with `ops->__lt` are refused. A map keeps its
+   values in the same order as its keys */
+#define SINDEX_BLOCK (8)
+
+typedef enum sindex_layout {
+    SINDEX_EYTZINGER = 0,
+    SINDEX_STREE     = 1,
+} sindex_layout_t;
+
+typedef struct sindex {
+    sindex_key_t*   keys;   /* 64-byte aligned. Eytzinger: keys[1 .. size]. S-tree: `blocks` blocks, the last one padded with the greatest key */
+    sindex_value_t* values; /* Slot for slot with `keys`, NULL for a set */
+    sindex_size_t   size;
+    sindex_size_t   blocks;
+    sindex_layout_t layout;
+} sindex_t;
+
+typedef struct class_sindex {
+    sindex_size_t (*size)(const sindex_t* _this);
+    sindex_size_t (*build_sorted)(sindex_t* _this, const sindex_key_t* keys, const sindex_value_t* values, sindex_size_t n); /* `values` may be NULL for a set. Unsorted input is sorted first, the first of equal keys is kept. A built index is rebuilt. Return the size or -1 */
+    sindex_size_t (*build_set)(sindex_t* _this, const set_t* set);
+    sindex_size_t (*build_map)(sindex_t* _this, const map_t* map);
+    sindex_size_t (*build_vector)(sindex_t* _this, const vector_t* vector);
+    bool (*contains)(const sindex_t* _this, sindex_key_t key);
+    bool (*find)(const sindex_t* _this, sindex_key_t key, sindex_value_t* value);                            /* `value` may be NULL */
+    bool (*lower_bound)(const sindex_t* _this, sindex_key_t key, sindex_key_t* lower, sindex_value_t* value); /* The least key >= `key` into `lower` if there's one, both outputs may be NULL */
+    sindex_size_t (*clear)(sindex_t* _this);
+} class_sindex_t;
+
+void __sindex_init(sindex_t* sindex, sindex_layout_t layout);
+void __sindex_deinit(sindex_t* sindex);
+const class_sindex_t* class_sindex_ins(void);
+#define g_class_sindex()        class_sindex_ins()
+#define csindex                 g_class_sindex()
+#define SINDEX_INIT(_ptr)       (sindex_t) { .size = 0, }; __sindex_init((_ptr), SINDEX_EYTZINGER)
+#define SINDEX_INIT_STREE(_ptr) (sindex_t) { .size = 0, }; __sindex_init((_ptr), SINDEX_STREE)
+#define SINDEX_DEINIT(_ptr)     do { __sindex_deinit((_ptr)); } while(0)
+
+#endif /* __J_SINDEX_H */
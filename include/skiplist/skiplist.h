@@ -0,0 +1,90 @@
+/*
+  Concurrent Skiplist
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef __J_SKIPLIST_H
+#define __J_SKIPLIST_H
+
+#include <pthread.h>
+#include <_types.h>
+#include <map/map_ops.h>
+
+/* An ordered map safe to use from many threads at once, without locks.
+   Each level is a linked list updated by CAS, a node is removed by marking bit 0 of its
+   `next` pointers from the top level down, the mark of level 0 deciding who removed it.
+   Removed nodes are freed by epoch based reclamation: a thread announces the global epoch
+   while it's inside an operation, and a node is freed once the epoch has moved on twice,
+   when no thread can still be looking at it.
+
+   Keys are unique and never change once inserted, a value is only set by `insert`.
+   A key or value handed out by `find` or `lower_bound` stays valid until that key is removed,
+   inside `for_each_range` the callback sees it safely whatever the other threads do.
+   Every list holds a `pthread_key_t` of the process from init to deinit */
+
+#define SKIPLIST_LEVEL_MAX 16 /* Levels grow with a probability of 1/4, enough for 4^16 keys */
+
+typedef struct skiplist_node {
+    skiplist_key_t key;
+    skiplist_value_t value;
+    int level;
+    int owners;                    /* The inserter and the remover, the last one to let go unlinks and retires it */
+    struct skiplist_node* retired; /* Next in the limbo list of the thread that retired it */
+    uintptr_t next[];              /* Successor on each level, bit 0 set once removed from that level */
+} skiplist_node_t;
+
+/* A thread working on the list, reused by another once its thread exits */
+typedef struct skiplist_thread {
+    struct skiplist_thread* next;
+    unsigned long state;       /* (epoch << 1) | 1 inside an operation, 0 outside */
+    unsigned long epoch;       /* The global epoch seen last */
+    skiplist_node_t* limbo[3]; /* Nodes retired in each epoch modulo 3 */
+    size_t retired;
+    uint32_t seed;
+    int nest;
+    bool in_use;
+} skiplist_thread_t;
+
+typedef struct skiplist {
+    const class_map_ops_t* ops;
+    skiplist_node_t* head;
+    skiplist_size_t size;
+    unsigned long epoch;
+    skiplist_thread_t* threads;
+    pthread_key_t key;
+} skiplist_t;
+
+typedef struct class_skiplist {
+    skiplist_size_t (*size)(const skiplist_t* _this);                                                         /* Exact when no writer is running */
+    bool (*find)(skiplist_t* _this, skiplist_key_t key, skiplist_value_t* value);                             /* `value` may be NULL */
+    bool (*lower_bound)(skiplist_t* _this, skiplist_key_t key, skiplist_key_t* lower, skiplist_value_t* value); /* The first key >= `key`, `lower` and `value` may be NULL */
+    bool (*insert)(skiplist_t* _this, skiplist_key_t key, skiplist_value_t value);                            /* Return false if `key` exists */
+    skiplist_size_t (*remove)(skiplist_t* _this, skiplist_key_t key);                                         /* Return the count removed */
+    skiplist_size_t (*clear)(skiplist_t* _this);                                                              /* Remove the keys present when it passes them, return the count removed */
+    skiplist_size_t (*for_each_range)(skiplist_t* _this, skiplist_key_t lo, skiplist_key_t hi, for_each_kv cb, void* arg); /* Visit the keys in [ lo, hi ) in order until `cb` returns false, return the count visited. Keys inserted or removed meanwhile may be seen or not */
+} class_skiplist_t;
+
+void __skiplist_init(skiplist_t* skiplist);
+void __skiplist_deinit(skiplist_t* skiplist); /* No other thread may use the list any more */
+const class_skiplist_t* class_skiplist_ins(void);
+#define g_class_skiplist()            class_skiplist_ins()
+#define cskiplist                     g_class_skiplist()
+#define SKIPLIST_INIT(_ptr)           (skiplist_t) { .ops = NULL, .size = 0, }; __skiplist_init((_ptr))
+#define SKIPLIST_INIT_OPS(_ptr, _ops) (skiplist_t) { .ops = _ops, .size = 0, }; __skiplist_init((_ptr))
+#define SKIPLIST_DEINIT(_ptr)         do { __skiplist_deinit((_ptr)); } while(0)
+
+#endif /* __J_SKIPLIST_H */
@@ -0,0 +1,89 @@
+/*
+  Snapshot Interfaces
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef __J_SNAPSHOT_H
+#define __J_SNAPSHOT_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <map/map.h>
+#include <set/set.h>
+#include <hashmap/hashmap.h>
+
+/* A snapshot forks the process, the child walks a copy-on-write view of the container
+   with the existing iterators and streams it to a file while the parent keeps mutating.
+   hashmap_t is written in the `hashmap_image` format (see hashmap/hashmap_image.h),
+   map_t and set_t are written in order as:
+   [ header | record ... ], record: key (map only) and value, each an integer (8 bytes)
+   or a string ([ u32 length | bytes ], length 0xffffffff is NULL) */
+#define SNAPSHOT_MAGIC   (0x50414e53) /* "SNAP" */
+#define SNAPSHOT_VERSION (1)
+
+typedef enum snapshot_ds {
+    SNAPSHOT_DS_HASHMAP = 1,
+    SNAPSHOT_DS_MAP     = 2,
+    SNAPSHOT_DS_SET     = 3,
+} snapshot_ds_t;
+
+typedef struct snapshot_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ds;         /* snapshot_ds_t */
+    uint32_t type;       /* hashmap_kv_type_t, for set_t only HM_KV_VALUE_STRING is meaningful */
+    uint64_t size;       /* Count of records */
+} snapshot_header_t;
+
+typedef struct snapshot_report {
+    int      status;            /* 0 on success */
+    uint64_t duration_us;       /* From `fork` until the child finished writing */
+    uint64_t fork_us;           /* How long the parent was blocked in `fork` */
+    uint64_t records;
+    uint64_t bytes;             /* Size of the file written */
+    uint64_t rss_bytes;         /* Resident memory of the parent at `fork` */
+    uint64_t cow_bytes;         /* Memory the child ended up owning privately, i.e. pages duplicated by copy-on-write */
+    double   cow_amplification; /* cow_bytes / rss_bytes */
+} snapshot_report_t;
+
+typedef struct snapshot {
+    pid_t    pid;
+    int      fd;                /* Read end of the pipe the child reports through */
+    int      wstatus;
+    bool     reaped;
+    uint64_t start_us;
+    uint64_t fork_us;
+    uint64_t rss_bytes;
+} snapshot_t;
+
+typedef struct class_snapshot {
+    bool (*hashmap)(snapshot_t* _this, const hashmap_t* hashmap, const char* path, hashmap_kv_type_t type); /* Start writing `hashmap` in the background */
+    bool (*map)(snapshot_t* _this, const map_t* map, const char* path, hashmap_kv_type_t type);             /* Start writing `map` in the background */
+    bool (*set)(snapshot_t* _this, const set_t* set, const char* path, hashmap_kv_type_t type);             /* Start writing `set` in the background */
+    bool (*done)(snapshot_t* _this);                                                                        /* Return true once the child has finished, never blocks */
+    bool (*wait)(snapshot_t* _this, snapshot_report_t* report);                                             /* Block until the child has finished and fill `report` */
+} class_snapshot_t;
+
+void __snapshot_init(snapshot_t* snapshot);
+void __snapshot_deinit(snapshot_t* snapshot);
+const class_snapshot_t* class_snapshot_ins(void);
+#define g_class_snapshot()     class_snapshot_ins()
+#define csnapshot              g_class_snapshot()
+#define SNAPSHOT_INIT(_ptr)    (snapshot_t) { .pid = -1, .fd = -1, }; __snapshot_init((_ptr))
+#define SNAPSHOT_DEINIT(_ptr)  do { __snapshot_deinit((_ptr)); } while(0)
+
+#endif /* __J_SNAPSHOT_H */
@@ -31,4 +31,9 @@ void sort_heap(ds_data_t* a, ds_size_t size, __comp __comp);
 void __sort_quick(ds_data_t* a, ds_size_t size, __comp __comp);
 void sort_quick(ds_data_t* a, ds_size_t size, __comp __comp);
 
+/* Stable sort of `size` records of `width` ds_data_t ordered by their first one,
+   return false if the merge buffer can't be allocated */
+bool __sort_merge_n(ds_data_t* a, ds_size_t size, ds_size_t width, __comp __comp);
+bool sort_merge_n(ds_data_t* a, ds_size_t size, ds_size_t width, __comp __comp);
+
 #endif /* __J_SORT_H */
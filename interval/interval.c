@@ -0,0 +1,542 @@
+/*
+  Interval Tree
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <interval/interval.h>
+
+#include <_memory.h>
+#include <linux/rbtree.h>
+#include <linux/_compiler.h>
+#include <iterator/iterator.h>
+
+#define interval_entry(ptr) rb_entry((ptr), struct interval_node, node)
+
+/* Augment callbacks: `max` of a node is the greatest `hi` below it, itself included */
+static /* __always_inline */ inline interval_key_t __interval_max_compute(const interval_node_t* t)
+{
+    interval_key_t max = t->hi;
+
+    if (!is_null(t->node.rb_left) && interval_entry(t->node.rb_left)->max > max)
+        max = interval_entry(t->node.rb_left)->max;
+    if (!is_null(t->node.rb_right) && interval_entry(t->node.rb_right)->max > max)
+        max = interval_entry(t->node.rb_right)->max;
+    return max;
+}
+
+static void __interval_max_propagate(struct rb_node* node, struct rb_node* stop)
+{
+    for (; node != stop; node = rb_parent(node))
+        interval_entry(node)->max = __interval_max_compute(interval_entry(node));
+}
+
+static void __interval_max_copy(struct rb_node* old, struct rb_node* new)
+{
+    interval_entry(new)->max = interval_entry(old)->max;
+}
+
+static void __interval_max_rotate(struct rb_node* old, struct rb_node* new)
+{
+    interval_entry(new)->max = interval_entry(old)->max;
+    interval_entry(old)->max = __interval_max_compute(interval_entry(old));
+}
+
+static const struct rb_augment_callbacks interval_augment = {
+    .propagate = __interval_max_propagate,
+    .copy      = __interval_max_copy,
+    .rotate    = __interval_max_rotate,
+};
+
+static /* __always_inline */ inline bool __interval_lt(interval_key_t llo, interval_key_t lhi, const interval_node_t* t)
+{
+    return llo < t->lo || (llo == t->lo && lhi < t->hi);
+}
+
+static /* __always_inline */ inline interval_size_t __interval_size(const interval_t* _this)
+{
+    return _this->size;
+}
+
+static /* __always_inline */ inline interval_size_t _interval_size(const interval_t* _this)
+{
+    if (unlikely(is_null(_this)))
+        return -1;
+    return __interval_size(_this);
+}
+
+static /* __always_inline */ inline interval_node_t* __interval_first(const interval_t* _this)
+{
+    struct rb_node* t = rb_first(&_this->root);
+    return is_null(t) ? NULL : interval_entry(t);
+}
+
+static /* __always_inline */ inline interval_node_t* __interval_last(const interval_t* _this)
+{
+    struct rb_node* t = rb_last(&_this->root);
+    return is_null(t) ? NULL : interval_entry(t);
+}
+
+static /* __always_inline */ inline interval_node_t* __interval_end(const interval_t* _this)
+{
+    return (interval_node_t*)iterator_end();
+}
+
+static /* __always_inline */ inline interval_node_t* __interval_begin(const interval_t* _this)
+{
+    interval_node_t* t = __interval_first(_this);
+    return is_null(t) ? __interval_end(_this) : t;
+}
+
+static /* __always_inline */ inline interval_node_t* _interval_begin(const interval_t* _this)
+{
+    if (unlikely(is_null(_this)))
+        return NULL;
+    return __interval_begin(_this);
+}
+
+static /* __always_inline */ inline interval_node_t* __interval_next(const interval_t* _this, const interval_node_t* node)
+{
+    struct rb_node* t = NULL;
+
+    if (RB_EMPTY_ROOT(&_this->root) || __interval_end(_this) == node)
+        return __interval_end(_this);
+
+    /* This check should come after `end` or `rend`.
+       This is a pre-judgment condition for `rb_next` or `rb_prev` */
+    if (unlikely(RB_EMPTY_NODE(&node->node)))
+        return NULL;
+
+    t = rb_next(&node->node);
+    return is_null(t) ? __interval_end(_this) : interval_entry(t);
+}
+
+static /* __always_inline */ inline interval_node_t* _interval_next(const interval_t* _this, const interval_node_t* node)
+{
+    if (unlikely(is_null(_this) || is_null(node)))
+        return NULL;
+    return __interval_next(_this, node);
+}
+
+static /* __always_inline */ inline interval_node_t* __interval_prev(const interval_t* _this, const interval_node_t* node)
+{
+    struct rb_node* t = NULL;
+
+    if (RB_EMPTY_ROOT(&_this->root))
+        return __interval_end(_this);
+
+    if (__interval_end(_this) == node)
+        return __interval_last(_this);
+
+    if (unlikely(RB_EMPTY_NODE(&node->node)))
+        return NULL;
+
+    t = rb_prev(&node->node);
+    return is_null(t) ? __interval_end(_this) : interval_entry(t);
+}
+
+static /* __always_inline */ inline interval_node_t* _interval_prev(const interval_t* _this, const interval_node_t* node)
+{
+    if (unlikely(is_null(_this) || is_null(node)))
+        return NULL;
+    return __interval_prev(_this, node);
+}
+
+static /* __always_inline */ inline interval_node_t* __interval_rend(const interval_t* _this)
+{
+    return (interval_node_t*)iterator_rend();
+}
+
+static /* __always_inline */ inline interval_node_t* __interval_rbegin(const interval_t* _this)
+{
+    interval_node_t* t = __interval_last(_this);
+    return is_null(t) ? __interval_rend(_this) : t;
+}
+
+static /* __always_inline */ inline interval_node_t* _interval_rbegin(const interval_t* _this)
+{
+    if (unlikely(is_null(_this)))
+        return NULL;
+    return __interval_rbegin(_this);
+}
+
+static /* __always_inline */ inline interval_node_t* __interval_rnext(const interval_t* _this, const interval_node_t* node)
+{
+    struct rb_node* t = NULL;
+
+    if (RB_EMPTY_ROOT(&_this->root) || __interval_rend(_this) == node)
+        return __interval_rend(_this);
+
+    if (unlikely(RB_EMPTY_NODE(&node->node)))
+        return NULL;
+
+    t = rb_prev(&node->node);
+    return is_null(t) ? __interval_rend(_this) : interval_entry(t);
+}
+
+static /* __always_inline */ inline interval_node_t* _interval_rnext(const interval_t* _this, const interval_node_t* node)
+{
+    if (unlikely(is_null(_this) || is_null(node)))
+        return NULL;
+    return __interval_rnext(_this, node);
+}
+
+static /* __always_inline */ inline interval_node_t* __interval_rprev(const interval_t* _this, const interval_node_t* node)
+{
+    struct rb_node* t = NULL;
+
+    if (RB_EMPTY_ROOT(&_this->root))
+        return __interval_rend(_this);
+
+    if (__interval_rend(_this) == node)
+        return __interval_first(_this);
+
+    if (unlikely(RB_EMPTY_NODE(&node->node)))
+        return NULL;
+
+    t = rb_next(&node->node);
+    return is_null(t) ? __interval_rend(_this) : interval_entry(t);
+}
+
+static /* __always_inline */ inline interval_node_t* _interval_rprev(const interval_t* _this, const interval_node_t* node)
+{
+    if (unlikely(is_null(_this) || is_null(node)))
+        return NULL;
+    return __interval_rprev(_this, node);
+}
+
+/* The first of the equal intervals */
+static interval_node_t* __interval_find(const interval_t* _this, interval_key_t lo, interval_key_t hi)
+{
+    struct rb_node* n = _this->root.rb_node;
+    interval_node_t* ret = NULL;
+    interval_node_t* t = NULL;
+
+    while (!is_null(n)) {
+        t = interval_entry(n);
+
+        if (__interval_lt(lo, hi, t)) {
+            n = n->rb_left;
+        } else if (t->lo < lo || (t->lo == lo && t->hi < hi)) {
+            n = n->rb_right;
+        } else {
+            ret = t;
+            n = n->rb_left;
+        }
+    }
+
+    return ret;
+}
+
+static /* __always_inline */ inline interval_node_t* interval_find(const interval_t* _this, interval_key_t lo, interval_key_t hi)
+{
+    interval_node_t* t = NULL;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    t = __interval_find(_this, lo, hi);
+    return is_null(t) ? __interval_end(_this) : t;
+}
+
+static interval_node_t* interval_insert(interval_t* _this, interval_key_t lo, interval_key_t hi, interval_value_t value)
+{
+    struct rb_node** n = NULL;
+    struct rb_node* parent = NULL;
+    interval_node_t* t = NULL;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (lo >= hi)
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
+        return NULL;
+
+    t = (interval_node_t*)p_calloc(1, sizeof(interval_node_t));
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    if (is_null(_this->ops) || is_null(_this->ops->copy_value)) {
+        t->value = value;
+    } else {
+        if (!_this->ops->copy_value(value, &t->value)) {
+            p_free(t);
+            return NULL;
+        }
+    }
+
+    t->lo = lo;
+    t->hi = hi;
+    t->max = hi;
+
+    for (n = &_this->root.rb_node; !is_null(*n); ) {
+        parent = *n;
+        n = __interval_lt(lo, hi, interval_entry(parent)) ? &parent->rb_left : &parent->rb_right;
+    }
+
+    rb_link_node(&t->node, parent, n);
+    rb_insert_augmented(&t->node, &_this->root, &interval_augment);
+    _this->size++;
+    return t;
+}
+
+static /* __always_inline */ inline void __interval_node_free(interval_t* _this, interval_node_t* t)
+{
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&t->value);
+
+    p_free(t);
+}
+
+static interval_node_t* interval_erase(interval_t* _this, interval_node_t* pos)
+{
+    interval_node_t* t = NULL;
+
+    if (unlikely(is_null(_this) || is_null(pos)))
+        return NULL;
+
+    /* The input parameter is `iterator`, and there's no need 
+       to check whether it equals `rend` */
+    if (__interval_size(_this) <= 0 || __interval_end(_this) == pos)
+        return NULL;
+
+    t = __interval_next(_this, pos);
+    if (is_null(t))
+        return NULL;
+
+    rb_erase_augmented(&pos->node, &_this->root, &interval_augment);
+    _this->size--;
+    __interval_node_free(_this, pos);
+    return t;
+}
+
+static interval_size_t interval_remove(interval_t* _this, interval_key_t lo, interval_key_t hi)
+{
+    interval_size_t ret = 0;
+    interval_node_t* t = NULL;
+
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    t = __interval_find(_this, lo, hi);
+    while (!is_null(t) && __interval_end(_this) != t && t->lo == lo && t->hi == hi) {
+        t = interval_erase(_this, t);
+        ret++;
+    }
+
+    return ret;
+}
+
+/* Postorder, so nodes are freed without `rb_erase` keeping the tree balanced all along */
+static interval_size_t interval_clear(interval_t* _this)
+{
+    interval_size_t ret = 0;
+    struct rb_node* n = NULL;
+    struct rb_node* next = NULL;
+
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    for (n = rb_first_postorder(&_this->root); !is_null(n); n = next) {
+        next = rb_next_postorder(n);
+        __interval_node_free(_this, interval_entry(n));
+        ret++;
+    }
+
+    _this->root = RB_ROOT;
+    _this->size = 0;
+    return ret;
+}
+
+/* The leftmost node of the subtree `t` overlapping [ lo, hi ), given `t->max` > `lo`.
+   The leftmost node of which `hi` > `lo` is the only candidate: those after it start later */
+static interval_node_t* __interval_subtree_search(interval_node_t* t, interval_key_t lo, interval_key_t hi)
+{
+    interval_node_t* left = NULL;
+
+    while (true) {
+        if (!is_null(t->node.rb_left)) {
+            left = interval_entry(t->node.rb_left);
+            if (left->max > lo) {
+                t = left;
+                continue;
+            }
+        }
+
+        if (t->lo < hi) {
+            if (t->hi > lo)
+                return t;
+
+            if (!is_null(t->node.rb_right)) {
+                t = interval_entry(t->node.rb_right);
+                if (t->max > lo)
+                    continue;
+            }
+        }
+
+        return NULL;
+    }
+}
+
+static interval_node_t* __interval_overlap_first(const interval_t* _this, interval_key_t lo, interval_key_t hi)
+{
+    interval_node_t* t = NULL;
+
+    if (RB_EMPTY_ROOT(&_this->root) || lo >= hi)
+        return NULL;
+
+    t = interval_entry(_this->root.rb_node);
+    if (t->max <= lo)
+        return NULL;
+
+    return __interval_subtree_search(t, lo, hi);
+}
+
+/* In order from `t`, which starts before `hi`: the right subtree first, then up to the
+   first ancestor `t` is on the left of */
+static interval_node_t* __interval_overlap_next(const interval_node_t* t, interval_key_t lo, interval_key_t hi)
+{
+    struct rb_node* rb = t->node.rb_right;
+    struct rb_node* prev = NULL;
+
+    while (true) {
+        if (!is_null(rb) && interval_entry(rb)->max > lo)
+            return __interval_subtree_search(interval_entry(rb), lo, hi);
+
+        do {
+            rb = rb_parent(&t->node);
+            if (is_null(rb))
+                return NULL;
+
+            prev = (struct rb_node*)&t->node;
+            t = interval_entry(rb);
+            rb = t->node.rb_right;
+        } while (prev == rb);
+
+        if (t->lo >= hi)
+            return NULL;
+        if (t->hi > lo)
+            return (interval_node_t*)t;
+    }
+}
+
+static interval_node_t* interval_overlap_first(const interval_t* _this, interval_key_t lo, interval_key_t hi)
+{
+    interval_node_t* t = NULL;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    t = __interval_overlap_first(_this, lo, hi);
+    return is_null(t) ? __interval_end(_this) : t;
+}
+
+static interval_node_t* interval_overlap_next(const interval_t* _this, const interval_node_t* node, interval_key_t lo, interval_key_t hi)
+{
+    interval_node_t* t = NULL;
+
+    if (unlikely(is_null(_this) || is_null(node)))
+        return NULL;
+
+    if (RB_EMPTY_ROOT(&_this->root) || __interval_end(_this) == node || lo >= hi)
+        return __interval_end(_this);
+
+    if (unlikely(RB_EMPTY_NODE(&node->node)))
+        return NULL;
+
+    t = __interval_overlap_next(node, lo, hi);
+    return is_null(t) ? __interval_end(_this) : t;
+}
+
+static interval_size_t interval_overlap(const interval_t* _this, interval_key_t lo, interval_key_t hi, for_each_interval cb, void* arg)
+{
+    interval_size_t ret = 0;
+    interval_node_t* t = NULL;
+
+    if (unlikely(is_null(_this) || is_null(cb)))
+        return -1;
+
+    for (t = __interval_overlap_first(_this, lo, hi); !is_null(t); t = __interval_overlap_next(t, lo, hi)) {
+        ret++;
+        if (!cb(t->lo, t->hi, t->value, arg))
+            break;
+    }
+
+    return ret;
+}
+
+static interval_size_t interval_stab(const interval_t* _this, interval_key_t point, for_each_interval cb, void* arg)
+{
+    if (unlikely(point == INTPTR_MAX))
+        return 0; /* No interval holds it, `hi` is at most INTPTR_MAX */
+
+    return interval_overlap(_this, point, point + 1, cb, arg);
+}
+
+/* __always_inline */ inline void __interval_init(interval_t* interval)
+{
+    interval->root = RB_ROOT;
+}
+
+/* __always_inline */ inline void __interval_deinit(interval_t* interval)
+{
+    interval_clear(interval);
+
+    interval->ops = NULL;
+    interval->root = RB_ROOT;
+    interval->size = 0;
+}
+
+typedef interval_iterator_t* (*fp_end)(const interval_t* _this);
+typedef interval_iterator_t* (*fp_begin)(const interval_t* _this);
+typedef interval_iterator_t* (*fp_next)(const interval_t* _this, const interval_iterator_t* iterator);
+typedef interval_iterator_t* (*fp_prev)(const interval_t* _this, const interval_iterator_t* iterator);
+typedef interval_r_iterator_t* (*fp_rend)(const interval_t* _this);
+typedef interval_r_iterator_t* (*fp_rbegin)(const interval_t* _this);
+typedef interval_r_iterator_t* (*fp_rnext)(const interval_t* _this, const interval_r_iterator_t* r_iterator);
+typedef interval_r_iterator_t* (*fp_rprev)(const interval_t* _this, const interval_r_iterator_t* r_iterator);
+typedef interval_iterator_t* (*fp_find)(const interval_t* _this, interval_key_t lo, interval_key_t hi);
+typedef interval_iterator_t* (*fp_insert)(interval_t* _this, interval_key_t lo, interval_key_t hi, interval_value_t value);
+typedef interval_iterator_t* (*fp_erase)(interval_t* _this, interval_iterator_t* iterator);
+typedef interval_iterator_t* (*fp_overlap_first)(const interval_t* _this, interval_key_t lo, interval_key_t hi);
+typedef interval_iterator_t* (*fp_overlap_next)(const interval_t* _this, const interval_iterator_t* iterator, interval_key_t lo, interval_key_t hi);
+
+const class_interval_t* class_interval_ins(void)
+{
+    static const class_interval_t ins = {
+        .size          = _interval_size,
+        .end           = (fp_end)__interval_end,
+        .begin         = (fp_begin)_interval_begin,
+        .next          = (fp_next)_interval_next,
+        .prev          = (fp_prev)_interval_prev,
+        .rend          = (fp_rend)__interval_rend,
+        .rbegin        = (fp_rbegin)_interval_rbegin,
+        .rnext         = (fp_rnext)_interval_rnext,
+        .rprev         = (fp_rprev)_interval_rprev,
+        .find          = (fp_find)interval_find,
+        .insert        = (fp_insert)interval_insert,
+        .erase         = (fp_erase)interval_erase,
+        .remove        = interval_remove,
+        .clear         = interval_clear,
+        .overlap_first = (fp_overlap_first)interval_overlap_first,
+        .overlap_next  = (fp_overlap_next)interval_overlap_next,
+        .overlap       = interval_overlap,
+        .stab          = interval_stab,
+    };
+    return &ins;
+}
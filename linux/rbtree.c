@@ -23,7 +23,7 @@
 #define	RB_RED   0
 #define	RB_BLACK 1
 
-static void __rb_rotate_left(struct rb_node *node, struct rb_root *root)
+static inline void __rb_rotate_left(struct rb_node *node, struct rb_root *root, const struct rb_augment_callbacks *augment)
 {
     struct rb_node *right = node->rb_right;
     struct rb_node *parent = rb_parent(node);
@@ -44,9 +44,12 @@ static void __rb_rotate_left(struct rb_node *node, struct rb_root *root)
     else
         root->rb_node = right;
     rb_set_parent(node, right);
+
+    if (augment)
+        augment->rotate(node, right);
 }
 
-static void __rb_rotate_right(struct rb_node *node, struct rb_root *root)
+static inline void __rb_rotate_right(struct rb_node *node, struct rb_root *root, const struct rb_augment_callbacks *augment)
 {
     struct rb_node *left = node->rb_left;
     struct rb_node *parent = rb_parent(node);
@@ -67,9 +70,12 @@ static void __rb_rotate_right(struct rb_node *node, struct rb_root *root)
     else
         root->rb_node = left;
     rb_set_parent(node, left);
+
+    if (augment)
+        augment->rotate(node, left);
 }
 
-void rb_insert_color(struct rb_node *node, struct rb_root *root)
+static inline void __rb_insert_color(struct rb_node *node, struct rb_root *root, const struct rb_augment_callbacks *augment)
 {
     struct rb_node *parent, *gparent;
 
@@ -94,7 +100,7 @@ void rb_insert_color(struct rb_node *node, struct rb_root *root)
             if (parent->rb_right == node)
             {
                 register struct rb_node *tmp;
-                __rb_rotate_left(parent, root);
+                __rb_rotate_left(parent, root, augment);
                 tmp = parent;
                 parent = node;
                 node = tmp;
@@ -102,7 +108,7 @@ void rb_insert_color(struct rb_node *node, struct rb_root *root)
 
             rb_set_black(parent);
             rb_set_red(gparent);
-            __rb_rotate_right(gparent, root);
+            __rb_rotate_right(gparent, root, augment);
         } else {
             {
                 register struct rb_node *uncle = gparent->rb_left;
@@ -119,7 +125,7 @@ void rb_insert_color(struct rb_node *node, struct rb_root *root)
             if (parent->rb_left == node)
             {
                 register struct rb_node *tmp;
-                __rb_rotate_right(parent, root);
+                __rb_rotate_right(parent, root, augment);
                 tmp = parent;
                 parent = node;
                 node = tmp;
@@ -127,14 +133,25 @@ void rb_insert_color(struct rb_node *node, struct rb_root *root)
 
             rb_set_black(parent);
             rb_set_red(gparent);
-            __rb_rotate_left(gparent, root);
+            __rb_rotate_left(gparent, root, augment);
         }
     }
 
     rb_set_black(root->rb_node);
 }
 
-static void __rb_erase_color(struct rb_node *node, struct rb_node *parent, struct rb_root *root)
+void rb_insert_color(struct rb_node *node, struct rb_root *root)
+{
+    __rb_insert_color(node, root, NULL);
+}
+
+void rb_insert_augmented(struct rb_node *node, struct rb_root *root, const struct rb_augment_callbacks *augment)
+{
+    augment->propagate(node, NULL);
+    __rb_insert_color(node, root, augment);
+}
+
+static inline void __rb_erase_color(struct rb_node *node, struct rb_node *parent, struct rb_root *root, const struct rb_augment_callbacks *augment)
 {
     struct rb_node *other;
 
@@ -147,7 +164,7 @@ static void __rb_erase_color(struct rb_node *node, struct rb_node *parent, struc
             {
                 rb_set_black(other);
                 rb_set_red(parent);
-                __rb_rotate_left(parent, root);
+                __rb_rotate_left(parent, root, augment);
                 other = parent->rb_right;
             }
             if ((!other->rb_left || rb_is_black(other->rb_left)) &&
@@ -163,13 +180,13 @@ static void __rb_erase_color(struct rb_node *node, struct rb_node *parent, struc
                 {
                     rb_set_black(other->rb_left);
                     rb_set_red(other);
-                    __rb_rotate_right(other, root);
+                    __rb_rotate_right(other, root, augment);
                     other = parent->rb_right;
                 }
                 rb_set_color(other, rb_color(parent));
                 rb_set_black(parent);
                 rb_set_black(other->rb_right);
-                __rb_rotate_left(parent, root);
+                __rb_rotate_left(parent, root, augment);
                 node = root->rb_node;
                 break;
             }
@@ -181,7 +198,7 @@ static void __rb_erase_color(struct rb_node *node, struct rb_node *parent, struc
             {
                 rb_set_black(other);
                 rb_set_red(parent);
-                __rb_rotate_right(parent, root);
+                __rb_rotate_right(parent, root, augment);
                 other = parent->rb_left;
             }
             if ((!other->rb_left || rb_is_black(other->rb_left)) &&
@@ -197,13 +214,13 @@ static void __rb_erase_color(struct rb_node *node, struct rb_node *parent, struc
                 {
                     rb_set_black(other->rb_right);
                     rb_set_red(other);
-                    __rb_rotate_left(other, root);
+                    __rb_rotate_left(other, root, augment);
                     other = parent->rb_left;
                 }
                 rb_set_color(other, rb_color(parent));
                 rb_set_black(parent);
                 rb_set_black(other->rb_left);
-                __rb_rotate_right(parent, root);
+                __rb_rotate_right(parent, root, augment);
                 node = root->rb_node;
                 break;
             }
@@ -213,7 +230,7 @@ static void __rb_erase_color(struct rb_node *node, struct rb_node *parent, struc
         rb_set_black(node);
 }
 
-void rb_erase(struct rb_node *node, struct rb_root *root)
+static inline void __rb_erase(struct rb_node *node, struct rb_root *root, const struct rb_augment_callbacks *augment)
 {
     struct rb_node *child, *parent;
     int color;
@@ -257,6 +274,8 @@ void rb_erase(struct rb_node *node, struct rb_root *root)
         node->rb_left = old->rb_left;
         rb_set_parent(old->rb_left, node);
 
+        if (augment)
+            augment->copy(old, node);
         goto color;
     }
 
@@ -276,8 +295,21 @@ void rb_erase(struct rb_node *node, struct rb_root *root)
         root->rb_node = child;
 
 color:
+    /* `parent` is where a node went missing, the path above it is fixed before rotating */
+    if (augment)
+        augment->propagate(parent, NULL);
     if (color == RB_BLACK)
-        __rb_erase_color(child, parent, root);
+        __rb_erase_color(child, parent, root, augment);
+}
+
+void rb_erase(struct rb_node *node, struct rb_root *root)
+{
+    __rb_erase(node, root, NULL);
+}
+
+void rb_erase_augmented(struct rb_node *node, struct rb_root *root, const struct rb_augment_callbacks *augment)
+{
+    __rb_erase(node, root, augment);
 }
 
 struct rb_node *rb_first(const struct rb_root *root)
@@ -344,6 +376,42 @@ struct rb_node *rb_prev(const struct rb_node *node)
     return parent;
 }
 
+static struct rb_node *rb_left_deepest_node(const struct rb_node *node)
+{
+    for (;;) {
+        if (node->rb_left)
+            node = node->rb_left;
+        else if (node->rb_right)
+            node = node->rb_right;
+        else
+            return (struct rb_node *)node;
+    }
+}
+
+struct rb_node *rb_next_postorder(const struct rb_node *node)
+{
+    const struct rb_node *parent;
+
+    if (!node)
+        return NULL;
+
+    parent = rb_parent(node);
+
+    /* If we're sitting on node, we've already seen our children */
+    if (parent && node == parent->rb_left && parent->rb_right)
+        return rb_left_deepest_node(parent->rb_right);
+    else
+        return (struct rb_node *)parent;
+}
+
+struct rb_node *rb_first_postorder(const struct rb_root *root)
+{
+    if (!root->rb_node)
+        return NULL;
+
+    return rb_left_deepest_node(root->rb_node);
+}
+
 void rb_replace_node(struct rb_node *victim, struct rb_node *new, struct rb_root *root)
 {
 	struct rb_node *parent = rb_parent(victim);
@@ -363,3 +431,260 @@ void rb_replace_node(struct rb_node *victim, struct rb_node *new, struct rb_root
 
     *new = *victim;
 }
+
+/* Sizes of the two subtrees differ by one at most, so every level but the deepest
+   is full: painting the deepest one red when it's not the root keeps black heights equal */
+static struct rb_node *__rb_build_sorted(struct rb_node **list, size_t n, size_t depth, size_t red)
+{
+    struct rb_node *node, *left;
+
+    if (!n)
+        return NULL;
+
+    left = __rb_build_sorted(list, (n - 1) / 2, depth + 1, red);
+    node = *list;
+    *list = node->rb_right;
+
+    node->rb_parent_color = depth == red ? RB_RED : RB_BLACK;
+    node->rb_left = left;
+    if (left)
+        rb_set_parent(left, node);
+
+    node->rb_right = __rb_build_sorted(list, n - 1 - (n - 1) / 2, depth + 1, red);
+    if (node->rb_right)
+        rb_set_parent(node->rb_right, node);
+    return node;
+}
+
+void rb_build_sorted(struct rb_root *root, struct rb_node *list, size_t n)
+{
+    size_t depth = 0;
+
+    while (n >> (depth + 1))
+        ++depth;
+
+    root->rb_node = __rb_build_sorted(&list, n, 0, depth ? depth : (size_t)-1);
+}
+
+/* Count of black nodes from `node` down to a leaf, `node` included */
+static size_t __rb_black_height(const struct rb_node *node)
+{
+    size_t h = 0;
+
+    for (; node; node = node->rb_left)
+        h += rb_is_black(node);
+    return h;
+}
+
+/* Count of black nodes from `node` up to the root, `node` included */
+static size_t __rb_black_depth(const struct rb_node *node)
+{
+    size_t h = 0;
+
+    for (; node; node = rb_parent(node))
+        h += rb_is_black(node);
+    return h;
+}
+
+/* `hl` and `hr` are the black heights of `left` and `right`, return the one of the result.
+   `node` is linked red on the spine of the taller tree, where the black height matches the
+   shorter one, and the insert fix-up only rotates along that spine: the shorter tree stays
+   a child of `node`, so the black nodes above it give the new black height */
+static size_t __rb_join(struct rb_root *left, size_t hl, struct rb_node *node, struct rb_root *right, size_t hr, const struct rb_augment_callbacks *augment)
+{
+    struct rb_node *l = left->rb_node, *r = right->rb_node;
+    struct rb_node *x, *parent = NULL;
+    size_t h;
+
+    if (l && rb_is_red(l)) {
+        rb_set_black(l);
+        hl++;
+    }
+    if (r && rb_is_red(r)) {
+        rb_set_black(r);
+        hr++;
+    }
+    right->rb_node = NULL;
+
+    if (hl == hr) {
+        node->rb_parent_color = RB_BLACK;
+        node->rb_left = l;
+        node->rb_right = r;
+        if (l)
+            rb_set_parent(l, node);
+        if (r)
+            rb_set_parent(r, node);
+        left->rb_node = node;
+
+        if (augment)
+            augment->propagate(node, NULL);
+        return hl + 1;
+    }
+
+    if (hl > hr) {
+        for (x = l, h = hl; x && (rb_is_red(x) || h > hr); x = x->rb_right) {
+            h -= rb_is_black(x);
+            parent = x;
+        }
+        node->rb_left = x;
+        node->rb_right = r;
+        parent->rb_right = node;
+    } else {
+        for (x = r, h = hr; x && (rb_is_red(x) || h > hl); x = x->rb_left) {
+            h -= rb_is_black(x);
+            parent = x;
+        }
+        node->rb_left = l;
+        node->rb_right = x;
+        parent->rb_left = node;
+        left->rb_node = r;
+    }
+
+    node->rb_parent_color = (unsigned long)parent; /* Red */
+    if (node->rb_left)
+        rb_set_parent(node->rb_left, node);
+    if (node->rb_right)
+        rb_set_parent(node->rb_right, node);
+
+    if (augment)
+        augment->propagate(node, NULL);
+    __rb_insert_color(node, left, augment);
+    return (hl > hr ? hr : hl) + __rb_black_depth(node);
+}
+
+void rb_join(struct rb_root *left, struct rb_node *node, struct rb_root *right, const struct rb_augment_callbacks *augment)
+{
+    __rb_join(left, __rb_black_height(left->rb_node), node, right, __rb_black_height(right->rb_node), augment);
+}
+
+void rb_concat(struct rb_root *left, struct rb_root *right, const struct rb_augment_callbacks *augment)
+{
+    struct rb_node *node = rb_last(left);
+
+    if (!node) {
+        *left = *right;
+        right->rb_node = NULL;
+        return;
+    }
+
+    if (!right->rb_node)
+        return;
+
+    __rb_erase(node, left, augment);
+    rb_join(left, node, right, augment);
+}
+
+/* Climb from `node` to the root, the other subtree of each ancestor is joined with the
+   ancestor onto the side it belongs to. Black heights are carried along the climb, so
+   the joins add up to O(log n) */
+void rb_split(struct rb_root *root, struct rb_node *node, struct rb_root *right, const struct rb_augment_callbacks *augment)
+{
+    struct rb_root l = RB_ROOT, r = RB_ROOT, t = RB_ROOT;
+    struct rb_node *x = node, *parent = rb_parent(node), *next, *sibling;
+    size_t h = __rb_black_height(node);             /* Of the subtree of `x` */
+    size_t hl = h - rb_is_black(node), hr = hl;
+    size_t hp;
+    int is_left;
+
+    if ((l.rb_node = node->rb_left))
+        rb_set_parent(l.rb_node, NULL);
+    if ((r.rb_node = node->rb_right))
+        rb_set_parent(r.rb_node, NULL);
+
+    hr = __rb_join(&t, 0, node, &r, hr, augment);
+    r = t;
+
+    for (; parent; x = parent, parent = next) {
+        next = rb_parent(parent);
+        is_left = parent->rb_left == x;
+        sibling = is_left ? parent->rb_right : parent->rb_left;
+        hp = h + rb_is_black(parent);
+
+        if ((t.rb_node = sibling))
+            rb_set_parent(sibling, NULL);
+
+        if (is_left) {
+            hr = __rb_join(&r, hr, parent, &t, h, augment);
+        } else {
+            hl = __rb_join(&t, h, parent, &l, hl, augment);
+            l = t;
+        }
+        h = hp;
+    }
+
+    /* A side no ancestor was joined onto may still have the red root of a subtree */
+    if (l.rb_node)
+        rb_set_black(l.rb_node);
+    if (r.rb_node)
+        rb_set_black(r.rb_node);
+
+    *root = l;
+    *right = r;
+}
+
+static inline unsigned long __rb_size_compute(struct rb_node *node)
+{
+    return 1 + rb_size_of(node->rb_left) + rb_size_of(node->rb_right);
+}
+
+static void __rb_size_propagate(struct rb_node *node, struct rb_node *stop)
+{
+    for (; node != stop; node = rb_parent(node))
+        rb_size(node) = __rb_size_compute(node);
+}
+
+static void __rb_size_copy(struct rb_node *old, struct rb_node *new)
+{
+    rb_size(new) = rb_size(old);
+}
+
+static void __rb_size_rotate(struct rb_node *old, struct rb_node *new)
+{
+    rb_size(new) = rb_size(old);
+    rb_size(old) = __rb_size_compute(old);
+}
+
+const struct rb_augment_callbacks rb_size_augment = {
+    .propagate = __rb_size_propagate,
+    .copy      = __rb_size_copy,
+    .rotate    = __rb_size_rotate,
+};
+
+struct rb_node *rb_select(const struct rb_root *root, unsigned long k)
+{
+    struct rb_node *n = root->rb_node;
+
+    while (n) {
+        unsigned long left = rb_size_of(n->rb_left);
+
+        if (k < left) {
+            n = n->rb_left;
+        } else if (k == left) {
+            return n;
+        } else {
+            k -= left + 1;
+            n = n->rb_right;
+        }
+    }
+    return NULL;
+}
+
+unsigned long rb_rank(const struct rb_node *node)
+{
+    unsigned long rank = rb_size_of(node->rb_left);
+    struct rb_node *parent;
+
+    for (; (parent = rb_parent(node)); node = parent) {
+        if (node == parent->rb_right)
+            rank += rb_size_of(parent->rb_left) + 1;
+    }
+    return rank;
+}
+
+void rb_size_build(struct rb_root *root)
+{
+    struct rb_node *n;
+
+    for (n = rb_first_postorder(root); n; n = rb_next_postorder(n))
+        rb_size(n) = __rb_size_compute(n);
+}
@@ -22,6 +22,7 @@
 #include <time.h>
 #include <stdlib.h>
 #include <sys/time.h>
+#include <malloc.h>
 #include <iterator/iterator.h>
 #include <hashmap/hashmap.h>
 #include <list/list.h>
@@ -31,8 +32,36 @@
 #include <multimap/multimap.h>
 #include <set/set.h>
 #include <multiset/multiset.h>
+#include <skiplist/skiplist.h>
+#include <sindex/sindex.h>
 #include <operations/ds_ops_string.h>
 
+#ifdef MAP_BTREE /* Run the map tests on the B+tree backend */
+#include <btree/btree.h>
+#define map_t                    btree_t
+#undef  cmap
+#define cmap                     cbtree_map
+#undef  MAP_INIT
+#define MAP_INIT(_ptr)           BTREE_MAP_INIT(_ptr)
+#undef  MAP_INIT_OPS
+#define MAP_INIT_OPS(_ptr, _ops) BTREE_MAP_INIT_OPS(_ptr, _ops)
+#undef  MAP_DEINIT
+#define MAP_DEINIT(_ptr)         BTREE_DEINIT(_ptr)
+#endif /* MAP_BTREE */
+
+#ifdef MAP_ART /* Run the map tests on the adaptive radix tree, string keys in byte order */
+#include <art/art.h>
+#define map_t                    art_t
+#undef  cmap
+#define cmap                     cart
+#undef  MAP_INIT
+#define MAP_INIT(_ptr)           ART_INIT(_ptr)
+#undef  MAP_INIT_OPS
+#define MAP_INIT_OPS(_ptr, _ops) ART_INIT_STRING(_ptr, _ops)
+#undef  MAP_DEINIT
+#define MAP_DEINIT(_ptr)         ART_DEINIT(_ptr)
+#endif /* MAP_ART */
+
 #define GET_DURATION(_data, _time) do { gettimeofday(&time_begin, NULL); _data gettimeofday(&time_end, NULL); \
                                         _time += time_end.tv_usec - time_begin.tv_usec + 1000000 * (time_end.tv_sec - time_begin.tv_sec); } while (0)
 
@@ -44,6 +73,8 @@
 //#define TEST_LIST           1
 //#define TEST_VECTOR         1
 //#define TEST_PQUEUE         1
+//#define TEST_SKIPLIST       1
+//#define TEST_SINDEX         1
 
 #ifndef TIMES_INSERT
 #define TIMES_INSERT   10000000
@@ -52,6 +83,9 @@
 #ifndef TIMES_FIND
 #define TIMES_FIND     100000000
 #endif /* TIMES_FIND */
+#ifndef TIMES_FIND_BATCH
+#define TIMES_FIND_BATCH 1024
+#endif /* TIMES_FIND_BATCH */
 #ifndef TIMES_FIND_V_L
 #define TIMES_FIND_V_L 100
 #endif /* TIMES_FIND_V_L */
@@ -63,10 +97,25 @@
 #define TIMES_REMOVE_V_L 100
 #endif /* TIMES_REMOVE_V_L */
 
+#ifdef TEST_HASHMAP
+/* Bytes currently allocated from the heap, `mallinfo2` appeared in glibc 2.33 */
+static size_t heap_used(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 mi = mallinfo2();
+    return mi.uordblks + mi.hblkhd;
+#else
+    struct mallinfo mi = mallinfo();
+    return (size_t)(unsigned int)mi.uordblks + (size_t)(unsigned int)mi.hblkhd;
+#endif
+}
+#endif /* TEST_HASHMAP */
+
 #ifndef HASHMAP_CAPACITY_INIT
 #define HASHMAP_CAPACITY_INIT 2 * TIMES_INSERT
 #endif /* HASHMAP_CAPACITY_INIT */
 
+#if !defined(TEST_SKIPLIST) && !defined(TEST_SINDEX)
 static void test_i_for(void)
 {
     struct timeval time_begin, time_end;
@@ -80,7 +129,12 @@ static void test_i_for(void)
     clock_t time_vector_s = 0;
     clock_t time_pqueue   = 0;
 
-#ifdef TEST_HASHMAP
+#if defined(TEST_HASHMAP) && defined(HASHMAP_COMPACT)
+    size_t           heap_hashmap  = heap_used();
+    hashmap_t        ds_hashmap_i  = HASHMAP_INIT_COMPACT(&ds_hashmap_i);
+    printf("Hashmap compact\n");
+#elif TEST_HASHMAP
+    size_t           heap_hashmap  = heap_used();
     hashmap_t        ds_hashmap_i  = HASHMAP_INIT_3(&ds_hashmap_i, HASHMAP_CAPACITY_INIT, 0, 0.0);
     printf("Hashmap reserve: %d\n", HASHMAP_CAPACITY_INIT);
 #elif TEST_MAP
@@ -115,6 +169,7 @@ static void test_i_for(void)
 
 #ifdef TEST_HASHMAP
         GET_DURATION(for (int i = 0; i < TIMES_INSERT; ++i) { chashmap->insert(&ds_hashmap_i, i, i);   }, time_hashmap);
+        heap_hashmap = heap_used() - heap_hashmap;
 #elif TEST_MAP
         GET_DURATION(for (int i = 0; i < TIMES_INSERT; ++i) { cmap->insert(&ds_map_i, i, i);           }, time_map);
 #elif TEST_SET
@@ -142,6 +197,10 @@ static void test_i_for(void)
                 time_list     / 1000,
                 time_vector   / 1000,
                 time_pqueue   / 1000);
+#ifdef TEST_HASHMAP
+        printf("Memory  [ hashmap ] = [ %zu bytes | %.1f bytes/entry ]\n",
+                heap_hashmap, chashmap->size(&ds_hashmap_i) > 0 ? (double)heap_hashmap / chashmap->size(&ds_hashmap_i) : 0.0);
+#endif
     }
 
     if (1) // if (0)
@@ -356,7 +415,12 @@ static void test_i_rand(void)
     clock_t time_vector_s = 0;
     clock_t time_pqueue   = 0;
 
-#ifdef TEST_HASHMAP
+#if defined(TEST_HASHMAP) && defined(HASHMAP_COMPACT)
+    size_t           heap_hashmap  = heap_used();
+    hashmap_t        ds_hashmap_i  = HASHMAP_INIT_COMPACT(&ds_hashmap_i);
+    printf("Hashmap compact\n");
+#elif TEST_HASHMAP
+    size_t           heap_hashmap  = heap_used();
     hashmap_t        ds_hashmap_i  = HASHMAP_INIT_3(&ds_hashmap_i, HASHMAP_CAPACITY_INIT, 0, 0.0);
     printf("Hashmap reserve: %d\n", HASHMAP_CAPACITY_INIT);
 #elif TEST_MAP
@@ -394,6 +458,7 @@ static void test_i_rand(void)
         GET_DURATION(for (int i = 0; i < TIMES_INSERT; ++i) { 
             chashmap->insert(&ds_hashmap_i, rand() % TIMES_FIND, i);   
         }, time_hashmap);
+        heap_hashmap = heap_used() - heap_hashmap;
 #elif TEST_MAP
         GET_DURATION(for (int i = 0; i < TIMES_INSERT; ++i) { 
             cmap->insert(&ds_map_i, rand() % TIMES_FIND, i);           
@@ -435,6 +500,10 @@ static void test_i_rand(void)
                 time_list     / 1000,
                 time_vector   / 1000,
                 time_pqueue   / 1000);
+#ifdef TEST_HASHMAP
+        printf("Memory  [ hashmap ] = [ %zu bytes | %.1f bytes/entry ]\n",
+                heap_hashmap, chashmap->size(&ds_hashmap_i) > 0 ? (double)heap_hashmap / chashmap->size(&ds_hashmap_i) : 0.0);
+#endif
     }
 
     if (1) // if (0)
@@ -517,6 +586,32 @@ static void test_i_rand(void)
                 time_vector   / 1000,
                 time_vector_s / 1000,
                 times_succ, ds_size);
+
+#if (defined(TEST_MAP) && !defined(MAP_BTREE) && !defined(MAP_ART)) || defined(TEST_SET)
+        {
+            ds_key_t keys[TIMES_FIND_BATCH];
+            void* out[TIMES_FIND_BATCH];
+            clock_t time_batch = 0;
+
+            times_succ = 0;
+            GET_DURATION(for (int i = 0; i < TIMES_FIND; i += TIMES_FIND_BATCH) { 
+                for (int j = 0; j < TIMES_FIND_BATCH; ++j)
+                    keys[j] = rand() % TIMES_FIND;
+#ifdef TEST_MAP
+                times_succ += cmap->find_batch(&ds_map_i, keys, TIMES_FIND_BATCH, (map_iterator_t**)out); 
+#else
+                times_succ += cset->find_batch(&ds_set_i, keys, TIMES_FIND_BATCH, (set_iterator_t**)out); 
+#endif /* TEST_MAP */
+            }, time_batch);
+
+            printf("Find    [ %.0f*10^%d times    ] [ find_batch(%d) ] \t= [ %ld ] ms\n\tsucc [ %zu ]\n", 
+                    TIMES_FIND / pow(10, (int)log10(TIMES_FIND)),
+                    (int)log10(TIMES_FIND),
+                    TIMES_FIND_BATCH,
+                    time_batch / 1000,
+                    times_succ);
+        }
+#endif /* TEST_MAP || TEST_SET */
     }
 
     if (1) // if (0)
@@ -667,6 +762,7 @@ static void test_s_rand(void)
         .__hash      = __ds_ops_hash_default_string,
         .valid_key   = ds_ops_valid_key_default_string_max_128,
         .__lt        = __ds_ops_lt_default_string,
+        .__cmp       = __ds_ops_cmp_default_string,
         .copy_key    = ds_ops_copy_data_default_string,
         .free_key    = ds_ops_free_data_default_string,
     };
@@ -674,6 +770,7 @@ static void test_s_rand(void)
     class_map_ops_t tops_map = {
         .valid_key   = ds_ops_valid_key_default_string_max_128,
         .__lt        = __ds_ops_lt_default_string,
+        .__cmp       = __ds_ops_cmp_default_string,
         .copy_key    = ds_ops_copy_data_default_string,
         .free_key    = ds_ops_free_data_default_string,
     };
@@ -681,6 +778,7 @@ static void test_s_rand(void)
     class_set_ops_t tops_set = {
         .valid_value = ds_ops_valid_key_default_string_max_128,
         .__lt_value  = __ds_ops_lt_default_string,
+        .__cmp_value = __ds_ops_cmp_default_string,
         .copy_value  = ds_ops_copy_data_default_string,
         .free_value  = ds_ops_free_data_default_string,
     };
@@ -688,6 +786,7 @@ static void test_s_rand(void)
     class_multimap_ops_t tops_multimap = {
         .valid_key   = ds_ops_valid_key_default_string_max_128,
         .__lt        = __ds_ops_lt_default_string,
+        .__cmp       = __ds_ops_cmp_default_string,
         .copy_key    = ds_ops_copy_data_default_string,
         .free_key    = ds_ops_free_data_default_string,
     };
@@ -695,6 +794,7 @@ static void test_s_rand(void)
     class_multiset_ops_t tops_multiset = {
         .valid_value = ds_ops_valid_data_default_string,
         .__lt_value  = __ds_ops_lt_default_string,
+        .__cmp_value = __ds_ops_cmp_default_string,
         .copy_value  = ds_ops_copy_data_default_string,
         .free_value  = ds_ops_free_data_default_string,
     };
@@ -1030,12 +1130,182 @@ static void test_s_rand(void)
     }
 }
 
+#endif /* !TEST_SKIPLIST && !TEST_SINDEX */
+
+#ifdef TEST_SKIPLIST
+#ifndef THREADS_MT
+#define THREADS_MT 8
+#endif /* THREADS_MT */
+
+#ifndef KEYS_MT
+#define KEYS_MT    1000000
+#endif /* KEYS_MT */
+
+typedef struct mt_arg {
+    unsigned int seed;
+    int times;
+    size_t succ;
+} mt_arg_t;
+
+static skiplist_t      ds_skiplist_mt;
+static map_t           ds_map_mt;
+static pthread_mutex_t ds_map_mt_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Half finds, a quarter inserts and a quarter removes on random keys */
+static void* test_mt_skiplist(void* arg)
+{
+    mt_arg_t* a = (mt_arg_t*)arg;
+    int key;
+    int op;
+
+    for (int i = 0; i < a->times; ++i) {
+        key = rand_r(&a->seed) % KEYS_MT;
+        op  = rand_r(&a->seed) % 4;
+        if (op < 2)
+            a->succ += cskiplist->find(&ds_skiplist_mt, key, NULL);
+        else if (op == 2)
+            a->succ += cskiplist->insert(&ds_skiplist_mt, key, key);
+        else
+            a->succ += cskiplist->remove(&ds_skiplist_mt, key);
+    }
+    return NULL;
+}
+
+static void* test_mt_map(void* arg)
+{
+    mt_arg_t* a = (mt_arg_t*)arg;
+    void* it;
+    int key;
+    int op;
+
+    for (int i = 0; i < a->times; ++i) {
+        key = rand_r(&a->seed) % KEYS_MT;
+        op  = rand_r(&a->seed) % 4;
+        pthread_mutex_lock(&ds_map_mt_lock);
+        if (op < 2) {
+            it = cmap->find(&ds_map_mt, key);
+            if (it && iterator_end() != it) a->succ++;
+        } else if (op == 2) {
+            if (cmap->insert(&ds_map_mt, key, key)) a->succ++;
+        } else {
+            a->succ += cmap->remove(&ds_map_mt, key);
+        }
+        pthread_mutex_unlock(&ds_map_mt_lock);
+    }
+    return NULL;
+}
+
+static void test_mt(void)
+{
+    struct timeval time_begin, time_end;
+    clock_t time_skiplist;
+    clock_t time_map;
+    pthread_t threads[THREADS_MT];
+    mt_arg_t args[THREADS_MT];
+    size_t succ_skiplist;
+    size_t succ_map;
+    int key;
+
+    ds_skiplist_mt = SKIPLIST_INIT(&ds_skiplist_mt);
+    ds_map_mt      = MAP_INIT(&ds_map_mt);
+
+    for (int i = 0; i < KEYS_MT / 2; ++i) {
+        key = rand() % KEYS_MT;
+        cskiplist->insert(&ds_skiplist_mt, key, key);
+        cmap->insert(&ds_map_mt, key, key);
+    }
+
+    for (int n = 1; n <= THREADS_MT; n *= 2) {
+        time_skiplist = 0;
+        time_map      = 0;
+        succ_skiplist = 0;
+        succ_map      = 0;
+
+        for (int i = 0; i < n; ++i)
+            args[i] = (mt_arg_t){ .seed = i + 1, .times = TIMES_INSERT / n, .succ = 0 };
+        GET_DURATION({ for (int i = 0; i < n; ++i) pthread_create(&threads[i], NULL, test_mt_skiplist, &args[i]);
+                       for (int i = 0; i < n; ++i) pthread_join(threads[i], NULL); }, time_skiplist);
+        for (int i = 0; i < n; ++i)
+            succ_skiplist += args[i].succ;
+
+        for (int i = 0; i < n; ++i)
+            args[i] = (mt_arg_t){ .seed = i + 1, .times = TIMES_INSERT / n, .succ = 0 };
+        GET_DURATION({ for (int i = 0; i < n; ++i) pthread_create(&threads[i], NULL, test_mt_map, &args[i]);
+                       for (int i = 0; i < n; ++i) pthread_join(threads[i], NULL); }, time_map);
+        for (int i = 0; i < n; ++i)
+            succ_map += args[i].succ;
+
+        printf("MT      [ %.0f*10^%d times, %d threads ] [ skiplist | map + mutex ] \t= [ %ld | %ld ] ms\n\tsucc [ %zu | %zu ], ds_size [ %zd | %zd ]\n", 
+                TIMES_INSERT / pow(10, (int)log10(TIMES_INSERT)),
+                (int)log10(TIMES_INSERT),
+                n,
+                time_skiplist / 1000,
+                time_map      / 1000,
+                succ_skiplist, succ_map,
+                cskiplist->size(&ds_skiplist_mt), cmap->size(&ds_map_mt));
+    }
+
+    SKIPLIST_DEINIT(&ds_skiplist_mt);
+    MAP_DEINIT(&ds_map_mt);
+}
+#endif /* TEST_SKIPLIST */
+
+#ifdef TEST_SINDEX
+/* Lookups of random keys, about half of them present, in a set built once */
+static void test_sindex(void)
+{
+    struct timeval time_begin, time_end;
+    clock_t time_set       = 0;
+    clock_t time_eytzinger = 0;
+    clock_t time_stree     = 0;
+    size_t succ_set        = 0;
+    size_t succ_eytzinger  = 0;
+    size_t succ_stree      = 0;
+    set_t    ds_set        = SET_INIT(&ds_set);
+    sindex_t ds_eytzinger  = SINDEX_INIT(&ds_eytzinger);
+    sindex_t ds_stree      = SINDEX_INIT_STREE(&ds_stree);
+    set_iterator_t* it;
+
+    for (int i = 0; i < TIMES_INSERT; ++i)
+        cset->insert(&ds_set, rand() % (TIMES_INSERT * 2));
+
+    csindex->build_set(&ds_eytzinger, &ds_set);
+    csindex->build_set(&ds_stree, &ds_set);
+
+    srand(1);
+    GET_DURATION(for (int i = 0; i < TIMES_FIND; ++i) { it = cset->find(&ds_set, rand() % (TIMES_INSERT * 2)); succ_set += cset->end(&ds_set) != it; }, time_set);
+    srand(1);
+    GET_DURATION(for (int i = 0; i < TIMES_FIND; ++i) { succ_eytzinger += csindex->contains(&ds_eytzinger, rand() % (TIMES_INSERT * 2)); }, time_eytzinger);
+    srand(1);
+    GET_DURATION(for (int i = 0; i < TIMES_FIND; ++i) { succ_stree += csindex->contains(&ds_stree, rand() % (TIMES_INSERT * 2)); }, time_stree);
+
+    printf("SIndex  [ %.0f*10^%d times    ] [ set | eytzinger | s-tree ] \t= [ %ld | %ld | %ld ] ms\n\tsucc [ %zu | %zu | %zu ], ds_size [ %zd ]\n", 
+            TIMES_FIND / pow(10, (int)log10(TIMES_FIND)),
+            (int)log10(TIMES_FIND),
+            time_set       / 1000,
+            time_eytzinger / 1000,
+            time_stree     / 1000,
+            succ_set, succ_eytzinger, succ_stree,
+            csindex->size(&ds_eytzinger));
+
+    SET_DEINIT(&ds_set);
+    SINDEX_DEINIT(&ds_eytzinger);
+    SINDEX_DEINIT(&ds_stree);
+}
+#endif /* TEST_SINDEX */
+
 int main(int argc, char** argv)
 {
+#ifdef TEST_SKIPLIST
+    test_mt();
+#elif defined(TEST_SINDEX)
+    test_sindex();
+#else
     test_i_for();
     sleep(1);
     test_i_rand();
     sleep(1);
     test_s_rand();
+#endif /* TEST_SKIPLIST, TEST_SINDEX */
     return 0;
 }
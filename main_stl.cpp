@@ -51,6 +51,7 @@ typedef ssize_t  ds_size_t;
 //#define TEST_LIST           1
 //#define TEST_VECTOR         1
 //#define TEST_PQUEUE         1
+//#define TEST_SINDEX         1
 
 #ifndef TIMES_INSERT
 #define TIMES_INSERT   10000000
@@ -74,6 +75,7 @@ typedef ssize_t  ds_size_t;
 #define HASHMAP_CAPACITY_INIT 2 * TIMES_INSERT
 #endif /* HASHMAP_CAPACITY_INIT */
 
+#ifndef TEST_SINDEX
 static void test_i_for(void)
 {
     struct timeval time_begin, time_end;
@@ -997,13 +999,52 @@ static void test_s_rand(void)
                 removed);
     }
 }
+#endif /* TEST_SINDEX */
+
+#ifdef TEST_SINDEX
+/* The lookups of `test_sindex` in main.c, on std::set and a sorted std::vector */
+static void test_sindex(void)
+{
+    struct timeval time_begin, time_end;
+    clock_t time_set    = 0;
+    clock_t time_vector = 0;
+    size_t succ_set     = 0;
+    size_t succ_vector  = 0;
+    set<ds_data_t> stl_set;
+    vector<ds_data_t> stl_vector;
+    vector<ds_data_t>::iterator it;
+    ds_data_t key;
+
+    for (int i = 0; i < TIMES_INSERT; ++i)
+        stl_set.insert(rand() % (TIMES_INSERT * 2));
+
+    stl_vector.assign(stl_set.begin(), stl_set.end());
+
+    srand(1);
+    GET_DURATION(for (int i = 0; i < TIMES_FIND; ++i) { succ_set += stl_set.end() != stl_set.find(rand() % (TIMES_INSERT * 2)); }, time_set);
+    srand(1);
+    GET_DURATION(for (int i = 0; i < TIMES_FIND; ++i) { key = rand() % (TIMES_INSERT * 2); it = lower_bound(stl_vector.begin(), stl_vector.end(), key); succ_vector += stl_vector.end() != it && *it == key; }, time_vector);
+
+    printf("SIndex  [ %.0f*10^%d times    ] [ set | vector(lower_bound) ] \t= [ %ld | %ld ] ms\n\tsucc [ %zu | %zu ], ds_size [ %zu ]\n", 
+            TIMES_FIND / pow(10, (int)log10(TIMES_FIND)),
+            (int)log10(TIMES_FIND),
+            time_set    / 1000,
+            time_vector / 1000,
+            succ_set, succ_vector,
+            stl_vector.size());
+}
+#endif /* TEST_SINDEX */
 
 int main(int argc, char** argv)
 {
+#ifdef TEST_SINDEX
+    test_sindex();
+#else
     test_i_for();
     sleep(1);
     test_i_rand();
     sleep(1);
     test_s_rand();
+#endif /* TEST_SINDEX */
     return 0;
 }
@@ -19,15 +19,51 @@
 
 #include <map/map.h>
 
+#include <_block.h>
+#include <_handle.h>
+#include <_finger.h>
+#include <_thread.h>
 #include <_memory.h>
+#include <sort/sort.h>
 #include <linux/rbtree.h>
 #include <linux/_compiler.h>
 #include <iterator/iterator.h>
 
 #define map_entry(ptr) rb_entry((ptr), struct map_node, node)
+#define map_os(_this)  ((_this)->config.c.b_order_stat)
+#define map_thread(_this) ((_this)->config.c.b_thread)
+
+#define MAP_BATCH_GROUP 16 /* Descents in flight in `find_batch` */
 
 static /* __always_inline */ inline map_node_t* map_find(const map_t* _this, map_key_t key);
 static /* __always_inline */ inline map_node_t* __map_end(const map_t* _this);
+static /* __always_inline */ inline map_node_t* __map_rend(const map_t* _this);
+static /* __always_inline */ inline bool __map_lt(const map_t* _this, map_key_t left, map_key_t right);
+static bool __map_node_fill(map_t* _this, map_node_t* t, map_key_t key, map_value_t value);
+static /* __always_inline */ inline void __map_node_free(map_t* _this, map_node_t* node);
+
+static /* __always_inline */ inline size_t __map_node_bytes(const map_t* _this)
+{
+    return sizeof(map_node_t) + (map_os(_this) ? RB_SIZE_EXTRA : 0) + (map_thread(_this) ? DS_THREAD_EXTRA : 0);
+}
+
+/* From the `rb_node` to its thread, past the size word */
+static /* __always_inline */ inline size_t __map_thread_off(const map_t* _this)
+{
+    return sizeof(struct rb_node) + (map_os(_this) ? RB_SIZE_EXTRA : 0);
+}
+
+static /* __always_inline */ inline struct rb_node* __map_succ(const map_t* _this, const struct rb_node* n)
+{
+    return map_thread(_this) ? ds_thread_of(n, __map_thread_off(_this))->next : rb_next(n);
+}
+
+static /* __always_inline */ inline struct rb_node* __map_pred(const map_t* _this, const struct rb_node* n)
+{
+    return map_thread(_this) ? ds_thread_of(n, __map_thread_off(_this))->prev : rb_prev(n);
+}
+
+#include <../map/map_small.c>
 
 static /* __always_inline */ inline map_size_t __map_size(const map_t* _this)
 {
@@ -49,13 +85,13 @@ static /* __always_inline */ inline map_count_t map_count(const map_t* _this, ma
 
 static /* __always_inline */ inline map_node_t* __map_first(const map_t* _this)
 {
-    struct rb_node* t = rb_first(&_this->root);
+    struct rb_node* t = map_thread(_this) ? _this->leftmost : rb_first(&_this->root);
     return is_null(t) ? NULL : map_entry(t);
 }
 
 static /* __always_inline */ inline map_node_t* __map_last(const map_t* _this)
 {
-    struct rb_node* t = rb_last(&_this->root);
+    struct rb_node* t = map_thread(_this) ? _this->rightmost : rb_last(&_this->root);
     return is_null(t) ? NULL : map_entry(t);
 }
 
@@ -66,7 +102,12 @@ static /* __always_inline */ inline map_node_t* __map_end(const map_t* _this)
 
 static /* __always_inline */ inline map_node_t* __map_begin(const map_t* _this)
 {
-    map_node_t* t = __map_first(_this);
+    map_node_t* t = NULL;
+
+    if (__map_small(_this))
+        return __map_small_begin(_this);
+
+    t = __map_first(_this);
     return is_null(t) ? __map_end(_this) : t;
 }
 
@@ -81,6 +122,9 @@ static /* __always_inline */ inline map_node_t* __map_next(const map_t* _this, c
 {
     struct rb_node* t = NULL;
 
+    if (__map_small(_this))
+        return __map_small_next(_this, node);
+
     if (RB_EMPTY_ROOT(&_this->root) || __map_end(_this) == node)
         return __map_end(_this);
 
@@ -92,7 +136,7 @@ static /* __always_inline */ inline map_node_t* __map_next(const map_t* _this, c
     if (unlikely(RB_EMPTY_NODE(&node->node)))
         return NULL;
 
-    t = rb_next(&node->node);
+    t = __map_succ(_this, &node->node);
     return is_null(t) ? __map_end(_this) : map_entry(t);
 }
 
@@ -107,6 +151,9 @@ static /* __always_inline */ inline map_node_t* __map_prev(const map_t* _this, c
 {
     struct rb_node* t = NULL;
 
+    if (__map_small(_this))
+        return __map_small_prev(_this, node);
+
     if (RB_EMPTY_ROOT(&_this->root))
         return __map_end(_this);
 
@@ -119,7 +166,7 @@ static /* __always_inline */ inline map_node_t* __map_prev(const map_t* _this, c
     if (unlikely(RB_EMPTY_NODE(&node->node)))
         return NULL;
 
-    t = rb_prev(&node->node);
+    t = __map_pred(_this, &node->node);
     return is_null(t) ? __map_end(_this) : map_entry(t);
 }
 
@@ -137,7 +184,12 @@ static /* __always_inline */ inline map_node_t* __map_rend(const map_t* _this)
 
 static /* __always_inline */ inline map_node_t* __map_rbegin(const map_t* _this)
 {
-    map_node_t* t = __map_last(_this);
+    map_node_t* t = NULL;
+
+    if (__map_small(_this))
+        return __map_small_rbegin(_this);
+
+    t = __map_last(_this);
     return is_null(t) ? __map_rend(_this) : t;
 }
 
@@ -152,6 +204,9 @@ static /* __always_inline */ inline map_node_t* __map_rnext(const map_t* _this,
 {
     struct rb_node* t = NULL;
 
+    if (__map_small(_this))
+        return __map_small_rnext(_this, node);
+
     if (RB_EMPTY_ROOT(&_this->root) || __map_rend(_this) == node)
         return __map_rend(_this);
 
@@ -163,7 +218,7 @@ static /* __always_inline */ inline map_node_t* __map_rnext(const map_t* _this,
     if (unlikely(RB_EMPTY_NODE(&node->node)))
         return NULL;
 
-    t = rb_prev(&node->node);
+    t = __map_pred(_this, &node->node);
     return is_null(t) ? __map_rend(_this) : map_entry(t);
 }
 
@@ -178,6 +233,9 @@ static /* __always_inline */ inline map_node_t* __map_rprev(const map_t* _this,
 {
     struct rb_node* t = NULL;
 
+    if (__map_small(_this))
+        return __map_small_rprev(_this, node);
+
     if (RB_EMPTY_ROOT(&_this->root))
         return __map_rend(_this);
 
@@ -190,7 +248,7 @@ static /* __always_inline */ inline map_node_t* __map_rprev(const map_t* _this,
     if (unlikely(RB_EMPTY_NODE(&node->node)))
         return NULL;
 
-    t = rb_next(&node->node);
+    t = __map_succ(_this, &node->node);
     return is_null(t) ? __map_rend(_this) : map_entry(t);
 }
 
@@ -205,6 +263,7 @@ static map_node_t* __map_find(const map_t* _this, map_key_t key)
 {
     struct rb_node* n = _this->root.rb_node;
     map_node_t* t = NULL;
+    int cmp = 0;
 
     if (is_null(_this->ops) || is_null(_this->ops->__lt)) {
         while (!is_null(n)) {
@@ -217,6 +276,18 @@ static map_node_t* __map_find(const map_t* _this, map_key_t key)
             else
                 return t;
         }
+    } else if (!is_null(_this->ops->__cmp)) {
+        while (!is_null(n)) {
+            t = map_entry(n);
+            cmp = _this->ops->__cmp(key, t->key);
+
+            if (cmp < 0)
+                n = n->rb_left;
+            else if (cmp > 0)
+                n = n->rb_right;
+            else
+                return t;
+        }
     } else {
         while (!is_null(n)) {
             t = map_entry(n);
@@ -243,15 +314,155 @@ static /* __always_inline */ inline map_node_t* map_find(const map_t* _this, map
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
         return NULL;
 
-    t = __map_find(_this, key);
+    t = __map_small(_this) ? __map_small_find(_this, key) : __map_find(_this, key);
     return is_null(t) ? __map_end(_this) : t;
 }
 
+static /* __always_inline */ inline int __map_batch_cmp(const map_t* _this, map_key_t key, map_key_t other)
+{
+    if (is_null(_this->ops) || is_null(_this->ops->__lt))
+        return (key > other) - (key < other);
+    if (!is_null(_this->ops->__cmp))
+        return _this->ops->__cmp(key, other);
+    return _this->ops->__lt(key, other) ? -1 : _this->ops->__lt(other, key);
+}
+
+/* Hand the next lookup to a free slot, the lookups that need no descent are answered here */
+static /* __always_inline */ inline bool __map_batch_start(const map_t* _this, const map_key_t* keys, map_size_t n, map_node_t** out, map_size_t* next, struct rb_node** node, map_size_t* index)
+{
+    map_size_t i = 0;
+
+    while (*next < n) {
+        i = (*next)++;
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(keys[i])) {
+            out[i] = NULL;
+        } else if (is_null(_this->root.rb_node)) {
+            out[i] = __map_end(_this);
+        } else {
+            *node  = _this->root.rb_node;
+            *index = i;
+            return true;
+        }
+    }
+
+    *node = NULL;
+    return false;
+}
+
+/*
+  AMAC: every slot is one lookup stepped a level at a time, round robin. The child
+  of a step is prefetched and waited for while the other slots step, so up to
+  `MAP_BATCH_GROUP` cache misses overlap instead of one per level and lookup
+*/
+static map_size_t map_find_batch(const map_t* _this, const map_key_t* keys, map_size_t n, map_node_t** out)
+{
+    struct rb_node* node[MAP_BATCH_GROUP];
+    map_size_t index[MAP_BATCH_GROUP];
+    struct rb_node* c = NULL;
+    map_node_t* t = NULL;
+    map_size_t next = 0;
+    map_size_t found = 0;
+    int live = 0;
+    int cmp = 0;
+    int i = 0;
+
+    if (unlikely(is_null(_this) || is_null(keys) || is_null(out) || n < 0))
+        return -1;
+
+    if (__map_small(_this)) {
+        for (next = 0; next < n; ++next) {
+            out[next] = map_find(_this, keys[next]);
+            found += !is_null(out[next]) && __map_end(_this) != out[next];
+        }
+        return found;
+    }
+
+    for (i = 0; i < MAP_BATCH_GROUP; ++i)
+        live += __map_batch_start(_this, keys, n, out, &next, &node[i], &index[i]);
+
+    while (live > 0) {
+        for (i = 0; i < MAP_BATCH_GROUP; ++i) {
+            if (is_null(node[i]))
+                continue;
+
+            t = map_entry(node[i]);
+            cmp = __map_batch_cmp(_this, keys[index[i]], t->key);
+
+            if (0 == cmp) {
+                out[index[i]] = t;
+                ++found;
+            } else {
+                c = cmp < 0 ? node[i]->rb_left : node[i]->rb_right;
+
+                if (!is_null(c)) {
+                    __builtin_prefetch(&map_entry(c)->key);
+                    __builtin_prefetch(&c->rb_left);
+                    node[i] = c;
+                    continue;
+                }
+                out[index[i]] = __map_end(_this);
+            }
+
+            if (!__map_batch_start(_this, keys, n, out, &next, &node[i], &index[i]))
+                --live;
+        }
+    }
+
+    return found;
+}
+
+/* One walk for the keys in order, see `_finger.h`. Either `bitmap` or `out` is filled */
+static map_size_t __map_probe_sorted(const map_t* _this, const map_key_t* keys, map_size_t n, uint64_t* bitmap, map_node_t** out)
+{
+    ds_finger_t finger = DS_FINGER_INIT;
+    __comp lt = is_null(_this->ops) ? NULL : _this->ops->__lt;
+    struct rb_node* lb = NULL;
+    map_node_t* t = NULL;
+    map_size_t found = 0;
+    map_size_t i = 0;
+
+    for (i = 0; i < n; ++i) {
+        if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(keys[i])) {
+            t = NULL;
+        } else if (__map_small(_this)) {
+            t = __map_small_find(_this, keys[i]);
+            t = is_null(t) ? __map_end(_this) : t;
+        } else {
+            lb = ds_finger_lower_bound(&_this->root, &finger, keys[i], offsetof(map_node_t, node), lt);
+            t = !is_null(lb) && !__map_lt(_this, keys[i], map_entry(lb)->key) ? map_entry(lb) : __map_end(_this);
+        }
+
+        found += !is_null(t) && __map_end(_this) != t;
+        if (!is_null(bitmap))
+            ds_bitmap_put(bitmap, i, !is_null(t) && __map_end(_this) != t);
+        else
+            out[i] = t;
+    }
+
+    return found;
+}
+
+static map_size_t map_contains_sorted(const map_t* _this, const map_key_t* keys, map_size_t n, uint64_t* bitmap)
+{
+    if (unlikely(is_null(_this) || is_null(keys) || is_null(bitmap) || n < 0))
+        return -1;
+    return __map_probe_sorted(_this, keys, n, bitmap, NULL);
+}
+
+static map_size_t map_find_sorted(const map_t* _this, const map_key_t* keys, map_size_t n, map_node_t** out)
+{
+    if (unlikely(is_null(_this) || is_null(keys) || is_null(out) || n < 0))
+        return -1;
+    return __map_probe_sorted(_this, keys, n, NULL, out);
+}
+
 static map_node_t* __map_lower_bound(const map_t* _this, map_key_t key)
 {
     struct rb_node* n = _this->root.rb_node;
     map_node_t* t = NULL;
     map_node_t* ret = NULL;
+    int cmp = 0;
 
     if (is_null(_this->ops) || is_null(_this->ops->__lt)) {
         while (!is_null(n)) {
@@ -266,6 +477,20 @@ static map_node_t* __map_lower_bound(const map_t* _this, map_key_t key)
                 return t;
             }
         }
+    } else if (!is_null(_this->ops->__cmp)) {
+        while (!is_null(n)) {
+            t = map_entry(n);
+            cmp = _this->ops->__cmp(key, t->key);
+
+            if (cmp < 0) {
+                n = n->rb_left;
+                ret = t;
+            } else if (cmp > 0) {
+                n = n->rb_right;
+            } else {
+                return t;
+            }
+        }
     } else {
         while (!is_null(n)) {
             t = map_entry(n);
@@ -294,7 +519,7 @@ static /* __always_inline */ inline map_node_t* map_lower_bound(const map_t* _th
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
         return NULL;
 
-    t = __map_lower_bound(_this, key);
+    t = __map_small(_this) ? __map_small_at(_this, __map_small_bound(_this, key, false)) : __map_lower_bound(_this, key);
     return is_null(t) ? __map_end(_this) : t;
 }
 
@@ -303,6 +528,7 @@ static map_node_t* __map_upper_bound(const map_t* _this, map_key_t key)
     struct rb_node* n = _this->root.rb_node;
     map_node_t* t = NULL;
     map_node_t* ret = NULL;
+    int cmp = 0;
 
     if (is_null(_this->ops) || is_null(_this->ops->__lt)) {
         while (!is_null(n)) {
@@ -314,7 +540,22 @@ static map_node_t* __map_upper_bound(const map_t* _this, map_key_t key)
             } else if (key > t->key) {
                 n = n->rb_right;
             } else {
-                n = rb_next(n);
+                n = __map_succ(_this, n);
+                return is_null(n) ? NULL : map_entry(n);
+            }
+        }
+    } else if (!is_null(_this->ops->__cmp)) {
+        while (!is_null(n)) {
+            t = map_entry(n);
+            cmp = _this->ops->__cmp(key, t->key);
+
+            if (cmp < 0) {
+                n = n->rb_left;
+                ret = t;
+            } else if (cmp > 0) {
+                n = n->rb_right;
+            } else {
+                n = __map_succ(_this, n);
                 return is_null(n) ? NULL : map_entry(n);
             }
         }
@@ -328,7 +569,7 @@ static map_node_t* __map_upper_bound(const map_t* _this, map_key_t key)
             } else if (_this->ops->__lt(t->key, key)) {
                 n = n->rb_right;
             } else {
-                n = rb_next(n);
+                n = __map_succ(_this, n);
                 return is_null(n) ? NULL : map_entry(n);
             }
         }
@@ -347,15 +588,38 @@ static /* __always_inline */ inline map_node_t* map_upper_bound(const map_t* _th
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
         return NULL;
 
-    t = __map_upper_bound(_this, key);
+    t = __map_small(_this) ? __map_small_at(_this, __map_small_bound(_this, key, true)) : __map_upper_bound(_this, key);
     return is_null(t) ? __map_end(_this) : t;
 }
 
+/* `rightmost` moves to a node linked as its right child */
+static /* __always_inline */ inline map_node_t* __map_link(map_t* _this, map_node_t* node, struct rb_node* parent, struct rb_node** link)
+{
+    if (is_null(parent) || (parent == _this->rightmost && link == &parent->rb_right))
+        _this->rightmost = &node->node;
+
+    rb_link_node(&node->node, parent, link);
+    if (map_thread(_this))
+        ds_thread_link(&node->node, parent, link, __map_thread_off(_this), &_this->leftmost);
+
+    if (map_os(_this))
+        rb_insert_augmented(&node->node, &_this->root, &rb_size_augment);
+    else
+        rb_insert_color(&node->node, &_this->root);
+    _this->size++;
+    return node;
+}
+
 static map_node_t* __map_insert(map_t* _this, map_node_t* node)
 {
     struct rb_node** n = &_this->root.rb_node;
     struct rb_node* parent = NULL;
     map_node_t* t = NULL;
+    int cmp = 0;
+
+    /* Increasing keys are appended without a descent */
+    if (!is_null(_this->rightmost) && __map_lt(_this, map_entry(_this->rightmost)->key, node->key))
+        return __map_link(_this, node, _this->rightmost, &_this->rightmost->rb_right);
 
     if (is_null(_this->ops) || is_null(_this->ops->__lt)) {
         while (!is_null(*n)) {
@@ -369,6 +633,19 @@ static map_node_t* __map_insert(map_t* _this, map_node_t* node)
             else
                 return t;
         }
+    } else if (!is_null(_this->ops->__cmp)) {
+        while (!is_null(*n)) {
+            parent = *n;
+            t = map_entry(parent);
+            cmp = _this->ops->__cmp(node->key, t->key);
+
+            if (cmp < 0)
+                n = &parent->rb_left;
+            else if (cmp > 0)
+                n = &parent->rb_right;
+            else
+                return t;
+        }
     } else {
         while (!is_null(*n)) {
             parent = *n;
@@ -383,10 +660,7 @@ static map_node_t* __map_insert(map_t* _this, map_node_t* node)
         }
     }
 
-    rb_link_node(&node->node, parent, n);
-    rb_insert_color(&node->node, &_this->root);
-    _this->size++;
-    return node;
+    return __map_link(_this, node, parent, n);
 }
 
 static inline map_node_t* map_insert(map_t* _this, map_key_t key, map_value_t value)
@@ -403,7 +677,13 @@ static inline map_node_t* map_insert(map_t* _this, map_key_t key, map_value_t va
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
         return NULL;
 
-    t = (map_node_t*)p_calloc(1, sizeof(map_node_t));
+    if (__map_small_on(_this)) {
+        t = __map_small_insert(_this, key, value, true);
+        if (__map_small_on(_this))
+            return t;
+    }
+
+    t = (map_node_t*)p_calloc(1, __map_node_bytes(_this));
     if (unlikely(is_null(t)))
         return NULL;
 
@@ -437,6 +717,81 @@ err:
     return NULL;
 }
 
+/* Links `node` next to `hint` if it belongs there, else NULL. Return `hint` if equal */
+static map_node_t* __map_insert_hint(map_t* _this, map_node_t* node, map_node_t* hint)
+{
+    struct rb_node* h = &hint->node;
+    struct rb_node* n = NULL;
+
+    if (__map_lt(_this, node->key, hint->key)) {
+        n = __map_pred(_this, h);
+        if (!is_null(n) && !__map_lt(_this, map_entry(n)->key, node->key))
+            return NULL;
+        return is_null(h->rb_left) ? __map_link(_this, node, h, &h->rb_left) : __map_link(_this, node, n, &n->rb_right);
+    }
+
+    if (__map_lt(_this, hint->key, node->key)) {
+        n = __map_succ(_this, h);
+        if (!is_null(n) && !__map_lt(_this, node->key, map_entry(n)->key))
+            return NULL;
+        return is_null(h->rb_right) ? __map_link(_this, node, h, &h->rb_right) : __map_link(_this, node, n, &n->rb_left);
+    }
+
+    return hint;
+}
+
+/* `end`, or a `hint` out of place, falls back to `__map_insert`, which still appends in O(1) */
+static map_node_t* map_insert_hint(map_t* _this, map_node_t* hint, map_key_t key, map_value_t value)
+{
+    map_node_t* t = NULL;
+    map_node_t* ret = NULL;
+
+    if (unlikely(is_null(_this) || is_null(hint)))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return NULL;
+
+    if (__map_small_on(_this)) {
+        t = __map_small_insert(_this, key, value, true);
+        if (__map_small_on(_this))
+            return t;
+        hint = __map_end(_this); /* The entries just moved into the tree */
+    }
+
+    t = (map_node_t*)p_calloc(1, __map_node_bytes(_this));
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    if (!__map_node_fill(_this, t, key, value)) {
+        p_free(t);
+        return NULL;
+    }
+
+    if (__map_end(_this) != hint && __map_rend(_this) != hint)
+        ret = __map_insert_hint(_this, t, hint);
+
+    if (is_null(ret))
+        ret = __map_insert(_this, t);
+
+    if (t != ret)
+        goto err;
+    return t;
+
+err:
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&t->value);
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+        _this->ops->free_key(&t->key);
+
+    p_free(t);
+    return NULL;
+}
+
 static inline map_node_t* map_insert_replace(map_t* _this, map_key_t key, map_value_t value)
 {
     map_node_t* t = NULL;
@@ -470,7 +825,13 @@ static inline map_node_t* map_insert_replace(map_t* _this, map_key_t key, map_va
         return t;
     }
 
-    t = (map_node_t*)p_calloc(1, sizeof(map_node_t));
+    if (__map_small_on(_this)) {
+        t = __map_small_insert(_this, key, value, true);
+        if (__map_small_on(_this))
+            return t;
+    }
+
+    t = (map_node_t*)p_calloc(1, __map_node_bytes(_this));
     if (unlikely(is_null(t)))
         return NULL;
 
@@ -504,9 +865,24 @@ err:
     return NULL;
 }
 
+static /* __always_inline */ inline void __map_node_free(map_t* _this, map_node_t* node)
+{
+    if (is_null(_this->blocks) || !ds_block_put(&_this->blocks, node))
+        p_free(node);
+}
+
 static /* __always_inline */ inline map_node_t* __map_erase(map_t* _this, map_node_t* pos)
 {
-    rb_erase(&pos->node, &_this->root);
+    if (&pos->node == _this->rightmost)
+        _this->rightmost = __map_pred(_this, &pos->node);
+
+    if (map_thread(_this))
+        ds_thread_unlink(&pos->node, __map_thread_off(_this), &_this->leftmost);
+
+    if (map_os(_this))
+        rb_erase_augmented(&pos->node, &_this->root, &rb_size_augment);
+    else
+        rb_erase(&pos->node, &_this->root);
     _this->size--;
     return pos;
 }
@@ -523,6 +899,9 @@ static inline map_node_t* map_erase(map_t* _this, map_node_t* pos)
     if (__map_size(_this) <= 0 || __map_end(_this) == pos/* || __map_rend(_this) == pos*/)
         return NULL;
 
+    if (__map_small(_this))
+        return __map_small_erase(_this, pos);
+
     t = __map_next(_this, pos);
     if (is_null(t))
         return NULL;
@@ -535,9 +914,9 @@ static inline map_node_t* map_erase(map_t* _this, map_node_t* pos)
     if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
         _this->ops->free_value(&pos->value);
 
-    p_free(pos);
+    __map_node_free(_this, pos);
 
-    return t;
+    return __map_small_settle_at(_this, MAP_SMALL / 2, t);
 }
 
 static inline map_size_t map_remove(map_t* _this, map_key_t key)
@@ -554,6 +933,11 @@ static inline map_size_t map_remove(map_t* _this, map_key_t key)
     if (__map_end(_this) == t)
         return 0;
 
+    if (__map_small(_this)) {
+        __map_small_erase(_this, t);
+        return 1;
+    }
+
     __map_erase(_this, t);
 
     if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
@@ -562,8 +946,9 @@ static inline map_size_t map_remove(map_t* _this, map_key_t key)
     if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
         _this->ops->free_value(&t->value);
 
-    p_free(t);
+    __map_node_free(_this, t);
 
+    __map_small_settle(_this, MAP_SMALL / 2);
     return 1;
 }
 
@@ -588,25 +973,644 @@ static map_size_t map_remove_if(map_t* _this, remove_if_condition_kv cond)
     return ret;
 }
 
+/* Postorder, so nodes are freed without `rb_erase` keeping the tree balanced all along */
 static map_size_t map_clear(map_t* _this)
 {
     map_size_t ret = 0;
     map_node_t* t = NULL;
+    struct rb_node* n = NULL;
+    struct rb_node* next = NULL;
 
     if (unlikely(is_null(_this)))
         return -1;
 
-    for (t = __map_begin(_this); __map_end(_this) != t; ) {
-        t = map_erase(_this, t); /* When `clear`, the performance of `erase` without rotation doesn't improve */
+    if (__map_small(_this))
+        return __map_small_clear(_this);
+
+    for (n = rb_first_postorder(&_this->root); !is_null(n); n = next) {
+        next = rb_next_postorder(n);
+        t = map_entry(n);
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+            _this->ops->free_key(&t->key);
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+            _this->ops->free_value(&t->value);
+
+        __map_node_free(_this, t);
+        ret++;
+    }
+
+    _this->root = RB_ROOT;
+    _this->rightmost = NULL;
+    _this->leftmost = NULL;
+    _this->size = 0;
+    return ret;
+}
+
+static /* __always_inline */ inline bool __map_lt(const map_t* _this, map_key_t left, map_key_t right)
+{
+    return is_null(_this->ops) || is_null(_this->ops->__lt) ? left < right : _this->ops->__lt(left, right);
+}
+
+/* Count of keys < `key`, or <= `key` if `le` */
+static map_size_t __map_rank(const map_t* _this, map_key_t key, bool le)
+{
+    struct rb_node* n = _this->root.rb_node;
+    map_node_t* t = NULL;
+    map_size_t ret = 0;
+
+    if (__map_small(_this))
+        return __map_small_bound(_this, key, le);
+
+    if (!map_os(_this)) {
+        for (t = __map_begin(_this); __map_end(_this) != t; t = __map_next(_this, t), ret++) {
+            if (le ? __map_lt(_this, key, t->key) : !__map_lt(_this, t->key, key))
+                break;
+        }
+        return ret;
+    }
+
+    while (!is_null(n)) {
+        t = map_entry(n);
+
+        if (le ? __map_lt(_this, key, t->key) : !__map_lt(_this, t->key, key)) {
+            n = n->rb_left;
+        } else {
+            ret += rb_size_of(n->rb_left) + 1;
+            n = n->rb_right;
+        }
+    }
+    return ret;
+}
+
+static map_size_t map_rank(const map_t* _this, map_key_t key)
+{
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return -1;
+
+    return __map_rank(_this, key, false);
+}
+
+static map_node_t* map_select(const map_t* _this, map_size_t k)
+{
+    struct rb_node* n = NULL;
+    map_node_t* t = NULL;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (k < 0 || k >= __map_size(_this))
+        return __map_end(_this);
+
+    if (__map_small(_this))
+        return __map_small_at(_this, k);
+
+    if (map_os(_this)) {
+        n = rb_select(&_this->root, k);
+        return is_null(n) ? NULL : map_entry(n);
+    }
+
+    for (t = __map_begin(_this); k > 0; --k)
+        t = __map_next(_this, t);
+    return t;
+}
+
+static map_size_t map_count_range(const map_t* _this, map_key_t lo, map_key_t hi)
+{
+    map_size_t ret = 0;
+    map_node_t* t = NULL;
+
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && (!_this->ops->valid_key(lo) || !_this->ops->valid_key(hi)))
+        return -1;
+
+    if (!__map_lt(_this, lo, hi))
+        return 0;
+
+    if (map_os(_this) || __map_small(_this))
+        return __map_rank(_this, hi, false) - __map_rank(_this, lo, false);
+
+    t = __map_lower_bound(_this, lo);
+    for (; !is_null(t) && __map_end(_this) != t && __map_lt(_this, t->key, hi); t = __map_next(_this, t))
+        ret++;
+    return ret;
+}
+
+static map_node_t* map_equal_range(const map_t* _this, map_key_t key, map_node_t** last)
+{
+    map_node_t* t = NULL;
+    struct rb_node* n = NULL;
+
+    if (unlikely(is_null(_this) || is_null(last)))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return NULL;
+
+    if (__map_small(_this)) {
+        *last = __map_small_at(_this, __map_small_bound(_this, key, true));
+        *last = is_null(*last) ? __map_end(_this) : *last;
+        t = __map_small_at(_this, __map_small_bound(_this, key, false));
+        return is_null(t) ? __map_end(_this) : t;
+    }
+
+    t = __map_lower_bound(_this, key);
+    if (is_null(t)) {
+        *last = __map_end(_this);
+        return __map_end(_this);
+    }
+
+    n = __map_lt(_this, key, t->key) ? &t->node : __map_succ(_this, &t->node);
+    *last = is_null(n) ? __map_end(_this) : map_entry(n);
+    return t;
+}
+
+/* One descent to `lo`, then the nodes before `hi` are unlinked in order, chained through
+   `rb_right`, and freed together. A range covering every node is a `clear` */
+static map_size_t map_erase_range(map_t* _this, map_key_t lo, map_key_t hi)
+{
+    map_node_t* t = NULL;
+    struct rb_node* n = NULL;
+    struct rb_node* next = NULL;
+    struct rb_node* head = NULL;
+    map_size_t ret = 0;
+
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && (!_this->ops->valid_key(lo) || !_this->ops->valid_key(hi)))
+        return -1;
+
+    if (!__map_lt(_this, lo, hi))
+        return 0;
+
+    if (__map_small(_this))
+        return __map_small_erase_range(_this, lo, hi);
+
+    t = __map_lower_bound(_this, lo);
+    if (is_null(t))
+        return 0;
+
+    if (t == __map_first(_this) && __map_lt(_this, map_entry(_this->rightmost)->key, hi))
+        return map_clear(_this);
+
+    for (n = &t->node; !is_null(n) && __map_lt(_this, map_entry(n)->key, hi); n = next) {
+        next = __map_succ(_this, n);
+        __map_erase(_this, map_entry(n));
+        n->rb_right = head;
+        head = n;
         ret++;
     }
 
+    for (n = head; !is_null(n); n = next) {
+        next = n->rb_right;
+        t = map_entry(n);
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+            _this->ops->free_key(&t->key);
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+            _this->ops->free_value(&t->value);
+
+        __map_node_free(_this, t);
+    }
+
+    __map_small_settle(_this, MAP_SMALL / 2);
+    return ret;
+}
+
+static map_size_t map_for_each_range(const map_t* _this, map_key_t lo, map_key_t hi, for_each_kv cb, void* arg)
+{
+    map_node_t* t = NULL;
+    struct rb_node* n = NULL;
+    map_size_t i = 0;
+    map_size_t ret = 0;
+
+    if (unlikely(is_null(_this) || is_null(cb)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && (!_this->ops->valid_key(lo) || !_this->ops->valid_key(hi)))
+        return -1;
+
+    if (!__map_lt(_this, lo, hi))
+        return 0;
+
+    if (__map_small(_this)) {
+        for (i = __map_small_bound(_this, lo, false); i < __map_size(_this) && __map_lt(_this, _this->small->keys[i], hi); ++i) {
+            ret++;
+            if (!cb(__map_small_at(_this, i)->key, __map_small_at(_this, i)->value, arg))
+                break;
+        }
+        return ret;
+    }
+
+    t = __map_lower_bound(_this, lo);
+    for (n = is_null(t) ? NULL : &t->node; !is_null(n) && __map_lt(_this, map_entry(n)->key, hi); n = __map_succ(_this, n)) {
+        ret++;
+        if (!cb(map_entry(n)->key, map_entry(n)->value, arg))
+            break;
+    }
     return ret;
 }
 
+/* Count of `l` after a split of `total` values, `l` and `r` are walked in step so only the smaller one is walked through */
+static map_size_t __map_split_size(const map_t* _this, const struct rb_root* l, const struct rb_root* r, map_size_t total)
+{
+    struct rb_node* a = NULL;
+    struct rb_node* b = NULL;
+    map_size_t na = 0, nb = 0;
+
+    if (map_os(_this))
+        return (map_size_t)rb_size_of(l->rb_node);
+
+    a = rb_first(l);
+    b = rb_first(r);
+    for (; !is_null(a) && !is_null(b); a = __map_succ(_this, a), b = __map_succ(_this, b)) {
+        na++;
+        nb++;
+    }
+    return is_null(a) ? na : total - nb;
+}
+
+/* The blocks follow their nodes: those of the smaller half are marked, a block with nodes on
+   both sides is shared by the halves */
+static void __map_split_blocks(const map_t* _this, ds_block_t* blocks, ds_block_t* spare, map_t* left, map_t* right)
+{
+    bool lesser = __map_size(left) <= __map_size(right);
+    map_t* t = lesser ? left : right;
+    ds_block_t* moved = NULL;
+    struct rb_node* n = NULL;
+
+    if (is_null(blocks))
+        return;
+
+    for (n = rb_first(&t->root); !is_null(n); n = __map_succ(_this, n))
+        ds_block_mark(blocks, map_entry(n));
+
+    ds_block_split(&blocks, &moved, spare);
+    ds_block_splice(&left->blocks, lesser ? &moved : &blocks);
+    ds_block_splice(&right->blocks, lesser ? &blocks : &moved);
+}
+
+/* The nodes move as they are, so `t` must be empty with the same ops and config, or `_this` itself */
+static /* __always_inline */ inline bool __map_split_into(const map_t* _this, const map_t* t)
+{
+    return t == _this || (0 == __map_size(t) && t->ops == _this->ops && t->config.d == _this->config.d);
+}
+
+static map_size_t map_split(map_t* _this, map_key_t key, map_t* left, map_t* right)
+{
+    struct rb_root l = RB_ROOT;
+    struct rb_root r = RB_ROOT;
+    struct rb_node* rightmost = NULL;
+    struct rb_node* leftmost = NULL;
+    struct rb_node* n = NULL;
+    map_node_t* t = NULL;
+    map_size_t total = 0;
+    ds_block_t* blocks = NULL;
+    ds_block_t* spare = NULL;
+
+    if (unlikely(is_null(_this) || is_null(left) || is_null(right) || left == right))
+        return -1;
+
+    if (!__map_split_into(_this, left) || !__map_split_into(_this, right))
+        return -1;
+
+    /* The array goes to the tree to be split, the halves settle after */
+    if (!__map_small_off(left) || !__map_small_off(right) || !__map_small_off(_this))
+        return -1;
+
+    if (!ds_block_spare(_this->blocks, &spare))
+        return -1;
+
+    t = __map_lower_bound(_this, key);
+    n = is_null(t) ? NULL : &t->node;
+
+    l = _this->root;
+    total = __map_size(_this);
+    rightmost = _this->rightmost;
+    leftmost = _this->leftmost;
+    if (!is_null(n))
+        rb_split(&l, n, &r, map_os(_this) ? &rb_size_augment : NULL);
+
+    /* The thread is cut before `n` */
+    if (map_thread(_this) && !is_null(n)) {
+        leftmost = leftmost == n ? NULL : leftmost;
+        ds_thread_splice(ds_thread_of(n, __map_thread_off(_this))->prev, NULL, __map_thread_off(_this));
+        ds_thread_splice(NULL, n, __map_thread_off(_this));
+    }
+
+    blocks = _this->blocks;
+    _this->root = RB_ROOT;
+    _this->rightmost = NULL;
+    _this->leftmost = NULL;
+    _this->blocks = NULL;
+    _this->size = 0;
+
+    left->root = l;
+    left->size = __map_split_size(_this, &l, &r, total);
+    left->rightmost = (is_null(r.rb_node) ? rightmost : rb_last(&l));
+    left->leftmost = leftmost;
+    right->root = r;
+    right->size = total - left->size;
+    right->rightmost = is_null(r.rb_node) ? NULL : rightmost;
+    right->leftmost = map_thread(_this) ? n : NULL;
+
+    __map_split_blocks(_this, blocks, spare, left, right);
+
+    __map_small_settle(left, MAP_SMALL);
+    __map_small_settle(right, MAP_SMALL);
+    return __map_size(left);
+}
+
+static map_size_t map_join(map_t* _this, map_t* other)
+{
+    map_node_t* last = NULL;
+    map_node_t* first = NULL;
+
+    if (unlikely(is_null(_this) || is_null(other) || _this == other))
+        return -1;
+
+    if (other->ops != _this->ops || other->config.d != _this->config.d)
+        return -1;
+
+    if (0 == __map_size(other))
+        return __map_size(_this);
+
+    last = __map_rbegin(_this);
+    first = __map_begin(other);
+    if (__map_size(_this) > 0 && !__map_lt(_this, last->key, first->key))
+        return -1;
+
+    if (!__map_small_off(_this) || !__map_small_off(other))
+        return -1;
+
+    if (map_thread(_this)) {
+        ds_thread_splice(_this->rightmost, other->leftmost, __map_thread_off(_this));
+        _this->leftmost = is_null(_this->leftmost) ? other->leftmost : _this->leftmost;
+        other->leftmost = NULL;
+    }
+
+    rb_concat(&_this->root, &other->root, map_os(_this) ? &rb_size_augment : NULL);
+    ds_block_splice(&_this->blocks, &other->blocks);
+    _this->rightmost = other->rightmost;
+    _this->size += other->size;
+
+    other->rightmost = NULL;
+    other->size = 0;
+
+    __map_small_settle(_this, MAP_SMALL);
+    return __map_size(_this);
+}
+
+/* The key, the value and the node memory go to `handle`, unless the node is in a block or the entry in the array */
+static map_node_t* map_extract(map_t* _this, map_node_t* pos, ds_node_handle_t* handle)
+{
+    map_node_t* t = NULL;
+    map_size_t i = 0;
+
+    if (unlikely(is_null(_this) || is_null(pos) || is_null(handle) || handle->full))
+        return NULL;
+
+    if (__map_size(_this) <= 0 || __map_end(_this) == pos)
+        return NULL;
+
+    if (__map_small(_this)) {
+        i = __map_small_index(_this, pos);
+        if (i < 0)
+            return NULL;
+
+        handle->key = pos->key;
+        handle->value = pos->value;
+        handle->full = true;
+
+        __map_small_close(_this, i);
+        return i < __map_size(_this) ? __map_small_at(_this, i) : __map_end(_this);
+    }
+
+    t = __map_next(_this, pos);
+    if (is_null(t))
+        return NULL;
+
+    __map_erase(_this, pos);
+
+    handle->key = pos->key;
+    handle->value = pos->value;
+    handle->full = true;
+
+    if (is_null(_this->blocks) || !ds_block_put(&_this->blocks, pos))
+        ds_node_handle_put(handle, pos, __map_node_bytes(_this));
+
+    return __map_small_settle_at(_this, MAP_SMALL / 2, t);
+}
+
+/* On failure `handle` is left as it was */
+static map_node_t* map_insert_node(map_t* _this, ds_node_handle_t* handle)
+{
+    map_node_t* t = NULL;
+
+    if (unlikely(is_null(_this) || is_null(handle) || !handle->full))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(handle->value))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(handle->key))
+        return NULL;
+
+    if (__map_small_on(_this)) {
+        t = __map_small_insert(_this, handle->key, handle->value, false);
+        if (!is_null(t))
+            ds_node_handle_release(handle);
+        if (__map_small_on(_this))
+            return t;
+    }
+
+    t = (map_node_t*)ds_node_handle_take(handle, __map_node_bytes(_this));
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    t->key = handle->key;
+    t->value = handle->value;
+
+    if (t != __map_insert(_this, t)) {
+        ds_node_handle_put(handle, t, __map_node_bytes(_this));
+        return NULL;
+    }
+
+    handle->full = false;
+    return t;
+}
+
+static void map_free_node(map_t* _this, ds_node_handle_t* handle)
+{
+    if (unlikely(is_null(_this) || is_null(handle)))
+        return;
+
+    if (handle->full && !is_null(_this->ops) && !is_null(_this->ops->free_key))
+        _this->ops->free_key(&handle->key);
+
+    if (handle->full && !is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&handle->value);
+
+    ds_node_handle_release(handle);
+}
+
+static bool __map_lt_default(map_key_t left, map_key_t right)
+{
+    return left < right;
+}
+
+static bool __map_node_fill(map_t* _this, map_node_t* t, map_key_t key, map_value_t value)
+{
+    if (is_null(_this->ops) || is_null(_this->ops->copy_key)) {
+        t->key = key;
+    } else {
+        if (!_this->ops->copy_key(key, &t->key))
+            return false;
+    }
+
+    if (is_null(_this->ops) || is_null(_this->ops->copy_value)) {
+        t->value = value;
+    } else {
+        if (!_this->ops->copy_value(value, &t->value)) {
+            if (!is_null(_this->ops->free_key))
+                _this->ops->free_key(&t->key);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* The nodes are chained in order through `rb_right`, then linked into a balanced tree at once */
+static map_size_t map_build_sorted(map_t* _this, const map_key_t* keys, const map_value_t* values, map_size_t n, bool contiguous)
+{
+    __comp lt = NULL;
+    ds_data_t* kv = NULL;       /* The pairs sorted, if the input isn't */
+    ds_size_t step = 1;
+    map_node_t* nodes = NULL;
+    map_node_t* t = NULL;
+    struct rb_node* head = NULL;
+    struct rb_node** tail = &head;
+    map_size_t i, m = 0;
+
+    if (unlikely(is_null(_this) || n < 0 || (n > 0 && is_null(keys))))
+        return -1;
+
+    if (__map_size(_this) > 0)
+        return -1;
+
+    __map_small_off(_this);
+
+    for (i = 0; i < n; ++i) {
+        if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(keys[i]))
+            return -1;
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(is_null(values) ? 0 : values[i]))
+            return -1;
+    }
+
+    lt = is_null(_this->ops) || is_null(_this->ops->__lt) ? __map_lt_default : _this->ops->__lt;
+
+    for (i = 1; i < n && !lt(keys[i], keys[i - 1]); ++i)
+        ;
+
+    if (i < n) {
+        kv = (ds_data_t*)p_malloc(n * 2 * sizeof(ds_data_t));
+        if (unlikely(is_null(kv)))
+            return -1;
+
+        for (i = 0; i < n; ++i) {
+            kv[i * 2] = keys[i];
+            kv[i * 2 + 1] = is_null(values) ? 0 : values[i];
+        }
+
+        if (!__sort_merge_n(kv, n, 2, lt)) {
+            p_free(kv);
+            return -1;
+        }
+
+        keys = kv;
+        values = kv + 1;
+        step = 2;
+    }
+
+    for (i = 0; i < n; ++i)
+        m += 0 == i || lt(keys[(i - 1) * step], keys[i * step]);
+
+    if (contiguous && m > 0) {
+        nodes = (map_node_t*)ds_block_alloc(&_this->blocks, m, __map_node_bytes(_this));
+        if (unlikely(is_null(nodes)))
+            goto err;
+    }
+
+    for (i = 0, m = 0; i < n; ++i) {
+        if (i > 0 && !lt(keys[(i - 1) * step], keys[i * step]))
+            continue;
+
+        t = contiguous ? (map_node_t*)((char*)nodes + m * __map_node_bytes(_this)) : (map_node_t*)p_calloc(1, __map_node_bytes(_this));
+        if (unlikely(is_null(t)))
+            goto err;
+
+        if (!__map_node_fill(_this, t, keys[i * step], is_null(values) ? 0 : values[i * step])) {
+            if (!contiguous)
+                p_free(t);
+            goto err;
+        }
+
+        *tail = &t->node;
+        tail = &t->node.rb_right;
+        m++;
+    }
+
+    if (map_thread(_this))
+        ds_thread_chain(head, m, __map_thread_off(_this), &_this->leftmost);
+
+    rb_build_sorted(&_this->root, head, m);
+    _this->rightmost = rb_last(&_this->root);
+    if (map_os(_this))
+        rb_size_build(&_this->root);
+    _this->size = m;
+    p_free(kv);
+
+    __map_small_settle(_this, MAP_SMALL);
+    return m;
+
+err:
+    while (!is_null(head)) {
+        t = map_entry(head);
+        head = head->rb_right;
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+            _this->ops->free_key(&t->key);
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+            _this->ops->free_value(&t->value);
+
+        if (!contiguous)
+            p_free(t);
+    }
+
+    if (!is_null(nodes))
+        ds_block_free(&_this->blocks, nodes);
+    p_free(kv);
+    return -1;
+}
+
 /* __always_inline */ inline void __map_init(map_t* map)
 {
     map->root = RB_ROOT;
+    map->blocks = NULL;
+    map->rightmost = NULL;
+    map->leftmost = NULL;
+    map->small = NULL;
 }
 
 /* __always_inline */ inline void __map_deinit(map_t* map)
@@ -627,11 +1631,18 @@ typedef map_r_iterator_t* (*fp_rbegin)(const map_t* _this);
 typedef map_r_iterator_t* (*fp_rnext)(const map_t* _this, const map_r_iterator_t* r_iterator);
 typedef map_r_iterator_t* (*fp_rprev)(const map_t* _this, const map_r_iterator_t* r_iterator);
 typedef map_iterator_t* (*fp_find)(const map_t* _this, map_key_t key);
+typedef map_size_t (*fp_find_batch)(const map_t* _this, const map_key_t* keys, map_size_t n, map_iterator_t** out);
+typedef map_size_t (*fp_find_sorted)(const map_t* _this, const map_key_t* keys, map_size_t n, map_iterator_t** out);
 typedef map_iterator_t* (*fp_lower_bound)(const map_t* _this, map_key_t key);
 typedef map_iterator_t* (*fp_upper_bound)(const map_t* _this, map_key_t key);
 typedef map_iterator_t* (*fp_insert)(map_t* _this, map_key_t key, map_value_t value);
 typedef map_iterator_t* (*fp_insert_replace)(map_t* _this, map_key_t key, map_value_t value);
 typedef map_iterator_t* (*fp_erase)(map_t* _this, map_iterator_t* iterator);
+typedef map_iterator_t* (*fp_insert_hint)(map_t* _this, map_iterator_t* hint, map_key_t key, map_value_t value);
+typedef map_iterator_t* (*fp_equal_range)(const map_t* _this, map_key_t key, map_iterator_t** last);
+typedef map_iterator_t* (*fp_select)(const map_t* _this, map_size_t k);
+typedef map_iterator_t* (*fp_extract)(map_t* _this, map_iterator_t* iterator, ds_node_handle_t* handle);
+typedef map_iterator_t* (*fp_insert_node)(map_t* _this, ds_node_handle_t* handle);
 
 const class_map_t* class_map_ins(void)
 {
@@ -647,6 +1658,9 @@ const class_map_t* class_map_ins(void)
         .rnext          = (fp_rnext)_map_rnext,
         .rprev          = (fp_rprev)_map_rprev,
         .find           = (fp_find)map_find,
+        .find_batch     = (fp_find_batch)map_find_batch,
+        .contains_sorted = map_contains_sorted,
+        .find_sorted    = (fp_find_sorted)map_find_sorted,
         .lower_bound    = (fp_lower_bound)map_lower_bound,
         .upper_bound    = (fp_upper_bound)map_upper_bound,
         .insert         = (fp_insert)map_insert,
@@ -655,6 +1669,19 @@ const class_map_t* class_map_ins(void)
         .remove         = map_remove,
         .remove_if      = map_remove_if,
         .clear          = map_clear,
+        .build_sorted   = map_build_sorted,
+        .rank           = map_rank,
+        .select         = (fp_select)map_select,
+        .count_range    = map_count_range,
+        .insert_hint    = (fp_insert_hint)map_insert_hint,
+        .equal_range    = (fp_equal_range)map_equal_range,
+        .erase_range    = map_erase_range,
+        .for_each_range = map_for_each_range,
+        .split          = map_split,
+        .join           = map_join,
+        .extract        = (fp_extract)map_extract,
+        .insert_node    = (fp_insert_node)map_insert_node,
+        .free_node      = map_free_node,
     };
     return &ins;
 }
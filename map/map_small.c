@@ -0,0 +1,384 @@
+/*
+  Map Small-size Mode Implementations
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/* Included by map/map.c.
+   In the adaptive mode (`b_small`) a map of up to MAP_SMALL entries keeps them in one
+   `map_small_t` instead of nodes of a tree: the key and value of each entry in a slot, and
+   the keys in order in one array, searched with a scan the compiler can turn into SIMD
+   compares. A slot doesn't move while the array lasts, so an iterator is the address of its
+   slot and stays valid until its own entry is erased, as a node would. The entry past
+   MAP_SMALL moves the entries into nodes of one block of `blocks`, linked into the tree, and
+   erases leaving MAP_SMALL / 2 move them back, so a size going back and forth doesn't convert
+   each time. Either move invalidates the iterators taken before it, as a reallocation does */
+
+#include <map/map.h>
+
+#include <string.h>
+#include <_block.h>
+#include <_memory.h>
+#include <linux/rbtree.h>
+#include <linux/_compiler.h>
+#include <iterator/iterator.h>
+
+#define MAP_SMALL_SLOTS ((1U << MAP_SMALL) - 1)
+
+static /* __always_inline */ inline bool __map_small(const map_t* _this)
+{
+    return !is_null(_this->small);
+}
+
+/* The array takes the next insert: there's one, or the adaptive map is empty */
+static /* __always_inline */ inline bool __map_small_on(const map_t* _this)
+{
+    return __map_small(_this) || (_this->config.c.b_small && 0 == _this->size);
+}
+
+static /* __always_inline */ inline map_node_t* __map_small_at(const map_t* _this, map_size_t i)
+{
+    return i >= 0 && i < _this->size ? (map_node_t*)&_this->small->slots[_this->small->order[i]] : NULL;
+}
+
+/* Index of `node` in the array, -1 if it's not the slot of an entry */
+static map_size_t __map_small_index(const map_t* _this, const map_node_t* node)
+{
+    const map_small_t* s = _this->small;
+    uintptr_t off = (uintptr_t)node - (uintptr_t)s->slots;
+    map_size_t i = 0;
+
+    if (off >= sizeof(s->slots) || 0 != off % sizeof(map_small_slot_t))
+        return -1;
+
+    for (i = 0; i < _this->size; ++i) {
+        if (s->order[i] == off / sizeof(map_small_slot_t))
+            return i;
+    }
+    return -1;
+}
+
+/* Count of entries < `key`, or <= `key` if `upper` */
+static map_size_t __map_small_bound(const map_t* _this, map_key_t key, bool upper)
+{
+    const map_key_t* e = _this->small->keys;
+    map_size_t n = _this->size;
+    map_size_t i = 0;
+    map_size_t ret = 0;
+
+    /* Without a branch per entry, which the compiler may turn into SIMD compares */
+    if (is_null(_this->ops) || is_null(_this->ops->__lt)) {
+        if (upper) {
+            for (i = 0; i < n; ++i)
+                ret += e[i] <= key;
+        } else {
+            for (i = 0; i < n; ++i)
+                ret += e[i] < key;
+        }
+        return ret;
+    }
+
+    if (upper) {
+        for (i = 0; i < n && !_this->ops->__lt(key, e[i]); ++i)
+            ;
+    } else {
+        for (i = 0; i < n && _this->ops->__lt(e[i], key); ++i)
+            ;
+    }
+    return i;
+}
+
+/* Return true if `key` is there at `*i`, else `*i` is where it goes */
+static /* __always_inline */ inline bool __map_small_slot(const map_t* _this, map_key_t key, map_size_t* i)
+{
+    *i = __map_small_bound(_this, key, false);
+    return *i < _this->size && !__map_lt(_this, key, _this->small->keys[*i]);
+}
+
+static map_node_t* __map_small_find(const map_t* _this, map_key_t key)
+{
+    map_size_t i = 0;
+    return __map_small_slot(_this, key, &i) ? __map_small_at(_this, i) : NULL;
+}
+
+static /* __always_inline */ inline map_node_t* __map_small_begin(const map_t* _this)
+{
+    return _this->size > 0 ? __map_small_at(_this, 0) : __map_end(_this);
+}
+
+static /* __always_inline */ inline map_node_t* __map_small_rbegin(const map_t* _this)
+{
+    return _this->size > 0 ? __map_small_at(_this, _this->size - 1) : __map_rend(_this);
+}
+
+/* One step from `node`, forward or backward, toward `stop` which is `end` or `rend` */
+static map_node_t* __map_small_step(const map_t* _this, const map_node_t* node, bool forward, map_node_t* stop)
+{
+    map_size_t i = __map_small_index(_this, node);
+
+    if (i < 0)
+        return NULL;
+
+    i += forward ? 1 : -1;
+    return i >= 0 && i < _this->size ? __map_small_at(_this, i) : stop;
+}
+
+static map_node_t* __map_small_next(const map_t* _this, const map_node_t* node)
+{
+    if (__map_end(_this) == node)
+        return __map_end(_this);
+    return __map_small_step(_this, node, true, __map_end(_this));
+}
+
+static map_node_t* __map_small_prev(const map_t* _this, const map_node_t* node)
+{
+    if (__map_end(_this) == node)
+        return _this->size > 0 ? __map_small_at(_this, _this->size - 1) : __map_end(_this);
+    return __map_small_step(_this, node, false, __map_end(_this));
+}
+
+static map_node_t* __map_small_rnext(const map_t* _this, const map_node_t* node)
+{
+    if (__map_rend(_this) == node)
+        return __map_rend(_this);
+    return __map_small_step(_this, node, false, __map_rend(_this));
+}
+
+static map_node_t* __map_small_rprev(const map_t* _this, const map_node_t* node)
+{
+    if (__map_rend(_this) == node)
+        return _this->size > 0 ? __map_small_at(_this, 0) : __map_rend(_this);
+    return __map_small_step(_this, node, true, __map_rend(_this));
+}
+
+/* A free slot for the entry at `i`, those after it move up. The key of the array is left to the caller */
+static /* __always_inline */ inline map_node_t* __map_small_open(map_t* _this, map_size_t i)
+{
+    map_small_t* s = _this->small;
+    uint32_t slot = __builtin_ctz(s->free);
+
+    memmove(s->keys + i + 1, s->keys + i, (_this->size - i) * sizeof(map_key_t));
+    memmove(s->order + i + 1, s->order + i, (_this->size - i) * sizeof(uint8_t));
+    s->order[i] = (uint8_t)slot;
+    s->free &= ~(1U << slot);
+    _this->size++;
+    return (map_node_t*)&s->slots[slot];
+}
+
+/* The entry at `i` goes, its key and value are left to the caller */
+static /* __always_inline */ inline void __map_small_close(map_t* _this, map_size_t i)
+{
+    map_small_t* s = _this->small;
+
+    s->free |= 1U << s->order[i];
+    memmove(s->keys + i, s->keys + i + 1, (_this->size - i - 1) * sizeof(map_key_t));
+    memmove(s->order + i, s->order + i + 1, (_this->size - i - 1) * sizeof(uint8_t));
+    _this->size--;
+}
+
+static /* __always_inline */ inline void __map_small_free_entry(map_t* _this, map_node_t* t)
+{
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+        _this->ops->free_key(&t->key);
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&t->value);
+}
+
+/* The entries move into nodes of one block, linked into the tree in order. On failure the array stays */
+static bool __map_small_promote(map_t* _this)
+{
+    map_small_t* s = _this->small;
+    struct rb_node* head = NULL;
+    struct rb_node** tail = &head;
+    char* nodes = NULL;
+    map_node_t* t = NULL;
+    map_size_t i = 0;
+
+    nodes = (char*)ds_block_alloc(&_this->blocks, _this->size, __map_node_bytes(_this));
+    if (unlikely(is_null(nodes)))
+        return false;
+
+    for (i = 0; i < _this->size; ++i) {
+        t = (map_node_t*)(nodes + i * __map_node_bytes(_this));
+        t->key = s->slots[s->order[i]].key;
+        t->value = s->slots[s->order[i]].value;
+        *tail = &t->node;
+        tail = &t->node.rb_right;
+    }
+    *tail = NULL;
+
+    if (map_thread(_this))
+        ds_thread_chain(head, _this->size, __map_thread_off(_this), &_this->leftmost);
+
+    rb_build_sorted(&_this->root, head, _this->size);
+    _this->rightmost = rb_last(&_this->root);
+    if (map_os(_this))
+        rb_size_build(&_this->root);
+
+    p_free(_this->small);
+    return true;
+}
+
+/* The entries of the tree move to an array and their nodes are freed. On failure the tree stays */
+static void __map_small_demote(map_t* _this)
+{
+    map_small_t* s = NULL;
+    struct rb_node* n = NULL;
+    struct rb_node* next = NULL;
+    map_size_t i = 0;
+
+    s = (map_small_t*)p_malloc(sizeof(map_small_t));
+    if (unlikely(is_null(s)))
+        return;
+
+    for (n = rb_first(&_this->root); !is_null(n); n = rb_next(n), ++i) {
+        s->keys[i] = map_entry(n)->key;
+        s->order[i] = (uint8_t)i;
+        s->slots[i].key = map_entry(n)->key;
+        s->slots[i].value = map_entry(n)->value;
+    }
+    s->free = MAP_SMALL_SLOTS & ~((1U << i) - 1);
+
+    for (n = rb_first_postorder(&_this->root); !is_null(n); n = next) {
+        next = rb_next_postorder(n);
+        __map_node_free(_this, map_entry(n));
+    }
+
+    _this->root = RB_ROOT;
+    _this->rightmost = NULL;
+    _this->leftmost = NULL;
+    _this->small = s;
+}
+
+/* An adaptive map of `limit` entries or fewer goes back to the array */
+static /* __always_inline */ inline void __map_small_settle(map_t* _this, map_size_t limit)
+{
+    if (_this->config.c.b_small && !__map_small(_this) && _this->size > 0 && _this->size <= limit)
+        __map_small_demote(_this);
+}
+
+/* As `__map_small_settle`, `t` of the tree, or `end`, is followed to where its entry moved */
+static map_node_t* __map_small_settle_at(map_t* _this, map_size_t limit, map_node_t* t)
+{
+    map_key_t key = __map_end(_this) == t ? 0 : t->key;
+
+    __map_small_settle(_this, limit);
+    if (!__map_small(_this) || __map_end(_this) == t)
+        return t;
+    return __map_small_find(_this, key);
+}
+
+/* Before the tree is worked on directly: the array goes, its entries into the tree. On failure the array stays */
+static /* __always_inline */ inline bool __map_small_off(map_t* _this)
+{
+    if (!__map_small(_this))
+        return true;
+
+    if (0 == _this->size) {
+        p_free(_this->small);
+        return true;
+    }
+    return __map_small_promote(_this);
+}
+
+static bool __map_small_new(map_t* _this)
+{
+    map_small_t* s = (map_small_t*)p_malloc(sizeof(map_small_t));
+
+    if (unlikely(is_null(s)))
+        return false;
+
+    s->free = MAP_SMALL_SLOTS;
+    _this->small = s;
+    return true;
+}
+
+/* NULL if `key` is there or on failure. A full array goes to the tree, which then takes the
+   insert: `__map_small_on` tells the caller. `copy` is false for the key and value of a handle */
+static map_node_t* __map_small_insert(map_t* _this, map_key_t key, map_value_t value, bool copy)
+{
+    map_node_t* t = NULL;
+    map_size_t i = 0;
+
+    if (!__map_small(_this) && !__map_small_new(_this))
+        return NULL;
+
+    if (__map_small_slot(_this, key, &i))
+        return NULL;
+
+    if (_this->size >= MAP_SMALL) {
+        __map_small_promote(_this);
+        return NULL;
+    }
+
+    t = __map_small_open(_this, i);
+    if (!copy) {
+        t->key = key;
+        t->value = value;
+    } else if (!__map_node_fill(_this, t, key, value)) {
+        __map_small_close(_this, i);
+        return NULL;
+    }
+
+    _this->small->keys[i] = t->key;
+    return t;
+}
+
+/* Return the entry after `pos` or `end` */
+static map_node_t* __map_small_erase(map_t* _this, map_node_t* pos)
+{
+    map_size_t i = __map_small_index(_this, pos);
+
+    if (i < 0)
+        return NULL;
+
+    __map_small_free_entry(_this, pos);
+    __map_small_close(_this, i);
+    return i < _this->size ? __map_small_at(_this, i) : __map_end(_this);
+}
+
+static map_size_t __map_small_clear(map_t* _this)
+{
+    map_size_t ret = _this->size;
+    map_size_t i = 0;
+
+    for (i = 0; i < _this->size; ++i)
+        __map_small_free_entry(_this, __map_small_at(_this, i));
+
+    p_free(_this->small);
+    _this->size = 0;
+    return ret;
+}
+
+/* Entries in [ lo, hi ) */
+static map_size_t __map_small_erase_range(map_t* _this, map_key_t lo, map_key_t hi)
+{
+    map_small_t* s = _this->small;
+    map_size_t l = __map_small_bound(_this, lo, false);
+    map_size_t h = __map_small_bound(_this, hi, false);
+    map_size_t i = 0;
+
+    for (i = l; i < h; ++i) {
+        __map_small_free_entry(_this, __map_small_at(_this, i));
+        s->free |= 1U << s->order[i];
+    }
+
+    memmove(s->keys + l, s->keys + h, (_this->size - h) * sizeof(map_key_t));
+    memmove(s->order + l, s->order + h, (_this->size - h) * sizeof(uint8_t));
+    _this->size -= h - l;
+    return h - l;
+}
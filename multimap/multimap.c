@@ -19,16 +19,34 @@
 
 #include <multimap/multimap.h>
 
+#include <_block.h>
+#include <_handle.h>
+#include <_finger.h>
 #include <_memory.h>
+#include <sort/sort.h>
 #include <linux/rbtree.h>
 #include <linux/_compiler.h>
 #include <iterator/iterator.h>
 
 #define multimap_entry(ptr) rb_entry((ptr), struct multimap_node, node)
+#define multimap_os(_this)  ((_this)->config.c.b_order_stat)
 
 static /* __always_inline */ inline multimap_node_t* multimap_find(const multimap_t* _this, multimap_key_t key);
 static /* __always_inline */ inline multimap_node_t* __multimap_end(const multimap_t* _this);
+static /* __always_inline */ inline multimap_node_t* __multimap_rend(const multimap_t* _this);
+static /* __always_inline */ inline bool __multimap_lt(const multimap_t* _this, multimap_key_t left, multimap_key_t right);
+static bool __multimap_node_fill(multimap_t* _this, multimap_node_t* t, multimap_key_t key, multimap_value_t value);
+static multimap_size_t __multimap_rank(const multimap_t* _this, multimap_key_t key, bool le);
+
+static /* __always_inline */ inline size_t __multimap_node_bytes(const multimap_t* _this)
+{
+    return sizeof(multimap_node_t) + (multimap_os(_this) ? RB_SIZE_EXTRA : 0);
+}
 static /* __always_inline */ inline multimap_node_t* __multimap_next(const multimap_t* _this, const multimap_node_t* node);
+static /* __always_inline */ inline void __multimap_node_free(multimap_t* _this, multimap_node_t* node);
+
+#include <../multimap/multimap_compress.c>
+#include <../multimap/multimap_small.c>
 
 static /* __always_inline */ inline multimap_size_t __multimap_size(const multimap_t* _this)
 {
@@ -50,9 +68,15 @@ static multimap_count_t multimap_count(const multimap_t* _this, multimap_key_t k
     if (is_null(t))
         return -1;
 
+    if (__multimap_compress(_this))
+        return __mmc_count(_this, key);
+
     if (__multimap_end(_this) == t)
         return 0;
 
+    if (multimap_os(_this) || __multimap_small(_this))
+        return __multimap_rank(_this, key, true) - __multimap_rank(_this, key, false);
+
     /* TODO: The current way of writing code will result in low performance. It's 
              necessary to balance the memory usage and performance for optimization. */
     if (is_null(_this->ops) || is_null(_this->ops->__lt)) {
@@ -92,7 +116,12 @@ static /* __always_inline */ inline multimap_node_t* __multimap_end(const multim
 
 static /* __always_inline */ inline multimap_node_t* __multimap_begin(const multimap_t* _this)
 {
-    multimap_node_t* t = __multimap_first(_this);
+    multimap_node_t* t = NULL;
+
+    if (__multimap_small(_this))
+        return __multimap_small_begin(_this);
+
+    t = __multimap_first(_this);
     return is_null(t) ? __multimap_end(_this) : t;
 }
 
@@ -100,6 +129,8 @@ static /* __always_inline */ inline multimap_node_t* _multimap_begin(const multi
 {
     if (unlikely(is_null(_this)))
         return NULL;
+    if (__multimap_compress(_this))
+        return (multimap_node_t*)__mmc_begin(_this);
     return __multimap_begin(_this);
 }
 
@@ -107,6 +138,9 @@ static /* __always_inline */ inline multimap_node_t* __multimap_next(const multi
 {
     struct rb_node* t = NULL;
 
+    if (__multimap_small(_this))
+        return __multimap_small_next(_this, node);
+
     if (RB_EMPTY_ROOT(&_this->root) || __multimap_end(_this) == node)
         return __multimap_end(_this);
 
@@ -126,6 +160,8 @@ static /* __always_inline */ inline multimap_node_t* _multimap_next(const multim
 {
     if (unlikely(is_null(_this) || is_null(node)))
         return NULL;
+    if (__multimap_compress(_this))
+        return (multimap_node_t*)__mmc_next(_this, (const multimap_cslot_t*)node);
     return __multimap_next(_this, node);
 }
 
@@ -133,6 +169,9 @@ static /* __always_inline */ inline multimap_node_t* __multimap_prev(const multi
 {
     struct rb_node* t = NULL;
 
+    if (__multimap_small(_this))
+        return __multimap_small_prev(_this, node);
+
     if (RB_EMPTY_ROOT(&_this->root))
         return __multimap_end(_this);
 
@@ -153,6 +192,8 @@ static /* __always_inline */ inline multimap_node_t* _multimap_prev(const multim
 {
     if (unlikely(is_null(_this) || is_null(node)))
         return NULL;
+    if (__multimap_compress(_this))
+        return (multimap_node_t*)__mmc_prev(_this, (const multimap_cslot_t*)node);
     return __multimap_prev(_this, node);
 }
 
@@ -163,7 +204,12 @@ static /* __always_inline */ inline multimap_node_t* __multimap_rend(const multi
 
 static /* __always_inline */ inline multimap_node_t* __multimap_rbegin(const multimap_t* _this)
 {
-    multimap_node_t* t = __multimap_last(_this);
+    multimap_node_t* t = NULL;
+
+    if (__multimap_small(_this))
+        return __multimap_small_rbegin(_this);
+
+    t = __multimap_last(_this);
     return is_null(t) ? __multimap_rend(_this) : t;
 }
 
@@ -171,6 +217,8 @@ static /* __always_inline */ inline multimap_node_t* _multimap_rbegin(const mult
 {
     if (unlikely(is_null(_this)))
         return NULL;
+    if (__multimap_compress(_this))
+        return (multimap_node_t*)__mmc_rbegin(_this);
     return __multimap_rbegin(_this);
 }
 
@@ -178,6 +226,9 @@ static /* __always_inline */ inline multimap_node_t* __multimap_rnext(const mult
 {
     struct rb_node* t = NULL;
 
+    if (__multimap_small(_this))
+        return __multimap_small_rnext(_this, node);
+
     if (RB_EMPTY_ROOT(&_this->root) || __multimap_rend(_this) == node)
         return __multimap_rend(_this);
 
@@ -197,6 +248,8 @@ static /* __always_inline */ inline multimap_node_t* _multimap_rnext(const multi
 {
     if (unlikely(is_null(_this) || is_null(node)))
         return NULL;
+    if (__multimap_compress(_this))
+        return (multimap_node_t*)__mmc_rnext(_this, (const multimap_cslot_t*)node);
     return __multimap_rnext(_this, node);
 }
 
@@ -204,6 +257,9 @@ static /* __always_inline */ inline multimap_node_t* __multimap_rprev(const mult
 {
     struct rb_node* t = NULL;
 
+    if (__multimap_small(_this))
+        return __multimap_small_rprev(_this, node);
+
     if (RB_EMPTY_ROOT(&_this->root))
         return __multimap_rend(_this);
 
@@ -224,6 +280,8 @@ static /* __always_inline */ inline multimap_node_t* _multimap_rprev(const multi
 {
     if (unlikely(is_null(_this) || is_null(node)))
         return NULL;
+    if (__multimap_compress(_this))
+        return (multimap_node_t*)__mmc_rprev(_this, (const multimap_cslot_t*)node);
     return __multimap_rprev(_this, node);
 }
 
@@ -232,6 +290,7 @@ static multimap_node_t* __multimap_find(const multimap_t* _this, multimap_key_t
     struct rb_node* n = _this->root.rb_node;
     multimap_node_t* t = NULL;
     multimap_node_t* ret = NULL;
+    int cmp = 0;
 
     if (is_null(_this->ops) || is_null(_this->ops->__lt)) {
         while (!is_null(n)) {
@@ -246,6 +305,20 @@ static multimap_node_t* __multimap_find(const multimap_t* _this, multimap_key_t
                 ret = t;
             }
         }
+    } else if (!is_null(_this->ops->__cmp)) {
+        while (!is_null(n)) {
+            t = multimap_entry(n);
+            cmp = _this->ops->__cmp(key, t->key);
+
+            if (cmp < 0) {
+                n = n->rb_left;
+            } else if (cmp > 0) {
+                n = n->rb_right;
+            } else {
+                n = n->rb_left;
+                ret = t;
+            }
+        }
     } else {
         while (!is_null(n)) {
             t = multimap_entry(n);
@@ -274,16 +347,73 @@ static /* __always_inline */ inline multimap_node_t* multimap_find(const multima
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
         return NULL;
 
-    t = __multimap_find(_this, key);
+    if (__multimap_compress(_this))
+        return (multimap_node_t*)__mmc_at(_this, __mmc_find(_this, key));
+
+    t = __multimap_small(_this) ? __multimap_small_find(_this, key) : __multimap_find(_this, key);
     return is_null(t) ? __multimap_end(_this) : t;
 }
 
+/* One walk for the keys in order, see `_finger.h`. Either `bitmap` or `out` is filled */
+static multimap_size_t __multimap_probe_sorted(const multimap_t* _this, const multimap_key_t* keys, multimap_size_t n, uint64_t* bitmap, multimap_node_t** out)
+{
+    ds_finger_t finger = DS_FINGER_INIT;
+    __comp lt = is_null(_this->ops) ? NULL : _this->ops->__lt;
+    size_t off = __multimap_compress(_this) ? offsetof(multimap_cnode_t, node) : offsetof(multimap_node_t, node);
+    struct rb_node* lb = NULL;
+    multimap_node_t* t = NULL;
+    multimap_size_t found = 0;
+    multimap_size_t i = 0;
+    bool valid = false;
+    bool in = false;
+
+    for (i = 0; i < n; ++i) {
+        valid = is_null(_this->ops) || is_null(_this->ops->valid_key) || _this->ops->valid_key(keys[i]);
+        in = false;
+
+        if (valid && __multimap_small(_this)) {
+            t = __multimap_small_find(_this, keys[i]);
+            in = !is_null(t);
+        } else if (valid) {
+            lb = ds_finger_lower_bound(&_this->root, &finger, keys[i], off, lt);
+            in = !is_null(lb) && !__multimap_lt(_this, keys[i], __finger_key(lb, off));
+        }
+
+        found += in;
+        if (!is_null(bitmap))
+            ds_bitmap_put(bitmap, i, in);
+        else if (!in)
+            out[i] = valid ? __multimap_end(_this) : NULL;
+        else if (__multimap_small(_this))
+            out[i] = t;
+        else /* The first of equal keys, as `find` */
+            out[i] = __multimap_compress(_this) ? (multimap_node_t*)__mmc_first(mmc_entry(lb)) : multimap_entry(lb);
+    }
+
+    return found;
+}
+
+static multimap_size_t multimap_contains_sorted(const multimap_t* _this, const multimap_key_t* keys, multimap_size_t n, uint64_t* bitmap)
+{
+    if (unlikely(is_null(_this) || is_null(keys) || is_null(bitmap) || n < 0))
+        return -1;
+    return __multimap_probe_sorted(_this, keys, n, bitmap, NULL);
+}
+
+static multimap_size_t multimap_find_sorted(const multimap_t* _this, const multimap_key_t* keys, multimap_size_t n, multimap_node_t** out)
+{
+    if (unlikely(is_null(_this) || is_null(keys) || is_null(out) || n < 0))
+        return -1;
+    return __multimap_probe_sorted(_this, keys, n, NULL, out);
+}
+
 static multimap_node_t* __multimap_lower_bound(const multimap_t* _this, multimap_key_t key)
 {
     struct rb_node* n = _this->root.rb_node;
     multimap_node_t* t = NULL;
     multimap_node_t* eq = NULL;
     multimap_node_t* gt = NULL;
+    int cmp = 0;
 
     if (is_null(_this->ops) || is_null(_this->ops->__lt)) {
         while (!is_null(n)) {
@@ -299,6 +429,21 @@ static multimap_node_t* __multimap_lower_bound(const multimap_t* _this, multimap
                 eq = t;
             }
         }
+    } else if (!is_null(_this->ops->__cmp)) {
+        while (!is_null(n)) {
+            t = multimap_entry(n);
+            cmp = _this->ops->__cmp(key, t->key);
+
+            if (cmp < 0) {
+                n = n->rb_left;
+                gt = t;
+            } else if (cmp > 0) {
+                n = n->rb_right;
+            } else {
+                n = n->rb_left;
+                eq = t;
+            }
+        }
     } else {
         while (!is_null(n)) {
             t = multimap_entry(n);
@@ -328,7 +473,10 @@ static /* __always_inline */ inline multimap_node_t* multimap_lower_bound(const
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
         return NULL;
 
-    t = __multimap_lower_bound(_this, key);
+    if (__multimap_compress(_this))
+        return (multimap_node_t*)__mmc_at(_this, __mmc_bound(_this, key, false));
+
+    t = __multimap_small(_this) ? __multimap_small_at(_this, __multimap_small_bound(_this, key, false)) : __multimap_lower_bound(_this, key);
     return is_null(t) ? __multimap_end(_this) : t;
 }
 
@@ -337,6 +485,7 @@ static multimap_node_t* __multimap_upper_bound(const multimap_t* _this, multimap
     struct rb_node* n = _this->root.rb_node;
     multimap_node_t* t = NULL;
     multimap_node_t* ret = NULL;
+    int cmp = 0;
 
     if (is_null(_this->ops) || is_null(_this->ops->__lt)) {
         while (!is_null(n)) {
@@ -351,6 +500,20 @@ static multimap_node_t* __multimap_upper_bound(const multimap_t* _this, multimap
                 n = n->rb_right;
             }
         }
+    } else if (!is_null(_this->ops->__cmp)) {
+        while (!is_null(n)) {
+            t = multimap_entry(n);
+            cmp = _this->ops->__cmp(key, t->key);
+
+            if (cmp < 0) {
+                n = n->rb_left;
+                ret = t;
+            } else if (cmp > 0) {
+                n = n->rb_right;
+            } else {
+                n = n->rb_right;
+            }
+        }
     } else {
         while (!is_null(n)) {
             t = multimap_entry(n);
@@ -379,15 +542,38 @@ static /* __always_inline */ inline multimap_node_t* multimap_upper_bound(const
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
         return NULL;
 
-    t = __multimap_upper_bound(_this, key);
+    if (__multimap_compress(_this))
+        return (multimap_node_t*)__mmc_at(_this, __mmc_bound(_this, key, true));
+
+    t = __multimap_small(_this) ? __multimap_small_at(_this, __multimap_small_bound(_this, key, true)) : __multimap_upper_bound(_this, key);
     return is_null(t) ? __multimap_end(_this) : t;
 }
 
+/* `rightmost` moves to a node linked as its right child */
+static /* __always_inline */ inline multimap_node_t* __multimap_link(multimap_t* _this, multimap_node_t* node, struct rb_node* parent, struct rb_node** link)
+{
+    if (is_null(parent) || (parent == _this->rightmost && link == &parent->rb_right))
+        _this->rightmost = &node->node;
+
+    rb_link_node(&node->node, parent, link);
+    if (multimap_os(_this))
+        rb_insert_augmented(&node->node, &_this->root, &rb_size_augment);
+    else
+        rb_insert_color(&node->node, &_this->root);
+    _this->size++;
+    return node;
+}
+
 static multimap_node_t* __multimap_insert(multimap_t* _this, multimap_node_t* node)
 {
     struct rb_node** n = &_this->root.rb_node;
     struct rb_node* parent = NULL;
     multimap_node_t* t = NULL;
+    int cmp = 0;
+
+    /* Increasing keys are appended without a descent */
+    if (!is_null(_this->rightmost) && !__multimap_lt(_this, node->key, multimap_entry(_this->rightmost)->key))
+        return __multimap_link(_this, node, _this->rightmost, &_this->rightmost->rb_right);
 
     if (is_null(_this->ops) || is_null(_this->ops->__lt)) {
         while (!is_null(*n)) {
@@ -401,6 +587,19 @@ static multimap_node_t* __multimap_insert(multimap_t* _this, multimap_node_t* no
             else
                 n = &parent->rb_right;
         }
+    } else if (!is_null(_this->ops->__cmp)) {
+        while (!is_null(*n)) {
+            parent = *n;
+            t = multimap_entry(parent);
+            cmp = _this->ops->__cmp(node->key, t->key);
+
+            if (cmp < 0)
+                n = &parent->rb_left;
+            else if (cmp > 0)
+                n = &parent->rb_right;
+            else
+                n = &parent->rb_right;
+        }
     } else {
         while (!is_null(*n)) {
             parent = *n;
@@ -415,10 +614,7 @@ static multimap_node_t* __multimap_insert(multimap_t* _this, multimap_node_t* no
         }
     }
 
-    rb_link_node(&node->node, parent, n);
-    rb_insert_color(&node->node, &_this->root);
-    _this->size++;
-    return node;
+    return __multimap_link(_this, node, parent, n);
 }
 
 static inline multimap_node_t* multimap_insert(multimap_t* _this, multimap_key_t key, multimap_value_t value)
@@ -435,7 +631,16 @@ static inline multimap_node_t* multimap_insert(multimap_t* _this, multimap_key_t
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
         return NULL;
 
-    t = (multimap_node_t*)p_calloc(1, sizeof(multimap_node_t));
+    if (__multimap_compress(_this))
+        return (multimap_node_t*)__mmc_insert(_this, key, value);
+
+    if (__multimap_small_on(_this)) {
+        t = __multimap_small_insert(_this, key, value, NULL, true);
+        if (__multimap_small_on(_this))
+            return t;
+    }
+
+    t = (multimap_node_t*)p_calloc(1, __multimap_node_bytes(_this));
     if (unlikely(is_null(t)))
         return NULL;
 
@@ -469,9 +674,94 @@ err:
     return NULL;
 }
 
+/* Links `node` next to `hint` if it belongs there, right before it first, else NULL */
+static multimap_node_t* __multimap_insert_hint(multimap_t* _this, multimap_node_t* node, multimap_node_t* hint)
+{
+    struct rb_node* h = &hint->node;
+    struct rb_node* n = NULL;
+
+    if (!__multimap_lt(_this, hint->key, node->key)) {
+        n = rb_prev(h);
+        if (!is_null(n) && __multimap_lt(_this, node->key, multimap_entry(n)->key))
+            return NULL;
+        return is_null(h->rb_left) ? __multimap_link(_this, node, h, &h->rb_left) : __multimap_link(_this, node, n, &n->rb_right);
+    }
+
+    n = rb_next(h);
+    if (!is_null(n) && __multimap_lt(_this, multimap_entry(n)->key, node->key))
+        return NULL;
+    return is_null(h->rb_right) ? __multimap_link(_this, node, h, &h->rb_right) : __multimap_link(_this, node, n, &n->rb_left);
+}
+
+/* `end`, or a `hint` out of place, falls back to `__multimap_insert`, which still appends in O(1) */
+static multimap_node_t* multimap_insert_hint(multimap_t* _this, multimap_node_t* hint, multimap_key_t key, multimap_value_t value)
+{
+    multimap_node_t* t = NULL;
+    multimap_node_t* ret = NULL;
+
+    if (unlikely(is_null(_this) || is_null(hint)))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return NULL;
+
+    if (__multimap_compress(_this))
+        return (multimap_node_t*)__mmc_insert(_this, key, value);
+
+    if (__multimap_small_on(_this)) {
+        t = __multimap_small_insert(_this, key, value, &hint, true);
+        if (__multimap_small_on(_this))
+            return t;
+    }
+
+    t = (multimap_node_t*)p_calloc(1, __multimap_node_bytes(_this));
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    if (!__multimap_node_fill(_this, t, key, value)) {
+        p_free(t);
+        return NULL;
+    }
+
+    if (__multimap_end(_this) != hint && __multimap_rend(_this) != hint)
+        ret = __multimap_insert_hint(_this, t, hint);
+
+    if (is_null(ret))
+        ret = __multimap_insert(_this, t);
+
+    if (t != ret)
+        goto err;
+    return t;
+
+err:
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&t->value);
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+        _this->ops->free_key(&t->key);
+
+    p_free(t);
+    return NULL;
+}
+
+static /* __always_inline */ inline void __multimap_node_free(multimap_t* _this, multimap_node_t* node)
+{
+    if (is_null(_this->blocks) || !ds_block_put(&_this->blocks, node))
+        p_free(node);
+}
+
 static /* __always_inline */ inline multimap_node_t* __multimap_erase(multimap_t* _this, multimap_node_t* pos)
 {
-    rb_erase(&pos->node, &_this->root);
+    if (&pos->node == _this->rightmost)
+        _this->rightmost = rb_prev(&pos->node);
+
+    if (multimap_os(_this))
+        rb_erase_augmented(&pos->node, &_this->root, &rb_size_augment);
+    else
+        rb_erase(&pos->node, &_this->root);
     _this->size--;
     return pos;
 }
@@ -488,6 +778,12 @@ static inline multimap_node_t* multimap_erase(multimap_t* _this, multimap_node_t
     if (__multimap_size(_this) <= 0 || __multimap_end(_this) == pos/* || __multimap_rend(_this) == pos*/)
         return NULL;
 
+    if (__multimap_compress(_this))
+        return (multimap_node_t*)__mmc_erase(_this, (multimap_cslot_t*)pos);
+
+    if (__multimap_small(_this))
+        return __multimap_small_erase(_this, pos);
+
     t = __multimap_next(_this, pos);
     if (is_null(t))
         return NULL;
@@ -500,9 +796,9 @@ static inline multimap_node_t* multimap_erase(multimap_t* _this, multimap_node_t
     if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
         _this->ops->free_value(&pos->value);
 
-    p_free(pos);
+    __multimap_node_free(_this, pos);
 
-    return t;
+    return __multimap_small_settle_at(_this, MULTIMAP_SMALL / 2, t);
 }
 
 static multimap_size_t multimap_remove(multimap_t* _this, multimap_key_t key)
@@ -520,6 +816,9 @@ static multimap_size_t multimap_remove(multimap_t* _this, multimap_key_t key)
     if (__multimap_end(_this) == t)
         return 0;
 
+    if (__multimap_compress(_this))
+        return __mmc_remove(_this, key);
+
     if (is_null(_this->ops) || is_null(_this->ops->__lt)) {
         for (; __multimap_end(_this) != t; ) {
             if (key != t->key)
@@ -549,6 +848,9 @@ static multimap_size_t multimap_remove_if(multimap_t* _this, remove_if_condition
     if (unlikely(is_null(_this) || is_null(cond)))
         return -1;
 
+    if (__multimap_compress(_this))
+        return __mmc_remove_if(_this, cond);
+
     for (t = __multimap_begin(_this); __multimap_end(_this) != t; ) {
         if (!cond(t->key, t->value)) {
             t = __multimap_next(_this, t);
@@ -562,25 +864,651 @@ static multimap_size_t multimap_remove_if(multimap_t* _this, remove_if_condition
     return ret;
 }
 
+/* Postorder, so nodes are freed without `rb_erase` keeping the tree balanced all along */
 static multimap_size_t multimap_clear(multimap_t* _this)
 {
     multimap_size_t ret = 0;
     multimap_node_t* t = NULL;
+    struct rb_node* n = NULL;
+    struct rb_node* next = NULL;
 
     if (unlikely(is_null(_this)))
         return -1;
 
-    for (t = __multimap_begin(_this); __multimap_end(_this) != t; ) {
-        t = multimap_erase(_this, t);
+    if (__multimap_compress(_this))
+        return __mmc_clear(_this);
+
+    if (__multimap_small(_this))
+        return __multimap_small_clear(_this);
+
+    for (n = rb_first_postorder(&_this->root); !is_null(n); n = next) {
+        next = rb_next_postorder(n);
+        t = multimap_entry(n);
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+            _this->ops->free_key(&t->key);
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+            _this->ops->free_value(&t->value);
+
+        __multimap_node_free(_this, t);
         ret++;
     }
 
+    _this->root = RB_ROOT;
+    _this->rightmost = NULL;
+    _this->size = 0;
     return ret;
 }
 
+static /* __always_inline */ inline bool __multimap_lt(const multimap_t* _this, multimap_key_t left, multimap_key_t right)
+{
+    return is_null(_this->ops) || is_null(_this->ops->__lt) ? left < right : _this->ops->__lt(left, right);
+}
+
+/* Count of keys < `key`, or <= `key` if `le` */
+static multimap_size_t __multimap_rank(const multimap_t* _this, multimap_key_t key, bool le)
+{
+    struct rb_node* n = _this->root.rb_node;
+    multimap_node_t* t = NULL;
+    multimap_size_t ret = 0;
+
+    if (__multimap_small(_this))
+        return __multimap_small_bound(_this, key, le);
+
+    if (!multimap_os(_this)) {
+        for (t = __multimap_begin(_this); __multimap_end(_this) != t; t = __multimap_next(_this, t), ret++) {
+            if (le ? __multimap_lt(_this, key, t->key) : !__multimap_lt(_this, t->key, key))
+                break;
+        }
+        return ret;
+    }
+
+    while (!is_null(n)) {
+        t = multimap_entry(n);
+
+        if (le ? __multimap_lt(_this, key, t->key) : !__multimap_lt(_this, t->key, key)) {
+            n = n->rb_left;
+        } else {
+            ret += rb_size_of(n->rb_left) + 1;
+            n = n->rb_right;
+        }
+    }
+    return ret;
+}
+
+static multimap_size_t multimap_rank(const multimap_t* _this, multimap_key_t key)
+{
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return -1;
+
+    if (__multimap_compress(_this))
+        return __mmc_rank(_this, key);
+    return __multimap_rank(_this, key, false);
+}
+
+static multimap_node_t* multimap_select(const multimap_t* _this, multimap_size_t k)
+{
+    struct rb_node* n = NULL;
+    multimap_node_t* t = NULL;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (k < 0 || k >= __multimap_size(_this))
+        return __multimap_end(_this);
+
+    if (__multimap_compress(_this))
+        return (multimap_node_t*)__mmc_select(_this, k);
+
+    if (__multimap_small(_this))
+        return __multimap_small_at(_this, k);
+
+    if (multimap_os(_this)) {
+        n = rb_select(&_this->root, k);
+        return is_null(n) ? NULL : multimap_entry(n);
+    }
+
+    for (t = __multimap_begin(_this); k > 0; --k)
+        t = __multimap_next(_this, t);
+    return t;
+}
+
+static multimap_size_t multimap_count_range(const multimap_t* _this, multimap_key_t lo, multimap_key_t hi)
+{
+    multimap_size_t ret = 0;
+    multimap_node_t* t = NULL;
+
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && (!_this->ops->valid_key(lo) || !_this->ops->valid_key(hi)))
+        return -1;
+
+    if (!__multimap_lt(_this, lo, hi))
+        return 0;
+
+    if (__multimap_compress(_this))
+        return __mmc_count_range(_this, lo, hi);
+
+    if (multimap_os(_this) || __multimap_small(_this))
+        return __multimap_rank(_this, hi, false) - __multimap_rank(_this, lo, false);
+
+    t = __multimap_lower_bound(_this, lo);
+    for (; !is_null(t) && __multimap_end(_this) != t && __multimap_lt(_this, t->key, hi); t = __multimap_next(_this, t))
+        ret++;
+    return ret;
+}
+
+static multimap_node_t* multimap_equal_range(const multimap_t* _this, multimap_key_t key, multimap_node_t** last)
+{
+    multimap_node_t* t = NULL;
+    multimap_node_t* u = NULL;
+
+    if (unlikely(is_null(_this) || is_null(last)))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return NULL;
+
+    if (__multimap_compress(_this))
+        return (multimap_node_t*)__mmc_equal_range(_this, key, (multimap_cslot_t**)last);
+
+    if (__multimap_small(_this)) {
+        *last = __multimap_small_at(_this, __multimap_small_bound(_this, key, true));
+        *last = is_null(*last) ? __multimap_end(_this) : *last;
+        t = __multimap_small_at(_this, __multimap_small_bound(_this, key, false));
+        return is_null(t) ? __multimap_end(_this) : t;
+    }
+
+    t = __multimap_lower_bound(_this, key);
+    u = __multimap_upper_bound(_this, key);
+    *last = is_null(u) ? __multimap_end(_this) : u;
+    return is_null(t) ? __multimap_end(_this) : t;
+}
+
+/* One descent to `lo`, then the nodes before `hi` are unlinked in order, chained through
+   `rb_right`, and freed together. A range covering every node is a `clear` */
+static multimap_size_t multimap_erase_range(multimap_t* _this, multimap_key_t lo, multimap_key_t hi)
+{
+    multimap_node_t* t = NULL;
+    struct rb_node* n = NULL;
+    struct rb_node* next = NULL;
+    struct rb_node* head = NULL;
+    multimap_size_t ret = 0;
+
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && (!_this->ops->valid_key(lo) || !_this->ops->valid_key(hi)))
+        return -1;
+
+    if (!__multimap_lt(_this, lo, hi))
+        return 0;
+
+    if (__multimap_compress(_this))
+        return __mmc_erase_range(_this, lo, hi);
+
+    if (__multimap_small(_this))
+        return __multimap_small_erase_range(_this, lo, hi);
+
+    t = __multimap_lower_bound(_this, lo);
+    if (is_null(t))
+        return 0;
+
+    if (&t->node == rb_first(&_this->root) && __multimap_lt(_this, multimap_entry(_this->rightmost)->key, hi))
+        return multimap_clear(_this);
+
+    for (n = &t->node; !is_null(n) && __multimap_lt(_this, multimap_entry(n)->key, hi); n = next) {
+        next = rb_next(n);
+        __multimap_erase(_this, multimap_entry(n));
+        n->rb_right = head;
+        head = n;
+        ret++;
+    }
+
+    for (n = head; !is_null(n); n = next) {
+        next = n->rb_right;
+        t = multimap_entry(n);
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+            _this->ops->free_key(&t->key);
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+            _this->ops->free_value(&t->value);
+
+        __multimap_node_free(_this, t);
+    }
+
+    __multimap_small_settle(_this, MULTIMAP_SMALL / 2);
+    return ret;
+}
+
+static multimap_size_t multimap_for_each_range(const multimap_t* _this, multimap_key_t lo, multimap_key_t hi, for_each_kv cb, void* arg)
+{
+    multimap_node_t* t = NULL;
+    struct rb_node* n = NULL;
+    multimap_size_t i = 0;
+    multimap_size_t ret = 0;
+
+    if (unlikely(is_null(_this) || is_null(cb)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && (!_this->ops->valid_key(lo) || !_this->ops->valid_key(hi)))
+        return -1;
+
+    if (!__multimap_lt(_this, lo, hi))
+        return 0;
+
+    if (__multimap_compress(_this))
+        return __mmc_for_each_range(_this, lo, hi, cb, arg);
+
+    if (__multimap_small(_this)) {
+        for (i = __multimap_small_bound(_this, lo, false); i < __multimap_size(_this) && __multimap_lt(_this, _this->small->keys[i], hi); ++i) {
+            t = __multimap_small_at(_this, i);
+            ret++;
+            if (!cb(t->key, t->value, arg))
+                break;
+        }
+        return ret;
+    }
+
+    t = __multimap_lower_bound(_this, lo);
+    for (n = is_null(t) ? NULL : &t->node; !is_null(n) && __multimap_lt(_this, multimap_entry(n)->key, hi); n = rb_next(n)) {
+        ret++;
+        if (!cb(multimap_entry(n)->key, multimap_entry(n)->value, arg))
+            break;
+    }
+    return ret;
+}
+
+/* What keeps the subtree sizes through a split or a join, a compressed node weighs its count */
+static /* __always_inline */ inline const struct rb_augment_callbacks* __multimap_augment(const multimap_t* _this)
+{
+    if (!multimap_os(_this))
+        return NULL;
+    return __multimap_compress(_this) ? &mmc_weight_augment : &rb_size_augment;
+}
+
+/* Count of `l` after a split of `total` values, `l` and `r` are walked in step so only the smaller one is walked through */
+static multimap_size_t __multimap_split_size(const multimap_t* _this, const struct rb_root* l, const struct rb_root* r, multimap_size_t total)
+{
+    struct rb_node* a = rb_first(l);
+    struct rb_node* b = rb_first(r);
+    multimap_size_t na = 0, nb = 0;
+
+    if (multimap_os(_this))
+        return (multimap_size_t)rb_size_of(l->rb_node);
+
+    for (; !is_null(a) && !is_null(b); a = rb_next(a), b = rb_next(b)) {
+        na += __multimap_compress(_this) ? mmc_entry(a)->count : 1;
+        nb += __multimap_compress(_this) ? mmc_entry(b)->count : 1;
+    }
+    return is_null(a) ? na : total - nb;
+}
+
+/* The blocks follow their nodes: those of the smaller half are marked, a block with nodes on
+   both sides is shared by the halves. Only plain nodes come in blocks */
+static void __multimap_split_blocks(ds_block_t* blocks, ds_block_t* spare, multimap_t* left, multimap_t* right)
+{
+    bool lesser = __multimap_size(left) <= __multimap_size(right);
+    multimap_t* t = lesser ? left : right;
+    ds_block_t* moved = NULL;
+    struct rb_node* n = NULL;
+
+    if (is_null(blocks))
+        return;
+
+    for (n = rb_first(&t->root); !is_null(n); n = rb_next(n))
+        ds_block_mark(blocks, multimap_entry(n));
+
+    ds_block_split(&blocks, &moved, spare);
+    ds_block_splice(&left->blocks, lesser ? &moved : &blocks);
+    ds_block_splice(&right->blocks, lesser ? &blocks : &moved);
+}
+
+/* The nodes move as they are, so `t` must be empty with the same ops and config, or `_this` itself */
+static /* __always_inline */ inline bool __multimap_split_into(const multimap_t* _this, const multimap_t* t)
+{
+    return t == _this || (0 == __multimap_size(t) && t->ops == _this->ops && t->config.d == _this->config.d);
+}
+
+static multimap_size_t multimap_split(multimap_t* _this, multimap_key_t key, multimap_t* left, multimap_t* right)
+{
+    struct rb_root l = RB_ROOT;
+    struct rb_root r = RB_ROOT;
+    struct rb_node* rightmost = NULL;
+    struct rb_node* n = NULL;
+    multimap_cnode_t* c = NULL;
+    multimap_node_t* t = NULL;
+    multimap_size_t total = 0;
+    ds_block_t* blocks = NULL;
+    ds_block_t* spare = NULL;
+
+    if (unlikely(is_null(_this) || is_null(left) || is_null(right) || left == right))
+        return -1;
+
+    if (!__multimap_split_into(_this, left) || !__multimap_split_into(_this, right))
+        return -1;
+
+    /* The array goes to the tree to be split, the halves settle after */
+    if (!__multimap_small_off(left) || !__multimap_small_off(right) || !__multimap_small_off(_this))
+        return -1;
+
+    if (!ds_block_spare(_this->blocks, &spare))
+        return -1;
+
+    if (__multimap_compress(_this)) {
+        c = __mmc_bound(_this, key, false);
+        n = is_null(c) ? NULL : &c->node;
+    } else {
+        t = __multimap_lower_bound(_this, key);
+        n = is_null(t) ? NULL : &t->node;
+    }
+
+    l = _this->root;
+    total = __multimap_size(_this);
+    rightmost = _this->rightmost;
+    if (!is_null(n))
+        rb_split(&l, n, &r, __multimap_augment(_this));
+
+    blocks = _this->blocks;
+    _this->root = RB_ROOT;
+    _this->rightmost = NULL;
+    _this->blocks = NULL;
+    _this->size = 0;
+
+    left->root = l;
+    left->size = __multimap_split_size(_this, &l, &r, total);
+    left->rightmost = __multimap_compress(left) ? NULL : (is_null(r.rb_node) ? rightmost : rb_last(&l));
+    right->root = r;
+    right->size = total - left->size;
+    right->rightmost = is_null(r.rb_node) ? NULL : rightmost;
+
+    __multimap_split_blocks(blocks, spare, left, right);
+
+    __multimap_small_settle(left, MULTIMAP_SMALL);
+    __multimap_small_settle(right, MULTIMAP_SMALL);
+    return __multimap_size(left);
+}
+
+static multimap_size_t multimap_join(multimap_t* _this, multimap_t* other)
+{
+    struct rb_node* last = NULL;
+    struct rb_node* first = NULL;
+
+    if (unlikely(is_null(_this) || is_null(other) || _this == other))
+        return -1;
+
+    if (other->ops != _this->ops || other->config.d != _this->config.d)
+        return -1;
+
+    if (0 == __multimap_size(other))
+        return __multimap_size(_this);
+
+    if (__multimap_size(_this) > 0 && !__multimap_compress(_this) && __multimap_lt(_this, __multimap_begin(other)->key, __multimap_rbegin(_this)->key))
+        return -1;
+
+    if (!__multimap_small_off(_this) || !__multimap_small_off(other))
+        return -1;
+
+    last = rb_last(&_this->root);
+    first = rb_first(&other->root);
+    if (!is_null(last) && __multimap_compress(_this) && !__multimap_lt(_this, mmc_entry(last)->key, mmc_entry(first)->key))
+        return -1;
+
+    rb_concat(&_this->root, &other->root, __multimap_augment(_this));
+    ds_block_splice(&_this->blocks, &other->blocks);
+    _this->rightmost = other->rightmost;
+    _this->size += other->size;
+
+    other->rightmost = NULL;
+    other->size = 0;
+
+    __multimap_small_settle(_this, MULTIMAP_SMALL);
+    return __multimap_size(_this);
+}
+
+/* The key, the value and the node memory go to `handle`, unless the node is in a block or the entry in the array */
+static multimap_node_t* multimap_extract(multimap_t* _this, multimap_node_t* pos, ds_node_handle_t* handle)
+{
+    multimap_node_t* t = NULL;
+    multimap_size_t i = 0;
+
+    if (unlikely(is_null(_this) || is_null(pos) || is_null(handle) || handle->full))
+        return NULL;
+
+    if (__multimap_size(_this) <= 0 || __multimap_end(_this) == pos)
+        return NULL;
+
+    if (__multimap_compress(_this))
+        return (multimap_node_t*)__mmc_extract(_this, (multimap_cslot_t*)pos, handle);
+
+    if (__multimap_small(_this)) {
+        i = __multimap_small_index(_this, pos);
+        if (i < 0)
+            return NULL;
+
+        handle->key = pos->key;
+        handle->value = pos->value;
+        handle->full = true;
+
+        __multimap_small_close(_this, i);
+        return i < __multimap_size(_this) ? __multimap_small_at(_this, i) : __multimap_end(_this);
+    }
+
+    t = __multimap_next(_this, pos);
+    if (is_null(t))
+        return NULL;
+
+    __multimap_erase(_this, pos);
+
+    handle->key = pos->key;
+    handle->value = pos->value;
+    handle->full = true;
+
+    if (is_null(_this->blocks) || !ds_block_put(&_this->blocks, pos))
+        ds_node_handle_put(handle, pos, __multimap_node_bytes(_this));
+
+    return __multimap_small_settle_at(_this, MULTIMAP_SMALL / 2, t);
+}
+
+static multimap_node_t* multimap_insert_node(multimap_t* _this, ds_node_handle_t* handle)
+{
+    multimap_node_t* t = NULL;
+
+    if (unlikely(is_null(_this) || is_null(handle) || !handle->full))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(handle->value))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(handle->key))
+        return NULL;
+
+    if (__multimap_compress(_this))
+        return (multimap_node_t*)__mmc_insert_node(_this, handle);
+
+    if (__multimap_small_on(_this)) {
+        t = __multimap_small_insert(_this, handle->key, handle->value, NULL, false);
+        if (!is_null(t))
+            ds_node_handle_release(handle);
+        if (__multimap_small_on(_this))
+            return t;
+    }
+
+    t = (multimap_node_t*)ds_node_handle_take(handle, __multimap_node_bytes(_this));
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    t->key = handle->key;
+    t->value = handle->value;
+    handle->full = false;
+    return __multimap_insert(_this, t);
+}
+
+static void multimap_free_node(multimap_t* _this, ds_node_handle_t* handle)
+{
+    if (unlikely(is_null(_this) || is_null(handle)))
+        return;
+
+    if (handle->full && !is_null(_this->ops) && !is_null(_this->ops->free_key))
+        _this->ops->free_key(&handle->key);
+
+    if (handle->full && !is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&handle->value);
+
+    ds_node_handle_release(handle);
+}
+
+static bool __multimap_lt_default(multimap_key_t left, multimap_key_t right)
+{
+    return left < right;
+}
+
+static bool __multimap_node_fill(multimap_t* _this, multimap_node_t* t, multimap_key_t key, multimap_value_t value)
+{
+    if (is_null(_this->ops) || is_null(_this->ops->copy_key)) {
+        t->key = key;
+    } else {
+        if (!_this->ops->copy_key(key, &t->key))
+            return false;
+    }
+
+    if (is_null(_this->ops) || is_null(_this->ops->copy_value)) {
+        t->value = value;
+    } else {
+        if (!_this->ops->copy_value(value, &t->value)) {
+            if (!is_null(_this->ops->free_key))
+                _this->ops->free_key(&t->key);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* The nodes are chained in order through `rb_right`, then linked into a balanced tree at once */
+static multimap_size_t multimap_build_sorted(multimap_t* _this, const multimap_key_t* keys, const multimap_value_t* values, multimap_size_t n, bool contiguous)
+{
+    __comp lt = NULL;
+    ds_data_t* kv = NULL;       /* The pairs sorted, if the input isn't */
+    ds_size_t step = 1;
+    multimap_node_t* nodes = NULL;
+    multimap_node_t* t = NULL;
+    struct rb_node* head = NULL;
+    struct rb_node** tail = &head;
+    multimap_size_t i, m = 0;
+
+    if (unlikely(is_null(_this) || n < 0 || (n > 0 && is_null(keys))))
+        return -1;
+
+    if (__multimap_size(_this) > 0)
+        return -1;
+
+    __multimap_small_off(_this);
+
+    for (i = 0; i < n; ++i) {
+        if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(keys[i]))
+            return -1;
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(is_null(values) ? 0 : values[i]))
+            return -1;
+    }
+
+    lt = is_null(_this->ops) || is_null(_this->ops->__lt) ? __multimap_lt_default : _this->ops->__lt;
+
+    for (i = 1; i < n && !lt(keys[i], keys[i - 1]); ++i)
+        ;
+
+    if (i < n) {
+        kv = (ds_data_t*)p_malloc(n * 2 * sizeof(ds_data_t));
+        if (unlikely(is_null(kv)))
+            return -1;
+
+        for (i = 0; i < n; ++i) {
+            kv[i * 2] = keys[i];
+            kv[i * 2 + 1] = is_null(values) ? 0 : values[i];
+        }
+
+        if (!__sort_merge_n(kv, n, 2, lt)) {
+            p_free(kv);
+            return -1;
+        }
+
+        keys = kv;
+        values = kv + 1;
+        step = 2;
+    }
+
+    if (__multimap_compress(_this)) {
+        m = __mmc_build_sorted(_this, keys, values, step, n, lt);
+        p_free(kv);
+        return m;
+    }
+
+    if (contiguous && n > 0) {
+        nodes = (multimap_node_t*)ds_block_alloc(&_this->blocks, n, __multimap_node_bytes(_this));
+        if (unlikely(is_null(nodes)))
+            goto err;
+    }
+
+    for (i = 0; i < n; ++i) {
+        t = contiguous ? (multimap_node_t*)((char*)nodes + m * __multimap_node_bytes(_this)) : (multimap_node_t*)p_calloc(1, __multimap_node_bytes(_this));
+        if (unlikely(is_null(t)))
+            goto err;
+
+        if (!__multimap_node_fill(_this, t, keys[i * step], is_null(values) ? 0 : values[i * step])) {
+            if (!contiguous)
+                p_free(t);
+            goto err;
+        }
+
+        *tail = &t->node;
+        tail = &t->node.rb_right;
+        m++;
+    }
+
+    rb_build_sorted(&_this->root, head, m);
+    _this->rightmost = rb_last(&_this->root);
+    if (multimap_os(_this))
+        rb_size_build(&_this->root);
+    _this->size = m;
+    p_free(kv);
+
+    __multimap_small_settle(_this, MULTIMAP_SMALL);
+    return m;
+
+err:
+    while (!is_null(head)) {
+        t = multimap_entry(head);
+        head = head->rb_right;
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+            _this->ops->free_key(&t->key);
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+            _this->ops->free_value(&t->value);
+
+        if (!contiguous)
+            p_free(t);
+    }
+
+    if (!is_null(nodes))
+        ds_block_free(&_this->blocks, nodes);
+    p_free(kv);
+    return -1;
+}
+
 /* __always_inline */ inline void __multimap_init(multimap_t* multimap)
 {
     multimap->root = RB_ROOT;
+    multimap->blocks = NULL;
+    multimap->rightmost = NULL;
+    multimap->small = NULL;
 }
 
 /* __always_inline */ inline void __multimap_deinit(multimap_t* multimap)
@@ -601,32 +1529,53 @@ typedef multimap_r_iterator_t* (*fp_rbegin)(const multimap_t* _this);
 typedef multimap_r_iterator_t* (*fp_rnext)(const multimap_t* _this, const multimap_r_iterator_t* r_iterator);
 typedef multimap_r_iterator_t* (*fp_rprev)(const multimap_t* _this, const multimap_r_iterator_t* r_iterator);
 typedef multimap_iterator_t* (*fp_find)(const multimap_t* _this, multimap_key_t key);
+typedef multimap_size_t (*fp_find_sorted)(const multimap_t* _this, const multimap_key_t* keys, multimap_size_t n, multimap_iterator_t** out);
 typedef multimap_iterator_t* (*fp_lower_bound)(const multimap_t* _this, multimap_key_t key);
 typedef multimap_iterator_t* (*fp_upper_bound)(const multimap_t* _this, multimap_key_t key);
 typedef multimap_iterator_t* (*fp_insert)(multimap_t* _this, multimap_key_t key, multimap_value_t value);
 typedef multimap_iterator_t* (*fp_erase)(multimap_t* _this, multimap_iterator_t* iterator);
+typedef multimap_iterator_t* (*fp_insert_hint)(multimap_t* _this, multimap_iterator_t* hint, multimap_key_t key, multimap_value_t value);
+typedef multimap_iterator_t* (*fp_equal_range)(const multimap_t* _this, multimap_key_t key, multimap_iterator_t** last);
+typedef multimap_iterator_t* (*fp_select)(const multimap_t* _this, multimap_size_t k);
+typedef multimap_iterator_t* (*fp_extract)(multimap_t* _this, multimap_iterator_t* iterator, ds_node_handle_t* handle);
+typedef multimap_iterator_t* (*fp_insert_node)(multimap_t* _this, ds_node_handle_t* handle);
 
 const class_multimap_t* class_multimap_ins(void)
 {
     static const class_multimap_t ins = {
-        .size        = _multimap_size,
-        .count       = multimap_count,
-        .end         = (fp_end)__multimap_end,
-        .begin       = (fp_begin)_multimap_begin,
-        .next        = (fp_next)_multimap_next,
-        .prev        = (fp_prev)_multimap_prev,
-        .rend        = (fp_rend)__multimap_rend,
-        .rbegin      = (fp_rbegin)_multimap_rbegin,
-        .rnext       = (fp_rnext)_multimap_rnext,
-        .rprev       = (fp_rprev)_multimap_rprev,
-        .find        = (fp_find)multimap_find,
-        .lower_bound = (fp_lower_bound)multimap_lower_bound,
-        .upper_bound = (fp_upper_bound)multimap_upper_bound,
-        .insert      = (fp_insert)multimap_insert,
-        .erase       = (fp_erase)multimap_erase,
-        .remove      = multimap_remove,
-        .remove_if   = multimap_remove_if,
-        .clear       = multimap_clear,
+        .size           = _multimap_size,
+        .count          = multimap_count,
+        .end            = (fp_end)__multimap_end,
+        .begin          = (fp_begin)_multimap_begin,
+        .next           = (fp_next)_multimap_next,
+        .prev           = (fp_prev)_multimap_prev,
+        .rend           = (fp_rend)__multimap_rend,
+        .rbegin         = (fp_rbegin)_multimap_rbegin,
+        .rnext          = (fp_rnext)_multimap_rnext,
+        .rprev          = (fp_rprev)_multimap_rprev,
+        .find           = (fp_find)multimap_find,
+        .contains_sorted = multimap_contains_sorted,
+        .find_sorted     = (fp_find_sorted)multimap_find_sorted,
+        .lower_bound    = (fp_lower_bound)multimap_lower_bound,
+        .upper_bound    = (fp_upper_bound)multimap_upper_bound,
+        .insert         = (fp_insert)multimap_insert,
+        .erase          = (fp_erase)multimap_erase,
+        .remove         = multimap_remove,
+        .remove_if      = multimap_remove_if,
+        .clear          = multimap_clear,
+        .build_sorted   = multimap_build_sorted,
+        .rank           = multimap_rank,
+        .select         = (fp_select)multimap_select,
+        .count_range    = multimap_count_range,
+        .insert_hint    = (fp_insert_hint)multimap_insert_hint,
+        .equal_range    = (fp_equal_range)multimap_equal_range,
+        .erase_range    = multimap_erase_range,
+        .for_each_range = multimap_for_each_range,
+        .split          = multimap_split,
+        .join           = multimap_join,
+        .extract        = (fp_extract)multimap_extract,
+        .insert_node    = (fp_insert_node)multimap_insert_node,
+        .free_node      = multimap_free_node,
     };
     return &ins;
 }
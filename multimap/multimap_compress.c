@@ -0,0 +1,881 @@
+/*
+  Multimap Compressed Mode Implementations
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/* Included by multimap/multimap.c.
+   In compressed mode equal keys share one `multimap_cnode_t`, the key copied in once, so
+   `count` is one descent. Only the first of equal keys is kept. With `b_order_stat` a node
+   weighs its count, so `rank`, `select` and `count_range` stay O(log n) over the distinct keys.
+   An iterator is read as `it->key` and `it->value`, so each value is a pair of words, the
+   first one the key pointer of the node again: the pairs are packed MMC_PAIRS to a 128-byte
+   line of a run of the node, and the first word of a line is the address of its run with the
+   pairs of the line still alive in its low bits, which 128-byte aligned runs leave free. That
+   is about 18 bytes per value instead of a 48-byte node. Pairs never move, so iterators
+   compare, survive inserts and erases of other entries, and `it->value` is written in place,
+   as with plain nodes */
+
+#include <multimap/multimap.h>
+
+#include <string.h>
+#include <_memory.h>
+#include <_handle.h>
+#include <sort/sort.h>
+#include <linux/rbtree.h>
+#include <linux/_compiler.h>
+#include <iterator/iterator.h>
+
+#define MMC_LINE       (128)
+#define MMC_PAIRS      (7)   /* Pairs of a line, after the words naming its run */
+#define MMC_RUN_ALIGN  (128) /* Leaves MMC_PAIRS low bits of a run address free */
+#define MMC_LINES_MAX  (32)
+
+/* An iterator of a compressed multimap, the pair of a value in its line */
+typedef struct multimap_cslot {
+    multimap_key_t key;      /* Must be first, as in `multimap_iterator_t`, the key of the node */
+    multimap_value_t value;
+} multimap_cslot_t;
+
+/* The lines of a run follow its header, each at MMC_LINE bytes */
+struct multimap_crun {
+    multimap_cnode_t* cnode;
+    multimap_crun_t* prev;
+    multimap_crun_t* next;
+    uint16_t shift;          /* From what `p_malloc` returned up to the run */
+    uint16_t lines;
+    uint16_t used;           /* Pairs handed out, erased ones included */
+    uint16_t live;
+};
+
+#define mmc_entry(ptr)     rb_entry((ptr), struct multimap_cnode, node)
+#define mmc_line_of(slot)  ((uintptr_t*)((uintptr_t)(slot) & ~(uintptr_t)(MMC_LINE - 1)))
+#define mmc_run_of(line)   ((multimap_crun_t*)((line)[0] & ~(uintptr_t)(MMC_RUN_ALIGN - 1)))
+#define mmc_mask_of(line)  ((uint32_t)((line)[0] & (MMC_RUN_ALIGN - 1)))
+
+static /* __always_inline */ inline bool __multimap_compress(const multimap_t* _this)
+{
+    return _this->config.c.b_compress;
+}
+
+static /* __always_inline */ inline size_t __mmc_node_bytes(const multimap_t* _this)
+{
+    return sizeof(multimap_cnode_t) + (_this->config.c.b_order_stat ? RB_SIZE_EXTRA : 0);
+}
+
+static /* __always_inline */ inline bool __mmc_lt(const multimap_t* _this, multimap_key_t left, multimap_key_t right)
+{
+    if (is_null(_this->ops) || is_null(_this->ops->__lt))
+        return left < right;
+    return _this->ops->__lt(left, right);
+}
+
+static /* __always_inline */ inline int __mmc_cmp(const multimap_t* _this, multimap_key_t left, multimap_key_t right)
+{
+    if (!is_null(_this->ops) && !is_null(_this->ops->__lt) && !is_null(_this->ops->__cmp))
+        return _this->ops->__cmp(left, right);
+    return __mmc_lt(_this, left, right) ? -1 : __mmc_lt(_this, right, left) ? 1 : 0;
+}
+
+static /* __always_inline */ inline multimap_cslot_t* __mmc_end(const multimap_t* _this)
+{
+    return (multimap_cslot_t*)iterator_end();
+}
+
+static /* __always_inline */ inline multimap_cslot_t* __mmc_rend(const multimap_t* _this)
+{
+    return (multimap_cslot_t*)iterator_rend();
+}
+
+/* A node weighs its count, so `rb_size` is the count of values under it */
+static /* __always_inline */ inline unsigned long __mmc_weight(struct rb_node* n)
+{
+    return (unsigned long)mmc_entry(n)->count + rb_size_of(n->rb_left) + rb_size_of(n->rb_right);
+}
+
+static void __mmc_weight_propagate(struct rb_node* n, struct rb_node* stop)
+{
+    for (; n != stop; n = rb_parent(n))
+        rb_size(n) = __mmc_weight(n);
+}
+
+static void __mmc_weight_copy(struct rb_node* old, struct rb_node* new)
+{
+    rb_size(new) = rb_size(old);
+}
+
+static void __mmc_weight_rotate(struct rb_node* old, struct rb_node* new)
+{
+    rb_size(new) = rb_size(old);
+    rb_size(old) = __mmc_weight(old);
+}
+
+static const struct rb_augment_callbacks mmc_weight_augment = {
+    .propagate = __mmc_weight_propagate,
+    .copy = __mmc_weight_copy,
+    .rotate = __mmc_weight_rotate,
+};
+
+static void __mmc_weight_build(struct rb_root* root)
+{
+    struct rb_node* n = NULL;
+
+    for (n = rb_first_postorder(root); !is_null(n); n = rb_next_postorder(n))
+        rb_size(n) = __mmc_weight(n);
+}
+
+/* The count of `t` changed, the weights up to the root follow */
+static /* __always_inline */ inline void __mmc_reweigh(const multimap_t* _this, multimap_cnode_t* t)
+{
+    if (_this->config.c.b_order_stat)
+        __mmc_weight_propagate(&t->node, NULL);
+}
+
+static /* __always_inline */ inline uintptr_t* __mmc_line(const multimap_crun_t* r, uint32_t i)
+{
+    return (uintptr_t*)((char*)r + MMC_LINE * (i + 1));
+}
+
+static /* __always_inline */ inline multimap_cslot_t* __mmc_pair(const multimap_crun_t* r, uint32_t i)
+{
+    return (multimap_cslot_t*)__mmc_line(r, i / MMC_PAIRS) + 1 + i % MMC_PAIRS;
+}
+
+/* Index of `s` in its run, lines before it included */
+static /* __always_inline */ inline uint32_t __mmc_idx(const multimap_crun_t* r, const multimap_cslot_t* s)
+{
+    uintptr_t* l = mmc_line_of(s);
+    return (uint32_t)(((char*)l - (char*)r) / MMC_LINE - 1) * MMC_PAIRS + (uint32_t)(s - (multimap_cslot_t*)l - 1);
+}
+
+static /* __always_inline */ inline multimap_crun_t* __mmc_run(const multimap_cslot_t* s)
+{
+    return mmc_run_of(mmc_line_of(s));
+}
+
+/* The pair no longer counts as alive in its line */
+static /* __always_inline */ inline void __mmc_unmark(const multimap_cslot_t* s)
+{
+    uintptr_t* l = mmc_line_of(s);
+    l[0] &= ~((uintptr_t)1 << (s - (multimap_cslot_t*)l - 1));
+}
+
+/* First live pair from index `i` of `r` on, through the following runs */
+static multimap_cslot_t* __mmc_live_from(const multimap_crun_t* r, uint32_t i)
+{
+    uint32_t mask;
+
+    for (; !is_null(r); r = r->next, i = 0) {
+        for (; i < r->used; i = (i / MMC_PAIRS + 1) * MMC_PAIRS) {
+            mask = mmc_mask_of(__mmc_line(r, i / MMC_PAIRS)) >> (i % MMC_PAIRS);
+            if (0 != mask)
+                return __mmc_pair(r, i + __builtin_ctz(mask));
+        }
+    }
+    return NULL;
+}
+
+/* Last live pair before index `i` of `r`, through the preceding runs */
+static multimap_cslot_t* __mmc_live_before(const multimap_crun_t* r, uint32_t i)
+{
+    uint32_t mask, base;
+
+    while (!is_null(r)) {
+        while (i > 0) {
+            base = (i - 1) / MMC_PAIRS * MMC_PAIRS;
+            mask = mmc_mask_of(__mmc_line(r, base / MMC_PAIRS)) & ((1U << (i - base)) - 1);
+            if (0 != mask)
+                return __mmc_pair(r, base + 31 - __builtin_clz(mask));
+            i = base;
+        }
+
+        r = r->prev;
+        i = is_null(r) ? 0 : r->used;
+    }
+    return NULL;
+}
+
+/* A node always has a live pair, the runs left empty are freed */
+static /* __always_inline */ inline multimap_cslot_t* __mmc_first(const multimap_cnode_t* t)
+{
+    return __mmc_live_from(t->head, 0);
+}
+
+static /* __always_inline */ inline multimap_cslot_t* __mmc_last(const multimap_cnode_t* t)
+{
+    return __mmc_live_before(t->tail, t->tail->used);
+}
+
+/* The `k`th live pair of `t` */
+static multimap_cslot_t* __mmc_nth(const multimap_cnode_t* t, multimap_size_t k)
+{
+    const multimap_crun_t* r = t->head;
+    uint32_t i, mask;
+
+    for (; k >= r->live; r = r->next)
+        k -= r->live;
+
+    for (i = 0; ; ++i) {
+        mask = mmc_mask_of(__mmc_line(r, i));
+        if (k < __builtin_popcount(mask)) {
+            for (; k > 0; --k)
+                mask &= mask - 1;
+            return __mmc_pair(r, i * MMC_PAIRS + __builtin_ctz(mask));
+        }
+        k -= __builtin_popcount(mask);
+    }
+}
+
+static /* __always_inline */ inline void __mmc_run_free(multimap_crun_t* r)
+{
+    char* raw = (char*)r - r->shift;
+    p_free(raw);
+}
+
+/* A new pair after the others of `t`, its value left to the caller.
+   A full tail run is followed by one of as many lines as `t` fills up to MMC_LINES_MAX */
+static multimap_cslot_t* __mmc_slot(multimap_cnode_t* t)
+{
+    multimap_crun_t* r = t->tail;
+    multimap_cslot_t* s = NULL;
+    uintptr_t* l = NULL;
+    char* raw = NULL;
+    uint32_t lines, i;
+
+    if (is_null(r) || r->used == r->lines * MMC_PAIRS) {
+        lines = (uint32_t)(t->count / MMC_PAIRS);
+        lines = lines < 1 ? 1 : lines > MMC_LINES_MAX ? MMC_LINES_MAX : lines;
+        raw = (char*)p_malloc(MMC_LINE * (lines + 1) + MMC_RUN_ALIGN - 1);
+        if (unlikely(is_null(raw)))
+            return NULL;
+
+        r = (multimap_crun_t*)(((uintptr_t)raw + MMC_RUN_ALIGN - 1) & ~(uintptr_t)(MMC_RUN_ALIGN - 1));
+        r->shift = (uint16_t)((char*)r - raw);
+        r->cnode = t;
+        r->prev = t->tail;
+        r->next = NULL;
+        r->lines = (uint16_t)lines;
+        r->used = 0;
+        r->live = 0;
+        for (i = 0; i < lines; ++i)
+            __mmc_line(r, i)[0] = (uintptr_t)r;
+
+        if (is_null(t->tail))
+            t->head = r;
+        else
+            t->tail->next = r;
+        t->tail = r;
+    }
+
+    i = r->used++;
+    l = __mmc_line(r, i / MMC_PAIRS);
+    l[0] |= (uintptr_t)1 << (i % MMC_PAIRS);
+    s = (multimap_cslot_t*)l + 1 + i % MMC_PAIRS;
+    s->key = t->key;
+    r->live++;
+    t->count++;
+    return s;
+}
+
+/* The pair is erased, its value left to the caller. Its run is freed with the last live pair of it, `t` keeps another one */
+static void __mmc_kill(multimap_cslot_t* s)
+{
+    multimap_crun_t* r = __mmc_run(s);
+    multimap_cnode_t* t = r->cnode;
+
+    __mmc_unmark(s);
+    r->live--;
+    t->count--;
+    while (r->used > 0 && !(mmc_mask_of(__mmc_line(r, (r->used - 1) / MMC_PAIRS)) & (1U << ((r->used - 1) % MMC_PAIRS))))
+        r->used--;
+
+    if (r->live > 0)
+        return ;
+
+    if (is_null(r->prev))
+        t->head = r->next;
+    else
+        r->prev->next = r->next;
+
+    if (is_null(r->next))
+        t->tail = r->prev;
+    else
+        r->next->prev = r->prev;
+    __mmc_run_free(r);
+}
+
+/* The values still alive are freed with their runs */
+static void __mmc_runs_free(multimap_t* _this, multimap_cnode_t* t)
+{
+    multimap_crun_t* r = t->head;
+    multimap_crun_t* next = NULL;
+    multimap_cslot_t* s = NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value)) {
+        for (s = __mmc_live_from(r, 0); !is_null(s); s = __mmc_live_from(__mmc_run(s), __mmc_idx(__mmc_run(s), s) + 1))
+            _this->ops->free_value(&s->value);
+    }
+
+    for (; !is_null(r); r = next) {
+        next = r->next;
+        __mmc_run_free(r);
+    }
+
+    t->head = NULL;
+    t->tail = NULL;
+}
+
+static /* __always_inline */ inline multimap_cslot_t* __mmc_head(const multimap_t* _this, struct rb_node* n, bool reverse)
+{
+    if (is_null(n))
+        return reverse ? __mmc_rend(_this) : __mmc_end(_this);
+    return reverse ? __mmc_last(mmc_entry(n)) : __mmc_first(mmc_entry(n));
+}
+
+static multimap_cnode_t* __mmc_find(const multimap_t* _this, multimap_key_t key)
+{
+    struct rb_node* n = _this->root.rb_node;
+    multimap_cnode_t* t = NULL;
+    int cmp = 0;
+
+    while (!is_null(n)) {
+        t = mmc_entry(n);
+
+        cmp = __mmc_cmp(_this, key, t->key);
+
+        if (cmp < 0)
+            n = n->rb_left;
+        else if (cmp > 0)
+            n = n->rb_right;
+        else
+            return t;
+    }
+    return NULL;
+}
+
+/* First node >= `key`, or > `key` if `upper` */
+static multimap_cnode_t* __mmc_bound(const multimap_t* _this, multimap_key_t key, bool upper)
+{
+    struct rb_node* n = _this->root.rb_node;
+    multimap_cnode_t* t = NULL;
+    multimap_cnode_t* ret = NULL;
+
+    while (!is_null(n)) {
+        t = mmc_entry(n);
+
+        if (upper ? __mmc_lt(_this, key, t->key) : !__mmc_lt(_this, t->key, key)) {
+            ret = t;
+            n = n->rb_left;
+        } else {
+            n = n->rb_right;
+        }
+    }
+    return ret;
+}
+
+static /* __always_inline */ inline multimap_count_t __mmc_count(const multimap_t* _this, multimap_key_t key)
+{
+    multimap_cnode_t* t = __mmc_find(_this, key);
+    return is_null(t) ? 0 : t->count;
+}
+
+static /* __always_inline */ inline multimap_cslot_t* __mmc_begin(const multimap_t* _this)
+{
+    return __mmc_head(_this, rb_first(&_this->root), false);
+}
+
+static /* __always_inline */ inline multimap_cslot_t* __mmc_rbegin(const multimap_t* _this)
+{
+    return __mmc_head(_this, rb_last(&_this->root), true);
+}
+
+/* Forward in both walks: `reverse` only picks `rend` over `end` past the last node */
+static multimap_cslot_t* __mmc_forward(const multimap_t* _this, const multimap_cslot_t* s, bool reverse)
+{
+    multimap_crun_t* r = __mmc_run(s);
+    multimap_cslot_t* ret = __mmc_live_from(r, __mmc_idx(r, s) + 1);
+    struct rb_node* n = NULL;
+
+    if (!is_null(ret))
+        return ret;
+
+    n = rb_next(&r->cnode->node);
+    if (is_null(n))
+        return reverse ? __mmc_rend(_this) : __mmc_end(_this);
+    return __mmc_first(mmc_entry(n));
+}
+
+static multimap_cslot_t* __mmc_backward(const multimap_t* _this, const multimap_cslot_t* s, bool reverse)
+{
+    multimap_crun_t* r = __mmc_run(s);
+    multimap_cslot_t* ret = __mmc_live_before(r, __mmc_idx(r, s));
+    struct rb_node* n = NULL;
+
+    if (!is_null(ret))
+        return ret;
+
+    n = rb_prev(&r->cnode->node);
+    if (is_null(n))
+        return reverse ? __mmc_rend(_this) : __mmc_end(_this);
+    return __mmc_last(mmc_entry(n));
+}
+
+static multimap_cslot_t* __mmc_next(const multimap_t* _this, const multimap_cslot_t* s)
+{
+    if (RB_EMPTY_ROOT(&_this->root) || __mmc_end(_this) == s)
+        return __mmc_end(_this);
+    return __mmc_forward(_this, s, false);
+}
+
+static multimap_cslot_t* __mmc_prev(const multimap_t* _this, const multimap_cslot_t* s)
+{
+    if (RB_EMPTY_ROOT(&_this->root))
+        return __mmc_end(_this);
+    if (__mmc_end(_this) == s)
+        return __mmc_head(_this, rb_last(&_this->root), true);
+    return __mmc_backward(_this, s, false);
+}
+
+static multimap_cslot_t* __mmc_rnext(const multimap_t* _this, const multimap_cslot_t* s)
+{
+    if (RB_EMPTY_ROOT(&_this->root) || __mmc_rend(_this) == s)
+        return __mmc_rend(_this);
+    return __mmc_backward(_this, s, true);
+}
+
+static multimap_cslot_t* __mmc_rprev(const multimap_t* _this, const multimap_cslot_t* s)
+{
+    if (RB_EMPTY_ROOT(&_this->root))
+        return __mmc_rend(_this);
+    if (__mmc_rend(_this) == s)
+        return __mmc_head(_this, rb_first(&_this->root), false);
+    return __mmc_forward(_this, s, true);
+}
+
+static /* __always_inline */ inline multimap_cslot_t* __mmc_at(const multimap_t* _this, const multimap_cnode_t* t)
+{
+    return is_null(t) ? __mmc_end(_this) : __mmc_first(t);
+}
+
+static multimap_cnode_t* __mmc_link(multimap_t* _this, multimap_cnode_t* node)
+{
+    struct rb_node** n = &_this->root.rb_node;
+    struct rb_node* parent = NULL;
+
+    while (!is_null(*n)) {
+        parent = *n;
+        n = __mmc_lt(_this, node->key, mmc_entry(parent)->key) ? &parent->rb_left : &parent->rb_right;
+    }
+
+    rb_link_node(&node->node, parent, n);
+    if (_this->config.c.b_order_stat)
+        rb_insert_augmented(&node->node, &_this->root, &mmc_weight_augment);
+    else
+        rb_insert_color(&node->node, &_this->root);
+    return node;
+}
+
+/* Appends a copy of `value` */
+static multimap_cslot_t* __mmc_push(multimap_t* _this, multimap_cnode_t* t, multimap_value_t value)
+{
+    multimap_cslot_t* s = __mmc_slot(t);
+
+    if (unlikely(is_null(s)))
+        return NULL;
+
+    if (is_null(_this->ops) || is_null(_this->ops->copy_value)) {
+        s->value = value;
+    } else {
+        if (!_this->ops->copy_value(value, &s->value)) {
+            __mmc_kill(s);
+            return NULL;
+        }
+    }
+    return s;
+}
+
+static void __mmc_node_free(multimap_t* _this, multimap_cnode_t* t)
+{
+    __mmc_runs_free(_this, t);
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+        _this->ops->free_key(&t->key);
+    p_free(t);
+}
+
+static multimap_cnode_t* __mmc_node_new(multimap_t* _this, multimap_key_t key)
+{
+    multimap_cnode_t* t = (multimap_cnode_t*)p_calloc(1, __mmc_node_bytes(_this));
+
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    if (is_null(_this->ops) || is_null(_this->ops->copy_key)) {
+        t->key = key;
+    } else {
+        if (!_this->ops->copy_key(key, &t->key)) {
+            p_free(t);
+            return NULL;
+        }
+    }
+
+    return t;
+}
+
+/* Inserted after the equal keys */
+static multimap_cslot_t* __mmc_insert(multimap_t* _this, multimap_key_t key, multimap_value_t value)
+{
+    multimap_cnode_t* t = __mmc_find(_this, key);
+    multimap_cslot_t* s = NULL;
+
+    if (!is_null(t)) {
+        s = __mmc_push(_this, t, value);
+        if (is_null(s))
+            return NULL;
+
+        __mmc_reweigh(_this, t);
+        _this->size++;
+        return s;
+    }
+
+    t = __mmc_node_new(_this, key);
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    s = __mmc_push(_this, t, value);
+    if (is_null(s)) {
+        __mmc_node_free(_this, t);
+        return NULL;
+    }
+
+    __mmc_link(_this, t);
+    _this->size++;
+    return s;
+}
+
+static /* __always_inline */ inline void __mmc_unlink(multimap_t* _this, multimap_cnode_t* t)
+{
+    if (_this->config.c.b_order_stat)
+        rb_erase_augmented(&t->node, &_this->root, &mmc_weight_augment);
+    else
+        rb_erase(&t->node, &_this->root);
+}
+
+static multimap_size_t __mmc_drop(multimap_t* _this, multimap_cnode_t* t)
+{
+    multimap_size_t ret = t->count;
+
+    __mmc_unlink(_this, t);
+    _this->size -= ret;
+    __mmc_node_free(_this, t);
+    return ret;
+}
+
+static multimap_cslot_t* __mmc_erase(multimap_t* _this, multimap_cslot_t* s)
+{
+    multimap_cnode_t* t = __mmc_run(s)->cnode;
+    multimap_cslot_t* ret = __mmc_forward(_this, s, false);
+
+    if (1 == t->count) {
+        __mmc_drop(_this, t);
+        return ret;
+    }
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&s->value);
+
+    __mmc_kill(s);
+    __mmc_reweigh(_this, t);
+    _this->size--;
+    return ret;
+}
+
+/* The last value of a key hands the node to `handle`, else the key is copied for it */
+static multimap_cslot_t* __mmc_extract(multimap_t* _this, multimap_cslot_t* s, ds_node_handle_t* handle)
+{
+    multimap_cnode_t* t = __mmc_run(s)->cnode;
+    multimap_cslot_t* ret = __mmc_forward(_this, s, false);
+
+    if (1 == t->count) {
+        __mmc_unlink(_this, t);
+        _this->size--;
+
+        handle->key = t->key;
+        handle->value = s->value;
+        handle->full = true;
+        __mmc_unmark(s); /* The value moves, it's not freed with the runs */
+        __mmc_runs_free(_this, t);
+        ds_node_handle_put(handle, t, __mmc_node_bytes(_this));
+        return ret;
+    }
+
+    if (is_null(_this->ops) || is_null(_this->ops->copy_key)) {
+        handle->key = t->key;
+    } else {
+        if (!_this->ops->copy_key(t->key, &handle->key))
+            return NULL;
+    }
+
+    handle->value = s->value;
+    handle->full = true;
+
+    __mmc_kill(s);
+    __mmc_reweigh(_this, t);
+    _this->size--;
+    return ret;
+}
+
+/* Appended to the values of an equal key if there's one, the key of `handle` is freed then */
+static multimap_cslot_t* __mmc_insert_node(multimap_t* _this, ds_node_handle_t* handle)
+{
+    multimap_cnode_t* t = __mmc_find(_this, handle->key);
+    multimap_cslot_t* s = NULL;
+
+    if (!is_null(t)) {
+        s = __mmc_slot(t);
+        if (unlikely(is_null(s)))
+            return NULL;
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+            _this->ops->free_key(&handle->key);
+
+        s->value = handle->value;
+        ds_node_handle_release(handle);
+        __mmc_reweigh(_this, t);
+        _this->size++;
+        return s;
+    }
+
+    t = (multimap_cnode_t*)ds_node_handle_take(handle, __mmc_node_bytes(_this));
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    t->key = handle->key;
+    t->count = 0;
+    t->head = NULL;
+    t->tail = NULL;
+    s = __mmc_slot(t);
+    if (unlikely(is_null(s))) {
+        ds_node_handle_put(handle, t, __mmc_node_bytes(_this));
+        return NULL;
+    }
+
+    s->value = handle->value;
+    handle->full = false;
+
+    __mmc_link(_this, t);
+    _this->size++;
+    return s;
+}
+
+static multimap_size_t __mmc_remove(multimap_t* _this, multimap_key_t key)
+{
+    multimap_cnode_t* t = __mmc_find(_this, key);
+    return is_null(t) ? 0 : __mmc_drop(_this, t);
+}
+
+/* `cond` is asked for each pair, the slots kept stay where they are */
+static multimap_size_t __mmc_remove_if(multimap_t* _this, remove_if_condition_kv cond)
+{
+    multimap_size_t ret = 0;
+    multimap_cslot_t* s = NULL;
+    multimap_cslot_t* next = NULL;
+    struct rb_node* n = rb_first(&_this->root);
+
+    while (!is_null(n)) {
+        multimap_cnode_t* t = mmc_entry(n);
+
+        n = rb_next(n);
+        for (s = __mmc_first(t); !is_null(s); s = next) {
+            next = __mmc_live_from(__mmc_run(s), __mmc_idx(__mmc_run(s), s) + 1);
+            if (!cond(t->key, s->value))
+                continue;
+
+            ret++;
+            if (1 == t->count) {
+                __mmc_drop(_this, t);
+                break;
+            }
+
+            if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+                _this->ops->free_value(&s->value);
+            __mmc_kill(s);
+            __mmc_reweigh(_this, t);
+            _this->size--;
+        }
+    }
+    return ret;
+}
+
+static multimap_size_t __mmc_clear(multimap_t* _this)
+{
+    multimap_size_t ret = _this->size;
+    struct rb_node* n = NULL;
+    struct rb_node* next = NULL;
+
+    for (n = rb_first_postorder(&_this->root); !is_null(n); n = next) {
+        next = rb_next_postorder(n);
+        __mmc_node_free(_this, mmc_entry(n));
+    }
+
+    _this->root = RB_ROOT;
+    _this->size = 0;
+    return ret;
+}
+
+/* `keys` is sorted, each run of equal keys makes one node. Pairs are `step` words apart */
+static multimap_size_t __mmc_build_sorted(multimap_t* _this, const multimap_key_t* keys, const multimap_value_t* values, ds_size_t step, multimap_size_t n, __comp lt)
+{
+    multimap_cnode_t* t = NULL;
+    struct rb_node* head = NULL;
+    struct rb_node** tail = &head;
+    multimap_size_t i, m = 0;
+
+    for (i = 0; i < n; ++i) {
+        if (0 == i || lt(keys[(i - 1) * step], keys[i * step])) {
+            t = __mmc_node_new(_this, keys[i * step]);
+            if (unlikely(is_null(t)))
+                goto err;
+
+            *tail = &t->node;
+            tail = &t->node.rb_right;
+            m++;
+        }
+
+        if (is_null(__mmc_push(_this, t, is_null(values) ? 0 : values[i * step])))
+            goto err;
+    }
+
+    rb_build_sorted(&_this->root, head, m);
+    if (_this->config.c.b_order_stat)
+        __mmc_weight_build(&_this->root);
+    _this->size = n;
+    return n;
+
+err:
+    while (!is_null(head)) {
+        t = mmc_entry(head);
+        head = head->rb_right;
+        __mmc_node_free(_this, t);
+    }
+    return -1;
+}
+
+static multimap_size_t __mmc_rank(const multimap_t* _this, multimap_key_t key)
+{
+    multimap_size_t ret = 0;
+    struct rb_node* n = NULL;
+
+    if (!_this->config.c.b_order_stat) {
+        for (n = rb_first(&_this->root); !is_null(n) && __mmc_lt(_this, mmc_entry(n)->key, key); n = rb_next(n))
+            ret += mmc_entry(n)->count;
+        return ret;
+    }
+
+    for (n = _this->root.rb_node; !is_null(n); ) {
+        if (__mmc_lt(_this, mmc_entry(n)->key, key)) {
+            ret += rb_size_of(n->rb_left) + mmc_entry(n)->count;
+            n = n->rb_right;
+        } else {
+            n = n->rb_left;
+        }
+    }
+    return ret;
+}
+
+static multimap_cslot_t* __mmc_select(const multimap_t* _this, multimap_size_t k)
+{
+    struct rb_node* n = NULL;
+    multimap_size_t left;
+
+    if (!_this->config.c.b_order_stat) {
+        for (n = rb_first(&_this->root); !is_null(n) && k >= mmc_entry(n)->count; n = rb_next(n))
+            k -= mmc_entry(n)->count;
+        return is_null(n) ? __mmc_end(_this) : __mmc_nth(mmc_entry(n), k);
+    }
+
+    for (n = _this->root.rb_node; !is_null(n); ) {
+        left = (multimap_size_t)rb_size_of(n->rb_left);
+        if (k < left) {
+            n = n->rb_left;
+        } else if (k < left + mmc_entry(n)->count) {
+            return __mmc_nth(mmc_entry(n), k - left);
+        } else {
+            k -= left + mmc_entry(n)->count;
+            n = n->rb_right;
+        }
+    }
+    return __mmc_end(_this);
+}
+
+static multimap_size_t __mmc_count_range(const multimap_t* _this, multimap_key_t lo, multimap_key_t hi)
+{
+    multimap_size_t ret = 0;
+    multimap_cnode_t* t = NULL;
+    struct rb_node* n = NULL;
+
+    if (_this->config.c.b_order_stat)
+        return __mmc_lt(_this, lo, hi) ? __mmc_rank(_this, hi) - __mmc_rank(_this, lo) : 0;
+
+    t = __mmc_bound(_this, lo, false);
+    n = is_null(t) ? NULL : &t->node;
+    for (; !is_null(n) && __mmc_lt(_this, mmc_entry(n)->key, hi); n = rb_next(n))
+        ret += mmc_entry(n)->count;
+    return ret;
+}
+
+static multimap_cslot_t* __mmc_equal_range(const multimap_t* _this, multimap_key_t key, multimap_cslot_t** last)
+{
+    multimap_cnode_t* t = __mmc_bound(_this, key, false);
+
+    if (is_null(t)) {
+        *last = __mmc_end(_this);
+        return __mmc_end(_this);
+    }
+
+    *last = __mmc_lt(_this, key, t->key) ? __mmc_first(t) : __mmc_head(_this, rb_next(&t->node), false);
+    return __mmc_first(t);
+}
+
+static multimap_size_t __mmc_erase_range(multimap_t* _this, multimap_key_t lo, multimap_key_t hi)
+{
+    multimap_size_t ret = 0;
+    multimap_cnode_t* t = __mmc_bound(_this, lo, false);
+    struct rb_node* n = is_null(t) ? NULL : &t->node;
+    struct rb_node* next = NULL;
+
+    for (; !is_null(n) && __mmc_lt(_this, mmc_entry(n)->key, hi); n = next) {
+        next = rb_next(n);
+        ret += __mmc_drop(_this, mmc_entry(n));
+    }
+    return ret;
+}
+
+static multimap_size_t __mmc_for_each_range(const multimap_t* _this, multimap_key_t lo, multimap_key_t hi, for_each_kv cb, void* arg)
+{
+    multimap_size_t ret = 0;
+    multimap_cslot_t* s = NULL;
+    multimap_cnode_t* t = __mmc_bound(_this, lo, false);
+    struct rb_node* n = is_null(t) ? NULL : &t->node;
+
+    for (; !is_null(n) && __mmc_lt(_this, mmc_entry(n)->key, hi); n = rb_next(n)) {
+        for (s = __mmc_first(mmc_entry(n)); !is_null(s); s = __mmc_live_from(__mmc_run(s), __mmc_idx(__mmc_run(s), s) + 1)) {
+            ret++;
+            if (!cb(mmc_entry(n)->key, s->value, arg))
+                return ret;
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,399 @@
+/*
+  Multimap Small-size Mode Implementations
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/* Included by multimap/multimap.c.
+   In the adaptive mode (`b_small`) a multimap of up to MULTIMAP_SMALL entries keeps them in one
+   `multimap_small_t` instead of nodes of a tree: the key and value of each entry in a slot, and
+   the keys in order in one array, equal ones in the order they came, searched with a scan the
+   compiler can turn into SIMD compares. A slot doesn't move while the array lasts, so an
+   iterator is the address of its slot and stays valid until its own entry is erased, as a node
+   would. The entry past MULTIMAP_SMALL moves the entries into nodes of one block of `blocks`,
+   linked into the tree, and erases leaving MULTIMAP_SMALL / 2 move them back, so a size going
+   back and forth doesn't convert each time. Either move invalidates the iterators taken before
+   it, as a reallocation does. A compressed multimap already keeps equal keys together and never
+   takes the array */
+
+#include <multimap/multimap.h>
+
+#include <string.h>
+#include <_block.h>
+#include <_memory.h>
+#include <linux/rbtree.h>
+#include <linux/_compiler.h>
+#include <iterator/iterator.h>
+
+#define MULTIMAP_SMALL_SLOTS ((1U << MULTIMAP_SMALL) - 1)
+
+static /* __always_inline */ inline bool __multimap_small(const multimap_t* _this)
+{
+    return !is_null(_this->small);
+}
+
+/* The array takes the next insert: there's one, or the adaptive multimap is empty */
+static /* __always_inline */ inline bool __multimap_small_on(const multimap_t* _this)
+{
+    return __multimap_small(_this) || (_this->config.c.b_small && !__multimap_compress(_this) && 0 == _this->size);
+}
+
+static /* __always_inline */ inline multimap_node_t* __multimap_small_at(const multimap_t* _this, multimap_size_t i)
+{
+    return i >= 0 && i < _this->size ? (multimap_node_t*)&_this->small->slots[_this->small->order[i]] : NULL;
+}
+
+/* Index of `node` in the array, -1 if it's not the slot of an entry */
+static multimap_size_t __multimap_small_index(const multimap_t* _this, const multimap_node_t* node)
+{
+    const multimap_small_t* s = _this->small;
+    uintptr_t off = (uintptr_t)node - (uintptr_t)s->slots;
+    multimap_size_t i = 0;
+
+    if (off >= sizeof(s->slots) || 0 != off % sizeof(multimap_small_slot_t))
+        return -1;
+
+    for (i = 0; i < _this->size; ++i) {
+        if (s->order[i] == off / sizeof(multimap_small_slot_t))
+            return i;
+    }
+    return -1;
+}
+
+/* Count of entries < `key`, or <= `key` if `upper` */
+static multimap_size_t __multimap_small_bound(const multimap_t* _this, multimap_key_t key, bool upper)
+{
+    const multimap_key_t* e = _this->small->keys;
+    multimap_size_t n = _this->size;
+    multimap_size_t i = 0;
+    multimap_size_t ret = 0;
+
+    /* Without a branch per entry, which the compiler may turn into SIMD compares */
+    if (is_null(_this->ops) || is_null(_this->ops->__lt)) {
+        if (upper) {
+            for (i = 0; i < n; ++i)
+                ret += e[i] <= key;
+        } else {
+            for (i = 0; i < n; ++i)
+                ret += e[i] < key;
+        }
+        return ret;
+    }
+
+    if (upper) {
+        for (i = 0; i < n && !_this->ops->__lt(key, e[i]); ++i)
+            ;
+    } else {
+        for (i = 0; i < n && _this->ops->__lt(e[i], key); ++i)
+            ;
+    }
+    return i;
+}
+
+/* The first of the entries of `key`, NULL if there's none */
+static multimap_node_t* __multimap_small_find(const multimap_t* _this, multimap_key_t key)
+{
+    multimap_size_t i = __multimap_small_bound(_this, key, false);
+    return i < _this->size && !__multimap_lt(_this, key, _this->small->keys[i]) ? __multimap_small_at(_this, i) : NULL;
+}
+
+static /* __always_inline */ inline multimap_node_t* __multimap_small_begin(const multimap_t* _this)
+{
+    return _this->size > 0 ? __multimap_small_at(_this, 0) : __multimap_end(_this);
+}
+
+static /* __always_inline */ inline multimap_node_t* __multimap_small_rbegin(const multimap_t* _this)
+{
+    return _this->size > 0 ? __multimap_small_at(_this, _this->size - 1) : __multimap_rend(_this);
+}
+
+/* One step from `node`, forward or backward, toward `stop` which is `end` or `rend` */
+static multimap_node_t* __multimap_small_step(const multimap_t* _this, const multimap_node_t* node, bool forward, multimap_node_t* stop)
+{
+    multimap_size_t i = __multimap_small_index(_this, node);
+
+    if (i < 0)
+        return NULL;
+
+    i += forward ? 1 : -1;
+    return i >= 0 && i < _this->size ? __multimap_small_at(_this, i) : stop;
+}
+
+static multimap_node_t* __multimap_small_next(const multimap_t* _this, const multimap_node_t* node)
+{
+    if (__multimap_end(_this) == node)
+        return __multimap_end(_this);
+    return __multimap_small_step(_this, node, true, __multimap_end(_this));
+}
+
+static multimap_node_t* __multimap_small_prev(const multimap_t* _this, const multimap_node_t* node)
+{
+    if (__multimap_end(_this) == node)
+        return _this->size > 0 ? __multimap_small_at(_this, _this->size - 1) : __multimap_end(_this);
+    return __multimap_small_step(_this, node, false, __multimap_end(_this));
+}
+
+static multimap_node_t* __multimap_small_rnext(const multimap_t* _this, const multimap_node_t* node)
+{
+    if (__multimap_rend(_this) == node)
+        return __multimap_rend(_this);
+    return __multimap_small_step(_this, node, false, __multimap_rend(_this));
+}
+
+static multimap_node_t* __multimap_small_rprev(const multimap_t* _this, const multimap_node_t* node)
+{
+    if (__multimap_rend(_this) == node)
+        return _this->size > 0 ? __multimap_small_at(_this, 0) : __multimap_rend(_this);
+    return __multimap_small_step(_this, node, true, __multimap_rend(_this));
+}
+
+/* A free slot for the entry at `i`, those after it move up. The key of the array is left to the caller */
+static /* __always_inline */ inline multimap_node_t* __multimap_small_open(multimap_t* _this, multimap_size_t i)
+{
+    multimap_small_t* s = _this->small;
+    uint32_t slot = __builtin_ctz(s->free);
+
+    memmove(s->keys + i + 1, s->keys + i, (_this->size - i) * sizeof(multimap_key_t));
+    memmove(s->order + i + 1, s->order + i, (_this->size - i) * sizeof(uint8_t));
+    s->order[i] = (uint8_t)slot;
+    s->free &= ~(1U << slot);
+    _this->size++;
+    return (multimap_node_t*)&s->slots[slot];
+}
+
+/* The entry at `i` goes, its key and value are left to the caller */
+static /* __always_inline */ inline void __multimap_small_close(multimap_t* _this, multimap_size_t i)
+{
+    multimap_small_t* s = _this->small;
+
+    s->free |= 1U << s->order[i];
+    memmove(s->keys + i, s->keys + i + 1, (_this->size - i - 1) * sizeof(multimap_key_t));
+    memmove(s->order + i, s->order + i + 1, (_this->size - i - 1) * sizeof(uint8_t));
+    _this->size--;
+}
+
+static /* __always_inline */ inline void __multimap_small_free_entry(multimap_t* _this, multimap_node_t* t)
+{
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+        _this->ops->free_key(&t->key);
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&t->value);
+}
+
+/* The entries move into nodes of one block, linked into the tree in order. On failure the array stays */
+static bool __multimap_small_promote(multimap_t* _this)
+{
+    multimap_small_t* s = _this->small;
+    struct rb_node* head = NULL;
+    struct rb_node** tail = &head;
+    char* nodes = NULL;
+    multimap_node_t* t = NULL;
+    multimap_size_t i = 0;
+
+    nodes = (char*)ds_block_alloc(&_this->blocks, _this->size, __multimap_node_bytes(_this));
+    if (unlikely(is_null(nodes)))
+        return false;
+
+    for (i = 0; i < _this->size; ++i) {
+        t = (multimap_node_t*)(nodes + i * __multimap_node_bytes(_this));
+        t->key = s->slots[s->order[i]].key;
+        t->value = s->slots[s->order[i]].value;
+        *tail = &t->node;
+        tail = &t->node.rb_right;
+    }
+    *tail = NULL;
+
+    rb_build_sorted(&_this->root, head, _this->size);
+    _this->rightmost = rb_last(&_this->root);
+    if (multimap_os(_this))
+        rb_size_build(&_this->root);
+
+    p_free(_this->small);
+    return true;
+}
+
+/* The entries of the tree move to an array and their nodes are freed. On failure the tree stays */
+static void __multimap_small_demote(multimap_t* _this)
+{
+    multimap_small_t* s = NULL;
+    struct rb_node* n = NULL;
+    struct rb_node* next = NULL;
+    multimap_size_t i = 0;
+
+    s = (multimap_small_t*)p_malloc(sizeof(multimap_small_t));
+    if (unlikely(is_null(s)))
+        return;
+
+    for (n = rb_first(&_this->root); !is_null(n); n = rb_next(n), ++i) {
+        s->keys[i] = multimap_entry(n)->key;
+        s->order[i] = (uint8_t)i;
+        s->slots[i].key = multimap_entry(n)->key;
+        s->slots[i].value = multimap_entry(n)->value;
+    }
+    s->free = MULTIMAP_SMALL_SLOTS & ~((1U << i) - 1);
+
+    for (n = rb_first_postorder(&_this->root); !is_null(n); n = next) {
+        next = rb_next_postorder(n);
+        __multimap_node_free(_this, multimap_entry(n));
+    }
+
+    _this->root = RB_ROOT;
+    _this->rightmost = NULL;
+    _this->small = s;
+}
+
+/* An adaptive multimap of `limit` entries or fewer goes back to the array */
+static /* __always_inline */ inline void __multimap_small_settle(multimap_t* _this, multimap_size_t limit)
+{
+    if (_this->config.c.b_small && !__multimap_compress(_this) && !__multimap_small(_this) && _this->size > 0 && _this->size <= limit)
+        __multimap_small_demote(_this);
+}
+
+/* As `__multimap_small_settle`, `t` of the tree, or `end`, is followed to where it moved.
+   Equal keys tell no slot apart, so it's found by its place in order */
+static multimap_node_t* __multimap_small_settle_at(multimap_t* _this, multimap_size_t limit, multimap_node_t* t)
+{
+    struct rb_node* n = NULL;
+    multimap_size_t k = 0;
+
+    if (!_this->config.c.b_small || __multimap_small(_this) || _this->size > limit)
+        return t;
+
+    for (n = rb_first(&_this->root); __multimap_end(_this) != t && !is_null(n) && n != &t->node; n = rb_next(n))
+        ++k;
+
+    __multimap_small_settle(_this, limit);
+    return __multimap_small(_this) && __multimap_end(_this) != t ? __multimap_small_at(_this, k) : t;
+}
+
+/* Before the tree is worked on directly: the array goes, its entries into the tree. On failure the array stays */
+static /* __always_inline */ inline bool __multimap_small_off(multimap_t* _this)
+{
+    if (!__multimap_small(_this))
+        return true;
+
+    if (0 == _this->size) {
+        p_free(_this->small);
+        return true;
+    }
+    return __multimap_small_promote(_this);
+}
+
+static bool __multimap_small_new(multimap_t* _this)
+{
+    multimap_small_t* s = (multimap_small_t*)p_malloc(sizeof(multimap_small_t));
+
+    if (unlikely(is_null(s)))
+        return false;
+
+    s->free = MULTIMAP_SMALL_SLOTS;
+    _this->small = s;
+    return true;
+}
+
+/* Where `key` goes: right before `hint` if it belongs there, as `insert_hint`, else after the entries of `key` */
+static multimap_size_t __multimap_small_place(const multimap_t* _this, multimap_key_t key, const multimap_node_t* hint)
+{
+    const multimap_key_t* e = _this->small->keys;
+    multimap_size_t i = is_null(hint) ? -1 : __multimap_small_index(_this, hint);
+
+    if (i >= 0 && !__multimap_lt(_this, e[i], key) && (0 == i || !__multimap_lt(_this, key, e[i - 1])))
+        return i;
+    return __multimap_small_bound(_this, key, true);
+}
+
+/* NULL on failure. A full array goes to the tree, which then takes the insert: `__multimap_small_on`
+   tells the caller, and `*hint` is then moved to the node of the tree where the insert goes.
+   `hint` is NULL but for `insert_hint`, `copy` is false for the key and value of a handle */
+static multimap_node_t* __multimap_small_insert(multimap_t* _this, multimap_key_t key, multimap_value_t value, multimap_node_t** hint, bool copy)
+{
+    struct rb_node* n = NULL;
+    multimap_node_t* t = NULL;
+    multimap_size_t i = 0;
+
+    if (!__multimap_small(_this) && !__multimap_small_new(_this))
+        return NULL;
+
+    if (_this->size >= MULTIMAP_SMALL) {
+        i = is_null(hint) ? 0 : __multimap_small_place(_this, key, *hint);
+        if (!__multimap_small_promote(_this) || is_null(hint))
+            return NULL;
+
+        for (n = rb_first(&_this->root); i > 0; --i)
+            n = rb_next(n);
+        *hint = is_null(n) ? __multimap_end(_this) : multimap_entry(n);
+        return NULL;
+    }
+
+    i = __multimap_small_place(_this, key, is_null(hint) ? NULL : *hint);
+    t = __multimap_small_open(_this, i);
+    if (!copy) {
+        t->key = key;
+        t->value = value;
+    } else if (!__multimap_node_fill(_this, t, key, value)) {
+        __multimap_small_close(_this, i);
+        return NULL;
+    }
+
+    _this->small->keys[i] = t->key;
+    return t;
+}
+
+/* Return the entry after `pos` or `end` */
+static multimap_node_t* __multimap_small_erase(multimap_t* _this, multimap_node_t* pos)
+{
+    multimap_size_t i = __multimap_small_index(_this, pos);
+
+    if (i < 0)
+        return NULL;
+
+    __multimap_small_free_entry(_this, pos);
+    __multimap_small_close(_this, i);
+    return i < _this->size ? __multimap_small_at(_this, i) : __multimap_end(_this);
+}
+
+static multimap_size_t __multimap_small_clear(multimap_t* _this)
+{
+    multimap_size_t ret = _this->size;
+    multimap_size_t i = 0;
+
+    for (i = 0; i < _this->size; ++i)
+        __multimap_small_free_entry(_this, __multimap_small_at(_this, i));
+
+    p_free(_this->small);
+    _this->size = 0;
+    return ret;
+}
+
+/* Entries in [ lo, hi ) */
+static multimap_size_t __multimap_small_erase_range(multimap_t* _this, multimap_key_t lo, multimap_key_t hi)
+{
+    multimap_small_t* s = _this->small;
+    multimap_size_t l = __multimap_small_bound(_this, lo, false);
+    multimap_size_t h = __multimap_small_bound(_this, hi, false);
+    multimap_size_t i = 0;
+
+    for (i = l; i < h; ++i) {
+        __multimap_small_free_entry(_this, __multimap_small_at(_this, i));
+        s->free |= 1U << s->order[i];
+    }
+
+    memmove(s->keys + l, s->keys + h, (_this->size - h) * sizeof(multimap_key_t));
+    memmove(s->order + l, s->order + h, (_this->size - h) * sizeof(uint8_t));
+    _this->size -= h - l;
+    return h - l;
+}
@@ -19,16 +19,34 @@
 
 #include <multiset/multiset.h>
 
+#include <_block.h>
+#include <_handle.h>
+#include <_finger.h>
 #include <_memory.h>
+#include <sort/sort.h>
 #include <linux/rbtree.h>
 #include <linux/_compiler.h>
 #include <iterator/iterator.h>
 
 #define multiset_entry(ptr) rb_entry((ptr), struct multiset_node, node)
+#define multiset_os(_this)  ((_this)->config.c.b_order_stat)
 
 static /* __always_inline */ inline multiset_node_t* multiset_find(const multiset_t* _this, multiset_value_t value);
 static /* __always_inline */ inline multiset_node_t* __multiset_end(const multiset_t* _this);
+static /* __always_inline */ inline multiset_node_t* __multiset_rend(const multiset_t* _this);
+static /* __always_inline */ inline bool __multiset_lt(const multiset_t* _this, multiset_value_t left, multiset_value_t right);
+static bool __multiset_node_fill(multiset_t* _this, multiset_node_t* t, multiset_value_t value);
+static multiset_size_t __multiset_rank(const multiset_t* _this, multiset_value_t value, bool le);
+
+static /* __always_inline */ inline size_t __multiset_node_bytes(const multiset_t* _this)
+{
+    return sizeof(multiset_node_t) + (multiset_os(_this) ? RB_SIZE_EXTRA : 0);
+}
 static /* __always_inline */ inline multiset_node_t* __multiset_next(const multiset_t* _this, const multiset_node_t* node);
+static /* __always_inline */ inline void __multiset_node_free(multiset_t* _this, multiset_node_t* node);
+
+#include <../multiset/multiset_compress.c>
+#include <../multiset/multiset_small.c>
 
 static /* __always_inline */ inline multiset_size_t __multiset_size(const multiset_t* _this)
 {
@@ -50,9 +68,15 @@ static multiset_count_t multiset_count(const multiset_t* _this, multiset_value_t
     if (is_null(t))
         return -1;
 
+    if (__multiset_compress(_this))
+        return __msc_count(_this, value);
+
     if (__multiset_end(_this) == t)
         return 0;
 
+    if (multiset_os(_this) || __multiset_small(_this))
+        return __multiset_rank(_this, value, true) - __multiset_rank(_this, value, false);
+
     /* TODO: The current way of writing code will result in low performance. It's 
              necessary to balance the memory usage and performance for optimization. */
     if (is_null(_this->ops) || is_null(_this->ops->__lt_value)) {
@@ -92,7 +116,12 @@ static /* __always_inline */ inline multiset_node_t* __multiset_end(const multis
 
 static /* __always_inline */ inline multiset_node_t* __multiset_begin(const multiset_t* _this)
 {
-    multiset_node_t* t = __multiset_first(_this);
+    multiset_node_t* t = NULL;
+
+    if (__multiset_small(_this))
+        return __multiset_small_begin(_this);
+
+    t = __multiset_first(_this);
     return is_null(t) ? __multiset_end(_this) : t;
 }
 
@@ -100,6 +129,8 @@ static /* __always_inline */ inline multiset_node_t* _multiset_begin(const multi
 {
     if (unlikely(is_null(_this)))
         return NULL;
+    if (__multiset_compress(_this))
+        return (multiset_node_t*)__msc_begin(_this);
     return __multiset_begin(_this);
 }
 
@@ -107,6 +138,9 @@ static /* __always_inline */ inline multiset_node_t* __multiset_next(const multi
 {
     struct rb_node* t = NULL;
 
+    if (__multiset_small(_this))
+        return __multiset_small_next(_this, node);
+
     if (RB_EMPTY_ROOT(&_this->root) || __multiset_end(_this) == node)
         return __multiset_end(_this);
 
@@ -126,6 +160,8 @@ static /* __always_inline */ inline multiset_node_t* _multiset_next(const multis
 {
     if (unlikely(is_null(_this) || is_null(node)))
         return NULL;
+    if (__multiset_compress(_this))
+        return (multiset_node_t*)__msc_next(_this, (const multiset_cslot_t*)node);
     return __multiset_next(_this, node);
 }
 
@@ -133,6 +169,9 @@ static /* __always_inline */ inline multiset_node_t* __multiset_prev(const multi
 {
     struct rb_node* t = NULL;
 
+    if (__multiset_small(_this))
+        return __multiset_small_prev(_this, node);
+
     if (RB_EMPTY_ROOT(&_this->root))
         return __multiset_end(_this);
 
@@ -153,6 +192,8 @@ static /* __always_inline */ inline multiset_node_t* _multiset_prev(const multis
 {
     if (unlikely(is_null(_this) || is_null(node)))
         return NULL;
+    if (__multiset_compress(_this))
+        return (multiset_node_t*)__msc_prev(_this, (const multiset_cslot_t*)node);
     return __multiset_prev(_this, node);
 }
 
@@ -163,7 +204,12 @@ static /* __always_inline */ inline multiset_node_t* __multiset_rend(const multi
 
 static /* __always_inline */ inline multiset_node_t* __multiset_rbegin(const multiset_t* _this)
 {
-    multiset_node_t* t = __multiset_last(_this);
+    multiset_node_t* t = NULL;
+
+    if (__multiset_small(_this))
+        return __multiset_small_rbegin(_this);
+
+    t = __multiset_last(_this);
     return is_null(t) ? __multiset_rend(_this) : t;
 }
 
@@ -171,6 +217,8 @@ static /* __always_inline */ inline multiset_node_t* _multiset_rbegin(const mult
 {
     if (unlikely(is_null(_this)))
         return NULL;
+    if (__multiset_compress(_this))
+        return (multiset_node_t*)__msc_rbegin(_this);
     return __multiset_rbegin(_this);
 }
 
@@ -178,6 +226,9 @@ static /* __always_inline */ inline multiset_node_t* __multiset_rnext(const mult
 {
     struct rb_node* t = NULL;
 
+    if (__multiset_small(_this))
+        return __multiset_small_rnext(_this, node);
+
     if (RB_EMPTY_ROOT(&_this->root) || __multiset_rend(_this) == node)
         return __multiset_rend(_this);
 
@@ -197,6 +248,8 @@ static /* __always_inline */ inline multiset_node_t* _multiset_rnext(const multi
 {
     if (unlikely(is_null(_this) || is_null(node)))
         return NULL;
+    if (__multiset_compress(_this))
+        return (multiset_node_t*)__msc_rnext(_this, (const multiset_cslot_t*)node);
     return __multiset_rnext(_this, node);
 }
 
@@ -204,6 +257,9 @@ static /* __always_inline */ inline multiset_node_t* __multiset_rprev(const mult
 {
     struct rb_node* t = NULL;
 
+    if (__multiset_small(_this))
+        return __multiset_small_rprev(_this, node);
+
     if (RB_EMPTY_ROOT(&_this->root))
         return __multiset_rend(_this);
 
@@ -224,6 +280,8 @@ static /* __always_inline */ inline multiset_node_t* _multiset_rprev(const multi
 {
     if (unlikely(is_null(_this) || is_null(node)))
         return NULL;
+    if (__multiset_compress(_this))
+        return (multiset_node_t*)__msc_rprev(_this, (const multiset_cslot_t*)node);
     return __multiset_rprev(_this, node);
 }
 
@@ -232,6 +290,7 @@ static multiset_node_t* __multiset_find(const multiset_t* _this, multiset_value_
     struct rb_node* n = _this->root.rb_node;
     multiset_node_t* t = NULL;
     multiset_node_t* ret = NULL;
+    int cmp = 0;
 
     if (is_null(_this->ops) || is_null(_this->ops->__lt_value)) {
         while (!is_null(n)) {
@@ -246,6 +305,20 @@ static multiset_node_t* __multiset_find(const multiset_t* _this, multiset_value_
                 ret = t;
             }
         }
+    } else if (!is_null(_this->ops->__cmp_value)) {
+        while (!is_null(n)) {
+            t = multiset_entry(n);
+            cmp = _this->ops->__cmp_value(value, t->value);
+
+            if (cmp < 0) {
+                n = n->rb_left;
+            } else if (cmp > 0) {
+                n = n->rb_right;
+            } else {
+                n = n->rb_left;
+                ret = t;
+            }
+        }
     } else {
         while (!is_null(n)) {
             t = multiset_entry(n);
@@ -274,16 +347,73 @@ static /* __always_inline */ inline multiset_node_t* multiset_find(const multise
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
         return NULL;
 
-    t = __multiset_find(_this, value);
+    if (__multiset_compress(_this))
+        return (multiset_node_t*)__msc_at(_this, __msc_find(_this, value));
+
+    t = __multiset_small(_this) ? __multiset_small_find(_this, value) : __multiset_find(_this, value);
     return is_null(t) ? __multiset_end(_this) : t;
 }
 
+/* One walk for the values in order, see `_finger.h`. Either `bitmap` or `out` is filled */
+static multiset_size_t __multiset_probe_sorted(const multiset_t* _this, const multiset_value_t* values, multiset_size_t n, uint64_t* bitmap, multiset_node_t** out)
+{
+    ds_finger_t finger = DS_FINGER_INIT;
+    __comp lt = is_null(_this->ops) ? NULL : _this->ops->__lt_value;
+    size_t off = __multiset_compress(_this) ? offsetof(multiset_cnode_t, node) : offsetof(multiset_node_t, node);
+    struct rb_node* lb = NULL;
+    multiset_node_t* t = NULL;
+    multiset_size_t found = 0;
+    multiset_size_t i = 0;
+    bool valid = false;
+    bool in = false;
+
+    for (i = 0; i < n; ++i) {
+        valid = is_null(_this->ops) || is_null(_this->ops->valid_value) || _this->ops->valid_value(values[i]);
+        in = false;
+
+        if (valid && __multiset_small(_this)) {
+            t = __multiset_small_find(_this, values[i]);
+            in = !is_null(t);
+        } else if (valid) {
+            lb = ds_finger_lower_bound(&_this->root, &finger, values[i], off, lt);
+            in = !is_null(lb) && !__multiset_lt(_this, values[i], __finger_key(lb, off));
+        }
+
+        found += in;
+        if (!is_null(bitmap))
+            ds_bitmap_put(bitmap, i, in);
+        else if (!in)
+            out[i] = valid ? __multiset_end(_this) : NULL;
+        else if (__multiset_small(_this))
+            out[i] = t;
+        else /* The first of equal values, as `find` */
+            out[i] = __multiset_compress(_this) ? (multiset_node_t*)__msc_first(msc_entry(lb)) : multiset_entry(lb);
+    }
+
+    return found;
+}
+
+static multiset_size_t multiset_contains_sorted(const multiset_t* _this, const multiset_value_t* values, multiset_size_t n, uint64_t* bitmap)
+{
+    if (unlikely(is_null(_this) || is_null(values) || is_null(bitmap) || n < 0))
+        return -1;
+    return __multiset_probe_sorted(_this, values, n, bitmap, NULL);
+}
+
+static multiset_size_t multiset_find_sorted(const multiset_t* _this, const multiset_value_t* values, multiset_size_t n, multiset_node_t** out)
+{
+    if (unlikely(is_null(_this) || is_null(values) || is_null(out) || n < 0))
+        return -1;
+    return __multiset_probe_sorted(_this, values, n, NULL, out);
+}
+
 static multiset_node_t* __multiset_lower_bound(const multiset_t* _this, multiset_value_t value)
 {
     struct rb_node* n = _this->root.rb_node;
     multiset_node_t* t = NULL;
     multiset_node_t* eq = NULL;
     multiset_node_t* gt = NULL;
+    int cmp = 0;
 
     if (is_null(_this->ops) || is_null(_this->ops->__lt_value)) {
         while (!is_null(n)) {
@@ -299,6 +429,21 @@ static multiset_node_t* __multiset_lower_bound(const multiset_t* _this, multiset
                 eq = t;
             }
         }
+    } else if (!is_null(_this->ops->__cmp_value)) {
+        while (!is_null(n)) {
+            t = multiset_entry(n);
+            cmp = _this->ops->__cmp_value(value, t->value);
+
+            if (cmp < 0) {
+                n = n->rb_left;
+                gt = t;
+            } else if (cmp > 0) {
+                n = n->rb_right;
+            } else {
+                n = n->rb_left;
+                eq = t;
+            }
+        }
     } else {
         while (!is_null(n)) {
             t = multiset_entry(n);
@@ -328,7 +473,10 @@ static /* __always_inline */ inline multiset_node_t* multiset_lower_bound(const
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
         return NULL;
 
-    t = __multiset_lower_bound(_this, value);
+    if (__multiset_compress(_this))
+        return (multiset_node_t*)__msc_at(_this, __msc_bound(_this, value, false));
+
+    t = __multiset_small(_this) ? __multiset_small_at(_this, __multiset_small_bound(_this, value, false)) : __multiset_lower_bound(_this, value);
     return is_null(t) ? __multiset_end(_this) : t;
 }
 
@@ -337,6 +485,7 @@ static multiset_node_t* __multiset_upper_bound(const multiset_t* _this, multiset
     struct rb_node* n = _this->root.rb_node;
     multiset_node_t* t = NULL;
     multiset_node_t* ret = NULL;
+    int cmp = 0;
 
     if (is_null(_this->ops) || is_null(_this->ops->__lt_value)) {
         while (!is_null(n)) {
@@ -351,6 +500,20 @@ static multiset_node_t* __multiset_upper_bound(const multiset_t* _this, multiset
                 n = n->rb_right;
             }
         }
+    } else if (!is_null(_this->ops->__cmp_value)) {
+        while (!is_null(n)) {
+            t = multiset_entry(n);
+            cmp = _this->ops->__cmp_value(value, t->value);
+
+            if (cmp < 0) {
+                n = n->rb_left;
+                ret = t;
+            } else if (cmp > 0) {
+                n = n->rb_right;
+            } else {
+                n = n->rb_right;
+            }
+        }
     } else {
         while (!is_null(n)) {
             t = multiset_entry(n);
@@ -379,15 +542,38 @@ static /* __always_inline */ inline multiset_node_t* multiset_upper_bound(const
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
         return NULL;
 
-    t = __multiset_upper_bound(_this, value);
+    if (__multiset_compress(_this))
+        return (multiset_node_t*)__msc_at(_this, __msc_bound(_this, value, true));
+
+    t = __multiset_small(_this) ? __multiset_small_at(_this, __multiset_small_bound(_this, value, true)) : __multiset_upper_bound(_this, value);
     return is_null(t) ? __multiset_end(_this) : t;
 }
 
+/* `rightmost` moves to a node linked as its right child */
+static /* __always_inline */ inline multiset_node_t* __multiset_link(multiset_t* _this, multiset_node_t* node, struct rb_node* parent, struct rb_node** link)
+{
+    if (is_null(parent) || (parent == _this->rightmost && link == &parent->rb_right))
+        _this->rightmost = &node->node;
+
+    rb_link_node(&node->node, parent, link);
+    if (multiset_os(_this))
+        rb_insert_augmented(&node->node, &_this->root, &rb_size_augment);
+    else
+        rb_insert_color(&node->node, &_this->root);
+    _this->size++;
+    return node;
+}
+
 static multiset_node_t* __multiset_insert(multiset_t* _this, multiset_node_t* node)
 {
     struct rb_node** n = &_this->root.rb_node;
     struct rb_node* parent = NULL;
     multiset_node_t* t = NULL;
+    int cmp = 0;
+
+    /* Increasing values are appended without a descent */
+    if (!is_null(_this->rightmost) && !__multiset_lt(_this, node->value, multiset_entry(_this->rightmost)->value))
+        return __multiset_link(_this, node, _this->rightmost, &_this->rightmost->rb_right);
 
     if (is_null(_this->ops) || is_null(_this->ops->__lt_value)) {
         while (!is_null(*n)) {
@@ -401,6 +587,19 @@ static multiset_node_t* __multiset_insert(multiset_t* _this, multiset_node_t* no
             else
                 n = &parent->rb_right;
         }
+    } else if (!is_null(_this->ops->__cmp_value)) {
+        while (!is_null(*n)) {
+            parent = *n;
+            t = multiset_entry(parent);
+            cmp = _this->ops->__cmp_value(node->value, t->value);
+
+            if (cmp < 0)
+                n = &parent->rb_left;
+            else if (cmp > 0)
+                n = &parent->rb_right;
+            else
+                n = &parent->rb_right;
+        }
     } else {
         while (!is_null(*n)) {
             parent = *n;
@@ -415,10 +614,7 @@ static multiset_node_t* __multiset_insert(multiset_t* _this, multiset_node_t* no
         }
     }
 
-    rb_link_node(&node->node, parent, n);
-    rb_insert_color(&node->node, &_this->root);
-    _this->size++;
-    return node;
+    return __multiset_link(_this, node, parent, n);
 }
 
 static inline multiset_node_t* multiset_insert(multiset_t* _this, multiset_value_t value)
@@ -432,7 +628,16 @@ static inline multiset_node_t* multiset_insert(multiset_t* _this, multiset_value
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
         return NULL;
 
-    t = (multiset_node_t*)p_calloc(1, sizeof(multiset_node_t));
+    if (__multiset_compress(_this))
+        return (multiset_node_t*)__msc_insert(_this, value);
+
+    if (__multiset_small_on(_this)) {
+        t = __multiset_small_insert(_this, value, NULL, true);
+        if (__multiset_small_on(_this))
+            return t;
+    }
+
+    t = (multiset_node_t*)p_calloc(1, __multiset_node_bytes(_this));
     if (unlikely(is_null(t)))
         return NULL;
 
@@ -456,9 +661,88 @@ err:
     return NULL;
 }
 
+/* Links `node` next to `hint` if it belongs there, right before it first, else NULL */
+static multiset_node_t* __multiset_insert_hint(multiset_t* _this, multiset_node_t* node, multiset_node_t* hint)
+{
+    struct rb_node* h = &hint->node;
+    struct rb_node* n = NULL;
+
+    if (!__multiset_lt(_this, hint->value, node->value)) {
+        n = rb_prev(h);
+        if (!is_null(n) && __multiset_lt(_this, node->value, multiset_entry(n)->value))
+            return NULL;
+        return is_null(h->rb_left) ? __multiset_link(_this, node, h, &h->rb_left) : __multiset_link(_this, node, n, &n->rb_right);
+    }
+
+    n = rb_next(h);
+    if (!is_null(n) && __multiset_lt(_this, multiset_entry(n)->value, node->value))
+        return NULL;
+    return is_null(h->rb_right) ? __multiset_link(_this, node, h, &h->rb_right) : __multiset_link(_this, node, n, &n->rb_left);
+}
+
+/* `end`, or a `hint` out of place, falls back to `__multiset_insert`, which still appends in O(1) */
+static multiset_node_t* multiset_insert_hint(multiset_t* _this, multiset_node_t* hint, multiset_value_t value)
+{
+    multiset_node_t* t = NULL;
+    multiset_node_t* ret = NULL;
+
+    if (unlikely(is_null(_this) || is_null(hint)))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
+        return NULL;
+
+    if (__multiset_compress(_this))
+        return (multiset_node_t*)__msc_insert(_this, value);
+
+    if (__multiset_small_on(_this)) {
+        t = __multiset_small_insert(_this, value, &hint, true);
+        if (__multiset_small_on(_this))
+            return t;
+    }
+
+    t = (multiset_node_t*)p_calloc(1, __multiset_node_bytes(_this));
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    if (!__multiset_node_fill(_this, t, value)) {
+        p_free(t);
+        return NULL;
+    }
+
+    if (__multiset_end(_this) != hint && __multiset_rend(_this) != hint)
+        ret = __multiset_insert_hint(_this, t, hint);
+
+    if (is_null(ret))
+        ret = __multiset_insert(_this, t);
+
+    if (t != ret)
+        goto err;
+    return t;
+
+err:
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&t->value);
+
+    p_free(t);
+    return NULL;
+}
+
+static /* __always_inline */ inline void __multiset_node_free(multiset_t* _this, multiset_node_t* node)
+{
+    if (is_null(_this->blocks) || !ds_block_put(&_this->blocks, node))
+        p_free(node);
+}
+
 static /* __always_inline */ inline multiset_node_t* __multiset_erase(multiset_t* _this, multiset_node_t* pos)
 {
-    rb_erase(&pos->node, &_this->root);
+    if (&pos->node == _this->rightmost)
+        _this->rightmost = rb_prev(&pos->node);
+
+    if (multiset_os(_this))
+        rb_erase_augmented(&pos->node, &_this->root, &rb_size_augment);
+    else
+        rb_erase(&pos->node, &_this->root);
     _this->size--;
     return pos;
 }
@@ -475,6 +759,12 @@ static inline multiset_node_t* multiset_erase(multiset_t* _this, multiset_node_t
     if (__multiset_size(_this) <= 0 || __multiset_end(_this) == pos/* || __multiset_rend(_this) == pos*/)
         return NULL;
 
+    if (__multiset_compress(_this))
+        return (multiset_node_t*)__msc_erase(_this, (multiset_cslot_t*)pos);
+
+    if (__multiset_small(_this))
+        return __multiset_small_erase(_this, pos);
+
     t = __multiset_next(_this, pos);
     if (is_null(t))
         return NULL;
@@ -484,9 +774,9 @@ static inline multiset_node_t* multiset_erase(multiset_t* _this, multiset_node_t
     if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
         _this->ops->free_value(&pos->value);
 
-    p_free(pos);
+    __multiset_node_free(_this, pos);
 
-    return t;
+    return __multiset_small_settle_at(_this, MULTISET_SMALL / 2, t);
 }
 
 static multiset_size_t multiset_remove(multiset_t* _this, multiset_value_t value)
@@ -504,6 +794,9 @@ static multiset_size_t multiset_remove(multiset_t* _this, multiset_value_t value
     if (__multiset_end(_this) == t)
         return 0;
 
+    if (__multiset_compress(_this))
+        return __msc_remove(_this, value);
+
     if (is_null(_this->ops) || is_null(_this->ops->__lt_value)) {
         for (; __multiset_end(_this) != t; ) {
             if (value != t->value)
@@ -533,6 +826,9 @@ static multiset_size_t multiset_remove_if(multiset_t* _this, remove_if_condition
     if (unlikely(is_null(_this) || is_null(cond)))
         return -1;
 
+    if (__multiset_compress(_this))
+        return __msc_remove_if(_this, cond);
+
     for (t = __multiset_begin(_this); __multiset_end(_this) != t; ) {
         if (!cond(t->value)) {
             t = __multiset_next(_this, t);
@@ -546,25 +842,879 @@ static multiset_size_t multiset_remove_if(multiset_t* _this, remove_if_condition
     return ret;
 }
 
+/* Postorder, so nodes are freed without `rb_erase` keeping the tree balanced all along */
 static multiset_size_t multiset_clear(multiset_t* _this)
 {
     multiset_size_t ret = 0;
     multiset_node_t* t = NULL;
+    struct rb_node* n = NULL;
+    struct rb_node* next = NULL;
 
     if (unlikely(is_null(_this)))
         return -1;
 
-    for (t = __multiset_begin(_this); __multiset_end(_this) != t; ) {
-        t = multiset_erase(_this, t);
+    if (__multiset_compress(_this))
+        return __msc_clear(_this);
+
+    if (__multiset_small(_this))
+        return __multiset_small_clear(_this);
+
+    for (n = rb_first_postorder(&_this->root); !is_null(n); n = next) {
+        next = rb_next_postorder(n);
+        t = multiset_entry(n);
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+            _this->ops->free_value(&t->value);
+
+        __multiset_node_free(_this, t);
         ret++;
     }
 
+    _this->root = RB_ROOT;
+    _this->rightmost = NULL;
+    _this->size = 0;
+    return ret;
+}
+
+static /* __always_inline */ inline bool __multiset_lt(const multiset_t* _this, multiset_value_t left, multiset_value_t right)
+{
+    return is_null(_this->ops) || is_null(_this->ops->__lt_value) ? left < right : _this->ops->__lt_value(left, right);
+}
+
+/* Count of values < `value`, or <= `value` if `le` */
+static multiset_size_t __multiset_rank(const multiset_t* _this, multiset_value_t value, bool le)
+{
+    struct rb_node* n = _this->root.rb_node;
+    multiset_node_t* t = NULL;
+    multiset_size_t ret = 0;
+
+    if (__multiset_small(_this))
+        return __multiset_small_bound(_this, value, le);
+
+    if (!multiset_os(_this)) {
+        for (t = __multiset_begin(_this); __multiset_end(_this) != t; t = __multiset_next(_this, t), ret++) {
+            if (le ? __multiset_lt(_this, value, t->value) : !__multiset_lt(_this, t->value, value))
+                break;
+        }
+        return ret;
+    }
+
+    while (!is_null(n)) {
+        t = multiset_entry(n);
+
+        if (le ? __multiset_lt(_this, value, t->value) : !__multiset_lt(_this, t->value, value)) {
+            n = n->rb_left;
+        } else {
+            ret += rb_size_of(n->rb_left) + 1;
+            n = n->rb_right;
+        }
+    }
     return ret;
 }
 
+static multiset_size_t multiset_rank(const multiset_t* _this, multiset_value_t value)
+{
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
+        return -1;
+
+    if (__multiset_compress(_this))
+        return __msc_rank(_this, value);
+    return __multiset_rank(_this, value, false);
+}
+
+static multiset_node_t* multiset_select(const multiset_t* _this, multiset_size_t k)
+{
+    struct rb_node* n = NULL;
+    multiset_node_t* t = NULL;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (k < 0 || k >= __multiset_size(_this))
+        return __multiset_end(_this);
+
+    if (__multiset_compress(_this))
+        return (multiset_node_t*)__msc_select(_this, k);
+
+    if (__multiset_small(_this))
+        return __multiset_small_at(_this, k);
+
+    if (multiset_os(_this)) {
+        n = rb_select(&_this->root, k);
+        return is_null(n) ? NULL : multiset_entry(n);
+    }
+
+    for (t = __multiset_begin(_this); k > 0; --k)
+        t = __multiset_next(_this, t);
+    return t;
+}
+
+static multiset_size_t multiset_count_range(const multiset_t* _this, multiset_value_t lo, multiset_value_t hi)
+{
+    multiset_size_t ret = 0;
+    multiset_node_t* t = NULL;
+
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && (!_this->ops->valid_value(lo) || !_this->ops->valid_value(hi)))
+        return -1;
+
+    if (!__multiset_lt(_this, lo, hi))
+        return 0;
+
+    if (__multiset_compress(_this))
+        return __msc_count_range(_this, lo, hi);
+
+    if (multiset_os(_this) || __multiset_small(_this))
+        return __multiset_rank(_this, hi, false) - __multiset_rank(_this, lo, false);
+
+    t = __multiset_lower_bound(_this, lo);
+    for (; !is_null(t) && __multiset_end(_this) != t && __multiset_lt(_this, t->value, hi); t = __multiset_next(_this, t))
+        ret++;
+    return ret;
+}
+
+static multiset_node_t* multiset_equal_range(const multiset_t* _this, multiset_value_t value, multiset_node_t** last)
+{
+    multiset_node_t* t = NULL;
+    multiset_node_t* u = NULL;
+
+    if (unlikely(is_null(_this) || is_null(last)))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
+        return NULL;
+
+    if (__multiset_compress(_this))
+        return (multiset_node_t*)__msc_equal_range(_this, value, (multiset_cslot_t**)last);
+
+    if (__multiset_small(_this)) {
+        *last = __multiset_small_at(_this, __multiset_small_bound(_this, value, true));
+        *last = is_null(*last) ? __multiset_end(_this) : *last;
+        t = __multiset_small_at(_this, __multiset_small_bound(_this, value, false));
+        return is_null(t) ? __multiset_end(_this) : t;
+    }
+
+    t = __multiset_lower_bound(_this, value);
+    u = __multiset_upper_bound(_this, value);
+    *last = is_null(u) ? __multiset_end(_this) : u;
+    return is_null(t) ? __multiset_end(_this) : t;
+}
+
+/* One descent to `lo`, then the nodes before `hi` are unlinked in order, chained through
+   `rb_right`, and freed together. A range covering every node is a `clear` */
+static multiset_size_t multiset_erase_range(multiset_t* _this, multiset_value_t lo, multiset_value_t hi)
+{
+    multiset_node_t* t = NULL;
+    struct rb_node* n = NULL;
+    struct rb_node* next = NULL;
+    struct rb_node* head = NULL;
+    multiset_size_t ret = 0;
+
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && (!_this->ops->valid_value(lo) || !_this->ops->valid_value(hi)))
+        return -1;
+
+    if (!__multiset_lt(_this, lo, hi))
+        return 0;
+
+    if (__multiset_compress(_this))
+        return __msc_erase_range(_this, lo, hi);
+
+    if (__multiset_small(_this))
+        return __multiset_small_erase_range(_this, lo, hi);
+
+    t = __multiset_lower_bound(_this, lo);
+    if (is_null(t))
+        return 0;
+
+    if (&t->node == rb_first(&_this->root) && __multiset_lt(_this, multiset_entry(_this->rightmost)->value, hi))
+        return multiset_clear(_this);
+
+    for (n = &t->node; !is_null(n) && __multiset_lt(_this, multiset_entry(n)->value, hi); n = next) {
+        next = rb_next(n);
+        __multiset_erase(_this, multiset_entry(n));
+        n->rb_right = head;
+        head = n;
+        ret++;
+    }
+
+    for (n = head; !is_null(n); n = next) {
+        next = n->rb_right;
+        t = multiset_entry(n);
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+            _this->ops->free_value(&t->value);
+
+        __multiset_node_free(_this, t);
+    }
+
+    __multiset_small_settle(_this, MULTISET_SMALL / 2);
+    return ret;
+}
+
+static multiset_size_t multiset_for_each_range(const multiset_t* _this, multiset_value_t lo, multiset_value_t hi, for_each_v cb, void* arg)
+{
+    multiset_node_t* t = NULL;
+    struct rb_node* n = NULL;
+    multiset_size_t i = 0;
+    multiset_size_t ret = 0;
+
+    if (unlikely(is_null(_this) || is_null(cb)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && (!_this->ops->valid_value(lo) || !_this->ops->valid_value(hi)))
+        return -1;
+
+    if (!__multiset_lt(_this, lo, hi))
+        return 0;
+
+    if (__multiset_compress(_this))
+        return __msc_for_each_range(_this, lo, hi, cb, arg);
+
+    if (__multiset_small(_this)) {
+        for (i = __multiset_small_bound(_this, lo, false); i < __multiset_size(_this) && __multiset_lt(_this, _this->small->values[i], hi); ++i) {
+            ret++;
+            if (!cb(__multiset_small_at(_this, i)->value, arg))
+                break;
+        }
+        return ret;
+    }
+
+    t = __multiset_lower_bound(_this, lo);
+    for (n = is_null(t) ? NULL : &t->node; !is_null(n) && __multiset_lt(_this, multiset_entry(n)->value, hi); n = rb_next(n)) {
+        ret++;
+        if (!cb(multiset_entry(n)->value, arg))
+            break;
+    }
+    return ret;
+}
+
+/* What keeps the subtree sizes through a split or a join, a compressed node weighs its count */
+static /* __always_inline */ inline const struct rb_augment_callbacks* __multiset_augment(const multiset_t* _this)
+{
+    if (!multiset_os(_this))
+        return NULL;
+    return __multiset_compress(_this) ? &msc_weight_augment : &rb_size_augment;
+}
+
+/* Count of `l` after a split of `total` values, `l` and `r` are walked in step so only the smaller one is walked through */
+static multiset_size_t __multiset_split_size(const multiset_t* _this, const struct rb_root* l, const struct rb_root* r, multiset_size_t total)
+{
+    struct rb_node* a = rb_first(l);
+    struct rb_node* b = rb_first(r);
+    multiset_size_t na = 0, nb = 0;
+
+    if (multiset_os(_this))
+        return (multiset_size_t)rb_size_of(l->rb_node);
+
+    for (; !is_null(a) && !is_null(b); a = rb_next(a), b = rb_next(b)) {
+        na += __multiset_compress(_this) ? msc_entry(a)->count : 1;
+        nb += __multiset_compress(_this) ? msc_entry(b)->count : 1;
+    }
+    return is_null(a) ? na : total - nb;
+}
+
+/* The blocks follow their nodes: those of the smaller half are marked, a block with nodes on
+   both sides is shared by the halves. Only plain nodes come in blocks */
+static void __multiset_split_blocks(ds_block_t* blocks, ds_block_t* spare, multiset_t* left, multiset_t* right)
+{
+    bool lesser = __multiset_size(left) <= __multiset_size(right);
+    multiset_t* t = lesser ? left : right;
+    ds_block_t* moved = NULL;
+    struct rb_node* n = NULL;
+
+    if (is_null(blocks))
+        return;
+
+    for (n = rb_first(&t->root); !is_null(n); n = rb_next(n))
+        ds_block_mark(blocks, multiset_entry(n));
+
+    ds_block_split(&blocks, &moved, spare);
+    ds_block_splice(&left->blocks, lesser ? &moved : &blocks);
+    ds_block_splice(&right->blocks, lesser ? &blocks : &moved);
+}
+
+/* The nodes move as they are, so `t` must be empty with the same ops and config, or `_this` itself */
+static /* __always_inline */ inline bool __multiset_split_into(const multiset_t* _this, const multiset_t* t)
+{
+    return t == _this || (0 == __multiset_size(t) && t->ops == _this->ops && t->config.d == _this->config.d);
+}
+
+static multiset_size_t multiset_split(multiset_t* _this, multiset_value_t value, multiset_t* left, multiset_t* right)
+{
+    struct rb_root l = RB_ROOT;
+    struct rb_root r = RB_ROOT;
+    struct rb_node* rightmost = NULL;
+    struct rb_node* n = NULL;
+    multiset_cnode_t* c = NULL;
+    multiset_node_t* t = NULL;
+    multiset_size_t total = 0;
+    ds_block_t* blocks = NULL;
+    ds_block_t* spare = NULL;
+
+    if (unlikely(is_null(_this) || is_null(left) || is_null(right) || left == right))
+        return -1;
+
+    if (!__multiset_split_into(_this, left) || !__multiset_split_into(_this, right))
+        return -1;
+
+    /* The array goes to the tree to be split, the halves settle after */
+    if (!__multiset_small_off(left) || !__multiset_small_off(right) || !__multiset_small_off(_this))
+        return -1;
+
+    if (!ds_block_spare(_this->blocks, &spare))
+        return -1;
+
+    if (__multiset_compress(_this)) {
+        c = __msc_bound(_this, value, false);
+        n = is_null(c) ? NULL : &c->node;
+    } else {
+        t = __multiset_lower_bound(_this, value);
+        n = is_null(t) ? NULL : &t->node;
+    }
+
+    l = _this->root;
+    total = __multiset_size(_this);
+    rightmost = _this->rightmost;
+    if (!is_null(n))
+        rb_split(&l, n, &r, __multiset_augment(_this));
+
+    blocks = _this->blocks;
+    _this->root = RB_ROOT;
+    _this->rightmost = NULL;
+    _this->blocks = NULL;
+    _this->size = 0;
+
+    left->root = l;
+    left->size = __multiset_split_size(_this, &l, &r, total);
+    left->rightmost = __multiset_compress(left) ? NULL : (is_null(r.rb_node) ? rightmost : rb_last(&l));
+    right->root = r;
+    right->size = total - left->size;
+    right->rightmost = is_null(r.rb_node) ? NULL : rightmost;
+
+    __multiset_split_blocks(blocks, spare, left, right);
+
+    __multiset_small_settle(left, MULTISET_SMALL);
+    __multiset_small_settle(right, MULTISET_SMALL);
+    return __multiset_size(left);
+}
+
+static multiset_size_t multiset_join(multiset_t* _this, multiset_t* other)
+{
+    struct rb_node* last = NULL;
+    struct rb_node* first = NULL;
+
+    if (unlikely(is_null(_this) || is_null(other) || _this == other))
+        return -1;
+
+    if (other->ops != _this->ops || other->config.d != _this->config.d)
+        return -1;
+
+    if (0 == __multiset_size(other))
+        return __multiset_size(_this);
+
+    if (__multiset_size(_this) > 0 && !__multiset_compress(_this) && __multiset_lt(_this, __multiset_begin(other)->value, __multiset_rbegin(_this)->value))
+        return -1;
+
+    if (!__multiset_small_off(_this) || !__multiset_small_off(other))
+        return -1;
+
+    last = rb_last(&_this->root);
+    first = rb_first(&other->root);
+    if (!is_null(last) && __multiset_compress(_this) && !__multiset_lt(_this, msc_entry(last)->value, msc_entry(first)->value))
+        return -1;
+
+    rb_concat(&_this->root, &other->root, __multiset_augment(_this));
+    ds_block_splice(&_this->blocks, &other->blocks);
+    _this->rightmost = other->rightmost;
+    _this->size += other->size;
+
+    other->rightmost = NULL;
+    other->size = 0;
+
+    __multiset_small_settle(_this, MULTISET_SMALL);
+    return __multiset_size(_this);
+}
+
+/* The value and the node memory go to `handle`, unless the node is in a block or the value in the array */
+static multiset_node_t* multiset_extract(multiset_t* _this, multiset_node_t* pos, ds_node_handle_t* handle)
+{
+    multiset_node_t* t = NULL;
+    multiset_size_t i = 0;
+
+    if (unlikely(is_null(_this) || is_null(pos) || is_null(handle) || handle->full))
+        return NULL;
+
+    if (__multiset_size(_this) <= 0 || __multiset_end(_this) == pos)
+        return NULL;
+
+    if (__multiset_compress(_this))
+        return (multiset_node_t*)__msc_extract(_this, (multiset_cslot_t*)pos, handle);
+
+    if (__multiset_small(_this)) {
+        i = __multiset_small_index(_this, pos);
+        if (i < 0)
+            return NULL;
+
+        handle->key = pos->value;
+        handle->value = 0;
+        handle->full = true;
+
+        __multiset_small_close(_this, i);
+        return i < __multiset_size(_this) ? __multiset_small_at(_this, i) : __multiset_end(_this);
+    }
+
+    t = __multiset_next(_this, pos);
+    if (is_null(t))
+        return NULL;
+
+    __multiset_erase(_this, pos);
+
+    handle->key = pos->value;
+    handle->value = 0;
+    handle->full = true;
+
+    if (is_null(_this->blocks) || !ds_block_put(&_this->blocks, pos))
+        ds_node_handle_put(handle, pos, __multiset_node_bytes(_this));
+
+    return __multiset_small_settle_at(_this, MULTISET_SMALL / 2, t);
+}
+
+static multiset_node_t* multiset_insert_node(multiset_t* _this, ds_node_handle_t* handle)
+{
+    multiset_node_t* t = NULL;
+
+    if (unlikely(is_null(_this) || is_null(handle) || !handle->full))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(handle->key))
+        return NULL;
+
+    if (__multiset_compress(_this))
+        return (multiset_node_t*)__msc_insert_node(_this, handle);
+
+    if (__multiset_small_on(_this)) {
+        t = __multiset_small_insert(_this, handle->key, NULL, false);
+        if (!is_null(t))
+            ds_node_handle_release(handle);
+        if (__multiset_small_on(_this))
+            return t;
+    }
+
+    t = (multiset_node_t*)ds_node_handle_take(handle, __multiset_node_bytes(_this));
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    t->value = handle->key;
+    handle->full = false;
+    return __multiset_insert(_this, t);
+}
+
+static void multiset_free_node(multiset_t* _this, ds_node_handle_t* handle)
+{
+    if (unlikely(is_null(_this) || is_null(handle)))
+        return;
+
+    if (handle->full && !is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&handle->key);
+
+    ds_node_handle_release(handle);
+}
+
+static bool __multiset_lt_default(multiset_value_t left, multiset_value_t right)
+{
+    return left < right;
+}
+
+static bool __multiset_node_fill(multiset_t* _this, multiset_node_t* t, multiset_value_t value)
+{
+    if (is_null(_this->ops) || is_null(_this->ops->copy_value)) {
+        t->value = value;
+    } else {
+        if (!_this->ops->copy_value(value, &t->value))
+            return false;
+    }
+
+    return true;
+}
+
+/* The nodes are chained in order through `rb_right`, then linked into a balanced tree at once */
+static multiset_size_t multiset_build_sorted(multiset_t* _this, const multiset_value_t* values, multiset_size_t n, bool contiguous)
+{
+    __comp lt = NULL;
+    ds_data_t* v = NULL;        /* The values sorted, if the input isn't */
+    multiset_node_t* nodes = NULL;
+    multiset_node_t* t = NULL;
+    struct rb_node* head = NULL;
+    struct rb_node** tail = &head;
+    multiset_size_t i, m = 0;
+
+    if (unlikely(is_null(_this) || n < 0 || (n > 0 && is_null(values))))
+        return -1;
+
+    if (__multiset_size(_this) > 0)
+        return -1;
+
+    __multiset_small_off(_this);
+
+    for (i = 0; i < n; ++i) {
+        if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(values[i]))
+            return -1;
+    }
+
+    lt = is_null(_this->ops) || is_null(_this->ops->__lt_value) ? __multiset_lt_default : _this->ops->__lt_value;
+
+    for (i = 1; i < n && !lt(values[i], values[i - 1]); ++i)
+        ;
+
+    if (i < n) {
+        v = (ds_data_t*)p_malloc(n * sizeof(ds_data_t));
+        if (unlikely(is_null(v)))
+            return -1;
+
+        for (i = 0; i < n; ++i)
+            v[i] = values[i];
+
+        if (!__sort_merge_n(v, n, 1, lt)) {
+            p_free(v);
+            return -1;
+        }
+
+        values = v;
+    }
+
+    if (__multiset_compress(_this)) {
+        m = __msc_build_sorted(_this, values, n, lt);
+        p_free(v);
+        return m;
+    }
+
+    if (contiguous && n > 0) {
+        nodes = (multiset_node_t*)ds_block_alloc(&_this->blocks, n, __multiset_node_bytes(_this));
+        if (unlikely(is_null(nodes)))
+            goto err;
+    }
+
+    for (i = 0; i < n; ++i) {
+        t = contiguous ? (multiset_node_t*)((char*)nodes + m * __multiset_node_bytes(_this)) : (multiset_node_t*)p_calloc(1, __multiset_node_bytes(_this));
+        if (unlikely(is_null(t)))
+            goto err;
+
+        if (!__multiset_node_fill(_this, t, values[i])) {
+            if (!contiguous)
+                p_free(t);
+            goto err;
+        }
+
+        *tail = &t->node;
+        tail = &t->node.rb_right;
+        m++;
+    }
+
+    rb_build_sorted(&_this->root, head, m);
+    _this->rightmost = rb_last(&_this->root);
+    if (multiset_os(_this))
+        rb_size_build(&_this->root);
+    _this->size = m;
+    p_free(v);
+
+    __multiset_small_settle(_this, MULTISET_SMALL);
+    return m;
+
+err:
+    while (!is_null(head)) {
+        t = multiset_entry(head);
+        head = head->rb_right;
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+            _this->ops->free_value(&t->value);
+
+        if (!contiguous)
+            p_free(t);
+    }
+
+    if (!is_null(nodes))
+        ds_block_free(&_this->blocks, nodes);
+    p_free(v);
+    return -1;
+}
+
+/* Which values of a merged walk are kept: only in the first multiset, only in the second, in both.
+   Equal values pair off one to one, so the counts follow std::set_union and friends */
+#define MULTISET_KEEP_FIRST  (1)
+#define MULTISET_KEEP_SECOND (2)
+#define MULTISET_KEEP_BOTH   (4)
+
+/* In-order walk over every value, each copy of a compressed node included. Over the array
+   of the adaptive mode `i` is the index */
+typedef struct multiset_walk {
+    const multiset_t* ds;
+    struct rb_node* n;
+    multiset_size_t i;
+} multiset_walk_t;
+
+static /* __always_inline */ inline void __multiset_walk_init(multiset_walk_t* w, const multiset_t* ds)
+{
+    w->ds = ds;
+    w->n = rb_first(&ds->root);
+    w->i = 0;
+}
+
+static /* __always_inline */ inline bool __multiset_walk_more(const multiset_walk_t* w)
+{
+    return __multiset_small(w->ds) ? w->i < __multiset_size(w->ds) : !is_null(w->n);
+}
+
+static /* __always_inline */ inline multiset_value_t __multiset_walk_value(const multiset_walk_t* w)
+{
+    if (__multiset_small(w->ds))
+        return w->ds->small->values[w->i];
+    return __multiset_compress(w->ds) ? msc_entry(w->n)->value : multiset_entry(w->n)->value;
+}
+
+static /* __always_inline */ inline void __multiset_walk_next(multiset_walk_t* w)
+{
+    if (__multiset_small(w->ds)) {
+        w->i++;
+        return;
+    }
+
+    if (__multiset_compress(w->ds) && ++w->i < msc_entry(w->n)->count)
+        return;
+
+    w->n = rb_next(w->n);
+    w->i = 0;
+}
+
+static /* __always_inline */ inline int __multiset_cmp(const multiset_t* _this, multiset_value_t left, multiset_value_t right)
+{
+    if (!is_null(_this->ops) && !is_null(_this->ops->__lt_value) && !is_null(_this->ops->__cmp_value))
+        return _this->ops->__cmp_value(left, right);
+    return __multiset_lt(_this, left, right) ? -1 : (__multiset_lt(_this, right, left) ? 1 : 0);
+}
+
+/* One merged walk of `a` and `b` into an array, then `build_sorted` links it in O(n) */
+static multiset_size_t __multiset_merge(multiset_t* _this, const multiset_t* a, const multiset_t* b, uint32_t keep)
+{
+    multiset_size_t ret, n = 0;
+    ds_data_t* v = NULL;
+    multiset_walk_t x, y;
+    int cmp = 0;
+
+    if (unlikely(_this == a || _this == b))
+        return -1;
+
+    if (__multiset_size(a) + __multiset_size(b) > 0) {
+        v = (ds_data_t*)p_malloc((__multiset_size(a) + __multiset_size(b)) * sizeof(ds_data_t));
+        if (unlikely(is_null(v)))
+            return -1;
+    }
+
+    __multiset_walk_init(&x, a);
+    __multiset_walk_init(&y, b);
+
+    while (__multiset_walk_more(&x) && __multiset_walk_more(&y)) {
+        cmp = __multiset_cmp(a, __multiset_walk_value(&x), __multiset_walk_value(&y));
+
+        if (cmp < 0) {
+            if (keep & MULTISET_KEEP_FIRST)
+                v[n++] = __multiset_walk_value(&x);
+            __multiset_walk_next(&x);
+        } else if (cmp > 0) {
+            if (keep & MULTISET_KEEP_SECOND)
+                v[n++] = __multiset_walk_value(&y);
+            __multiset_walk_next(&y);
+        } else {
+            if (keep & MULTISET_KEEP_BOTH)
+                v[n++] = __multiset_walk_value(&x);
+            __multiset_walk_next(&x);
+            __multiset_walk_next(&y);
+        }
+    }
+
+    for (; __multiset_walk_more(&x) && (keep & MULTISET_KEEP_FIRST); __multiset_walk_next(&x))
+        v[n++] = __multiset_walk_value(&x);
+
+    for (; __multiset_walk_more(&y) && (keep & MULTISET_KEEP_SECOND); __multiset_walk_next(&y))
+        v[n++] = __multiset_walk_value(&y);
+
+    ret = multiset_build_sorted(_this, v, n, false);
+    p_free(v);
+    return ret;
+}
+
+static multiset_size_t multiset_union(multiset_t* _this, const multiset_t* a, const multiset_t* b)
+{
+    if (unlikely(is_null(_this) || is_null(a) || is_null(b)))
+        return -1;
+    return __multiset_merge(_this, a, b, MULTISET_KEEP_FIRST | MULTISET_KEEP_SECOND | MULTISET_KEEP_BOTH);
+}
+
+static multiset_size_t multiset_intersection(multiset_t* _this, const multiset_t* a, const multiset_t* b)
+{
+    if (unlikely(is_null(_this) || is_null(a) || is_null(b)))
+        return -1;
+    return __multiset_merge(_this, a, b, MULTISET_KEEP_BOTH);
+}
+
+static multiset_size_t multiset_difference(multiset_t* _this, const multiset_t* a, const multiset_t* b)
+{
+    if (unlikely(is_null(_this) || is_null(a) || is_null(b)))
+        return -1;
+    return __multiset_merge(_this, a, b, MULTISET_KEEP_FIRST);
+}
+
+static multiset_size_t multiset_symmetric_difference(multiset_t* _this, const multiset_t* a, const multiset_t* b)
+{
+    if (unlikely(is_null(_this) || is_null(a) || is_null(b)))
+        return -1;
+    return __multiset_merge(_this, a, b, MULTISET_KEEP_FIRST | MULTISET_KEEP_SECOND);
+}
+
+/* Return the node after `n` */
+static struct rb_node* __multiset_drop(multiset_t* _this, struct rb_node* n)
+{
+    struct rb_node* next = rb_next(n);
+    multiset_node_t* t = multiset_entry(n);
+
+    __multiset_erase(_this, t);
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&t->value);
+
+    __multiset_node_free(_this, t);
+    return next;
+}
+
+/* A copy of `value` right before `pos`, or appended if `pos` is NULL, without a compare */
+static bool __multiset_link_before(multiset_t* _this, multiset_value_t value, struct rb_node* pos)
+{
+    struct rb_node* n = NULL;
+    multiset_node_t* t = (multiset_node_t*)p_calloc(1, __multiset_node_bytes(_this));
+
+    if (unlikely(is_null(t)))
+        return false;
+
+    if (!__multiset_node_fill(_this, t, value)) {
+        p_free(t);
+        return false;
+    }
+
+    if (is_null(pos)) {
+        n = _this->rightmost;
+        __multiset_link(_this, t, n, is_null(n) ? &_this->root.rb_node : &n->rb_right);
+    } else if (is_null(pos->rb_left)) {
+        __multiset_link(_this, t, pos, &pos->rb_left);
+    } else {
+        n = rb_prev(pos);
+        __multiset_link(_this, t, n, &n->rb_right);
+    }
+    return true;
+}
+
+/* One merged walk of `_this` and `other`, erasing from `_this` and linking copies from `other` in place.
+   A compressed `_this` is rebuilt from the merged walk instead, an array of `_this` goes to the tree for the walk and settles after */
+static multiset_size_t __multiset_merge_with(multiset_t* _this, const multiset_t* other, uint32_t keep)
+{
+    multiset_t tmp;
+    struct rb_node* x = NULL;
+    multiset_walk_t y;
+    int cmp = 0;
+
+    if (_this == other) {
+        if (!(keep & MULTISET_KEEP_BOTH))
+            multiset_clear(_this);
+        return __multiset_size(_this);
+    }
+
+    if (__multiset_compress(_this)) {
+        tmp = *_this;
+        tmp.root = RB_ROOT;
+        tmp.size = 0;
+
+        if (__multiset_merge(&tmp, _this, other, keep) < 0)
+            return -1;
+
+        __msc_clear(_this);
+        _this->root = tmp.root;
+        _this->size = tmp.size;
+        return __multiset_size(_this);
+    }
+
+    if (!__multiset_small_off(_this))
+        return -1;
+
+    x = rb_first(&_this->root);
+    __multiset_walk_init(&y, other);
+
+    while (!is_null(x) && __multiset_walk_more(&y)) {
+        cmp = __multiset_cmp(_this, multiset_entry(x)->value, __multiset_walk_value(&y));
+
+        if (cmp < 0) {
+            x = (keep & MULTISET_KEEP_FIRST) ? rb_next(x) : __multiset_drop(_this, x);
+        } else if (cmp > 0) {
+            if ((keep & MULTISET_KEEP_SECOND) && !__multiset_link_before(_this, __multiset_walk_value(&y), x))
+                return -1;
+            __multiset_walk_next(&y);
+        } else {
+            x = (keep & MULTISET_KEEP_BOTH) ? rb_next(x) : __multiset_drop(_this, x);
+            __multiset_walk_next(&y);
+        }
+    }
+
+    while (!is_null(x) && !(keep & MULTISET_KEEP_FIRST))
+        x = __multiset_drop(_this, x);
+
+    for (; __multiset_walk_more(&y) && (keep & MULTISET_KEEP_SECOND); __multiset_walk_next(&y)) {
+        if (!__multiset_link_before(_this, __multiset_walk_value(&y), NULL))
+            return -1;
+    }
+
+    __multiset_small_settle(_this, MULTISET_SMALL);
+    return __multiset_size(_this);
+}
+
+static multiset_size_t multiset_union_with(multiset_t* _this, const multiset_t* other)
+{
+    if (unlikely(is_null(_this) || is_null(other)))
+        return -1;
+    return __multiset_merge_with(_this, other, MULTISET_KEEP_FIRST | MULTISET_KEEP_SECOND | MULTISET_KEEP_BOTH);
+}
+
+static multiset_size_t multiset_intersect_with(multiset_t* _this, const multiset_t* other)
+{
+    if (unlikely(is_null(_this) || is_null(other)))
+        return -1;
+    return __multiset_merge_with(_this, other, MULTISET_KEEP_BOTH);
+}
+
+static multiset_size_t multiset_difference_with(multiset_t* _this, const multiset_t* other)
+{
+    if (unlikely(is_null(_this) || is_null(other)))
+        return -1;
+    return __multiset_merge_with(_this, other, MULTISET_KEEP_FIRST);
+}
+
+static multiset_size_t multiset_symmetric_difference_with(multiset_t* _this, const multiset_t* other)
+{
+    if (unlikely(is_null(_this) || is_null(other)))
+        return -1;
+    return __multiset_merge_with(_this, other, MULTISET_KEEP_FIRST | MULTISET_KEEP_SECOND);
+}
+
 /* __always_inline */ inline void __multiset_init(multiset_t* multiset)
 {
     multiset->root = RB_ROOT;
+    multiset->blocks = NULL;
+    multiset->rightmost = NULL;
+    multiset->small = NULL;
 }
 
 /* __always_inline */ inline void __multiset_deinit(multiset_t* multiset)
@@ -585,32 +1735,61 @@ typedef multiset_r_iterator_t* (*fp_rbegin)(const multiset_t* _this);
 typedef multiset_r_iterator_t* (*fp_rnext)(const multiset_t* _this, const multiset_r_iterator_t* r_iterator);
 typedef multiset_r_iterator_t* (*fp_rprev)(const multiset_t* _this, const multiset_r_iterator_t* r_iterator);
 typedef multiset_iterator_t* (*fp_find)(const multiset_t* _this, multiset_value_t value);
+typedef multiset_size_t (*fp_find_sorted)(const multiset_t* _this, const multiset_value_t* values, multiset_size_t n, multiset_iterator_t** out);
 typedef multiset_iterator_t* (*fp_lower_bound)(const multiset_t* _this, multiset_value_t value);
 typedef multiset_iterator_t* (*fp_upper_bound)(const multiset_t* _this, multiset_value_t value);
 typedef multiset_iterator_t* (*fp_insert)(multiset_t* _this, multiset_value_t value);
 typedef multiset_iterator_t* (*fp_erase)(multiset_t* _this, multiset_iterator_t* iterator);
+typedef multiset_iterator_t* (*fp_insert_hint)(multiset_t* _this, multiset_iterator_t* hint, multiset_value_t value);
+typedef multiset_iterator_t* (*fp_equal_range)(const multiset_t* _this, multiset_value_t value, multiset_iterator_t** last);
+typedef multiset_iterator_t* (*fp_select)(const multiset_t* _this, multiset_size_t k);
+typedef multiset_iterator_t* (*fp_extract)(multiset_t* _this, multiset_iterator_t* iterator, ds_node_handle_t* handle);
+typedef multiset_iterator_t* (*fp_insert_node)(multiset_t* _this, ds_node_handle_t* handle);
 
 const class_multiset_t* class_multiset_ins(void)
 {
     static const class_multiset_t ins = {
-        .size        = _multiset_size,
-        .count       = multiset_count,
-        .end         = (fp_end)__multiset_end,
-        .begin       = (fp_begin)_multiset_begin,
-        .next        = (fp_next)_multiset_next,
-        .prev        = (fp_prev)_multiset_prev,
-        .rend        = (fp_rend)__multiset_rend,
-        .rbegin      = (fp_rbegin)_multiset_rbegin,
-        .rnext       = (fp_rnext)_multiset_rnext,
-        .rprev       = (fp_rprev)_multiset_rprev,
-        .find        = (fp_find)multiset_find,
-        .lower_bound = (fp_lower_bound)multiset_lower_bound,
-        .upper_bound = (fp_upper_bound)multiset_upper_bound,
-        .insert      = (fp_insert)multiset_insert,
-        .erase       = (fp_erase)multiset_erase,
-        .remove      = multiset_remove,
-        .remove_if   = multiset_remove_if,
-        .clear       = multiset_clear,
+        .size                      = _multiset_size,
+        .count                     = multiset_count,
+        .end                       = (fp_end)__multiset_end,
+        .begin                     = (fp_begin)_multiset_begin,
+        .next                      = (fp_next)_multiset_next,
+        .prev                      = (fp_prev)_multiset_prev,
+        .rend                      = (fp_rend)__multiset_rend,
+        .rbegin                    = (fp_rbegin)_multiset_rbegin,
+        .rnext                     = (fp_rnext)_multiset_rnext,
+        .rprev                     = (fp_rprev)_multiset_rprev,
+        .find                      = (fp_find)multiset_find,
+        .contains_sorted            = multiset_contains_sorted,
+        .find_sorted                = (fp_find_sorted)multiset_find_sorted,
+        .lower_bound               = (fp_lower_bound)multiset_lower_bound,
+        .upper_bound               = (fp_upper_bound)multiset_upper_bound,
+        .insert                    = (fp_insert)multiset_insert,
+        .erase                     = (fp_erase)multiset_erase,
+        .remove                    = multiset_remove,
+        .remove_if                 = multiset_remove_if,
+        .clear                     = multiset_clear,
+        .build_sorted              = multiset_build_sorted,
+        .rank                      = multiset_rank,
+        .select                    = (fp_select)multiset_select,
+        .count_range               = multiset_count_range,
+        .insert_hint               = (fp_insert_hint)multiset_insert_hint,
+        .equal_range               = (fp_equal_range)multiset_equal_range,
+        .erase_range               = multiset_erase_range,
+        .for_each_range            = multiset_for_each_range,
+        .split                     = multiset_split,
+        .join                      = multiset_join,
+        .set_union                 = multiset_union,
+        .set_intersection          = multiset_intersection,
+        .set_difference            = multiset_difference,
+        .set_symmetric_difference  = multiset_symmetric_difference,
+        .union_with                = multiset_union_with,
+        .intersect_with            = multiset_intersect_with,
+        .difference_with           = multiset_difference_with,
+        .symmetric_difference_with = multiset_symmetric_difference_with,
+        .extract                   = (fp_extract)multiset_extract,
+        .insert_node               = (fp_insert_node)multiset_insert_node,
+        .free_node                 = multiset_free_node,
     };
     return &ins;
 }
@@ -0,0 +1,815 @@
+/*
+  Multiset Compressed Mode Implementations
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/* Included by multiset/multiset.c.
+   In compressed mode equal values share one `multiset_cnode_t` holding how many there are,
+   so `count` is one descent and a multiset of few distinct values costs a few tree nodes.
+   Only the first of equal values is kept. With `b_order_stat` a node weighs its count, so
+   `rank`, `select` and `count_range` stay O(log n) over the distinct values.
+   An iterator is read as `it->value`, so each of equal values still needs a word holding the
+   value, and that word is all it has: the words are packed MSC_WORDS to a 64-byte line of a
+   run of the node, and the first word of a line is the address of its run with the words of
+   the line still alive in its low bits, which 128-byte aligned runs leave free. That is about
+   9 bytes per value instead of a 40-byte node. Words never move, so iterators compare,
+   survive inserts and erases of other values, as with plain nodes */
+
+#include <multiset/multiset.h>
+
+#include <_memory.h>
+#include <_handle.h>
+#include <sort/sort.h>
+#include <linux/rbtree.h>
+#include <linux/_compiler.h>
+#include <iterator/iterator.h>
+
+#define MSC_LINE       (64)
+#define MSC_WORDS      (7)   /* Values of a line, after the word naming its run */
+#define MSC_RUN_ALIGN  (128) /* Leaves MSC_WORDS low bits of a run address free */
+#define MSC_LINES_MAX  (32)
+
+/* An iterator of a compressed multiset, the word of a value in its line */
+typedef struct multiset_cslot {
+    multiset_value_t value;  /* Must be first, as in `multiset_iterator_t` */
+} multiset_cslot_t;
+
+/* The lines of a run follow its header, each at MSC_LINE bytes */
+struct multiset_crun {
+    multiset_cnode_t* cnode;
+    multiset_crun_t* prev;
+    multiset_crun_t* next;
+    uint16_t shift;          /* From what `p_malloc` returned up to the run */
+    uint16_t lines;
+    uint16_t used;           /* Words handed out, erased ones included */
+    uint16_t live;
+};
+
+#define msc_entry(ptr)     rb_entry((ptr), struct multiset_cnode, node)
+#define msc_line_of(slot)  ((uintptr_t*)((uintptr_t)(slot) & ~(uintptr_t)(MSC_LINE - 1)))
+#define msc_run_of(line)   ((multiset_crun_t*)((line)[0] & ~(uintptr_t)(MSC_RUN_ALIGN - 1)))
+#define msc_mask_of(line)  ((uint32_t)((line)[0] & (MSC_RUN_ALIGN - 1)))
+
+static /* __always_inline */ inline bool __multiset_compress(const multiset_t* _this)
+{
+    return _this->config.c.b_compress;
+}
+
+static /* __always_inline */ inline size_t __msc_node_bytes(const multiset_t* _this)
+{
+    return sizeof(multiset_cnode_t) + (_this->config.c.b_order_stat ? RB_SIZE_EXTRA : 0);
+}
+
+static /* __always_inline */ inline bool __msc_lt(const multiset_t* _this, multiset_value_t left, multiset_value_t right)
+{
+    if (is_null(_this->ops) || is_null(_this->ops->__lt_value))
+        return left < right;
+    return _this->ops->__lt_value(left, right);
+}
+
+static /* __always_inline */ inline int __msc_cmp(const multiset_t* _this, multiset_value_t left, multiset_value_t right)
+{
+    if (!is_null(_this->ops) && !is_null(_this->ops->__lt_value) && !is_null(_this->ops->__cmp_value))
+        return _this->ops->__cmp_value(left, right);
+    return __msc_lt(_this, left, right) ? -1 : __msc_lt(_this, right, left) ? 1 : 0;
+}
+
+static /* __always_inline */ inline multiset_cslot_t* __msc_end(const multiset_t* _this)
+{
+    return (multiset_cslot_t*)iterator_end();
+}
+
+static /* __always_inline */ inline multiset_cslot_t* __msc_rend(const multiset_t* _this)
+{
+    return (multiset_cslot_t*)iterator_rend();
+}
+
+/* A node weighs its count, so `rb_size` is the count of values under it */
+static /* __always_inline */ inline unsigned long __msc_weight(struct rb_node* n)
+{
+    return (unsigned long)msc_entry(n)->count + rb_size_of(n->rb_left) + rb_size_of(n->rb_right);
+}
+
+static void __msc_weight_propagate(struct rb_node* n, struct rb_node* stop)
+{
+    for (; n != stop; n = rb_parent(n))
+        rb_size(n) = __msc_weight(n);
+}
+
+static void __msc_weight_copy(struct rb_node* old, struct rb_node* new)
+{
+    rb_size(new) = rb_size(old);
+}
+
+static void __msc_weight_rotate(struct rb_node* old, struct rb_node* new)
+{
+    rb_size(new) = rb_size(old);
+    rb_size(old) = __msc_weight(old);
+}
+
+static const struct rb_augment_callbacks msc_weight_augment = {
+    .propagate = __msc_weight_propagate,
+    .copy = __msc_weight_copy,
+    .rotate = __msc_weight_rotate,
+};
+
+static void __msc_weight_build(struct rb_root* root)
+{
+    struct rb_node* n = NULL;
+
+    for (n = rb_first_postorder(root); !is_null(n); n = rb_next_postorder(n))
+        rb_size(n) = __msc_weight(n);
+}
+
+/* The count of `t` changed, the weights up to the root follow */
+static /* __always_inline */ inline void __msc_reweigh(const multiset_t* _this, multiset_cnode_t* t)
+{
+    if (_this->config.c.b_order_stat)
+        __msc_weight_propagate(&t->node, NULL);
+}
+
+static /* __always_inline */ inline uintptr_t* __msc_line(const multiset_crun_t* r, uint32_t i)
+{
+    return (uintptr_t*)((char*)r + MSC_LINE * (i + 1));
+}
+
+static /* __always_inline */ inline multiset_cslot_t* __msc_word(const multiset_crun_t* r, uint32_t i)
+{
+    return (multiset_cslot_t*)(__msc_line(r, i / MSC_WORDS) + 1 + i % MSC_WORDS);
+}
+
+/* Index of `s` in its run, lines before it included */
+static /* __always_inline */ inline uint32_t __msc_idx(const multiset_crun_t* r, const multiset_cslot_t* s)
+{
+    uintptr_t* l = msc_line_of(s);
+    return (uint32_t)(((char*)l - (char*)r) / MSC_LINE - 1) * MSC_WORDS + (uint32_t)((uintptr_t*)s - l - 1);
+}
+
+static /* __always_inline */ inline multiset_crun_t* __msc_run(const multiset_cslot_t* s)
+{
+    return msc_run_of(msc_line_of(s));
+}
+
+/* First live word from index `i` of `r` on, through the following runs */
+static multiset_cslot_t* __msc_live_from(const multiset_crun_t* r, uint32_t i)
+{
+    uint32_t mask;
+
+    for (; !is_null(r); r = r->next, i = 0) {
+        for (; i < r->used; i = (i / MSC_WORDS + 1) * MSC_WORDS) {
+            mask = msc_mask_of(__msc_line(r, i / MSC_WORDS)) >> (i % MSC_WORDS);
+            if (0 != mask)
+                return __msc_word(r, i + __builtin_ctz(mask));
+        }
+    }
+    return NULL;
+}
+
+/* Last live word before index `i` of `r`, through the preceding runs */
+static multiset_cslot_t* __msc_live_before(const multiset_crun_t* r, uint32_t i)
+{
+    uint32_t mask, base;
+
+    while (!is_null(r)) {
+        while (i > 0) {
+            base = (i - 1) / MSC_WORDS * MSC_WORDS;
+            mask = msc_mask_of(__msc_line(r, base / MSC_WORDS)) & ((1U << (i - base)) - 1);
+            if (0 != mask)
+                return __msc_word(r, base + 31 - __builtin_clz(mask));
+            i = base;
+        }
+
+        r = r->prev;
+        i = is_null(r) ? 0 : r->used;
+    }
+    return NULL;
+}
+
+/* A node always has a live word, the runs left empty are freed */
+static /* __always_inline */ inline multiset_cslot_t* __msc_first(const multiset_cnode_t* t)
+{
+    return __msc_live_from(t->head, 0);
+}
+
+static /* __always_inline */ inline multiset_cslot_t* __msc_last(const multiset_cnode_t* t)
+{
+    return __msc_live_before(t->tail, t->tail->used);
+}
+
+/* The `k`th live word of `t` */
+static multiset_cslot_t* __msc_nth(const multiset_cnode_t* t, multiset_size_t k)
+{
+    const multiset_crun_t* r = t->head;
+    uint32_t i, mask;
+
+    for (; k >= r->live; r = r->next)
+        k -= r->live;
+
+    for (i = 0; ; ++i) {
+        mask = msc_mask_of(__msc_line(r, i));
+        if (k < __builtin_popcount(mask)) {
+            for (; k > 0; --k)
+                mask &= mask - 1;
+            return __msc_word(r, i * MSC_WORDS + __builtin_ctz(mask));
+        }
+        k -= __builtin_popcount(mask);
+    }
+}
+
+static /* __always_inline */ inline void __msc_run_free(multiset_crun_t* r)
+{
+    char* raw = (char*)r - r->shift;
+    p_free(raw);
+}
+
+/* A new word after the others of `t`, a full tail run is followed by one of as many lines as `t` fills up to MSC_LINES_MAX */
+static multiset_cslot_t* __msc_push(multiset_cnode_t* t)
+{
+    multiset_crun_t* r = t->tail;
+    multiset_cslot_t* s = NULL;
+    uintptr_t* l = NULL;
+    char* raw = NULL;
+    uint32_t lines, i;
+
+    if (is_null(r) || r->used == r->lines * MSC_WORDS) {
+        lines = (uint32_t)(t->count / MSC_WORDS);
+        lines = lines < 1 ? 1 : lines > MSC_LINES_MAX ? MSC_LINES_MAX : lines;
+        raw = (char*)p_malloc(MSC_LINE * (lines + 1) + MSC_RUN_ALIGN - 1);
+        if (unlikely(is_null(raw)))
+            return NULL;
+
+        r = (multiset_crun_t*)(((uintptr_t)raw + MSC_RUN_ALIGN - 1) & ~(uintptr_t)(MSC_RUN_ALIGN - 1));
+        r->shift = (uint16_t)((char*)r - raw);
+        r->cnode = t;
+        r->prev = t->tail;
+        r->next = NULL;
+        r->lines = (uint16_t)lines;
+        r->used = 0;
+        r->live = 0;
+        for (i = 0; i < lines; ++i)
+            __msc_line(r, i)[0] = (uintptr_t)r;
+
+        if (is_null(t->tail))
+            t->head = r;
+        else
+            t->tail->next = r;
+        t->tail = r;
+    }
+
+    i = r->used++;
+    l = __msc_line(r, i / MSC_WORDS);
+    l[0] |= (uintptr_t)1 << (i % MSC_WORDS);
+    s = (multiset_cslot_t*)(l + 1 + i % MSC_WORDS);
+    s->value = t->value;
+    r->live++;
+    t->count++;
+    return s;
+}
+
+/* The word is erased, its run is freed with the last live word of it. `t` keeps another one */
+static void __msc_kill(multiset_cslot_t* s)
+{
+    uintptr_t* l = msc_line_of(s);
+    multiset_crun_t* r = msc_run_of(l);
+    multiset_cnode_t* t = r->cnode;
+
+    l[0] &= ~((uintptr_t)1 << ((uintptr_t*)s - l - 1));
+    r->live--;
+    t->count--;
+    while (r->used > 0 && !(msc_mask_of(__msc_line(r, (r->used - 1) / MSC_WORDS)) & (1U << ((r->used - 1) % MSC_WORDS))))
+        r->used--;
+
+    if (r->live > 0)
+        return ;
+
+    if (is_null(r->prev))
+        t->head = r->next;
+    else
+        r->prev->next = r->next;
+
+    if (is_null(r->next))
+        t->tail = r->prev;
+    else
+        r->next->prev = r->prev;
+    __msc_run_free(r);
+}
+
+static void __msc_runs_free(multiset_cnode_t* t)
+{
+    multiset_crun_t* r = t->head;
+    multiset_crun_t* next = NULL;
+
+    for (; !is_null(r); r = next) {
+        next = r->next;
+        __msc_run_free(r);
+    }
+
+    t->head = NULL;
+    t->tail = NULL;
+}
+
+static /* __always_inline */ inline multiset_cslot_t* __msc_head(const multiset_t* _this, struct rb_node* n, bool reverse)
+{
+    if (is_null(n))
+        return reverse ? __msc_rend(_this) : __msc_end(_this);
+    return reverse ? __msc_last(msc_entry(n)) : __msc_first(msc_entry(n));
+}
+
+static multiset_cnode_t* __msc_find(const multiset_t* _this, multiset_value_t value)
+{
+    struct rb_node* n = _this->root.rb_node;
+    multiset_cnode_t* t = NULL;
+    int cmp = 0;
+
+    while (!is_null(n)) {
+        t = msc_entry(n);
+
+        cmp = __msc_cmp(_this, value, t->value);
+
+        if (cmp < 0)
+            n = n->rb_left;
+        else if (cmp > 0)
+            n = n->rb_right;
+        else
+            return t;
+    }
+    return NULL;
+}
+
+/* First node >= `value`, or > `value` if `upper` */
+static multiset_cnode_t* __msc_bound(const multiset_t* _this, multiset_value_t value, bool upper)
+{
+    struct rb_node* n = _this->root.rb_node;
+    multiset_cnode_t* t = NULL;
+    multiset_cnode_t* ret = NULL;
+
+    while (!is_null(n)) {
+        t = msc_entry(n);
+
+        if (upper ? __msc_lt(_this, value, t->value) : !__msc_lt(_this, t->value, value)) {
+            ret = t;
+            n = n->rb_left;
+        } else {
+            n = n->rb_right;
+        }
+    }
+    return ret;
+}
+
+static /* __always_inline */ inline multiset_count_t __msc_count(const multiset_t* _this, multiset_value_t value)
+{
+    multiset_cnode_t* t = __msc_find(_this, value);
+    return is_null(t) ? 0 : t->count;
+}
+
+static /* __always_inline */ inline multiset_cslot_t* __msc_begin(const multiset_t* _this)
+{
+    return __msc_head(_this, rb_first(&_this->root), false);
+}
+
+static /* __always_inline */ inline multiset_cslot_t* __msc_rbegin(const multiset_t* _this)
+{
+    return __msc_head(_this, rb_last(&_this->root), true);
+}
+
+/* Forward in both walks: `reverse` only picks `rend` over `end` past the last node */
+static multiset_cslot_t* __msc_forward(const multiset_t* _this, const multiset_cslot_t* s, bool reverse)
+{
+    multiset_crun_t* r = __msc_run(s);
+    multiset_cslot_t* ret = __msc_live_from(r, __msc_idx(r, s) + 1);
+    struct rb_node* n = NULL;
+
+    if (!is_null(ret))
+        return ret;
+
+    n = rb_next(&r->cnode->node);
+    if (is_null(n))
+        return reverse ? __msc_rend(_this) : __msc_end(_this);
+    return __msc_first(msc_entry(n));
+}
+
+static multiset_cslot_t* __msc_backward(const multiset_t* _this, const multiset_cslot_t* s, bool reverse)
+{
+    multiset_crun_t* r = __msc_run(s);
+    multiset_cslot_t* ret = __msc_live_before(r, __msc_idx(r, s));
+    struct rb_node* n = NULL;
+
+    if (!is_null(ret))
+        return ret;
+
+    n = rb_prev(&r->cnode->node);
+    if (is_null(n))
+        return reverse ? __msc_rend(_this) : __msc_end(_this);
+    return __msc_last(msc_entry(n));
+}
+
+static multiset_cslot_t* __msc_next(const multiset_t* _this, const multiset_cslot_t* s)
+{
+    if (RB_EMPTY_ROOT(&_this->root) || __msc_end(_this) == s)
+        return __msc_end(_this);
+    return __msc_forward(_this, s, false);
+}
+
+static multiset_cslot_t* __msc_prev(const multiset_t* _this, const multiset_cslot_t* s)
+{
+    if (RB_EMPTY_ROOT(&_this->root))
+        return __msc_end(_this);
+    if (__msc_end(_this) == s)
+        return __msc_head(_this, rb_last(&_this->root), true);
+    return __msc_backward(_this, s, false);
+}
+
+static multiset_cslot_t* __msc_rnext(const multiset_t* _this, const multiset_cslot_t* s)
+{
+    if (RB_EMPTY_ROOT(&_this->root) || __msc_rend(_this) == s)
+        return __msc_rend(_this);
+    return __msc_backward(_this, s, true);
+}
+
+static multiset_cslot_t* __msc_rprev(const multiset_t* _this, const multiset_cslot_t* s)
+{
+    if (RB_EMPTY_ROOT(&_this->root))
+        return __msc_rend(_this);
+    if (__msc_rend(_this) == s)
+        return __msc_head(_this, rb_first(&_this->root), false);
+    return __msc_forward(_this, s, true);
+}
+
+static /* __always_inline */ inline multiset_cslot_t* __msc_at(const multiset_t* _this, const multiset_cnode_t* t)
+{
+    return is_null(t) ? __msc_end(_this) : __msc_first(t);
+}
+
+static multiset_cnode_t* __msc_link(multiset_t* _this, multiset_cnode_t* node)
+{
+    struct rb_node** n = &_this->root.rb_node;
+    struct rb_node* parent = NULL;
+
+    while (!is_null(*n)) {
+        parent = *n;
+        n = __msc_lt(_this, node->value, msc_entry(parent)->value) ? &parent->rb_left : &parent->rb_right;
+    }
+
+    rb_link_node(&node->node, parent, n);
+    if (_this->config.c.b_order_stat)
+        rb_insert_augmented(&node->node, &_this->root, &msc_weight_augment);
+    else
+        rb_insert_color(&node->node, &_this->root);
+    return node;
+}
+
+static void __msc_node_free(multiset_t* _this, multiset_cnode_t* t)
+{
+    __msc_runs_free(t);
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&t->value);
+    p_free(t);
+}
+
+/* Inserted after the equal values */
+static multiset_cslot_t* __msc_insert(multiset_t* _this, multiset_value_t value)
+{
+    multiset_cnode_t* t = __msc_find(_this, value);
+    multiset_cslot_t* s = NULL;
+
+    if (!is_null(t)) {
+        s = __msc_push(t);
+        if (unlikely(is_null(s)))
+            return NULL;
+
+        __msc_reweigh(_this, t);
+        _this->size++;
+        return s;
+    }
+
+    t = (multiset_cnode_t*)p_calloc(1, __msc_node_bytes(_this));
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    if (is_null(_this->ops) || is_null(_this->ops->copy_value)) {
+        t->value = value;
+    } else {
+        if (!_this->ops->copy_value(value, &t->value)) {
+            p_free(t);
+            return NULL;
+        }
+    }
+
+    s = __msc_push(t);
+    if (unlikely(is_null(s))) {
+        __msc_node_free(_this, t);
+        return NULL;
+    }
+
+    __msc_link(_this, t);
+    _this->size++;
+    return s;
+}
+
+static /* __always_inline */ inline void __msc_unlink(multiset_t* _this, multiset_cnode_t* t)
+{
+    if (_this->config.c.b_order_stat)
+        rb_erase_augmented(&t->node, &_this->root, &msc_weight_augment);
+    else
+        rb_erase(&t->node, &_this->root);
+}
+
+static multiset_size_t __msc_drop(multiset_t* _this, multiset_cnode_t* t)
+{
+    multiset_size_t ret = t->count;
+
+    __msc_unlink(_this, t);
+    _this->size -= ret;
+    __msc_node_free(_this, t);
+    return ret;
+}
+
+static multiset_cslot_t* __msc_erase(multiset_t* _this, multiset_cslot_t* s)
+{
+    multiset_cnode_t* t = __msc_run(s)->cnode;
+    multiset_cslot_t* ret = __msc_forward(_this, s, false);
+
+    if (1 == t->count) {
+        __msc_drop(_this, t);
+        return ret;
+    }
+
+    __msc_kill(s);
+    __msc_reweigh(_this, t);
+    _this->size--;
+    return ret;
+}
+
+/* The last occurrence hands its node to `handle`, of any other the value is copied */
+static multiset_cslot_t* __msc_extract(multiset_t* _this, multiset_cslot_t* s, ds_node_handle_t* handle)
+{
+    multiset_cnode_t* t = __msc_run(s)->cnode;
+    multiset_cslot_t* ret = NULL;
+
+    if (t->count > 1) {
+        if (is_null(_this->ops) || is_null(_this->ops->copy_value)) {
+            handle->key = t->value;
+        } else {
+            if (!_this->ops->copy_value(t->value, &handle->key))
+                return NULL;
+        }
+
+        handle->value = 0;
+        handle->full = true;
+        return __msc_erase(_this, s);
+    }
+
+    ret = __msc_forward(_this, s, false);
+    __msc_unlink(_this, t);
+    _this->size--;
+    __msc_runs_free(t);
+
+    handle->key = t->value;
+    handle->value = 0;
+    handle->full = true;
+    ds_node_handle_put(handle, t, __msc_node_bytes(_this));
+    return ret;
+}
+
+/* A value already there only counts one more, the one of `handle` is freed */
+static multiset_cslot_t* __msc_insert_node(multiset_t* _this, ds_node_handle_t* handle)
+{
+    multiset_cnode_t* t = __msc_find(_this, handle->key);
+    multiset_cslot_t* s = NULL;
+
+    if (!is_null(t)) {
+        s = __msc_push(t);
+        if (unlikely(is_null(s)))
+            return NULL;
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+            _this->ops->free_value(&handle->key);
+
+        ds_node_handle_release(handle);
+        __msc_reweigh(_this, t);
+        _this->size++;
+        return s;
+    }
+
+    t = (multiset_cnode_t*)ds_node_handle_take(handle, __msc_node_bytes(_this));
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    t->value = handle->key;
+    t->count = 0;
+    t->head = NULL;
+    t->tail = NULL;
+    s = __msc_push(t);
+    if (unlikely(is_null(s))) {
+        ds_node_handle_put(handle, t, __msc_node_bytes(_this));
+        return NULL;
+    }
+
+    handle->full = false;
+    __msc_link(_this, t);
+    _this->size++;
+    return s;
+}
+
+static multiset_size_t __msc_remove(multiset_t* _this, multiset_value_t value)
+{
+    multiset_cnode_t* t = __msc_find(_this, value);
+    return is_null(t) ? 0 : __msc_drop(_this, t);
+}
+
+static multiset_size_t __msc_remove_if(multiset_t* _this, remove_if_condition_v cond)
+{
+    multiset_size_t ret = 0;
+    struct rb_node* n = rb_first(&_this->root);
+
+    while (!is_null(n)) {
+        multiset_cnode_t* t = msc_entry(n);
+
+        n = rb_next(n);
+        if (cond(t->value))
+            ret += __msc_drop(_this, t);
+    }
+    return ret;
+}
+
+static multiset_size_t __msc_clear(multiset_t* _this)
+{
+    multiset_size_t ret = _this->size;
+    struct rb_node* n = NULL;
+    struct rb_node* next = NULL;
+
+    for (n = rb_first_postorder(&_this->root); !is_null(n); n = next) {
+        next = rb_next_postorder(n);
+        __msc_node_free(_this, msc_entry(n));
+    }
+
+    _this->root = RB_ROOT;
+    _this->size = 0;
+    return ret;
+}
+
+/* `values` is sorted, each run of equal values makes one node */
+static multiset_size_t __msc_build_sorted(multiset_t* _this, const multiset_value_t* values, multiset_size_t n, __comp lt)
+{
+    multiset_cnode_t* t = NULL;
+    struct rb_node* head = NULL;
+    struct rb_node** tail = &head;
+    multiset_size_t i, m = 0;
+
+    for (i = 0; i < n; ++i) {
+        if (0 == i || lt(values[i - 1], values[i])) {
+            t = (multiset_cnode_t*)p_calloc(1, __msc_node_bytes(_this));
+            if (unlikely(is_null(t)))
+                goto err;
+
+            if (is_null(_this->ops) || is_null(_this->ops->copy_value)) {
+                t->value = values[i];
+            } else if (!_this->ops->copy_value(values[i], &t->value)) {
+                p_free(t);
+                goto err;
+            }
+
+            *tail = &t->node;
+            tail = &t->node.rb_right;
+            m++;
+        }
+
+        if (unlikely(is_null(__msc_push(t))))
+            goto err;
+    }
+
+    rb_build_sorted(&_this->root, head, m);
+    if (_this->config.c.b_order_stat)
+        __msc_weight_build(&_this->root);
+    _this->size = n;
+    return n;
+
+err:
+    while (!is_null(head)) {
+        t = msc_entry(head);
+        head = head->rb_right;
+        __msc_node_free(_this, t);
+    }
+    return -1;
+}
+
+static multiset_size_t __msc_rank(const multiset_t* _this, multiset_value_t value)
+{
+    multiset_size_t ret = 0;
+    struct rb_node* n = NULL;
+
+    if (!_this->config.c.b_order_stat) {
+        for (n = rb_first(&_this->root); !is_null(n) && __msc_lt(_this, msc_entry(n)->value, value); n = rb_next(n))
+            ret += msc_entry(n)->count;
+        return ret;
+    }
+
+    for (n = _this->root.rb_node; !is_null(n); ) {
+        if (__msc_lt(_this, msc_entry(n)->value, value)) {
+            ret += rb_size_of(n->rb_left) + msc_entry(n)->count;
+            n = n->rb_right;
+        } else {
+            n = n->rb_left;
+        }
+    }
+    return ret;
+}
+
+static multiset_cslot_t* __msc_select(const multiset_t* _this, multiset_size_t k)
+{
+    struct rb_node* n = NULL;
+    multiset_size_t left;
+
+    if (!_this->config.c.b_order_stat) {
+        for (n = rb_first(&_this->root); !is_null(n) && k >= msc_entry(n)->count; n = rb_next(n))
+            k -= msc_entry(n)->count;
+        return is_null(n) ? __msc_end(_this) : __msc_nth(msc_entry(n), k);
+    }
+
+    for (n = _this->root.rb_node; !is_null(n); ) {
+        left = (multiset_size_t)rb_size_of(n->rb_left);
+        if (k < left) {
+            n = n->rb_left;
+        } else if (k < left + msc_entry(n)->count) {
+            return __msc_nth(msc_entry(n), k - left);
+        } else {
+            k -= left + msc_entry(n)->count;
+            n = n->rb_right;
+        }
+    }
+    return __msc_end(_this);
+}
+
+static multiset_size_t __msc_count_range(const multiset_t* _this, multiset_value_t lo, multiset_value_t hi)
+{
+    multiset_size_t ret = 0;
+    multiset_cnode_t* t = NULL;
+    struct rb_node* n = NULL;
+
+    if (_this->config.c.b_order_stat)
+        return __msc_lt(_this, lo, hi) ? __msc_rank(_this, hi) - __msc_rank(_this, lo) : 0;
+
+    t = __msc_bound(_this, lo, false);
+    n = is_null(t) ? NULL : &t->node;
+    for (; !is_null(n) && __msc_lt(_this, msc_entry(n)->value, hi); n = rb_next(n))
+        ret += msc_entry(n)->count;
+    return ret;
+}
+
+static multiset_cslot_t* __msc_equal_range(const multiset_t* _this, multiset_value_t value, multiset_cslot_t** last)
+{
+    multiset_cnode_t* t = __msc_bound(_this, value, false);
+
+    if (is_null(t)) {
+        *last = __msc_end(_this);
+        return __msc_end(_this);
+    }
+
+    *last = __msc_lt(_this, value, t->value) ? __msc_first(t) : __msc_head(_this, rb_next(&t->node), false);
+    return __msc_first(t);
+}
+
+static multiset_size_t __msc_erase_range(multiset_t* _this, multiset_value_t lo, multiset_value_t hi)
+{
+    multiset_size_t ret = 0;
+    multiset_cnode_t* t = __msc_bound(_this, lo, false);
+    struct rb_node* n = is_null(t) ? NULL : &t->node;
+    struct rb_node* next = NULL;
+
+    for (; !is_null(n) && __msc_lt(_this, msc_entry(n)->value, hi); n = next) {
+        next = rb_next(n);
+        ret += __msc_drop(_this, msc_entry(n));
+    }
+    return ret;
+}
+
+static multiset_size_t __msc_for_each_range(const multiset_t* _this, multiset_value_t lo, multiset_value_t hi, for_each_v cb, void* arg)
+{
+    multiset_size_t ret = 0;
+    multiset_size_t i;
+    multiset_cnode_t* t = __msc_bound(_this, lo, false);
+    struct rb_node* n = is_null(t) ? NULL : &t->node;
+
+    for (; !is_null(n) && __msc_lt(_this, msc_entry(n)->value, hi); n = rb_next(n)) {
+        for (i = 0; i < msc_entry(n)->count; ++i) {
+            ret++;
+            if (!cb(msc_entry(n)->value, arg))
+                return ret;
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,392 @@
+/*
+  Multiset Small-size Mode Implementations
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/* Included by multiset/multiset.c.
+   In the adaptive mode (`b_small`) a multiset of up to MULTISET_SMALL values keeps them in one
+   `multiset_small_t` instead of nodes of a tree: each value in a slot, and the values in order
+   in one array, equal ones in the order they came, searched with a scan the compiler can turn
+   into SIMD compares. A slot doesn't move while the array lasts, so an iterator is the address
+   of its slot and stays valid until its own value is erased, as a node would. The value past
+   MULTISET_SMALL moves the values into nodes of one block of `blocks`, linked into the tree,
+   and erases leaving MULTISET_SMALL / 2 move them back, so a size going back and forth doesn't
+   convert each time. Either move invalidates the iterators taken before it, as a reallocation
+   does. A compressed multiset already keeps equal values together and never takes the array */
+
+#include <multiset/multiset.h>
+
+#include <string.h>
+#include <_block.h>
+#include <_memory.h>
+#include <linux/rbtree.h>
+#include <linux/_compiler.h>
+#include <iterator/iterator.h>
+
+#define MULTISET_SMALL_SLOTS ((1U << MULTISET_SMALL) - 1)
+
+static /* __always_inline */ inline bool __multiset_small(const multiset_t* _this)
+{
+    return !is_null(_this->small);
+}
+
+/* The array takes the next insert: there's one, or the adaptive multiset is empty */
+static /* __always_inline */ inline bool __multiset_small_on(const multiset_t* _this)
+{
+    return __multiset_small(_this) || (_this->config.c.b_small && !__multiset_compress(_this) && 0 == _this->size);
+}
+
+static /* __always_inline */ inline multiset_node_t* __multiset_small_at(const multiset_t* _this, multiset_size_t i)
+{
+    return i >= 0 && i < _this->size ? (multiset_node_t*)&_this->small->slots[_this->small->order[i]] : NULL;
+}
+
+/* Index of `node` in the array, -1 if it's not the slot of a value */
+static multiset_size_t __multiset_small_index(const multiset_t* _this, const multiset_node_t* node)
+{
+    const multiset_small_t* s = _this->small;
+    uintptr_t off = (uintptr_t)node - (uintptr_t)s->slots;
+    multiset_size_t i = 0;
+
+    if (off >= sizeof(s->slots) || 0 != off % sizeof(multiset_small_slot_t))
+        return -1;
+
+    for (i = 0; i < _this->size; ++i) {
+        if (s->order[i] == off / sizeof(multiset_small_slot_t))
+            return i;
+    }
+    return -1;
+}
+
+/* Count of values < `value`, or <= `value` if `upper` */
+static multiset_size_t __multiset_small_bound(const multiset_t* _this, multiset_value_t value, bool upper)
+{
+    const multiset_value_t* e = _this->small->values;
+    multiset_size_t n = _this->size;
+    multiset_size_t i = 0;
+    multiset_size_t ret = 0;
+
+    /* Without a branch per entry, which the compiler may turn into SIMD compares */
+    if (is_null(_this->ops) || is_null(_this->ops->__lt_value)) {
+        if (upper) {
+            for (i = 0; i < n; ++i)
+                ret += e[i] <= value;
+        } else {
+            for (i = 0; i < n; ++i)
+                ret += e[i] < value;
+        }
+        return ret;
+    }
+
+    if (upper) {
+        for (i = 0; i < n && !_this->ops->__lt_value(value, e[i]); ++i)
+            ;
+    } else {
+        for (i = 0; i < n && _this->ops->__lt_value(e[i], value); ++i)
+            ;
+    }
+    return i;
+}
+
+/* The first of the values equal to `value`, NULL if there's none */
+static multiset_node_t* __multiset_small_find(const multiset_t* _this, multiset_value_t value)
+{
+    multiset_size_t i = __multiset_small_bound(_this, value, false);
+    return i < _this->size && !__multiset_lt(_this, value, _this->small->values[i]) ? __multiset_small_at(_this, i) : NULL;
+}
+
+static /* __always_inline */ inline multiset_node_t* __multiset_small_begin(const multiset_t* _this)
+{
+    return _this->size > 0 ? __multiset_small_at(_this, 0) : __multiset_end(_this);
+}
+
+static /* __always_inline */ inline multiset_node_t* __multiset_small_rbegin(const multiset_t* _this)
+{
+    return _this->size > 0 ? __multiset_small_at(_this, _this->size - 1) : __multiset_rend(_this);
+}
+
+/* One step from `node`, forward or backward, toward `stop` which is `end` or `rend` */
+static multiset_node_t* __multiset_small_step(const multiset_t* _this, const multiset_node_t* node, bool forward, multiset_node_t* stop)
+{
+    multiset_size_t i = __multiset_small_index(_this, node);
+
+    if (i < 0)
+        return NULL;
+
+    i += forward ? 1 : -1;
+    return i >= 0 && i < _this->size ? __multiset_small_at(_this, i) : stop;
+}
+
+static multiset_node_t* __multiset_small_next(const multiset_t* _this, const multiset_node_t* node)
+{
+    if (__multiset_end(_this) == node)
+        return __multiset_end(_this);
+    return __multiset_small_step(_this, node, true, __multiset_end(_this));
+}
+
+static multiset_node_t* __multiset_small_prev(const multiset_t* _this, const multiset_node_t* node)
+{
+    if (__multiset_end(_this) == node)
+        return _this->size > 0 ? __multiset_small_at(_this, _this->size - 1) : __multiset_end(_this);
+    return __multiset_small_step(_this, node, false, __multiset_end(_this));
+}
+
+static multiset_node_t* __multiset_small_rnext(const multiset_t* _this, const multiset_node_t* node)
+{
+    if (__multiset_rend(_this) == node)
+        return __multiset_rend(_this);
+    return __multiset_small_step(_this, node, false, __multiset_rend(_this));
+}
+
+static multiset_node_t* __multiset_small_rprev(const multiset_t* _this, const multiset_node_t* node)
+{
+    if (__multiset_rend(_this) == node)
+        return _this->size > 0 ? __multiset_small_at(_this, 0) : __multiset_rend(_this);
+    return __multiset_small_step(_this, node, true, __multiset_rend(_this));
+}
+
+/* A free slot for the value at `i`, those after it move up. The value of the array is left to the caller */
+static /* __always_inline */ inline multiset_node_t* __multiset_small_open(multiset_t* _this, multiset_size_t i)
+{
+    multiset_small_t* s = _this->small;
+    uint32_t slot = __builtin_ctz(s->free);
+
+    memmove(s->values + i + 1, s->values + i, (_this->size - i) * sizeof(multiset_value_t));
+    memmove(s->order + i + 1, s->order + i, (_this->size - i) * sizeof(uint8_t));
+    s->order[i] = (uint8_t)slot;
+    s->free &= ~(1U << slot);
+    _this->size++;
+    return (multiset_node_t*)&s->slots[slot];
+}
+
+/* The value at `i` goes, its slot is left to the caller */
+static /* __always_inline */ inline void __multiset_small_close(multiset_t* _this, multiset_size_t i)
+{
+    multiset_small_t* s = _this->small;
+
+    s->free |= 1U << s->order[i];
+    memmove(s->values + i, s->values + i + 1, (_this->size - i - 1) * sizeof(multiset_value_t));
+    memmove(s->order + i, s->order + i + 1, (_this->size - i - 1) * sizeof(uint8_t));
+    _this->size--;
+}
+
+static /* __always_inline */ inline void __multiset_small_free_value(multiset_t* _this, multiset_node_t* t)
+{
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&t->value);
+}
+
+/* The values move into nodes of one block, linked into the tree in order. On failure the array stays */
+static bool __multiset_small_promote(multiset_t* _this)
+{
+    multiset_small_t* s = _this->small;
+    struct rb_node* head = NULL;
+    struct rb_node** tail = &head;
+    char* nodes = NULL;
+    multiset_node_t* t = NULL;
+    multiset_size_t i = 0;
+
+    nodes = (char*)ds_block_alloc(&_this->blocks, _this->size, __multiset_node_bytes(_this));
+    if (unlikely(is_null(nodes)))
+        return false;
+
+    for (i = 0; i < _this->size; ++i) {
+        t = (multiset_node_t*)(nodes + i * __multiset_node_bytes(_this));
+        t->value = s->slots[s->order[i]].value;
+        *tail = &t->node;
+        tail = &t->node.rb_right;
+    }
+    *tail = NULL;
+
+    rb_build_sorted(&_this->root, head, _this->size);
+    _this->rightmost = rb_last(&_this->root);
+    if (multiset_os(_this))
+        rb_size_build(&_this->root);
+
+    p_free(_this->small);
+    return true;
+}
+
+/* The values of the tree move to an array and their nodes are freed. On failure the tree stays */
+static void __multiset_small_demote(multiset_t* _this)
+{
+    multiset_small_t* s = NULL;
+    struct rb_node* n = NULL;
+    struct rb_node* next = NULL;
+    multiset_size_t i = 0;
+
+    s = (multiset_small_t*)p_malloc(sizeof(multiset_small_t));
+    if (unlikely(is_null(s)))
+        return;
+
+    for (n = rb_first(&_this->root); !is_null(n); n = rb_next(n), ++i) {
+        s->values[i] = multiset_entry(n)->value;
+        s->order[i] = (uint8_t)i;
+        s->slots[i].value = multiset_entry(n)->value;
+    }
+    s->free = MULTISET_SMALL_SLOTS & ~((1U << i) - 1);
+
+    for (n = rb_first_postorder(&_this->root); !is_null(n); n = next) {
+        next = rb_next_postorder(n);
+        __multiset_node_free(_this, multiset_entry(n));
+    }
+
+    _this->root = RB_ROOT;
+    _this->rightmost = NULL;
+    _this->small = s;
+}
+
+/* An adaptive multiset of `limit` values or fewer goes back to the array */
+static /* __always_inline */ inline void __multiset_small_settle(multiset_t* _this, multiset_size_t limit)
+{
+    if (_this->config.c.b_small && !__multiset_compress(_this) && !__multiset_small(_this) && _this->size > 0 && _this->size <= limit)
+        __multiset_small_demote(_this);
+}
+
+/* As `__multiset_small_settle`, `t` of the tree, or `end`, is followed to where it moved.
+   Equal values tell no slot apart, so it's found by its place in order */
+static multiset_node_t* __multiset_small_settle_at(multiset_t* _this, multiset_size_t limit, multiset_node_t* t)
+{
+    struct rb_node* n = NULL;
+    multiset_size_t k = 0;
+
+    if (!_this->config.c.b_small || __multiset_small(_this) || _this->size > limit)
+        return t;
+
+    for (n = rb_first(&_this->root); __multiset_end(_this) != t && !is_null(n) && n != &t->node; n = rb_next(n))
+        ++k;
+
+    __multiset_small_settle(_this, limit);
+    return __multiset_small(_this) && __multiset_end(_this) != t ? __multiset_small_at(_this, k) : t;
+}
+
+/* Before the tree is worked on directly: the array goes, its values into the tree. On failure the array stays */
+static /* __always_inline */ inline bool __multiset_small_off(multiset_t* _this)
+{
+    if (!__multiset_small(_this))
+        return true;
+
+    if (0 == _this->size) {
+        p_free(_this->small);
+        return true;
+    }
+    return __multiset_small_promote(_this);
+}
+
+static bool __multiset_small_new(multiset_t* _this)
+{
+    multiset_small_t* s = (multiset_small_t*)p_malloc(sizeof(multiset_small_t));
+
+    if (unlikely(is_null(s)))
+        return false;
+
+    s->free = MULTISET_SMALL_SLOTS;
+    _this->small = s;
+    return true;
+}
+
+/* Where `value` goes: right before `hint` if it belongs there, as `insert_hint`, else after the values equal to it */
+static multiset_size_t __multiset_small_place(const multiset_t* _this, multiset_value_t value, const multiset_node_t* hint)
+{
+    const multiset_value_t* e = _this->small->values;
+    multiset_size_t i = is_null(hint) ? -1 : __multiset_small_index(_this, hint);
+
+    if (i >= 0 && !__multiset_lt(_this, e[i], value) && (0 == i || !__multiset_lt(_this, value, e[i - 1])))
+        return i;
+    return __multiset_small_bound(_this, value, true);
+}
+
+/* NULL on failure. A full array goes to the tree, which then takes the insert: `__multiset_small_on`
+   tells the caller, and `*hint` is then moved to the node of the tree where the insert goes.
+   `hint` is NULL but for `insert_hint`, `copy` is false for the value of a handle */
+static multiset_node_t* __multiset_small_insert(multiset_t* _this, multiset_value_t value, multiset_node_t** hint, bool copy)
+{
+    struct rb_node* n = NULL;
+    multiset_node_t* t = NULL;
+    multiset_size_t i = 0;
+
+    if (!__multiset_small(_this) && !__multiset_small_new(_this))
+        return NULL;
+
+    if (_this->size >= MULTISET_SMALL) {
+        i = is_null(hint) ? 0 : __multiset_small_place(_this, value, *hint);
+        if (!__multiset_small_promote(_this) || is_null(hint))
+            return NULL;
+
+        for (n = rb_first(&_this->root); i > 0; --i)
+            n = rb_next(n);
+        *hint = is_null(n) ? __multiset_end(_this) : multiset_entry(n);
+        return NULL;
+    }
+
+    i = __multiset_small_place(_this, value, is_null(hint) ? NULL : *hint);
+    t = __multiset_small_open(_this, i);
+    if (!copy) {
+        t->value = value;
+    } else if (!__multiset_node_fill(_this, t, value)) {
+        __multiset_small_close(_this, i);
+        return NULL;
+    }
+
+    _this->small->values[i] = t->value;
+    return t;
+}
+
+/* Return the value after `pos` or `end` */
+static multiset_node_t* __multiset_small_erase(multiset_t* _this, multiset_node_t* pos)
+{
+    multiset_size_t i = __multiset_small_index(_this, pos);
+
+    if (i < 0)
+        return NULL;
+
+    __multiset_small_free_value(_this, pos);
+    __multiset_small_close(_this, i);
+    return i < _this->size ? __multiset_small_at(_this, i) : __multiset_end(_this);
+}
+
+static multiset_size_t __multiset_small_clear(multiset_t* _this)
+{
+    multiset_size_t ret = _this->size;
+    multiset_size_t i = 0;
+
+    for (i = 0; i < _this->size; ++i)
+        __multiset_small_free_value(_this, __multiset_small_at(_this, i));
+
+    p_free(_this->small);
+    _this->size = 0;
+    return ret;
+}
+
+/* Values in [ lo, hi ) */
+static multiset_size_t __multiset_small_erase_range(multiset_t* _this, multiset_value_t lo, multiset_value_t hi)
+{
+    multiset_small_t* s = _this->small;
+    multiset_size_t l = __multiset_small_bound(_this, lo, false);
+    multiset_size_t h = __multiset_small_bound(_this, hi, false);
+    multiset_size_t i = 0;
+
+    for (i = l; i < h; ++i) {
+        __multiset_small_free_value(_this, __multiset_small_at(_this, i));
+        s->free |= 1U << s->order[i];
+    }
+
+    memmove(s->values + l, s->values + h, (_this->size - h) * sizeof(multiset_value_t));
+    memmove(s->order + l, s->order + h, (_this->size - h) * sizeof(uint8_t));
+    _this->size -= h - l;
+    return h - l;
+}
@@ -133,6 +133,13 @@ static /* __always_inline */ inline bool ds_ops_valid_key_default_string_max_n(d
     return strcmp(l, r) < 0; /* TODO: security */
 }
 
+/* __always_inline */ inline int __ds_ops_cmp_default_string(ds_data_t left, ds_data_t right)
+{
+    char* l = (char*)left;
+    char* r = (char*)right;
+    return strcmp(l, r); /* TODO: security */
+}
+
 /* __always_inline */ inline bool __ds_ops_gt_default_string(ds_data_t left, ds_data_t right)
 {
     char* l = (char*)left;
@@ -0,0 +1,688 @@
+/*
+  Persistent Map and Set
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <pmap/pmap.h>
+
+#include <sched.h>
+#include <_memory.h>
+#include <linux/_compiler.h>
+#include <iterator/iterator.h>
+
+#define __pmap_height(n) (is_null(n) ? 0 : (n)->height)
+
+static /* __always_inline */ inline int __pmap_cmp(const pmap_t* _this, pmap_key_t left, pmap_key_t right)
+{
+    if (is_null(_this->ops.__lt))
+        return left < right ? -1 : left > right;
+
+    if (!is_null(_this->ops.__cmp))
+        return _this->ops.__cmp(left, right);
+
+    return _this->ops.__lt(left, right) ? -1 : _this->ops.__lt(right, left);
+}
+
+static /* __always_inline */ inline pmap_node_t* __pmap_node_retain(pmap_node_t* node)
+{
+    if (!is_null(node))
+        __atomic_add_fetch(&node->refs, 1, __ATOMIC_RELAXED);
+    return node;
+}
+
+static void __pmap_node_release(const pmap_t* _this, pmap_node_t* node)
+{
+    pmap_node_t* t = NULL;
+
+    /* Recurse on the left, loop on the right */
+    while (!is_null(node) && 0 == __atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL)) {
+        t = node;
+        __pmap_node_release(_this, t->left);
+        node = t->right;
+
+        if (!is_null(_this->ops.free_value))
+            _this->ops.free_value(&t->value);
+
+        if (!is_null(_this->ops.free_key))
+            _this->ops.free_key(&t->key);
+
+        p_free(t);
+    }
+}
+
+static pmap_node_t* __pmap_node_new(const pmap_t* _this, pmap_key_t key, pmap_value_t value)
+{
+    pmap_node_t* t = (pmap_node_t*)p_calloc(1, sizeof(pmap_node_t));
+
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    if (is_null(_this->ops.copy_key)) {
+        t->key = key;
+    } else {
+        if (!_this->ops.copy_key(key, &t->key))
+            goto err;
+    }
+
+    if (is_null(_this->ops.copy_value)) {
+        t->value = value;
+    } else {
+        if (!_this->ops.copy_value(value, &t->value))
+            goto err;
+    }
+
+    t->height = 1;
+    t->refs = 1;
+    return t;
+
+err:
+    if (!is_null(_this->ops.free_value))
+        _this->ops.free_value(&t->value);
+
+    if (!is_null(_this->ops.free_key))
+        _this->ops.free_key(&t->key);
+
+    p_free(t);
+    return NULL;
+}
+
+/* `node` over `left` and `right`, the three references are handed over, NULL if out of memory.
+   `node` is changed in place if nobody else holds it, else copied */
+static pmap_node_t* __pmap_with(const pmap_t* _this, pmap_node_t* node, pmap_node_t* left, pmap_node_t* right)
+{
+    pmap_node_t* t = NULL;
+    int hl = __pmap_height(left);
+    int hr = __pmap_height(right);
+
+    if (1 == __atomic_load_n(&node->refs, __ATOMIC_ACQUIRE)) {
+        __pmap_node_release(_this, node->left);
+        __pmap_node_release(_this, node->right);
+        t = node;
+    } else {
+        t = __pmap_node_new(_this, node->key, node->value);
+        __pmap_node_release(_this, node);
+        if (unlikely(is_null(t))) {
+            __pmap_node_release(_this, left);
+            __pmap_node_release(_this, right);
+            return NULL;
+        }
+    }
+
+    t->left = left;
+    t->right = right;
+    t->height = 1 + (hl > hr ? hl : hr);
+    return t;
+}
+
+/* As `__pmap_with`, rotated back into AVL shape when `left` and `right` differ by 2 in height */
+static pmap_node_t* __pmap_balance(const pmap_t* _this, pmap_node_t* node, pmap_node_t* left, pmap_node_t* right)
+{
+    pmap_node_t* a = NULL;
+    pmap_node_t* b = NULL;
+    pmap_node_t* c = NULL;
+    pmap_node_t* m = NULL;
+    int hl = __pmap_height(left);
+    int hr = __pmap_height(right);
+
+    if (hl > hr + 1) {
+        if (__pmap_height(left->left) >= __pmap_height(left->right)) {
+            a = __pmap_node_retain(left->left);
+            b = __pmap_with(_this, node, __pmap_node_retain(left->right), right);
+            if (unlikely(is_null(b))) {
+                __pmap_node_release(_this, a);
+                __pmap_node_release(_this, left);
+                return NULL;
+            }
+            return __pmap_with(_this, left, a, b);
+        }
+
+        /* The references below are taken before `left` may go */
+        m = __pmap_node_retain(left->right);
+        a = __pmap_node_retain(left->left);
+        b = __pmap_node_retain(m->left);
+        c = __pmap_node_retain(m->right);
+        a = __pmap_with(_this, left, a, b);
+        if (unlikely(is_null(a))) {
+            __pmap_node_release(_this, c);
+            __pmap_node_release(_this, m);
+            __pmap_node_release(_this, node);
+            __pmap_node_release(_this, right);
+            return NULL;
+        }
+        b = __pmap_with(_this, node, c, right);
+        if (unlikely(is_null(b))) {
+            __pmap_node_release(_this, a);
+            __pmap_node_release(_this, m);
+            return NULL;
+        }
+        return __pmap_with(_this, m, a, b);
+    }
+
+    if (hr > hl + 1) {
+        if (__pmap_height(right->right) >= __pmap_height(right->left)) {
+            a = __pmap_node_retain(right->right);
+            b = __pmap_with(_this, node, left, __pmap_node_retain(right->left));
+            if (unlikely(is_null(b))) {
+                __pmap_node_release(_this, a);
+                __pmap_node_release(_this, right);
+                return NULL;
+            }
+            return __pmap_with(_this, right, b, a);
+        }
+
+        m = __pmap_node_retain(right->left);
+        a = __pmap_node_retain(right->right);
+        b = __pmap_node_retain(m->right);
+        c = __pmap_node_retain(m->left);
+        a = __pmap_with(_this, right, b, a);
+        if (unlikely(is_null(a))) {
+            __pmap_node_release(_this, c);
+            __pmap_node_release(_this, m);
+            __pmap_node_release(_this, node);
+            __pmap_node_release(_this, left);
+            return NULL;
+        }
+        b = __pmap_with(_this, node, left, c);
+        if (unlikely(is_null(b))) {
+            __pmap_node_release(_this, a);
+            __pmap_node_release(_this, m);
+            return NULL;
+        }
+        return __pmap_with(_this, m, b, a);
+    }
+
+    return __pmap_with(_this, node, left, right);
+}
+
+/* A new subtree for `node` holding `key`, `node` itself is only borrowed */
+static pmap_node_t* __pmap_insert_node(const pmap_t* _this, pmap_node_t* node, pmap_key_t key, pmap_value_t value)
+{
+    pmap_node_t* t = NULL;
+    int c = 0;
+
+    if (is_null(node))
+        return __pmap_node_new(_this, key, value);
+
+    c = __pmap_cmp(_this, key, node->key);
+    if (0 == c) {
+        t = __pmap_node_new(_this, node->key, value);
+        if (unlikely(is_null(t)))
+            return NULL;
+        t->left = __pmap_node_retain(node->left);
+        t->right = __pmap_node_retain(node->right);
+        t->height = node->height;
+        return t;
+    }
+
+    if (c < 0) {
+        t = __pmap_insert_node(_this, node->left, key, value);
+        if (unlikely(is_null(t)))
+            return NULL;
+        return __pmap_balance(_this, __pmap_node_retain(node), t, __pmap_node_retain(node->right));
+    }
+
+    t = __pmap_insert_node(_this, node->right, key, value);
+    if (unlikely(is_null(t)))
+        return NULL;
+    return __pmap_balance(_this, __pmap_node_retain(node), __pmap_node_retain(node->left), t);
+}
+
+/* The subtree `node` without its least node, handed over in `min` */
+static bool __pmap_remove_min(const pmap_t* _this, pmap_node_t* node, pmap_node_t** out, pmap_node_t** min)
+{
+    pmap_node_t* t = NULL;
+
+    if (is_null(node->left)) {
+        *min = __pmap_node_retain(node);
+        *out = __pmap_node_retain(node->right);
+        return true;
+    }
+
+    if (!__pmap_remove_min(_this, node->left, &t, min))
+        return false;
+
+    *out = __pmap_balance(_this, __pmap_node_retain(node), t, __pmap_node_retain(node->right));
+    if (unlikely(is_null(*out))) {
+        __pmap_node_release(_this, *min);
+        return false;
+    }
+    return true;
+}
+
+/* The subtree `node` without `key`, which must be in it. `*out` may be NULL */
+static bool __pmap_remove_node(const pmap_t* _this, pmap_node_t* node, pmap_key_t key, pmap_node_t** out)
+{
+    pmap_node_t* t = NULL;
+    pmap_node_t* min = NULL;
+    int c = __pmap_cmp(_this, key, node->key);
+
+    if (c < 0) {
+        if (!__pmap_remove_node(_this, node->left, key, &t))
+            return false;
+        *out = __pmap_balance(_this, __pmap_node_retain(node), t, __pmap_node_retain(node->right));
+        return !is_null(*out);
+    }
+
+    if (c > 0) {
+        if (!__pmap_remove_node(_this, node->right, key, &t))
+            return false;
+        *out = __pmap_balance(_this, __pmap_node_retain(node), __pmap_node_retain(node->left), t);
+        return !is_null(*out);
+    }
+
+    if (is_null(node->left) || is_null(node->right)) {
+        *out = __pmap_node_retain(is_null(node->left) ? node->right : node->left);
+        return true;
+    }
+
+    if (!__pmap_remove_min(_this, node->right, &t, &min))
+        return false;
+
+    *out = __pmap_balance(_this, min, __pmap_node_retain(node->left), t);
+    return !is_null(*out);
+}
+
+static pmap_node_t* __pmap_find(const pmap_t* _this, pmap_key_t key)
+{
+    pmap_node_t* n = _this->root;
+    int c = 0;
+
+    while (!is_null(n)) {
+        c = __pmap_cmp(_this, key, n->key);
+        if (0 == c)
+            return n;
+        n = c < 0 ? n->left : n->right;
+    }
+    return NULL;
+}
+
+static pmap_node_t* __pmap_bound(const pmap_t* _this, pmap_key_t key, bool upper)
+{
+    pmap_node_t* n = _this->root;
+    pmap_node_t* ret = NULL;
+    int c = 0;
+
+    while (!is_null(n)) {
+        c = __pmap_cmp(_this, n->key, key);
+        if (c > 0 || (0 == c && !upper)) {
+            ret = n;
+            n = n->left;
+        } else {
+            n = n->right;
+        }
+    }
+    return ret;
+}
+
+/* Only the subtrees reaching into [ lo, hi ) are entered, O(log n + k) */
+static bool __pmap_walk(const pmap_t* _this, const pmap_node_t* node, pmap_key_t lo, pmap_key_t hi,
+                        for_each_kv cb, for_each_v cb_v, void* arg, pmap_size_t* count)
+{
+    while (!is_null(node)) {
+        if (__pmap_cmp(_this, node->key, lo) < 0) {
+            node = node->right;
+            continue;
+        }
+
+        if (__pmap_cmp(_this, node->key, hi) >= 0) {
+            node = node->left;
+            continue;
+        }
+
+        if (!__pmap_walk(_this, node->left, lo, hi, cb, cb_v, arg, count))
+            return false;
+
+        (*count)++;
+        if (is_null(cb) ? !cb_v(node->key, arg) : !cb(node->key, node->value, arg))
+            return false;
+
+        node = node->right;
+    }
+    return true;
+}
+
+static pmap_t* __pmap_version(const pmap_t* _this, pmap_node_t* root, pmap_size_t size)
+{
+    pmap_t* t = (pmap_t*)p_malloc(sizeof(pmap_t));
+
+    if (unlikely(is_null(t))) {
+        __pmap_node_release(_this, root);
+        return NULL;
+    }
+
+    t->ops = _this->ops;
+    t->root = root;
+    t->size = size;
+    t->refs = 1;
+    return t;
+}
+
+static pmap_t* pmap_create(const class_map_ops_t* ops)
+{
+    pmap_t* t = (pmap_t*)p_calloc(1, sizeof(pmap_t));
+
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    if (!is_null(ops))
+        t->ops = *ops;
+    t->refs = 1;
+    return t;
+}
+
+static pmap_t* pset_create(const class_set_ops_t* ops)
+{
+    pmap_t* t = pmap_create(NULL);
+
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    if (!is_null(ops)) {
+        t->ops.valid_key = ops->valid_value;
+        t->ops.__lt      = ops->__lt_value;
+        t->ops.__cmp     = ops->__cmp_value;
+        t->ops.copy_key  = ops->copy_value;
+        t->ops.free_key  = ops->free_value;
+    }
+    return t;
+}
+
+static pmap_t* pmap_retain(pmap_t* _this)
+{
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    __atomic_add_fetch(&_this->refs, 1, __ATOMIC_RELAXED);
+    return _this;
+}
+
+static void pmap_release(pmap_t* _this)
+{
+    if (unlikely(is_null(_this)))
+        return;
+
+    if (0 != __atomic_sub_fetch(&_this->refs, 1, __ATOMIC_ACQ_REL))
+        return;
+
+    __pmap_node_release(_this, _this->root);
+    p_free(_this);
+}
+
+static pmap_size_t pmap_size(const pmap_t* _this)
+{
+    if (unlikely(is_null(_this)))
+        return -1;
+    return _this->size;
+}
+
+static /* __always_inline */ inline pmap_node_t* __pmap_end(const pmap_t* _this)
+{
+    return (pmap_node_t*)iterator_end();
+}
+
+static pmap_node_t* pmap_begin(const pmap_t* _this)
+{
+    pmap_node_t* n = NULL;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (is_null(n = _this->root))
+        return __pmap_end(_this);
+
+    while (!is_null(n->left))
+        n = n->left;
+    return n;
+}
+
+static pmap_node_t* pmap_next(const pmap_t* _this, const pmap_node_t* node)
+{
+    pmap_node_t* t = NULL;
+
+    if (unlikely(is_null(_this) || is_null(node)))
+        return NULL;
+
+    if (__pmap_end(_this) == node)
+        return __pmap_end(_this);
+
+    t = __pmap_bound(_this, node->key, true);
+    return is_null(t) ? __pmap_end(_this) : t;
+}
+
+static pmap_node_t* pmap_find(const pmap_t* _this, pmap_key_t key)
+{
+    pmap_node_t* t = NULL;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (!is_null(_this->ops.valid_key) && !_this->ops.valid_key(key))
+        return __pmap_end(_this);
+
+    t = __pmap_find(_this, key);
+    return is_null(t) ? __pmap_end(_this) : t;
+}
+
+static pmap_node_t* pmap_lower_bound(const pmap_t* _this, pmap_key_t key)
+{
+    pmap_node_t* t = NULL;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (!is_null(_this->ops.valid_key) && !_this->ops.valid_key(key))
+        return __pmap_end(_this);
+
+    t = __pmap_bound(_this, key, false);
+    return is_null(t) ? __pmap_end(_this) : t;
+}
+
+static pmap_node_t* pmap_upper_bound(const pmap_t* _this, pmap_key_t key)
+{
+    pmap_node_t* t = NULL;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (!is_null(_this->ops.valid_key) && !_this->ops.valid_key(key))
+        return __pmap_end(_this);
+
+    t = __pmap_bound(_this, key, true);
+    return is_null(t) ? __pmap_end(_this) : t;
+}
+
+static pmap_t* __pmap_insert(const pmap_t* _this, pmap_key_t key, pmap_value_t value, bool replace)
+{
+    pmap_node_t* root = NULL;
+    bool exists = false;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (!is_null(_this->ops.valid_value) && !_this->ops.valid_value(value))
+        return NULL;
+
+    if (!is_null(_this->ops.valid_key) && !_this->ops.valid_key(key))
+        return NULL;
+
+    exists = !is_null(__pmap_find(_this, key));
+    if (exists && !replace)
+        return NULL;
+
+    root = __pmap_insert_node(_this, _this->root, key, value);
+    if (unlikely(is_null(root)))
+        return NULL;
+
+    return __pmap_version(_this, root, _this->size + !exists);
+}
+
+static pmap_t* pmap_insert(const pmap_t* _this, pmap_key_t key, pmap_value_t value)
+{
+    return __pmap_insert(_this, key, value, false);
+}
+
+static pmap_t* pmap_insert_replace(const pmap_t* _this, pmap_key_t key, pmap_value_t value)
+{
+    return __pmap_insert(_this, key, value, true);
+}
+
+static pmap_t* pset_insert(const pmap_t* _this, pmap_key_t value)
+{
+    return __pmap_insert(_this, value, 0, false);
+}
+
+static pmap_t* pmap_remove(const pmap_t* _this, pmap_key_t key)
+{
+    pmap_node_t* root = NULL;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (!is_null(_this->ops.valid_key) && !_this->ops.valid_key(key))
+        return NULL;
+
+    if (is_null(__pmap_find(_this, key)))
+        return NULL;
+
+    if (!__pmap_remove_node(_this, _this->root, key, &root))
+        return NULL;
+
+    return __pmap_version(_this, root, _this->size - 1);
+}
+
+static pmap_size_t __pmap_for_each_range(const pmap_t* _this, pmap_key_t lo, pmap_key_t hi, for_each_kv cb, for_each_v cb_v, void* arg)
+{
+    pmap_size_t ret = 0;
+
+    if (unlikely(is_null(_this) || (is_null(cb) && is_null(cb_v))))
+        return -1;
+
+    if (!is_null(_this->ops.valid_key) && (!_this->ops.valid_key(lo) || !_this->ops.valid_key(hi)))
+        return -1;
+
+    __pmap_walk(_this, _this->root, lo, hi, cb, cb_v, arg, &ret);
+    return ret;
+}
+
+static pmap_size_t pmap_for_each_range(const pmap_t* _this, pmap_key_t lo, pmap_key_t hi, for_each_kv cb, void* arg)
+{
+    if (unlikely(is_null(cb)))
+        return -1;
+    return __pmap_for_each_range(_this, lo, hi, cb, NULL, arg);
+}
+
+static pmap_size_t pset_for_each_range(const pmap_t* _this, pmap_key_t lo, pmap_key_t hi, for_each_v cb, void* arg)
+{
+    if (unlikely(is_null(cb)))
+        return -1;
+    return __pmap_for_each_range(_this, lo, hi, NULL, cb, arg);
+}
+
+static void pmap_publish(pmap_slot_t* slot, pmap_t* version)
+{
+    pmap_t* old = NULL;
+    unsigned long index = 0;
+
+    if (unlikely(is_null(slot)))
+        return;
+
+    pmap_retain(version);
+    old = __atomic_exchange_n(&slot->version, version, __ATOMIC_SEQ_CST);
+
+    /* A reader counted on the old parity may still be taking `old`, the new ones can't see it */
+    index = __atomic_fetch_add(&slot->index, 1, __ATOMIC_SEQ_CST);
+    while (0 != __atomic_load_n(&slot->readers[index & 1], __ATOMIC_SEQ_CST))
+        sched_yield();
+
+    pmap_release(old);
+}
+
+static pmap_t* pmap_acquire(pmap_slot_t* slot)
+{
+    pmap_t* t = NULL;
+    unsigned long index = 0;
+
+    if (unlikely(is_null(slot)))
+        return NULL;
+
+    /* Counted on a parity no `publish` has flipped away from yet */
+    while (true) {
+        index = __atomic_load_n(&slot->index, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&slot->readers[index & 1], 1, __ATOMIC_SEQ_CST);
+        if (index == __atomic_load_n(&slot->index, __ATOMIC_SEQ_CST))
+            break;
+        __atomic_sub_fetch(&slot->readers[index & 1], 1, __ATOMIC_SEQ_CST);
+    }
+
+    t = pmap_retain(__atomic_load_n(&slot->version, __ATOMIC_SEQ_CST));
+    __atomic_sub_fetch(&slot->readers[index & 1], 1, __ATOMIC_SEQ_CST);
+    return t;
+}
+
+typedef map_iterator_t* (*fp_end)(const pmap_t* _this);
+typedef map_iterator_t* (*fp_begin)(const pmap_t* _this);
+typedef map_iterator_t* (*fp_next)(const pmap_t* _this, const map_iterator_t* iterator);
+typedef map_iterator_t* (*fp_find)(const pmap_t* _this, pmap_key_t key);
+typedef set_iterator_t* (*fp_s_end)(const pmap_t* _this);
+typedef set_iterator_t* (*fp_s_begin)(const pmap_t* _this);
+typedef set_iterator_t* (*fp_s_next)(const pmap_t* _this, const set_iterator_t* iterator);
+typedef set_iterator_t* (*fp_s_find)(const pmap_t* _this, pmap_key_t value);
+
+const class_pmap_t* class_pmap_ins(void)
+{
+    static const class_pmap_t ins = {
+        .create         = pmap_create,
+        .retain         = pmap_retain,
+        .release        = pmap_release,
+        .size           = pmap_size,
+        .end            = (fp_end)__pmap_end,
+        .begin          = (fp_begin)pmap_begin,
+        .next           = (fp_next)pmap_next,
+        .find           = (fp_find)pmap_find,
+        .lower_bound    = (fp_find)pmap_lower_bound,
+        .upper_bound    = (fp_find)pmap_upper_bound,
+        .insert         = pmap_insert,
+        .insert_replace = pmap_insert_replace,
+        .remove         = pmap_remove,
+        .for_each_range = pmap_for_each_range,
+        .publish        = pmap_publish,
+        .acquire        = pmap_acquire,
+    };
+    return &ins;
+}
+
+const class_pset_t* class_pset_ins(void)
+{
+    static const class_pset_t ins = {
+        .create         = pset_create,
+        .retain         = pmap_retain,
+        .release        = pmap_release,
+        .size           = pmap_size,
+        .end            = (fp_s_end)__pmap_end,
+        .begin          = (fp_s_begin)pmap_begin,
+        .next           = (fp_s_next)pmap_next,
+        .find           = (fp_s_find)pmap_find,
+        .lower_bound    = (fp_s_find)pmap_lower_bound,
+        .upper_bound    = (fp_s_find)pmap_upper_bound,
+        .insert         = pset_insert,
+        .remove         = pmap_remove,
+        .for_each_range = pset_for_each_range,
+        .publish        = pmap_publish,
+        .acquire        = pmap_acquire,
+    };
+    return &ins;
+}
@@ -19,15 +19,51 @@
 
 #include <set/set.h>
 
+#include <_block.h>
+#include <_handle.h>
+#include <_finger.h>
+#include <_thread.h>
 #include <_memory.h>
+#include <sort/sort.h>
 #include <linux/rbtree.h>
 #include <linux/_compiler.h>
 #include <iterator/iterator.h>
 
 #define set_entry(ptr) rb_entry((ptr), struct set_node, node)
+#define set_os(_this)  ((_this)->config.c.b_order_stat)
+#define set_thread(_this) ((_this)->config.c.b_thread)
+
+#define SET_BATCH_GROUP 16 /* Descents in flight in `find_batch` */
 
 static /* __always_inline */ inline set_node_t* set_find(const set_t* _this, set_value_t value);
 static /* __always_inline */ inline set_node_t* __set_end(const set_t* _this);
+static /* __always_inline */ inline set_node_t* __set_rend(const set_t* _this);
+static /* __always_inline */ inline bool __set_lt(const set_t* _this, set_value_t left, set_value_t right);
+static bool __set_node_fill(set_t* _this, set_node_t* t, set_value_t value);
+static /* __always_inline */ inline void __set_node_free(set_t* _this, set_node_t* node);
+
+static /* __always_inline */ inline size_t __set_node_bytes(const set_t* _this)
+{
+    return sizeof(set_node_t) + (set_os(_this) ? RB_SIZE_EXTRA : 0) + (set_thread(_this) ? DS_THREAD_EXTRA : 0);
+}
+
+/* From the `rb_node` to its thread, past the size word */
+static /* __always_inline */ inline size_t __set_thread_off(const set_t* _this)
+{
+    return sizeof(struct rb_node) + (set_os(_this) ? RB_SIZE_EXTRA : 0);
+}
+
+static /* __always_inline */ inline struct rb_node* __set_succ(const set_t* _this, const struct rb_node* n)
+{
+    return set_thread(_this) ? ds_thread_of(n, __set_thread_off(_this))->next : rb_next(n);
+}
+
+static /* __always_inline */ inline struct rb_node* __set_pred(const set_t* _this, const struct rb_node* n)
+{
+    return set_thread(_this) ? ds_thread_of(n, __set_thread_off(_this))->prev : rb_prev(n);
+}
+
+#include <../set/set_small.c>
 
 static /* __always_inline */ inline set_size_t __set_size(const set_t* _this)
 {
@@ -49,13 +85,13 @@ static /* __always_inline */ inline set_count_t set_count(const set_t* _this, se
 
 static /* __always_inline */ inline set_node_t* __set_first(const set_t* _this)
 {
-    struct rb_node* t = rb_first(&_this->root);
+    struct rb_node* t = set_thread(_this) ? _this->leftmost : rb_first(&_this->root);
     return is_null(t) ? NULL : set_entry(t);
 }
 
 static /* __always_inline */ inline set_node_t* __set_last(const set_t* _this)
 {
-    struct rb_node* t = rb_last(&_this->root);
+    struct rb_node* t = set_thread(_this) ? _this->rightmost : rb_last(&_this->root);
     return is_null(t) ? NULL : set_entry(t);
 }
 
@@ -66,7 +102,12 @@ static /* __always_inline */ inline set_node_t* __set_end(const set_t* _this)
 
 static /* __always_inline */ inline set_node_t* __set_begin(const set_t* _this)
 {
-    set_node_t* t = __set_first(_this);
+    set_node_t* t = NULL;
+
+    if (__set_small(_this))
+        return __set_small_begin(_this);
+
+    t = __set_first(_this);
     return is_null(t) ? __set_end(_this) : t;
 }
 
@@ -81,6 +122,9 @@ static /* __always_inline */ inline set_node_t* __set_next(const set_t* _this, c
 {
     struct rb_node* t = NULL;
 
+    if (__set_small(_this))
+        return __set_small_next(_this, node);
+
     if (RB_EMPTY_ROOT(&_this->root) || __set_end(_this) == node)
         return __set_end(_this);
 
@@ -92,7 +136,7 @@ static /* __always_inline */ inline set_node_t* __set_next(const set_t* _this, c
     if (unlikely(RB_EMPTY_NODE(&node->node)))
         return NULL;
 
-    t = rb_next(&node->node);
+    t = __set_succ(_this, &node->node);
     return is_null(t) ? __set_end(_this) : set_entry(t);
 }
 
@@ -107,6 +151,9 @@ static /* __always_inline */ inline set_node_t* __set_prev(const set_t* _this, c
 {
     struct rb_node* t = NULL;
 
+    if (__set_small(_this))
+        return __set_small_prev(_this, node);
+
     if (RB_EMPTY_ROOT(&_this->root))
         return __set_end(_this);
 
@@ -119,7 +166,7 @@ static /* __always_inline */ inline set_node_t* __set_prev(const set_t* _this, c
     if (unlikely(RB_EMPTY_NODE(&node->node)))
         return NULL;
 
-    t = rb_prev(&node->node);
+    t = __set_pred(_this, &node->node);
     return is_null(t) ? __set_end(_this) : set_entry(t);
 }
 
@@ -137,7 +184,12 @@ static /* __always_inline */ inline set_node_t* __set_rend(const set_t* _this)
 
 static /* __always_inline */ inline set_node_t* __set_rbegin(const set_t* _this)
 {
-    set_node_t* t = __set_last(_this);
+    set_node_t* t = NULL;
+
+    if (__set_small(_this))
+        return __set_small_rbegin(_this);
+
+    t = __set_last(_this);
     return is_null(t) ? __set_rend(_this) : t;
 }
 
@@ -152,6 +204,9 @@ static /* __always_inline */ inline set_node_t* __set_rnext(const set_t* _this,
 {
     struct rb_node* t = NULL;
 
+    if (__set_small(_this))
+        return __set_small_rnext(_this, node);
+
     if (RB_EMPTY_ROOT(&_this->root) || __set_rend(_this) == node)
         return __set_rend(_this);
 
@@ -163,7 +218,7 @@ static /* __always_inline */ inline set_node_t* __set_rnext(const set_t* _this,
     if (unlikely(RB_EMPTY_NODE(&node->node)))
         return NULL;
 
-    t = rb_prev(&node->node);
+    t = __set_pred(_this, &node->node);
     return is_null(t) ? __set_rend(_this) : set_entry(t);
 }
 
@@ -178,6 +233,9 @@ static /* __always_inline */ inline set_node_t* __set_rprev(const set_t* _this,
 {
     struct rb_node* t = NULL;
 
+    if (__set_small(_this))
+        return __set_small_rprev(_this, node);
+
     if (RB_EMPTY_ROOT(&_this->root))
         return __set_rend(_this);
 
@@ -190,7 +248,7 @@ static /* __always_inline */ inline set_node_t* __set_rprev(const set_t* _this,
     if (unlikely(RB_EMPTY_NODE(&node->node)))
         return NULL;
 
-    t = rb_next(&node->node);
+    t = __set_succ(_this, &node->node);
     return is_null(t) ? __set_rend(_this) : set_entry(t);
 }
 
@@ -205,6 +263,7 @@ static set_node_t* __set_find(const set_t* _this, set_value_t value)
 {
     struct rb_node* n = _this->root.rb_node;
     set_node_t* t = NULL;
+    int cmp = 0;
 
     if (is_null(_this->ops) || is_null(_this->ops->__lt_value)) {
         while (!is_null(n)) {
@@ -217,6 +276,18 @@ static set_node_t* __set_find(const set_t* _this, set_value_t value)
             else
                 return t;
         }
+    } else if (!is_null(_this->ops->__cmp_value)) {
+        while (!is_null(n)) {
+            t = set_entry(n);
+            cmp = _this->ops->__cmp_value(value, t->value);
+
+            if (cmp < 0)
+                n = n->rb_left;
+            else if (cmp > 0)
+                n = n->rb_right;
+            else
+                return t;
+        }
     } else {
         while (!is_null(n)) {
             t = set_entry(n);
@@ -243,15 +314,155 @@ static /* __always_inline */ inline set_node_t* set_find(const set_t* _this, set
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
         return NULL;
 
-    t = __set_find(_this, value);
+    t = __set_small(_this) ? __set_small_find(_this, value) : __set_find(_this, value);
     return is_null(t) ? __set_end(_this) : t;
 }
 
+static /* __always_inline */ inline int __set_batch_cmp(const set_t* _this, set_value_t value, set_value_t other)
+{
+    if (is_null(_this->ops) || is_null(_this->ops->__lt_value))
+        return (value > other) - (value < other);
+    if (!is_null(_this->ops->__cmp_value))
+        return _this->ops->__cmp_value(value, other);
+    return _this->ops->__lt_value(value, other) ? -1 : _this->ops->__lt_value(other, value);
+}
+
+/* Hand the next lookup to a free slot, the lookups that need no descent are answered here */
+static /* __always_inline */ inline bool __set_batch_start(const set_t* _this, const set_value_t* values, set_size_t n, set_node_t** out, set_size_t* next, struct rb_node** node, set_size_t* index)
+{
+    set_size_t i = 0;
+
+    while (*next < n) {
+        i = (*next)++;
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(values[i])) {
+            out[i] = NULL;
+        } else if (is_null(_this->root.rb_node)) {
+            out[i] = __set_end(_this);
+        } else {
+            *node  = _this->root.rb_node;
+            *index = i;
+            return true;
+        }
+    }
+
+    *node = NULL;
+    return false;
+}
+
+/*
+  AMAC: every slot is one lookup stepped a level at a time, round robin. The child
+  of a step is prefetched and waited for while the other slots step, so up to
+  `SET_BATCH_GROUP` cache misses overlap instead of one per level and lookup
+*/
+static set_size_t set_find_batch(const set_t* _this, const set_value_t* values, set_size_t n, set_node_t** out)
+{
+    struct rb_node* node[SET_BATCH_GROUP];
+    set_size_t index[SET_BATCH_GROUP];
+    struct rb_node* c = NULL;
+    set_node_t* t = NULL;
+    set_size_t next = 0;
+    set_size_t found = 0;
+    int live = 0;
+    int cmp = 0;
+    int i = 0;
+
+    if (unlikely(is_null(_this) || is_null(values) || is_null(out) || n < 0))
+        return -1;
+
+    if (__set_small(_this)) {
+        for (next = 0; next < n; ++next) {
+            out[next] = set_find(_this, values[next]);
+            found += !is_null(out[next]) && __set_end(_this) != out[next];
+        }
+        return found;
+    }
+
+    for (i = 0; i < SET_BATCH_GROUP; ++i)
+        live += __set_batch_start(_this, values, n, out, &next, &node[i], &index[i]);
+
+    while (live > 0) {
+        for (i = 0; i < SET_BATCH_GROUP; ++i) {
+            if (is_null(node[i]))
+                continue;
+
+            t = set_entry(node[i]);
+            cmp = __set_batch_cmp(_this, values[index[i]], t->value);
+
+            if (0 == cmp) {
+                out[index[i]] = t;
+                ++found;
+            } else {
+                c = cmp < 0 ? node[i]->rb_left : node[i]->rb_right;
+
+                if (!is_null(c)) {
+                    __builtin_prefetch(&set_entry(c)->value);
+                    __builtin_prefetch(&c->rb_left);
+                    node[i] = c;
+                    continue;
+                }
+                out[index[i]] = __set_end(_this);
+            }
+
+            if (!__set_batch_start(_this, values, n, out, &next, &node[i], &index[i]))
+                --live;
+        }
+    }
+
+    return found;
+}
+
+/* One walk for the values in order, see `_finger.h`. Either `bitmap` or `out` is filled */
+static set_size_t __set_probe_sorted(const set_t* _this, const set_value_t* values, set_size_t n, uint64_t* bitmap, set_node_t** out)
+{
+    ds_finger_t finger = DS_FINGER_INIT;
+    __comp lt = is_null(_this->ops) ? NULL : _this->ops->__lt_value;
+    struct rb_node* lb = NULL;
+    set_node_t* t = NULL;
+    set_size_t found = 0;
+    set_size_t i = 0;
+
+    for (i = 0; i < n; ++i) {
+        if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(values[i])) {
+            t = NULL;
+        } else if (__set_small(_this)) {
+            t = __set_small_find(_this, values[i]);
+            t = is_null(t) ? __set_end(_this) : t;
+        } else {
+            lb = ds_finger_lower_bound(&_this->root, &finger, values[i], offsetof(set_node_t, node), lt);
+            t = !is_null(lb) && !__set_lt(_this, values[i], set_entry(lb)->value) ? set_entry(lb) : __set_end(_this);
+        }
+
+        found += !is_null(t) && __set_end(_this) != t;
+        if (!is_null(bitmap))
+            ds_bitmap_put(bitmap, i, !is_null(t) && __set_end(_this) != t);
+        else
+            out[i] = t;
+    }
+
+    return found;
+}
+
+static set_size_t set_contains_sorted(const set_t* _this, const set_value_t* values, set_size_t n, uint64_t* bitmap)
+{
+    if (unlikely(is_null(_this) || is_null(values) || is_null(bitmap) || n < 0))
+        return -1;
+    return __set_probe_sorted(_this, values, n, bitmap, NULL);
+}
+
+static set_size_t set_find_sorted(const set_t* _this, const set_value_t* values, set_size_t n, set_node_t** out)
+{
+    if (unlikely(is_null(_this) || is_null(values) || is_null(out) || n < 0))
+        return -1;
+    return __set_probe_sorted(_this, values, n, NULL, out);
+}
+
 static set_node_t* __set_lower_bound(const set_t* _this, set_value_t value)
 {
     struct rb_node* n = _this->root.rb_node;
     set_node_t* t = NULL;
     set_node_t* ret = NULL;
+    int cmp = 0;
 
     if (is_null(_this->ops) || is_null(_this->ops->__lt_value)) {
         while (!is_null(n)) {
@@ -266,6 +477,20 @@ static set_node_t* __set_lower_bound(const set_t* _this, set_value_t value)
                 return t;
             }
         }
+    } else if (!is_null(_this->ops->__cmp_value)) {
+        while (!is_null(n)) {
+            t = set_entry(n);
+            cmp = _this->ops->__cmp_value(value, t->value);
+
+            if (cmp < 0) {
+                n = n->rb_left;
+                ret = t;
+            } else if (cmp > 0) {
+                n = n->rb_right;
+            } else {
+                return t;
+            }
+        }
     } else {
         while (!is_null(n)) {
             t = set_entry(n);
@@ -294,7 +519,7 @@ static /* __always_inline */ inline set_node_t* set_lower_bound(const set_t* _th
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
         return NULL;
 
-    t = __set_lower_bound(_this, value);
+    t = __set_small(_this) ? __set_small_at(_this, __set_small_bound(_this, value, false)) : __set_lower_bound(_this, value);
     return is_null(t) ? __set_end(_this) : t;
 }
 
@@ -303,6 +528,7 @@ static set_node_t* __set_upper_bound(const set_t* _this, set_value_t value)
     struct rb_node* n = _this->root.rb_node;
     set_node_t* t = NULL;
     set_node_t* ret = NULL;
+    int cmp = 0;
 
     if (is_null(_this->ops) || is_null(_this->ops->__lt_value)) {
         while (!is_null(n)) {
@@ -314,7 +540,22 @@ static set_node_t* __set_upper_bound(const set_t* _this, set_value_t value)
             } else if (value > t->value) {
                 n = n->rb_right;
             } else {
-                n = rb_next(n);
+                n = __set_succ(_this, n);
+                return is_null(n) ? NULL : set_entry(n);
+            }
+        }
+    } else if (!is_null(_this->ops->__cmp_value)) {
+        while (!is_null(n)) {
+            t = set_entry(n);
+            cmp = _this->ops->__cmp_value(value, t->value);
+
+            if (cmp < 0) {
+                n = n->rb_left;
+                ret = t;
+            } else if (cmp > 0) {
+                n = n->rb_right;
+            } else {
+                n = __set_succ(_this, n);
                 return is_null(n) ? NULL : set_entry(n);
             }
         }
@@ -328,7 +569,7 @@ static set_node_t* __set_upper_bound(const set_t* _this, set_value_t value)
             } else if (_this->ops->__lt_value(t->value, value)) {
                 n = n->rb_right;
             } else {
-                n = rb_next(n);
+                n = __set_succ(_this, n);
                 return is_null(n) ? NULL : set_entry(n);
             }
         }
@@ -347,15 +588,38 @@ static /* __always_inline */ inline set_node_t* set_upper_bound(const set_t* _th
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
         return NULL;
 
-    t = __set_upper_bound(_this, value);
+    t = __set_small(_this) ? __set_small_at(_this, __set_small_bound(_this, value, true)) : __set_upper_bound(_this, value);
     return is_null(t) ? __set_end(_this) : t;
 }
 
+/* `rightmost` moves to a node linked as its right child */
+static /* __always_inline */ inline set_node_t* __set_link(set_t* _this, set_node_t* node, struct rb_node* parent, struct rb_node** link)
+{
+    if (is_null(parent) || (parent == _this->rightmost && link == &parent->rb_right))
+        _this->rightmost = &node->node;
+
+    rb_link_node(&node->node, parent, link);
+    if (set_thread(_this))
+        ds_thread_link(&node->node, parent, link, __set_thread_off(_this), &_this->leftmost);
+
+    if (set_os(_this))
+        rb_insert_augmented(&node->node, &_this->root, &rb_size_augment);
+    else
+        rb_insert_color(&node->node, &_this->root);
+    _this->size++;
+    return node;
+}
+
 static set_node_t* __set_insert(set_t* _this, set_node_t* node)
 {
     struct rb_node** n = &_this->root.rb_node;
     struct rb_node* parent = NULL;
     set_node_t* t = NULL;
+    int cmp = 0;
+
+    /* Increasing values are appended without a descent */
+    if (!is_null(_this->rightmost) && __set_lt(_this, set_entry(_this->rightmost)->value, node->value))
+        return __set_link(_this, node, _this->rightmost, &_this->rightmost->rb_right);
 
     if (is_null(_this->ops) || is_null(_this->ops->__lt_value)) {
         while (!is_null(*n)) {
@@ -369,6 +633,19 @@ static set_node_t* __set_insert(set_t* _this, set_node_t* node)
             else
                 return t;
         }
+    } else if (!is_null(_this->ops->__cmp_value)) {
+        while (!is_null(*n)) {
+            parent = *n;
+            t = set_entry(parent);
+            cmp = _this->ops->__cmp_value(node->value, t->value);
+
+            if (cmp < 0)
+                n = &parent->rb_left;
+            else if (cmp > 0)
+                n = &parent->rb_right;
+            else
+                return t;
+        }
     } else {
         while (!is_null(*n)) {
             parent = *n;
@@ -383,10 +660,7 @@ static set_node_t* __set_insert(set_t* _this, set_node_t* node)
         }
     }
 
-    rb_link_node(&node->node, parent, n);
-    rb_insert_color(&node->node, &_this->root);
-    _this->size++;
-    return node;
+    return __set_link(_this, node, parent, n);
 }
 
 static inline set_node_t* set_insert(set_t* _this, set_value_t value)
@@ -400,7 +674,13 @@ static inline set_node_t* set_insert(set_t* _this, set_value_t value)
     if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
         return NULL;
 
-    t = (set_node_t*)p_calloc(1, sizeof(set_node_t));
+    if (__set_small_on(_this)) {
+        t = __set_small_insert(_this, value, true);
+        if (__set_small_on(_this))
+            return t;
+    }
+
+    t = (set_node_t*)p_calloc(1, __set_node_bytes(_this));
     if (unlikely(is_null(t)))
         return NULL;
 
@@ -424,9 +704,93 @@ err:
     return NULL;
 }
 
+/* Links `node` next to `hint` if it belongs there, else NULL. Return `hint` if equal */
+static set_node_t* __set_insert_hint(set_t* _this, set_node_t* node, set_node_t* hint)
+{
+    struct rb_node* h = &hint->node;
+    struct rb_node* n = NULL;
+
+    if (__set_lt(_this, node->value, hint->value)) {
+        n = __set_pred(_this, h);
+        if (!is_null(n) && !__set_lt(_this, set_entry(n)->value, node->value))
+            return NULL;
+        return is_null(h->rb_left) ? __set_link(_this, node, h, &h->rb_left) : __set_link(_this, node, n, &n->rb_right);
+    }
+
+    if (__set_lt(_this, hint->value, node->value)) {
+        n = __set_succ(_this, h);
+        if (!is_null(n) && !__set_lt(_this, node->value, set_entry(n)->value))
+            return NULL;
+        return is_null(h->rb_right) ? __set_link(_this, node, h, &h->rb_right) : __set_link(_this, node, n, &n->rb_left);
+    }
+
+    return hint;
+}
+
+/* `end`, or a `hint` out of place, falls back to `__set_insert`, which still appends in O(1) */
+static set_node_t* set_insert_hint(set_t* _this, set_node_t* hint, set_value_t value)
+{
+    set_node_t* t = NULL;
+    set_node_t* ret = NULL;
+
+    if (unlikely(is_null(_this) || is_null(hint)))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
+        return NULL;
+
+    if (__set_small_on(_this)) {
+        t = __set_small_insert(_this, value, true);
+        if (__set_small_on(_this))
+            return t;
+        hint = __set_end(_this); /* The values just moved into the tree */
+    }
+
+    t = (set_node_t*)p_calloc(1, __set_node_bytes(_this));
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    if (!__set_node_fill(_this, t, value)) {
+        p_free(t);
+        return NULL;
+    }
+
+    if (__set_end(_this) != hint && __set_rend(_this) != hint)
+        ret = __set_insert_hint(_this, t, hint);
+
+    if (is_null(ret))
+        ret = __set_insert(_this, t);
+
+    if (t != ret)
+        goto err;
+    return t;
+
+err:
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&t->value);
+
+    p_free(t);
+    return NULL;
+}
+
+static /* __always_inline */ inline void __set_node_free(set_t* _this, set_node_t* node)
+{
+    if (is_null(_this->blocks) || !ds_block_put(&_this->blocks, node))
+        p_free(node);
+}
+
 static /* __always_inline */ inline set_node_t* __set_erase(set_t* _this, set_node_t* pos)
 {
-    rb_erase(&pos->node, &_this->root);
+    if (&pos->node == _this->rightmost)
+        _this->rightmost = __set_pred(_this, &pos->node);
+
+    if (set_thread(_this))
+        ds_thread_unlink(&pos->node, __set_thread_off(_this), &_this->leftmost);
+
+    if (set_os(_this))
+        rb_erase_augmented(&pos->node, &_this->root, &rb_size_augment);
+    else
+        rb_erase(&pos->node, &_this->root);
     _this->size--;
     return pos;
 }
@@ -443,6 +807,9 @@ static inline set_node_t* set_erase(set_t* _this, set_node_t* pos)
     if (__set_size(_this) <= 0 || __set_end(_this) == pos/* || __set_rend(_this) == pos*/)
         return NULL;
 
+    if (__set_small(_this))
+        return __set_small_erase(_this, pos);
+
     t = __set_next(_this, pos);
     if (is_null(t))
         return NULL;
@@ -452,9 +819,9 @@ static inline set_node_t* set_erase(set_t* _this, set_node_t* pos)
     if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
         _this->ops->free_value(&pos->value);
 
-    p_free(pos);
+    __set_node_free(_this, pos);
 
-    return t;
+    return __set_small_settle_at(_this, SET_SMALL / 2, t);
 }
 
 static inline set_size_t set_remove(set_t* _this, set_value_t value)
@@ -471,13 +838,19 @@ static inline set_size_t set_remove(set_t* _this, set_value_t value)
     if (__set_end(_this) == t)
         return 0;
 
+    if (__set_small(_this)) {
+        __set_small_erase(_this, t);
+        return 1;
+    }
+
     __set_erase(_this, t);
 
     if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
         _this->ops->free_value(&t->value);
 
-    p_free(t);
+    __set_node_free(_this, t);
 
+    __set_small_settle(_this, SET_SMALL / 2);
     return 1;
 }
 
@@ -502,25 +875,815 @@ static set_size_t set_remove_if(set_t* _this, remove_if_condition_v cond)
     return ret;
 }
 
+/* Postorder, so nodes are freed without `rb_erase` keeping the tree balanced all along */
 static set_size_t set_clear(set_t* _this)
 {
     set_size_t ret = 0;
     set_node_t* t = NULL;
+    struct rb_node* n = NULL;
+    struct rb_node* next = NULL;
 
     if (unlikely(is_null(_this)))
         return -1;
 
-    for (t = __set_begin(_this); __set_end(_this) != t; ) {
-        t = set_erase(_this, t);
+    if (__set_small(_this))
+        return __set_small_clear(_this);
+
+    for (n = rb_first_postorder(&_this->root); !is_null(n); n = next) {
+        next = rb_next_postorder(n);
+        t = set_entry(n);
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+            _this->ops->free_value(&t->value);
+
+        __set_node_free(_this, t);
         ret++;
     }
 
+    _this->root = RB_ROOT;
+    _this->rightmost = NULL;
+    _this->leftmost = NULL;
+    _this->size = 0;
+    return ret;
+}
+
+static /* __always_inline */ inline bool __set_lt(const set_t* _this, set_value_t left, set_value_t right)
+{
+    return is_null(_this->ops) || is_null(_this->ops->__lt_value) ? left < right : _this->ops->__lt_value(left, right);
+}
+
+/* Count of values < `value`, or <= `value` if `le` */
+static set_size_t __set_rank(const set_t* _this, set_value_t value, bool le)
+{
+    struct rb_node* n = _this->root.rb_node;
+    set_node_t* t = NULL;
+    set_size_t ret = 0;
+
+    if (__set_small(_this))
+        return __set_small_bound(_this, value, le);
+
+    if (!set_os(_this)) {
+        for (t = __set_begin(_this); __set_end(_this) != t; t = __set_next(_this, t), ret++) {
+            if (le ? __set_lt(_this, value, t->value) : !__set_lt(_this, t->value, value))
+                break;
+        }
+        return ret;
+    }
+
+    while (!is_null(n)) {
+        t = set_entry(n);
+
+        if (le ? __set_lt(_this, value, t->value) : !__set_lt(_this, t->value, value)) {
+            n = n->rb_left;
+        } else {
+            ret += rb_size_of(n->rb_left) + 1;
+            n = n->rb_right;
+        }
+    }
+    return ret;
+}
+
+static set_size_t set_rank(const set_t* _this, set_value_t value)
+{
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
+        return -1;
+
+    return __set_rank(_this, value, false);
+}
+
+static set_node_t* set_select(const set_t* _this, set_size_t k)
+{
+    struct rb_node* n = NULL;
+    set_node_t* t = NULL;
+
+    if (unlikely(is_null(_this)))
+        return NULL;
+
+    if (k < 0 || k >= __set_size(_this))
+        return __set_end(_this);
+
+    if (__set_small(_this))
+        return __set_small_at(_this, k);
+
+    if (set_os(_this)) {
+        n = rb_select(&_this->root, k);
+        return is_null(n) ? NULL : set_entry(n);
+    }
+
+    for (t = __set_begin(_this); k > 0; --k)
+        t = __set_next(_this, t);
+    return t;
+}
+
+static set_size_t set_count_range(const set_t* _this, set_value_t lo, set_value_t hi)
+{
+    set_size_t ret = 0;
+    set_node_t* t = NULL;
+
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && (!_this->ops->valid_value(lo) || !_this->ops->valid_value(hi)))
+        return -1;
+
+    if (!__set_lt(_this, lo, hi))
+        return 0;
+
+    if (set_os(_this) || __set_small(_this))
+        return __set_rank(_this, hi, false) - __set_rank(_this, lo, false);
+
+    t = __set_lower_bound(_this, lo);
+    for (; !is_null(t) && __set_end(_this) != t && __set_lt(_this, t->value, hi); t = __set_next(_this, t))
+        ret++;
     return ret;
 }
 
+static set_node_t* set_equal_range(const set_t* _this, set_value_t value, set_node_t** last)
+{
+    set_node_t* t = NULL;
+    struct rb_node* n = NULL;
+
+    if (unlikely(is_null(_this) || is_null(last)))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
+        return NULL;
+
+    if (__set_small(_this)) {
+        *last = __set_small_at(_this, __set_small_bound(_this, value, true));
+        *last = is_null(*last) ? __set_end(_this) : *last;
+        t = __set_small_at(_this, __set_small_bound(_this, value, false));
+        return is_null(t) ? __set_end(_this) : t;
+    }
+
+    t = __set_lower_bound(_this, value);
+    if (is_null(t)) {
+        *last = __set_end(_this);
+        return __set_end(_this);
+    }
+
+    n = __set_lt(_this, value, t->value) ? &t->node : __set_succ(_this, &t->node);
+    *last = is_null(n) ? __set_end(_this) : set_entry(n);
+    return t;
+}
+
+/* One descent to `lo`, then the nodes before `hi` are unlinked in order, chained through
+   `rb_right`, and freed together. A range covering every node is a `clear` */
+static set_size_t set_erase_range(set_t* _this, set_value_t lo, set_value_t hi)
+{
+    set_node_t* t = NULL;
+    struct rb_node* n = NULL;
+    struct rb_node* next = NULL;
+    struct rb_node* head = NULL;
+    set_size_t ret = 0;
+
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && (!_this->ops->valid_value(lo) || !_this->ops->valid_value(hi)))
+        return -1;
+
+    if (!__set_lt(_this, lo, hi))
+        return 0;
+
+    if (__set_small(_this))
+        return __set_small_erase_range(_this, lo, hi);
+
+    t = __set_lower_bound(_this, lo);
+    if (is_null(t))
+        return 0;
+
+    if (t == __set_first(_this) && __set_lt(_this, set_entry(_this->rightmost)->value, hi))
+        return set_clear(_this);
+
+    for (n = &t->node; !is_null(n) && __set_lt(_this, set_entry(n)->value, hi); n = next) {
+        next = __set_succ(_this, n);
+        __set_erase(_this, set_entry(n));
+        n->rb_right = head;
+        head = n;
+        ret++;
+    }
+
+    for (n = head; !is_null(n); n = next) {
+        next = n->rb_right;
+        t = set_entry(n);
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+            _this->ops->free_value(&t->value);
+
+        __set_node_free(_this, t);
+    }
+
+    __set_small_settle(_this, SET_SMALL / 2);
+    return ret;
+}
+
+static set_size_t set_for_each_range(const set_t* _this, set_value_t lo, set_value_t hi, for_each_v cb, void* arg)
+{
+    set_node_t* t = NULL;
+    struct rb_node* n = NULL;
+    set_size_t i = 0;
+    set_size_t ret = 0;
+
+    if (unlikely(is_null(_this) || is_null(cb)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && (!_this->ops->valid_value(lo) || !_this->ops->valid_value(hi)))
+        return -1;
+
+    if (!__set_lt(_this, lo, hi))
+        return 0;
+
+    if (__set_small(_this)) {
+        for (i = __set_small_bound(_this, lo, false); i < __set_size(_this) && __set_lt(_this, _this->small->values[i], hi); ++i) {
+            ret++;
+            if (!cb(__set_small_at(_this, i)->value, arg))
+                break;
+        }
+        return ret;
+    }
+
+    t = __set_lower_bound(_this, lo);
+    for (n = is_null(t) ? NULL : &t->node; !is_null(n) && __set_lt(_this, set_entry(n)->value, hi); n = __set_succ(_this, n)) {
+        ret++;
+        if (!cb(set_entry(n)->value, arg))
+            break;
+    }
+    return ret;
+}
+
+/* Count of `l` after a split of `total` values, `l` and `r` are walked in step so only the smaller one is walked through */
+static set_size_t __set_split_size(const set_t* _this, const struct rb_root* l, const struct rb_root* r, set_size_t total)
+{
+    struct rb_node* a = NULL;
+    struct rb_node* b = NULL;
+    set_size_t na = 0, nb = 0;
+
+    if (set_os(_this))
+        return (set_size_t)rb_size_of(l->rb_node);
+
+    a = rb_first(l);
+    b = rb_first(r);
+    for (; !is_null(a) && !is_null(b); a = __set_succ(_this, a), b = __set_succ(_this, b)) {
+        na++;
+        nb++;
+    }
+    return is_null(a) ? na : total - nb;
+}
+
+/* The blocks follow their nodes: those of the smaller half are marked, a block with nodes on
+   both sides is shared by the halves */
+static void __set_split_blocks(const set_t* _this, ds_block_t* blocks, ds_block_t* spare, set_t* left, set_t* right)
+{
+    bool lesser = __set_size(left) <= __set_size(right);
+    set_t* t = lesser ? left : right;
+    ds_block_t* moved = NULL;
+    struct rb_node* n = NULL;
+
+    if (is_null(blocks))
+        return;
+
+    for (n = rb_first(&t->root); !is_null(n); n = __set_succ(_this, n))
+        ds_block_mark(blocks, set_entry(n));
+
+    ds_block_split(&blocks, &moved, spare);
+    ds_block_splice(&left->blocks, lesser ? &moved : &blocks);
+    ds_block_splice(&right->blocks, lesser ? &blocks : &moved);
+}
+
+/* The nodes move as they are, so `t` must be empty with the same ops and config, or `_this` itself */
+static /* __always_inline */ inline bool __set_split_into(const set_t* _this, const set_t* t)
+{
+    return t == _this || (0 == __set_size(t) && t->ops == _this->ops && t->config.d == _this->config.d);
+}
+
+static set_size_t set_split(set_t* _this, set_value_t value, set_t* left, set_t* right)
+{
+    struct rb_root l = RB_ROOT;
+    struct rb_root r = RB_ROOT;
+    struct rb_node* rightmost = NULL;
+    struct rb_node* leftmost = NULL;
+    struct rb_node* n = NULL;
+    set_node_t* t = NULL;
+    set_size_t total = 0;
+    ds_block_t* blocks = NULL;
+    ds_block_t* spare = NULL;
+
+    if (unlikely(is_null(_this) || is_null(left) || is_null(right) || left == right))
+        return -1;
+
+    if (!__set_split_into(_this, left) || !__set_split_into(_this, right))
+        return -1;
+
+    /* The array goes to the tree to be split, the halves settle after */
+    if (!__set_small_off(left) || !__set_small_off(right) || !__set_small_off(_this))
+        return -1;
+
+    if (!ds_block_spare(_this->blocks, &spare))
+        return -1;
+
+    t = __set_lower_bound(_this, value);
+    n = is_null(t) ? NULL : &t->node;
+
+    l = _this->root;
+    total = __set_size(_this);
+    rightmost = _this->rightmost;
+    leftmost = _this->leftmost;
+    if (!is_null(n))
+        rb_split(&l, n, &r, set_os(_this) ? &rb_size_augment : NULL);
+
+    /* The thread is cut before `n` */
+    if (set_thread(_this) && !is_null(n)) {
+        leftmost = leftmost == n ? NULL : leftmost;
+        ds_thread_splice(ds_thread_of(n, __set_thread_off(_this))->prev, NULL, __set_thread_off(_this));
+        ds_thread_splice(NULL, n, __set_thread_off(_this));
+    }
+
+    blocks = _this->blocks;
+    _this->root = RB_ROOT;
+    _this->rightmost = NULL;
+    _this->leftmost = NULL;
+    _this->blocks = NULL;
+    _this->size = 0;
+
+    left->root = l;
+    left->size = __set_split_size(_this, &l, &r, total);
+    left->rightmost = (is_null(r.rb_node) ? rightmost : rb_last(&l));
+    left->leftmost = leftmost;
+    right->root = r;
+    right->size = total - left->size;
+    right->rightmost = is_null(r.rb_node) ? NULL : rightmost;
+    right->leftmost = set_thread(_this) ? n : NULL;
+
+    __set_split_blocks(_this, blocks, spare, left, right);
+
+    __set_small_settle(left, SET_SMALL);
+    __set_small_settle(right, SET_SMALL);
+    return __set_size(left);
+}
+
+static set_size_t set_join(set_t* _this, set_t* other)
+{
+    set_node_t* last = NULL;
+    set_node_t* first = NULL;
+
+    if (unlikely(is_null(_this) || is_null(other) || _this == other))
+        return -1;
+
+    if (other->ops != _this->ops || other->config.d != _this->config.d)
+        return -1;
+
+    if (0 == __set_size(other))
+        return __set_size(_this);
+
+    last = __set_rbegin(_this);
+    first = __set_begin(other);
+    if (__set_size(_this) > 0 && !__set_lt(_this, last->value, first->value))
+        return -1;
+
+    if (!__set_small_off(_this) || !__set_small_off(other))
+        return -1;
+
+    if (set_thread(_this)) {
+        ds_thread_splice(_this->rightmost, other->leftmost, __set_thread_off(_this));
+        _this->leftmost = is_null(_this->leftmost) ? other->leftmost : _this->leftmost;
+        other->leftmost = NULL;
+    }
+
+    rb_concat(&_this->root, &other->root, set_os(_this) ? &rb_size_augment : NULL);
+    ds_block_splice(&_this->blocks, &other->blocks);
+    _this->rightmost = other->rightmost;
+    _this->size += other->size;
+
+    other->rightmost = NULL;
+    other->size = 0;
+
+    __set_small_settle(_this, SET_SMALL);
+    return __set_size(_this);
+}
+
+/* The value and the node memory go to `handle`, unless the node is in a block or the value in the array */
+static set_node_t* set_extract(set_t* _this, set_node_t* pos, ds_node_handle_t* handle)
+{
+    set_node_t* t = NULL;
+    set_size_t i = 0;
+
+    if (unlikely(is_null(_this) || is_null(pos) || is_null(handle) || handle->full))
+        return NULL;
+
+    if (__set_size(_this) <= 0 || __set_end(_this) == pos)
+        return NULL;
+
+    if (__set_small(_this)) {
+        i = __set_small_index(_this, pos);
+        if (i < 0)
+            return NULL;
+
+        handle->key = pos->value;
+        handle->value = 0;
+        handle->full = true;
+
+        __set_small_close(_this, i);
+        return i < __set_size(_this) ? __set_small_at(_this, i) : __set_end(_this);
+    }
+
+    t = __set_next(_this, pos);
+    if (is_null(t))
+        return NULL;
+
+    __set_erase(_this, pos);
+
+    handle->key = pos->value;
+    handle->value = 0;
+    handle->full = true;
+
+    if (is_null(_this->blocks) || !ds_block_put(&_this->blocks, pos))
+        ds_node_handle_put(handle, pos, __set_node_bytes(_this));
+
+    return __set_small_settle_at(_this, SET_SMALL / 2, t);
+}
+
+/* On failure `handle` is left as it was */
+static set_node_t* set_insert_node(set_t* _this, ds_node_handle_t* handle)
+{
+    set_node_t* t = NULL;
+
+    if (unlikely(is_null(_this) || is_null(handle) || !handle->full))
+        return NULL;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(handle->key))
+        return NULL;
+
+    if (__set_small_on(_this)) {
+        t = __set_small_insert(_this, handle->key, false);
+        if (!is_null(t))
+            ds_node_handle_release(handle);
+        if (__set_small_on(_this))
+            return t;
+    }
+
+    t = (set_node_t*)ds_node_handle_take(handle, __set_node_bytes(_this));
+    if (unlikely(is_null(t)))
+        return NULL;
+
+    t->value = handle->key;
+
+    if (t != __set_insert(_this, t)) {
+        ds_node_handle_put(handle, t, __set_node_bytes(_this));
+        return NULL;
+    }
+
+    handle->full = false;
+    return t;
+}
+
+static void set_free_node(set_t* _this, ds_node_handle_t* handle)
+{
+    if (unlikely(is_null(_this) || is_null(handle)))
+        return;
+
+    if (handle->full && !is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&handle->key);
+
+    ds_node_handle_release(handle);
+}
+
+static bool __set_lt_default(set_value_t left, set_value_t right)
+{
+    return left < right;
+}
+
+static bool __set_node_fill(set_t* _this, set_node_t* t, set_value_t value)
+{
+    if (is_null(_this->ops) || is_null(_this->ops->copy_value)) {
+        t->value = value;
+    } else {
+        if (!_this->ops->copy_value(value, &t->value))
+            return false;
+    }
+
+    return true;
+}
+
+/* The nodes are chained in order through `rb_right`, then linked into a balanced tree at once */
+static set_size_t set_build_sorted(set_t* _this, const set_value_t* values, set_size_t n, bool contiguous)
+{
+    __comp lt = NULL;
+    ds_data_t* v = NULL;        /* The values sorted, if the input isn't */
+    set_node_t* nodes = NULL;
+    set_node_t* t = NULL;
+    struct rb_node* head = NULL;
+    struct rb_node** tail = &head;
+    set_size_t i, m = 0;
+
+    if (unlikely(is_null(_this) || n < 0 || (n > 0 && is_null(values))))
+        return -1;
+
+    if (__set_size(_this) > 0)
+        return -1;
+
+    __set_small_off(_this);
+
+    for (i = 0; i < n; ++i) {
+        if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(values[i]))
+            return -1;
+    }
+
+    lt = is_null(_this->ops) || is_null(_this->ops->__lt_value) ? __set_lt_default : _this->ops->__lt_value;
+
+    for (i = 1; i < n && !lt(values[i], values[i - 1]); ++i)
+        ;
+
+    if (i < n) {
+        v = (ds_data_t*)p_malloc(n * sizeof(ds_data_t));
+        if (unlikely(is_null(v)))
+            return -1;
+
+        for (i = 0; i < n; ++i)
+            v[i] = values[i];
+
+        if (!__sort_merge_n(v, n, 1, lt)) {
+            p_free(v);
+            return -1;
+        }
+
+        values = v;
+    }
+
+    for (i = 0; i < n; ++i)
+        m += 0 == i || lt(values[i - 1], values[i]);
+
+    if (contiguous && m > 0) {
+        nodes = (set_node_t*)ds_block_alloc(&_this->blocks, m, __set_node_bytes(_this));
+        if (unlikely(is_null(nodes)))
+            goto err;
+    }
+
+    for (i = 0, m = 0; i < n; ++i) {
+        if (i > 0 && !lt(values[i - 1], values[i]))
+            continue;
+
+        t = contiguous ? (set_node_t*)((char*)nodes + m * __set_node_bytes(_this)) : (set_node_t*)p_calloc(1, __set_node_bytes(_this));
+        if (unlikely(is_null(t)))
+            goto err;
+
+        if (!__set_node_fill(_this, t, values[i])) {
+            if (!contiguous)
+                p_free(t);
+            goto err;
+        }
+
+        *tail = &t->node;
+        tail = &t->node.rb_right;
+        m++;
+    }
+
+    if (set_thread(_this))
+        ds_thread_chain(head, m, __set_thread_off(_this), &_this->leftmost);
+
+    rb_build_sorted(&_this->root, head, m);
+    _this->rightmost = rb_last(&_this->root);
+    if (set_os(_this))
+        rb_size_build(&_this->root);
+    _this->size = m;
+    p_free(v);
+
+    __set_small_settle(_this, SET_SMALL);
+    return m;
+
+err:
+    while (!is_null(head)) {
+        t = set_entry(head);
+        head = head->rb_right;
+
+        if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+            _this->ops->free_value(&t->value);
+
+        if (!contiguous)
+            p_free(t);
+    }
+
+    if (!is_null(nodes))
+        ds_block_free(&_this->blocks, nodes);
+    p_free(v);
+    return -1;
+}
+
+/* Which values of a merged walk are kept: only in the first set, only in the second, in both */
+#define SET_KEEP_FIRST  (1)
+#define SET_KEEP_SECOND (2)
+#define SET_KEEP_BOTH   (4)
+
+static /* __always_inline */ inline int __set_cmp(const set_t* _this, set_value_t left, set_value_t right)
+{
+    if (!is_null(_this->ops) && !is_null(_this->ops->__lt_value) && !is_null(_this->ops->__cmp_value))
+        return _this->ops->__cmp_value(left, right);
+    return __set_lt(_this, left, right) ? -1 : (__set_lt(_this, right, left) ? 1 : 0);
+}
+
+/* One merged walk of `a` and `b` into an array, then `build_sorted` links it in O(n) */
+static set_size_t __set_merge(set_t* _this, const set_t* a, const set_t* b, uint32_t keep)
+{
+    set_size_t ret, n = 0;
+    ds_data_t* v = NULL;
+    set_node_t* x = __set_begin(a);
+    set_node_t* y = __set_begin(b);
+    int cmp = 0;
+
+    if (unlikely(_this == a || _this == b))
+        return -1;
+
+    if (__set_size(a) + __set_size(b) > 0) {
+        v = (ds_data_t*)p_malloc((__set_size(a) + __set_size(b)) * sizeof(ds_data_t));
+        if (unlikely(is_null(v)))
+            return -1;
+    }
+
+    while (__set_end(a) != x && __set_end(b) != y) {
+        cmp = __set_cmp(a, x->value, y->value);
+
+        if (cmp < 0) {
+            if (keep & SET_KEEP_FIRST)
+                v[n++] = x->value;
+            x = __set_next(a, x);
+        } else if (cmp > 0) {
+            if (keep & SET_KEEP_SECOND)
+                v[n++] = y->value;
+            y = __set_next(b, y);
+        } else {
+            if (keep & SET_KEEP_BOTH)
+                v[n++] = x->value;
+            x = __set_next(a, x);
+            y = __set_next(b, y);
+        }
+    }
+
+    for (; __set_end(a) != x && (keep & SET_KEEP_FIRST); x = __set_next(a, x))
+        v[n++] = x->value;
+
+    for (; __set_end(b) != y && (keep & SET_KEEP_SECOND); y = __set_next(b, y))
+        v[n++] = y->value;
+
+    ret = set_build_sorted(_this, v, n, false);
+    p_free(v);
+    return ret;
+}
+
+static set_size_t set_union(set_t* _this, const set_t* a, const set_t* b)
+{
+    if (unlikely(is_null(_this) || is_null(a) || is_null(b)))
+        return -1;
+    return __set_merge(_this, a, b, SET_KEEP_FIRST | SET_KEEP_SECOND | SET_KEEP_BOTH);
+}
+
+static set_size_t set_intersection(set_t* _this, const set_t* a, const set_t* b)
+{
+    if (unlikely(is_null(_this) || is_null(a) || is_null(b)))
+        return -1;
+    return __set_merge(_this, a, b, SET_KEEP_BOTH);
+}
+
+static set_size_t set_difference(set_t* _this, const set_t* a, const set_t* b)
+{
+    if (unlikely(is_null(_this) || is_null(a) || is_null(b)))
+        return -1;
+    return __set_merge(_this, a, b, SET_KEEP_FIRST);
+}
+
+static set_size_t set_symmetric_difference(set_t* _this, const set_t* a, const set_t* b)
+{
+    if (unlikely(is_null(_this) || is_null(a) || is_null(b)))
+        return -1;
+    return __set_merge(_this, a, b, SET_KEEP_FIRST | SET_KEEP_SECOND);
+}
+
+/* Return the node after `n` */
+static struct rb_node* __set_drop(set_t* _this, struct rb_node* n)
+{
+    struct rb_node* next = __set_succ(_this, n);
+    set_node_t* t = set_entry(n);
+
+    __set_erase(_this, t);
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&t->value);
+
+    __set_node_free(_this, t);
+    return next;
+}
+
+/* A copy of `value` right before `pos`, or appended if `pos` is NULL, without a compare */
+static bool __set_link_before(set_t* _this, set_value_t value, struct rb_node* pos)
+{
+    struct rb_node* n = NULL;
+    set_node_t* t = (set_node_t*)p_calloc(1, __set_node_bytes(_this));
+
+    if (unlikely(is_null(t)))
+        return false;
+
+    if (!__set_node_fill(_this, t, value)) {
+        p_free(t);
+        return false;
+    }
+
+    if (is_null(pos)) {
+        n = _this->rightmost;
+        __set_link(_this, t, n, is_null(n) ? &_this->root.rb_node : &n->rb_right);
+    } else if (is_null(pos->rb_left)) {
+        __set_link(_this, t, pos, &pos->rb_left);
+    } else {
+        n = __set_pred(_this, pos);
+        __set_link(_this, t, n, &n->rb_right);
+    }
+    return true;
+}
+
+/* One merged walk of `_this` and `other`, erasing from `_this` and linking copies from `other` in place.
+   An array of `_this` goes to the tree for the walk and settles after */
+static set_size_t __set_merge_with(set_t* _this, const set_t* other, uint32_t keep)
+{
+    struct rb_node* x = NULL;
+    set_node_t* y = __set_begin(other);
+    set_size_t ret = -1;
+    int cmp = 0;
+
+    if (_this == other) {
+        if (!(keep & SET_KEEP_BOTH))
+            set_clear(_this);
+        return __set_size(_this);
+    }
+
+    if (!__set_small_off(_this))
+        return -1;
+
+    x = rb_first(&_this->root);
+    while (!is_null(x) && __set_end(other) != y) {
+        cmp = __set_cmp(_this, set_entry(x)->value, y->value);
+
+        if (cmp < 0) {
+            x = (keep & SET_KEEP_FIRST) ? __set_succ(_this, x) : __set_drop(_this, x);
+        } else if (cmp > 0) {
+            if ((keep & SET_KEEP_SECOND) && !__set_link_before(_this, y->value, x))
+                goto out;
+            y = __set_next(other, y);
+        } else {
+            x = (keep & SET_KEEP_BOTH) ? __set_succ(_this, x) : __set_drop(_this, x);
+            y = __set_next(other, y);
+        }
+    }
+
+    while (!is_null(x) && !(keep & SET_KEEP_FIRST))
+        x = __set_drop(_this, x);
+
+    for (; __set_end(other) != y && (keep & SET_KEEP_SECOND); y = __set_next(other, y)) {
+        if (!__set_link_before(_this, y->value, NULL))
+            goto out;
+    }
+    ret = __set_size(_this);
+
+out:
+    __set_small_settle(_this, SET_SMALL);
+    return ret;
+}
+
+static set_size_t set_union_with(set_t* _this, const set_t* other)
+{
+    if (unlikely(is_null(_this) || is_null(other)))
+        return -1;
+    return __set_merge_with(_this, other, SET_KEEP_FIRST | SET_KEEP_SECOND | SET_KEEP_BOTH);
+}
+
+static set_size_t set_intersect_with(set_t* _this, const set_t* other)
+{
+    if (unlikely(is_null(_this) || is_null(other)))
+        return -1;
+    return __set_merge_with(_this, other, SET_KEEP_BOTH);
+}
+
+static set_size_t set_difference_with(set_t* _this, const set_t* other)
+{
+    if (unlikely(is_null(_this) || is_null(other)))
+        return -1;
+    return __set_merge_with(_this, other, SET_KEEP_FIRST);
+}
+
+static set_size_t set_symmetric_difference_with(set_t* _this, const set_t* other)
+{
+    if (unlikely(is_null(_this) || is_null(other)))
+        return -1;
+    return __set_merge_with(_this, other, SET_KEEP_FIRST | SET_KEEP_SECOND);
+}
+
 /* __always_inline */ inline void __set_init(set_t* set)
 {
     set->root = RB_ROOT;
+    set->blocks = NULL;
+    set->rightmost = NULL;
+    set->leftmost = NULL;
+    set->small = NULL;
 }
 
 /* __always_inline */ inline void __set_deinit(set_t* set)
@@ -541,32 +1704,63 @@ typedef set_r_iterator_t* (*fp_rbegin)(const set_t* _this);
 typedef set_r_iterator_t* (*fp_rnext)(const set_t* _this, const set_r_iterator_t* r_iterator);
 typedef set_r_iterator_t* (*fp_rprev)(const set_t* _this, const set_r_iterator_t* r_iterator);
 typedef set_iterator_t* (*fp_find)(const set_t* _this, set_value_t value);
+typedef set_size_t (*fp_find_batch)(const set_t* _this, const set_value_t* values, set_size_t n, set_iterator_t** out);
+typedef set_size_t (*fp_find_sorted)(const set_t* _this, const set_value_t* values, set_size_t n, set_iterator_t** out);
 typedef set_iterator_t* (*fp_lower_bound)(const set_t* _this, set_value_t value);
 typedef set_iterator_t* (*fp_upper_bound)(const set_t* _this, set_value_t value);
 typedef set_iterator_t* (*fp_insert)(set_t* _this, set_value_t value);
 typedef set_iterator_t* (*fp_erase)(set_t* _this, set_iterator_t* iterator);
+typedef set_iterator_t* (*fp_insert_hint)(set_t* _this, set_iterator_t* hint, set_value_t value);
+typedef set_iterator_t* (*fp_equal_range)(const set_t* _this, set_value_t value, set_iterator_t** last);
+typedef set_iterator_t* (*fp_select)(const set_t* _this, set_size_t k);
+typedef set_iterator_t* (*fp_extract)(set_t* _this, set_iterator_t* iterator, ds_node_handle_t* handle);
+typedef set_iterator_t* (*fp_insert_node)(set_t* _this, ds_node_handle_t* handle);
 
 const class_set_t* class_set_ins(void)
 {
     static const class_set_t ins = {
-        .size        = _set_size,
-        .count       = set_count,
-        .end         = (fp_end)__set_end,
-        .begin       = (fp_begin)_set_begin,
-        .next        = (fp_next)_set_next,
-        .prev        = (fp_prev)_set_prev,
-        .rend        = (fp_rend)__set_rend,
-        .rbegin      = (fp_rbegin)_set_rbegin,
-        .rnext       = (fp_rnext)_set_rnext,
-        .rprev       = (fp_rprev)_set_rprev,
-        .find        = (fp_find)set_find,
-        .lower_bound = (fp_lower_bound)set_lower_bound,
-        .upper_bound = (fp_upper_bound)set_upper_bound,
-        .insert      = (fp_insert)set_insert,
-        .erase       = (fp_erase)set_erase,
-        .remove      = set_remove,
-        .remove_if   = set_remove_if,
-        .clear       = set_clear,
+        .size                      = _set_size,
+        .count                     = set_count,
+        .end                       = (fp_end)__set_end,
+        .begin                     = (fp_begin)_set_begin,
+        .next                      = (fp_next)_set_next,
+        .prev                      = (fp_prev)_set_prev,
+        .rend                      = (fp_rend)__set_rend,
+        .rbegin                    = (fp_rbegin)_set_rbegin,
+        .rnext                     = (fp_rnext)_set_rnext,
+        .rprev                     = (fp_rprev)_set_rprev,
+        .find                      = (fp_find)set_find,
+        .find_batch                = (fp_find_batch)set_find_batch,
+        .contains_sorted           = set_contains_sorted,
+        .find_sorted               = (fp_find_sorted)set_find_sorted,
+        .lower_bound               = (fp_lower_bound)set_lower_bound,
+        .upper_bound               = (fp_upper_bound)set_upper_bound,
+        .insert                    = (fp_insert)set_insert,
+        .erase                     = (fp_erase)set_erase,
+        .remove                    = set_remove,
+        .remove_if                 = set_remove_if,
+        .clear                     = set_clear,
+        .build_sorted              = set_build_sorted,
+        .rank                      = set_rank,
+        .select                    = (fp_select)set_select,
+        .count_range               = set_count_range,
+        .insert_hint               = (fp_insert_hint)set_insert_hint,
+        .equal_range               = (fp_equal_range)set_equal_range,
+        .erase_range               = set_erase_range,
+        .for_each_range            = set_for_each_range,
+        .split                     = set_split,
+        .join                      = set_join,
+        .set_union                 = set_union,
+        .set_intersection          = set_intersection,
+        .set_difference            = set_difference,
+        .set_symmetric_difference  = set_symmetric_difference,
+        .union_with                = set_union_with,
+        .intersect_with            = set_intersect_with,
+        .difference_with           = set_difference_with,
+        .symmetric_difference_with = set_symmetric_difference_with,
+        .extract                   = (fp_extract)set_extract,
+        .insert_node               = (fp_insert_node)set_insert_node,
+        .free_node                 = set_free_node,
     };
     return &ins;
 }
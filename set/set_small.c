@@ -0,0 +1,378 @@
+/*
+  Set Small-size Mode Implementations
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/* Included by set/set.c.
+   In the adaptive mode (`b_small`) a set of up to SET_SMALL values keeps them in one
+   `set_small_t` instead of nodes of a tree: each value in a slot, and the values in order in
+   one array, searched with a scan the compiler can turn into SIMD compares. A slot doesn't
+   move while the array lasts, so an iterator is the address of its slot and stays valid until
+   its own value is erased, as a node would. The value past SET_SMALL moves the values into
+   nodes of one block of `blocks`, linked into the tree, and erases leaving SET_SMALL / 2 move
+   them back, so a size going back and forth doesn't convert each time. Either move
+   invalidates the iterators taken before it, as a reallocation does */
+
+#include <set/set.h>
+
+#include <string.h>
+#include <_block.h>
+#include <_memory.h>
+#include <linux/rbtree.h>
+#include <linux/_compiler.h>
+#include <iterator/iterator.h>
+
+#define SET_SMALL_SLOTS ((1U << SET_SMALL) - 1)
+
+static /* __always_inline */ inline bool __set_small(const set_t* _this)
+{
+    return !is_null(_this->small);
+}
+
+/* The array takes the next insert: there's one, or the adaptive set is empty */
+static /* __always_inline */ inline bool __set_small_on(const set_t* _this)
+{
+    return __set_small(_this) || (_this->config.c.b_small && 0 == _this->size);
+}
+
+static /* __always_inline */ inline set_node_t* __set_small_at(const set_t* _this, set_size_t i)
+{
+    return i >= 0 && i < _this->size ? (set_node_t*)&_this->small->slots[_this->small->order[i]] : NULL;
+}
+
+/* Index of `node` in the array, -1 if it's not the slot of a value */
+static set_size_t __set_small_index(const set_t* _this, const set_node_t* node)
+{
+    const set_small_t* s = _this->small;
+    uintptr_t off = (uintptr_t)node - (uintptr_t)s->slots;
+    set_size_t i = 0;
+
+    if (off >= sizeof(s->slots) || 0 != off % sizeof(set_small_slot_t))
+        return -1;
+
+    for (i = 0; i < _this->size; ++i) {
+        if (s->order[i] == off / sizeof(set_small_slot_t))
+            return i;
+    }
+    return -1;
+}
+
+/* Count of values < `value`, or <= `value` if `upper` */
+static set_size_t __set_small_bound(const set_t* _this, set_value_t value, bool upper)
+{
+    const set_value_t* e = _this->small->values;
+    set_size_t n = _this->size;
+    set_size_t i = 0;
+    set_size_t ret = 0;
+
+    /* Without a branch per entry, which the compiler may turn into SIMD compares */
+    if (is_null(_this->ops) || is_null(_this->ops->__lt_value)) {
+        if (upper) {
+            for (i = 0; i < n; ++i)
+                ret += e[i] <= value;
+        } else {
+            for (i = 0; i < n; ++i)
+                ret += e[i] < value;
+        }
+        return ret;
+    }
+
+    if (upper) {
+        for (i = 0; i < n && !_this->ops->__lt_value(value, e[i]); ++i)
+            ;
+    } else {
+        for (i = 0; i < n && _this->ops->__lt_value(e[i], value); ++i)
+            ;
+    }
+    return i;
+}
+
+/* Return true if `value` is there at `*i`, else `*i` is where it goes */
+static /* __always_inline */ inline bool __set_small_slot(const set_t* _this, set_value_t value, set_size_t* i)
+{
+    *i = __set_small_bound(_this, value, false);
+    return *i < _this->size && !__set_lt(_this, value, _this->small->values[*i]);
+}
+
+static set_node_t* __set_small_find(const set_t* _this, set_value_t value)
+{
+    set_size_t i = 0;
+    return __set_small_slot(_this, value, &i) ? __set_small_at(_this, i) : NULL;
+}
+
+static /* __always_inline */ inline set_node_t* __set_small_begin(const set_t* _this)
+{
+    return _this->size > 0 ? __set_small_at(_this, 0) : __set_end(_this);
+}
+
+static /* __always_inline */ inline set_node_t* __set_small_rbegin(const set_t* _this)
+{
+    return _this->size > 0 ? __set_small_at(_this, _this->size - 1) : __set_rend(_this);
+}
+
+/* One step from `node`, forward or backward, toward `stop` which is `end` or `rend` */
+static set_node_t* __set_small_step(const set_t* _this, const set_node_t* node, bool forward, set_node_t* stop)
+{
+    set_size_t i = __set_small_index(_this, node);
+
+    if (i < 0)
+        return NULL;
+
+    i += forward ? 1 : -1;
+    return i >= 0 && i < _this->size ? __set_small_at(_this, i) : stop;
+}
+
+static set_node_t* __set_small_next(const set_t* _this, const set_node_t* node)
+{
+    if (__set_end(_this) == node)
+        return __set_end(_this);
+    return __set_small_step(_this, node, true, __set_end(_this));
+}
+
+static set_node_t* __set_small_prev(const set_t* _this, const set_node_t* node)
+{
+    if (__set_end(_this) == node)
+        return _this->size > 0 ? __set_small_at(_this, _this->size - 1) : __set_end(_this);
+    return __set_small_step(_this, node, false, __set_end(_this));
+}
+
+static set_node_t* __set_small_rnext(const set_t* _this, const set_node_t* node)
+{
+    if (__set_rend(_this) == node)
+        return __set_rend(_this);
+    return __set_small_step(_this, node, false, __set_rend(_this));
+}
+
+static set_node_t* __set_small_rprev(const set_t* _this, const set_node_t* node)
+{
+    if (__set_rend(_this) == node)
+        return _this->size > 0 ? __set_small_at(_this, 0) : __set_rend(_this);
+    return __set_small_step(_this, node, true, __set_rend(_this));
+}
+
+/* A free slot for the value at `i`, those after it move up. The value of the array is left to the caller */
+static /* __always_inline */ inline set_node_t* __set_small_open(set_t* _this, set_size_t i)
+{
+    set_small_t* s = _this->small;
+    uint32_t slot = __builtin_ctz(s->free);
+
+    memmove(s->values + i + 1, s->values + i, (_this->size - i) * sizeof(set_value_t));
+    memmove(s->order + i + 1, s->order + i, (_this->size - i) * sizeof(uint8_t));
+    s->order[i] = (uint8_t)slot;
+    s->free &= ~(1U << slot);
+    _this->size++;
+    return (set_node_t*)&s->slots[slot];
+}
+
+/* The value at `i` goes, its slot is left to the caller */
+static /* __always_inline */ inline void __set_small_close(set_t* _this, set_size_t i)
+{
+    set_small_t* s = _this->small;
+
+    s->free |= 1U << s->order[i];
+    memmove(s->values + i, s->values + i + 1, (_this->size - i - 1) * sizeof(set_value_t));
+    memmove(s->order + i, s->order + i + 1, (_this->size - i - 1) * sizeof(uint8_t));
+    _this->size--;
+}
+
+static /* __always_inline */ inline void __set_small_free_value(set_t* _this, set_node_t* t)
+{
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&t->value);
+}
+
+/* The values move into nodes of one block, linked into the tree in order. On failure the array stays */
+static bool __set_small_promote(set_t* _this)
+{
+    set_small_t* s = _this->small;
+    struct rb_node* head = NULL;
+    struct rb_node** tail = &head;
+    char* nodes = NULL;
+    set_node_t* t = NULL;
+    set_size_t i = 0;
+
+    nodes = (char*)ds_block_alloc(&_this->blocks, _this->size, __set_node_bytes(_this));
+    if (unlikely(is_null(nodes)))
+        return false;
+
+    for (i = 0; i < _this->size; ++i) {
+        t = (set_node_t*)(nodes + i * __set_node_bytes(_this));
+        t->value = s->slots[s->order[i]].value;
+        *tail = &t->node;
+        tail = &t->node.rb_right;
+    }
+    *tail = NULL;
+
+    if (set_thread(_this))
+        ds_thread_chain(head, _this->size, __set_thread_off(_this), &_this->leftmost);
+
+    rb_build_sorted(&_this->root, head, _this->size);
+    _this->rightmost = rb_last(&_this->root);
+    if (set_os(_this))
+        rb_size_build(&_this->root);
+
+    p_free(_this->small);
+    return true;
+}
+
+/* The values of the tree move to an array and their nodes are freed. On failure the tree stays */
+static void __set_small_demote(set_t* _this)
+{
+    set_small_t* s = NULL;
+    struct rb_node* n = NULL;
+    struct rb_node* next = NULL;
+    set_size_t i = 0;
+
+    s = (set_small_t*)p_malloc(sizeof(set_small_t));
+    if (unlikely(is_null(s)))
+        return;
+
+    for (n = rb_first(&_this->root); !is_null(n); n = rb_next(n), ++i) {
+        s->values[i] = set_entry(n)->value;
+        s->order[i] = (uint8_t)i;
+        s->slots[i].value = set_entry(n)->value;
+    }
+    s->free = SET_SMALL_SLOTS & ~((1U << i) - 1);
+
+    for (n = rb_first_postorder(&_this->root); !is_null(n); n = next) {
+        next = rb_next_postorder(n);
+        __set_node_free(_this, set_entry(n));
+    }
+
+    _this->root = RB_ROOT;
+    _this->rightmost = NULL;
+    _this->leftmost = NULL;
+    _this->small = s;
+}
+
+/* An adaptive set of `limit` values or fewer goes back to the array */
+static /* __always_inline */ inline void __set_small_settle(set_t* _this, set_size_t limit)
+{
+    if (_this->config.c.b_small && !__set_small(_this) && _this->size > 0 && _this->size <= limit)
+        __set_small_demote(_this);
+}
+
+/* As `__set_small_settle`, `t` of the tree, or `end`, is followed to where its value moved */
+static set_node_t* __set_small_settle_at(set_t* _this, set_size_t limit, set_node_t* t)
+{
+    set_value_t value = __set_end(_this) == t ? 0 : t->value;
+
+    __set_small_settle(_this, limit);
+    if (!__set_small(_this) || __set_end(_this) == t)
+        return t;
+    return __set_small_find(_this, value);
+}
+
+/* Before the tree is worked on directly: the array goes, its values into the tree. On failure the array stays */
+static /* __always_inline */ inline bool __set_small_off(set_t* _this)
+{
+    if (!__set_small(_this))
+        return true;
+
+    if (0 == _this->size) {
+        p_free(_this->small);
+        return true;
+    }
+    return __set_small_promote(_this);
+}
+
+static bool __set_small_new(set_t* _this)
+{
+    set_small_t* s = (set_small_t*)p_malloc(sizeof(set_small_t));
+
+    if (unlikely(is_null(s)))
+        return false;
+
+    s->free = SET_SMALL_SLOTS;
+    _this->small = s;
+    return true;
+}
+
+/* NULL if `value` is there or on failure. A full array goes to the tree, which then takes the
+   insert: `__set_small_on` tells the caller. `copy` is false for the value of a handle */
+static set_node_t* __set_small_insert(set_t* _this, set_value_t value, bool copy)
+{
+    set_node_t* t = NULL;
+    set_size_t i = 0;
+
+    if (!__set_small(_this) && !__set_small_new(_this))
+        return NULL;
+
+    if (__set_small_slot(_this, value, &i))
+        return NULL;
+
+    if (_this->size >= SET_SMALL) {
+        __set_small_promote(_this);
+        return NULL;
+    }
+
+    t = __set_small_open(_this, i);
+    if (!copy) {
+        t->value = value;
+    } else if (!__set_node_fill(_this, t, value)) {
+        __set_small_close(_this, i);
+        return NULL;
+    }
+
+    _this->small->values[i] = t->value;
+    return t;
+}
+
+/* Return the value after `pos` or `end` */
+static set_node_t* __set_small_erase(set_t* _this, set_node_t* pos)
+{
+    set_size_t i = __set_small_index(_this, pos);
+
+    if (i < 0)
+        return NULL;
+
+    __set_small_free_value(_this, pos);
+    __set_small_close(_this, i);
+    return i < _this->size ? __set_small_at(_this, i) : __set_end(_this);
+}
+
+static set_size_t __set_small_clear(set_t* _this)
+{
+    set_size_t ret = _this->size;
+    set_size_t i = 0;
+
+    for (i = 0; i < _this->size; ++i)
+        __set_small_free_value(_this, __set_small_at(_this, i));
+
+    p_free(_this->small);
+    _this->size = 0;
+    return ret;
+}
+
+/* Values in [ lo, hi ) */
+static set_size_t __set_small_erase_range(set_t* _this, set_value_t lo, set_value_t hi)
+{
+    set_small_t* s = _this->small;
+    set_size_t l = __set_small_bound(_this, lo, false);
+    set_size_t h = __set_small_bound(_this, hi, false);
+    set_size_t i = 0;
+
+    for (i = l; i < h; ++i) {
+        __set_small_free_value(_this, __set_small_at(_this, i));
+        s->free |= 1U << s->order[i];
+    }
+
+    memmove(s->values + l, s->values + h, (_this->size - h) * sizeof(set_value_t));
+    memmove(s->order + l, s->order + h, (_this->size - h) * sizeof(uint8_t));
+    _this->size -= h - l;
+    return h - l;
+}
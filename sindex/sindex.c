@@ -0,0 +1,385 @@
+/*
+  Static Search Index
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <sindex/sindex.h>
+
+#include <string.h>
+#include <_memory.h>
+#include <sort/sort.h>
+#include <linux/_compiler.h>
+#include <iterator/iterator.h>
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
+#define SINDEX_ALIGN (64)
+
+_Static_assert(SINDEX_BLOCK * sizeof(sindex_key_t) == SINDEX_ALIGN, "An S-tree block must fill a cache line");
+
+static __always_inline sindex_size_t __sindex_size(const sindex_t* _this)
+{
+    return _this->size;
+}
+
+static __always_inline sindex_size_t _sindex_size(const sindex_t* _this)
+{
+    if (unlikely(is_null(_this)))
+        return -1;
+    return __sindex_size(_this);
+}
+
+static bool __sindex_lt_default(ds_data_t left, ds_data_t right)
+{
+    return left < right;
+}
+
+static void* __sindex_alloc(sindex_size_t n)
+{
+    void* ret = NULL;
+
+    if (0 != posix_memalign(&ret, SINDEX_ALIGN, (n > 0 ? n : 1) * sizeof(ds_data_t)))
+        return NULL;
+    return ret;
+}
+
+/* In order over the implicit tree, the i-th entry of `kv` goes to the i-th node visited */
+static sindex_size_t __sindex_eytzinger_fill(sindex_t* _this, const ds_data_t* kv, uint32_t width, sindex_size_t i, sindex_size_t k)
+{
+    if (k <= _this->size) {
+        i = __sindex_eytzinger_fill(_this, kv, width, i, 2 * k);
+        _this->keys[k] = kv[i * width];
+        if (!is_null(_this->values))
+            _this->values[k] = kv[i * width + 1];
+        i = __sindex_eytzinger_fill(_this, kv, width, i + 1, 2 * k + 1);
+    }
+    return i;
+}
+
+/* Slots past the entries hold the greatest key, after the real one in order */
+static sindex_size_t __sindex_stree_fill(sindex_t* _this, const ds_data_t* kv, uint32_t width, sindex_size_t i, sindex_size_t k)
+{
+    sindex_size_t slot = 0;
+    int j = 0;
+
+    if (k >= _this->blocks)
+        return i;
+
+    for (j = 0; j < SINDEX_BLOCK; ++j) {
+        i = __sindex_stree_fill(_this, kv, width, i, k * (SINDEX_BLOCK + 1) + j + 1);
+        slot = k * SINDEX_BLOCK + j;
+        if (i < _this->size) {
+            _this->keys[slot] = kv[i * width];
+            if (!is_null(_this->values))
+                _this->values[slot] = kv[i * width + 1];
+            i++;
+        } else {
+            _this->keys[slot] = kv[(_this->size - 1) * width];
+            if (!is_null(_this->values))
+                _this->values[slot] = 0;
+        }
+    }
+    return __sindex_stree_fill(_this, kv, width, i, k * (SINDEX_BLOCK + 1) + SINDEX_BLOCK + 1);
+}
+
+/* Slot of the least key >= `key`, 0 if there's none. Every level is a conditional move,
+   the cache line of the descendants three levels down is requested meanwhile */
+static __always_inline sindex_size_t __sindex_eytzinger_lower(const sindex_t* _this, sindex_key_t key)
+{
+    const sindex_key_t* t = _this->keys;
+    size_t n = (size_t)_this->size;
+    size_t k = 1;
+
+    while (k <= n) {
+        __builtin_prefetch(t + k * 8);
+        k = 2 * k + (t[k] < key);
+    }
+    return k >> __builtin_ffsll((long long)~k);
+}
+
+/* Count of the keys of a block lt `key`, the whole block is compared at once */
+static __always_inline uint32_t __sindex_rank_block(const sindex_key_t* b, sindex_key_t key)
+{
+#if defined(__AVX2__)
+    __m256i k = _mm256_set1_epi64x((long long)key);
+    __m256i c0 = _mm256_cmpgt_epi64(k, _mm256_load_si256((const __m256i*)b));
+    __m256i c1 = _mm256_cmpgt_epi64(k, _mm256_load_si256((const __m256i*)(b + 4)));
+    uint32_t mask = (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(c0)) | (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(c1)) << 4;
+
+    return __builtin_popcount(mask);
+#elif defined(__SSE4_2__)
+    __m128i k = _mm_set1_epi64x((long long)key);
+    uint32_t i, mask = 0;
+
+    for (i = 0; i < SINDEX_BLOCK; i += 2)
+        mask |= (uint32_t)_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(k, _mm_load_si128((const __m128i*)(b + i))))) << i;
+    return __builtin_popcount(mask);
+#else
+    uint32_t i, ret = 0;
+
+    for (i = 0; i < SINDEX_BLOCK; ++i)
+        ret += b[i] < key;
+    return ret;
+#endif
+}
+
+/* Slot of the least key >= `key`, -1 if there's none */
+static __always_inline sindex_size_t __sindex_stree_lower(const sindex_t* _this, sindex_key_t key)
+{
+    sindex_size_t slot = -1;
+    sindex_size_t k = 0;
+    uint32_t i = 0;
+
+    while (k < _this->blocks) {
+        i = __sindex_rank_block(_this->keys + k * SINDEX_BLOCK, key);
+        slot = i < SINDEX_BLOCK ? k * SINDEX_BLOCK + i : slot;
+        k = k * (SINDEX_BLOCK + 1) + i + 1;
+    }
+    return slot;
+}
+
+/* Slot of the least key >= `key`, -1 if there's none */
+static __always_inline sindex_size_t __sindex_lower(const sindex_t* _this, sindex_key_t key)
+{
+    sindex_size_t slot = 0;
+
+    if (SINDEX_STREE == _this->layout)
+        return __sindex_stree_lower(_this, key);
+
+    slot = __sindex_eytzinger_lower(_this, key);
+    return 0 == slot ? -1 : slot;
+}
+
+static bool sindex_contains(const sindex_t* _this, sindex_key_t key)
+{
+    sindex_size_t slot = 0;
+
+    if (unlikely(is_null(_this)) || __sindex_size(_this) <= 0)
+        return false;
+
+    slot = __sindex_lower(_this, key);
+    return slot >= 0 && _this->keys[slot] == key;
+}
+
+static bool sindex_find(const sindex_t* _this, sindex_key_t key, sindex_value_t* value)
+{
+    sindex_size_t slot = 0;
+
+    if (unlikely(is_null(_this)) || __sindex_size(_this) <= 0)
+        return false;
+
+    slot = __sindex_lower(_this, key);
+    if (slot < 0 || _this->keys[slot] != key)
+        return false;
+
+    if (!is_null(value))
+        *value = is_null(_this->values) ? 0 : _this->values[slot];
+    return true;
+}
+
+static bool sindex_lower_bound(const sindex_t* _this, sindex_key_t key, sindex_key_t* lower, sindex_value_t* value)
+{
+    sindex_size_t slot = 0;
+
+    if (unlikely(is_null(_this)) || __sindex_size(_this) <= 0)
+        return false;
+
+    slot = __sindex_lower(_this, key);
+    if (slot < 0)
+        return false;
+
+    if (!is_null(lower))
+        *lower = _this->keys[slot];
+    if (!is_null(value))
+        *value = is_null(_this->values) ? 0 : _this->values[slot];
+    return true;
+}
+
+static sindex_size_t sindex_clear(sindex_t* _this)
+{
+    sindex_size_t ret = 0;
+
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    ret = __sindex_size(_this);
+    p_free(_this->keys);
+    p_free(_this->values);
+    _this->size = 0;
+    _this->blocks = 0;
+    return ret;
+}
+
+/* The entries are sorted and deduplicated in a copy, then laid out in new arrays, so a
+   failure leaves the index as it was */
+static sindex_size_t sindex_build_sorted(sindex_t* _this, const sindex_key_t* keys, const sindex_value_t* values, sindex_size_t n)
+{
+    uint32_t width = is_null(values) ? 1 : 2;
+    ds_data_t* kv = NULL;
+    sindex_t t = { .layout = 0 };
+    sindex_size_t i, m = 0;
+
+    if (unlikely(is_null(_this) || n < 0 || (n > 0 && is_null(keys))))
+        return -1;
+
+    kv = (ds_data_t*)p_malloc((n > 0 ? n : 1) * width * sizeof(ds_data_t));
+    if (unlikely(is_null(kv)))
+        return -1;
+
+    for (i = 0; i < n; ++i) {
+        kv[i * width] = keys[i];
+        if (!is_null(values))
+            kv[i * width + 1] = values[i];
+    }
+
+    for (i = 1; i < n && keys[i - 1] <= keys[i]; ++i)
+        ;
+
+    if (i < n && !__sort_merge_n(kv, n, width, __sindex_lt_default))
+        goto err;
+
+    for (i = 0; i < n; ++i) {
+        if (m > 0 && kv[(m - 1) * width] == kv[i * width])
+            continue;
+        if (m != i)
+            memcpy(kv + m * width, kv + i * width, width * sizeof(ds_data_t));
+        m++;
+    }
+
+    t.layout = _this->layout;
+    t.size = m;
+    t.blocks = (m + SINDEX_BLOCK - 1) / SINDEX_BLOCK;
+    t.keys = (sindex_key_t*)__sindex_alloc(SINDEX_STREE == t.layout ? t.blocks * SINDEX_BLOCK : m + 1);
+    if (unlikely(is_null(t.keys)))
+        goto err;
+
+    if (!is_null(values)) {
+        t.values = (sindex_value_t*)__sindex_alloc(SINDEX_STREE == t.layout ? t.blocks * SINDEX_BLOCK : m + 1);
+        if (unlikely(is_null(t.values)))
+            goto err;
+    }
+
+    if (SINDEX_STREE == t.layout)
+        __sindex_stree_fill(&t, kv, width, 0, 0);
+    else
+        __sindex_eytzinger_fill(&t, kv, width, 0, 1);
+
+    sindex_clear(_this);
+    *_this = t;
+    p_free(kv);
+    return m;
+
+err:
+    p_free(t.keys);
+    p_free(t.values);
+    p_free(kv);
+    return -1;
+}
+
+static sindex_size_t sindex_build_set(sindex_t* _this, const set_t* set)
+{
+    sindex_key_t* keys = NULL;
+    set_iterator_t* it = NULL;
+    sindex_size_t ret, i = 0;
+
+    if (unlikely(is_null(_this) || is_null(set)))
+        return -1;
+
+    if (!is_null(set->ops) && !is_null(set->ops->__lt_value))
+        return -1;
+
+    keys = (sindex_key_t*)p_malloc((cset->size(set) > 0 ? cset->size(set) : 1) * sizeof(sindex_key_t));
+    if (unlikely(is_null(keys)))
+        return -1;
+
+    for (it = cset->begin(set); cset->end(set) != it; it = cset->next(set, it))
+        keys[i++] = it->value;
+
+    ret = sindex_build_sorted(_this, keys, NULL, i);
+    p_free(keys);
+    return ret;
+}
+
+static sindex_size_t sindex_build_map(sindex_t* _this, const map_t* map)
+{
+    sindex_key_t* keys = NULL;
+    sindex_value_t* values = NULL;
+    map_iterator_t* it = NULL;
+    sindex_size_t ret = -1, i = 0;
+
+    if (unlikely(is_null(_this) || is_null(map)))
+        return -1;
+
+    if (!is_null(map->ops) && !is_null(map->ops->__lt))
+        return -1;
+
+    keys = (sindex_key_t*)p_malloc((cmap->size(map) > 0 ? cmap->size(map) : 1) * sizeof(sindex_key_t));
+    values = (sindex_value_t*)p_malloc((cmap->size(map) > 0 ? cmap->size(map) : 1) * sizeof(sindex_value_t));
+    if (likely(!is_null(keys) && !is_null(values))) {
+        for (it = cmap->begin(map); cmap->end(map) != it; it = cmap->next(map, it), ++i) {
+            keys[i] = it->key;
+            values[i] = it->value;
+        }
+        ret = sindex_build_sorted(_this, keys, values, i);
+    }
+
+    p_free(keys);
+    p_free(values);
+    return ret;
+}
+
+static sindex_size_t sindex_build_vector(sindex_t* _this, const vector_t* vector)
+{
+    if (unlikely(is_null(_this) || is_null(vector)))
+        return -1;
+
+    if (!is_null(vector->ops) && !is_null(vector->ops->__lt))
+        return -1;
+
+    return sindex_build_sorted(_this, &vector->head[0].data, NULL, cvector->size(vector));
+}
+
+/* __always_inline */ inline void __sindex_init(sindex_t* sindex, sindex_layout_t layout)
+{
+    sindex->keys = NULL;
+    sindex->values = NULL;
+    sindex->size = 0;
+    sindex->blocks = 0;
+    sindex->layout = layout;
+}
+
+/* __always_inline */ inline void __sindex_deinit(sindex_t* sindex)
+{
+    sindex_clear(sindex);
+}
+
+const class_sindex_t* class_sindex_ins(void)
+{
+    static const class_sindex_t ins = {
+        .size         = _sindex_size,
+        .build_sorted = sindex_build_sorted,
+        .build_set    = sindex_build_set,
+        .build_map    = sindex_build_map,
+        .build_vector = sindex_build_vector,
+        .contains     = sindex_contains,
+        .find         = sindex_find,
+        .lower_bound  = sindex_lower_bound,
+        .clear        = sindex_clear,
+    };
+    return &ins;
+}
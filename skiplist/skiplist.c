@@ -0,0 +1,561 @@
+/*
+  Concurrent Skiplist
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <skiplist/skiplist.h>
+
+#include <_memory.h>
+#include <linux/_compiler.h>
+
+#define SKIPLIST_ADVANCE_EVERY 64 /* Retirements between two tries to advance the epoch */
+
+#define __marked(p) ((p) & (uintptr_t)1)
+#define __node(p)   ((skiplist_node_t*)((p) & ~(uintptr_t)1))
+
+static /* __always_inline */ inline uintptr_t __skiplist_load(uintptr_t* p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static /* __always_inline */ inline bool __skiplist_cas(uintptr_t* p, uintptr_t old, uintptr_t new)
+{
+    return __atomic_compare_exchange_n(p, &old, new, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static /* __always_inline */ inline int __skiplist_cmp(const skiplist_t* _this, skiplist_key_t left, skiplist_key_t right)
+{
+    if (is_null(_this->ops) || is_null(_this->ops->__lt))
+        return left < right ? -1 : left > right;
+
+    if (!is_null(_this->ops->__cmp))
+        return _this->ops->__cmp(left, right);
+
+    return _this->ops->__lt(left, right) ? -1 : _this->ops->__lt(right, left);
+}
+
+static void __skiplist_node_free(skiplist_t* _this, skiplist_node_t* node)
+{
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_value))
+        _this->ops->free_value(&node->value);
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->free_key))
+        _this->ops->free_key(&node->key);
+
+    p_free(node);
+}
+
+static void __skiplist_limbo_free(skiplist_t* _this, skiplist_node_t** limbo)
+{
+    skiplist_node_t* t = NULL;
+
+    while (!is_null(*limbo)) {
+        t = *limbo;
+        *limbo = t->retired;
+        __skiplist_node_free(_this, t);
+    }
+}
+
+static void __skiplist_thread_exit(void* arg)
+{
+    skiplist_thread_t* t = (skiplist_thread_t*)arg;
+
+    /* Its limbo lists go with the record to the next thread taking it */
+    __atomic_store_n(&t->in_use, false, __ATOMIC_RELEASE);
+}
+
+/* The record of the calling thread, taking a free one or adding one at its first call */
+static skiplist_thread_t* __skiplist_thread(skiplist_t* _this)
+{
+    skiplist_thread_t* t = (skiplist_thread_t*)pthread_getspecific(_this->key);
+    bool in_use = false;
+
+    if (likely(!is_null(t)))
+        return t;
+
+    for (t = __atomic_load_n(&_this->threads, __ATOMIC_ACQUIRE); !is_null(t); t = t->next) {
+        in_use = false;
+        if (!__atomic_load_n(&t->in_use, __ATOMIC_RELAXED) &&
+            __atomic_compare_exchange_n(&t->in_use, &in_use, true, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+    }
+
+    if (is_null(t)) {
+        t = (skiplist_thread_t*)p_calloc(1, sizeof(skiplist_thread_t));
+        if (unlikely(is_null(t)))
+            return NULL;
+
+        t->in_use = true;
+        t->seed = (uint32_t)((uintptr_t)t >> 4) | 1;
+        t->next = __atomic_load_n(&_this->threads, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&_this->threads, &t->next, t, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+    }
+
+    if (unlikely(0 != pthread_setspecific(_this->key, t))) {
+        __atomic_store_n(&t->in_use, false, __ATOMIC_RELEASE);
+        return NULL;
+    }
+
+    return t;
+}
+
+/* Announce the global epoch, the nodes of the thread retired 3 epochs ago can't be seen any more */
+static void __skiplist_enter(skiplist_t* _this, skiplist_thread_t* t)
+{
+    unsigned long epoch = 0;
+
+    if (t->nest++ > 0)
+        return;
+
+    epoch = __atomic_load_n(&_this->epoch, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&t->state, (epoch << 1) | 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (t->epoch != epoch) {
+        t->epoch = epoch;
+        __skiplist_limbo_free(_this, &t->limbo[epoch % 3]);
+    }
+}
+
+static /* __always_inline */ inline void __skiplist_exit(skiplist_thread_t* t)
+{
+    if (--t->nest > 0)
+        return;
+
+    __atomic_store_n(&t->state, 0, __ATOMIC_RELEASE);
+}
+
+/* The epoch moves on once every thread inside an operation has seen it */
+static void __skiplist_advance(skiplist_t* _this)
+{
+    unsigned long epoch = __atomic_load_n(&_this->epoch, __ATOMIC_ACQUIRE);
+    unsigned long state = 0;
+    skiplist_thread_t* t = NULL;
+
+    for (t = __atomic_load_n(&_this->threads, __ATOMIC_ACQUIRE); !is_null(t); t = t->next) {
+        state = __atomic_load_n(&t->state, __ATOMIC_ACQUIRE);
+        if ((state & 1) && (state >> 1) != epoch)
+            return;
+    }
+
+    __atomic_compare_exchange_n(&_this->epoch, &epoch, epoch + 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+static void __skiplist_retire(skiplist_t* _this, skiplist_thread_t* t, skiplist_node_t* node)
+{
+    node->retired = t->limbo[t->epoch % 3];
+    t->limbo[t->epoch % 3] = node;
+
+    if (0 == ++t->retired % SKIPLIST_ADVANCE_EVERY)
+        __skiplist_advance(_this);
+}
+
+static /* __always_inline */ inline int __skiplist_level(skiplist_thread_t* t)
+{
+    uint32_t x = t->seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    t->seed = x;
+    return 1 + __builtin_ctz(x | (1u << (2 * (SKIPLIST_LEVEL_MAX - 1)))) / 2;
+}
+
+/* Fill `preds` and `succs` around `key` on every level, unlinking the removed nodes met on the way.
+   Return the node holding `key` if any */
+static skiplist_node_t* __skiplist_search(skiplist_t* _this, skiplist_key_t key, skiplist_node_t** preds, skiplist_node_t** succs)
+{
+    skiplist_node_t* pred = NULL;
+    skiplist_node_t* curr = NULL;
+    uintptr_t succ = 0;
+    int i = 0;
+
+retry:
+    pred = _this->head;
+    for (i = SKIPLIST_LEVEL_MAX - 1; i >= 0; --i) {
+        curr = __node(__skiplist_load(&pred->next[i]));
+        while (!is_null(curr)) {
+            succ = __skiplist_load(&curr->next[i]);
+            if (__marked(succ)) {
+                if (!__skiplist_cas(&pred->next[i], (uintptr_t)curr, (uintptr_t)__node(succ)))
+                    goto retry;
+                curr = __node(succ);
+                continue;
+            }
+
+            if (__skiplist_cmp(_this, curr->key, key) >= 0)
+                break;
+
+            pred = curr;
+            curr = __node(succ);
+        }
+
+        preds[i] = pred;
+        succs[i] = curr;
+    }
+
+    curr = succs[0];
+    return !is_null(curr) && 0 == __skiplist_cmp(_this, curr->key, key) ? curr : NULL;
+}
+
+/* As `__skiplist_search` for readers: removed nodes are stepped over, not unlinked */
+static skiplist_node_t* __skiplist_lower_bound(skiplist_t* _this, skiplist_key_t key)
+{
+    skiplist_node_t* pred = _this->head;
+    skiplist_node_t* curr = NULL;
+    uintptr_t succ = 0;
+    int i = 0;
+
+    for (i = SKIPLIST_LEVEL_MAX - 1; i >= 0; --i) {
+        curr = __node(__skiplist_load(&pred->next[i]));
+        while (!is_null(curr)) {
+            succ = __skiplist_load(&curr->next[i]);
+            if (!__marked(succ)) {
+                if (__skiplist_cmp(_this, curr->key, key) >= 0)
+                    break;
+                pred = curr;
+            }
+            curr = __node(succ);
+        }
+    }
+
+    return curr;
+}
+
+/* The last of the inserter and the remover unlinks `node` from the levels it's still on and retires it */
+static void __skiplist_release(skiplist_t* _this, skiplist_thread_t* t, skiplist_node_t* node)
+{
+    skiplist_node_t* preds[SKIPLIST_LEVEL_MAX];
+    skiplist_node_t* succs[SKIPLIST_LEVEL_MAX];
+
+    if (__atomic_sub_fetch(&node->owners, 1, __ATOMIC_ACQ_REL) > 0)
+        return;
+
+    __skiplist_search(_this, node->key, preds, succs);
+    __skiplist_retire(_this, t, node);
+}
+
+/* Mark `node` removed on every level, top down. Return false if another thread removed it first */
+static bool __skiplist_remove_node(skiplist_t* _this, skiplist_thread_t* t, skiplist_node_t* node)
+{
+    uintptr_t succ = 0;
+    int i = 0;
+
+    for (i = node->level - 1; i > 0; --i) {
+        succ = __skiplist_load(&node->next[i]);
+        while (!__marked(succ) &&
+               !__atomic_compare_exchange_n(&node->next[i], &succ, succ | 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            ;
+    }
+
+    succ = __skiplist_load(&node->next[0]);
+    while (true) {
+        if (__marked(succ))
+            return false;
+        if (__atomic_compare_exchange_n(&node->next[0], &succ, succ | 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            break;
+    }
+
+    __atomic_sub_fetch(&_this->size, 1, __ATOMIC_RELAXED);
+    __skiplist_release(_this, t, node);
+    return true;
+}
+
+static skiplist_size_t skiplist_size(const skiplist_t* _this)
+{
+    if (unlikely(is_null(_this)))
+        return -1;
+
+    return __atomic_load_n(&_this->size, __ATOMIC_RELAXED);
+}
+
+static bool skiplist_lower_bound(skiplist_t* _this, skiplist_key_t key, skiplist_key_t* lower, skiplist_value_t* value)
+{
+    skiplist_thread_t* t = NULL;
+    skiplist_node_t* node = NULL;
+
+    if (unlikely(is_null(_this) || is_null(_this->head)))
+        return false;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return false;
+
+    t = __skiplist_thread(_this);
+    if (unlikely(is_null(t)))
+        return false;
+
+    __skiplist_enter(_this, t);
+    node = __skiplist_lower_bound(_this, key);
+    if (!is_null(node)) {
+        if (!is_null(lower))
+            *lower = node->key;
+        if (!is_null(value))
+            *value = node->value;
+    }
+    __skiplist_exit(t);
+
+    return !is_null(node);
+}
+
+static bool skiplist_find(skiplist_t* _this, skiplist_key_t key, skiplist_value_t* value)
+{
+    skiplist_thread_t* t = NULL;
+    skiplist_node_t* node = NULL;
+    bool ret = false;
+
+    if (unlikely(is_null(_this) || is_null(_this->head)))
+        return false;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return false;
+
+    t = __skiplist_thread(_this);
+    if (unlikely(is_null(t)))
+        return false;
+
+    __skiplist_enter(_this, t);
+    node = __skiplist_lower_bound(_this, key);
+    ret = !is_null(node) && 0 == __skiplist_cmp(_this, node->key, key);
+    if (ret && !is_null(value))
+        *value = node->value;
+    __skiplist_exit(t);
+
+    return ret;
+}
+
+static bool skiplist_insert(skiplist_t* _this, skiplist_key_t key, skiplist_value_t value)
+{
+    skiplist_node_t* preds[SKIPLIST_LEVEL_MAX];
+    skiplist_node_t* succs[SKIPLIST_LEVEL_MAX];
+    skiplist_thread_t* t = NULL;
+    skiplist_node_t* node = NULL;
+    uintptr_t next = 0;
+    int level = 0;
+    int i = 0;
+
+    if (unlikely(is_null(_this) || is_null(_this->head)))
+        return false;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_value) && !_this->ops->valid_value(value))
+        return false;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return false;
+
+    t = __skiplist_thread(_this);
+    if (unlikely(is_null(t)))
+        return false;
+
+    level = __skiplist_level(t);
+    node = (skiplist_node_t*)p_calloc(1, sizeof(skiplist_node_t) + level * sizeof(uintptr_t));
+    if (unlikely(is_null(node)))
+        return false;
+
+    node->level = level;
+    node->owners = 2;
+
+    if (is_null(_this->ops) || is_null(_this->ops->copy_key)) {
+        node->key = key;
+    } else {
+        if (!_this->ops->copy_key(key, &node->key))
+            goto err;
+    }
+
+    if (is_null(_this->ops) || is_null(_this->ops->copy_value)) {
+        node->value = value;
+    } else {
+        if (!_this->ops->copy_value(value, &node->value))
+            goto err;
+    }
+
+    __skiplist_enter(_this, t);
+
+    /* Level 0 decides whether it's in */
+    do {
+        if (!is_null(__skiplist_search(_this, key, preds, succs))) {
+            __skiplist_exit(t);
+            goto err;
+        }
+
+        for (i = 0; i < level; ++i)
+            node->next[i] = (uintptr_t)succs[i];
+    } while (!__skiplist_cas(&preds[0]->next[0], (uintptr_t)succs[0], (uintptr_t)node));
+
+    __atomic_add_fetch(&_this->size, 1, __ATOMIC_RELAXED);
+
+    /* The upper levels are only shortcuts, give up on them once it's being removed */
+    for (i = 1; i < level; ++i) {
+        while (true) {
+            next = __skiplist_load(&node->next[i]);
+            if (__marked(next))
+                goto out;
+            if (next != (uintptr_t)succs[i] && !__skiplist_cas(&node->next[i], next, (uintptr_t)succs[i]))
+                goto out;
+            if (__skiplist_cas(&preds[i]->next[i], (uintptr_t)succs[i], (uintptr_t)node))
+                break;
+            if (node != __skiplist_search(_this, key, preds, succs))
+                goto out;
+        }
+    }
+
+out:
+    __skiplist_release(_this, t, node);
+    __skiplist_exit(t);
+    return true;
+
+err:
+    __skiplist_node_free(_this, node);
+    return false;
+}
+
+static skiplist_size_t skiplist_remove(skiplist_t* _this, skiplist_key_t key)
+{
+    skiplist_thread_t* t = NULL;
+    skiplist_node_t* node = NULL;
+    skiplist_size_t ret = 0;
+
+    if (unlikely(is_null(_this) || is_null(_this->head)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && !_this->ops->valid_key(key))
+        return 0;
+
+    t = __skiplist_thread(_this);
+    if (unlikely(is_null(t)))
+        return -1;
+
+    __skiplist_enter(_this, t);
+    node = __skiplist_lower_bound(_this, key);
+    if (!is_null(node) && 0 == __skiplist_cmp(_this, node->key, key) && __skiplist_remove_node(_this, t, node))
+        ret = 1;
+    __skiplist_exit(t);
+
+    return ret;
+}
+
+static skiplist_size_t skiplist_clear(skiplist_t* _this)
+{
+    skiplist_thread_t* t = NULL;
+    skiplist_node_t* node = NULL;
+    skiplist_size_t ret = 0;
+
+    if (unlikely(is_null(_this) || is_null(_this->head)))
+        return -1;
+
+    t = __skiplist_thread(_this);
+    if (unlikely(is_null(t)))
+        return -1;
+
+    __skiplist_enter(_this, t);
+    for (node = __node(__skiplist_load(&_this->head->next[0])); !is_null(node); node = __node(__skiplist_load(&node->next[0]))) {
+        if (__skiplist_remove_node(_this, t, node))
+            ret++;
+    }
+    __skiplist_exit(t);
+
+    return ret;
+}
+
+static skiplist_size_t skiplist_for_each_range(skiplist_t* _this, skiplist_key_t lo, skiplist_key_t hi, for_each_kv cb, void* arg)
+{
+    skiplist_thread_t* t = NULL;
+    skiplist_node_t* node = NULL;
+    skiplist_size_t ret = 0;
+    uintptr_t next = 0;
+
+    if (unlikely(is_null(_this) || is_null(_this->head) || is_null(cb)))
+        return -1;
+
+    if (!is_null(_this->ops) && !is_null(_this->ops->valid_key) && (!_this->ops->valid_key(lo) || !_this->ops->valid_key(hi)))
+        return -1;
+
+    t = __skiplist_thread(_this);
+    if (unlikely(is_null(t)))
+        return -1;
+
+    __skiplist_enter(_this, t);
+    for (node = __skiplist_lower_bound(_this, lo); !is_null(node); node = __node(next)) {
+        next = __skiplist_load(&node->next[0]);
+        if (__marked(next))
+            continue;
+        if (__skiplist_cmp(_this, node->key, hi) >= 0)
+            break;
+
+        ret++;
+        if (!cb(node->key, node->value, arg))
+            break;
+    }
+    __skiplist_exit(t);
+
+    return ret;
+}
+
+/* __always_inline */ inline void __skiplist_init(skiplist_t* skiplist)
+{
+    skiplist->head = (skiplist_node_t*)p_calloc(1, sizeof(skiplist_node_t) + SKIPLIST_LEVEL_MAX * sizeof(uintptr_t));
+    if (unlikely(is_null(skiplist->head)))
+        return;
+
+    skiplist->head->level = SKIPLIST_LEVEL_MAX;
+    if (0 != pthread_key_create(&skiplist->key, __skiplist_thread_exit))
+        p_free(skiplist->head);
+}
+
+/* __always_inline */ inline void __skiplist_deinit(skiplist_t* skiplist)
+{
+    skiplist_node_t* node = NULL;
+    skiplist_thread_t* t = NULL;
+
+    if (is_null(skiplist->head))
+        return;
+
+    /* Every node retired has been unlinked by then, the ones left are all in */
+    while (!is_null(node = __node(skiplist->head->next[0]))) {
+        skiplist->head->next[0] = node->next[0];
+        __skiplist_node_free(skiplist, node);
+    }
+
+    while (!is_null(t = skiplist->threads)) {
+        skiplist->threads = t->next;
+        __skiplist_limbo_free(skiplist, &t->limbo[0]);
+        __skiplist_limbo_free(skiplist, &t->limbo[1]);
+        __skiplist_limbo_free(skiplist, &t->limbo[2]);
+        p_free(t);
+    }
+
+    pthread_key_delete(skiplist->key);
+    p_free(skiplist->head);
+
+    skiplist->ops = NULL;
+    skiplist->size = 0;
+    skiplist->epoch = 0;
+}
+
+const class_skiplist_t* class_skiplist_ins(void)
+{
+    static const class_skiplist_t ins = {
+        .size           = skiplist_size,
+        .find           = skiplist_find,
+        .lower_bound    = skiplist_lower_bound,
+        .insert         = skiplist_insert,
+        .remove         = skiplist_remove,
+        .clear          = skiplist_clear,
+        .for_each_range = skiplist_for_each_range,
+    };
+    return &ins;
+}
@@ -0,0 +1,345 @@
+/*
+  Snapshot Implementations
+  Copyright (C) 2021  YangJie <yangjie98765@yeah.net>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <snapshot/snapshot.h>
+#include <hashmap/hashmap_image.h>
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <_log.h>
+#include <_memory.h>
+#include <linux/_compiler.h>
+
+#ifndef TAG
+#define TAG "[snapshot]"
+#endif /* TAG */
+
+#define SS_STR_NULL   (0xffffffffU)
+#define SS_PATH_MAX   (4096)
+#define SS_STREAM_BUF (1 << 20)
+
+typedef struct snapshot_result {
+    int      status;
+    uint64_t end_us;
+    uint64_t records;
+    uint64_t bytes;
+    uint64_t cow_bytes;
+} snapshot_result_t;
+
+typedef bool (*ss_writer)(const void* ds, const char* path, hashmap_kv_type_t type, uint64_t* records);
+
+static __always_inline uint64_t __ss_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t __ss_rss_bytes(void)
+{
+    unsigned long size = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+
+    if (is_null(f))
+        return 0;
+    if (2 != fscanf(f, "%lu %lu", &size, &resident))
+        resident = 0;
+    fclose(f);
+    return (uint64_t)resident * sysconf(_SC_PAGESIZE);
+}
+
+/* After `fork` every page is shared, a page the parent writes to is duplicated and the
+   child's copy becomes private to it, so the child's private dirty memory is the cost of COW */
+static uint64_t __ss_private_dirty(void)
+{
+    char line[256];
+    unsigned long kb;
+    uint64_t ret = 0;
+    FILE* f = fopen("/proc/self/smaps_rollup", "r");
+
+    if (is_null(f))
+        f = fopen("/proc/self/smaps", "r");
+    if (is_null(f))
+        return 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        if (1 == sscanf(line, "Private_Dirty: %lu kB", &kb))
+            ret += (uint64_t)kb << 10;
+    }
+    fclose(f);
+    return ret;
+}
+
+static __always_inline bool __ss_put(FILE* f, bool str, ds_data_t data)
+{
+    int64_t i = data;
+    uint32_t len;
+
+    if (!str)
+        return 1 == fwrite(&i, sizeof(i), 1, f);
+
+    len = is_null(data) ? SS_STR_NULL : (uint32_t)strlen((const char*)data);
+    if (1 != fwrite(&len, sizeof(len), 1, f))
+        return false;
+    return SS_STR_NULL == len || len == fwrite((const char*)data, 1, len, f);
+}
+
+static FILE* __ss_stream_open(const char* tmp, snapshot_ds_t ds, hashmap_kv_type_t type, uint64_t size)
+{
+    snapshot_header_t hdr = {
+        .magic   = SNAPSHOT_MAGIC,
+        .version = SNAPSHOT_VERSION,
+        .ds      = ds,
+        .type    = type,
+        .size    = size,
+    };
+    FILE* f = fopen(tmp, "wb");
+
+    if (is_null(f))
+        return NULL;
+
+    setvbuf(f, NULL, _IOFBF, SS_STREAM_BUF);
+    if (1 != fwrite(&hdr, sizeof(hdr), 1, f)) {
+        fclose(f);
+        return NULL;
+    }
+    return f;
+}
+
+static bool __ss_stream_close(FILE* f, const char* tmp, const char* path, bool ok)
+{
+    ok = ok && 0 == fflush(f) && 0 == fsync(fileno(f));
+    ok = 0 == fclose(f) && ok;
+    if (ok && 0 == rename(tmp, path))
+        return true;
+
+    unlink(tmp);
+    return false;
+}
+
+static bool __ss_write_map(const void* ds, const char* path, hashmap_kv_type_t type, uint64_t* records)
+{
+    const map_t* map = ds;
+    map_iterator_t* it;
+    char tmp[SS_PATH_MAX];
+    bool ok = true;
+    FILE* f;
+
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+        return false;
+
+    f = __ss_stream_open(tmp, SNAPSHOT_DS_MAP, type, cmap->size(map));
+    if (is_null(f))
+        return false;
+
+    for (it = cmap->begin(map); ok && cmap->end(map) != it; it = cmap->next(map, it)) {
+        ok = !is_null(it) && __ss_put(f, type & HM_KV_KEY_STRING, it->key) && __ss_put(f, type & HM_KV_VALUE_STRING, it->value);
+        *records += ok;
+    }
+    return __ss_stream_close(f, tmp, path, ok);
+}
+
+static bool __ss_write_set(const void* ds, const char* path, hashmap_kv_type_t type, uint64_t* records)
+{
+    const set_t* set = ds;
+    set_iterator_t* it;
+    char tmp[SS_PATH_MAX];
+    bool ok = true;
+    FILE* f;
+
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+        return false;
+
+    f = __ss_stream_open(tmp, SNAPSHOT_DS_SET, type, cset->size(set));
+    if (is_null(f))
+        return false;
+
+    for (it = cset->begin(set); ok && cset->end(set) != it; it = cset->next(set, it)) {
+        ok = !is_null(it) && __ss_put(f, type & HM_KV_VALUE_STRING, it->value);
+        *records += ok;
+    }
+    return __ss_stream_close(f, tmp, path, ok);
+}
+
+static bool __ss_write_hashmap(const void* ds, const char* path, hashmap_kv_type_t type, uint64_t* records)
+{
+    if (!chashmap_image->dump(ds, path, type))
+        return false;
+
+    *records = chashmap->size(ds);
+    return true;
+}
+
+static bool __snapshot_start(snapshot_t* _this, ss_writer writer, const void* ds, const char* path, hashmap_kv_type_t type)
+{
+    snapshot_result_t result;
+    struct stat st;
+    int fds[2];
+    pid_t pid;
+
+    if (unlikely(is_null(_this) || is_null(ds) || is_null(path)))
+        return false;
+
+    if (_this->pid > 0) {
+        pr_err("A snapshot [ %d ] is still in progress!", (int)_this->pid);
+        return false;
+    }
+
+    if (pipe(fds) < 0)
+        return false;
+
+    _this->rss_bytes = __ss_rss_bytes();
+    _this->start_us  = __ss_now_us();
+
+    pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        pr_err("Fork failed!");
+        return false;
+    }
+
+    if (0 == pid) {
+        close(fds[0]);
+        memset(&result, 0, sizeof(result));
+        result.status    = writer(ds, path, type, &result.records) ? 0 : 1;
+        result.bytes     = 0 == stat(path, &st) ? (uint64_t)st.st_size : 0;
+        result.cow_bytes = __ss_private_dirty();
+        result.end_us    = __ss_now_us();
+        if (write(fds[1], &result, sizeof(result)) != sizeof(result))
+            result.status = 1;
+        _exit(result.status);
+    }
+
+    _this->fork_us = __ss_now_us() - _this->start_us;
+    close(fds[1]);
+    _this->fd      = fds[0];
+    _this->pid     = pid;
+    _this->reaped  = false;
+    _this->wstatus = 0;
+    pr_info("Snapshot [ %s ] started in [ %d ], fork took [ %lu ] us", path, (int)pid, (unsigned long)_this->fork_us);
+    return true;
+}
+
+static bool snapshot_hashmap(snapshot_t* _this, const hashmap_t* hashmap, const char* path, hashmap_kv_type_t type)
+{
+    return __snapshot_start(_this, __ss_write_hashmap, hashmap, path, type);
+}
+
+static bool snapshot_map(snapshot_t* _this, const map_t* map, const char* path, hashmap_kv_type_t type)
+{
+    return __snapshot_start(_this, __ss_write_map, map, path, type);
+}
+
+static bool snapshot_set(snapshot_t* _this, const set_t* set, const char* path, hashmap_kv_type_t type)
+{
+    return __snapshot_start(_this, __ss_write_set, set, path, type);
+}
+
+static bool snapshot_done(snapshot_t* _this)
+{
+    if (unlikely(is_null(_this)))
+        return false;
+
+    if (_this->pid <= 0 || _this->reaped)
+        return true;
+
+    if (waitpid(_this->pid, &_this->wstatus, WNOHANG) == _this->pid)
+        _this->reaped = true;
+    return _this->reaped;
+}
+
+static bool snapshot_wait(snapshot_t* _this, snapshot_report_t* report)
+{
+    snapshot_result_t result;
+    bool ok;
+
+    if (unlikely(is_null(_this) || _this->pid <= 0))
+        return false;
+
+    while (!_this->reaped) {
+        if (waitpid(_this->pid, &_this->wstatus, 0) == _this->pid)
+            _this->reaped = true;
+        else if (EINTR != errno)
+            break;
+    }
+
+    ok = read(_this->fd, &result, sizeof(result)) == sizeof(result);
+    if (!ok) {
+        memset(&result, 0, sizeof(result));
+        result.status = -1; /* The child died before reporting */
+        result.end_us = __ss_now_us();
+    }
+
+    if (!is_null(report)) {
+        report->status            = result.status;
+        report->duration_us       = result.end_us - _this->start_us;
+        report->fork_us           = _this->fork_us;
+        report->records           = result.records;
+        report->bytes             = result.bytes;
+        report->rss_bytes         = _this->rss_bytes;
+        report->cow_bytes         = result.cow_bytes;
+        report->cow_amplification = 0 == _this->rss_bytes ? 0.0 : (double)result.cow_bytes / _this->rss_bytes;
+    }
+
+    pr_info("Snapshot [ %d ] finished, status [ %d ], records [ %lu ], bytes [ %lu ], cow [ %lu ] of rss [ %lu ]",
+            (int)_this->pid, result.status, (unsigned long)result.records, (unsigned long)result.bytes,
+            (unsigned long)result.cow_bytes, (unsigned long)_this->rss_bytes);
+
+    close(_this->fd);
+    _this->fd  = -1;
+    _this->pid = -1;
+    return 0 == result.status;
+}
+
+/* __always_inline */ inline void __snapshot_init(snapshot_t* snapshot)
+{
+    snapshot->pid       = -1;
+    snapshot->fd        = -1;
+    snapshot->wstatus   = 0;
+    snapshot->reaped    = false;
+    snapshot->start_us  = 0;
+    snapshot->fork_us   = 0;
+    snapshot->rss_bytes = 0;
+}
+
+/* __always_inline */ inline void __snapshot_deinit(snapshot_t* snapshot)
+{
+    if (snapshot->pid > 0)
+        snapshot_wait(snapshot, NULL);
+    __snapshot_init(snapshot);
+}
+
+/* __always_inline */ inline const class_snapshot_t* class_snapshot_ins(void)
+{
+    static const class_snapshot_t ins = {
+        .hashmap = snapshot_hashmap,
+        .map     = snapshot_map,
+        .set     = snapshot_set,
+        .done    = snapshot_done,
+        .wait    = snapshot_wait,
+    };
+    return &ins;
+}
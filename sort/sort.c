@@ -21,6 +21,7 @@
 
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* common */
 static inline void __sort_swap(ds_data_t* a, ds_data_t* b)
@@ -252,3 +253,58 @@ inline void sort_quick(ds_data_t* a, ds_size_t size, __comp __comp)
         return ;
     _sort_quick_s(a, size - 1, __comp); /* the last element is ordered by bubble */
 }
+
+
+
+/* sort_merge_n */
+static void __sort_merge_n_run(const ds_data_t* src, ds_data_t* dst, ds_size_t l, ds_size_t m, ds_size_t r, ds_size_t width, __comp __comp)
+{
+    ds_size_t i = l, j = m, k = l;
+
+    while (i < m && j < r) {
+        if (__comp(src[j * width], src[i * width])) /* the left one wins on a tie */
+            memcpy(&dst[k++ * width], &src[j++ * width], width * sizeof(ds_data_t));
+        else
+            memcpy(&dst[k++ * width], &src[i++ * width], width * sizeof(ds_data_t));
+    }
+    if (i < m)
+        memcpy(&dst[k * width], &src[i * width], (m - i) * width * sizeof(ds_data_t));
+    if (j < r)
+        memcpy(&dst[(k + m - i) * width], &src[j * width], (r - j) * width * sizeof(ds_data_t));
+}
+
+bool __sort_merge_n(ds_data_t* a, ds_size_t size, ds_size_t width, __comp __comp)
+{
+    ds_data_t* b = malloc(size * width * sizeof(ds_data_t));
+    ds_data_t* src = a;
+    ds_data_t* dst = b;
+
+    if (!b)
+        return false;
+
+    for (ds_size_t run = 1; run < size; run <<= 1) {
+        for (ds_size_t l = 0; l < size; l += run << 1) {
+            ds_size_t m = l + run < size ? l + run : size;
+            ds_size_t r = l + (run << 1) < size ? l + (run << 1) : size;
+            __sort_merge_n_run(src, dst, l, m, r, width, __comp);
+        }
+
+        ds_data_t* t = src;
+        src = dst;
+        dst = t;
+    }
+
+    if (src != a)
+        memcpy(a, src, size * width * sizeof(ds_data_t));
+    free(b);
+    return true;
+}
+
+inline bool sort_merge_n(ds_data_t* a, ds_size_t size, ds_size_t width, __comp __comp)
+{
+    if (!a || width < 1 || !__comp)
+        return false;
+    if (size < 2)
+        return true;
+    return __sort_merge_n(a, size, width, __comp);
+}